@@ -26,6 +26,7 @@
 #include <linux/kernel_stat.h>
 #include <linux/sysdev.h>
 #include <linux/cpu.h>
+#include <linux/clockchips.h>
 
 #include <asm/atomic.h>
 #include <asm/smp.h>
@@ -1044,6 +1045,72 @@ static int __init calibrate_APIC_clock(void)
 
 static unsigned int calibration_result;
 
+#ifdef CONFIG_HIGH_RES_TIMERS
+/*
+ * The local APIC timer as a oneshot clock event device. Once hrtimers
+ * switch a cpu to it, its interrupt runs the hrtimer queues instead of
+ * smp_local_timer_interrupt(), see kernel/hrtimer.c.
+ */
+static DEFINE_PER_CPU(struct clock_event_device, lapic_events);
+
+static int lapic_next_event(unsigned long delta,
+			    struct clock_event_device *evt)
+{
+	apic_write_around(APIC_TMICT, delta);
+	return 0;
+}
+
+static void lapic_timer_setup(enum clock_event_mode mode,
+			      struct clock_event_device *evt)
+{
+	unsigned long flags;
+	unsigned int v;
+
+	local_irq_save(flags);
+	switch (mode) {
+	case CLOCK_EVT_MODE_PERIODIC:
+		__setup_APIC_LVTT(calibration_result);
+		break;
+	case CLOCK_EVT_MODE_ONESHOT:
+		v = apic_read(APIC_LVTT);
+		v &= ~(APIC_LVT_TIMER_PERIODIC | APIC_LVT_MASKED);
+		apic_write_around(APIC_LVTT, v);
+		apic_write_around(APIC_TMICT, 0);
+		break;
+	case CLOCK_EVT_MODE_UNUSED:
+	case CLOCK_EVT_MODE_SHUTDOWN:
+		v = apic_read(APIC_LVTT);
+		apic_write_around(APIC_LVTT, v | APIC_LVT_MASKED);
+		break;
+	}
+	local_irq_restore(flags);
+}
+
+/*
+ * The timer counts down at the bus clock divided by APIC_DIVISOR;
+ * calibration_result is the number of bus clocks per tick.
+ */
+static void __devinit setup_APIC_timer_events(void)
+{
+	struct clock_event_device *evt = &__get_cpu_var(lapic_events);
+
+	evt->name = "lapic";
+	evt->features = CLOCK_EVT_FEAT_PERIODIC | CLOCK_EVT_FEAT_ONESHOT;
+	evt->rating = 100;
+	evt->shift = 32;
+	evt->mult = div_sc(calibration_result / APIC_DIVISOR, TICK_NSEC,
+			   evt->shift);
+	evt->max_delta_ns = clockevent_delta2ns(0x7FFFFFFF, evt);
+	evt->min_delta_ns = clockevent_delta2ns(0xF, evt);
+	evt->cpumask = cpumask_of_cpu(smp_processor_id());
+	evt->set_next_event = lapic_next_event;
+	evt->set_mode = lapic_timer_setup;
+	clockevents_register_device(evt);
+}
+#else
+static inline void setup_APIC_timer_events(void) { }
+#endif
+
 void __init setup_boot_APIC_clock(void)
 {
 	apic_printk(APIC_VERBOSE, "Using local APIC timer interrupts.\n");
@@ -1056,6 +1123,7 @@ void __init setup_boot_APIC_clock(void)
 	 * Now set up the timer for real.
 	 */
 	setup_APIC_timer(calibration_result);
+	setup_APIC_timer_events();
 
 	local_irq_enable();
 }
@@ -1063,6 +1131,7 @@ void __init setup_boot_APIC_clock(void)
 void __devinit setup_secondary_APIC_clock(void)
 {
 	setup_APIC_timer(calibration_result);
+	setup_APIC_timer_events();
 }
 
 void __devinit disable_APIC_timer(void)
@@ -1195,7 +1264,13 @@ fastcall void smp_apic_timer_interrupt(struct pt_regs *regs)
 	 * interrupt lock, which is the WrongThing (tm) to do.
 	 */
 	irq_enter();
-	smp_local_timer_interrupt(regs);
+#ifdef CONFIG_HIGH_RES_TIMERS
+	if (__get_cpu_var(lapic_events).event_handler)
+		__get_cpu_var(lapic_events).event_handler(
+				&__get_cpu_var(lapic_events), regs);
+	else
+#endif
+		smp_local_timer_interrupt(regs);
 	irq_exit();
 }
 
@@ -28,6 +28,7 @@
 #include <linux/user.h>
 #include <linux/a.out.h>
 #include <linux/interrupt.h>
+#include <linux/hrtimer.h>
 #include <linux/config.h>
 #include <linux/utsname.h>
 #include <linux/delay.h>
@@ -199,8 +200,10 @@ void cpu_idle(void)
 				play_dead();
 
 			__get_cpu_var(irq_stat).idle_timestamp = jiffies;
+			hrtimer_stop_sched_tick();
 			idle();
 		}
+		hrtimer_restart_sched_tick();
 		schedule();
 	}
 }
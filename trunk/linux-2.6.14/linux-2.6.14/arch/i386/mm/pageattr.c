@@ -9,6 +9,7 @@
 #include <linux/highmem.h>
 #include <linux/module.h>
 #include <linux/slab.h>
+#include <linux/vmalloc.h>
 #include <asm/uaccess.h>
 #include <asm/processor.h>
 #include <asm/tlbflush.h>
@@ -171,7 +172,8 @@ static inline void flush_map(void)
  * 
  * Caller must call global_flush_tlb() after this.
  */
-int change_page_attr(struct page *page, int numpages, pgprot_t prot)
+static int __change_page_attr_range(struct page *page, int numpages,
+					pgprot_t prot)
 {
 	int err = 0; 
 	int i; 
@@ -187,6 +189,13 @@ int change_page_attr(struct page *page, int numpages, pgprot_t prot)
 	return err;
 }
 
+int change_page_attr(struct page *page, int numpages, pgprot_t prot)
+{
+	/* No lazily unmapped vmap alias may keep the old attributes */
+	vm_unmap_aliases();
+	return __change_page_attr_range(page, numpages, prot);
+}
+
 void global_flush_tlb(void)
 { 
 	LIST_HEAD(l);
@@ -210,7 +219,8 @@ void kernel_map_pages(struct page *page, int numpages, int enable)
 	/* the return value is ignored - the calls cannot fail,
 	 * large pages are disabled at boot time.
 	 */
-	change_page_attr(page, numpages, enable ? PAGE_KERNEL : __pgprot(0));
+	__change_page_attr_range(page, numpages,
+				enable ? PAGE_KERNEL : __pgprot(0));
 	/* we should perform an IPI and flush all tlbs,
 	 * but that can deadlock->flush only current cpu.
 	 */
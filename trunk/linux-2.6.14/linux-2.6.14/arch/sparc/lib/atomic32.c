@@ -38,6 +38,34 @@ int __atomic_add_return(int i, atomic_t *v)
 	return ret;
 }
 
+int atomic_cmpxchg(atomic_t *v, int old, int new)
+{
+	int ret;
+	unsigned long flags;
+	spin_lock_irqsave(ATOMIC_HASH(v), flags);
+
+	ret = v->counter;
+	if (ret == old)
+		v->counter = new;
+
+	spin_unlock_irqrestore(ATOMIC_HASH(v), flags);
+	return ret;
+}
+
+int atomic_add_unless(atomic_t *v, int a, int u)
+{
+	int ret;
+	unsigned long flags;
+	spin_lock_irqsave(ATOMIC_HASH(v), flags);
+
+	ret = v->counter;
+	if (ret != u)
+		v->counter += a;
+
+	spin_unlock_irqrestore(ATOMIC_HASH(v), flags);
+	return ret != u;
+}
+
 void atomic_set(atomic_t *v, int i)
 {
 	unsigned long flags;
@@ -50,4 +78,6 @@ void atomic_set(atomic_t *v, int i)
 
 EXPORT_SYMBOL(__atomic_add_return);
 EXPORT_SYMBOL(atomic_set);
+EXPORT_SYMBOL(atomic_cmpxchg);
+EXPORT_SYMBOL(atomic_add_unless);
 
@@ -15,6 +15,7 @@
 #include <linux/seq_file.h>
 #include <linux/module.h>
 #include <linux/delay.h>
+#include <linux/hrtimer.h>
 #include <asm/uaccess.h>
 #include <asm/io_apic.h>
 
@@ -77,6 +78,13 @@ skip:
 			if (cpu_online(j))
 				seq_printf(p, "%10u ", cpu_pda[j].apic_timer_irqs);
 		seq_putc(p, '\n');
+#endif
+#ifdef CONFIG_NO_IDLE_HZ
+		seq_printf(p, "NOH: ");
+		for (j = 0; j < NR_CPUS; j++)
+			if (cpu_online(j))
+				seq_printf(p, "%10lu ", hrtimer_skipped_ticks(j));
+		seq_putc(p, '\n');
 #endif
 		seq_printf(p, "ERR: %10u\n", atomic_read(&irq_err_count));
 #ifdef CONFIG_X86_IO_APIC
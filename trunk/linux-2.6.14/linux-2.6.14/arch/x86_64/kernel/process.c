@@ -31,6 +31,7 @@
 #include <linux/module.h>
 #include <linux/a.out.h>
 #include <linux/interrupt.h>
+#include <linux/hrtimer.h>
 #include <linux/delay.h>
 #include <linux/ptrace.h>
 #include <linux/utsname.h>
@@ -201,9 +202,11 @@ void cpu_idle (void)
 				idle = default_idle;
 			if (cpu_is_offline(smp_processor_id()))
 				play_dead();
+			hrtimer_stop_sched_tick();
 			idle();
 		}
 
+		hrtimer_restart_sched_tick();
 		schedule();
 	}
 }
@@ -9,6 +9,7 @@
 #include <linux/highmem.h>
 #include <linux/module.h>
 #include <linux/slab.h>
+#include <linux/vmalloc.h>
 #include <asm/uaccess.h>
 #include <asm/processor.h>
 #include <asm/tlbflush.h>
@@ -185,6 +186,9 @@ int change_page_attr_addr(unsigned long address, int numpages, pgprot_t prot)
 	int err = 0; 
 	int i; 
 
+	/* No lazily unmapped vmap alias may keep the old attributes */
+	vm_unmap_aliases();
+
 	down_write(&init_mm.mmap_sem);
 	for (i = 0; i < numpages; i++, address += PAGE_SIZE) {
 		unsigned long pfn = __pa(address) >> PAGE_SHIFT;
@@ -96,7 +96,7 @@ static ssize_t node_read_numastat(struct sys_device * dev, char * buf)
 {
 	unsigned long numa_hit, numa_miss, interleave_hit, numa_foreign;
 	unsigned long local_node, other_node;
-	int i, cpu;
+	int i, cpu, n;
 	pg_data_t *pg = NODE_DATA(dev->id);
 	numa_hit = 0;
 	numa_miss = 0;
@@ -116,7 +116,7 @@ static ssize_t node_read_numastat(struct sys_device * dev, char * buf)
 			other_node += ps->other_node;
 		}
 	}
-	return sprintf(buf,
+	n = sprintf(buf,
 		       "numa_hit %lu\n"
 		       "numa_miss %lu\n"
 		       "numa_foreign %lu\n"
@@ -129,6 +129,22 @@ static ssize_t node_read_numastat(struct sys_device * dev, char * buf)
 		       interleave_hit,
 		       local_node,
 		       other_node);
+#ifdef CONFIG_NUMA_BALANCING
+	{
+		/* Counted by the cpus of the node, i.e. where the task ran */
+		struct page_state ps;
+
+		get_full_page_state_node(&ps, dev->id);
+		n += sprintf(buf + n,
+			     "numa_hint_faults %lu\n"
+			     "numa_hint_faults_local %lu\n"
+			     "numa_pages_migrated %lu\n",
+			     ps.numa_hint_faults,
+			     ps.numa_hint_faults_local,
+			     ps.numa_pages_migrated);
+	}
+#endif
+	return n;
 }
 static SYSDEV_ATTR(numastat, S_IRUGO, node_read_numastat, NULL);
 
@@ -1626,6 +1626,8 @@ void blk_cleanup_queue(request_queue_t * q)
 
 	blk_queue_ordered(q, QUEUE_ORDERED_NONE);
 
+	bdi_stop_flusher(&q->backing_dev_info);
+
 	kmem_cache_free(requestq_cachep, q);
 }
 
@@ -3589,6 +3591,29 @@ static ssize_t queue_max_hw_sectors_show(struct request_queue *q, char *page)
 	return queue_var_show(max_hw_sectors_kb, (page));
 }
 
+static ssize_t queue_dirty_show(struct request_queue *q, char *page)
+{
+	unsigned long dirty_kb = bdi_stat(&q->backing_dev_info,
+				BDI_RECLAIMABLE) << (PAGE_CACHE_SHIFT - 10);
+
+	return queue_var_show(dirty_kb, (page));
+}
+
+static ssize_t queue_writeback_show(struct request_queue *q, char *page)
+{
+	unsigned long writeback_kb = bdi_stat(&q->backing_dev_info,
+				BDI_WRITEBACK) << (PAGE_CACHE_SHIFT - 10);
+
+	return queue_var_show(writeback_kb, (page));
+}
+
+static ssize_t queue_dirty_limit_show(struct request_queue *q, char *page)
+{
+	unsigned long dirty_limit_kb = bdi_dirty_limit(&q->backing_dev_info)
+					<< (PAGE_CACHE_SHIFT - 10);
+
+	return queue_var_show(dirty_limit_kb, (page));
+}
 
 static struct queue_sysfs_entry queue_requests_entry = {
 	.attr = {.name = "nr_requests", .mode = S_IRUGO | S_IWUSR },
@@ -3613,6 +3638,21 @@ static struct queue_sysfs_entry queue_max_hw_sectors_entry = {
 	.show = queue_max_hw_sectors_show,
 };
 
+static struct queue_sysfs_entry queue_dirty_entry = {
+	.attr = {.name = "dirty_kb", .mode = S_IRUGO },
+	.show = queue_dirty_show,
+};
+
+static struct queue_sysfs_entry queue_writeback_entry = {
+	.attr = {.name = "writeback_kb", .mode = S_IRUGO },
+	.show = queue_writeback_show,
+};
+
+static struct queue_sysfs_entry queue_dirty_limit_entry = {
+	.attr = {.name = "dirty_limit_kb", .mode = S_IRUGO },
+	.show = queue_dirty_limit_show,
+};
+
 static struct queue_sysfs_entry queue_iosched_entry = {
 	.attr = {.name = "scheduler", .mode = S_IRUGO | S_IWUSR },
 	.show = elv_iosched_show,
@@ -3624,6 +3664,9 @@ static struct attribute *default_attrs[] = {
 	&queue_ra_entry.attr,
 	&queue_max_hw_sectors_entry.attr,
 	&queue_max_sectors_entry.attr,
+	&queue_dirty_entry.attr,
+	&queue_writeback_entry.attr,
+	&queue_dirty_limit_entry.attr,
 	&queue_iosched_entry.attr,
 	NULL,
 };
@@ -58,7 +58,7 @@ void cache_readahead(struct address_space *mapping, int index)
 
 	end_index = ((isize - 1) >> PAGE_CACHE_SHIFT);
 
-	read_lock_irq(&mapping->tree_lock);
+	rcu_read_lock();
 	for (i = 0; i < PAGE_READAHEAD; i++) {
 		pagei = index + i;
 		if (pagei > end_index) {
@@ -66,20 +66,22 @@ void cache_readahead(struct address_space *mapping, int index)
 			break;
 		}
 		page = radix_tree_lookup(&mapping->page_tree, pagei);
+		if (page && radix_tree_exceptional_entry(page))
+			page = NULL;
 		if (page && (!i))
 			break;
 		if (page)
 			continue;
-		read_unlock_irq(&mapping->tree_lock);
+		rcu_read_unlock();
 		page = page_cache_alloc_cold(mapping);
-		read_lock_irq(&mapping->tree_lock);
+		rcu_read_lock();
 		if (!page)
 			break;
 		page->index = pagei;
 		list_add(&page->lru, &page_pool);
 		ret++;
 	}
-	read_unlock_irq(&mapping->tree_lock);
+	rcu_read_unlock();
 	if (ret)
 		read_cache_pages(mapping, &page_pool, filler, NULL);
 }
@@ -55,13 +55,22 @@ static kmem_cache_t *dentry_cache;
  *
  * This hash-function tries to avoid losing too many bits of hash
  * information, yet avoid using a prime hash-size or similar.
+ *
+ * Each chain has its own lock which serializes additions and removals
+ * on that chain; readers walk the chains under RCU.  The chain lock nests
+ * inside dentry->d_lock, and no more than one chain lock is ever held.
  */
 #define D_HASHBITS     d_hash_shift
 #define D_HASHMASK     d_hash_mask
 
+struct dcache_hash_bucket {
+	struct hlist_head head;
+	spinlock_t lock;
+};
+
 static unsigned int d_hash_mask;
 static unsigned int d_hash_shift;
-static struct hlist_head *dentry_hashtable;
+static struct dcache_hash_bucket *dentry_hashtable;
 static LIST_HEAD(dentry_unused);
 
 /* Statistics gathering. */
@@ -98,7 +107,9 @@ static inline void dentry_iput(struct dentry * dentry)
 {
 	struct inode *inode = dentry->d_inode;
 	if (inode) {
+		write_seqcount_begin(&dentry->d_seq);
 		dentry->d_inode = NULL;
+		write_seqcount_end(&dentry->d_seq);
 		list_del_init(&dentry->d_alias);
 		spin_unlock(&dentry->d_lock);
 		spin_unlock(&dcache_lock);
@@ -737,6 +748,7 @@ struct dentry *d_alloc(struct dentry * parent, const struct qstr *name)
 	atomic_set(&dentry->d_count, 1);
 	dentry->d_flags = DCACHE_UNHASHED;
 	spin_lock_init(&dentry->d_lock);
+	seqcount_init(&dentry->d_seq);
 	dentry->d_inode = NULL;
 	dentry->d_parent = NULL;
 	dentry->d_sb = NULL;
@@ -875,8 +887,8 @@ struct dentry * d_alloc_root(struct inode * root_inode)
 	return res;
 }
 
-static inline struct hlist_head *d_hash(struct dentry *parent,
-					unsigned long hash)
+static inline struct dcache_hash_bucket *d_hash(struct dentry *parent,
+						unsigned long hash)
 {
 	hash += ((unsigned long) parent ^ GOLDEN_RATIO_PRIME) / L1_CACHE_BYTES;
 	hash = hash ^ ((hash ^ GOLDEN_RATIO_PRIME) >> D_HASHBITS);
@@ -1040,13 +1052,13 @@ struct dentry * __d_lookup(struct dentry * parent, struct qstr * name)
 	unsigned int len = name->len;
 	unsigned int hash = name->hash;
 	const unsigned char *str = name->name;
-	struct hlist_head *head = d_hash(parent,hash);
+	struct dcache_hash_bucket *b = d_hash(parent,hash);
 	struct dentry *found = NULL;
 	struct hlist_node *node;
 
 	rcu_read_lock();
 	
-	hlist_for_each_rcu(node, head) {
+	hlist_for_each_rcu(node, &b->head) {
 		struct dentry *dentry; 
 		struct qstr *qstr;
 
@@ -1096,6 +1108,62 @@ next:
  	return found;
 }
 
+/**
+ * __d_lookup_rcu - lockless, reference-less dcache lookup
+ * @parent: parent dentry
+ * @name: qstr of name we wish to find
+ * @seqp: returns the d_seq value the dentry was found with
+ *
+ * Like __d_lookup, but takes neither d_lock nor a reference on the dentry
+ * it finds.  The caller must hold rcu_read_lock(), must have checked that
+ * @parent has no ->d_compare, and must validate the returned dentry with
+ * read_seqcount_retry(&dentry->d_seq, *seqp) before trusting anything it
+ * read from it.
+ *
+ * d_name.len and d_name.name may be sampled from both sides of a
+ * concurrent d_move(); the memcmp() can then look at the wrong buffer, but
+ * the names are only freed after an RCU grace period and the d_seq check
+ * throws the result away.
+ */
+struct dentry * __d_lookup_rcu(struct dentry * parent, struct qstr * name,
+			       unsigned *seqp)
+{
+	unsigned int len = name->len;
+	unsigned int hash = name->hash;
+	const unsigned char *str = name->name;
+	struct dcache_hash_bucket *b = d_hash(parent,hash);
+	struct hlist_node *node;
+
+	hlist_for_each_rcu(node, &b->head) {
+		struct dentry *dentry;
+		unsigned seq;
+
+		dentry = hlist_entry(node, struct dentry, d_hash);
+
+		seq = read_seqcount_begin(&dentry->d_seq);
+		if (dentry->d_parent != parent)
+			continue;
+		if (d_unhashed(dentry))
+			continue;
+		if (dentry->d_name.hash != hash)
+			continue;
+		if (dentry->d_name.len != len)
+			continue;
+		if (memcmp(dentry->d_name.name, str, len))
+			continue;
+		/*
+		 * A rename in flight may have moved the dentry we are
+		 * really after to another chain: report a miss and let
+		 * the caller fall back to the locked lookup.
+		 */
+		if (read_seqcount_retry(&dentry->d_seq, seq))
+			break;
+		*seqp = seq;
+		return dentry;
+	}
+	return NULL;
+}
+
 /**
  * d_validate - verify dentry provided from insecure source
  * @dentry: The dentry alleged to be valid child of @dparent
@@ -1110,7 +1178,7 @@ next:
  
 int d_validate(struct dentry *dentry, struct dentry *dparent)
 {
-	struct hlist_head *base;
+	struct dcache_hash_bucket *b;
 	struct hlist_node *lhp;
 
 	/* Check whether the ptr might be valid at all.. */
@@ -1121,17 +1189,20 @@ int d_validate(struct dentry *dentry, struct dentry *dparent)
 		goto out;
 
 	spin_lock(&dcache_lock);
-	base = d_hash(dparent, dentry->d_name.hash);
-	hlist_for_each(lhp,base) { 
+	b = d_hash(dparent, dentry->d_name.hash);
+	spin_lock(&b->lock);
+	hlist_for_each(lhp, &b->head) {
 		/* hlist_for_each_rcu() not required for d_hash list
-		 * as it is parsed under dcache_lock
+		 * as it is parsed under the chain lock
 		 */
 		if (dentry == hlist_entry(lhp, struct dentry, d_hash)) {
+			spin_unlock(&b->lock);
 			__dget_locked(dentry);
 			spin_unlock(&dcache_lock);
 			return 1;
 		}
 	}
+	spin_unlock(&b->lock);
 	spin_unlock(&dcache_lock);
 out:
 	return 0;
@@ -1182,29 +1253,50 @@ void d_delete(struct dentry * dentry)
 	fsnotify_nameremove(dentry, isdir);
 }
 
-static void __d_rehash(struct dentry * entry, struct hlist_head *list)
+/*
+ * __d_drop - unhash a dentry, see d_drop() in <linux/dcache.h>.
+ *
+ * The caller holds dentry->d_lock.  Hashed dentries always sit on the
+ * chain for their current parent and name, so that chain's lock is the
+ * one protecting the unlink.  Anonymous dentries hang off sb->s_anon
+ * instead, which is still serialized by dcache_lock.
+ */
+void __d_drop(struct dentry *dentry)
 {
+	if (!(dentry->d_flags & DCACHE_UNHASHED)) {
+		struct dcache_hash_bucket *b;
+
+		b = d_hash(dentry->d_parent, dentry->d_name.hash);
+		spin_lock(&b->lock);
+		dentry->d_flags |= DCACHE_UNHASHED;
+		hlist_del_rcu(&dentry->d_hash);
+		spin_unlock(&b->lock);
+		write_seqcount_begin(&dentry->d_seq);
+		write_seqcount_end(&dentry->d_seq);
+	}
+}
 
+static void __d_rehash(struct dentry * entry, struct dcache_hash_bucket *b)
+{
+	spin_lock(&b->lock);
  	entry->d_flags &= ~DCACHE_UNHASHED;
- 	hlist_add_head_rcu(&entry->d_hash, list);
+ 	hlist_add_head_rcu(&entry->d_hash, &b->head);
+	spin_unlock(&b->lock);
 }
 
 /**
  * d_rehash	- add an entry back to the hash
  * @entry: dentry to add to the hash
  *
- * Adds a dentry to the hash according to its name.
+ * Adds a dentry to the hash according to its name.  Only the dentry
+ * and the hash chain are locked, so no dcache_lock is needed here.
  */
  
 void d_rehash(struct dentry * entry)
 {
-	struct hlist_head *list = d_hash(entry->d_parent, entry->d_name.hash);
-
-	spin_lock(&dcache_lock);
 	spin_lock(&entry->d_lock);
-	__d_rehash(entry, list);
+	__d_rehash(entry, d_hash(entry->d_parent, entry->d_name.hash));
 	spin_unlock(&entry->d_lock);
-	spin_unlock(&dcache_lock);
 }
 
 #define do_switch(x,y) do { \
@@ -1281,7 +1373,7 @@ static void switch_names(struct dentry *dentry, struct dentry *target)
 
 void d_move(struct dentry * dentry, struct dentry * target)
 {
-	struct hlist_head *list;
+	struct dcache_hash_bucket *b;
 
 	if (!dentry->d_inode)
 		printk(KERN_WARNING "VFS: moving negative dcache entry\n");
@@ -1299,18 +1391,23 @@ void d_move(struct dentry * dentry, struct dentry * target)
 		spin_lock(&target->d_lock);
 	}
 
+	write_seqcount_begin(&dentry->d_seq);
+
 	/* Move the dentry to the target hash queue, if on different bucket */
 	if (dentry->d_flags & DCACHE_UNHASHED)
 		goto already_unhashed;
 
+	b = d_hash(dentry->d_parent, dentry->d_name.hash);
+	spin_lock(&b->lock);
 	hlist_del_rcu(&dentry->d_hash);
+	spin_unlock(&b->lock);
 
 already_unhashed:
-	list = d_hash(target->d_parent, target->d_name.hash);
-	__d_rehash(dentry, list);
+	__d_rehash(dentry, d_hash(target->d_parent, target->d_name.hash));
 
 	/* Unhash the target: dput() will then get rid of it */
 	__d_drop(target);
+	write_seqcount_begin(&target->d_seq);
 
 	list_del(&dentry->d_child);
 	list_del(&target->d_child);
@@ -1333,6 +1430,8 @@ already_unhashed:
 	}
 
 	list_add(&dentry->d_child, &dentry->d_parent->d_subdirs);
+	write_seqcount_end(&target->d_seq);
+	write_seqcount_end(&dentry->d_seq);
 	spin_unlock(&target->d_lock);
 	spin_unlock(&dentry->d_lock);
 	write_sequnlock(&rename_lock);
@@ -1653,7 +1752,7 @@ static void __init dcache_init_early(void)
 
 	dentry_hashtable =
 		alloc_large_system_hash("Dentry cache",
-					sizeof(struct hlist_head),
+					sizeof(struct dcache_hash_bucket),
 					dhash_entries,
 					13,
 					HASH_EARLY,
@@ -1661,8 +1760,10 @@ static void __init dcache_init_early(void)
 					&d_hash_mask,
 					0);
 
-	for (loop = 0; loop < (1 << d_hash_shift); loop++)
-		INIT_HLIST_HEAD(&dentry_hashtable[loop]);
+	for (loop = 0; loop < (1 << d_hash_shift); loop++) {
+		INIT_HLIST_HEAD(&dentry_hashtable[loop].head);
+		spin_lock_init(&dentry_hashtable[loop].lock);
+	}
 }
 
 static void __init dcache_init(unsigned long mempages)
@@ -1688,7 +1789,7 @@ static void __init dcache_init(unsigned long mempages)
 
 	dentry_hashtable =
 		alloc_large_system_hash("Dentry cache",
-					sizeof(struct hlist_head),
+					sizeof(struct dcache_hash_bucket),
 					dhash_entries,
 					13,
 					0,
@@ -1696,8 +1797,10 @@ static void __init dcache_init(unsigned long mempages)
 					&d_hash_mask,
 					0);
 
-	for (loop = 0; loop < (1 << d_hash_shift); loop++)
-		INIT_HLIST_HEAD(&dentry_hashtable[loop]);
+	for (loop = 0; loop < (1 << d_hash_shift); loop++) {
+		INIT_HLIST_HEAD(&dentry_hashtable[loop].head);
+		spin_lock_init(&dentry_hashtable[loop].lock);
+	}
 }
 
 /* SLAB cache for __getname() consumers */
@@ -1741,6 +1844,7 @@ void __init vfs_caches_init(unsigned long mempages)
 	chrdev_init();
 }
 
+EXPORT_SYMBOL(__d_drop);
 EXPORT_SYMBOL(d_alloc);
 EXPORT_SYMBOL(d_alloc_anon);
 EXPORT_SYMBOL(d_alloc_root);
@@ -18,6 +18,7 @@
 #include <linux/mount.h>
 #include <linux/cdev.h>
 #include <linux/fsnotify.h>
+#include <linux/percpu.h>
 
 /* sysctl tunables... */
 struct files_stat_struct files_stat = {
@@ -29,6 +30,16 @@ EXPORT_SYMBOL(files_stat); /* Needed by unix.o */
 /* public. Not pretty! */
  __cacheline_aligned_in_smp DEFINE_SPINLOCK(files_lock);
 
+/*
+ * The per-superblock s_files lists are split into one list per CPU, each
+ * protected by that CPU's sb_files_lock, so opening and closing files on
+ * different CPUs never touches a shared lock.  A file remembers the list
+ * it went on in f_sb_list_cpu.  The rare walkers of an s_files list take
+ * every CPU's lock with file_list_lock_all().  files_lock itself only
+ * protects the tty_files lists now.
+ */
+static DEFINE_PER_CPU(spinlock_t, sb_files_lock) = SPIN_LOCK_UNLOCKED;
+
 static DEFINE_SPINLOCK(filp_count_lock);
 
 /* slab constructors and destructors are called from arbitrary
@@ -96,6 +107,7 @@ struct file *get_empty_filp(void)
 	rwlock_init(&f->f_owner.lock);
 	/* f->f_version: 0 */
 	INIT_LIST_HEAD(&f->f_list);
+	f->f_sb_list_cpu = -1;
 	return f;
 
 over:
@@ -220,10 +232,60 @@ void put_filp(struct file *file)
 	}
 }
 
+void file_list_lock_all(void)
+{
+	int i;
+
+	/*
+	 * Take the raw locks so that nesting one per possible CPU does
+	 * not overflow the preempt count.
+	 */
+	preempt_disable();
+	for_each_cpu(i)
+		_raw_spin_lock(&per_cpu(sb_files_lock, i));
+}
+
+void file_list_unlock_all(void)
+{
+	int i;
+
+	for_each_cpu(i)
+		_raw_spin_unlock(&per_cpu(sb_files_lock, i));
+	preempt_enable();
+}
+
+void file_sb_list_add(struct file *file, struct super_block *sb)
+{
+	int cpu = get_cpu();
+	spinlock_t *lock = &per_cpu(sb_files_lock, cpu);
+
+	spin_lock(lock);
+	file->f_sb_list_cpu = cpu;
+	list_add(&file->f_list, per_cpu_ptr(sb->s_files, cpu));
+	spin_unlock(lock);
+	put_cpu();
+}
+
+static void file_sb_list_del(struct file *file)
+{
+	spinlock_t *lock = &per_cpu(sb_files_lock, file->f_sb_list_cpu);
+
+	spin_lock(lock);
+	list_del_init(&file->f_list);
+	file->f_sb_list_cpu = -1;
+	spin_unlock(lock);
+}
+
+/*
+ * Move a file off its superblock list onto a private list protected by
+ * files_lock (the tty driver's tty_files).
+ */
 void file_move(struct file *file, struct list_head *list)
 {
 	if (!list)
 		return;
+	if (file->f_sb_list_cpu >= 0)
+		file_sb_list_del(file);
 	file_list_lock();
 	list_move(&file->f_list, list);
 	file_list_unlock();
@@ -231,7 +293,9 @@ void file_move(struct file *file, struct list_head *list)
 
 void file_kill(struct file *file)
 {
-	if (!list_empty(&file->f_list)) {
+	if (file->f_sb_list_cpu >= 0) {
+		file_sb_list_del(file);
+	} else if (!list_empty(&file->f_list)) {
 		file_list_lock();
 		list_del_init(&file->f_list);
 		file_list_unlock();
@@ -240,12 +304,11 @@ void file_kill(struct file *file)
 
 int fs_may_remount_ro(struct super_block *sb)
 {
-	struct list_head *p;
+	struct file *file;
 
 	/* Check that no files are currently opened for writing. */
-	file_list_lock();
-	list_for_each(p, &sb->s_files) {
-		struct file *file = list_entry(p, struct file, f_list);
+	file_list_lock_all();
+	do_file_list_for_each_entry(sb, file) {
 		struct inode *inode = file->f_dentry->d_inode;
 
 		/* File with pending delete? */
@@ -255,11 +318,11 @@ int fs_may_remount_ro(struct super_block *sb)
 		/* Writeable file? */
 		if (S_ISREG(inode->i_mode) && (file->f_mode & FMODE_WRITE))
 			goto too_bad;
-	}
-	file_list_unlock();
+	} while_file_list_for_each_entry;
+	file_list_unlock_all();
 	return 1; /* Tis' cool bro. */
 too_bad:
-	file_list_unlock();
+	file_list_unlock_all();
 	return 0;
 }
 
@@ -125,6 +125,7 @@ void __mark_inode_dirty(struct inode *inode, int flags)
 		if (!was_dirty) {
 			inode->dirtied_when = jiffies;
 			list_move(&inode->i_list, &sb->s_dirty);
+			bdi_start_flusher(inode->i_mapping->backing_dev_info);
 		}
 	}
 out:
@@ -220,18 +221,19 @@ __sync_single_inode(struct inode *inode, struct writeback_control *wbc)
 			 * the pages.
 			 */
 			list_move(&inode->i_list, &sb->s_dirty);
-		} else if (atomic_read(&inode->i_count)) {
-			/*
-			 * The inode is clean, inuse
-			 */
-			list_move(&inode->i_list, &inode_in_use);
 		} else {
 			/*
-			 * The inode is clean, unused
+			 * The inode is clean.  If it is unused it is on
+			 * the LRU already, iput_final() put it there.
 			 */
-			list_move(&inode->i_list, &inode_unused);
-			inodes_stat.nr_unused++;
+			list_move(&inode->i_list, &inode_in_use);
 		}
+		/*
+		 * An inode redirtied while I_LOCK was held went onto
+		 * s_dirty here rather than in __mark_inode_dirty.
+		 */
+		if (inode->i_state & I_DIRTY)
+			bdi_start_flusher(mapping->backing_dev_info);
 	}
 	wake_up_inode(inode);
 	return ret;
@@ -443,6 +445,34 @@ restart:
 	spin_unlock(&sb_lock);
 }
 
+static int dirty_list_has_bdi(struct list_head *head,
+				struct backing_dev_info *bdi)
+{
+	struct inode *inode;
+
+	list_for_each_entry(inode, head, i_list) {
+		if (inode->i_mapping->backing_dev_info == bdi)
+			return 1;
+	}
+	return 0;
+}
+
+/*
+ * Is any inode backed by `bdi' dirty?  The flusher thread of the device
+ * asks before it exits.  Called under sb_lock and inode_lock.
+ */
+int bdi_has_dirty_inodes(struct backing_dev_info *bdi)
+{
+	struct super_block *sb;
+
+	list_for_each_entry(sb, &super_blocks, s_list) {
+		if (dirty_list_has_bdi(&sb->s_dirty, bdi) ||
+				dirty_list_has_bdi(&sb->s_io, bdi))
+			return 1;
+	}
+	return 0;
+}
+
 /*
  * writeback and wait upon the filesystem's dirty inodes.  The caller will
  * do this in two passes - one to write, and one to wait.  WB_SYNC_HOLD is
@@ -463,7 +493,7 @@ void sync_inodes_sb(struct super_block *sb, int wait)
 	unsigned long nr_unstable = read_page_state(nr_unstable);
 
 	wbc.nr_to_write = nr_dirty + nr_unstable +
-			(inodes_stat.nr_inodes - inodes_stat.nr_unused) +
+			(inodes_stat.nr_inodes - get_nr_inodes_unused()) +
 			nr_dirty + nr_unstable;
 	wbc.nr_to_write += wbc.nr_to_write / 2;		/* Bit more for luck */
 	spin_lock(&inode_lock);
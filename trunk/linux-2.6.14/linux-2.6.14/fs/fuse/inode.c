@@ -197,6 +197,7 @@ static void fuse_put_super(struct super_block *sb)
 {
 	struct fuse_conn *fc = get_fuse_conn_super(sb);
 
+	bdi_stop_flusher(&fc->bdi);
 	down_write(&fc->sbput_sem);
 	while (!list_empty(&fc->background))
 		fuse_release_background(list_entry(fc->background.next,
@@ -226,10 +226,14 @@ static void hugetlbfs_delete_inode(struct inode *inode)
 {
 	struct hugetlbfs_sb_info *sbinfo = HUGETLBFS_SB(inode->i_sb);
 
-	hlist_del_init(&inode->i_hash);
+	if (!inode_set_freeing(inode, I_FREEING)) {
+		spin_unlock(&inode_lock);
+		return;
+	}
+	inode_lru_del(inode);
+	remove_inode_hash(inode);
 	list_del_init(&inode->i_list);
-	list_del_init(&inode->i_sb_list);
-	inode->i_state |= I_FREEING;
+	inode_sb_list_del(inode);
 	inodes_stat.nr_inodes--;
 	spin_unlock(&inode_lock);
 
@@ -253,26 +257,22 @@ static void hugetlbfs_forget_inode(struct inode *inode)
 	struct super_block *super_block = inode->i_sb;
 	struct hugetlbfs_sb_info *sbinfo = HUGETLBFS_SB(super_block);
 
-	if (hlist_unhashed(&inode->i_hash))
-		goto out_truncate;
-
-	if (!(inode->i_state & (I_DIRTY|I_LOCK))) {
-		list_del(&inode->i_list);
-		list_add(&inode->i_list, &inode_unused);
-	}
-	inodes_stat.nr_unused++;
-	if (!super_block || (super_block->s_flags & MS_ACTIVE)) {
+	if (!hlist_unhashed(&inode->i_hash) &&
+	    (!super_block || (super_block->s_flags & MS_ACTIVE))) {
+		inode_lru_add(inode);
 		spin_unlock(&inode_lock);
 		return;
 	}
 
 	/* write_inode_now() ? */
-	inodes_stat.nr_unused--;
-	hlist_del_init(&inode->i_hash);
-out_truncate:
+	if (!inode_set_freeing(inode, I_FREEING)) {
+		spin_unlock(&inode_lock);
+		return;
+	}
+	inode_lru_del(inode);
+	remove_inode_hash(inode);
 	list_del_init(&inode->i_list);
-	list_del_init(&inode->i_sb_list);
-	inode->i_state |= I_FREEING;
+	inode_sb_list_del(inode);
 	inodes_stat.nr_inodes--;
 	spin_unlock(&inode_lock);
 	if (inode->i_data.nrpages)
@@ -22,6 +22,9 @@
 #include <linux/cdev.h>
 #include <linux/bootmem.h>
 #include <linux/inotify.h>
+#include <linux/seq_file.h>
+#include <linux/percpu.h>
+#include <linux/sysctl.h>
 
 /*
  * This is needed for the following functions:
@@ -59,28 +62,59 @@ static unsigned int i_hash_mask;
 static unsigned int i_hash_shift;
 
 /*
- * Each inode can be on two separate lists. One is
+ * Each inode can be on four separate lists. One is
  * the hash list of the inode, used for lookups. The
- * other linked list is the "type" list:
- *  "in_use" - valid inode, i_count > 0, i_nlink > 0
+ * second is the "type" list:
+ *  "in_use" - valid, clean inode
  *  "dirty"  - as "in_use" but also dirty
- *  "unused" - valid inode, i_count = 0
+ * The third is the per-superblock list of all inodes,
+ * and the last is the LRU of inodes whose i_count has
+ * dropped to zero, which prune_icache() reclaims from.
  *
  * A "dirty" list is maintained for each super block,
  * allowing for low-overhead inode sync() operations.
  */
 
 LIST_HEAD(inode_in_use);
-LIST_HEAD(inode_unused);
-static struct hlist_head *inode_hashtable;
+static LIST_HEAD(inode_lru);
 
 /*
- * A simple spinlock to protect the list manipulations.
+ * Each hash chain has its own lock, so that iget() of a cached
+ * inode never has to touch inode_lock.
+ */
+struct inode_hash_bucket {
+	struct hlist_head head;
+	spinlock_t lock;
+};
+
+static struct inode_hash_bucket *inode_hashtable;
+
+/*
+ * A simple spinlock to protect the type list manipulations.
  *
  * NOTE! You also have to own the lock if you change
  * the i_state of an inode while it is in use..
+ *
+ * Lock ordering:
+ *	inode_lock
+ *	  inode_lru_lock
+ *	    inode_hash_bucket->lock
+ *	  super_block->s_inode_list_lock
+ *
+ * The hash chain lock alone is enough to find an inode and take a
+ * reference to it.  Whoever decides to free an unreferenced hashed
+ * inode must therefore recheck i_count and set I_FREEING (or
+ * I_WILL_FREE) under the chain lock too, see inode_set_freeing().
+ *
+ * The LRU is maintained lazily: taking a reference does not remove an
+ * inode from it, prune_icache() culls referenced inodes in batches as
+ * it scans.  inode_lru_nr counts the LRU and is protected by
+ * inode_lru_lock.  Since the LRU may hold referenced inodes, its length
+ * says little about how many inodes are unused; that is counted apart
+ * in inodes_unused as i_count goes to and from zero.
  */
 DEFINE_SPINLOCK(inode_lock);
+static DEFINE_SPINLOCK(inode_lru_lock);
 
 /*
  * iprune_sem provides exclusion between the kswapd or try_to_free_pages
@@ -97,8 +131,227 @@ DECLARE_MUTEX(iprune_sem);
  */
 struct inodes_stat_t inodes_stat;
 
+static int inode_lru_nr;
+
+/*
+ * Inodes whose i_count has dropped to zero and which nobody has claimed
+ * for freeing yet.  Raised by iput() on the last reference, lowered by
+ * __iget() picking an inode up from zero and by inode_set_freeing().
+ * __iget() may run under a hash chain lock alone, hence the atomic.
+ */
+static atomic_t inodes_unused = ATOMIC_INIT(0);
+
+/*
+ * The iput() that dropped i_count to zero raises inodes_unused only once
+ * it has inode_lock, so a racing __iget() can briefly take it below zero.
+ */
+int get_nr_inodes_unused(void)
+{
+	int nr = atomic_read(&inodes_unused);
+
+	return nr < 0 ? 0 : nr;
+}
+
+/*
+ * sysctl handler for /proc/sys/fs/inode-nr and inode-state
+ */
+int proc_nr_inodes(ctl_table *table, int write, struct file *filp,
+		   void __user *buffer, size_t *lenp, loff_t *ppos)
+{
+	inodes_stat.nr_unused = get_nr_inodes_unused();
+	return proc_dointvec(table, write, filp, buffer, lenp, ppos);
+}
+
 static kmem_cache_t * inode_cachep;
 
+#ifdef CONFIG_INODE_LOCK_STAT
+/*
+ * Hold and wait times of the inode cache locks, per lock class, summed
+ * over all cpus in /proc/inode_lock_stat.  The locks are spinlocks, so
+ * the cpu that took one also releases it, and none of the classes nest
+ * within themselves: one timestamp per class per cpu is enough.
+ */
+enum inode_lock_class {
+	ILOCK_HASH,
+	ILOCK_SB_LIST,
+	ILOCK_LRU,
+	NR_ILOCK_CLASSES
+};
+
+static const char *inode_lock_names[NR_ILOCK_CLASSES] = {
+	"hash", "sb_list", "lru",
+};
+
+struct inode_lock_stat {
+	unsigned long acquired;
+	unsigned long contended;
+	unsigned long long wait_ns;
+	unsigned long long hold_ns;
+};
+
+struct inode_lock_stats {
+	struct inode_lock_stat stat[NR_ILOCK_CLASSES];
+	unsigned long long since[NR_ILOCK_CLASSES];
+};
+
+static DEFINE_PER_CPU(struct inode_lock_stats, inode_lock_stats);
+
+static void ilock(spinlock_t *lock, enum inode_lock_class class)
+{
+	struct inode_lock_stats *st;
+	unsigned long long now;
+
+	if (spin_trylock(lock)) {
+		st = &__get_cpu_var(inode_lock_stats);
+		now = sched_clock();
+	} else {
+		unsigned long long start = sched_clock();
+
+		spin_lock(lock);
+		st = &__get_cpu_var(inode_lock_stats);
+		now = sched_clock();
+		st->stat[class].contended++;
+		st->stat[class].wait_ns += now - start;
+	}
+	st->stat[class].acquired++;
+	st->since[class] = now;
+}
+
+static void iunlock(spinlock_t *lock, enum inode_lock_class class)
+{
+	struct inode_lock_stats *st = &__get_cpu_var(inode_lock_stats);
+
+	st->stat[class].hold_ns += sched_clock() - st->since[class];
+	spin_unlock(lock);
+}
+
+static void *ilock_stat_start(struct seq_file *m, loff_t *pos)
+{
+	if (*pos == 0)
+		seq_printf(m, "%-8s %12s %12s %16s %16s\n", "lock",
+			   "acquired", "contended", "wait_ns", "hold_ns");
+	return *pos < NR_ILOCK_CLASSES ? (void *)(unsigned long)(*pos + 1) : NULL;
+}
+
+static void *ilock_stat_next(struct seq_file *m, void *v, loff_t *pos)
+{
+	(*pos)++;
+	return *pos < NR_ILOCK_CLASSES ? (void *)(unsigned long)(*pos + 1) : NULL;
+}
+
+static void ilock_stat_stop(struct seq_file *m, void *v)
+{
+}
+
+static int ilock_stat_show(struct seq_file *m, void *v)
+{
+	int class = (unsigned long)v - 1;
+	struct inode_lock_stat sum;
+	int cpu;
+
+	memset(&sum, 0, sizeof(sum));
+	for_each_cpu(cpu) {
+		struct inode_lock_stat *st =
+			&per_cpu(inode_lock_stats, cpu).stat[class];
+
+		sum.acquired += st->acquired;
+		sum.contended += st->contended;
+		sum.wait_ns += st->wait_ns;
+		sum.hold_ns += st->hold_ns;
+	}
+	seq_printf(m, "%-8s %12lu %12lu %16llu %16llu\n",
+		   inode_lock_names[class], sum.acquired, sum.contended,
+		   sum.wait_ns, sum.hold_ns);
+	return 0;
+}
+
+struct seq_operations inode_lock_stat_op = {
+	.start	= ilock_stat_start,
+	.next	= ilock_stat_next,
+	.stop	= ilock_stat_stop,
+	.show	= ilock_stat_show,
+};
+#else
+#define ilock(lock, class)	spin_lock(lock)
+#define iunlock(lock, class)	spin_unlock(lock)
+#endif
+
+/*
+ * LRU of unreferenced inodes.  Called with inode_lock held, so that the
+ * inode can't be freed under us.
+ */
+void inode_lru_add(struct inode *inode)
+{
+	ilock(&inode_lru_lock, ILOCK_LRU);
+	if (list_empty(&inode->i_lru)) {
+		list_add(&inode->i_lru, &inode_lru);
+		inode_lru_nr++;
+	}
+	iunlock(&inode_lru_lock, ILOCK_LRU);
+}
+
+void inode_lru_del(struct inode *inode)
+{
+	ilock(&inode_lru_lock, ILOCK_LRU);
+	if (!list_empty(&inode->i_lru)) {
+		list_del_init(&inode->i_lru);
+		inode_lru_nr--;
+	}
+	iunlock(&inode_lru_lock, ILOCK_LRU);
+}
+
+/*
+ * Per-superblock list of all inodes.  Walkers take s_inode_list_lock,
+ * or hold both inode_lock and iprune_sem, which between them exclude
+ * every writer.
+ */
+void inode_sb_list_add(struct inode *inode)
+{
+	struct super_block *sb = inode->i_sb;
+
+	ilock(&sb->s_inode_list_lock, ILOCK_SB_LIST);
+	list_add(&inode->i_sb_list, &sb->s_inodes);
+	iunlock(&sb->s_inode_list_lock, ILOCK_SB_LIST);
+}
+
+void inode_sb_list_del(struct inode *inode)
+{
+	struct super_block *sb = inode->i_sb;
+
+	ilock(&sb->s_inode_list_lock, ILOCK_SB_LIST);
+	list_del_init(&inode->i_sb_list);
+	iunlock(&sb->s_inode_list_lock, ILOCK_SB_LIST);
+}
+
+/**
+ *	inode_set_freeing - claim an unreferenced inode for freeing
+ *	@inode: inode whose last reference has gone
+ *	@flag: I_FREEING or I_WILL_FREE
+ *
+ *	Called with inode_lock held.  Sets @flag in i_state unless a lookup
+ *	through the hash has taken a new reference in the meantime, in which
+ *	case 0 is returned and the inode must be left alone.  Setting
+ *	I_FREEING replaces an I_WILL_FREE set earlier by the same caller.
+ *	A claimed inode no longer counts as unused.
+ */
+int inode_set_freeing(struct inode *inode, unsigned long flag)
+{
+	struct inode_hash_bucket *b = inode->i_hash_bucket;
+	int ret;
+
+	if (b)
+		ilock(&b->lock, ILOCK_HASH);
+	ret = !atomic_read(&inode->i_count);
+	if (ret) {
+		if (!(inode->i_state & (I_FREEING|I_WILL_FREE)))
+			atomic_dec(&inodes_unused);
+		inode->i_state = (inode->i_state & ~I_WILL_FREE) | flag;
+	}
+	if (b)
+		iunlock(&b->lock, ILOCK_HASH);
+	return ret;
+}
+
 static struct inode *alloc_inode(struct super_block *sb)
 {
 	static struct address_space_operations empty_aops;
@@ -146,7 +399,7 @@ static struct inode *alloc_inode(struct super_block *sb)
 		mapping->a_ops = &empty_aops;
  		mapping->host = inode;
 		mapping->flags = 0;
-		mapping_set_gfp_mask(mapping, GFP_HIGHUSER);
+		mapping_set_gfp_mask(mapping, GFP_HIGHUSER_PAGECACHE);
 		mapping->assoc_mapping = NULL;
 		mapping->backing_dev_info = &default_backing_dev_info;
 
@@ -190,12 +443,13 @@ void inode_init_once(struct inode *inode)
 {
 	memset(inode, 0, sizeof(*inode));
 	INIT_HLIST_NODE(&inode->i_hash);
+	INIT_LIST_HEAD(&inode->i_lru);
 	INIT_LIST_HEAD(&inode->i_dentry);
 	INIT_LIST_HEAD(&inode->i_devices);
 	sema_init(&inode->i_sem, 1);
 	init_rwsem(&inode->i_alloc_sem);
 	INIT_RADIX_TREE(&inode->i_data.page_tree, GFP_ATOMIC);
-	rwlock_init(&inode->i_data.tree_lock);
+	spin_lock_init(&inode->i_data.tree_lock);
 	spin_lock_init(&inode->i_data.i_mmap_lock);
 	INIT_LIST_HEAD(&inode->i_data.private_list);
 	spin_lock_init(&inode->i_data.private_lock);
@@ -221,18 +475,15 @@ static void init_once(void * foo, kmem_cache_t * cachep, unsigned long flags)
 }
 
 /*
- * inode_lock must be held
+ * inode_lock or the inode's hash chain lock must be held, so that the
+ * inode can't be claimed for freeing under us.  An inode picked up
+ * from zero is left on the LRU for prune_icache() to cull, but stops
+ * counting as unused right away.
  */
 void __iget(struct inode * inode)
 {
-	if (atomic_read(&inode->i_count)) {
-		atomic_inc(&inode->i_count);
-		return;
-	}
-	atomic_inc(&inode->i_count);
-	if (!(inode->i_state & (I_DIRTY|I_LOCK)))
-		list_move(&inode->i_list, &inode_in_use);
-	inodes_stat.nr_unused--;
+	if (atomic_inc_return(&inode->i_count) == 1)
+		atomic_dec(&inodes_unused);
 }
 
 /**
@@ -284,14 +535,12 @@ static void dispose_list(struct list_head *head)
 		inode = list_entry(head->next, struct inode, i_list);
 		list_del(&inode->i_list);
 
-		if (inode->i_data.nrpages)
+		if (inode->i_data.nrpages || inode->i_data.nrshadows)
 			truncate_inode_pages(&inode->i_data, 0);
 		clear_inode(inode);
 
-		spin_lock(&inode_lock);
-		hlist_del_init(&inode->i_hash);
-		list_del_init(&inode->i_sb_list);
-		spin_unlock(&inode_lock);
+		remove_inode_hash(inode);
+		inode_sb_list_del(inode);
 
 		wake_up_inode(inode);
 		destroy_inode(inode);
@@ -308,7 +557,7 @@ static void dispose_list(struct list_head *head)
 static int invalidate_list(struct list_head *head, struct list_head *dispose)
 {
 	struct list_head *next;
-	int busy = 0, count = 0;
+	int busy = 0;
 
 	next = head->next;
 	for (;;) {
@@ -328,16 +577,16 @@ static int invalidate_list(struct list_head *head, struct list_head *dispose)
 			break;
 		inode = list_entry(tmp, struct inode, i_sb_list);
 		invalidate_inode_buffers(inode);
-		if (!atomic_read(&inode->i_count)) {
+		/* being freed by iput_final() already */
+		if (inode->i_state & (I_FREEING|I_CLEAR|I_WILL_FREE))
+			continue;
+		if (inode_set_freeing(inode, I_FREEING)) {
 			list_move(&inode->i_list, dispose);
-			inode->i_state |= I_FREEING;
-			count++;
+			inode_lru_del(inode);
 			continue;
 		}
 		busy = 1;
 	}
-	/* only unused inodes may be cached with i_count zero */
-	inodes_stat.nr_unused -= count;
 	return busy;
 }
 
@@ -403,12 +652,16 @@ static int can_unuse(struct inode *inode)
 }
 
 /*
- * Scan `goal' inodes on the unused list for freeable ones. They are moved to
+ * Scan `goal' inodes on the LRU for freeable ones. They are moved to
  * a temporary list and then are freed outside inode_lock by dispose_list().
  *
+ * Inodes which picked up a reference since they were put on the LRU are
+ * taken off it here, a whole scan's worth at a time, rather than by
+ * every iget().
+ *
  * Any inodes which are pinned purely because of attached pagecache have their
- * pagecache removed.  We expect the final iput() on that inode to add it to
- * the front of the inode_unused list.  So look for it there and if the
+ * pagecache removed.  They are rotated to the front of the LRU first, and the
+ * final iput() leaves them there.  So look for it there and if the
  * inode is still freeable, proceed.  The right inode is found 99.9% of the
  * time in testing on a 4-way.
  *
@@ -418,43 +671,53 @@ static int can_unuse(struct inode *inode)
 static void prune_icache(int nr_to_scan)
 {
 	LIST_HEAD(freeable);
-	int nr_pruned = 0;
 	int nr_scanned;
 	unsigned long reap = 0;
 
 	down(&iprune_sem);
 	spin_lock(&inode_lock);
+	ilock(&inode_lru_lock, ILOCK_LRU);
 	for (nr_scanned = 0; nr_scanned < nr_to_scan; nr_scanned++) {
 		struct inode *inode;
 
-		if (list_empty(&inode_unused))
+		if (list_empty(&inode_lru))
 			break;
 
-		inode = list_entry(inode_unused.prev, struct inode, i_list);
+		inode = list_entry(inode_lru.prev, struct inode, i_lru);
 
-		if (inode->i_state || atomic_read(&inode->i_count)) {
-			list_move(&inode->i_list, &inode_unused);
+		if (atomic_read(&inode->i_count)) {
+			list_del_init(&inode->i_lru);
+			inode_lru_nr--;
+			continue;
+		}
+		if (inode->i_state) {
+			list_move(&inode->i_lru, &inode_lru);
 			continue;
 		}
 		if (inode_has_buffers(inode) || inode->i_data.nrpages) {
 			__iget(inode);
+			list_move(&inode->i_lru, &inode_lru);
+			iunlock(&inode_lru_lock, ILOCK_LRU);
 			spin_unlock(&inode_lock);
 			if (remove_inode_buffers(inode))
 				reap += invalidate_inode_pages(&inode->i_data);
 			iput(inode);
 			spin_lock(&inode_lock);
+			ilock(&inode_lru_lock, ILOCK_LRU);
 
-			if (inode != list_entry(inode_unused.next,
-						struct inode, i_list))
+			if (inode != list_entry(inode_lru.next,
+						struct inode, i_lru))
 				continue;	/* wrong inode or list_empty */
 			if (!can_unuse(inode))
 				continue;
 		}
+		if (!inode_set_freeing(inode, I_FREEING))
+			continue;
+		list_del_init(&inode->i_lru);
+		inode_lru_nr--;
 		list_move(&inode->i_list, &freeable);
-		inode->i_state |= I_FREEING;
-		nr_pruned++;
 	}
-	inodes_stat.nr_unused -= nr_pruned;
+	iunlock(&inode_lru_lock, ILOCK_LRU);
 	spin_unlock(&inode_lock);
 
 	dispose_list(&freeable);
@@ -487,30 +750,31 @@ static int shrink_icache_memory(int nr, unsigned int gfp_mask)
 			return -1;
 		prune_icache(nr);
 	}
-	return (inodes_stat.nr_unused / 100) * sysctl_vfs_cache_pressure;
+	return (inode_lru_nr / 100) * sysctl_vfs_cache_pressure;
 }
 
-static void __wait_on_freeing_inode(struct inode *inode);
+static void __wait_on_freeing_inode(struct inode *inode,
+				    struct inode_hash_bucket *b);
 /*
- * Called with the inode lock held.
+ * Called with the hash chain lock held.
  * NOTE: we are not increasing the inode-refcount, you must call __iget()
  * by hand after calling find_inode now! This simplifies iunique and won't
  * add any additional branch in the common code.
  */
-static struct inode * find_inode(struct super_block * sb, struct hlist_head *head, int (*test)(struct inode *, void *), void *data)
+static struct inode * find_inode(struct super_block * sb, struct inode_hash_bucket *b, int (*test)(struct inode *, void *), void *data)
 {
 	struct hlist_node *node;
 	struct inode * inode = NULL;
 
 repeat:
-	hlist_for_each (node, head) { 
+	hlist_for_each (node, &b->head) { 
 		inode = hlist_entry(node, struct inode, i_hash);
 		if (inode->i_sb != sb)
 			continue;
 		if (!test(inode, data))
 			continue;
 		if (inode->i_state & (I_FREEING|I_CLEAR|I_WILL_FREE)) {
-			__wait_on_freeing_inode(inode);
+			__wait_on_freeing_inode(inode, b);
 			goto repeat;
 		}
 		break;
@@ -522,20 +786,20 @@ repeat:
  * find_inode_fast is the fast path version of find_inode, see the comment at
  * iget_locked for details.
  */
-static struct inode * find_inode_fast(struct super_block * sb, struct hlist_head *head, unsigned long ino)
+static struct inode * find_inode_fast(struct super_block * sb, struct inode_hash_bucket *b, unsigned long ino)
 {
 	struct hlist_node *node;
 	struct inode * inode = NULL;
 
 repeat:
-	hlist_for_each (node, head) {
+	hlist_for_each (node, &b->head) {
 		inode = hlist_entry(node, struct inode, i_hash);
 		if (inode->i_ino != ino)
 			continue;
 		if (inode->i_sb != sb)
 			continue;
 		if (inode->i_state & (I_FREEING|I_CLEAR|I_WILL_FREE)) {
-			__wait_on_freeing_inode(inode);
+			__wait_on_freeing_inode(inode, b);
 			goto repeat;
 		}
 		break;
@@ -543,6 +807,27 @@ repeat:
 	return node ? inode : NULL;
 }
 
+/*
+ * Called with the hash chain lock held.  The inode is not on the
+ * type or superblock lists yet; get_new_inode() puts it there after
+ * dropping the chain lock, it can't be freed before the caller
+ * has done unlock_new_inode() anyway.
+ */
+static void __inode_hash_add(struct inode *inode, struct inode_hash_bucket *b)
+{
+	hlist_add_head(&inode->i_hash, &b->head);
+	inode->i_hash_bucket = b;
+}
+
+static void inode_add_lists(struct inode *inode)
+{
+	spin_lock(&inode_lock);
+	inodes_stat.nr_inodes++;
+	list_add(&inode->i_list, &inode_in_use);
+	inode_sb_list_add(inode);
+	spin_unlock(&inode_lock);
+}
+
 /**
  *	new_inode 	- obtain an inode
  *	@sb: superblock
@@ -561,7 +846,7 @@ struct inode *new_inode(struct super_block *sb)
 		spin_lock(&inode_lock);
 		inodes_stat.nr_inodes++;
 		list_add(&inode->i_list, &inode_in_use);
-		list_add(&inode->i_sb_list, &sb->s_inodes);
+		inode_sb_list_add(inode);
 		inode->i_ino = ++last_ino;
 		inode->i_state = 0;
 		spin_unlock(&inode_lock);
@@ -593,7 +878,7 @@ EXPORT_SYMBOL(unlock_new_inode);
  * We no longer cache the sb_flags in i_flags - see fs.h
  *	-- rmk@arm.uk.linux.org
  */
-static struct inode * get_new_inode(struct super_block *sb, struct hlist_head *head, int (*test)(struct inode *, void *), int (*set)(struct inode *, void *), void *data)
+static struct inode * get_new_inode(struct super_block *sb, struct inode_hash_bucket *b, int (*test)(struct inode *, void *), int (*set)(struct inode *, void *), void *data)
 {
 	struct inode * inode;
 
@@ -601,19 +886,17 @@ static struct inode * get_new_inode(struct super_block *sb, struct hlist_head *h
 	if (inode) {
 		struct inode * old;
 
-		spin_lock(&inode_lock);
+		ilock(&b->lock, ILOCK_HASH);
 		/* We released the lock, so.. */
-		old = find_inode(sb, head, test, data);
+		old = find_inode(sb, b, test, data);
 		if (!old) {
 			if (set(inode, data))
 				goto set_failed;
 
-			inodes_stat.nr_inodes++;
-			list_add(&inode->i_list, &inode_in_use);
-			list_add(&inode->i_sb_list, &sb->s_inodes);
-			hlist_add_head(&inode->i_hash, head);
 			inode->i_state = I_LOCK|I_NEW;
-			spin_unlock(&inode_lock);
+			__inode_hash_add(inode, b);
+			iunlock(&b->lock, ILOCK_HASH);
+			inode_add_lists(inode);
 
 			/* Return the locked inode with I_NEW set, the
 			 * caller is responsible for filling in the contents
@@ -627,7 +910,7 @@ static struct inode * get_new_inode(struct super_block *sb, struct hlist_head *h
 		 * allocated.
 		 */
 		__iget(old);
-		spin_unlock(&inode_lock);
+		iunlock(&b->lock, ILOCK_HASH);
 		destroy_inode(inode);
 		inode = old;
 		wait_on_inode(inode);
@@ -635,7 +918,7 @@ static struct inode * get_new_inode(struct super_block *sb, struct hlist_head *h
 	return inode;
 
 set_failed:
-	spin_unlock(&inode_lock);
+	iunlock(&b->lock, ILOCK_HASH);
 	destroy_inode(inode);
 	return NULL;
 }
@@ -644,7 +927,7 @@ set_failed:
  * get_new_inode_fast is the fast path version of get_new_inode, see the
  * comment at iget_locked for details.
  */
-static struct inode * get_new_inode_fast(struct super_block *sb, struct hlist_head *head, unsigned long ino)
+static struct inode * get_new_inode_fast(struct super_block *sb, struct inode_hash_bucket *b, unsigned long ino)
 {
 	struct inode * inode;
 
@@ -652,17 +935,15 @@ static struct inode * get_new_inode_fast(struct super_block *sb, struct hlist_he
 	if (inode) {
 		struct inode * old;
 
-		spin_lock(&inode_lock);
+		ilock(&b->lock, ILOCK_HASH);
 		/* We released the lock, so.. */
-		old = find_inode_fast(sb, head, ino);
+		old = find_inode_fast(sb, b, ino);
 		if (!old) {
 			inode->i_ino = ino;
-			inodes_stat.nr_inodes++;
-			list_add(&inode->i_list, &inode_in_use);
-			list_add(&inode->i_sb_list, &sb->s_inodes);
-			hlist_add_head(&inode->i_hash, head);
 			inode->i_state = I_LOCK|I_NEW;
-			spin_unlock(&inode_lock);
+			__inode_hash_add(inode, b);
+			iunlock(&b->lock, ILOCK_HASH);
+			inode_add_lists(inode);
 
 			/* Return the locked inode with I_NEW set, the
 			 * caller is responsible for filling in the contents
@@ -676,7 +957,7 @@ static struct inode * get_new_inode_fast(struct super_block *sb, struct hlist_he
 		 * allocated.
 		 */
 		__iget(old);
-		spin_unlock(&inode_lock);
+		iunlock(&b->lock, ILOCK_HASH);
 		destroy_inode(inode);
 		inode = old;
 		wait_on_inode(inode);
@@ -694,6 +975,12 @@ static inline unsigned long hash(struct super_block *sb, unsigned long hashval)
 	return tmp & I_HASHMASK;
 }
 
+static inline struct inode_hash_bucket *inode_hash(struct super_block *sb,
+						   unsigned long hashval)
+{
+	return inode_hashtable + hash(sb, hashval);
+}
+
 /**
  *	iunique - get a unique inode number
  *	@sb: superblock
@@ -710,18 +997,29 @@ static inline unsigned long hash(struct super_block *sb, unsigned long hashval)
  */
 ino_t iunique(struct super_block *sb, ino_t max_reserved)
 {
+	static DEFINE_SPINLOCK(iunique_lock);
 	static ino_t counter;
+	struct inode_hash_bucket *b;
+	struct hlist_node *node;
 	struct inode *inode;
-	struct hlist_head * head;
 	ino_t res;
-	spin_lock(&inode_lock);
+	spin_lock(&iunique_lock);
 retry:
 	if (counter > max_reserved) {
-		head = inode_hashtable + hash(sb,counter);
+		b = inode_hash(sb, counter);
 		res = counter++;
-		inode = find_inode_fast(sb, head, res);
-		if (!inode) {
-			spin_unlock(&inode_lock);
+		/*
+		 * An inode still being freed keeps its number busy: no
+		 * need to wait for it as find_inode_fast() would.
+		 */
+		ilock(&b->lock, ILOCK_HASH);
+		hlist_for_each_entry(inode, node, &b->head, i_hash) {
+			if (inode->i_ino == res && inode->i_sb == sb)
+				break;
+		}
+		iunlock(&b->lock, ILOCK_HASH);
+		if (!node) {
+			spin_unlock(&iunique_lock);
 			return res;
 		}
 	} else {
@@ -768,24 +1066,24 @@ EXPORT_SYMBOL(igrab);
  *
  * Otherwise NULL is returned.
  *
- * Note, @test is called with the inode_lock held, so can't sleep.
+ * Note, @test is called with the hash chain lock held, so can't sleep.
  */
 static inline struct inode *ifind(struct super_block *sb,
-		struct hlist_head *head, int (*test)(struct inode *, void *),
+		struct inode_hash_bucket *b, int (*test)(struct inode *, void *),
 		void *data, const int wait)
 {
 	struct inode *inode;
 
-	spin_lock(&inode_lock);
-	inode = find_inode(sb, head, test, data);
+	ilock(&b->lock, ILOCK_HASH);
+	inode = find_inode(sb, b, test, data);
 	if (inode) {
 		__iget(inode);
-		spin_unlock(&inode_lock);
+		iunlock(&b->lock, ILOCK_HASH);
 		if (likely(wait))
 			wait_on_inode(inode);
 		return inode;
 	}
-	spin_unlock(&inode_lock);
+	iunlock(&b->lock, ILOCK_HASH);
 	return NULL;
 }
 
@@ -805,19 +1103,19 @@ static inline struct inode *ifind(struct super_block *sb,
  * Otherwise NULL is returned.
  */
 static inline struct inode *ifind_fast(struct super_block *sb,
-		struct hlist_head *head, unsigned long ino)
+		struct inode_hash_bucket *b, unsigned long ino)
 {
 	struct inode *inode;
 
-	spin_lock(&inode_lock);
-	inode = find_inode_fast(sb, head, ino);
+	ilock(&b->lock, ILOCK_HASH);
+	inode = find_inode_fast(sb, b, ino);
 	if (inode) {
 		__iget(inode);
-		spin_unlock(&inode_lock);
+		iunlock(&b->lock, ILOCK_HASH);
 		wait_on_inode(inode);
 		return inode;
 	}
-	spin_unlock(&inode_lock);
+	iunlock(&b->lock, ILOCK_HASH);
 	return NULL;
 }
 
@@ -840,14 +1138,14 @@ static inline struct inode *ifind_fast(struct super_block *sb,
  *
  * Otherwise NULL is returned.
  *
- * Note, @test is called with the inode_lock held, so can't sleep.
+ * Note, @test is called with the hash chain lock held, so can't sleep.
  */
 struct inode *ilookup5_nowait(struct super_block *sb, unsigned long hashval,
 		int (*test)(struct inode *, void *), void *data)
 {
-	struct hlist_head *head = inode_hashtable + hash(sb, hashval);
+	struct inode_hash_bucket *b = inode_hash(sb, hashval);
 
-	return ifind(sb, head, test, data, 0);
+	return ifind(sb, b, test, data, 0);
 }
 
 EXPORT_SYMBOL(ilookup5_nowait);
@@ -869,14 +1167,14 @@ EXPORT_SYMBOL(ilookup5_nowait);
  *
  * Otherwise NULL is returned.
  *
- * Note, @test is called with the inode_lock held, so can't sleep.
+ * Note, @test is called with the hash chain lock held, so can't sleep.
  */
 struct inode *ilookup5(struct super_block *sb, unsigned long hashval,
 		int (*test)(struct inode *, void *), void *data)
 {
-	struct hlist_head *head = inode_hashtable + hash(sb, hashval);
+	struct inode_hash_bucket *b = inode_hash(sb, hashval);
 
-	return ifind(sb, head, test, data, 1);
+	return ifind(sb, b, test, data, 1);
 }
 
 EXPORT_SYMBOL(ilookup5);
@@ -897,9 +1195,9 @@ EXPORT_SYMBOL(ilookup5);
  */
 struct inode *ilookup(struct super_block *sb, unsigned long ino)
 {
-	struct hlist_head *head = inode_hashtable + hash(sb, ino);
+	struct inode_hash_bucket *b = inode_hash(sb, ino);
 
-	return ifind_fast(sb, head, ino);
+	return ifind_fast(sb, b, ino);
 }
 
 EXPORT_SYMBOL(ilookup);
@@ -924,23 +1222,24 @@ EXPORT_SYMBOL(ilookup);
  * inode and this is returned locked, hashed, and with the I_NEW flag set. The
  * file system gets to fill it in before unlocking it via unlock_new_inode().
  *
- * Note both @test and @set are called with the inode_lock held, so can't sleep.
+ * Note both @test and @set are called with the hash chain lock held, so can't
+ * sleep.
  */
 struct inode *iget5_locked(struct super_block *sb, unsigned long hashval,
 		int (*test)(struct inode *, void *),
 		int (*set)(struct inode *, void *), void *data)
 {
-	struct hlist_head *head = inode_hashtable + hash(sb, hashval);
+	struct inode_hash_bucket *b = inode_hash(sb, hashval);
 	struct inode *inode;
 
-	inode = ifind(sb, head, test, data, 1);
+	inode = ifind(sb, b, test, data, 1);
 	if (inode)
 		return inode;
 	/*
 	 * get_new_inode() will do the right thing, re-trying the search
 	 * in case it had to block at any point.
 	 */
-	return get_new_inode(sb, head, test, set, data);
+	return get_new_inode(sb, b, test, set, data);
 }
 
 EXPORT_SYMBOL(iget5_locked);
@@ -964,17 +1263,17 @@ EXPORT_SYMBOL(iget5_locked);
  */
 struct inode *iget_locked(struct super_block *sb, unsigned long ino)
 {
-	struct hlist_head *head = inode_hashtable + hash(sb, ino);
+	struct inode_hash_bucket *b = inode_hash(sb, ino);
 	struct inode *inode;
 
-	inode = ifind_fast(sb, head, ino);
+	inode = ifind_fast(sb, b, ino);
 	if (inode)
 		return inode;
 	/*
 	 * get_new_inode_fast() will do the right thing, re-trying the search
 	 * in case it had to block at any point.
 	 */
-	return get_new_inode_fast(sb, head, ino);
+	return get_new_inode_fast(sb, b, ino);
 }
 
 EXPORT_SYMBOL(iget_locked);
@@ -989,10 +1288,10 @@ EXPORT_SYMBOL(iget_locked);
  */
 void __insert_inode_hash(struct inode *inode, unsigned long hashval)
 {
-	struct hlist_head *head = inode_hashtable + hash(inode->i_sb, hashval);
-	spin_lock(&inode_lock);
-	hlist_add_head(&inode->i_hash, head);
-	spin_unlock(&inode_lock);
+	struct inode_hash_bucket *b = inode_hash(inode->i_sb, hashval);
+	ilock(&b->lock, ILOCK_HASH);
+	__inode_hash_add(inode, b);
+	iunlock(&b->lock, ILOCK_HASH);
 }
 
 EXPORT_SYMBOL(__insert_inode_hash);
@@ -1005,9 +1304,17 @@ EXPORT_SYMBOL(__insert_inode_hash);
  */
 void remove_inode_hash(struct inode *inode)
 {
-	spin_lock(&inode_lock);
+	struct inode_hash_bucket *b = inode->i_hash_bucket;
+
+	/* filesystems may keep private inode hashes on i_hash */
+	if (!b) {
+		hlist_del_init(&inode->i_hash);
+		return;
+	}
+	ilock(&b->lock, ILOCK_HASH);
 	hlist_del_init(&inode->i_hash);
-	spin_unlock(&inode_lock);
+	inode->i_hash_bucket = NULL;
+	iunlock(&b->lock, ILOCK_HASH);
 }
 
 EXPORT_SYMBOL(remove_inode_hash);
@@ -1028,9 +1335,13 @@ void generic_delete_inode(struct inode *inode)
 {
 	struct super_operations *op = inode->i_sb->s_op;
 
+	if (!inode_set_freeing(inode, I_FREEING)) {
+		spin_unlock(&inode_lock);
+		return;
+	}
+	inode_lru_del(inode);
 	list_del_init(&inode->i_list);
-	list_del_init(&inode->i_sb_list);
-	inode->i_state|=I_FREEING;
+	inode_sb_list_del(inode);
 	inodes_stat.nr_inodes--;
 	spin_unlock(&inode_lock);
 
@@ -1049,9 +1360,7 @@ void generic_delete_inode(struct inode *inode)
 		truncate_inode_pages(&inode->i_data, 0);
 		clear_inode(inode);
 	}
-	spin_lock(&inode_lock);
-	hlist_del_init(&inode->i_hash);
-	spin_unlock(&inode_lock);
+	remove_inode_hash(inode);
 	wake_up_inode(inode);
 	if (inode->i_state != I_CLEAR)
 		BUG();
@@ -1065,27 +1374,32 @@ static void generic_forget_inode(struct inode *inode)
 	struct super_block *sb = inode->i_sb;
 
 	if (!hlist_unhashed(&inode->i_hash)) {
-		if (!(inode->i_state & (I_DIRTY|I_LOCK)))
-			list_move(&inode->i_list, &inode_unused);
-		inodes_stat.nr_unused++;
 		if (!sb || (sb->s_flags & MS_ACTIVE)) {
+			inode_lru_add(inode);
+			spin_unlock(&inode_lock);
+			return;
+		}
+		if (!inode_set_freeing(inode, I_WILL_FREE)) {
 			spin_unlock(&inode_lock);
 			return;
 		}
-		inode->i_state |= I_WILL_FREE;
+		inode_lru_del(inode);
 		spin_unlock(&inode_lock);
 		write_inode_now(inode, 1);
 		spin_lock(&inode_lock);
-		inode->i_state &= ~I_WILL_FREE;
-		inodes_stat.nr_unused--;
-		hlist_del_init(&inode->i_hash);
 	}
+	if (!inode_set_freeing(inode, I_FREEING)) {
+		spin_unlock(&inode_lock);
+		return;
+	}
+	inode_lru_del(inode);
+	remove_inode_hash(inode);
 	list_del_init(&inode->i_list);
-	list_del_init(&inode->i_sb_list);
-	inode->i_state |= I_FREEING;
+	inode_sb_list_del(inode);
 	inodes_stat.nr_inodes--;
 	spin_unlock(&inode_lock);
-	if (inode->i_data.nrpages)
+	wake_up_inode(inode);
+	if (inode->i_data.nrpages || inode->i_data.nrshadows)
 		truncate_inode_pages(&inode->i_data, 0);
 	clear_inode(inode);
 	destroy_inode(inode);
@@ -1146,8 +1460,10 @@ void iput(struct inode *inode)
 		if (op && op->put_inode)
 			op->put_inode(inode);
 
-		if (atomic_dec_and_lock(&inode->i_count, &inode_lock))
+		if (atomic_dec_and_lock(&inode->i_count, &inode_lock)) {
+			atomic_inc(&inodes_unused);
 			iput_final(inode);
+		}
 	}
 }
 
@@ -1263,7 +1579,8 @@ void remove_dquot_ref(struct super_block *sb, int type,
 
 	if (!sb->dq_op)
 		return;	/* nothing to do */
-	spin_lock(&inode_lock);	/* This lock is for inodes code */
+	/* This lock is for inodes code */
+	ilock(&sb->s_inode_list_lock, ILOCK_SB_LIST);
 
 	/*
 	 * We don't have to lock against quota code - test IS_QUOTAINIT is
@@ -1273,7 +1590,7 @@ void remove_dquot_ref(struct super_block *sb, int type,
 		if (!IS_NOQUOTA(inode))
 			remove_inode_dquot_ref(inode, type, tofree_head);
 
-	spin_unlock(&inode_lock);
+	iunlock(&sb->s_inode_list_lock, ILOCK_SB_LIST);
 }
 
 #endif
@@ -1294,24 +1611,26 @@ int inode_wait(void *word)
  * It doesn't matter if I_LOCK is not set initially, a call to
  * wake_up_inode() after removing from the hash list will DTRT.
  *
- * This is called with inode_lock held.
+ * This is called with the hash chain lock @b held.
  */
-static void __wait_on_freeing_inode(struct inode *inode)
+static void __wait_on_freeing_inode(struct inode *inode,
+				    struct inode_hash_bucket *b)
 {
 	wait_queue_head_t *wq;
 	DEFINE_WAIT_BIT(wait, &inode->i_state, __I_LOCK);
 	wq = bit_waitqueue(&inode->i_state, __I_LOCK);
 	prepare_to_wait(wq, &wait.wait, TASK_UNINTERRUPTIBLE);
-	spin_unlock(&inode_lock);
+	iunlock(&b->lock, ILOCK_HASH);
 	schedule();
 	finish_wait(wq, &wait.wait);
-	spin_lock(&inode_lock);
+	ilock(&b->lock, ILOCK_HASH);
 }
 
 void wake_up_inode(struct inode *inode)
 {
 	/*
-	 * Prevent speculative execution through spin_unlock(&inode_lock);
+	 * Prevent speculative execution through the unlock of the
+	 * inode's hash chain;
 	 */
 	smp_mb();
 	wake_up_bit(&inode->i_state, __I_LOCK);
@@ -1342,7 +1661,7 @@ void __init inode_init_early(void)
 
 	inode_hashtable =
 		alloc_large_system_hash("Inode-cache",
-					sizeof(struct hlist_head),
+					sizeof(struct inode_hash_bucket),
 					ihash_entries,
 					14,
 					HASH_EARLY,
@@ -1350,8 +1669,10 @@ void __init inode_init_early(void)
 					&i_hash_mask,
 					0);
 
-	for (loop = 0; loop < (1 << i_hash_shift); loop++)
-		INIT_HLIST_HEAD(&inode_hashtable[loop]);
+	for (loop = 0; loop < (1 << i_hash_shift); loop++) {
+		INIT_HLIST_HEAD(&inode_hashtable[loop].head);
+		spin_lock_init(&inode_hashtable[loop].lock);
+	}
 }
 
 void __init inode_init(unsigned long mempages)
@@ -1369,7 +1690,7 @@ void __init inode_init(unsigned long mempages)
 
 	inode_hashtable =
 		alloc_large_system_hash("Inode-cache",
-					sizeof(struct hlist_head),
+					sizeof(struct inode_hash_bucket),
 					ihash_entries,
 					14,
 					0,
@@ -1377,8 +1698,10 @@ void __init inode_init(unsigned long mempages)
 					&i_hash_mask,
 					0);
 
-	for (loop = 0; loop < (1 << i_hash_shift); loop++)
-		INIT_HLIST_HEAD(&inode_hashtable[loop]);
+	for (loop = 0; loop < (1 << i_hash_shift); loop++) {
+		INIT_HLIST_HEAD(&inode_hashtable[loop].head);
+		spin_lock_init(&inode_hashtable[loop].lock);
+	}
 }
 
 void init_special_inode(struct inode *inode, umode_t mode, dev_t rdev)
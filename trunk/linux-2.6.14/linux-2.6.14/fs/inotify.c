@@ -54,7 +54,7 @@ int inotify_max_queued_events;
  *
  * dentry->d_lock (used to keep d_move() away from dentry->d_parent)
  * iprune_sem (synchronize shrink_icache_memory())
- * 	inode_lock (protects the super_block->s_inodes list)
+ * 	inode_lock (with iprune_sem, protects the super_block->s_inodes list)
  * 	inode->inotify_sem (protects inode->inotify_watches and watches->i_list)
  * 		inotify_dev->sem (protects inotify_device and watches->d_list)
  */
@@ -328,28 +328,25 @@ mpage_readpages(struct address_space *mapping, struct list_head *pages,
 				unsigned nr_pages, get_block_t get_block)
 {
 	struct bio *bio = NULL;
-	unsigned page_idx;
+	struct pagevec pvec;
+	unsigned page_idx, i;
 	sector_t last_block_in_bio = 0;
-	struct pagevec lru_pvec;
 
-	pagevec_init(&lru_pvec, 0);
-	for (page_idx = 0; page_idx < nr_pages; page_idx++) {
-		struct page *page = list_entry(pages->prev, struct page, lru);
+	for (page_idx = 0; page_idx < nr_pages; ) {
+		unsigned first = page_idx;
+
+		pagevec_init(&pvec, 0);
+		page_idx += add_to_page_cache_lru_vec(mapping, pages,
+					nr_pages - page_idx, &pvec, GFP_KERNEL);
+		for (i = 0; i < pagevec_count(&pvec); i++) {
+			struct page *page = pvec.pages[i];
 
-		prefetchw(&page->flags);
-		list_del(&page->lru);
-		if (!add_to_page_cache(page, mapping,
-					page->index, GFP_KERNEL)) {
 			bio = do_mpage_readpage(bio, page,
-					nr_pages - page_idx,
+					nr_pages - first - i,
 					&last_block_in_bio, get_block);
-			if (!pagevec_add(&lru_pvec, page))
-				__pagevec_lru_add(&lru_pvec);
-		} else {
 			page_cache_release(page);
 		}
 	}
-	pagevec_lru_add(&lru_pvec);
 	BUG_ON(!list_empty(pages));
 	if (bio)
 		mpage_bio_submit(READ, bio);
@@ -720,6 +720,242 @@ fail:
 	return PTR_ERR(dentry);
 }
 
+/*
+ * RCU path walk.
+ *
+ * The common case of resolving a path whose components are all hashed,
+ * positive and uninteresting (no mountpoints, symlinks, "..", or fs
+ * specific dentry/inode operations) is done without taking a single
+ * reference or lock: each component is found with __d_lookup_rcu() and
+ * checked against the d_seq counts of itself and its parent, so a rename,
+ * unhash or delete racing with us is noticed.  Only the final dentry is
+ * pinned.  Anything else, including any failed validation, makes us
+ * return -EAGAIN with the nameidata untouched and the caller redoes the
+ * walk the ordinary way.
+ *
+ * Inodes are not freed by RCU, so the inode of a dentry we hold no
+ * reference on may be freed and reused at any time.  rcu_read_inode()
+ * copies out the few fields the walk needs and only then checks d_seq:
+ * dentry_iput() bumps it before dropping the inode, so a copy that passes
+ * was taken while the dentry still pinned the inode.  No pointer out of
+ * the inode is followed before that check.  Kernels with LSM hooks, which
+ * the walk does not call, or with DEBUG_PAGEALLOC, where merely reading a
+ * freed inode faults, always take the slow path.
+ */
+#if defined(CONFIG_SECURITY) || defined(CONFIG_DEBUG_PAGEALLOC)
+#define rcu_walk_enabled()	0
+#else
+#define rcu_walk_enabled()	1
+#endif
+
+/* What the RCU walk needs to know about an inode, see rcu_read_inode() */
+struct rcu_inode {
+	struct inode_operations *i_op;
+	umode_t mode;
+	uid_t uid;
+	gid_t gid;
+};
+
+/*
+ * Copy out the inode of @dentry, sampled with sequence @seq.  Returns
+ * -EAGAIN for a negative dentry or if the dentry changed meanwhile, in
+ * which case the copy may come from a freed inode and must not be used.
+ */
+static inline int rcu_read_inode(struct dentry *dentry, unsigned seq,
+				 struct rcu_inode *ri)
+{
+	struct inode *inode = dentry->d_inode;
+
+	if (!inode)
+		return -EAGAIN;
+	ri->i_op = inode->i_op;
+	ri->mode = inode->i_mode;
+	ri->uid = inode->i_uid;
+	ri->gid = inode->i_gid;
+	if (read_seqcount_retry(&dentry->d_seq, seq))
+		return -EAGAIN;
+	return 0;
+}
+
+/*
+ * MAY_EXEC check for the RCU walk: the plain DAC test only, without any
+ * side effects.  Everything that would need capable() or ->permission()
+ * is left to the slow path.
+ */
+static inline int exec_permission_rcu(struct rcu_inode *ri)
+{
+	umode_t	mode = ri->mode;
+
+	if (ri->i_op && ri->i_op->permission)
+		return -EAGAIN;
+
+	if (current->fsuid == ri->uid)
+		mode >>= 6;
+	else if (in_group_p(ri->gid))
+		mode >>= 3;
+
+	return (mode & MAY_EXEC) ? 0 : -EAGAIN;
+}
+
+/*
+ * Look up one component below @parent (sampled with sequence @pseq)
+ * and return the child together with its own sequence in @seqp, or
+ * NULL if the lockless walk cannot handle it.
+ */
+static struct dentry *rcu_walk_component(struct dentry *parent, unsigned pseq,
+					 struct qstr *name, unsigned *seqp)
+{
+	struct dentry *dentry;
+
+	if (parent->d_op && (parent->d_op->d_hash || parent->d_op->d_compare))
+		return NULL;
+	dentry = __d_lookup_rcu(parent, name, seqp);
+	if (!dentry)
+		return NULL;
+	/* The child is only valid if the parent did not change under us */
+	if (read_seqcount_retry(&parent->d_seq, pseq))
+		return NULL;
+	if (dentry->d_op && dentry->d_op->d_revalidate)
+		return NULL;
+	if (d_mountpoint(dentry))
+		return NULL;
+	return dentry;
+}
+
+static int rcu_link_path_walk(const char *name, struct nameidata *nd)
+{
+	struct dentry *parent = nd->dentry;
+	struct dentry *dentry;
+	struct rcu_inode ri;
+	struct qstr this;
+	unsigned int lookup_flags = nd->flags;
+	int last_type = LAST_NORM;
+	unsigned seq, dseq;
+
+	if (!rcu_walk_enabled())
+		return -EAGAIN;
+	if (nd->flags & LOOKUP_REVAL)
+		return -EAGAIN;
+	if (parent->d_sb->s_type->fs_flags & FS_REVAL_DOT)
+		return -EAGAIN;
+
+	while (*name=='/')
+		name++;
+	if (!*name)
+		return -EAGAIN;
+
+	if (nd->depth)
+		lookup_flags = LOOKUP_FOLLOW;
+
+	rcu_read_lock();
+	seq = read_seqcount_begin(&parent->d_seq);
+	if (rcu_read_inode(parent, seq, &ri))
+		goto fail;
+
+	for(;;) {
+		unsigned long hash;
+		unsigned int c;
+
+		if (exec_permission_rcu(&ri))
+			goto fail;
+
+		this.name = name;
+		c = *(const unsigned char *)name;
+
+		hash = init_name_hash();
+		do {
+			name++;
+			hash = partial_name_hash(c, hash);
+			c = *(const unsigned char *)name;
+		} while (c && (c != '/'));
+		this.len = name - (const char *) this.name;
+		this.hash = end_name_hash(hash);
+
+		if (!c)
+			goto last_component;
+		while (*++name == '/');
+		if (!*name) {
+			lookup_flags |= LOOKUP_FOLLOW | LOOKUP_DIRECTORY;
+			goto last_component;
+		}
+
+		if (this.name[0] == '.') {
+			if (this.len == 1)
+				continue;
+			if (this.len == 2 && this.name[1] == '.')
+				goto fail;
+		}
+
+		dentry = rcu_walk_component(parent, seq, &this, &dseq);
+		if (!dentry)
+			goto fail;
+		if (rcu_read_inode(dentry, dseq, &ri) || !ri.i_op)
+			goto fail;
+		if (ri.i_op->follow_link || !ri.i_op->lookup)
+			goto fail;
+		parent = dentry;
+		seq = dseq;
+	}
+
+last_component:
+	if (lookup_flags & LOOKUP_PARENT) {
+		if (this.name[0] == '.') {
+			if (this.len == 1)
+				last_type = LAST_DOT;
+			else if (this.len == 2 && this.name[1] == '.')
+				last_type = LAST_DOTDOT;
+		}
+		dentry = parent;
+		dseq = seq;
+		goto grab;
+	}
+	if (this.name[0] == '.') {
+		if (this.len == 1) {
+			dentry = parent;
+			dseq = seq;
+			goto grab;
+		}
+		if (this.len == 2 && this.name[1] == '.')
+			goto fail;
+	}
+	dentry = rcu_walk_component(parent, seq, &this, &dseq);
+	if (!dentry)
+		goto fail;
+	if (rcu_read_inode(dentry, dseq, &ri) || !ri.i_op)
+		goto fail;
+	if ((lookup_flags & LOOKUP_FOLLOW) && ri.i_op->follow_link)
+		goto fail;
+	if ((lookup_flags & LOOKUP_DIRECTORY) && !ri.i_op->lookup)
+		goto fail;
+
+grab:
+	/*
+	 * Same lazy reference as __d_lookup: the count may go 0 -> 1 while
+	 * the dentry still sits on dentry_unused.
+	 */
+	spin_lock(&dentry->d_lock);
+	if (read_seqcount_retry(&dentry->d_seq, dseq)) {
+		spin_unlock(&dentry->d_lock);
+		goto fail;
+	}
+	atomic_inc(&dentry->d_count);
+	spin_unlock(&dentry->d_lock);
+	rcu_read_unlock();
+
+	dput(nd->dentry);
+	nd->dentry = dentry;
+	nd->flags &= ~LOOKUP_CONTINUE;
+	if (lookup_flags & LOOKUP_PARENT) {
+		nd->last = this;
+		nd->last_type = last_type;
+	}
+	return 0;
+
+fail:
+	rcu_read_unlock();
+	return -EAGAIN;
+}
+
 /*
  * Name resolution.
  * This is the basic name resolution function, turning a pathname into
@@ -925,6 +1161,10 @@ int fastcall link_path_walk(const char *name, struct nameidata *nd)
 	struct nameidata save = *nd;
 	int result;
 
+	result = rcu_link_path_walk(name, nd);
+	if (result != -EAGAIN)
+		return result;
+
 	/* make sure the stuff we saved doesn't go away */
 	dget(save.dentry);
 	mntget(save.mnt);
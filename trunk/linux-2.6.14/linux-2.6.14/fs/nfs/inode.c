@@ -1600,6 +1600,7 @@ static void nfs_kill_super(struct super_block *s)
 
 	rpciod_down();		/* release rpciod */
 
+	bdi_stop_flusher(&server->backing_dev_info);
 	if (server->hostname != NULL)
 		kfree(server->hostname);
 	kfree(server);
@@ -1958,6 +1959,7 @@ static void nfs4_kill_super(struct super_block *sb)
 
 	destroy_nfsv4_state(server);
 
+	bdi_stop_flusher(&server->backing_dev_info);
 	if (server->hostname != NULL)
 		kfree(server->hostname);
 	kfree(server);
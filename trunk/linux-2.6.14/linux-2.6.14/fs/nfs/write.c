@@ -54,6 +54,7 @@
 #include <linux/file.h>
 #include <linux/mpage.h>
 #include <linux/writeback.h>
+#include <linux/backing-dev.h>
 
 #include <linux/sunrpc/clnt.h>
 #include <linux/nfs_fs.h>
@@ -452,6 +453,7 @@ nfs_mark_request_dirty(struct nfs_page *req)
 	nfsi->ndirty++;
 	spin_unlock(&nfsi->req_lock);
 	inc_page_state(nr_dirty);
+	bdi_stat_inc(inode->i_mapping->backing_dev_info, BDI_RECLAIMABLE);
 	mark_inode_dirty(inode);
 }
 
@@ -480,6 +482,7 @@ nfs_mark_request_commit(struct nfs_page *req)
 	nfsi->ncommit++;
 	spin_unlock(&nfsi->req_lock);
 	inc_page_state(nr_unstable);
+	bdi_stat_inc(inode->i_mapping->backing_dev_info, BDI_RECLAIMABLE);
 	mark_inode_dirty(inode);
 }
 #endif
@@ -545,6 +548,8 @@ nfs_scan_dirty(struct inode *inode, struct list_head *dst, unsigned long idx_sta
 		res = nfs_scan_lock_dirty(nfsi, dst, idx_start, npages);
 		nfsi->ndirty -= res;
 		sub_page_state(nr_dirty,res);
+		bdi_stat_mod(inode->i_mapping->backing_dev_info,
+				BDI_RECLAIMABLE, -res);
 		if ((nfsi->ndirty == 0) != list_empty(&nfsi->dirty))
 			printk(KERN_ERR "NFS: desynchronized value of nfs_i.ndirty.\n");
 	}
@@ -1323,6 +1328,8 @@ nfs_commit_done(struct rpc_task *task)
 		res++;
 	}
 	sub_page_state(nr_unstable,res);
+	bdi_stat_mod(data->inode->i_mapping->backing_dev_info,
+			BDI_RECLAIMABLE, -res);
 }
 #endif
 
@@ -124,6 +124,7 @@ static int meminfo_read_proc(char *page, char **start, off_t off,
 	unsigned long inactive;
 	unsigned long active;
 	unsigned long free;
+	unsigned long lru[NR_LRU_LISTS];
 	unsigned long committed;
 	unsigned long allowed;
 	struct vmalloc_info vmi;
@@ -131,6 +132,7 @@ static int meminfo_read_proc(char *page, char **start, off_t off,
 
 	get_page_state(&ps);
 	get_zone_counts(&active, &inactive, &free);
+	get_lru_counts(lru);
 
 /*
  * display in kilobytes.
@@ -159,6 +161,11 @@ static int meminfo_read_proc(char *page, char **start, off_t off,
 		"SwapCached:   %8lu kB\n"
 		"Active:       %8lu kB\n"
 		"Inactive:     %8lu kB\n"
+		"Active(anon):   %8lu kB\n"
+		"Inactive(anon): %8lu kB\n"
+		"Active(file):   %8lu kB\n"
+		"Inactive(file): %8lu kB\n"
+		"Unevictable:  %8lu kB\n"
 		"HighTotal:    %8lu kB\n"
 		"HighFree:     %8lu kB\n"
 		"LowTotal:     %8lu kB\n"
@@ -182,6 +189,11 @@ static int meminfo_read_proc(char *page, char **start, off_t off,
 		K(total_swapcache_pages),
 		K(active),
 		K(inactive),
+		K(lru[LRU_ACTIVE_ANON]),
+		K(lru[LRU_INACTIVE_ANON]),
+		K(lru[LRU_ACTIVE_FILE]),
+		K(lru[LRU_INACTIVE_FILE]),
+		K(lru[LRU_UNEVICTABLE]),
 		K(i.totalhigh),
 		K(i.freehigh),
 		K(i.totalram-i.totalhigh),
@@ -220,6 +232,19 @@ static struct file_operations fragmentation_file_operations = {
 	.release	= seq_release,
 };
 
+extern struct seq_operations pagetypeinfo_op;
+static int pagetypeinfo_open(struct inode *inode, struct file *file)
+{
+	return seq_open(file, &pagetypeinfo_op);
+}
+
+static struct file_operations pagetypeinfo_file_ops = {
+	.open		= pagetypeinfo_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= seq_release,
+};
+
 extern struct seq_operations zoneinfo_op;
 static int zoneinfo_open(struct inode *inode, struct file *file)
 {
@@ -267,6 +292,20 @@ static struct file_operations proc_vmstat_file_operations = {
 	.release	= seq_release,
 };
 
+#ifdef CONFIG_INODE_LOCK_STAT
+extern struct seq_operations inode_lock_stat_op;
+static int inode_lock_stat_open(struct inode *inode, struct file *file)
+{
+	return seq_open(file, &inode_lock_stat_op);
+}
+static struct file_operations proc_inode_lock_stat_operations = {
+	.open		= inode_lock_stat_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= seq_release,
+};
+#endif
+
 #ifdef CONFIG_PROC_HARDWARE
 static int hardware_read_proc(char *page, char **start, off_t off,
 				 int count, int *eof, void *data)
@@ -602,6 +641,7 @@ void __init proc_misc_init(void)
 	create_seq_entry("interrupts", 0, &proc_interrupts_operations);
 	create_seq_entry("slabinfo",S_IWUSR|S_IRUGO,&proc_slabinfo_operations);
 	create_seq_entry("buddyinfo",S_IRUGO, &fragmentation_file_operations);
+	create_seq_entry("pagetypeinfo", S_IRUGO, &pagetypeinfo_file_ops);
 	create_seq_entry("vmstat",S_IRUGO, &proc_vmstat_file_operations);
 	create_seq_entry("zoneinfo",S_IRUGO, &proc_zoneinfo_file_operations);
 	create_seq_entry("diskstats", 0, &proc_diskstats_operations);
@@ -611,6 +651,9 @@ void __init proc_misc_init(void)
 #ifdef CONFIG_SCHEDSTATS
 	create_seq_entry("schedstat", 0, &proc_schedstat_operations);
 #endif
+#ifdef CONFIG_INODE_LOCK_STAT
+	create_seq_entry("inode_lock_stat", 0, &proc_inode_lock_stat_operations);
+#endif
 #ifdef CONFIG_PROC_KCORE
 	proc_root_kcore = create_proc_entry("kcore", S_IRUSR, NULL);
 	if (proc_root_kcore) {
@@ -1,5 +1,6 @@
 #include <linux/mm.h>
 #include <linux/hugetlb.h>
+#include <linux/huge_mm.h>
 #include <linux/mount.h>
 #include <linux/seq_file.h>
 #include <linux/highmem.h>
@@ -217,6 +218,34 @@ static void smaps_pte_range(struct vm_area_struct *vma, pmd_t *pmd,
 	cond_resched_lock(&vma->vm_mm->page_table_lock);
 }
 
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+static void smaps_huge_pmd(pmd_t pmd, unsigned long addr, unsigned long end,
+			   struct mem_size_stats *mss)
+{
+	struct page *page;
+
+	page = pfn_to_page(pmd_pfn(pmd)) +
+		((addr & ~HPAGE_PMD_MASK) >> PAGE_SHIFT);
+	for (; addr != end; addr += PAGE_SIZE, page++) {
+		mss->resident += PAGE_SIZE;
+		if (page_count(page) >= 2) {
+			if (pmd_dirty(pmd))
+				mss->shared_dirty += PAGE_SIZE;
+			else
+				mss->shared_clean += PAGE_SIZE;
+		} else {
+			if (pmd_dirty(pmd))
+				mss->private_dirty += PAGE_SIZE;
+			else
+				mss->private_clean += PAGE_SIZE;
+		}
+	}
+}
+#else
+static inline void smaps_huge_pmd(pmd_t pmd, unsigned long addr,
+			unsigned long end, struct mem_size_stats *mss) { }
+#endif
+
 static inline void smaps_pmd_range(struct vm_area_struct *vma, pud_t *pud,
 				unsigned long addr, unsigned long end,
 				struct mem_size_stats *mss)
@@ -227,6 +256,10 @@ static inline void smaps_pmd_range(struct vm_area_struct *vma, pud_t *pud,
 	pmd = pmd_offset(pud, addr);
 	do {
 		next = pmd_addr_end(addr, end);
+		if (pmd_trans_huge(*pmd)) {
+			smaps_huge_pmd(*pmd, addr, next, mss);
+			continue;
+		}
 		if (pmd_none_or_clear_bad(pmd))
 			continue;
 		smaps_pte_range(vma, pmd, addr, next, mss);
@@ -59,17 +59,28 @@ static struct super_block *alloc_super(void)
 	static struct super_operations default_op;
 
 	if (s) {
+		int i;
+
 		memset(s, 0, sizeof(struct super_block));
 		if (security_sb_alloc(s)) {
 			kfree(s);
 			s = NULL;
 			goto out;
 		}
+		s->s_files = alloc_percpu(struct list_head);
+		if (!s->s_files) {
+			security_sb_free(s);
+			kfree(s);
+			s = NULL;
+			goto out;
+		}
+		for_each_cpu(i)
+			INIT_LIST_HEAD(per_cpu_ptr(s->s_files, i));
 		INIT_LIST_HEAD(&s->s_dirty);
 		INIT_LIST_HEAD(&s->s_io);
-		INIT_LIST_HEAD(&s->s_files);
 		INIT_LIST_HEAD(&s->s_instances);
 		INIT_HLIST_HEAD(&s->s_anon);
+		spin_lock_init(&s->s_inode_list_lock);
 		INIT_LIST_HEAD(&s->s_inodes);
 		init_rwsem(&s->s_umount);
 		sema_init(&s->s_lock, 1);
@@ -99,6 +110,7 @@ out:
  */
 static inline void destroy_super(struct super_block *s)
 {
+	free_percpu(s->s_files);
 	security_sb_free(s);
 	kfree(s);
 }
@@ -512,12 +524,12 @@ static void mark_files_ro(struct super_block *sb)
 {
 	struct file *f;
 
-	file_list_lock();
-	list_for_each_entry(f, &sb->s_files, f_list) {
+	file_list_lock_all();
+	do_file_list_for_each_entry(sb, f) {
 		if (S_ISREG(f->f_dentry->d_inode->i_mode) && file_count(f))
 			f->f_mode &= ~FMODE_WRITE;
-	}
-	file_list_unlock();
+	} while_file_list_for_each_entry;
+	file_list_unlock_all();
 }
 
 /**
@@ -197,62 +197,6 @@ test_page_region(
 	return (mask && (page->private & mask) == mask);
 }
 
-/*
- * Mapping of multi-page buffers into contiguous virtual space
- */
-
-typedef struct a_list {
-	void		*vm_addr;
-	struct a_list	*next;
-} a_list_t;
-
-STATIC a_list_t		*as_free_head;
-STATIC int		as_list_len;
-STATIC DEFINE_SPINLOCK(as_lock);
-
-/*
- * Try to batch vunmaps because they are costly.
- */
-STATIC void
-free_address(
-	void		*addr)
-{
-	a_list_t	*aentry;
-
-	aentry = kmalloc(sizeof(a_list_t), GFP_ATOMIC & ~__GFP_HIGH);
-	if (likely(aentry)) {
-		spin_lock(&as_lock);
-		aentry->next = as_free_head;
-		aentry->vm_addr = addr;
-		as_free_head = aentry;
-		as_list_len++;
-		spin_unlock(&as_lock);
-	} else {
-		vunmap(addr);
-	}
-}
-
-STATIC void
-purge_addresses(void)
-{
-	a_list_t	*aentry, *old;
-
-	if (as_free_head == NULL)
-		return;
-
-	spin_lock(&as_lock);
-	aentry = as_free_head;
-	as_free_head = NULL;
-	as_list_len = 0;
-	spin_unlock(&as_lock);
-
-	while ((old = aentry) != NULL) {
-		vunmap(aentry->vm_addr);
-		aentry = aentry->next;
-		kfree(old);
-	}
-}
-
 /*
  *	Internal pagebuf object manipulation
  */
@@ -353,7 +297,8 @@ pagebuf_free(
 		uint		i;
 
 		if ((bp->pb_flags & PBF_MAPPED) && (bp->pb_page_count > 1))
-			free_address(bp->pb_addr - bp->pb_offset);
+			vm_unmap_ram(bp->pb_addr - bp->pb_offset,
+					bp->pb_page_count);
 
 		for (i = 0; i < bp->pb_page_count; i++)
 			page_cache_release(bp->pb_pages[i]);
@@ -483,10 +428,8 @@ _pagebuf_map_pages(
 		bp->pb_addr = page_address(bp->pb_pages[0]) + bp->pb_offset;
 		bp->pb_flags |= PBF_MAPPED;
 	} else if (flags & PBF_MAPPED) {
-		if (as_list_len > 64)
-			purge_addresses();
-		bp->pb_addr = vmap(bp->pb_pages, bp->pb_page_count,
-				VM_MAP, PAGE_KERNEL);
+		bp->pb_addr = vm_map_ram(bp->pb_pages, bp->pb_page_count,
+					PAGE_KERNEL);
 		if (unlikely(bp->pb_addr == NULL))
 			return -ENOMEM;
 		bp->pb_addr += bp->pb_offset;
@@ -1814,9 +1757,6 @@ xfsbufd(
 			blk_run_address_space(target->pbr_mapping);
 		}
 
-		if (as_list_len > 0)
-			purge_addresses();
-
 		xfsbufd_force_flush = 0;
 	} while (!kthread_should_stop());
 
@@ -123,6 +123,31 @@ extern __inline__ int atomic_inc_and_test(volatile atomic_t *v)
 	return retval;
 }
 
+extern __inline__ int atomic_cmpxchg(atomic_t *v, int old, int new)
+{
+	unsigned long flags;
+	int ret;
+
+	cris_atomic_save(v, flags);
+	ret = v->counter;
+	if (ret == old)
+		v->counter = new;
+	cris_atomic_restore(v, flags);
+
+	return ret;
+}
+
+extern __inline__ int atomic_add_unless(atomic_t *v, int a, int u)
+{
+	int c, old;
+
+	c = atomic_read(v);
+	while (c != u && (old = atomic_cmpxchg((v), c, c + a)) != c)
+		c = old;
+	return c != u;
+}
+#define atomic_inc_not_zero(v) atomic_add_unless((v), 1, 0)
+
 /* Atomic operations are already serializing */
 #define smp_mb__before_atomic_dec()    barrier()
 #define smp_mb__after_atomic_dec()     barrier()
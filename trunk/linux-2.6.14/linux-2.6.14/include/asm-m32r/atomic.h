@@ -106,6 +106,47 @@ static __inline__ int atomic_sub_return(int i, atomic_t *v)
 	return result;
 }
 
+static __inline__ int atomic_cmpxchg(atomic_t *v, int old, int new)
+{
+	unsigned long flags;
+	int retval;
+
+	local_irq_save(flags);
+	__asm__ __volatile__ (
+		"# atomic_cmpxchg		\n\t"
+		DCACHE_CLEAR("%0", "r4", "%1")
+		M32R_LOCK" %0, @%1;		\n\t"
+		"bne	%0, %2, 1f;		\n\t"
+		M32R_UNLOCK" %3, @%1;		\n\t"
+		"bra	2f;			\n\t"
+		".fillinsn			\n"
+		"1:"
+		M32R_UNLOCK" %0, @%1;		\n\t"
+		".fillinsn			\n"
+		"2:"
+		: "=&r" (retval)
+		: "r" (&v->counter), "r" (old), "r" (new)
+		: "cbit", "memory"
+#ifdef CONFIG_CHIP_M32700_TS1
+		, "r4"
+#endif	/* CONFIG_CHIP_M32700_TS1 */
+	);
+	local_irq_restore(flags);
+
+	return retval;
+}
+
+static __inline__ int atomic_add_unless(atomic_t *v, int a, int u)
+{
+	int c, old;
+
+	c = atomic_read(v);
+	while (c != u && (old = atomic_cmpxchg((v), c, c + a)) != c)
+		c = old;
+	return c != u;
+}
+#define atomic_inc_not_zero(v) atomic_add_unless((v), 1, 0)
+
 /**
  * atomic_add - add integer to atomic variable
  * @i: integer value to add
@@ -641,6 +641,18 @@ static __inline__ long atomic64_sub_if_positive(long i, atomic64_t * v)
 
 #endif /* CONFIG_64BIT */
 
+#define atomic_cmpxchg(v, o, n) ((int)cmpxchg(&((v)->counter), (o), (n)))
+
+#define atomic_add_unless(v, a, u)				\
+({								\
+	int c, old;						\
+	c = atomic_read(v);					\
+	while (c != (u) && (old = atomic_cmpxchg((v), c, c + (a))) != c) \
+		c = old;					\
+	c != (u);						\
+})
+#define atomic_inc_not_zero(v) atomic_add_unless((v), 1, 0)
+
 /*
  * atomic*_return operations are serializing but not the non-*_return
  * versions.
@@ -163,6 +163,20 @@ static __inline__ int atomic_read(const atomic_t *v)
 	return v->counter;
 }
 
+static __inline__ int atomic_cmpxchg(atomic_t *v, int old, int new)
+{
+	unsigned long flags;
+	int ret;
+
+	_atomic_spin_lock_irqsave(v, flags);
+	ret = v->counter;
+	if (ret == old)
+		v->counter = new;
+	_atomic_spin_unlock_irqrestore(v, flags);
+
+	return ret;
+}
+
 /* exported interface */
 
 #define atomic_add(i,v)	((void)(__atomic_add_return( ((int)i),(v))))
@@ -189,6 +203,17 @@ static __inline__ int atomic_read(const atomic_t *v)
 
 #define atomic_dec_and_test(v)	(atomic_dec_return(v) == 0)
 
+static __inline__ int atomic_add_unless(atomic_t *v, int a, int u)
+{
+	int c, old;
+
+	c = atomic_read(v);
+	while (c != u && (old = atomic_cmpxchg((v), c, c + a)) != c)
+		c = old;
+	return c != u;
+}
+#define atomic_inc_not_zero(v) atomic_add_unless((v), 1, 0)
+
 #define ATOMIC_INIT(i)	{ (i) }
 
 #define smp_mb__before_atomic_dec()	smp_mb()
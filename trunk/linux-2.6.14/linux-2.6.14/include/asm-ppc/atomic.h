@@ -204,6 +204,18 @@ static __inline__ int atomic_dec_if_positive(atomic_t *v)
 	return t;
 }
 
+#define atomic_cmpxchg(v, o, n) ((int)cmpxchg(&((v)->counter), (o), (n)))
+
+#define atomic_add_unless(v, a, u)				\
+({								\
+	int c, old;						\
+	c = atomic_read(v);					\
+	while (c != (u) && (old = atomic_cmpxchg((v), c, c + (a))) != c) \
+		c = old;					\
+	c != (u);						\
+})
+#define atomic_inc_not_zero(v) atomic_add_unless((v), 1, 0)
+
 #define __MB	__asm__ __volatile__ (SMP_SYNC : : : "memory")
 #define smp_mb__before_atomic_dec()	__MB
 #define smp_mb__after_atomic_dec()	__MB
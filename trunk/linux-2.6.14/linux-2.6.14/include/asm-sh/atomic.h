@@ -105,6 +105,31 @@ static __inline__ void atomic_set_mask(unsigned int mask, atomic_t *v)
 	local_irq_restore(flags);
 }
 
+static __inline__ int atomic_cmpxchg(atomic_t *v, int old, int new)
+{
+	unsigned long flags;
+	int ret;
+
+	local_irq_save(flags);
+	ret = v->counter;
+	if (ret == old)
+		v->counter = new;
+	local_irq_restore(flags);
+
+	return ret;
+}
+
+static __inline__ int atomic_add_unless(atomic_t *v, int a, int u)
+{
+	int c, old;
+
+	c = atomic_read(v);
+	while (c != u && (old = atomic_cmpxchg((v), c, c + a)) != c)
+		c = old;
+	return c != u;
+}
+#define atomic_inc_not_zero(v) atomic_add_unless((v), 1, 0)
+
 /* Atomic operations are already serializing on SH */
 #define smp_mb__before_atomic_dec()	barrier()
 #define smp_mb__after_atomic_dec()	barrier()
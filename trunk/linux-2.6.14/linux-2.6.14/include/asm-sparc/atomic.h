@@ -20,6 +20,8 @@ typedef struct { volatile int counter; } atomic_t;
 
 extern int __atomic_add_return(int, atomic_t *);
 extern void atomic_set(atomic_t *, int);
+extern int atomic_cmpxchg(atomic_t *, int, int);
+extern int atomic_add_unless(atomic_t *, int, int);
 
 #define atomic_read(v)          ((v)->counter)
 
@@ -34,6 +36,7 @@ extern void atomic_set(atomic_t *, int);
 #define atomic_dec_return(v)	(__atomic_add_return(       -1, (v)))
 
 #define atomic_add_negative(a, v)	(atomic_add_return((a), (v)) < 0)
+#define atomic_inc_not_zero(v)		atomic_add_unless((v), 1, 0)
 
 /*
  * atomic_inc_and_test - increment and test
@@ -57,6 +57,31 @@ static __inline__ int atomic_sub_return (int i, volatile atomic_t *v)
 	return res;
 }
 
+static __inline__ int atomic_cmpxchg(atomic_t *v, int old, int new)
+{
+	unsigned long flags;
+	int ret;
+
+	local_irq_save (flags);
+	ret = v->counter;
+	if (ret == old)
+		v->counter = new;
+	local_irq_restore (flags);
+
+	return ret;
+}
+
+static __inline__ int atomic_add_unless(atomic_t *v, int a, int u)
+{
+	int c, old;
+
+	c = atomic_read(v);
+	while (c != u && (old = atomic_cmpxchg((v), c, c + a)) != c)
+		c = old;
+	return c != u;
+}
+#define atomic_inc_not_zero(v) atomic_add_unless((v), 1, 0)
+
 static __inline__ void atomic_clear_mask (unsigned long mask, unsigned long *addr)
 {
 	unsigned long flags;
@@ -36,6 +36,10 @@
 #define MADV_SEQUENTIAL	0x2		/* read-ahead aggressively */
 #define MADV_WILLNEED	0x3		/* pre-fault pages */
 #define MADV_DONTNEED	0x4		/* discard these pages */
+#define MADV_MERGEABLE	12		/* KSM may merge identical pages */
+#define MADV_UNMERGEABLE 13		/* KSM may not merge identical pages */
+#define MADV_HUGEPAGE	14		/* worth backing with huge pages */
+#define MADV_NOHUGEPAGE	15		/* not worth backing with huge pages */
 
 /* compatibility flags */
 #define MAP_ANON	MAP_ANONYMOUS
@@ -280,6 +280,24 @@ extern inline pte_t pte_mkexec(pte_t pte)	{ set_pte(&pte, __pte(pte_val(pte) | _
 extern inline pte_t pte_mkdirty(pte_t pte)	{ set_pte(&pte, __pte(pte_val(pte) | _PAGE_DIRTY)); return pte; }
 extern inline pte_t pte_mkyoung(pte_t pte)	{ set_pte(&pte, __pte(pte_val(pte) | _PAGE_ACCESSED)); return pte; }
 extern inline pte_t pte_mkwrite(pte_t pte)	{ set_pte(&pte, __pte(pte_val(pte) | _PAGE_RW)); return pte; }
+
+/*
+ * NUMA hinting ptes look like PROT_NONE ones: not present to the MMU but
+ * to the kernel, so that the next access faults; see mm/numa_balancing.c.
+ */
+static inline int pte_numa(pte_t pte)
+{
+	return (pte_val(pte) & (_PAGE_PRESENT | _PAGE_PROTNONE)) ==
+		_PAGE_PROTNONE;
+}
+static inline pte_t pte_mknuma(pte_t pte)
+{
+	return __pte((pte_val(pte) & ~_PAGE_PRESENT) | _PAGE_PROTNONE);
+}
+static inline pte_t pte_mknonnuma(pte_t pte)
+{
+	return __pte((pte_val(pte) & ~_PAGE_PROTNONE) | _PAGE_PRESENT);
+}
 extern inline pte_t pte_mkhuge(pte_t pte)	{ set_pte(&pte, __pte(pte_val(pte) | __LARGE_PTE)); return pte; }
 
 struct vm_area_struct;
@@ -356,6 +374,40 @@ static inline pud_t *__pud_offset_k(pud_t *pud, unsigned long address)
 #define pfn_pmd(nr,prot) (__pmd(((nr) << PAGE_SHIFT) | pgprot_val(prot)))
 #define pmd_pfn(x)  ((pmd_val(x) >> PAGE_SHIFT) & __PHYSICAL_MASK)
 
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+/*
+ * A transparent huge pmd maps HPAGE_PMD_NR ordinary small pages with one
+ * large pmd entry; see mm/huge_memory.c.
+ */
+static inline int pmd_trans_huge(pmd_t pmd)	{ return pmd_val(pmd) & _PAGE_PSE; }
+static inline int pmd_write(pmd_t pmd)		{ return pmd_val(pmd) & _PAGE_RW; }
+static inline int pmd_dirty(pmd_t pmd)		{ return pmd_val(pmd) & _PAGE_DIRTY; }
+static inline int pmd_young(pmd_t pmd)		{ return pmd_val(pmd) & _PAGE_ACCESSED; }
+static inline pmd_t pmd_mkold(pmd_t pmd)	{ return __pmd(pmd_val(pmd) & ~_PAGE_ACCESSED); }
+static inline pmd_t pmd_mkyoung(pmd_t pmd)	{ return __pmd(pmd_val(pmd) | _PAGE_ACCESSED); }
+static inline pmd_t pmd_mkdirty(pmd_t pmd)	{ return __pmd(pmd_val(pmd) | _PAGE_DIRTY); }
+static inline pmd_t pmd_mkwrite(pmd_t pmd)	{ return __pmd(pmd_val(pmd) | _PAGE_RW); }
+static inline pmd_t pmd_wrprotect(pmd_t pmd)	{ return __pmd(pmd_val(pmd) & ~_PAGE_RW); }
+#define mk_huge_pmd(page,prot) \
+	pfn_pmd(page_to_pfn(page), __pgprot(pgprot_val(prot) | _PAGE_PSE))
+/* The protection of the small pages mapped by a huge pmd */
+#define pmd_pgprot(pmd)	__pgprot(pmd_val(pmd) & ~PTE_MASK & ~_PAGE_PSE)
+
+#define pmdp_get_and_clear(mm,addr,xp)	__pmd(xchg(&(xp)->pmd, 0))
+
+static inline void pmdp_set_wrprotect(struct mm_struct *mm, unsigned long addr, pmd_t *pmdp)
+{
+	clear_bit(_PAGE_BIT_RW, pmdp);
+}
+
+static inline int pmdp_test_and_clear_young(struct vm_area_struct *vma, unsigned long addr, pmd_t *pmdp)
+{
+	if (!pmd_young(*pmdp))
+		return 0;
+	return test_and_clear_bit(_PAGE_BIT_ACCESSED, pmdp);
+}
+#endif
+
 #define pte_to_pgoff(pte) ((pte_val(pte) & PHYSICAL_PAGE_MASK) >> PAGE_SHIFT)
 #define pgoff_to_pte(off) ((pte_t) { ((off) << PAGE_SHIFT) | _PAGE_FILE })
 #define PTE_FILE_MAX_BITS __PHYSICAL_MASK_SHIFT
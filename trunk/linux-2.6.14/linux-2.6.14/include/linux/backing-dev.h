@@ -8,8 +8,11 @@
 #ifndef _LINUX_BACKING_DEV_H
 #define _LINUX_BACKING_DEV_H
 
+#include <linux/list.h>
 #include <asm/atomic.h>
 
+struct task_struct;
+
 /*
  * Bits in backing_dev_info.state
  */
@@ -17,11 +20,21 @@ enum bdi_state {
 	BDI_pdflush,		/* A pdflush thread is working this device */
 	BDI_write_congested,	/* The write queue is getting full */
 	BDI_read_congested,	/* The read queue is getting full */
+	BDI_work,		/* The flusher thread has been asked to write */
 	BDI_unused,		/* Available bits start here */
 };
 
 typedef int (congested_fn)(void *, int);
 
+/*
+ * Page counts of a device, kept alongside the global nr_dirty and friends
+ */
+enum bdi_stat_item {
+	BDI_RECLAIMABLE,	/* dirty and unstable pages */
+	BDI_WRITEBACK,		/* pages under writeback */
+	NR_BDI_STAT_ITEMS
+};
+
 struct backing_dev_info {
 	unsigned long ra_pages;	/* max readahead in PAGE_CACHE_SIZE units */
 	unsigned long state;	/* Always use atomic bitops on this */
@@ -30,6 +43,19 @@ struct backing_dev_info {
 	void *congested_data;	/* Pointer to aux data for congested func */
 	void (*unplug_io_fn)(struct backing_dev_info *, struct page *);
 	void *unplug_io_data;
+
+	atomic_t stat[NR_BDI_STAT_ITEMS];
+	atomic_t completions;	/* recent writeback completions, decaying */
+	unsigned int completions_period; /* ... last decayed in this period */
+
+	/*
+	 * The flusher thread writing back this device.  Started on demand
+	 * by mm/backing-dev.c, all under bdi_lock.
+	 */
+	struct task_struct *flusher;
+	int flusher_state;
+	struct list_head flusher_list;	/* pending, or running flushers */
+	long flusher_pages;		/* pages asked for by BDI_work */
 };
 
 
@@ -65,6 +91,48 @@ int writeback_acquire(struct backing_dev_info *bdi);
 int writeback_in_progress(struct backing_dev_info *bdi);
 void writeback_release(struct backing_dev_info *bdi);
 
+static inline void bdi_stat_inc(struct backing_dev_info *bdi,
+				enum bdi_stat_item item)
+{
+	atomic_inc(&bdi->stat[item]);
+}
+
+static inline void bdi_stat_dec(struct backing_dev_info *bdi,
+				enum bdi_stat_item item)
+{
+	atomic_dec(&bdi->stat[item]);
+}
+
+static inline void bdi_stat_mod(struct backing_dev_info *bdi,
+				enum bdi_stat_item item, int delta)
+{
+	atomic_add(delta, &bdi->stat[item]);
+}
+
+static inline unsigned long bdi_stat(struct backing_dev_info *bdi,
+				     enum bdi_stat_item item)
+{
+	int val = atomic_read(&bdi->stat[item]);
+
+	return val > 0 ? val : 0;
+}
+
+/* mm/page-writeback.c */
+void bdi_writeout_inc(struct backing_dev_info *bdi);
+unsigned long bdi_dirty_limit(struct backing_dev_info *bdi);
+long bdi_background_writeout(struct backing_dev_info *bdi, long min_pages);
+long bdi_kupdate(struct backing_dev_info *bdi);
+
+/* mm/backing-dev.c */
+void bdi_start_flusher(struct backing_dev_info *bdi);
+void bdi_start_writeback(struct backing_dev_info *bdi, long nr_pages);
+void bdi_writeback_all(long nr_pages);
+void bdi_wakeup_flushers(void);
+void bdi_stop_flusher(struct backing_dev_info *bdi);
+
+/* fs/fs-writeback.c */
+int bdi_has_dirty_inodes(struct backing_dev_info *bdi);
+
 static inline int bdi_congested(struct backing_dev_info *bdi, int bdi_bits)
 {
 	if (bdi->congested_fn)
@@ -0,0 +1,102 @@
+/*
+ *  include/linux/clockchips.h
+ *
+ *  Clock event devices: hardware which can be programmed to raise an
+ *  interrupt at a given point in the future, like the local APIC timer.
+ *  The hrtimer code uses a oneshot device of the local CPU to run its
+ *  timers at their exact expiry time. See kernel/clockevents.c.
+ */
+#ifndef _LINUX_CLOCKCHIPS_H
+#define _LINUX_CLOCKCHIPS_H
+
+#include <linux/config.h>
+
+#ifdef CONFIG_HIGH_RES_TIMERS
+
+#include <linux/cpumask.h>
+#include <linux/ktime.h>
+
+struct clock_event_device;
+struct pt_regs;
+
+/* Clock event mode commands */
+enum clock_event_mode {
+	CLOCK_EVT_MODE_UNUSED = 0,
+	CLOCK_EVT_MODE_SHUTDOWN,
+	CLOCK_EVT_MODE_PERIODIC,
+	CLOCK_EVT_MODE_ONESHOT,
+};
+
+/* Clock event features */
+#define CLOCK_EVT_FEAT_PERIODIC		0x000001
+#define CLOCK_EVT_FEAT_ONESHOT		0x000002
+
+/**
+ * struct clock_event_device - clock event device descriptor
+ * @name:		ptr to clock event name
+ * @features:		features (CLOCK_EVT_FEAT_*)
+ * @max_delta_ns:	maximum delta value in ns
+ * @min_delta_ns:	minimum delta value in ns
+ * @mult:		nanosecond to cycles multiplier
+ * @shift:		nanoseconds to cycles divisor (power of two)
+ * @rating:		variable to rate clock event devices
+ * @cpumask:		cpumask to indicate for which cpus this device works
+ * @set_next_event:	set next event function, delta in device cycles
+ * @set_mode:		set mode function
+ * @event_handler:	called from the device's interrupt handler, with the
+ *			interrupted register state
+ * @next_event:		local storage for the next event in oneshot mode
+ * @mode:		operating mode assigned by the management code
+ */
+struct clock_event_device {
+	const char		*name;
+	unsigned int		features;
+	unsigned long		max_delta_ns;
+	unsigned long		min_delta_ns;
+	unsigned long		mult;
+	int			shift;
+	int			rating;
+	cpumask_t		cpumask;
+	int			(*set_next_event)(unsigned long evt,
+						  struct clock_event_device *);
+	void			(*set_mode)(enum clock_event_mode mode,
+					    struct clock_event_device *);
+	void			(*event_handler)(struct clock_event_device *,
+						 struct pt_regs *);
+	ktime_t			next_event;
+	enum clock_event_mode	mode;
+};
+
+/*
+ * Calculate a multiplication factor for scaled math, which is used to
+ * convert nanoseconds based values to clock ticks:
+ *
+ * clock_ticks = (nanoseconds * factor) >> shift.
+ *
+ * div_sc is the rearranged equation to calculate a factor from a given
+ * clock ticks / nanoseconds ratio:
+ *
+ * factor = (clock_ticks << shift) / nanoseconds
+ */
+static inline unsigned long div_sc(unsigned long ticks, unsigned long nsec,
+				   int shift)
+{
+	u64 tmp = ((u64)ticks) << shift;
+
+	do_div(tmp, nsec);
+	return (unsigned long) tmp;
+}
+
+/* Clock event layer functions */
+extern unsigned long clockevent_delta2ns(unsigned long latch,
+					 struct clock_event_device *evt);
+extern void clockevents_register_device(struct clock_event_device *dev);
+extern void clockevents_set_mode(struct clock_event_device *dev,
+				 enum clock_event_mode mode);
+extern int clockevents_program_event(struct clock_event_device *dev,
+				     ktime_t expires, ktime_t now);
+extern struct clock_event_device *clockevents_local_device(void);
+
+#endif /* CONFIG_HIGH_RES_TIMERS */
+
+#endif
@@ -0,0 +1,34 @@
+#ifndef _LINUX_COMPACTION_H
+#define _LINUX_COMPACTION_H
+/*
+ * Declarations for memory compaction, see mm/compaction.c
+ */
+
+#include <linux/config.h>
+#include <linux/mmzone.h>
+
+/* Return values of compact_zone() */
+#define COMPACT_CONTINUE	0	/* keep scanning */
+#define COMPACT_PARTIAL		1	/* the requested order is available */
+#define COMPACT_COMPLETE	2	/* the scanners met */
+
+struct ctl_table;
+struct file;
+
+#ifdef CONFIG_COMPACTION
+extern int sysctl_compact_memory;
+extern int sysctl_compaction_handler(struct ctl_table *table, int write,
+			struct file *file, void __user *buffer,
+			size_t *length, loff_t *ppos);
+
+extern int try_to_compact_pages(struct zone **zones, int order,
+				gfp_t gfp_mask);
+#else
+static inline int try_to_compact_pages(struct zone **zones, int order,
+				       gfp_t gfp_mask)
+{
+	return 0;
+}
+#endif
+
+#endif	/* _LINUX_COMPACTION_H */
@@ -8,6 +8,7 @@
 #include <linux/spinlock.h>
 #include <linux/cache.h>
 #include <linux/rcupdate.h>
+#include <linux/seqlock.h>
 #include <asm/bug.h>
 
 struct nameidata;
@@ -84,6 +85,7 @@ struct dentry {
 	atomic_t d_count;
 	unsigned int d_flags;		/* protected by d_lock */
 	spinlock_t d_lock;		/* per dentry lock */
+	seqcount_t d_seq;		/* per dentry seqcount, see below */
 	struct inode *d_inode;		/* Where the name belongs to - NULL is
 					 * negative */
 	/*
@@ -108,6 +110,13 @@ struct dentry {
 	unsigned char d_iname[DNAME_INLINE_LEN_MIN];	/* small names */
 };
 
+/*
+ * d_seq is bumped (under d_lock) whenever d_name, d_parent or d_inode
+ * change in a way a lockless reader must notice: d_move() renaming the
+ * dentry, __d_drop() unhashing it and dentry_iput() making it negative.
+ * The RCU path walk in fs/namei.c validates each component against it.
+ */
+
 struct dentry_operations {
 	int (*d_revalidate)(struct dentry *, struct nameidata *);
 	int (*d_hash) (struct dentry *, struct qstr *);
@@ -173,14 +182,7 @@ extern spinlock_t dcache_lock;
  *
  * __d_drop requires dentry->d_lock.
  */
-
-static inline void __d_drop(struct dentry *dentry)
-{
-	if (!(dentry->d_flags & DCACHE_UNHASHED)) {
-		dentry->d_flags |= DCACHE_UNHASHED;
-		hlist_del_rcu(&dentry->d_hash);
-	}
-}
+extern void __d_drop(struct dentry *dentry);
 
 static inline void d_drop(struct dentry *dentry)
 {
@@ -267,6 +269,7 @@ extern void d_move(struct dentry *, struct dentry *);
 /* appendix may either be NULL or be used for transname suffixes */
 extern struct dentry * d_lookup(struct dentry *, struct qstr *);
 extern struct dentry * __d_lookup(struct dentry *, struct qstr *);
+extern struct dentry * __d_lookup_rcu(struct dentry *, struct qstr *, unsigned *);
 
 /* validate "insecure" dentry pointer */
 extern int d_validate(struct dentry *, struct dentry *);
@@ -229,6 +229,8 @@ struct poll_table_struct;
 struct kstatfs;
 struct vm_area_struct;
 struct vfsmount;
+struct inode_hash_bucket;
+struct ctl_table;
 
 /* Used to be a macro which just called the function, now just a function */
 extern void update_atime (struct inode *);
@@ -331,13 +333,14 @@ struct backing_dev_info;
 struct address_space {
 	struct inode		*host;		/* owner: inode, block_device */
 	struct radix_tree_root	page_tree;	/* radix tree of all pages */
-	rwlock_t		tree_lock;	/* and rwlock protecting it */
+	spinlock_t		tree_lock;	/* and lock protecting it */
 	unsigned int		i_mmap_writable;/* count VM_SHARED mappings */
 	struct prio_tree_root	i_mmap;		/* tree of private and shared mappings */
 	struct list_head	i_mmap_nonlinear;/*list VM_NONLINEAR mappings */
 	spinlock_t		i_mmap_lock;	/* protect tree, count, list */
 	unsigned int		truncate_count;	/* Cover race condition with truncate */
 	unsigned long		nrpages;	/* number of total pages */
+	unsigned long		nrshadows;	/* evicted pages' shadow entries */
 	pgoff_t			writeback_index;/* writeback starts here */
 	struct address_space_operations *a_ops;	/* methods */
 	unsigned long		flags;		/* error bits/gfp mask */
@@ -421,8 +424,10 @@ static inline int mapping_writably_mapped(struct address_space *mapping)
 
 struct inode {
 	struct hlist_node	i_hash;
+	struct inode_hash_bucket *i_hash_bucket; /* NULL unless on inode hash */
 	struct list_head	i_list;
 	struct list_head	i_sb_list;
+	struct list_head	i_lru;		/* unreferenced inodes */
 	struct list_head	i_dentry;
 	unsigned long		i_ino;
 	atomic_t		i_count;
@@ -559,22 +564,19 @@ struct fown_struct {
  * Track a single file's readahead state
  */
 struct file_ra_state {
-	unsigned long start;		/* Current window */
-	unsigned long size;
-	unsigned long flags;		/* ra flags RA_FLAG_xxx*/
-	unsigned long cache_hit;	/* cache hit count*/
+	pgoff_t start;			/* where readahead started */
+	unsigned long size;		/* # of readahead pages */
+	unsigned long async_size;	/* do asynchronous readahead when
+					   there are only # of pages ahead */
 	unsigned long prev_page;	/* Cache last read() position */
-	unsigned long ahead_start;	/* Ahead window */
-	unsigned long ahead_size;
 	unsigned long ra_pages;		/* Maximum readahead window */
 	unsigned long mmap_hit;		/* Cache hit stat for mmap accesses */
 	unsigned long mmap_miss;	/* Cache miss stat for mmap accesses */
 };
-#define RA_FLAG_MISS 0x01	/* a cache miss occured against this file */
-#define RA_FLAG_INCACHE 0x02	/* file is already in cache */
 
 struct file {
 	struct list_head	f_list;
+	int			f_sb_list_cpu;	/* -1 unless on an s_files list */
 	struct dentry		*f_dentry;
 	struct vfsmount         *f_vfsmnt;
 	struct file_operations	*f_op;
@@ -600,10 +602,27 @@ struct file {
 	struct address_space	*f_mapping;
 	struct rcu_head 	f_rcuhead;
 };
+/* files_lock protects the tty_files lists; see fs/file_table.c */
 extern spinlock_t files_lock;
 #define file_list_lock() spin_lock(&files_lock);
 #define file_list_unlock() spin_unlock(&files_lock);
 
+/* sb->s_files is split into one list per CPU; walk it with these */
+extern void file_list_lock_all(void);
+extern void file_list_unlock_all(void);
+
+#define do_file_list_for_each_entry(__sb, __file)		\
+{								\
+	int __cpu;						\
+	for_each_cpu(__cpu) {					\
+		struct list_head *__list;			\
+		__list = per_cpu_ptr((__sb)->s_files, __cpu);	\
+		list_for_each_entry((__file), __list, f_list)
+
+#define while_file_list_for_each_entry				\
+	}							\
+}
+
 #define get_file(x)	rcuref_inc(&(x)->f_count)
 #define file_count(x)	atomic_read(&(x)->f_count)
 
@@ -780,11 +799,12 @@ struct super_block {
 	void                    *s_security;
 	struct xattr_handler	**s_xattr;
 
+	spinlock_t		s_inode_list_lock;
 	struct list_head	s_inodes;	/* all inodes */
 	struct list_head	s_dirty;	/* dirty inodes */
 	struct list_head	s_io;		/* parked for writeback */
 	struct hlist_head	s_anon;		/* anonymous dentries for (nfs) exporting */
-	struct list_head	s_files;
+	struct list_head	*s_files;	/* per-cpu open files lists */
 
 	struct block_device	*s_bdev;
 	struct list_head	s_instances;
@@ -1460,6 +1480,14 @@ static inline struct inode *iget(struct super_block *sb, unsigned long ino)
 }
 
 extern void __iget(struct inode * inode);
+extern int inode_set_freeing(struct inode *, unsigned long);
+extern int get_nr_inodes_unused(void);
+extern int proc_nr_inodes(struct ctl_table *, int, struct file *,
+			  void __user *, size_t *, loff_t *);
+extern void inode_lru_add(struct inode *);
+extern void inode_lru_del(struct inode *);
+extern void inode_sb_list_add(struct inode *);
+extern void inode_sb_list_del(struct inode *);
 extern void clear_inode(struct inode *);
 extern void destroy_inode(struct inode *);
 extern struct inode *new_inode(struct super_block *);
@@ -1474,6 +1502,7 @@ static inline void insert_inode_hash(struct inode *inode) {
 }
 
 extern struct file * get_empty_filp(void);
+extern void file_sb_list_add(struct file *f, struct super_block *sb);
 extern void file_move(struct file *f, struct list_head *list);
 extern void file_kill(struct file *f);
 struct bio;
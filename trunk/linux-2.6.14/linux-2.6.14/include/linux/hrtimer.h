@@ -0,0 +1,198 @@
+/*
+ *  include/linux/hrtimer.h
+ *
+ *  hrtimers - High-resolution kernel timers
+ *
+ *  hrtimers are kept sorted by expiry time in a red-black tree per
+ *  clock and per CPU, with nanosecond expiry times in ktime_t format.
+ *  They are meant for events that are expected to fire, like
+ *  nanosleep and the interval timers, whereas the timer wheel in
+ *  kernel/timer.c stays the right place for timeouts that are usually
+ *  removed before they expire.
+ *
+ *  Without a oneshot clock event device the timers are run from the
+ *  timer softirq, i.e. with jiffies resolution. See kernel/hrtimer.c.
+ */
+#ifndef _LINUX_HRTIMER_H
+#define _LINUX_HRTIMER_H
+
+#include <linux/config.h>
+#include <linux/rbtree.h>
+#include <linux/ktime.h>
+#include <linux/init.h>
+#include <linux/list.h>
+#include <linux/spinlock.h>
+
+/*
+ * Mode arguments of xxx_hrtimer functions:
+ */
+enum hrtimer_mode {
+	HRTIMER_ABS,	/* Time value is absolute */
+	HRTIMER_REL,	/* Time value is relative to now */
+};
+
+/*
+ * Return values of the timer callback function:
+ */
+enum hrtimer_restart {
+	HRTIMER_NORESTART,	/* Timer is not restarted */
+	HRTIMER_RESTART,	/* Timer must be restarted */
+};
+
+struct hrtimer_clock_base;
+struct restart_block;
+struct task_struct;
+
+/*
+ * A timer which is not queued has its rb_parent set to HRTIMER_INACTIVE:
+ */
+#define HRTIMER_INACTIVE	((void *)1UL)
+
+/**
+ * struct hrtimer - the basic hrtimer structure
+ *
+ * @node:	red black tree node for time ordered insertion
+ * @expires:	the absolute expiry time in the hrtimers internal
+ *		representation. The time is related to the clock on
+ *		which the timer is based.
+ * @function:	timer expiry callback function. It returns
+ *		HRTIMER_RESTART when the timer is to be requeued with
+ *		the (forwarded) expiry time.
+ * @base:	pointer to the timer base (per cpu and per clock)
+ *
+ * The callback runs with interrupts disabled, from the timer softirq
+ * or from the clock event interrupt, so it must not sleep.
+ */
+struct hrtimer {
+	struct rb_node			node;
+	ktime_t				expires;
+	int				(*function)(struct hrtimer *);
+	struct hrtimer_clock_base	*base;
+};
+
+/**
+ * struct hrtimer_sleeper - simple sleeper structure
+ *
+ * @timer:	embedded timer structure
+ * @task:	task to wake up
+ *
+ * task is set to NULL, when the timer expires.
+ */
+struct hrtimer_sleeper {
+	struct hrtimer			timer;
+	struct task_struct		*task;
+};
+
+struct hrtimer_cpu_base;
+
+/**
+ * struct hrtimer_clock_base - the timer base for a specific clock
+ *
+ * @cpu_base:		per cpu base this clock base belongs to
+ * @index:		clock type index for per_cpu support when moving a
+ *			timer to a base on another cpu.
+ * @active:		red black tree root node for the active timers
+ * @first:		pointer to the timer node which expires first
+ * @resolution:		the resolution of the clock, in nanoseconds
+ * @get_time:		function to retrieve the current time of the clock
+ */
+struct hrtimer_clock_base {
+	struct hrtimer_cpu_base	*cpu_base;
+	clockid_t		index;
+	struct rb_root		active;
+	struct rb_node		*first;
+	ktime_t			resolution;
+	ktime_t			(*get_time)(void);
+};
+
+#define HRTIMER_MAX_CLOCK_BASES	2
+
+/**
+ * struct hrtimer_cpu_base - the per cpu clock bases
+ *
+ * @lock:		lock protecting the bases and associated timers
+ * @clock_base:		array of clock bases for this cpu
+ * @curr_timer:		the timer whose callback is running right now
+ * @expires_next:	absolute CLOCK_MONOTONIC time of the next event the
+ *			clock event device is programmed for (high
+ *			resolution mode only)
+ * @hres_active:	set once this cpu runs its timers from a oneshot
+ *			clock event device
+ * @sched_timer:	timer which emulates the periodic per cpu tick in
+ *			high resolution mode
+ * @tick_stopped:	set while the idle cpu has pushed @sched_timer out
+ *			to its next timer event
+ * @idle_tick:		expiry time of the first tick the idle cpu skipped
+ * @idle_jiffies:	jiffies when the tick was stopped
+ * @skipped_ticks:	number of ticks the cpu did not take while idle
+ */
+struct hrtimer_cpu_base {
+	spinlock_t			lock;
+	struct hrtimer_clock_base	clock_base[HRTIMER_MAX_CLOCK_BASES];
+	struct hrtimer			*curr_timer;
+#ifdef CONFIG_HIGH_RES_TIMERS
+	ktime_t				expires_next;
+	int				hres_active;
+	struct hrtimer			sched_timer;
+#endif
+#ifdef CONFIG_NO_IDLE_HZ
+	int				tick_stopped;
+	ktime_t				idle_tick;
+	unsigned long			idle_jiffies;
+	unsigned long			skipped_ticks;
+#endif
+};
+
+/* Exported timer functions: */
+
+/* Initialize timers: */
+extern void hrtimer_init(struct hrtimer *timer, clockid_t which_clock,
+			 enum hrtimer_mode mode);
+
+/* Basic timer operations: */
+extern int hrtimer_start(struct hrtimer *timer, ktime_t tim,
+			 const enum hrtimer_mode mode);
+extern int hrtimer_cancel(struct hrtimer *timer);
+extern int hrtimer_try_to_cancel(struct hrtimer *timer);
+
+#define hrtimer_restart(timer) hrtimer_start((timer), (timer)->expires, HRTIMER_ABS)
+
+/* Query timers: */
+extern ktime_t hrtimer_get_remaining(const struct hrtimer *timer);
+extern int hrtimer_get_res(const clockid_t which_clock, struct timespec *tp);
+
+static inline int hrtimer_active(const struct hrtimer *timer)
+{
+	return timer->node.rb_parent != HRTIMER_INACTIVE;
+}
+
+/* Forward a hrtimer so it expires after now: */
+extern unsigned long hrtimer_forward(struct hrtimer *timer, ktime_t interval);
+
+/* Precise sleep: */
+extern long hrtimer_nanosleep(struct timespec *rqtp, struct timespec *rem,
+			      const enum hrtimer_mode mode,
+			      const clockid_t clockid);
+extern long hrtimer_nanosleep_restart(struct restart_block *restart,
+				      struct timespec *rem);
+
+extern void hrtimer_init_sleeper(struct hrtimer_sleeper *sl,
+				 struct task_struct *tsk);
+
+/* Soft interrupt function to run the hrtimer queues: */
+extern void hrtimer_run_queues(void);
+
+/* Stop and restart the tick of an idle cpu: */
+#ifdef CONFIG_NO_IDLE_HZ
+extern void hrtimer_stop_sched_tick(void);
+extern void hrtimer_restart_sched_tick(void);
+extern unsigned long hrtimer_skipped_ticks(int cpu);
+#else
+static inline void hrtimer_stop_sched_tick(void) { }
+static inline void hrtimer_restart_sched_tick(void) { }
+#endif
+
+/* Bootup initialization: */
+extern void __init hrtimers_init(void);
+
+#endif
@@ -0,0 +1,127 @@
+#ifndef _LINUX_HUGE_MM_H
+#define _LINUX_HUGE_MM_H
+/*
+ * Declarations for transparent huge pages, see mm/huge_memory.c
+ */
+
+#include <linux/config.h>
+#include <linux/mm.h>
+
+struct mmu_gather;
+
+/*
+ * Returned by the huge pmd fault handlers, with the page_table_lock
+ * still held, when the fault is to be handled with small pages.
+ */
+#define VM_FAULT_FALLBACK	0x20
+
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+#define HPAGE_PMD_SHIFT	PMD_SHIFT
+#define HPAGE_PMD_SIZE	(1UL << HPAGE_PMD_SHIFT)
+#define HPAGE_PMD_MASK	(~(HPAGE_PMD_SIZE - 1))
+#define HPAGE_PMD_ORDER	(HPAGE_PMD_SHIFT - PAGE_SHIFT)
+#define HPAGE_PMD_NR	(1 << HPAGE_PMD_ORDER)
+
+extern int transparent_hugepage_vma(struct vm_area_struct *vma,
+				    unsigned long address);
+extern int do_huge_pmd_anonymous_page(struct mm_struct *mm,
+			struct vm_area_struct *vma, unsigned long address,
+			pmd_t *pmd, int write_access);
+extern int do_huge_pmd_fault(struct mm_struct *mm, struct vm_area_struct *vma,
+			unsigned long address, pmd_t *pmd, int write_access);
+extern int copy_huge_pmd(struct mm_struct *dst_mm, struct mm_struct *src_mm,
+			pmd_t *dst_pmd, pmd_t *src_pmd, unsigned long addr,
+			unsigned long end);
+extern void zap_huge_pmd(struct mmu_gather *tlb, pmd_t *pmd);
+extern struct page *follow_trans_huge_pmd(pmd_t *pmd, unsigned long address,
+			int write, int accessed);
+extern void __split_huge_pmd(struct mm_struct *mm, pmd_t *pmd,
+			     unsigned long address);
+extern void split_huge_pmd_page(struct mm_struct *mm, pmd_t *pmd,
+			unsigned long address, struct page *page);
+extern int huge_pmd_maps_page(pmd_t *pmd, unsigned long address,
+			struct page *page);
+extern int pmdp_clear_flush_young(struct vm_area_struct *vma,
+			unsigned long address, pmd_t *pmd);
+extern int hugepage_madvise(struct vm_area_struct *vma,
+			    unsigned long *vm_flags, int advice);
+extern void khugepaged_enter(struct mm_struct *mm);
+extern void khugepaged_exit(struct mm_struct *mm);
+
+/*
+ * Walkers which do not hold the page_table_lock can race with a fault
+ * installing a huge pmd: read the pmd once, and leave huge ones alone.
+ */
+static inline int pmd_none_or_trans_huge_or_clear_bad(pmd_t *pmd)
+{
+	pmd_t pmdval = *pmd;
+
+	barrier();
+	if (pmd_none(pmdval) || pmd_trans_huge(pmdval))
+		return 1;
+	if (unlikely(pmd_bad(pmdval))) {
+		pmd_clear_bad(pmd);
+		return 1;
+	}
+	return 0;
+}
+#else
+/* Only reached from code behind pmd_trans_huge() */
+#define HPAGE_PMD_SIZE	({ BUG(); 0; })
+
+#define pmd_trans_huge(pmd)	0
+#define pmd_none_or_trans_huge_or_clear_bad(pmd) pmd_none_or_clear_bad(pmd)
+
+static inline int transparent_hugepage_vma(struct vm_area_struct *vma,
+					   unsigned long address)
+{
+	return 0;
+}
+static inline int do_huge_pmd_anonymous_page(struct mm_struct *mm,
+			struct vm_area_struct *vma, unsigned long address,
+			pmd_t *pmd, int write_access)
+{
+	return 0;
+}
+static inline int do_huge_pmd_fault(struct mm_struct *mm,
+			struct vm_area_struct *vma, unsigned long address,
+			pmd_t *pmd, int write_access)
+{
+	return 0;
+}
+static inline int copy_huge_pmd(struct mm_struct *dst_mm,
+			struct mm_struct *src_mm, pmd_t *dst_pmd,
+			pmd_t *src_pmd, unsigned long addr, unsigned long end)
+{
+	return 0;
+}
+static inline void zap_huge_pmd(struct mmu_gather *tlb, pmd_t *pmd) { }
+static inline struct page *follow_trans_huge_pmd(pmd_t *pmd,
+			unsigned long address, int write, int accessed)
+{
+	return NULL;
+}
+static inline void __split_huge_pmd(struct mm_struct *mm, pmd_t *pmd,
+				    unsigned long address) { }
+static inline void split_huge_pmd_page(struct mm_struct *mm, pmd_t *pmd,
+			unsigned long address, struct page *page) { }
+static inline int huge_pmd_maps_page(pmd_t *pmd, unsigned long address,
+			struct page *page)
+{
+	return 0;
+}
+static inline int pmdp_clear_flush_young(struct vm_area_struct *vma,
+			unsigned long address, pmd_t *pmd)
+{
+	return 0;
+}
+static inline int hugepage_madvise(struct vm_area_struct *vma,
+				   unsigned long *vm_flags, int advice)
+{
+	return -EINVAL;
+}
+static inline void khugepaged_enter(struct mm_struct *mm) { }
+static inline void khugepaged_exit(struct mm_struct *mm) { }
+#endif
+
+#endif	/* _LINUX_HUGE_MM_H */
@@ -0,0 +1,65 @@
+#ifndef _LINUX_KSM_H
+#define _LINUX_KSM_H
+/*
+ * Declarations for merging identical anonymous pages, see mm/ksm.c
+ */
+
+#include <linux/config.h>
+#include <linux/mm.h>
+#include <linux/sched.h>
+
+struct stable_node;
+
+#ifdef CONFIG_KSM
+extern int ksm_madvise(struct vm_area_struct *vma, unsigned long start,
+		       unsigned long end, int advice, unsigned long *vm_flags);
+extern void __ksm_enter(struct mm_struct *mm);
+extern void ksm_exit(struct mm_struct *mm);
+extern int page_referenced_ksm(struct page *page, int ignore_token);
+
+/* A child of an mm ksmd scans has the same mergeable vmas */
+static inline void ksm_fork(struct mm_struct *mm, struct mm_struct *oldmm)
+{
+	if (!list_empty(&oldmm->ksm_list))
+		__ksm_enter(mm);
+}
+
+/*
+ * A KSM page is a write protected anonymous page which ksmd merged
+ * identical pages into.  Its page->mapping points to its node in the
+ * stable tree, tagged with PAGE_MAPPING_ANON and PAGE_MAPPING_KSM.
+ */
+static inline int PageKsm(struct page *page)
+{
+	return ((unsigned long)page->mapping & PAGE_MAPPING_FLAGS) ==
+		(PAGE_MAPPING_ANON | PAGE_MAPPING_KSM);
+}
+
+static inline struct stable_node *page_stable_node(struct page *page)
+{
+	return (struct stable_node *)
+		((unsigned long)page->mapping & ~PAGE_MAPPING_FLAGS);
+}
+
+static inline void set_page_stable_node(struct page *page,
+					struct stable_node *stable_node)
+{
+	page->mapping = (struct address_space *)((unsigned long)stable_node |
+				PAGE_MAPPING_ANON | PAGE_MAPPING_KSM);
+}
+#else
+static inline void ksm_fork(struct mm_struct *mm, struct mm_struct *oldmm) { }
+static inline void ksm_exit(struct mm_struct *mm) { }
+
+static inline int PageKsm(struct page *page)
+{
+	return 0;
+}
+
+static inline int page_referenced_ksm(struct page *page, int ignore_token)
+{
+	return 0;
+}
+#endif
+
+#endif	/* _LINUX_KSM_H */
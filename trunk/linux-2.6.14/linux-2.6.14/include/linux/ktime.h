@@ -0,0 +1,112 @@
+/*
+ *  include/linux/ktime.h
+ *
+ *  ktime_t - nanosecond-resolution time format.
+ *
+ *  A ktime_t is a signed 64-bit count of nanoseconds. It is used by the
+ *  hrtimer code to hold both absolute times (relative to the timer's
+ *  clock) and intervals. 2^63 nanoseconds is ~292 years, so there is
+ *  no wraparound to worry about.
+ *
+ *  The helpers below hide the representation; code outside of
+ *  kernel/hrtimer.c should use them rather than do arithmetic on
+ *  ktime_t directly.
+ */
+#ifndef _LINUX_KTIME_H
+#define _LINUX_KTIME_H
+
+#include <linux/time.h>
+#include <linux/jiffies.h>
+#include <asm/div64.h>
+
+typedef s64 ktime_t;
+
+#define KTIME_MAX			((s64)~((u64)1 << 63))
+#define KTIME_SEC_MAX			(KTIME_MAX / NSEC_PER_SEC)
+
+/*
+ * Resolution of the timer bases when they are driven from the periodic
+ * tick, and when they are driven from a oneshot clock event device:
+ */
+#define KTIME_LOW_RES			((ktime_t)TICK_NSEC)
+#define KTIME_HIGH_RES			((ktime_t)1)
+
+static inline ktime_t ktime_set(const long secs, const unsigned long nsecs)
+{
+	if (unlikely(secs >= KTIME_SEC_MAX))
+		return KTIME_MAX;
+	return (s64)secs * NSEC_PER_SEC + (s64)nsecs;
+}
+
+#define ktime_add(lhs, rhs)		((lhs) + (rhs))
+#define ktime_sub(lhs, rhs)		((lhs) - (rhs))
+#define ktime_add_ns(kt, nsval)		((kt) + (s64)(nsval))
+
+static inline ktime_t timespec_to_ktime(const struct timespec ts)
+{
+	return ktime_set(ts.tv_sec, ts.tv_nsec);
+}
+
+static inline ktime_t timeval_to_ktime(const struct timeval tv)
+{
+	return ktime_set(tv.tv_sec, tv.tv_usec * NSEC_PER_USEC);
+}
+
+static inline s64 ktime_to_ns(const ktime_t kt)
+{
+	return kt;
+}
+
+/*
+ * Divide a ktime_t by a nanosecond value. Both must be positive; the
+ * divisor is truncated to 32 bits if it does not fit, which the timer
+ * code only ever does for intervals above four seconds where the lost
+ * precision does not matter.
+ */
+static inline u64 ktime_divns(const ktime_t kt, s64 div)
+{
+	u64 dclc = (u64)kt;
+	int sft = 0;
+
+	/* Make sure the divisor is less than 2^32 */
+	while (div >> 32) {
+		sft++;
+		div >>= 1;
+	}
+	dclc >>= sft;
+	do_div(dclc, (unsigned long)div);
+	return dclc;
+}
+
+static inline struct timespec ktime_to_timespec(const ktime_t kt)
+{
+	struct timespec ts;
+	u64 nsec = (u64)(kt < 0 ? -kt : kt);
+	u32 rem;
+
+	rem = do_div(nsec, NSEC_PER_SEC);
+	ts.tv_sec = (time_t)nsec;
+	ts.tv_nsec = rem;
+	if (kt < 0)
+		set_normalized_timespec(&ts, -ts.tv_sec, -ts.tv_nsec);
+	return ts;
+}
+
+static inline struct timeval ktime_to_timeval(const ktime_t kt)
+{
+	struct timespec ts = ktime_to_timespec(kt);
+	struct timeval tv;
+
+	tv.tv_sec = ts.tv_sec;
+	tv.tv_usec = ts.tv_nsec / NSEC_PER_USEC;
+	return tv;
+}
+
+/* Get the monotonic time in timespec format: */
+extern void ktime_get_ts(struct timespec *ts);
+
+/* Get the current time of CLOCK_MONOTONIC and CLOCK_REALTIME: */
+extern ktime_t ktime_get(void);
+extern ktime_t ktime_get_real(void);
+
+#endif
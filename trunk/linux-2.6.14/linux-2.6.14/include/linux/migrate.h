@@ -0,0 +1,36 @@
+#ifndef _LINUX_MIGRATE_H
+#define _LINUX_MIGRATE_H
+/*
+ * Declarations for page migration, see mm/migrate.c
+ */
+
+#include <linux/config.h>
+#include <linux/list.h>
+#include <linux/mm.h>
+
+/*
+ * Allocates the page the contents of @page are to be moved to; @private
+ * is passed through from migrate_pages().
+ */
+typedef struct page *new_page_t(struct page *page, unsigned long private);
+
+#ifdef CONFIG_MIGRATION
+extern int isolate_lru_page(struct page *page, struct list_head *pagelist);
+extern void putback_lru_pages(struct list_head *l);
+extern int migrate_pages(struct list_head *l, new_page_t get_new_page,
+			 unsigned long private);
+#else
+static inline int isolate_lru_page(struct page *page,
+				   struct list_head *pagelist)
+{
+	return -ENOSYS;
+}
+static inline void putback_lru_pages(struct list_head *l) { }
+static inline int migrate_pages(struct list_head *l, new_page_t get_new_page,
+				unsigned long private)
+{
+	return -ENOSYS;
+}
+#endif
+
+#endif	/* _LINUX_MIGRATE_H */
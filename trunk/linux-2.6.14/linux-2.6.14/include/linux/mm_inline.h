@@ -1,40 +1,76 @@
+/*
+ * Pages which are backed by swap, anonymous memory, swap cache and shmem,
+ * age on the anon LRU lists, all others on the file LRU lists.
+ * PG_swapbacked is set before the page first goes on the LRU and is
+ * left alone until the page is freed, so the list a page is on can be
+ * told from its flags.
+ */
+static inline int page_is_file_cache(struct page *page)
+{
+	return !PageSwapBacked(page);
+}
+
+static inline enum lru_list page_lru_base_type(struct page *page)
+{
+	if (page_is_file_cache(page))
+		return LRU_INACTIVE_FILE;
+	return LRU_INACTIVE_ANON;
+}
+
+/* The LRU list an LRU page is on, or an isolated page should go back to */
+static inline enum lru_list page_lru(struct page *page)
+{
+	if (PageUnevictable(page))
+		return LRU_UNEVICTABLE;
+	if (PageActive(page))
+		return page_lru_base_type(page) + LRU_ACTIVE;
+	return page_lru_base_type(page);
+}
+
+static inline void
+add_page_to_lru_list(struct zone *zone, struct page *page, enum lru_list l)
+{
+	list_add(&page->lru, &zone->lru[l].list);
+	zone->lru[l].nr_pages++;
+}
+
+static inline void
+del_page_from_lru_list(struct zone *zone, struct page *page, enum lru_list l)
+{
+	list_del(&page->lru);
+	zone->lru[l].nr_pages--;
+}
 
 static inline void
 add_page_to_active_list(struct zone *zone, struct page *page)
 {
-	list_add(&page->lru, &zone->active_list);
-	zone->nr_active++;
+	add_page_to_lru_list(zone, page, page_lru_base_type(page) + LRU_ACTIVE);
 }
 
 static inline void
 add_page_to_inactive_list(struct zone *zone, struct page *page)
 {
-	list_add(&page->lru, &zone->inactive_list);
-	zone->nr_inactive++;
+	add_page_to_lru_list(zone, page, page_lru_base_type(page));
 }
 
 static inline void
 del_page_from_active_list(struct zone *zone, struct page *page)
 {
-	list_del(&page->lru);
-	zone->nr_active--;
+	del_page_from_lru_list(zone, page, page_lru_base_type(page) + LRU_ACTIVE);
 }
 
 static inline void
 del_page_from_inactive_list(struct zone *zone, struct page *page)
 {
-	list_del(&page->lru);
-	zone->nr_inactive--;
+	del_page_from_lru_list(zone, page, page_lru_base_type(page));
 }
 
 static inline void
 del_page_from_lru(struct zone *zone, struct page *page)
 {
-	list_del(&page->lru);
-	if (PageActive(page)) {
+	del_page_from_lru_list(zone, page, page_lru(page));
+	if (PageActive(page))
 		ClearPageActive(page);
-		zone->nr_active--;
-	} else {
-		zone->nr_inactive--;
-	}
+	if (PageUnevictable(page))
+		ClearPageUnevictable(page);
 }
@@ -21,13 +21,70 @@
 #define MAX_ORDER CONFIG_FORCE_MAX_ZONEORDER
 #endif
 
+/*
+ * Free pages are kept on separate lists by the mobility of the
+ * allocations their block of pages is used for, so that the pages
+ * which can never be moved or reclaimed collect in as few blocks as
+ * possible and leave the others free to coalesce into large blocks.
+ */
+#define MIGRATE_UNMOVABLE	0
+#define MIGRATE_RECLAIMABLE	1
+#define MIGRATE_MOVABLE		2
+#define MIGRATE_TYPES		3
+
+#define for_each_migratetype_order(order, type) \
+	for (order = 0; order < MAX_ORDER; order++) \
+		for (type = 0; type < MIGRATE_TYPES; type++)
+
+/*
+ * The unit the migrate type is kept for: one block of the largest
+ * order, so that a block never coalesces with a block of another type.
+ */
+#define pageblock_order		(MAX_ORDER - 1)
+#define pageblock_nr_pages	(1UL << pageblock_order)
+
+/* Bits per block in zone->pageblock_flags */
+#define NR_PAGEBLOCK_BITS	2
+
 struct free_area {
-	struct list_head	free_list;
+	struct list_head	free_list[MIGRATE_TYPES];
 	unsigned long		nr_free;
 };
 
 struct pglist_data;
 
+/*
+ * Pages on the LRU are kept on separate lists for swap backed (anon) and
+ * file backed memory, so that the two can be aged at different rates.
+ * Pages which reclaim can do nothing about sit on the unevictable list.
+ * The order matters: LRU_ACTIVE and LRU_FILE are offsets into it.
+ */
+#define LRU_ACTIVE	1
+#define LRU_FILE	2
+
+enum lru_list {
+	LRU_INACTIVE_ANON,
+	LRU_ACTIVE_ANON = LRU_INACTIVE_ANON + LRU_ACTIVE,
+	LRU_INACTIVE_FILE = LRU_INACTIVE_ANON + LRU_FILE,
+	LRU_ACTIVE_FILE = LRU_INACTIVE_FILE + LRU_ACTIVE,
+	LRU_UNEVICTABLE,
+	NR_LRU_LISTS
+};
+
+#define for_each_lru(l) for (l = 0; l < NR_LRU_LISTS; l++)
+
+#define for_each_evictable_lru(l) for (l = 0; l <= LRU_ACTIVE_FILE; l++)
+
+static inline int is_file_lru(enum lru_list l)
+{
+	return l == LRU_INACTIVE_FILE || l == LRU_ACTIVE_FILE;
+}
+
+static inline int is_active_lru(enum lru_list l)
+{
+	return l == LRU_ACTIVE_ANON || l == LRU_ACTIVE_FILE;
+}
+
 /*
  * zone->lock and zone->lru_lock are two of the hottest locks in the kernel.
  * So add a wild amount of padding here to ensure that they fall into separate
@@ -48,6 +105,10 @@ struct per_cpu_pages {
 	int low;		/* low watermark, refill needed */
 	int high;		/* high watermark, emptying needed */
 	int batch;		/* chunk size for buddy add/remove */
+	int base_batch;		/* batch size derived from the zone size */
+	unsigned long stamp;	/* jiffies of the last refill or drain */
+	unsigned long refills;	/* refills from the buddy lists */
+	unsigned long drains;	/* drains to the buddy lists */
 	struct list_head list;	/* the list of pages */
 };
 
@@ -139,17 +200,35 @@ struct zone {
 	spinlock_t		lock;
 	struct free_area	free_area[MAX_ORDER];
 
+	/* migrate type of each pageblock, NR_PAGEBLOCK_BITS per block */
+	unsigned long		*pageblock_flags;
 
 	ZONE_PADDING(_pad1_)
 
 	/* Fields commonly accessed by the page reclaim scanner */
 	spinlock_t		lru_lock;	
-	struct list_head	active_list;
-	struct list_head	inactive_list;
-	unsigned long		nr_scan_active;
-	unsigned long		nr_scan_inactive;
-	unsigned long		nr_active;
-	unsigned long		nr_inactive;
+	struct {
+		struct list_head list;
+		unsigned long nr_pages;	/* pages on the list */
+		unsigned long nr_scan;	/* scan work deferred to next pass */
+	} lru[NR_LRU_LISTS];
+
+	/*
+	 * Of the pages reclaim recently scanned on the anon [0] and file
+	 * [1] lists, how many were in use and went back to the active
+	 * list.  The ratio tells reclaim which of the two is cheaper to
+	 * take memory from.  Both are halved now and then so that they
+	 * follow changes in the workload.  Protected by lru_lock.
+	 */
+	unsigned long		recent_rotated[2];
+	unsigned long		recent_scanned[2];
+
+	/*
+	 * Ticks on every eviction and activation of a file page: the
+	 * clock refault distances are measured in, see mm/workingset.c.
+	 */
+	atomic_t		inactive_age;
+
 	unsigned long		pages_scanned;	   /* since last reclaim */
 	int			all_unreclaimable; /* All pages pinned */
 
@@ -168,8 +247,7 @@ struct zone {
 	 * invokation.
 	 *
 	 * We use prev_priority as a measure of how much stress page reclaim is
-	 * under - it drives the swappiness decision: whether to unmap mapped
-	 * pages.
+	 * under.
 	 *
 	 * temp_priority is used to remember the scanning priority at which
 	 * this zone was successfully refilled to free_pages == pages_high.
@@ -295,6 +373,7 @@ typedef struct pglist_data {
 
 extern struct pglist_data *pgdat_list;
 
+void get_lru_counts(unsigned long *nr);
 void __get_zone_counts(unsigned long *active, unsigned long *inactive,
 			unsigned long *free, struct pglist_data *pgdat);
 void get_zone_counts(unsigned long *active, unsigned long *inactive,
@@ -0,0 +1,79 @@
+#ifndef _LINUX_NUMA_BALANCING_H
+#define _LINUX_NUMA_BALANCING_H
+/*
+ * Declarations for automatic NUMA balancing, see mm/numa_balancing.c
+ */
+
+#include <linux/config.h>
+#include <linux/mm.h>
+#include <linux/sched.h>
+
+#ifdef CONFIG_NUMA_BALANCING
+extern int do_numa_page(struct mm_struct *mm, struct vm_area_struct *vma,
+			unsigned long address, pte_t *pte, pmd_t *pmd,
+			pte_t entry);
+extern void __numa_balancing_enter(struct mm_struct *mm);
+extern void numa_balancing_exit(struct mm_struct *mm);
+extern void task_numa_free(struct task_struct *p);
+extern char *task_numa_status(struct task_struct *p, char *buffer);
+
+/* A hinting pte looks like a PROT_NONE one, but in an accessible vma */
+static inline int pte_numa_hint(struct vm_area_struct *vma, pte_t pte)
+{
+	return pte_numa(pte) && (vma->vm_flags & (VM_READ|VM_WRITE|VM_EXEC));
+}
+
+/**
+ * numa_balancing_enter - have knumad scan @mm
+ * @mm: an mm which is faulting pages in
+ */
+static inline void numa_balancing_enter(struct mm_struct *mm)
+{
+	if (list_empty(&mm->numa_list))
+		__numa_balancing_enter(mm);
+}
+
+/*
+ * Called from the scheduler tick: knumad only scans the mms of tasks
+ * which ran since their last scan.
+ */
+static inline void task_tick_numa(struct task_struct *p)
+{
+	struct mm_struct *mm = p->mm;
+
+	if (mm && !mm->numa_ran)
+		mm->numa_ran = 1;
+}
+
+static inline void task_numa_init(struct task_struct *p)
+{
+	p->numa_preferred_nid = -1;
+	p->numa_scan_seq = 0;
+	p->numa_faults = NULL;
+	p->numa_faults_local = 0;
+	p->numa_faults_remote = 0;
+	p->numa_pages_migrated = 0;
+}
+#else
+static inline int do_numa_page(struct mm_struct *mm,
+			struct vm_area_struct *vma, unsigned long address,
+			pte_t *pte, pmd_t *pmd, pte_t entry)
+{
+	return 0;
+}
+static inline int pte_numa_hint(struct vm_area_struct *vma, pte_t pte)
+{
+	return 0;
+}
+static inline void numa_balancing_enter(struct mm_struct *mm) { }
+static inline void numa_balancing_exit(struct mm_struct *mm) { }
+static inline void task_tick_numa(struct task_struct *p) { }
+static inline void task_numa_init(struct task_struct *p) { }
+static inline void task_numa_free(struct task_struct *p) { }
+static inline char *task_numa_status(struct task_struct *p, char *buffer)
+{
+	return buffer;
+}
+#endif
+
+#endif	/* _LINUX_NUMA_BALANCING_H */
@@ -76,6 +76,11 @@
 #define PG_nosave_free		18	/* Free, should not be written */
 #define PG_uncached		19	/* Page has been mapped as uncached */
 
+#define PG_swapbacked		20	/* Page is backed by swap: anon LRU */
+#define PG_unevictable		21	/* Page is on the unevictable LRU */
+#define PG_readahead		22	/* Swap: read ahead, not faulted yet.
+					 * File: start the next readahead */
+
 /*
  * Global page accounting.  One instance per CPU.  Only unsigned longs are
  * allowed.
@@ -130,12 +135,47 @@ struct page_state {
 	unsigned long allocstall;	/* direct reclaim calls */
 
 	unsigned long pgrotated;	/* pages rotated to tail of the LRU */
+	unsigned long pgscan_inactive_anon;/* scanned on each LRU list, */
+	unsigned long pgscan_active_anon;/* in enum lru_list order */
+	unsigned long pgscan_inactive_file;
+	unsigned long pgscan_active_file;
+	unsigned long pgrotated_anon;	/* in use, back to the active list */
+	unsigned long pgrotated_file;
+	unsigned long unevictable_culled;/* moved to the unevictable LRU */
+	unsigned long unevictable_rescued;/* ... and back when unlocked */
+	unsigned long workingset_refault;/* evicted file pages read back */
+	unsigned long workingset_activate;/* ... soon enough to be active */
+	unsigned long swap_ra;		/* swap pages read ahead */
+	unsigned long swap_ra_hit;	/* ... and faulted on */
+	unsigned long swap_ra_miss;	/* ... and dropped unused */
+	unsigned long file_ra_sync;	/* file readahead on cache misses */
+	unsigned long file_ra_async;	/* ... and on PG_readahead marks */
+	unsigned long file_ra_context;	/* ... resuming cached streams */
+	unsigned long file_ra_pages;	/* file pages read ahead */
+	unsigned long file_ra_hit;	/* file pages found by reads */
 	unsigned long nr_bounce;	/* pages for bounce buffers */
+
+	unsigned long pgmigrate_success;/* pages moved by page migration */
+	unsigned long pgmigrate_fail;	/* pages migration gave up on */
+	unsigned long compact_stall;	/* direct compaction calls */
+	unsigned long compact_fail;	/* ... which did not help */
+	unsigned long compact_success;	/* ... which did */
+
+	unsigned long thp_fault_alloc;	/* huge pmds mapped at fault */
+	unsigned long thp_fault_fallback;/* faults which mapped small pages */
+	unsigned long thp_collapse_alloc;/* huge pages khugepaged allocated */
+	unsigned long thp_split;	/* huge pmds split into small ptes */
+
+	unsigned long numa_pte_updates;	/* ptes made NUMA hinting ptes */
+	unsigned long numa_hint_faults;	/* faults on those */
+	unsigned long numa_hint_faults_local;/* ... on a page of this node */
+	unsigned long numa_pages_migrated;/* ... which moved the page here */
 };
 
 extern void get_page_state(struct page_state *ret);
 extern void get_page_state_node(struct page_state *ret, int node);
 extern void get_full_page_state(struct page_state *ret);
+extern void get_full_page_state_node(struct page_state *ret, int node);
 extern unsigned long __read_page_state(unsigned long offset);
 extern void __mod_page_state(unsigned long offset, unsigned long delta);
 
@@ -307,6 +347,21 @@ extern void __mod_page_state(unsigned long offset, unsigned long delta);
 #define SetPageUncached(page)	set_bit(PG_uncached, &(page)->flags)
 #define ClearPageUncached(page)	clear_bit(PG_uncached, &(page)->flags)
 
+#define PageSwapBacked(page)	test_bit(PG_swapbacked, &(page)->flags)
+#define SetPageSwapBacked(page)	set_bit(PG_swapbacked, &(page)->flags)
+#define ClearPageSwapBacked(page) clear_bit(PG_swapbacked, &(page)->flags)
+#define __ClearPageSwapBacked(page) __clear_bit(PG_swapbacked, &(page)->flags)
+
+#define PageUnevictable(page)	test_bit(PG_unevictable, &(page)->flags)
+#define SetPageUnevictable(page) set_bit(PG_unevictable, &(page)->flags)
+#define ClearPageUnevictable(page) clear_bit(PG_unevictable, &(page)->flags)
+
+#define PageReadahead(page)	test_bit(PG_readahead, &(page)->flags)
+#define SetPageReadahead(page)	set_bit(PG_readahead, &(page)->flags)
+#define ClearPageReadahead(page) clear_bit(PG_readahead, &(page)->flags)
+#define TestClearPageReadahead(page) \
+	test_and_clear_bit(PG_readahead, &(page)->flags)
+
 struct page;	/* forward declaration */
 
 int test_clear_page_dirty(struct page *page);
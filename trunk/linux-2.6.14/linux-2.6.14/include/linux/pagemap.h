@@ -18,6 +18,7 @@
  */
 #define	AS_EIO		(__GFP_BITS_SHIFT + 0)	/* IO error on async write */
 #define AS_ENOSPC	(__GFP_BITS_SHIFT + 1)	/* ENOSPC on async write */
+#define AS_UNEVICTABLE	(__GFP_BITS_SHIFT + 2)	/* ramfs, SHM_LOCKed shmem */
 
 static inline gfp_t mapping_gfp_mask(struct address_space * mapping)
 {
@@ -33,6 +34,28 @@ static inline void mapping_set_gfp_mask(struct address_space *m, int mask)
 	m->flags = (m->flags & ~__GFP_BITS_MASK) | mask;
 }
 
+/*
+ * Reclaim moves the pages of an unevictable mapping to the unevictable
+ * LRU when it comes across them, instead of scanning them again and
+ * again.  See scan_mapping_unevictable_pages() for the way back.
+ */
+static inline void mapping_set_unevictable(struct address_space *mapping)
+{
+	set_bit(AS_UNEVICTABLE, &mapping->flags);
+}
+
+static inline void mapping_clear_unevictable(struct address_space *mapping)
+{
+	clear_bit(AS_UNEVICTABLE, &mapping->flags);
+}
+
+static inline int mapping_unevictable(struct address_space *mapping)
+{
+	if (likely(mapping))
+		return test_bit(AS_UNEVICTABLE, &mapping->flags);
+	return 0;
+}
+
 /*
  * The page cache can done in larger chunks than
  * one page, because it allows for more efficient
@@ -50,6 +73,36 @@ static inline void mapping_set_gfp_mask(struct address_space *m, int mask)
 #define page_cache_release(page)	put_page(page)
 void release_pages(struct page **pages, int nr, int cold);
 
+/*
+ * Take a reference on a page found by a lookup under rcu_read_lock().
+ * The page may have been taken out of the page cache since, freed and
+ * even reused: this fails if the page is free or frozen, and otherwise
+ * the caller must check that the page is still in the slot it was found
+ * in, and drop the reference and look again if it is not.
+ */
+static inline int page_cache_get_speculative(struct page *page)
+{
+	return get_page_unless_zero(page);
+}
+
+/*
+ * Taking a page out of the page cache freezes its refcount at zero, if
+ * it is @count (the cache's and the caller's references alone), so that
+ * no speculative reference is taken meanwhile.  page_unfreeze_refs()
+ * sets it back to @count if the page is kept after all.
+ */
+static inline int page_freeze_refs(struct page *page, int count)
+{
+	return likely(atomic_cmpxchg(&page->_count, count - 1, -1) == count - 1);
+}
+
+static inline void page_unfreeze_refs(struct page *page, int count)
+{
+	BUG_ON(page_count(page) != 0);
+	smp_mb();
+	set_page_count(page, count);
+}
+
 static inline struct page *page_cache_alloc(struct address_space *x)
 {
 	return alloc_pages(mapping_gfp_mask(x)|__GFP_NORECLAIM, 0);
@@ -95,8 +148,12 @@ int add_to_page_cache(struct page *page, struct address_space *mapping,
 				unsigned long index, int gfp_mask);
 int add_to_page_cache_lru(struct page *page, struct address_space *mapping,
 				unsigned long index, int gfp_mask);
+struct pagevec;
+unsigned add_to_page_cache_lru_vec(struct address_space *mapping,
+		struct list_head *pages, unsigned nr_pages,
+		struct pagevec *pvec, int gfp_mask);
 extern void remove_from_page_cache(struct page *page);
-extern void __remove_from_page_cache(struct page *page);
+extern void __remove_from_page_cache(struct page *page, void *shadow);
 
 extern atomic_t nr_pagecache;
 
@@ -21,6 +21,17 @@
 
 #include <linux/preempt.h>
 #include <linux/types.h>
+#include <linux/rcupdate.h>
+
+/*
+ * Changes to a radix tree need the lock the user protects it with, but
+ * radix_tree_lookup(), radix_tree_lookup_slot(), radix_tree_gang_lookup(),
+ * radix_tree_gang_lookup_slot() and radix_tree_tagged() may also run
+ * under rcu_read_lock() alone.  The nodes are freed by RCU, so such a
+ * lookup is safe, but it may find an item which is being deleted, or
+ * miss one which is being inserted: the caller has to make sure of what
+ * it found, with its own means.
+ */
 
 struct radix_tree_root {
 	unsigned int		height;
@@ -44,12 +55,56 @@ do {									\
 	(root)->rnode = NULL;						\
 } while (0)
 
+/*
+ * An item with bit 1 set is not a pointer but an "exceptional" entry:
+ * the page cache leaves those behind in place of evicted pages, see
+ * mm/workingset.c.  The bits above RADIX_TREE_EXCEPTIONAL_SHIFT are
+ * the user's.  radix_tree_gang_lookup() skips exceptional entries.
+ */
+#define RADIX_TREE_EXCEPTIONAL_ENTRY	2
+#define RADIX_TREE_EXCEPTIONAL_SHIFT	2
+
+static inline int radix_tree_exceptional_entry(void *arg)
+{
+	return ((unsigned long)arg & RADIX_TREE_EXCEPTIONAL_ENTRY) != 0;
+}
+
+/*
+ * Read the item in a slot found with radix_tree_lookup_slot() or
+ * radix_tree_gang_lookup_slot(), also under rcu_read_lock().
+ */
+static inline void *radix_tree_deref_slot(void **pslot)
+{
+	return rcu_dereference(*pslot);
+}
+
+/*
+ * Replace the item in a slot found with radix_tree_lookup_slot().
+ * The caller must hold the lock protecting the tree for writing.
+ */
+static inline void radix_tree_replace_slot(void **pslot, void *item)
+{
+	rcu_assign_pointer(*pslot, item);
+}
+
 int radix_tree_insert(struct radix_tree_root *, unsigned long, void *);
 void *radix_tree_lookup(struct radix_tree_root *, unsigned long);
+void **radix_tree_lookup_slot(struct radix_tree_root *, unsigned long);
 void *radix_tree_delete(struct radix_tree_root *, unsigned long);
 unsigned int
 radix_tree_gang_lookup(struct radix_tree_root *root, void **results,
 			unsigned long first_index, unsigned int max_items);
+unsigned long radix_tree_next_hole(struct radix_tree_root *root,
+				unsigned long index, unsigned long max_scan);
+unsigned long radix_tree_prev_hole(struct radix_tree_root *root,
+				unsigned long index, unsigned long max_scan);
+unsigned int
+radix_tree_gang_lookup_slot(struct radix_tree_root *root, void ***results,
+			unsigned long first_index, unsigned int max_items);
+unsigned int
+radix_tree_gang_lookup_exceptional(struct radix_tree_root *root,
+			void **results, unsigned long *indices,
+			unsigned long first_index, unsigned int max_items);
 int radix_tree_preload(gfp_t gfp_mask);
 void radix_tree_init(void);
 void *radix_tree_tag_set(struct radix_tree_root *root,
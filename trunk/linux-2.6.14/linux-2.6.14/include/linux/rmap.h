@@ -90,7 +90,10 @@ static inline void page_dup_rmap(struct page *page)
  * Called from mm/vmscan.c to handle paging out
  */
 int page_referenced(struct page *, int is_locked, int ignore_token);
-int try_to_unmap(struct page *);
+int page_referenced_one(struct page *, struct vm_area_struct *,
+			unsigned long address, unsigned int *mapcount,
+			int ignore_token);
+int try_to_unmap(struct page *, int migration);
 
 /*
  * Called from mm/filemap_xip.c to unmap empty zero page
@@ -110,7 +113,7 @@ unsigned long page_address_in_vma(struct page *, struct vm_area_struct *);
 #define anon_vma_link(vma)	do {} while (0)
 
 #define page_referenced(page,l,i) TestClearPageReferenced(page)
-#define try_to_unmap(page)	SWAP_FAIL
+#define try_to_unmap(page, migration)	SWAP_FAIL
 
 #endif	/* CONFIG_MMU */
 
@@ -120,5 +123,6 @@ unsigned long page_address_in_vma(struct page *, struct vm_area_struct *);
 #define SWAP_SUCCESS	0
 #define SWAP_AGAIN	1
 #define SWAP_FAIL	2
+#define SWAP_MLOCK	3
 
 #endif	/* _LINUX_RMAP_H */
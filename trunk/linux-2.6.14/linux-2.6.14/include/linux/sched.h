@@ -104,6 +104,7 @@ extern unsigned long nr_iowait(void);
 #include <linux/param.h>
 #include <linux/resource.h>
 #include <linux/timer.h>
+#include <linux/hrtimer.h>
 
 #include <asm/processor.h>
 
@@ -158,6 +159,7 @@ extern unsigned long nr_iowait(void);
 #define SCHED_NORMAL		0
 #define SCHED_FIFO		1
 #define SCHED_RR		2
+#define SCHED_FAIR		3
 
 struct sched_param {
 	int sched_priority;
@@ -231,6 +233,7 @@ extern signed long schedule_timeout_uninterruptible(signed long timeout);
 asmlinkage void schedule(void);
 
 struct namespace;
+struct rmap_item;
 
 /* Maximum number of active map areas.. This is a random (large) number */
 #define DEFAULT_MAX_MAP_COUNT	65536
@@ -313,6 +316,21 @@ struct mm_struct {
 
 	unsigned long hiwater_rss;	/* High-water RSS usage */
 	unsigned long hiwater_vm;	/* High-water virtual memory usage */
+
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+	struct list_head pmd_huge_pte;	/* Page tables for splitting huge pmds */
+	struct list_head khugepaged_list; /* Entry on the list khugepaged scans */
+#endif
+#ifdef CONFIG_NUMA_BALANCING
+	struct list_head numa_list;	/* Entry on the list knumad scans */
+	unsigned long numa_scan_offset;	/* Address knumad continues at */
+	unsigned int numa_scan_seq;	/* Full scans of the mm so far */
+	int numa_ran;			/* A task ran since the last scan */
+#endif
+#ifdef CONFIG_KSM
+	struct list_head ksm_list;	/* Entry on the list ksmd scans */
+	struct rmap_item *ksm_rmap_list; /* Pages ksmd tracks, by address */
+#endif
 };
 
 struct sighand_struct {
@@ -358,8 +376,9 @@ struct signal_struct {
 	struct list_head posix_timers;
 
 	/* ITIMER_REAL timer for the process */
-	struct timer_list real_timer;
-	unsigned long it_real_value, it_real_incr;
+	struct hrtimer real_timer;
+	struct task_struct *tsk;
+	ktime_t it_real_incr;
 
 	/* ITIMER_PROF and ITIMER_VIRTUAL timers for the process */
 	cputime_t it_prof_expires, it_virt_expires;
@@ -638,6 +657,7 @@ static inline void prefetch_stack(struct task_struct *t) { }
 
 struct audit_context;		/* See audit.c */
 struct mempolicy;
+struct sched_class;		/* See kernel/sched.c */
 
 struct task_struct {
 	volatile long state;	/* -1 unrunnable, 0 runnable, >0 stopped */
@@ -666,6 +686,14 @@ struct task_struct {
 	cpumask_t cpus_allowed;
 	unsigned int time_slice, first_time_slice;
 
+	const struct sched_class *sched_class;
+	int on_rq;
+	/* SCHED_FAIR: virtual runtime ordered runqueue, nanoseconds */
+	struct rb_node run_node;
+	unsigned long long vruntime, exec_start;
+	unsigned long long sum_exec_runtime, prev_sum_exec_runtime;
+	unsigned long load_weight;
+
 #ifdef CONFIG_SCHEDSTATS
 	struct sched_info sched_info;
 #endif
@@ -807,6 +835,16 @@ struct task_struct {
   	struct mempolicy *mempolicy;
 	short il_next;
 #endif
+#ifdef CONFIG_NUMA_BALANCING
+	/* NUMA hinting faults, see mm/numa_balancing.c */
+	int numa_preferred_nid;		/* node most faults come from, or -1 */
+	unsigned int numa_scan_seq;	/* mm->numa_scan_seq at last placement */
+	unsigned long *numa_faults;	/* decaying per node faults, then the
+					   faults of the current scan */
+	unsigned long numa_faults_local;
+	unsigned long numa_faults_remote;
+	unsigned long numa_pages_migrated;
+#endif
 #ifdef CONFIG_CPUSETS
 	struct cpuset *cpuset;
 	nodemask_t mems_allowed;
@@ -29,7 +29,14 @@ static inline int current_is_kswapd(void)
  * the type/offset into the pte as 5/27 as well.
  */
 #define MAX_SWAPFILES_SHIFT	5
+#ifndef CONFIG_MIGRATION
 #define MAX_SWAPFILES		(1 << MAX_SWAPFILES_SHIFT)
+#else
+/* Use last two entries for page migration swap entries */
+#define MAX_SWAPFILES		((1 << MAX_SWAPFILES_SHIFT)-2)
+#define SWP_MIGRATION_READ	MAX_SWAPFILES
+#define SWP_MIGRATION_WRITE	(MAX_SWAPFILES + 1)
+#endif
 
 /*
  * Magic header for a swap area. The first part of the union is
@@ -116,6 +123,9 @@ enum {
 #define SWAP_MAP_MAX	0x7fff
 #define SWAP_MAP_BAD	0x8000
 
+struct swap_cluster_info;
+struct percpu_cluster;
+
 /*
  * The in-memory structure used to track swap areas.
  */
@@ -131,7 +141,10 @@ struct swap_info_struct {
 	unsigned int lowest_bit;
 	unsigned int highest_bit;
 	unsigned int cluster_next;
-	unsigned int cluster_nr;
+	struct swap_cluster_info *cluster_info;	/* slots used per cluster */
+	unsigned int free_cluster_head;	/* free clusters, */
+	unsigned int free_cluster_tail;	/* oldest freed first */
+	struct percpu_cluster *percpu_cluster;	/* cluster of each cpu */
 	unsigned int pages;
 	unsigned int max;
 	unsigned int inuse_pages;
@@ -175,6 +188,12 @@ extern int try_to_free_pages(struct zone **, unsigned int);
 extern int zone_reclaim(struct zone *, unsigned int, unsigned int);
 extern int shrink_all_memory(int);
 extern int vm_swappiness;
+extern void scan_mapping_unevictable_pages(struct address_space *);
+
+/* linux/mm/workingset.c */
+extern void *workingset_eviction(struct address_space *, struct page *);
+extern int workingset_refault(void *shadow);
+extern void workingset_activation(struct page *);
 
 #ifdef CONFIG_MMU
 /* linux/mm/shmem.c */
@@ -204,6 +223,8 @@ extern void free_pages_and_swap_cache(struct page **, int);
 extern struct page * lookup_swap_cache(swp_entry_t);
 extern struct page * read_swap_cache_async(swp_entry_t, struct vm_area_struct *vma,
 					   unsigned long addr);
+extern void swapin_readahead_vma(swp_entry_t, unsigned long,
+				 struct vm_area_struct *, pmd_t *);
 /* linux/mm/swapfile.c */
 extern long total_swap_pages;
 extern unsigned int nr_swapfiles;
@@ -213,6 +234,7 @@ extern swp_entry_t get_swap_page(void);
 extern int swap_duplicate(swp_entry_t);
 extern int valid_swaphandles(swp_entry_t, unsigned long *);
 extern void swap_free(swp_entry_t);
+extern void swapcache_free(swp_entry_t);
 extern void free_swap_and_cache(swp_entry_t);
 extern sector_t map_swap_page(struct swap_info_struct *, pgoff_t);
 extern struct swap_info_struct *get_swap_info_struct(unsigned);
@@ -257,7 +279,9 @@ static inline void put_swap_token(struct mm_struct *mm)
 #define free_swap_and_cache(swp)		/*NOTHING*/
 #define swap_duplicate(swp)			/*NOTHING*/
 #define swap_free(swp)				/*NOTHING*/
+#define swapcache_free(swp)			/*NOTHING*/
 #define read_swap_cache_async(swp,vma,addr)	NULL
+#define swapin_readahead_vma(swp,addr,vma,pmd)	/*NOTHING*/
 #define lookup_swap_cache(swp)			NULL
 #define valid_swaphandles(swp, off)		0
 #define can_share_swap_page(p)			0
@@ -180,6 +180,8 @@ enum
 	VM_VFS_CACHE_PRESSURE=26, /* dcache/icache reclaim pressure */
 	VM_LEGACY_VA_LAYOUT=27, /* legacy/compatibility virtual address space layout */
 	VM_SWAP_TOKEN_TIMEOUT=28, /* default time for token time out */
+	VM_COMPACT_MEMORY=29,	/* int: compact all zones when written */
+	VM_FAULT_AROUND_BYTES=30, /* int: window mapped around file faults */
 };
 
 
@@ -91,6 +91,7 @@ static inline void add_timer(struct timer_list * timer)
 
 extern void init_timers(void);
 extern void run_local_timers(void);
-extern void it_real_fn(unsigned long);
+struct hrtimer;
+extern int it_real_fn(struct hrtimer *);
 
 #endif
@@ -41,6 +41,11 @@ extern void vfree(void *addr);
 extern void *vmap(struct page **pages, unsigned int count,
 			unsigned long flags, pgprot_t prot);
 extern void vunmap(void *addr);
+
+extern void *vm_map_ram(struct page **pages, unsigned int count,
+			pgprot_t prot);
+extern void vm_unmap_ram(const void *mem, unsigned int count);
+extern void vm_unmap_aliases(void);
  
 /*
  *	Lowlevel-APIs (not for driver use!)
@@ -60,4 +65,6 @@ extern void unmap_vm_area(struct vm_struct *area);
 extern rwlock_t vmlist_lock;
 extern struct vm_struct *vmlist;
 
+extern void vmalloc_init(void);
+
 #endif /* _LINUX_VMALLOC_H */
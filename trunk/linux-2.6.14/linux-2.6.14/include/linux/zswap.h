@@ -0,0 +1,28 @@
+#ifndef _LINUX_ZSWAP_H
+#define _LINUX_ZSWAP_H
+/*
+ * Declarations for the compressed swap cache, see mm/zswap.c
+ */
+
+#include <linux/config.h>
+#include <linux/mm.h>
+
+#ifdef CONFIG_ZSWAP
+extern int zswap_store(struct page *page);
+extern int zswap_load(struct page *page);
+extern void zswap_invalidate(unsigned type, unsigned long offset);
+extern void zswap_invalidate_area(unsigned type);
+#else
+static inline int zswap_store(struct page *page)
+{
+	return -ENOSPC;
+}
+static inline int zswap_load(struct page *page)
+{
+	return -ENOENT;
+}
+static inline void zswap_invalidate(unsigned type, unsigned long offset) { }
+static inline void zswap_invalidate_area(unsigned type) { }
+#endif
+
+#endif	/* _LINUX_ZSWAP_H */
@@ -47,6 +47,7 @@
 #include <linux/rmap.h>
 #include <linux/mempolicy.h>
 #include <linux/key.h>
+#include <linux/vmalloc.h>
 #include <net/sock.h>
 
 #include <asm/io.h>
@@ -485,6 +486,7 @@ asmlinkage void __init start_kernel(void)
 	init_IRQ();
 	pidhash_init();
 	init_timers();
+	hrtimers_init();
 	softirq_init();
 	time_init();
 
@@ -509,6 +511,7 @@ asmlinkage void __init start_kernel(void)
 	vfs_caches_init_early();
 	mem_init();
 	kmem_cache_init();
+	vmalloc_init();
 	setup_per_cpu_pageset();
 	numa_policy_init();
 	if (late_time_init)
@@ -0,0 +1,164 @@
+/*
+ *  linux/kernel/clockevents.c
+ *
+ *  Management of clock event devices.
+ *
+ *  The arch code registers a clock event device on the cpu the device
+ *  serves. The best rated oneshot capable device of a cpu becomes its
+ *  local device, which the hrtimer code picks up from the timer softirq
+ *  and switches to high resolution mode. Devices are never handed over
+ *  once in use; a cpu which goes offline gives up its device so that it
+ *  can be registered again when the cpu comes back.
+ */
+
+#include <linux/clockchips.h>
+#include <linux/cpu.h>
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/notifier.h>
+#include <linux/percpu.h>
+#include <linux/smp.h>
+
+static DEFINE_PER_CPU(struct clock_event_device *, local_clock_event);
+
+/**
+ * clockevent_delta2ns - Convert a latch value (device ticks) to nanoseconds
+ * @latch:	value to convert
+ * @evt:	pointer to clock event device descriptor
+ *
+ * Math helper, returns latch value converted to nanoseconds (bound checked)
+ */
+unsigned long clockevent_delta2ns(unsigned long latch,
+				  struct clock_event_device *evt)
+{
+	u64 clc = ((u64) latch << evt->shift);
+
+	do_div(clc, evt->mult);
+	if (clc < 1000)
+		clc = 1000;
+	if (clc > LONG_MAX)
+		clc = LONG_MAX;
+
+	return (unsigned long) clc;
+}
+
+/**
+ * clockevents_set_mode - set the operating mode of a clock event device
+ * @dev:	device to modify
+ * @mode:	new mode
+ *
+ * Must be called with interrupts disabled !
+ */
+void clockevents_set_mode(struct clock_event_device *dev,
+			  enum clock_event_mode mode)
+{
+	if (dev->mode != mode) {
+		dev->set_mode(mode, dev);
+		dev->mode = mode;
+	}
+	if (mode != CLOCK_EVT_MODE_ONESHOT)
+		dev->next_event = KTIME_MAX;
+}
+
+/**
+ * clockevents_program_event - Reprogram the clock event device.
+ * @dev:	device to program
+ * @expires:	absolute expiry event time (CLOCK_MONOTONIC)
+ * @now:	current time (CLOCK_MONOTONIC)
+ *
+ * An event which is already due is programmed min_delta_ns ahead, so
+ * the interrupt still happens and the handler finds the expired timers.
+ *
+ * Must be called with interrupts disabled !
+ */
+int clockevents_program_event(struct clock_event_device *dev, ktime_t expires,
+			      ktime_t now)
+{
+	unsigned long long clc;
+	s64 delta;
+
+	dev->next_event = expires;
+
+	if (dev->mode == CLOCK_EVT_MODE_SHUTDOWN)
+		return 0;
+
+	delta = ktime_to_ns(ktime_sub(expires, now));
+	if (delta > (s64) dev->max_delta_ns)
+		delta = dev->max_delta_ns;
+	if (delta < (s64) dev->min_delta_ns)
+		delta = dev->min_delta_ns;
+
+	clc = (unsigned long long) delta * dev->mult;
+	clc >>= dev->shift;
+
+	return dev->set_next_event((unsigned long) clc, dev);
+}
+
+/**
+ * clockevents_register_device - register a clock event device
+ * @dev:	device to register
+ *
+ * Must be called on a cpu in @dev->cpumask.
+ */
+void clockevents_register_device(struct clock_event_device *dev)
+{
+	struct clock_event_device *curr;
+	unsigned long flags;
+
+	BUG_ON(dev->mode != CLOCK_EVT_MODE_UNUSED);
+
+	local_irq_save(flags);
+	curr = __get_cpu_var(local_clock_event);
+	if ((dev->features & CLOCK_EVT_FEAT_ONESHOT) &&
+	    cpu_isset(smp_processor_id(), dev->cpumask) &&
+	    (!curr || (curr->mode == CLOCK_EVT_MODE_UNUSED &&
+		       dev->rating > curr->rating)))
+		__get_cpu_var(local_clock_event) = dev;
+	local_irq_restore(flags);
+}
+EXPORT_SYMBOL_GPL(clockevents_register_device);
+
+/**
+ * clockevents_local_device - the clock event device of this cpu
+ *
+ * Returns NULL if no oneshot capable device has been registered.
+ * Must be called with preemption disabled.
+ */
+struct clock_event_device *clockevents_local_device(void)
+{
+	return __get_cpu_var(local_clock_event);
+}
+
+#ifdef CONFIG_HOTPLUG_CPU
+static int __devinit clockevents_cpu_notify(struct notifier_block *self,
+				unsigned long action, void *hcpu)
+{
+	long cpu = (long)hcpu;
+	struct clock_event_device *dev;
+
+	switch(action) {
+	case CPU_DEAD:
+		dev = per_cpu(local_clock_event, cpu);
+		if (dev) {
+			dev->event_handler = NULL;
+			dev->mode = CLOCK_EVT_MODE_UNUSED;
+			per_cpu(local_clock_event, cpu) = NULL;
+		}
+		break;
+	default:
+		break;
+	}
+	return NOTIFY_OK;
+}
+
+static struct notifier_block __devinitdata clockevents_nb = {
+	.notifier_call	= clockevents_cpu_notify,
+};
+
+static int __init clockevents_init(void)
+{
+	register_cpu_notifier(&clockevents_nb);
+	return 0;
+}
+core_initcall(clockevents_init);
+#endif
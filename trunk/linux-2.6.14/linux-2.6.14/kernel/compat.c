@@ -41,38 +41,28 @@ int put_compat_timespec(const struct timespec *ts, struct compat_timespec __user
 
 static long compat_nanosleep_restart(struct restart_block *restart)
 {
-	unsigned long expire = restart->arg0, now = jiffies;
 	struct compat_timespec __user *rmtp;
-
-	/* Did it expire while we handled signals? */
-	if (!time_after(expire, now))
-		return 0;
-
-	expire = schedule_timeout_interruptible(expire - now);
-	if (expire == 0)
-		return 0;
+	struct timespec t;
+	long ret;
 
 	rmtp = (struct compat_timespec __user *)restart->arg1;
-	if (rmtp) {
-		struct compat_timespec ct;
-		struct timespec t;
-
-		jiffies_to_timespec(expire, &t);
-		ct.tv_sec = t.tv_sec;
-		ct.tv_nsec = t.tv_nsec;
-		if (copy_to_user(rmtp, &ct, sizeof(ct)))
-			return -EFAULT;
-	}
-	/* The 'restart' block is already filled in */
+	ret = hrtimer_nanosleep_restart(restart, rmtp ? &t : NULL);
+	if (ret != -ERESTART_RESTARTBLOCK)
+		return ret;
+
+	if (rmtp && put_compat_timespec(&t, rmtp))
+		return -EFAULT;
+	/* The rest of the 'restart' block is already filled in */
+	restart->fn = compat_nanosleep_restart;
 	return -ERESTART_RESTARTBLOCK;
 }
 
 asmlinkage long compat_sys_nanosleep(struct compat_timespec __user *rqtp,
 		struct compat_timespec __user *rmtp)
 {
-	struct timespec t;
+	struct timespec t, rem;
 	struct restart_block *restart;
-	unsigned long expire;
+	long ret;
 
 	if (get_compat_timespec(&t, rqtp))
 		return -EFAULT;
@@ -80,19 +70,15 @@ asmlinkage long compat_sys_nanosleep(struct compat_timespec __user *rqtp,
 	if ((t.tv_nsec >= 1000000000L) || (t.tv_nsec < 0) || (t.tv_sec < 0))
 		return -EINVAL;
 
-	expire = timespec_to_jiffies(&t) + (t.tv_sec || t.tv_nsec);
-	expire = schedule_timeout_interruptible(expire);
-	if (expire == 0)
-		return 0;
+	ret = hrtimer_nanosleep(&t, rmtp ? &rem : NULL, HRTIMER_REL,
+				CLOCK_MONOTONIC);
+	if (ret != -ERESTART_RESTARTBLOCK)
+		return ret;
 
-	if (rmtp) {
-		jiffies_to_timespec(expire, &t);
-		if (put_compat_timespec(&t, rmtp))
-			return -EFAULT;
-	}
+	if (rmtp && put_compat_timespec(&rem, rmtp))
+		return -EFAULT;
 	restart = &current_thread_info()->restart_block;
 	restart->fn = compat_nanosleep_restart;
-	restart->arg0 = jiffies + expire;
 	restart->arg1 = (unsigned long) rmtp;
 	return -ERESTART_RESTARTBLOCK;
 }
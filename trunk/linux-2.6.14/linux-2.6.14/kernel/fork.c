@@ -41,6 +41,9 @@
 #include <linux/audit.h>
 #include <linux/profile.h>
 #include <linux/rmap.h>
+#include <linux/huge_mm.h>
+#include <linux/numa_balancing.h>
+#include <linux/ksm.h>
 #include <linux/acct.h>
 
 #include <asm/pgtable.h>
@@ -101,6 +104,7 @@ static kmem_cache_t *mm_cachep;
 
 void free_task(struct task_struct *tsk)
 {
+	task_numa_free(tsk);
 	free_thread_info(tsk->thread_info);
 	free_task_struct(tsk);
 }
@@ -178,6 +182,7 @@ static struct task_struct *dup_task_struct(struct task_struct *orig)
 	/* One for us, one for whoever does the "release_task()" (usually parent) */
 	atomic_set(&tsk->usage,2);
 	atomic_set(&tsk->fs_excl, 0);
+	task_numa_init(tsk);
 	return tsk;
 }
 
@@ -205,6 +210,7 @@ static inline int dup_mmap(struct mm_struct * mm, struct mm_struct * oldmm)
 	rb_link = &mm->mm_rb.rb_node;
 	rb_parent = NULL;
 	pprev = &mm->mmap;
+	ksm_fork(mm, oldmm);
 
 	for (mpnt = current->mm->mmap ; mpnt ; mpnt = mpnt->vm_next) {
 		struct file *file;
@@ -321,6 +327,20 @@ static struct mm_struct * mm_init(struct mm_struct * mm)
 	atomic_set(&mm->mm_count, 1);
 	init_rwsem(&mm->mmap_sem);
 	INIT_LIST_HEAD(&mm->mmlist);
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+	INIT_LIST_HEAD(&mm->pmd_huge_pte);
+	INIT_LIST_HEAD(&mm->khugepaged_list);
+#endif
+#ifdef CONFIG_NUMA_BALANCING
+	INIT_LIST_HEAD(&mm->numa_list);
+	mm->numa_scan_offset = 0;
+	mm->numa_scan_seq = 0;
+	mm->numa_ran = 0;
+#endif
+#ifdef CONFIG_KSM
+	INIT_LIST_HEAD(&mm->ksm_list);
+	mm->ksm_rmap_list = NULL;
+#endif
 	mm->core_waiters = 0;
 	mm->nr_ptes = 0;
 	spin_lock_init(&mm->page_table_lock);
@@ -372,6 +392,9 @@ void fastcall __mmdrop(struct mm_struct *mm)
 void mmput(struct mm_struct *mm)
 {
 	if (atomic_dec_and_test(&mm->mm_users)) {
+		khugepaged_exit(mm);
+		numa_balancing_exit(mm);
+		ksm_exit(mm);
 		exit_aio(mm);
 		exit_mmap(mm);
 		if (!list_empty(&mm->mmlist)) {
@@ -804,10 +827,10 @@ static inline int copy_signal(unsigned long clone_flags, struct task_struct * ts
 	init_sigpending(&sig->shared_pending);
 	INIT_LIST_HEAD(&sig->posix_timers);
 
-	sig->it_real_value = sig->it_real_incr = 0;
+	hrtimer_init(&sig->real_timer, CLOCK_MONOTONIC, HRTIMER_REL);
+	sig->it_real_incr = 0;
 	sig->real_timer.function = it_real_fn;
-	sig->real_timer.data = (unsigned long) tsk;
-	init_timer(&sig->real_timer);
+	sig->tsk = tsk;
 
 	sig->it_virt_expires = cputime_zero;
 	sig->it_virt_incr = cputime_zero;
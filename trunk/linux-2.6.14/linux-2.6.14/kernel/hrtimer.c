@@ -0,0 +1,1188 @@
+/*
+ *  linux/kernel/hrtimer.c
+ *
+ *  High-resolution kernel timers
+ *
+ *  In contrast to the timer wheel in kernel/timer.c, hrtimers are kept
+ *  in a time sorted red-black tree per clock and per cpu, with
+ *  nanosecond expiry times. They are used for:
+ *
+ *   - nanosleep
+ *   - ITIMER_REAL interval timers
+ *   - CLOCK_REALTIME and CLOCK_MONOTONIC POSIX timers
+ *
+ *  The timer wheel stays the better choice for timeouts, which are
+ *  mostly removed before they expire: insertion there is O(1), here it
+ *  is O(log n).
+ *
+ *  Without a clock event device the timers are run from the timer
+ *  softirq, so they expire on the first tick after their expiry time.
+ *  With CONFIG_HIGH_RES_TIMERS and a oneshot clock event device on the
+ *  cpu, the device is programmed for the first timer to expire and the
+ *  timers run from its interrupt. The per cpu tick is then emulated by
+ *  a timer as well, see hrtimer_sched_tick(). With CONFIG_NO_IDLE_HZ an
+ *  idle cpu pushes that timer out to its next timer wheel event.
+ */
+
+#include <linux/cpu.h>
+#include <linux/module.h>
+#include <linux/percpu.h>
+#include <linux/hrtimer.h>
+#include <linux/clockchips.h>
+#include <linux/notifier.h>
+#include <linux/syscalls.h>
+#include <linux/interrupt.h>
+#include <linux/kernel_stat.h>
+#include <linux/profile.h>
+#include <linux/rcupdate.h>
+#include <linux/workqueue.h>
+
+#include <asm/uaccess.h>
+
+/**
+ * ktime_get - get the monotonic time in ktime_t format
+ *
+ * returns the time in ktime_t format
+ */
+ktime_t ktime_get(void)
+{
+	struct timespec now;
+
+	ktime_get_ts(&now);
+
+	return timespec_to_ktime(now);
+}
+EXPORT_SYMBOL_GPL(ktime_get);
+
+/**
+ * ktime_get_real - get the real (wall-) time in ktime_t format
+ *
+ * returns the time in ktime_t format
+ */
+ktime_t ktime_get_real(void)
+{
+	struct timespec now;
+
+	getnstimeofday(&now);
+
+	return timespec_to_ktime(now);
+}
+EXPORT_SYMBOL_GPL(ktime_get_real);
+
+/**
+ * ktime_get_ts - get the monotonic clock in timespec format
+ * @ts:		pointer to timespec variable
+ *
+ * The function calculates the monotonic clock from the realtime
+ * clock and the wall_to_monotonic offset and stores the result
+ * in normalized timespec format in the variable pointed to by @ts.
+ */
+void ktime_get_ts(struct timespec *ts)
+{
+	struct timespec tomono;
+	unsigned long seq;
+
+	do {
+		seq = read_seqbegin(&xtime_lock);
+		getnstimeofday(ts);
+		tomono = wall_to_monotonic;
+
+	} while (read_seqretry(&xtime_lock, seq));
+
+	set_normalized_timespec(ts, ts->tv_sec + tomono.tv_sec,
+				ts->tv_nsec + tomono.tv_nsec);
+}
+EXPORT_SYMBOL_GPL(ktime_get_ts);
+
+/*
+ * The timer bases:
+ *
+ * Note: the clock_base index must match CLOCK_REALTIME and
+ * CLOCK_MONOTONIC, as hrtimer_init() uses the clock id as index.
+ */
+static DEFINE_PER_CPU(struct hrtimer_cpu_base, hrtimer_bases) =
+{
+	.clock_base =
+	{
+		{
+			.index = CLOCK_REALTIME,
+			.get_time = &ktime_get_real,
+			.resolution = KTIME_LOW_RES,
+		},
+		{
+			.index = CLOCK_MONOTONIC,
+			.get_time = &ktime_get,
+			.resolution = KTIME_LOW_RES,
+		},
+	}
+};
+
+/*
+ * Functions and macros which are different for UP/SMP systems are kept in a
+ * single place
+ */
+#ifdef CONFIG_SMP
+
+/*
+ * We are using hashed locking: holding per_cpu(hrtimer_bases)[n].lock
+ * means that all timers which are tied to this base via timer->base are
+ * locked, and the base itself is locked too.
+ *
+ * So __run_hrtimer_queue() and hrtimer_interrupt() can safely modify
+ * all timers which are queued on the locked base.
+ *
+ * When the timer's base is locked, and the timer removed from list, it is
+ * possible to set timer->base = NULL and drop the lock: the timer remains
+ * locked.
+ */
+static struct hrtimer_clock_base *lock_hrtimer_base(const struct hrtimer *timer,
+						    unsigned long *flags)
+{
+	struct hrtimer_clock_base *base;
+
+	for (;;) {
+		base = timer->base;
+		if (likely(base != NULL)) {
+			spin_lock_irqsave(&base->cpu_base->lock, *flags);
+			if (likely(base == timer->base))
+				return base;
+			/* The timer has migrated to another CPU: */
+			spin_unlock_irqrestore(&base->cpu_base->lock, *flags);
+		}
+		cpu_relax();
+	}
+}
+
+/*
+ * Switch the timer base to the current CPU when possible.
+ */
+static inline struct hrtimer_clock_base *
+switch_hrtimer_base(struct hrtimer *timer, struct hrtimer_clock_base *base)
+{
+	struct hrtimer_clock_base *new_base;
+	struct hrtimer_cpu_base *new_cpu_base;
+
+	new_cpu_base = &__get_cpu_var(hrtimer_bases);
+	new_base = &new_cpu_base->clock_base[base->index];
+
+	if (base != new_base) {
+		/*
+		 * We are trying to schedule the timer on the local CPU.
+		 * However we can't change timer's base while it is running,
+		 * so we keep it on the same CPU. The cpu running the
+		 * callback reprograms its event device after the callback
+		 * returns, so nothing else needs to be done here.
+		 */
+		if (unlikely(base->cpu_base->curr_timer == timer))
+			return base;
+
+		/* See the comment in lock_hrtimer_base() */
+		timer->base = NULL;
+		spin_unlock(&base->cpu_base->lock);
+		spin_lock(&new_base->cpu_base->lock);
+		timer->base = new_base;
+	}
+	return new_base;
+}
+
+#else /* CONFIG_SMP */
+
+static inline struct hrtimer_clock_base *
+lock_hrtimer_base(const struct hrtimer *timer, unsigned long *flags)
+{
+	struct hrtimer_clock_base *base = timer->base;
+
+	spin_lock_irqsave(&base->cpu_base->lock, *flags);
+
+	return base;
+}
+
+#define switch_hrtimer_base(t, b)	(b)
+
+#endif	/* !CONFIG_SMP */
+
+static inline void
+unlock_hrtimer_base(const struct hrtimer *timer, unsigned long *flags)
+{
+	spin_unlock_irqrestore(&timer->base->cpu_base->lock, *flags);
+}
+
+/*
+ * High resolution timer related functions
+ */
+#ifdef CONFIG_HIGH_RES_TIMERS
+
+/* High resolution timer mode can be disabled with highres=off */
+static int hrtimer_hres_enabled = 1;
+
+static int __init setup_hrtimer_hres(char *str)
+{
+	if (!strcmp(str, "off"))
+		hrtimer_hres_enabled = 0;
+	else if (!strcmp(str, "on"))
+		hrtimer_hres_enabled = 1;
+	else
+		return 0;
+	return 1;
+}
+
+__setup("highres=", setup_hrtimer_hres);
+
+/* Register state of the clock event interrupt, for hrtimer_sched_tick() */
+static DEFINE_PER_CPU(struct pt_regs *, hrtimer_irq_regs);
+
+static inline int hrtimer_hres_active(struct hrtimer_cpu_base *cpu_base)
+{
+	return cpu_base->hres_active;
+}
+
+/*
+ * Offset of the base's clock to CLOCK_MONOTONIC, which the clock event
+ * devices are programmed in:
+ */
+static ktime_t hrtimer_base_offset(struct hrtimer_clock_base *base)
+{
+	struct timespec tomono;
+	unsigned long seq;
+
+	if (base->index != CLOCK_REALTIME)
+		return 0;
+
+	do {
+		seq = read_seqbegin(&xtime_lock);
+		tomono = wall_to_monotonic;
+	} while (read_seqretry(&xtime_lock, seq));
+
+	return timespec_to_ktime(tomono);
+}
+
+/*
+ * Program the clock event device for the first timer to expire on
+ * this cpu. Called with the cpu base lock held and interrupts disabled.
+ */
+static void hrtimer_force_reprogram(struct hrtimer_cpu_base *cpu_base)
+{
+	struct hrtimer_clock_base *base = cpu_base->clock_base;
+	ktime_t expires, expires_next = KTIME_MAX;
+	struct hrtimer *timer;
+	int i;
+
+	for (i = 0; i < HRTIMER_MAX_CLOCK_BASES; i++, base++) {
+		if (!base->first)
+			continue;
+		timer = rb_entry(base->first, struct hrtimer, node);
+		expires = ktime_add(timer->expires, hrtimer_base_offset(base));
+		if (expires < expires_next)
+			expires_next = expires;
+	}
+
+	cpu_base->expires_next = expires_next;
+	if (expires_next != KTIME_MAX)
+		clockevents_program_event(clockevents_local_device(),
+					  expires_next, ktime_get());
+}
+
+/*
+ * A timer became the first one of its base. Reprogram the event device
+ * if it expires before the event the device is set for.
+ *
+ * Timers queued on the base of another cpu are left alone: that cpu is
+ * running the timer's callback right now and reprograms its device when
+ * it is done with the expired timers.
+ */
+static void hrtimer_reprogram(struct hrtimer *timer,
+			      struct hrtimer_clock_base *base)
+{
+	struct hrtimer_cpu_base *cpu_base = base->cpu_base;
+	ktime_t expires;
+
+	if (cpu_base != &__get_cpu_var(hrtimer_bases) ||
+	    !hrtimer_hres_active(cpu_base))
+		return;
+
+	expires = ktime_add(timer->expires, hrtimer_base_offset(base));
+	if (expires >= cpu_base->expires_next)
+		return;
+
+	cpu_base->expires_next = expires;
+	clockevents_program_event(clockevents_local_device(), expires,
+				  ktime_get());
+}
+
+/*
+ * Retrigger next event is called after clock was set
+ *
+ * Called with interrupts disabled via on_each_cpu()
+ */
+static void retrigger_next_event(void *arg)
+{
+	struct hrtimer_cpu_base *cpu_base = &__get_cpu_var(hrtimer_bases);
+
+	if (!hrtimer_hres_active(cpu_base))
+		return;
+
+	spin_lock(&cpu_base->lock);
+	hrtimer_force_reprogram(cpu_base);
+	spin_unlock(&cpu_base->lock);
+}
+
+#else
+
+static inline int hrtimer_hres_active(struct hrtimer_cpu_base *cpu_base)
+{
+	return 0;
+}
+
+static inline void hrtimer_reprogram(struct hrtimer *timer,
+				     struct hrtimer_clock_base *base) { }
+
+#endif /* CONFIG_HIGH_RES_TIMERS */
+
+/*
+ * Clock realtime was set
+ *
+ * CLOCK_REALTIME timers are kept in wall time, so they need no
+ * adjustment: from the tick they are checked against the new time
+ * anyway. In high resolution mode every cpu has to reprogram its clock
+ * event device, though, as the first timer may now expire earlier.
+ */
+#ifdef CONFIG_HIGH_RES_TIMERS
+static DECLARE_WORK(clock_was_set_work, (void(*)(void*))clock_was_set, NULL);
+#endif
+
+void clock_was_set(void)
+{
+#ifdef CONFIG_HIGH_RES_TIMERS
+	/* The leap second code calls us from the timer interrupt: */
+	if (unlikely(in_interrupt())) {
+		schedule_work(&clock_was_set_work);
+		return;
+	}
+	on_each_cpu(retrigger_next_event, NULL, 0, 1);
+#endif
+}
+
+/**
+ * hrtimer_forward - forward the timer expiry
+ *
+ * @timer:	hrtimer to forward
+ * @interval:	the interval to forward
+ *
+ * Forward the timer expiry so it will expire in the future.
+ * Returns the number of overruns.
+ */
+unsigned long
+hrtimer_forward(struct hrtimer *timer, ktime_t interval)
+{
+	unsigned long orun = 1;
+	ktime_t delta, now;
+
+	now = timer->base->get_time();
+
+	delta = ktime_sub(now, timer->expires);
+
+	if (delta < 0)
+		return 0;
+
+	if (interval < timer->base->resolution)
+		interval = timer->base->resolution;
+
+	if (unlikely(delta >= interval)) {
+		s64 incr = ktime_to_ns(interval);
+
+		orun = ktime_divns(delta, incr);
+		timer->expires = ktime_add_ns(timer->expires, incr * orun);
+		if (timer->expires > now)
+			return orun;
+		/*
+		 * This (and the ktime_add() below) is the
+		 * correction for exact:
+		 */
+		orun++;
+	}
+	timer->expires = ktime_add(timer->expires, interval);
+
+	return orun;
+}
+
+/*
+ * enqueue_hrtimer - internal function to (re)start a timer
+ *
+ * The timer is inserted in expiry order. Insertion into the
+ * red black tree is O(log(n)). Must hold the base lock.
+ */
+static void enqueue_hrtimer(struct hrtimer *timer,
+			    struct hrtimer_clock_base *base, int reprogram)
+{
+	struct rb_node **link = &base->active.rb_node;
+	struct rb_node *parent = NULL;
+	struct hrtimer *entry;
+	int leftmost = 1;
+
+	/*
+	 * Find the right place in the rbtree:
+	 */
+	while (*link) {
+		parent = *link;
+		entry = rb_entry(parent, struct hrtimer, node);
+		/*
+		 * We dont care about collisions. Nodes with
+		 * the same expiry time stay together.
+		 */
+		if (timer->expires < entry->expires)
+			link = &(*link)->rb_left;
+		else {
+			link = &(*link)->rb_right;
+			leftmost = 0;
+		}
+	}
+
+	/*
+	 * Insert the timer to the rbtree and check whether it
+	 * replaces the first pending timer
+	 */
+	rb_link_node(&timer->node, parent, link);
+	rb_insert_color(&timer->node, &base->active);
+
+	if (leftmost) {
+		base->first = &timer->node;
+		if (reprogram)
+			hrtimer_reprogram(timer, base);
+	}
+}
+
+/*
+ * __remove_hrtimer - internal function to remove a timer
+ *
+ * Caller must hold the base lock.
+ */
+static void __remove_hrtimer(struct hrtimer *timer,
+			     struct hrtimer_clock_base *base)
+{
+	/*
+	 * Remove the timer from the rbtree and replace the
+	 * first entry pointer if necessary. The clock event device is
+	 * not reprogrammed: an early interrupt finds nothing to do.
+	 */
+	if (base->first == &timer->node)
+		base->first = rb_next(&timer->node);
+	rb_erase(&timer->node, &base->active);
+	timer->node.rb_parent = HRTIMER_INACTIVE;
+}
+
+/*
+ * remove hrtimer, called with base lock held
+ */
+static inline int
+remove_hrtimer(struct hrtimer *timer, struct hrtimer_clock_base *base)
+{
+	if (hrtimer_active(timer)) {
+		__remove_hrtimer(timer, base);
+		return 1;
+	}
+	return 0;
+}
+
+/**
+ * hrtimer_start - (re)start an relative timer on the current CPU
+ *
+ * @timer:	the timer to be added
+ * @tim:	expiry time
+ * @mode:	expiry mode: absolute (HRTIMER_ABS) or relative (HRTIMER_REL)
+ *
+ * Returns:
+ *  0 on success
+ *  1 when the timer was active
+ */
+int
+hrtimer_start(struct hrtimer *timer, ktime_t tim, const enum hrtimer_mode mode)
+{
+	struct hrtimer_clock_base *base, *new_base;
+	unsigned long flags;
+	int ret;
+
+	base = lock_hrtimer_base(timer, &flags);
+
+	/* Remove an active timer from the queue: */
+	ret = remove_hrtimer(timer, base);
+
+	/* Switch the timer base, if necessary: */
+	new_base = switch_hrtimer_base(timer, base);
+
+	if (mode == HRTIMER_REL)
+		tim = ktime_add(tim, new_base->get_time());
+	timer->expires = tim;
+
+	enqueue_hrtimer(timer, new_base, 1);
+
+	unlock_hrtimer_base(timer, &flags);
+
+	return ret;
+}
+EXPORT_SYMBOL_GPL(hrtimer_start);
+
+/**
+ * hrtimer_try_to_cancel - try to deactivate a timer
+ *
+ * @timer:	hrtimer to stop
+ *
+ * Returns:
+ *  0 when the timer was not active
+ *  1 when the timer was active
+ * -1 when the timer is currently excuting the callback function and
+ *    can not be stopped
+ */
+int hrtimer_try_to_cancel(struct hrtimer *timer)
+{
+	struct hrtimer_clock_base *base;
+	unsigned long flags;
+	int ret = -1;
+
+	base = lock_hrtimer_base(timer, &flags);
+
+	if (base->cpu_base->curr_timer != timer)
+		ret = remove_hrtimer(timer, base);
+
+	unlock_hrtimer_base(timer, &flags);
+
+	return ret;
+
+}
+EXPORT_SYMBOL_GPL(hrtimer_try_to_cancel);
+
+/**
+ * hrtimer_cancel - cancel a timer and wait for the handler to finish.
+ *
+ * @timer:	the timer to be cancelled
+ *
+ * Returns:
+ *  0 when the timer was not active
+ *  1 when the timer was active
+ */
+int hrtimer_cancel(struct hrtimer *timer)
+{
+	for (;;) {
+		int ret = hrtimer_try_to_cancel(timer);
+
+		if (ret >= 0)
+			return ret;
+		cpu_relax();
+	}
+}
+EXPORT_SYMBOL_GPL(hrtimer_cancel);
+
+/**
+ * hrtimer_get_remaining - get remaining time for the timer
+ *
+ * @timer:	the timer to read
+ */
+ktime_t hrtimer_get_remaining(const struct hrtimer *timer)
+{
+	struct hrtimer_clock_base *base;
+	unsigned long flags;
+	ktime_t rem;
+
+	base = lock_hrtimer_base(timer, &flags);
+	rem = ktime_sub(timer->expires, base->get_time());
+	unlock_hrtimer_base(timer, &flags);
+
+	return rem;
+}
+EXPORT_SYMBOL_GPL(hrtimer_get_remaining);
+
+/**
+ * hrtimer_init - initialize a timer to the given clock
+ *
+ * @timer:	the timer to be initialized
+ * @clock_id:	the clock to be used
+ * @mode:	timer mode abs/rel
+ *
+ * Relative CLOCK_REALTIME timers are put on the CLOCK_MONOTONIC base,
+ * so that setting the clock does not move them.
+ */
+void hrtimer_init(struct hrtimer *timer, clockid_t clock_id,
+		  enum hrtimer_mode mode)
+{
+	struct hrtimer_cpu_base *cpu_base;
+
+	memset(timer, 0, sizeof(struct hrtimer));
+
+	cpu_base = &per_cpu(hrtimer_bases, raw_smp_processor_id());
+
+	if (clock_id == CLOCK_REALTIME && mode != HRTIMER_ABS)
+		clock_id = CLOCK_MONOTONIC;
+
+	timer->base = &cpu_base->clock_base[clock_id];
+	timer->node.rb_parent = HRTIMER_INACTIVE;
+}
+EXPORT_SYMBOL_GPL(hrtimer_init);
+
+/**
+ * hrtimer_get_res - get the timer resolution for a clock
+ *
+ * @which_clock: which clock to query
+ * @tp:		 pointer to timespec variable to store the resolution
+ *
+ * Store the resolution of the clock selected by which_clock in the
+ * variable pointed to by tp.
+ */
+int hrtimer_get_res(const clockid_t which_clock, struct timespec *tp)
+{
+	struct hrtimer_cpu_base *cpu_base;
+
+	cpu_base = &per_cpu(hrtimer_bases, raw_smp_processor_id());
+	*tp = ktime_to_timespec(cpu_base->clock_base[which_clock].resolution);
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(hrtimer_get_res);
+
+/*
+ * Expire the timers of one clock base. Called with the cpu base lock
+ * held and interrupts disabled; the lock is dropped around the
+ * callbacks, which run with interrupts still disabled.
+ */
+static void __run_hrtimer_queue(struct hrtimer_cpu_base *cpu_base,
+				struct hrtimer_clock_base *base)
+{
+	struct rb_node *node;
+	ktime_t now;
+
+	if (!base->first)
+		return;
+
+	now = base->get_time();
+
+	while ((node = base->first)) {
+		struct hrtimer *timer;
+		int (*fn)(struct hrtimer *);
+		int restart;
+
+		timer = rb_entry(node, struct hrtimer, node);
+		if (now < timer->expires)
+			break;
+
+		fn = timer->function;
+		__remove_hrtimer(timer, base);
+		cpu_base->curr_timer = timer;
+		spin_unlock(&cpu_base->lock);
+
+		restart = fn(timer);
+
+		spin_lock(&cpu_base->lock);
+
+		if (restart != HRTIMER_NORESTART) {
+			BUG_ON(hrtimer_active(timer));
+			enqueue_hrtimer(timer, base, 0);
+		}
+	}
+	cpu_base->curr_timer = NULL;
+}
+
+#ifdef CONFIG_HIGH_RES_TIMERS
+
+/*
+ * High resolution timer interrupt
+ * Called with interrupts disabled
+ */
+static void hrtimer_interrupt(struct clock_event_device *dev,
+			      struct pt_regs *regs)
+{
+	struct hrtimer_cpu_base *cpu_base = &__get_cpu_var(hrtimer_bases);
+	int i;
+
+	__get_cpu_var(hrtimer_irq_regs) = regs;
+
+	spin_lock(&cpu_base->lock);
+	cpu_base->expires_next = KTIME_MAX;
+	for (i = 0; i < HRTIMER_MAX_CLOCK_BASES; i++)
+		__run_hrtimer_queue(cpu_base, &cpu_base->clock_base[i]);
+	hrtimer_force_reprogram(cpu_base);
+	spin_unlock(&cpu_base->lock);
+
+	__get_cpu_var(hrtimer_irq_regs) = NULL;
+}
+
+#ifdef CONFIG_NO_IDLE_HZ
+
+/* Stopping the tick of idle cpus can be disabled with nohz=off */
+static int hrtimer_nohz_enabled = 1;
+
+static int __init setup_hrtimer_nohz(char *str)
+{
+	if (!strcmp(str, "off"))
+		hrtimer_nohz_enabled = 0;
+	else if (!strcmp(str, "on"))
+		hrtimer_nohz_enabled = 1;
+	else
+		return 0;
+	return 1;
+}
+
+__setup("nohz=", setup_hrtimer_nohz);
+
+/*
+ * Upper bound for the time an idle cpu goes without a tick. The clock
+ * event device cannot be programmed that far out anyway, it just keeps
+ * the conversion to nanoseconds in range:
+ */
+#define NOHZ_MAX_IDLE_TICKS	(3600 * HZ)
+
+/*
+ * Account ticks which an idle cpu did not take as idle time.
+ * Called with interrupts disabled.
+ */
+static void hrtimer_account_idle_ticks(struct hrtimer_cpu_base *cpu_base,
+				       unsigned long ticks, int hardirq_offset)
+{
+	cpu_base->tick_stopped = 0;
+	if (!ticks)
+		return;
+	cpu_base->skipped_ticks += ticks;
+	account_system_time(current, hardirq_offset,
+			    jiffies_to_cputime(ticks));
+}
+
+static void __hrtimer_restart_sched_tick(struct hrtimer_cpu_base *cpu_base)
+{
+	struct hrtimer *timer = &cpu_base->sched_timer;
+
+	cpu_clear(smp_processor_id(), nohz_cpu_mask);
+	if (!cpu_base->tick_stopped)
+		return;
+
+	/* Forward to the first tick after now, counting the skipped ones: */
+	hrtimer_try_to_cancel(timer);
+	timer->expires = cpu_base->idle_tick;
+	hrtimer_account_idle_ticks(cpu_base,
+				   hrtimer_forward(timer, KTIME_LOW_RES), 0);
+	hrtimer_restart(timer);
+}
+
+/**
+ * hrtimer_stop_sched_tick - stop the tick of an idle cpu
+ *
+ * Called from the idle loop before the cpu halts, and again from
+ * irq_exit() for each interrupt the idle cpu takes, as the interrupt
+ * may have added timers. The tick emulation is pushed out to the next
+ * timer wheel event, unless rcu or a pending softirq needs the tick.
+ * The global tick keeps jiffies and the time of day going.
+ */
+void hrtimer_stop_sched_tick(void)
+{
+	struct hrtimer_cpu_base *cpu_base = &__get_cpu_var(hrtimer_bases);
+	struct hrtimer *timer = &cpu_base->sched_timer;
+	unsigned long flags, next, delta;
+	ktime_t expires;
+	int cpu;
+
+	if (!hrtimer_nohz_enabled)
+		return;
+
+	local_irq_save(flags);
+
+	if (!hrtimer_hres_active(cpu_base))
+		goto out;
+
+	/*
+	 * As on s390, this cpu leaves rcu_start_batch() before rcu is
+	 * asked whether it still needs us, so that a new grace period
+	 * either does not wait for this cpu or shows up as pending here.
+	 */
+	cpu = smp_processor_id();
+	cpu_set(cpu, nohz_cpu_mask);
+	if (rcu_pending(cpu) || local_softirq_pending())
+		goto restart;
+
+	next = next_timer_interrupt();
+	if (time_before_eq(next, jiffies + 1))
+		goto restart;
+
+	if (!cpu_base->tick_stopped) {
+		hrtimer_try_to_cancel(timer);
+		cpu_base->idle_tick = timer->expires;
+		cpu_base->idle_jiffies = jiffies;
+		cpu_base->tick_stopped = 1;
+	}
+
+	delta = next - cpu_base->idle_jiffies;
+	if (delta > NOHZ_MAX_IDLE_TICKS)
+		delta = NOHZ_MAX_IDLE_TICKS;
+	expires = ktime_add_ns(cpu_base->idle_tick,
+			       (u64)(delta - 1) * TICK_NSEC);
+	hrtimer_start(timer, expires, HRTIMER_ABS);
+
+	/* The device may still be set for the tick we just skipped: */
+	spin_lock(&cpu_base->lock);
+	hrtimer_force_reprogram(cpu_base);
+	spin_unlock(&cpu_base->lock);
+	goto out;
+
+restart:
+	__hrtimer_restart_sched_tick(cpu_base);
+out:
+	local_irq_restore(flags);
+}
+
+/**
+ * hrtimer_restart_sched_tick - restart the tick when the cpu leaves idle
+ *
+ * The ticks the cpu slept through are accounted as idle time.
+ */
+void hrtimer_restart_sched_tick(void)
+{
+	unsigned long flags;
+
+	local_irq_save(flags);
+	__hrtimer_restart_sched_tick(&__get_cpu_var(hrtimer_bases));
+	local_irq_restore(flags);
+}
+
+/**
+ * hrtimer_skipped_ticks - number of ticks a cpu skipped while idle
+ * @cpu:	the cpu to query
+ */
+unsigned long hrtimer_skipped_ticks(int cpu)
+{
+	return per_cpu(hrtimer_bases, cpu).skipped_ticks;
+}
+
+#endif /* CONFIG_NO_IDLE_HZ */
+
+/*
+ * Emulate the periodic per cpu tick in high resolution mode: do what
+ * the local APIC timer interrupt does in smp_local_timer_interrupt().
+ * The global tick keeps running do_timer(), and on UP it does the
+ * process accounting as well.
+ */
+static int hrtimer_sched_tick(struct hrtimer *timer)
+{
+	struct pt_regs *regs = __get_cpu_var(hrtimer_irq_regs);
+
+#ifdef CONFIG_NO_IDLE_HZ
+	struct hrtimer_cpu_base *cpu_base = &__get_cpu_var(hrtimer_bases);
+
+	/* Woken up for a timer wheel event, this tick is taken below: */
+	if (cpu_base->tick_stopped) {
+		cpu_clear(smp_processor_id(), nohz_cpu_mask);
+		timer->expires = cpu_base->idle_tick;
+		hrtimer_account_idle_ticks(cpu_base,
+				hrtimer_forward(timer, KTIME_LOW_RES) - 1,
+				HARDIRQ_OFFSET);
+	}
+#endif
+
+	if (regs) {
+		profile_tick(CPU_PROFILING, regs);
+#ifdef CONFIG_SMP
+		update_process_times(user_mode_vm(regs));
+#endif
+	}
+
+	hrtimer_forward(timer, KTIME_LOW_RES);
+
+	return HRTIMER_RESTART;
+}
+
+/*
+ * Switch this cpu to high resolution mode, once its clock event device
+ * has been registered. Called from the timer softirq.
+ */
+static int hrtimer_switch_to_hres(void)
+{
+	struct hrtimer_cpu_base *cpu_base = &__get_cpu_var(hrtimer_bases);
+	struct clock_event_device *dev;
+	unsigned long flags;
+	int i;
+
+	if (!hrtimer_hres_enabled)
+		return 0;
+
+	dev = clockevents_local_device();
+	if (!dev)
+		return 0;
+
+	local_irq_save(flags);
+
+	spin_lock(&cpu_base->lock);
+	dev->event_handler = hrtimer_interrupt;
+	clockevents_set_mode(dev, CLOCK_EVT_MODE_ONESHOT);
+	for (i = 0; i < HRTIMER_MAX_CLOCK_BASES; i++)
+		cpu_base->clock_base[i].resolution = KTIME_HIGH_RES;
+	cpu_base->hres_active = 1;
+	hrtimer_force_reprogram(cpu_base);
+	spin_unlock(&cpu_base->lock);
+
+	hrtimer_init(&cpu_base->sched_timer, CLOCK_MONOTONIC, HRTIMER_ABS);
+	cpu_base->sched_timer.function = hrtimer_sched_tick;
+	hrtimer_start(&cpu_base->sched_timer,
+		      ktime_add(ktime_get(), KTIME_LOW_RES), HRTIMER_ABS);
+
+	local_irq_restore(flags);
+
+	printk(KERN_INFO "Switched to high resolution mode on CPU %d\n",
+	       smp_processor_id());
+	return 1;
+}
+
+#endif /* CONFIG_HIGH_RES_TIMERS */
+
+/*
+ * Called from timer softirq every jiffy, expire hrtimers:
+ *
+ * For HRT its the fall back code to run the softirq in the timer
+ * softirq context in case the hrtimer initialization failed or has
+ * not been done yet.
+ */
+void hrtimer_run_queues(void)
+{
+	struct hrtimer_cpu_base *cpu_base = &__get_cpu_var(hrtimer_bases);
+	int i;
+
+	if (hrtimer_hres_active(cpu_base))
+		return;
+
+#ifdef CONFIG_HIGH_RES_TIMERS
+	if (hrtimer_switch_to_hres())
+		return;
+#endif
+
+	spin_lock_irq(&cpu_base->lock);
+	for (i = 0; i < HRTIMER_MAX_CLOCK_BASES; i++)
+		__run_hrtimer_queue(cpu_base, &cpu_base->clock_base[i]);
+	spin_unlock_irq(&cpu_base->lock);
+}
+
+/*
+ * Sleep related functions:
+ */
+static int hrtimer_wakeup(struct hrtimer *timer)
+{
+	struct hrtimer_sleeper *t =
+		container_of(timer, struct hrtimer_sleeper, timer);
+	struct task_struct *task = t->task;
+
+	t->task = NULL;
+	if (task)
+		wake_up_process(task);
+
+	return HRTIMER_NORESTART;
+}
+
+void hrtimer_init_sleeper(struct hrtimer_sleeper *sl, struct task_struct *task)
+{
+	sl->timer.function = hrtimer_wakeup;
+	sl->task = task;
+}
+
+static int __sched do_nanosleep(struct hrtimer_sleeper *t, enum hrtimer_mode mode)
+{
+	hrtimer_init_sleeper(t, current);
+
+	do {
+		set_current_state(TASK_INTERRUPTIBLE);
+		hrtimer_start(&t->timer, t->timer.expires, mode);
+
+		if (likely(t->task))
+			schedule();
+
+		hrtimer_cancel(&t->timer);
+		mode = HRTIMER_ABS;
+
+	} while (t->task && !signal_pending(current));
+
+	__set_current_state(TASK_RUNNING);
+
+	return t->task == NULL;
+}
+
+/**
+ * hrtimer_nanosleep_restart - continue an interrupted hrtimer_nanosleep()
+ *
+ * @restart:	restart block filled in by hrtimer_nanosleep()
+ * @rem:	where to store the remaining time, may be NULL
+ *
+ * When -ERESTART_RESTARTBLOCK is returned, the caller has to set
+ * restart->fn again; the rest of the restart block is still valid.
+ */
+long __sched hrtimer_nanosleep_restart(struct restart_block *restart,
+				       struct timespec *rem)
+{
+	struct hrtimer_sleeper t;
+	ktime_t time;
+
+	restart->fn = do_no_restart_syscall;
+
+	hrtimer_init(&t.timer, restart->arg0, HRTIMER_ABS);
+	t.timer.expires = ((u64)restart->arg3 << 32) | (u64) restart->arg2;
+
+	if (do_nanosleep(&t, HRTIMER_ABS))
+		return 0;
+
+	if (rem) {
+		time = hrtimer_get_remaining(&t.timer);
+		if (time <= 0)
+			return 0;
+		*rem = ktime_to_timespec(time);
+	}
+
+	/* The other values in restart are already filled in */
+	return -ERESTART_RESTARTBLOCK;
+}
+
+/**
+ * hrtimer_nanosleep - sleep on an hrtimer
+ *
+ * @rqtp:	requested sleep time
+ * @rem:	where to store the remaining time, may be NULL
+ * @mode:	HRTIMER_ABS or HRTIMER_REL
+ * @clockid:	clock the sleep time refers to
+ *
+ * Absolute sleeps are restarted from scratch when interrupted. For
+ * relative ones the absolute expiry time is kept in the restart block
+ * and -ERESTART_RESTARTBLOCK is returned: the caller sets restart->fn
+ * and restart->arg1 and its restart function calls
+ * hrtimer_nanosleep_restart().
+ */
+long __sched hrtimer_nanosleep(struct timespec *rqtp, struct timespec *rem,
+			       const enum hrtimer_mode mode,
+			       const clockid_t clockid)
+{
+	struct restart_block *restart;
+	struct hrtimer_sleeper t;
+	ktime_t time;
+
+	hrtimer_init(&t.timer, clockid, mode);
+	t.timer.expires = timespec_to_ktime(*rqtp);
+	if (do_nanosleep(&t, mode))
+		return 0;
+
+	/* Absolute timers do not update the rmtp value and restart: */
+	if (mode == HRTIMER_ABS)
+		return -ERESTARTNOHAND;
+
+	if (rem) {
+		time = hrtimer_get_remaining(&t.timer);
+		if (time <= 0)
+			return 0;
+		*rem = ktime_to_timespec(time);
+	}
+
+	restart = &current_thread_info()->restart_block;
+	restart->fn = do_no_restart_syscall;
+	restart->arg0 = (unsigned long) t.timer.base->index;
+	restart->arg2 = (u64) t.timer.expires & 0xFFFFFFFF;
+	restart->arg3 = (u64) t.timer.expires >> 32;
+
+	return -ERESTART_RESTARTBLOCK;
+}
+
+/*
+ * Functions related to boot-time initialization:
+ */
+static void __devinit init_hrtimers_cpu(int cpu)
+{
+	struct hrtimer_cpu_base *cpu_base = &per_cpu(hrtimer_bases, cpu);
+	int i;
+
+	spin_lock_init(&cpu_base->lock);
+	for (i = 0; i < HRTIMER_MAX_CLOCK_BASES; i++) {
+		cpu_base->clock_base[i].cpu_base = cpu_base;
+		cpu_base->clock_base[i].resolution = KTIME_LOW_RES;
+	}
+#ifdef CONFIG_HIGH_RES_TIMERS
+	cpu_base->expires_next = KTIME_MAX;
+	cpu_base->hres_active = 0;
+#endif
+#ifdef CONFIG_NO_IDLE_HZ
+	cpu_base->tick_stopped = 0;
+#endif
+}
+
+#ifdef CONFIG_HOTPLUG_CPU
+
+static void migrate_hrtimer_list(struct hrtimer_clock_base *old_base,
+				 struct hrtimer_clock_base *new_base)
+{
+	struct hrtimer *timer;
+	struct rb_node *node;
+
+	while ((node = rb_first(&old_base->active))) {
+		timer = rb_entry(node, struct hrtimer, node);
+		__remove_hrtimer(timer, old_base);
+		timer->base = new_base;
+		enqueue_hrtimer(timer, new_base, 1);
+	}
+}
+
+static void migrate_hrtimers(int cpu)
+{
+	struct hrtimer_cpu_base *old_base, *new_base;
+	int i;
+
+	BUG_ON(cpu_online(cpu));
+	old_base = &per_cpu(hrtimer_bases, cpu);
+	new_base = &get_cpu_var(hrtimer_bases);
+
+	local_irq_disable();
+
+	spin_lock(&new_base->lock);
+	spin_lock(&old_base->lock);
+
+	BUG_ON(old_base->curr_timer);
+
+#ifdef CONFIG_HIGH_RES_TIMERS
+	/* The tick emulation of the dead cpu goes away with it: */
+	if (old_base->hres_active)
+		remove_hrtimer(&old_base->sched_timer,
+			       old_base->sched_timer.base);
+#endif
+#ifdef CONFIG_NO_IDLE_HZ
+	cpu_clear(cpu, nohz_cpu_mask);
+#endif
+	for (i = 0; i < HRTIMER_MAX_CLOCK_BASES; i++)
+		migrate_hrtimer_list(&old_base->clock_base[i],
+				     &new_base->clock_base[i]);
+
+	spin_unlock(&old_base->lock);
+	spin_unlock(&new_base->lock);
+
+	local_irq_enable();
+	put_cpu_var(hrtimer_bases);
+}
+#endif /* CONFIG_HOTPLUG_CPU */
+
+static int __devinit hrtimer_cpu_notify(struct notifier_block *self,
+					unsigned long action, void *hcpu)
+{
+	long cpu = (long)hcpu;
+
+	switch (action) {
+
+	case CPU_UP_PREPARE:
+		init_hrtimers_cpu(cpu);
+		break;
+
+#ifdef CONFIG_HOTPLUG_CPU
+	case CPU_DEAD:
+		migrate_hrtimers(cpu);
+		break;
+#endif
+
+	default:
+		break;
+	}
+
+	return NOTIFY_OK;
+}
+
+static struct notifier_block __devinitdata hrtimers_nb = {
+	.notifier_call = hrtimer_cpu_notify,
+};
+
+void __init hrtimers_init(void)
+{
+	hrtimer_cpu_notify(&hrtimers_nb, (unsigned long)CPU_UP_PREPARE,
+			  (void *)(long)smp_processor_id());
+	register_cpu_notifier(&hrtimers_nb);
+}
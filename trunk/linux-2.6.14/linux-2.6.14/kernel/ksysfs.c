@@ -43,6 +43,10 @@ KERNEL_ATTR_RO(crash_notes);
 decl_subsys(kernel, NULL, NULL);
 EXPORT_SYMBOL_GPL(kernel_subsys);
 
+/* /sys/kernel/mm, the parent of the memory management tunables */
+decl_subsys(mm, NULL, NULL);
+EXPORT_SYMBOL_GPL(mm_subsys);
+
 static struct attribute * kernel_attrs[] = {
 #ifdef CONFIG_HOTPLUG
 	&hotplug_seqnum_attr.attr,
@@ -63,6 +67,10 @@ static int __init ksysfs_init(void)
 	if (!error)
 		error = sysfs_create_group(&kernel_subsys.kset.kobj,
 					   &kernel_attr_group);
+	if (!error) {
+		mm_subsys.kset.kobj.parent = &kernel_subsys.kset.kobj;
+		error = subsystem_register(&mm_subsys);
+	}
 
 	return error;
 }
@@ -16,6 +16,8 @@
  *		by Davide Libenzi, preemptible kernel bits by Robert Love.
  *  2003-09-03	Interactivity tuning by Con Kolivas.
  *  2004-04-02	Scheduler domains code by Nick Piggin
+ *		Scheduling classes and the SCHED_FAIR virtual runtime
+ *		class, see kernel/sched_fair.c
  */
 
 #include <linux/mm.h>
@@ -47,7 +49,9 @@
 #include <linux/syscalls.h>
 #include <linux/times.h>
 #include <linux/acct.h>
+#include <linux/numa_balancing.h>
 #include <asm/tlb.h>
+#include <asm/div64.h>
 
 #include <asm/unistd.h>
 
@@ -154,6 +158,15 @@
 #define TASK_PREEMPTS_CURR(p, rq) \
 	((p)->prio < (rq)->curr->prio)
 
+#define rt_policy(policy) \
+	((policy) == SCHED_FIFO || (policy) == SCHED_RR)
+
+/*
+ * SCHED_FAIR tasks compete against the priority arrays as a single
+ * nice 0 entity: they all carry this ->prio.
+ */
+#define FAIR_PRIO		NICE_TO_PRIO(0)
+
 /*
  * task_timeslice() scales user-nice values [ -20 ... 0 ... 19 ]
  * to time slice values: [800ms ... 100ms ... 5ms]
@@ -190,6 +203,22 @@ struct prio_array {
 	struct list_head queue[MAX_PRIO];
 };
 
+/*
+ * SCHED_FAIR tasks, ordered by virtual runtime. The running task
+ * (curr) is kept out of the tree while it runs.
+ */
+struct fair_rq {
+	struct rb_root tasks_timeline;
+	struct rb_node *rb_leftmost;
+	task_t *curr;
+	unsigned long nr_running;
+	unsigned long load;
+	unsigned long long min_vruntime;
+	/* nanoseconds run since the last array switch, see fair_epoch() */
+	unsigned long long epoch_used;
+	int expired;
+};
+
 /*
  * This is the main, per-CPU runqueue data structure.
  *
@@ -224,6 +253,7 @@ struct runqueue {
 	struct mm_struct *prev_mm;
 	prio_array_t *active, *expired, arrays[2];
 	int best_expired_prio;
+	struct fair_rq fair;
 	atomic_t nr_iowait;
 
 #ifdef CONFIG_SMP
@@ -275,6 +305,44 @@ for (domain = rcu_dereference(cpu_rq(cpu)->sd); domain; domain = domain->parent)
 #define task_rq(p)		cpu_rq(task_cpu(p))
 #define cpu_curr(cpu)		(cpu_rq(cpu)->curr)
 
+/*
+ * Scheduling class operations. All of them are called with the
+ * runqueue lock held. Selecting the next task is not a class
+ * operation: pick_next_task() arbitrates between the priority
+ * arrays and the fair runqueue.
+ *
+ * put_prev_task() is called when p stops running, set_curr_task()
+ * when an already running task is moved into a class.
+ * migrate_task() is called before p changes CPU from src to dst.
+ * task_new() is optional, the default places a new task in the
+ * priority arrays.
+ */
+struct sched_class {
+	void (*enqueue_task)(runqueue_t *rq, task_t *p);
+	void (*dequeue_task)(runqueue_t *rq, task_t *p);
+	void (*yield_task)(runqueue_t *rq, task_t *p);
+	void (*put_prev_task)(runqueue_t *rq, task_t *p);
+	void (*set_curr_task)(runqueue_t *rq, task_t *p);
+	void (*task_tick)(runqueue_t *rq, task_t *p);
+	int (*check_preempt_curr)(runqueue_t *rq, task_t *p);
+	void (*migrate_task)(task_t *p, runqueue_t *src, runqueue_t *dst);
+	void (*task_new)(runqueue_t *rq, task_t *p);
+};
+
+static const struct sched_class prio_sched_class;
+static const struct sched_class fair_sched_class;
+
+/*
+ * task_preempts_curr - should p preempt the task running on rq?
+ * Tasks of different classes are compared by priority.
+ */
+static inline int task_preempts_curr(task_t *p, runqueue_t *rq)
+{
+	if (p->sched_class != rq->curr->sched_class)
+		return TASK_PREEMPTS_CURR(p, rq);
+	return p->sched_class->check_preempt_curr(rq, p);
+}
+
 #ifndef prepare_arch_switch
 # define prepare_arch_switch(next)	do { } while (0)
 #endif
@@ -659,12 +727,47 @@ static int effective_prio(task_t *p)
 	return prio;
 }
 
+/*
+ * The priority array class: SCHED_FIFO, SCHED_RR and SCHED_NORMAL.
+ */
+static void enqueue_task_prio(runqueue_t *rq, task_t *p)
+{
+	enqueue_task(p, rq->active);
+}
+
+static void dequeue_task_prio(runqueue_t *rq, task_t *p)
+{
+	dequeue_task(p, p->array);
+	p->array = NULL;
+}
+
+/*
+ * The running task stays queued in its array, nothing to do:
+ */
+static void put_prev_task_prio(runqueue_t *rq, task_t *p)
+{
+}
+
+static void set_curr_task_prio(runqueue_t *rq, task_t *p)
+{
+}
+
+static int check_preempt_curr_prio(runqueue_t *rq, task_t *p)
+{
+	return TASK_PREEMPTS_CURR(p, rq);
+}
+
+static void migrate_task_prio(task_t *p, runqueue_t *src, runqueue_t *dst)
+{
+}
+
 /*
  * __activate_task - move a task to the runqueue.
  */
 static inline void __activate_task(task_t *p, runqueue_t *rq)
 {
-	enqueue_task(p, rq->active);
+	p->sched_class->enqueue_task(rq, p);
+	p->on_rq = 1;
 	rq->nr_running++;
 }
 
@@ -674,6 +777,7 @@ static inline void __activate_task(task_t *p, runqueue_t *rq)
 static inline void __activate_idle_task(task_t *p, runqueue_t *rq)
 {
 	enqueue_task_head(p, rq->active);
+	p->on_rq = 1;
 	rq->nr_running++;
 }
 
@@ -759,6 +863,16 @@ static void activate_task(task_t *p, runqueue_t *rq, int local)
 	}
 #endif
 
+	/*
+	 * SCHED_FAIR tasks are charged by their runtime alone, the
+	 * sleep average does not apply to them:
+	 */
+	if (p->sched_class != &prio_sched_class) {
+		p->timestamp = now;
+		__activate_task(p, rq);
+		return;
+	}
+
 	p->prio = recalc_task_prio(p, now);
 
 	/*
@@ -794,8 +908,8 @@ static void activate_task(task_t *p, runqueue_t *rq, int local)
 static void deactivate_task(struct task_struct *p, runqueue_t *rq)
 {
 	rq->nr_running--;
-	dequeue_task(p, p->array);
-	p->array = NULL;
+	p->sched_class->dequeue_task(rq, p);
+	p->on_rq = 0;
 }
 
 /*
@@ -836,6 +950,8 @@ inline int task_curr(const task_t *p)
 	return cpu_curr(task_cpu(p)) == p;
 }
 
+#include "sched_fair.c"
+
 #ifdef CONFIG_SMP
 typedef struct {
 	struct list_head list;
@@ -858,7 +974,8 @@ static int migrate_task(task_t *p, int dest_cpu, migration_req_t *req)
 	 * If the task is not on a runqueue (and not running), then
 	 * it is sufficient to simply update the task's cpu field.
 	 */
-	if (!p->array && !task_running(rq, p)) {
+	if (!p->on_rq && !task_running(rq, p)) {
+		p->sched_class->migrate_task(p, rq, cpu_rq(dest_cpu));
 		set_task_cpu(p, dest_cpu);
 		return 0;
 	}
@@ -888,7 +1005,7 @@ void wait_task_inactive(task_t *p)
 repeat:
 	rq = task_rq_lock(p, &flags);
 	/* Must be off runqueue entirely, not preempted. */
-	if (unlikely(p->array || task_running(rq, p))) {
+	if (unlikely(p->on_rq || task_running(rq, p))) {
 		/* If it's preempted, we yield.  It could be a while. */
 		preempted = !task_running(rq, p);
 		task_rq_unlock(rq, &flags);
@@ -1157,7 +1274,7 @@ static int try_to_wake_up(task_t *p, unsigned int state, int sync)
 	if (!(old_state & state))
 		goto out;
 
-	if (p->array)
+	if (p->on_rq)
 		goto out_running;
 
 	cpu = task_cpu(p);
@@ -1239,6 +1356,7 @@ static int try_to_wake_up(task_t *p, unsigned int state, int sync)
 out_set_cpu:
 	new_cpu = wake_idle(new_cpu, p);
 	if (new_cpu != cpu) {
+		p->sched_class->migrate_task(p, rq, cpu_rq(new_cpu));
 		set_task_cpu(p, new_cpu);
 		task_rq_unlock(rq, &flags);
 		/* might preempt at this point */
@@ -1246,7 +1364,7 @@ out_set_cpu:
 		old_state = p->state;
 		if (!(old_state & state))
 			goto out;
-		if (p->array)
+		if (p->on_rq)
 			goto out_running;
 
 		this_cpu = smp_processor_id();
@@ -1283,7 +1401,7 @@ out_activate:
 	 * to be considered on this CPU.)
 	 */
 	if (!sync || cpu != this_cpu) {
-		if (TASK_PREEMPTS_CURR(p, rq))
+		if (task_preempts_curr(p, rq))
 			resched_task(rq->curr);
 	}
 	success = 1;
@@ -1331,6 +1449,8 @@ void fastcall sched_fork(task_t *p, int clone_flags)
 	p->state = TASK_RUNNING;
 	INIT_LIST_HEAD(&p->run_list);
 	p->array = NULL;
+	p->on_rq = 0;
+	p->sum_exec_runtime = p->prev_sum_exec_runtime = 0;
 #ifdef CONFIG_SCHEDSTATS
 	memset(&p->sched_info, 0, sizeof(p->sched_info));
 #endif
@@ -1386,6 +1506,16 @@ void fastcall wake_up_new_task(task_t *p, unsigned long clone_flags)
 	this_cpu = smp_processor_id();
 	cpu = task_cpu(p);
 
+	if (p->sched_class->task_new) {
+		p->sched_class->task_new(rq, p);
+		p->on_rq = 1;
+		rq->nr_running++;
+		if (task_preempts_curr(p, rq))
+			resched_task(rq->curr);
+		task_rq_unlock(rq, &flags);
+		return;
+	}
+
 	/*
 	 * We decrease the sleep average of forking parents
 	 * and children as well, to keep max-interactive tasks
@@ -1411,6 +1541,7 @@ void fastcall wake_up_new_task(task_t *p, unsigned long clone_flags)
 				list_add_tail(&p->run_list, &current->run_list);
 				p->array = current->array;
 				p->array->nr_active++;
+				p->on_rq = 1;
 				rq->nr_running++;
 			}
 			set_need_resched();
@@ -1434,7 +1565,7 @@ void fastcall wake_up_new_task(task_t *p, unsigned long clone_flags)
 		p->timestamp = (p->timestamp - this_rq->timestamp_last_tick)
 					+ rq->timestamp_last_tick;
 		__activate_task(p, rq);
-		if (TASK_PREEMPTS_CURR(p, rq))
+		if (task_preempts_curr(p, rq))
 			resched_task(rq->curr);
 
 		/*
@@ -1766,10 +1897,36 @@ void pull_task(runqueue_t *src_rq, prio_array_t *src_array, task_t *p,
 	 * Note that idle threads have a prio of MAX_PRIO, for this test
 	 * to be always true for them.
 	 */
-	if (TASK_PREEMPTS_CURR(p, this_rq))
+	if (task_preempts_curr(p, this_rq))
 		resched_task(this_rq->curr);
 }
 
+#ifdef CONFIG_NUMA_BALANCING
+/*
+ * Does moving p to this_cpu take it to the node most of its NUMA hinting
+ * faults come from (> 0), or away from it (< 0)?  See mm/numa_balancing.c.
+ */
+static inline int task_numa_locality(task_t *p, int this_cpu)
+{
+	int nid = p->numa_preferred_nid;
+	int src_nid = cpu_to_node(task_cpu(p));
+	int dst_nid = cpu_to_node(this_cpu);
+
+	if (nid < 0 || src_nid == dst_nid)
+		return 0;
+	if (dst_nid == nid)
+		return 1;
+	if (src_nid == nid)
+		return -1;
+	return 0;
+}
+#else
+static inline int task_numa_locality(task_t *p, int this_cpu)
+{
+	return 0;
+}
+#endif
+
 /*
  * can_migrate_task - may task p from runqueue rq be migrated to this_cpu?
  */
@@ -1778,11 +1935,14 @@ int can_migrate_task(task_t *p, runqueue_t *rq, int this_cpu,
 		     struct sched_domain *sd, enum idle_type idle,
 		     int *all_pinned)
 {
+	int locality;
+
 	/*
 	 * We do not migrate tasks that are:
 	 * 1) running (obviously), or
 	 * 2) cannot be migrated to this CPU due to cpus_allowed, or
-	 * 3) are cache-hot on their current CPU.
+	 * 3) are cache-hot on their current CPU, or
+	 * 4) are on the node their memory is on.
 	 */
 	if (!cpu_isset(this_cpu, p->cpus_allowed))
 		return 0;
@@ -1791,6 +1951,11 @@ int can_migrate_task(task_t *p, runqueue_t *rq, int this_cpu,
 	if (task_running(rq, p))
 		return 0;
 
+	/* A task goes to the node its memory is on even if cache-hot */
+	locality = task_numa_locality(p, this_cpu);
+	if (locality > 0)
+		return 1;
+
 	/*
 	 * Aggressive migration if:
 	 * 1) task is cache cold, or
@@ -1800,11 +1965,63 @@ int can_migrate_task(task_t *p, runqueue_t *rq, int this_cpu,
 	if (sd->nr_balance_failed > sd->cache_nice_tries)
 		return 1;
 
+	if (locality < 0)
+		return 0;
 	if (task_hot(p, rq->timestamp_last_tick, sd))
 		return 0;
 	return 1;
 }
 
+/*
+ * pull_fair_task - pull_task() for SCHED_FAIR tasks.
+ * Both runqueues must be locked.
+ */
+static void pull_fair_task(runqueue_t *src_rq, task_t *p,
+			   runqueue_t *this_rq, int this_cpu)
+{
+	deactivate_task(p, src_rq);
+	p->sched_class->migrate_task(p, src_rq, this_rq);
+	set_task_cpu(p, this_cpu);
+	__activate_task(p, this_rq);
+	p->timestamp = (p->timestamp - src_rq->timestamp_last_tick)
+				+ this_rq->timestamp_last_tick;
+	if (task_preempts_curr(p, this_rq))
+		resched_task(this_rq->curr);
+}
+
+/*
+ * move_fair_tasks - move up to max_nr_move SCHED_FAIR tasks from busiest
+ * to this_rq. The tasks with the largest virtual runtime will wait the
+ * longest on busiest, so they are taken first.
+ *
+ * Called with both runqueues locked.
+ */
+static int move_fair_tasks(runqueue_t *this_rq, int this_cpu,
+			   runqueue_t *busiest, unsigned long max_nr_move,
+			   struct sched_domain *sd, enum idle_type idle,
+			   int *all_pinned)
+{
+	struct rb_node *node, *prev;
+	int pulled = 0;
+	task_t *p;
+
+	node = rb_last(&busiest->fair.tasks_timeline);
+	for (; node && pulled < max_nr_move; node = prev) {
+		prev = rb_prev(node);
+		p = rb_entry(node, task_t, run_node);
+		if (!can_migrate_task(p, busiest, this_cpu, sd, idle,
+				      all_pinned))
+			continue;
+#ifdef CONFIG_SCHEDSTATS
+		if (task_hot(p, busiest->timestamp_last_tick, sd))
+			schedstat_inc(sd, lb_hot_gained[idle]);
+#endif
+		pull_fair_task(busiest, p, this_rq, this_cpu);
+		pulled++;
+	}
+	return pulled;
+}
+
 /*
  * move_tasks tries to move up to max_nr_move tasks from busiest to this_rq,
  * as part of a balancing operation within "domain". Returns the number of
@@ -1887,6 +2104,9 @@ skip_queue:
 		goto skip_bitmap;
 	}
 out:
+	if (pulled < max_nr_move)
+		pulled += move_fair_tasks(this_rq, this_cpu, busiest,
+				max_nr_move - pulled, sd, idle, &pinned);
 	/*
 	 * Right now, this is the only place pull_task() is called,
 	 * so we can safely collect pull_task() stats here rather than
@@ -2333,6 +2553,36 @@ out:
 /* Don't have all balancing operations going off at once */
 #define CPU_OFFSET(cpu) (HZ * cpu / NR_CPUS)
 
+#ifdef CONFIG_NO_IDLE_HZ
+/*
+ * Idle cpus which have stopped their tick do not run rebalance_tick().
+ * A busy cpu which is due to balance a domain kicks one of them, so it
+ * can pull work over in idle_balance().
+ */
+static void wake_nohz_idle_cpu(int this_cpu, struct sched_domain *sd)
+{
+	cpumask_t mask;
+	runqueue_t *rq;
+	int cpu;
+
+	cpus_and(mask, sd->span, nohz_cpu_mask);
+	cpu_clear(this_cpu, mask);
+	if (cpus_empty(mask))
+		return;
+
+	cpu = first_cpu(mask);
+	rq = cpu_rq(cpu);
+	spin_lock(&rq->lock);
+	if (rq->curr == rq->idle)
+		resched_task(rq->idle);
+	spin_unlock(&rq->lock);
+}
+#else
+static inline void wake_nohz_idle_cpu(int this_cpu, struct sched_domain *sd)
+{
+}
+#endif
+
 static void rebalance_tick(int this_cpu, runqueue_t *this_rq,
 			   enum idle_type idle)
 {
@@ -2373,6 +2623,8 @@ static void rebalance_tick(int this_cpu, runqueue_t *this_rq,
 			interval = 1;
 
 		if (j - sd->last_balance >= interval) {
+			if (idle != SCHED_IDLE && this_rq->nr_running > 1)
+				wake_nohz_idle_cpu(this_cpu, sd);
 			if (load_balance(this_cpu, this_rq, sd, idle)) {
 				/*
 				 * We've pulled tasks over so either we're no
@@ -2537,36 +2789,15 @@ void account_steal_time(struct task_struct *p, cputime_t steal)
 }
 
 /*
- * This function gets called by the timer code, with HZ frequency.
- * We call it with interrupts disabled.
- *
- * It also gets called by the fork code, when changing the parent's
- * timeslices.
+ * Timer tick for the priority array class, with the runqueue lock held.
  */
-void scheduler_tick(void)
+static void task_tick_prio(runqueue_t *rq, task_t *p)
 {
-	int cpu = smp_processor_id();
-	runqueue_t *rq = this_rq();
-	task_t *p = current;
-	unsigned long long now = sched_clock();
-
-	update_cpu_clock(p, rq, now);
-
-	rq->timestamp_last_tick = now;
-
-	if (p == rq->idle) {
-		if (wake_priority_sleeper(rq))
-			goto out;
-		rebalance_tick(cpu, rq, SCHED_IDLE);
-		return;
-	}
-
 	/* Task might have expired already, but not scheduled off yet */
 	if (p->array != rq->active) {
 		set_tsk_need_resched(p);
-		goto out;
+		return;
 	}
-	spin_lock(&rq->lock);
 	/*
 	 * The task was running during this tick - update the
 	 * time slice counter. Note: we do not update a thread's
@@ -2587,7 +2818,7 @@ void scheduler_tick(void)
 			/* put it at the end of the queue: */
 			requeue_task(p, rq->active);
 		}
-		goto out_unlock;
+		return;
 	}
 	if (!--p->time_slice) {
 		dequeue_task(p, rq->active);
@@ -2630,8 +2861,82 @@ void scheduler_tick(void)
 			set_tsk_need_resched(p);
 		}
 	}
-out_unlock:
+}
+
+/*
+ * sched_yield() for the priority array class:
+ *
+ * We implement yielding by moving the task into the expired
+ * queue.
+ *
+ * (special rule: RT tasks will just roundrobin in the active
+ *  array.)
+ */
+static void yield_task_prio(runqueue_t *rq, task_t *p)
+{
+	prio_array_t *array = p->array;
+	prio_array_t *target = rq->expired;
+
+	if (rt_task(p))
+		target = rq->active;
+
+	if (array->nr_active == 1) {
+		schedstat_inc(rq, yld_act_empty);
+		if (!rq->expired->nr_active)
+			schedstat_inc(rq, yld_both_empty);
+	} else if (!rq->expired->nr_active)
+		schedstat_inc(rq, yld_exp_empty);
+
+	if (array != target) {
+		dequeue_task(p, array);
+		enqueue_task(p, target);
+	} else
+		/*
+		 * requeue_task is cheaper so perform that if possible.
+		 */
+		requeue_task(p, array);
+}
+
+static const struct sched_class prio_sched_class = {
+	.enqueue_task		= enqueue_task_prio,
+	.dequeue_task		= dequeue_task_prio,
+	.yield_task		= yield_task_prio,
+	.put_prev_task		= put_prev_task_prio,
+	.set_curr_task		= set_curr_task_prio,
+	.task_tick		= task_tick_prio,
+	.check_preempt_curr	= check_preempt_curr_prio,
+	.migrate_task		= migrate_task_prio,
+};
+
+/*
+ * This function gets called by the timer code, with HZ frequency.
+ * We call it with interrupts disabled.
+ *
+ * It also gets called by the fork code, when changing the parent's
+ * timeslices.
+ */
+void scheduler_tick(void)
+{
+	int cpu = smp_processor_id();
+	runqueue_t *rq = this_rq();
+	task_t *p = current;
+	unsigned long long now = sched_clock();
+
+	update_cpu_clock(p, rq, now);
+
+	rq->timestamp_last_tick = now;
+
+	if (p == rq->idle) {
+		if (wake_priority_sleeper(rq))
+			goto out;
+		rebalance_tick(cpu, rq, SCHED_IDLE);
+		return;
+	}
+
+	spin_lock(&rq->lock);
+	p->sched_class->task_tick(rq, p);
 	spin_unlock(&rq->lock);
+	task_tick_numa(p);
 out:
 	rebalance_tick(cpu, rq, NOT_IDLE);
 }
@@ -2732,7 +3037,9 @@ static inline int dependent_sleeper(int this_cpu, runqueue_t *this_rq)
 	array = this_rq->active;
 	if (!array->nr_active)
 		array = this_rq->expired;
-	BUG_ON(!array->nr_active);
+	/* Only SCHED_FAIR tasks are runnable */
+	if (!array->nr_active)
+		goto out_unlock;
 
 	p = list_entry(array->queue[sched_find_first_bit(array->bitmap)].next,
 		task_t, run_list);
@@ -2841,6 +3148,73 @@ EXPORT_SYMBOL(sub_preempt_count);
 
 #endif
 
+static task_t *pick_next_task_prio(runqueue_t *rq, prio_array_t *array,
+				   unsigned long long now)
+{
+	struct list_head *queue;
+	task_t *next;
+	int idx, new_prio;
+
+	idx = sched_find_first_bit(array->bitmap);
+	queue = array->queue + idx;
+	next = list_entry(queue->next, task_t, run_list);
+
+	if (!rt_task(next) && next->activated > 0) {
+		unsigned long long delta = now - next->timestamp;
+		if (unlikely((long long)(now - next->timestamp) < 0))
+			delta = 0;
+
+		if (next->activated == 1)
+			delta = delta * (ON_RUNQUEUE_WEIGHT * 128 / 100) / 128;
+
+		array = next->array;
+		new_prio = recalc_task_prio(next, next->timestamp + delta);
+
+		if (unlikely(next->prio != new_prio)) {
+			dequeue_task(next, array);
+			next->prio = new_prio;
+			enqueue_task(next, array);
+		} else
+			requeue_task(next, array);
+	}
+	return next;
+}
+
+/*
+ * pick_next_task - choose the next task to run on a non-empty runqueue.
+ *
+ * The fair runqueue runs as one nice 0 entity of the priority arrays,
+ * winning ties. Once it has used up its epoch it waits for the next
+ * array switch, like an expired task.
+ */
+static task_t *pick_next_task(runqueue_t *rq, unsigned long long now)
+{
+	prio_array_t *array = rq->active;
+	struct fair_rq *fr = &rq->fair;
+
+	if (unlikely(fr->curr))
+		put_prev_task_fair(rq, fr->curr);
+
+	if (unlikely(!array->nr_active)) {
+		/*
+		 * Switch the active and expired arrays.
+		 */
+		schedstat_inc(rq, sched_switch);
+		rq->active = rq->expired;
+		rq->expired = array;
+		array = rq->active;
+		rq->expired_timestamp = 0;
+		rq->best_expired_prio = MAX_PRIO;
+		fair_new_epoch(rq);
+	}
+
+	if (fr->nr_running && (!fr->expired || !array->nr_active) &&
+			sched_find_first_bit(array->bitmap) >= FAIR_PRIO)
+		return pick_next_task_fair(rq);
+
+	return pick_next_task_prio(rq, array, now);
+}
+
 /*
  * schedule() is the main scheduler function.
  */
@@ -2849,11 +3223,9 @@ asmlinkage void __sched schedule(void)
 	long *switch_count;
 	task_t *prev, *next;
 	runqueue_t *rq;
-	prio_array_t *array;
-	struct list_head *queue;
 	unsigned long long now;
 	unsigned long run_time;
-	int cpu, idx, new_prio;
+	int cpu;
 
 	/*
 	 * Test if we are atomic.  Since do_exit() needs to call into
@@ -2918,6 +3290,7 @@ need_resched_nonpreemptible:
 			deactivate_task(prev, rq);
 		}
 	}
+	prev->sched_class->put_prev_task(rq, prev);
 
 	cpu = smp_processor_id();
 	if (unlikely(!rq->nr_running)) {
@@ -2949,41 +3322,7 @@ go_idle:
 			goto go_idle;
 	}
 
-	array = rq->active;
-	if (unlikely(!array->nr_active)) {
-		/*
-		 * Switch the active and expired arrays.
-		 */
-		schedstat_inc(rq, sched_switch);
-		rq->active = rq->expired;
-		rq->expired = array;
-		array = rq->active;
-		rq->expired_timestamp = 0;
-		rq->best_expired_prio = MAX_PRIO;
-	}
-
-	idx = sched_find_first_bit(array->bitmap);
-	queue = array->queue + idx;
-	next = list_entry(queue->next, task_t, run_list);
-
-	if (!rt_task(next) && next->activated > 0) {
-		unsigned long long delta = now - next->timestamp;
-		if (unlikely((long long)(now - next->timestamp) < 0))
-			delta = 0;
-
-		if (next->activated == 1)
-			delta = delta * (ON_RUNQUEUE_WEIGHT * 128 / 100) / 128;
-
-		array = next->array;
-		new_prio = recalc_task_prio(next, next->timestamp + delta);
-
-		if (unlikely(next->prio != new_prio)) {
-			dequeue_task(next, array);
-			next->prio = new_prio;
-			enqueue_task(next, array);
-		} else
-			requeue_task(next, array);
-	}
+	next = pick_next_task(rq, now);
 	next->activated = 0;
 switch_tasks:
 	if (next == rq->idle)
@@ -3431,9 +3770,8 @@ EXPORT_SYMBOL(sleep_on_timeout);
 void set_user_nice(task_t *p, long nice)
 {
 	unsigned long flags;
-	prio_array_t *array;
 	runqueue_t *rq;
-	int old_prio, new_prio, delta;
+	int old_prio, new_prio, delta, on_rq, running;
 
 	if (TASK_NICE(p) == nice || nice < -20 || nice > 19)
 		return;
@@ -3450,20 +3788,30 @@ void set_user_nice(task_t *p, long nice)
 	 */
 	if (rt_task(p)) {
 		p->static_prio = NICE_TO_PRIO(nice);
+		set_load_weight(p);
 		goto out_unlock;
 	}
-	array = p->array;
-	if (array)
-		dequeue_task(p, array);
+	on_rq = p->on_rq;
+	running = rq->curr == p;
+	if (on_rq) {
+		if (running)
+			p->sched_class->put_prev_task(rq, p);
+		p->sched_class->dequeue_task(rq, p);
+	}
 
 	old_prio = p->prio;
 	new_prio = NICE_TO_PRIO(nice);
 	delta = new_prio - old_prio;
 	p->static_prio = NICE_TO_PRIO(nice);
-	p->prio += delta;
-
-	if (array) {
-		enqueue_task(p, array);
+	set_load_weight(p);
+	/* SCHED_FAIR tasks keep FAIR_PRIO, their weight changed instead */
+	if (p->sched_class == &prio_sched_class)
+		p->prio += delta;
+
+	if (on_rq) {
+		p->sched_class->enqueue_task(rq, p);
+		if (running)
+			p->sched_class->set_curr_task(rq, p);
 		/*
 		 * If the task increased its priority or is running and
 		 * lowered its priority, then reschedule its CPU:
@@ -3588,10 +3936,17 @@ static inline task_t *find_process_by_pid(pid_t pid)
 /* Actually do priority change: must hold rq lock. */
 static void __setscheduler(struct task_struct *p, int policy, int prio)
 {
-	BUG_ON(p->array);
+	BUG_ON(p->on_rq);
 	p->policy = policy;
 	p->rt_priority = prio;
-	if (policy != SCHED_NORMAL)
+	set_load_weight(p);
+	if (policy == SCHED_FAIR) {
+		p->sched_class = &fair_sched_class;
+		p->prio = FAIR_PRIO;
+		return;
+	}
+	p->sched_class = &prio_sched_class;
+	if (rt_policy(policy))
 		p->prio = MAX_RT_PRIO-1 - p->rt_priority;
 	else
 		p->prio = p->static_prio;
@@ -3608,8 +3963,7 @@ int sched_setscheduler(struct task_struct *p, int policy,
 		       struct sched_param *param)
 {
 	int retval;
-	int oldprio, oldpolicy = -1;
-	prio_array_t *array;
+	int oldprio, oldpolicy = -1, on_rq, running;
 	unsigned long flags;
 	runqueue_t *rq;
 
@@ -3617,30 +3971,33 @@ recheck:
 	/* double check policy once rq lock held */
 	if (policy < 0)
 		policy = oldpolicy = p->policy;
-	else if (policy != SCHED_FIFO && policy != SCHED_RR &&
-				policy != SCHED_NORMAL)
+	else if (!rt_policy(policy) && policy != SCHED_NORMAL &&
+				policy != SCHED_FAIR)
 			return -EINVAL;
 	/*
 	 * Valid priorities for SCHED_FIFO and SCHED_RR are
-	 * 1..MAX_USER_RT_PRIO-1, valid priority for SCHED_NORMAL is 0.
+	 * 1..MAX_USER_RT_PRIO-1, valid priority for SCHED_NORMAL and
+	 * SCHED_FAIR is 0.
 	 */
 	if (param->sched_priority < 0 ||
 	    (p->mm && param->sched_priority > MAX_USER_RT_PRIO-1) ||
 	    (!p->mm && param->sched_priority > MAX_RT_PRIO-1))
 		return -EINVAL;
-	if ((policy == SCHED_NORMAL) != (param->sched_priority == 0))
+	if (rt_policy(policy) != (param->sched_priority != 0))
 		return -EINVAL;
 
 	/*
-	 * Allow unprivileged RT tasks to decrease priority:
+	 * Allow unprivileged RT tasks to decrease priority, and
+	 * switching between SCHED_NORMAL and SCHED_FAIR:
 	 */
 	if (!capable(CAP_SYS_NICE)) {
 		/* can't change policy */
 		if (policy != p->policy &&
+		    (rt_policy(policy) || rt_policy(p->policy)) &&
 			!p->signal->rlim[RLIMIT_RTPRIO].rlim_cur)
 			return -EPERM;
 		/* can't increase priority */
-		if (policy != SCHED_NORMAL &&
+		if (rt_policy(policy) &&
 		    param->sched_priority > p->rt_priority &&
 		    param->sched_priority >
 				p->signal->rlim[RLIMIT_RTPRIO].rlim_cur)
@@ -3665,13 +4022,19 @@ recheck:
 		task_rq_unlock(rq, &flags);
 		goto recheck;
 	}
-	array = p->array;
-	if (array)
+	on_rq = p->on_rq;
+	running = rq->curr == p;
+	if (on_rq) {
+		if (running)
+			p->sched_class->put_prev_task(rq, p);
 		deactivate_task(p, rq);
+	}
 	oldprio = p->prio;
 	__setscheduler(p, policy, param->sched_priority);
-	if (array) {
+	if (on_rq) {
 		__activate_task(p, rq);
+		if (running)
+			p->sched_class->set_curr_task(rq, p);
 		/*
 		 * Reschedule if we are currently running on this runqueue and
 		 * our priority decreased, or if we are not currently running on
@@ -3680,7 +4043,7 @@ recheck:
 		if (task_running(rq, p)) {
 			if (p->prio > oldprio)
 				resched_task(rq->curr);
-		} else if (TASK_PREEMPTS_CURR(p, rq))
+		} else if (task_preempts_curr(p, rq))
 			resched_task(rq->curr);
 	}
 	task_rq_unlock(rq, &flags);
@@ -3937,41 +4300,15 @@ asmlinkage long sys_sched_getaffinity(pid_t pid, unsigned int len,
  * sys_sched_yield - yield the current processor to other threads.
  *
  * this function yields the current CPU by moving the calling thread
- * to the expired array. If there are no other threads running on this
- * CPU then this function will return.
+ * to the expired array, or behind all other SCHED_FAIR threads. If there
+ * are no other threads running on this CPU then this function will return.
  */
 asmlinkage long sys_sched_yield(void)
 {
 	runqueue_t *rq = this_rq_lock();
-	prio_array_t *array = current->array;
-	prio_array_t *target = rq->expired;
 
 	schedstat_inc(rq, yld_cnt);
-	/*
-	 * We implement yielding by moving the task into the expired
-	 * queue.
-	 *
-	 * (special rule: RT tasks will just roundrobin in the active
-	 *  array.)
-	 */
-	if (rt_task(current))
-		target = rq->active;
-
-	if (array->nr_active == 1) {
-		schedstat_inc(rq, yld_act_empty);
-		if (!rq->expired->nr_active)
-			schedstat_inc(rq, yld_both_empty);
-	} else if (!rq->expired->nr_active)
-		schedstat_inc(rq, yld_exp_empty);
-
-	if (array != target) {
-		dequeue_task(current, array);
-		enqueue_task(current, target);
-	} else
-		/*
-		 * requeue_task is cheaper so perform that if possible.
-		 */
-		requeue_task(current, array);
+	current->sched_class->yield_task(rq, current);
 
 	/*
 	 * Since we are going to call schedule() anyway, there's
@@ -4119,6 +4456,7 @@ asmlinkage long sys_sched_get_priority_max(int policy)
 		ret = MAX_USER_RT_PRIO-1;
 		break;
 	case SCHED_NORMAL:
+	case SCHED_FAIR:
 		ret = 0;
 		break;
 	}
@@ -4142,6 +4480,7 @@ asmlinkage long sys_sched_get_priority_min(int policy)
 		ret = 1;
 		break;
 	case SCHED_NORMAL:
+	case SCHED_FAIR:
 		ret = 0;
 	}
 	return ret;
@@ -4175,7 +4514,7 @@ long sys_sched_rr_get_interval(pid_t pid, struct timespec __user *interval)
 	if (retval)
 		goto out_unlock;
 
-	jiffies_to_timespec(p->policy & SCHED_FIFO ?
+	jiffies_to_timespec(p->policy == SCHED_FIFO ?
 				0 : task_timeslice(p), &t);
 	read_unlock(&tasklist_lock);
 	retval = copy_to_user(interval, &t, sizeof(t)) ? -EFAULT : 0;
@@ -4299,6 +4638,8 @@ void __devinit init_idle(task_t *idle, int cpu)
 
 	idle->sleep_avg = 0;
 	idle->array = NULL;
+	idle->on_rq = 0;
+	idle->sched_class = &prio_sched_class;
 	idle->prio = MAX_PRIO;
 	idle->state = TASK_RUNNING;
 	idle->cpus_allowed = cpumask_of_cpu(cpu);
@@ -4414,8 +4755,9 @@ static void __migrate_task(struct task_struct *p, int src_cpu, int dest_cpu)
 	if (!cpu_isset(dest_cpu, p->cpus_allowed))
 		goto out;
 
+	p->sched_class->migrate_task(p, rq_src, rq_dest);
 	set_task_cpu(p, dest_cpu);
-	if (p->array) {
+	if (p->on_rq) {
 		/*
 		 * Sync timestamp with rq_dest's before activating.
 		 * The same thing could be achieved by doing this step
@@ -4426,7 +4768,7 @@ static void __migrate_task(struct task_struct *p, int src_cpu, int dest_cpu)
 				+ rq_dest->timestamp_last_tick;
 		deactivate_task(p, rq_src);
 		activate_task(p, rq_dest, 0);
-		if (TASK_PREEMPTS_CURR(p, rq_dest))
+		if (task_preempts_curr(p, rq_dest))
 			resched_task(rq_dest->curr);
 	}
 
@@ -4638,6 +4980,7 @@ static void migrate_dead_tasks(unsigned int dead_cpu)
 {
 	unsigned arr, i;
 	struct runqueue *rq = cpu_rq(dead_cpu);
+	struct rb_node *node;
 
 	for (arr = 0; arr < 2; arr++) {
 		for (i = 0; i < MAX_PRIO; i++) {
@@ -4648,6 +4991,8 @@ static void migrate_dead_tasks(unsigned int dead_cpu)
 							run_list));
 		}
 	}
+	while ((node = rb_first(&rq->fair.tasks_timeline)) != NULL)
+		migrate_dead(dead_cpu, rb_entry(node, task_t, run_node));
 }
 #endif /* CONFIG_HOTPLUG_CPU */
 
@@ -5534,6 +5879,7 @@ void __init sched_init(void)
 			// delimiter for bitsearch
 			__set_bit(MAX_PRIO, array->bitmap);
 		}
+		init_fair_rq(&rq->fair);
 	}
 
 	/*
@@ -5577,9 +5923,9 @@ EXPORT_SYMBOL(__might_sleep);
 void normalize_rt_tasks(void)
 {
 	struct task_struct *p;
-	prio_array_t *array;
 	unsigned long flags;
 	runqueue_t *rq;
+	int on_rq;
 
 	read_lock_irq(&tasklist_lock);
 	for_each_process (p) {
@@ -5588,11 +5934,11 @@ void normalize_rt_tasks(void)
 
 		rq = task_rq_lock(p, &flags);
 
-		array = p->array;
-		if (array)
+		on_rq = p->on_rq;
+		if (on_rq)
 			deactivate_task(p, task_rq(p));
 		__setscheduler(p, SCHED_NORMAL, 0);
-		if (array) {
+		if (on_rq) {
 			__activate_task(p, task_rq(p));
 			resched_task(rq->curr);
 		}
@@ -0,0 +1,378 @@
+/*
+ *  kernel/sched_fair.c
+ *
+ *  SCHED_FAIR scheduling class, included by kernel/sched.c
+ *
+ *  Runnable tasks are kept in a red-black tree ordered by virtual
+ *  runtime: the nanoseconds a task has run, scaled by its nice weight.
+ *  The task with the smallest virtual runtime runs next. There are no
+ *  sleep average or interactivity heuristics: a task that sleeps simply
+ *  falls behind and gets at most half a latency period of credit back
+ *  when it wakes up.
+ *
+ *  Against the priority arrays the whole fair runqueue competes as one
+ *  nice 0 task: see pick_next_task() and fair_epoch().
+ */
+
+/*
+ * Every runnable task gets to run at least once per FAIR_LATENCY_NS,
+ * unless there are more than FAIR_LATENCY_NS/FAIR_MIN_GRANULARITY_NS
+ * of them. A waking task preempts the running one if it is behind by
+ * more than FAIR_WAKEUP_GRANULARITY_NS of virtual runtime.
+ */
+#define FAIR_LATENCY_NS			20000000ULL
+#define FAIR_MIN_GRANULARITY_NS		4000000ULL
+#define FAIR_WAKEUP_GRANULARITY_NS	5000000LL
+
+#define NICE_0_LOAD		1024
+
+/*
+ * Nice levels are multiplicative, with a gentle 10% change for every
+ * nice level changed: a task that is one nice level lower gets ~10%
+ * more CPU than one at the next level up, i.e. weights differ by ~1.25.
+ */
+static const unsigned long prio_to_weight[40] = {
+ /* -20 */	88761,	71755,	56483,	46273,	36291,
+ /* -15 */	29154,	23254,	18705,	14949,	11916,
+ /* -10 */	 9548,	 7620,	 6100,	 4904,	 3906,
+ /*  -5 */	 3121,	 2501,	 1991,	 1586,	 1277,
+ /*   0 */	 1024,	  820,	  655,	  526,	  423,
+ /*   5 */	  335,	  272,	  215,	  172,	  137,
+ /*  10 */	  110,	   87,	   70,	   56,	   45,
+ /*  15 */	   36,	   29,	   23,	   18,	   15,
+};
+
+static void set_load_weight(task_t *p)
+{
+	int prio = p->static_prio;
+
+	/* The idle thread is parked at MAX_PRIO */
+	if (unlikely(prio >= MAX_PRIO))
+		prio = MAX_PRIO - 1;
+	p->load_weight = prio_to_weight[USER_PRIO(prio)];
+}
+
+static void init_fair_rq(struct fair_rq *fr)
+{
+	fr->tasks_timeline = RB_ROOT;
+	fr->rb_leftmost = NULL;
+	fr->curr = NULL;
+	fr->nr_running = 0;
+	fr->load = 0;
+	fr->min_vruntime = 0;
+	fr->epoch_used = 0;
+	fr->expired = 0;
+}
+
+/*
+ * sched_clock() of rq's CPU, compensated for drift like activate_task()
+ * does when called from another CPU.
+ */
+static inline unsigned long long fair_clock(runqueue_t *rq)
+{
+	unsigned long long now = sched_clock();
+#ifdef CONFIG_SMP
+	runqueue_t *this_rq = this_rq();
+
+	if (rq != this_rq)
+		now = (now - this_rq->timestamp_last_tick)
+			+ rq->timestamp_last_tick;
+#endif
+	return now;
+}
+
+/*
+ * delta * NICE_0_LOAD / p->load_weight: nanoseconds to virtual runtime.
+ */
+static inline unsigned long long
+calc_delta_fair(unsigned long long delta, task_t *p)
+{
+	if (likely(p->load_weight == NICE_0_LOAD))
+		return delta;
+	delta *= NICE_0_LOAD;
+	do_div(delta, p->load_weight);
+	return delta;
+}
+
+/*
+ * The CPU time p should get in one latency period, in nanoseconds.
+ */
+static unsigned long long fair_slice(struct fair_rq *fr, task_t *p)
+{
+	unsigned long long slice = FAIR_LATENCY_NS;
+
+	if (fr->nr_running > FAIR_LATENCY_NS / FAIR_MIN_GRANULARITY_NS)
+		slice = fr->nr_running * FAIR_MIN_GRANULARITY_NS;
+	if (fr->load) {
+		slice *= p->load_weight;
+		do_div(slice, fr->load);
+	}
+	return slice;
+}
+
+/*
+ * How long the fair runqueue may run between two array switches while
+ * tasks in the priority arrays wait: one nice 0 timeslice per
+ * NICE_0_LOAD of queued weight.
+ */
+static inline unsigned long long fair_epoch(struct fair_rq *fr)
+{
+	return (unsigned long long)(JIFFIES_TO_NS(DEF_TIMESLICE) /
+					NICE_0_LOAD) * fr->load;
+}
+
+/* Called at every array switch. */
+static inline void fair_new_epoch(runqueue_t *rq)
+{
+	rq->fair.epoch_used = 0;
+	rq->fair.expired = 0;
+}
+
+/*
+ * Virtual runtimes are compared relative to min_vruntime, so that the
+ * ordering survives the unsigned counters wrapping.
+ */
+static inline long long fair_key(struct fair_rq *fr, task_t *p)
+{
+	return (long long)(p->vruntime - fr->min_vruntime);
+}
+
+static void __enqueue_fair(struct fair_rq *fr, task_t *p)
+{
+	struct rb_node **link = &fr->tasks_timeline.rb_node;
+	struct rb_node *parent = NULL;
+	long long key = fair_key(fr, p);
+	int leftmost = 1;
+	task_t *entry;
+
+	while (*link) {
+		parent = *link;
+		entry = rb_entry(parent, task_t, run_node);
+		/* Equal keys go to the right, behind the queued ones. */
+		if (key < fair_key(fr, entry))
+			link = &parent->rb_left;
+		else {
+			link = &parent->rb_right;
+			leftmost = 0;
+		}
+	}
+	if (leftmost)
+		fr->rb_leftmost = &p->run_node;
+
+	rb_link_node(&p->run_node, parent, link);
+	rb_insert_color(&p->run_node, &fr->tasks_timeline);
+}
+
+static void __dequeue_fair(struct fair_rq *fr, task_t *p)
+{
+	if (fr->rb_leftmost == &p->run_node)
+		fr->rb_leftmost = rb_next(&p->run_node);
+	rb_erase(&p->run_node, &fr->tasks_timeline);
+}
+
+/*
+ * min_vruntime follows the smallest virtual runtime on the runqueue,
+ * running task included, and never goes backwards.
+ */
+static void update_min_vruntime(struct fair_rq *fr)
+{
+	unsigned long long vruntime = fr->min_vruntime;
+	task_t *first;
+
+	if (fr->curr)
+		vruntime = fr->curr->vruntime;
+	if (fr->rb_leftmost) {
+		first = rb_entry(fr->rb_leftmost, task_t, run_node);
+		if (!fr->curr || (long long)(first->vruntime - vruntime) < 0)
+			vruntime = first->vruntime;
+	}
+	if ((long long)(vruntime - fr->min_vruntime) > 0)
+		fr->min_vruntime = vruntime;
+}
+
+/*
+ * Charge the running task for the time since it was last updated.
+ */
+static void update_curr_fair(runqueue_t *rq)
+{
+	struct fair_rq *fr = &rq->fair;
+	task_t *curr = fr->curr;
+	unsigned long long now, delta_exec;
+
+	if (unlikely(!curr))
+		return;
+
+	now = fair_clock(rq);
+	delta_exec = now - curr->exec_start;
+	if ((long long)delta_exec <= 0)
+		return;
+
+	curr->exec_start = now;
+	curr->sum_exec_runtime += delta_exec;
+	curr->vruntime += calc_delta_fair(delta_exec, curr);
+	fr->epoch_used += delta_exec;
+	update_min_vruntime(fr);
+}
+
+static void set_next_fair(runqueue_t *rq, task_t *p)
+{
+	rq->fair.curr = p;
+	p->exec_start = fair_clock(rq);
+	p->prev_sum_exec_runtime = p->sum_exec_runtime;
+}
+
+static void enqueue_task_fair(runqueue_t *rq, task_t *p)
+{
+	struct fair_rq *fr = &rq->fair;
+	unsigned long long min_vruntime;
+
+	update_curr_fair(rq);
+	/*
+	 * However long it slept, a task comes back with at most half a
+	 * latency period of credit:
+	 */
+	min_vruntime = fr->min_vruntime - FAIR_LATENCY_NS / 2;
+	if ((long long)(p->vruntime - min_vruntime) < 0)
+		p->vruntime = min_vruntime;
+
+	if (p != fr->curr)
+		__enqueue_fair(fr, p);
+	fr->nr_running++;
+	fr->load += p->load_weight;
+}
+
+static void dequeue_task_fair(runqueue_t *rq, task_t *p)
+{
+	struct fair_rq *fr = &rq->fair;
+
+	update_curr_fair(rq);
+	if (p != fr->curr)
+		__dequeue_fair(fr, p);
+	fr->nr_running--;
+	fr->load -= p->load_weight;
+}
+
+/*
+ * Move the yielding task behind every other queued task.
+ */
+static void yield_task_fair(runqueue_t *rq, task_t *p)
+{
+	struct fair_rq *fr = &rq->fair;
+	struct rb_node *last = rb_last(&fr->tasks_timeline);
+	task_t *rightmost;
+
+	if (p != fr->curr || !last)
+		return;
+
+	update_curr_fair(rq);
+	rightmost = rb_entry(last, task_t, run_node);
+	if ((long long)(rightmost->vruntime - p->vruntime) >= 0)
+		p->vruntime = rightmost->vruntime + 1;
+}
+
+static task_t *pick_next_task_fair(runqueue_t *rq)
+{
+	struct fair_rq *fr = &rq->fair;
+	task_t *p = rb_entry(fr->rb_leftmost, task_t, run_node);
+
+	__dequeue_fair(fr, p);
+	set_next_fair(rq, p);
+	return p;
+}
+
+static void put_prev_task_fair(runqueue_t *rq, task_t *p)
+{
+	struct fair_rq *fr = &rq->fair;
+
+	if (fr->curr != p)
+		return;
+	update_curr_fair(rq);
+	if (p->on_rq)
+		__enqueue_fair(fr, p);
+	fr->curr = NULL;
+}
+
+static void set_curr_task_fair(runqueue_t *rq, task_t *p)
+{
+	struct fair_rq *fr = &rq->fair;
+
+	if (fr->curr == p)
+		return;
+	if (fr->curr)
+		put_prev_task_fair(rq, fr->curr);
+	__dequeue_fair(fr, p);
+	set_next_fair(rq, p);
+}
+
+static void task_tick_fair(runqueue_t *rq, task_t *p)
+{
+	struct fair_rq *fr = &rq->fair;
+	unsigned long long ran;
+
+	if (p != fr->curr)
+		return;
+	update_curr_fair(rq);
+
+	/*
+	 * Give the priority arrays their turn once the fair runqueue
+	 * has used up its epoch:
+	 */
+	if (!rq->active->nr_active && !rq->expired->nr_active)
+		fr->epoch_used = 0;
+	else if (fr->epoch_used >= fair_epoch(fr)) {
+		fr->expired = 1;
+		set_tsk_need_resched(p);
+		return;
+	}
+
+	if (!fr->rb_leftmost)
+		return;
+	ran = p->sum_exec_runtime - p->prev_sum_exec_runtime;
+	if (ran > fair_slice(fr, p))
+		set_tsk_need_resched(p);
+}
+
+static int check_preempt_curr_fair(runqueue_t *rq, task_t *p)
+{
+	task_t *curr = rq->curr;
+
+	if (curr != rq->fair.curr)
+		return 0;
+	update_curr_fair(rq);
+	return (long long)(curr->vruntime - p->vruntime) >
+					FAIR_WAKEUP_GRANULARITY_NS;
+}
+
+/*
+ * Virtual runtimes only mean something relative to their runqueue's
+ * min_vruntime:
+ */
+static void migrate_task_fair(task_t *p, runqueue_t *src, runqueue_t *dst)
+{
+	p->vruntime = p->vruntime - src->fair.min_vruntime +
+			dst->fair.min_vruntime;
+}
+
+/*
+ * A new task starts one minimum granularity behind the queued tasks,
+ * so that forking does not buy CPU time.
+ */
+static void task_new_fair(runqueue_t *rq, task_t *p)
+{
+	update_curr_fair(rq);
+	p->vruntime = rq->fair.min_vruntime +
+			calc_delta_fair(FAIR_MIN_GRANULARITY_NS, p);
+	enqueue_task_fair(rq, p);
+}
+
+static const struct sched_class fair_sched_class = {
+	.enqueue_task		= enqueue_task_fair,
+	.dequeue_task		= dequeue_task_fair,
+	.yield_task		= yield_task_fair,
+	.put_prev_task		= put_prev_task_fair,
+	.set_curr_task		= set_curr_task_fair,
+	.task_tick		= task_tick_fair,
+	.check_preempt_curr	= check_preempt_curr_fair,
+	.migrate_task		= migrate_task_fair,
+	.task_new		= task_new_fair,
+};
@@ -30,6 +30,7 @@
 #include <linux/thread_info.h>
 #include <linux/time.h>
 #include <linux/jiffies.h>
+#include <linux/hrtimer.h>
 #include <linux/posix-timers.h>
 #include <linux/cpu.h>
 #include <linux/syscalls.h>
@@ -510,8 +511,9 @@ static inline void __run_timers(tvec_base_t *base)
 #ifdef CONFIG_NO_IDLE_HZ
 /*
  * Find out when the next timer event is due to happen. This
- * is used on S/390 to stop all activity when a cpus is idle.
- * This functions needs to be called disabled.
+ * is used on S/390 to stop all activity when a cpus is idle,
+ * and by hrtimer_stop_sched_tick() to stop the tick of an idle
+ * cpu. This functions needs to be called disabled.
  */
 unsigned long next_timer_interrupt(void)
 {
@@ -912,6 +914,7 @@ static void run_timer_softirq(struct softirq_action *h)
 {
 	tvec_base_t *base = &__get_cpu_var(tvec_bases);
 
+	hrtimer_run_queues();
 	if (time_after_eq(jiffies, base->timer_jiffies))
 		__run_timers(base);
 }
@@ -1179,33 +1182,22 @@ asmlinkage long sys_gettid(void)
 
 static long __sched nanosleep_restart(struct restart_block *restart)
 {
-	unsigned long expire = restart->arg0, now = jiffies;
 	struct timespec __user *rmtp = (struct timespec __user *) restart->arg1;
+	struct timespec t;
 	long ret;
 
-	/* Did it expire while we handled signals? */
-	if (!time_after(expire, now))
-		return 0;
-
-	expire = schedule_timeout_interruptible(expire - now);
-
-	ret = 0;
-	if (expire) {
-		struct timespec t;
-		jiffies_to_timespec(expire, &t);
-
-		ret = -ERESTART_RESTARTBLOCK;
+	ret = hrtimer_nanosleep_restart(restart, rmtp ? &t : NULL);
+	if (ret == -ERESTART_RESTARTBLOCK) {
 		if (rmtp && copy_to_user(rmtp, &t, sizeof(t)))
-			ret = -EFAULT;
-		/* The 'restart' block is already filled in */
+			return -EFAULT;
+		restart->fn = nanosleep_restart;
 	}
 	return ret;
 }
 
 asmlinkage long sys_nanosleep(struct timespec __user *rqtp, struct timespec __user *rmtp)
 {
-	struct timespec t;
-	unsigned long expire;
+	struct timespec t, rem;
 	long ret;
 
 	if (copy_from_user(&t, rqtp, sizeof(t)))
@@ -1214,21 +1206,17 @@ asmlinkage long sys_nanosleep(struct timespec __user *rqtp, struct timespec __us
 	if ((t.tv_nsec >= 1000000000L) || (t.tv_nsec < 0) || (t.tv_sec < 0))
 		return -EINVAL;
 
-	expire = timespec_to_jiffies(&t) + (t.tv_sec || t.tv_nsec);
-	expire = schedule_timeout_interruptible(expire);
-
-	ret = 0;
-	if (expire) {
+	ret = hrtimer_nanosleep(&t, rmtp ? &rem : NULL, HRTIMER_REL,
+				CLOCK_MONOTONIC);
+	if (ret == -ERESTART_RESTARTBLOCK) {
 		struct restart_block *restart;
-		jiffies_to_timespec(expire, &t);
-		if (rmtp && copy_to_user(rmtp, &t, sizeof(t)))
+
+		if (rmtp && copy_to_user(rmtp, &rem, sizeof(rem)))
 			return -EFAULT;
 
 		restart = &current_thread_info()->restart_block;
 		restart->fn = nanosleep_restart;
-		restart->arg0 = jiffies + expire;
 		restart->arg1 = (unsigned long) rmtp;
-		ret = -ERESTART_RESTARTBLOCK;
 	}
 	return ret;
 }
@@ -0,0 +1,151 @@
+/*
+ * lib/bench.c
+ *
+ * Scaffolding for the benchmark modules: run an operation in a loop on
+ * a number of cpus at once and count how often it got done.
+ */
+
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/sched.h>
+#include <linux/kthread.h>
+#include <linux/slab.h>
+#include <linux/err.h>
+#include <linux/cpumask.h>
+#include <linux/jiffies.h>
+#include "bench.h"
+
+static int bench_thread(void *data)
+{
+	struct bench_thread *t = data;
+	struct bench *b = t->bench;
+
+	if (b->setup)
+		t->err = b->setup(t);
+	if (atomic_dec_and_test(&b->ready))
+		complete(&b->started);
+
+	wait_event(b->wait, b->go);
+	if (!t->err) {
+		while (time_before(jiffies, b->end)) {
+			t->err = b->op(t);
+			if (t->err)
+				break;
+			t->ops++;
+			cond_resched();
+		}
+		if (b->teardown)
+			b->teardown(t);
+	}
+	if (atomic_dec_and_test(&b->running))
+		complete(&b->done);
+
+	/* kthread_stop() needs us around until it is called */
+	set_current_state(TASK_INTERRUPTIBLE);
+	while (!kthread_should_stop()) {
+		schedule();
+		set_current_state(TASK_INTERRUPTIBLE);
+	}
+	__set_current_state(TASK_RUNNING);
+	return 0;
+}
+
+/**
+ * bench_run - run a benchmark on several cpus at once
+ * @b: the benchmark
+ * @nr_cpus: how many of the online cpus to use, one thread bound to each
+ * @sec: how long to keep calling ->op()
+ * @ops: returns the number of ->op() calls completed by all threads
+ *
+ * Returns 0, or the first error met by a thread.
+ */
+int bench_run(struct bench *b, int nr_cpus, unsigned int sec,
+	      unsigned long *ops)
+{
+	struct bench_thread *threads;
+	int cpu, i, err = 0;
+
+	threads = kmalloc(nr_cpus * sizeof(*threads), GFP_KERNEL);
+	if (!threads)
+		return -ENOMEM;
+	memset(threads, 0, nr_cpus * sizeof(*threads));
+
+	b->go = 0;
+	init_waitqueue_head(&b->wait);
+	atomic_set(&b->ready, nr_cpus);
+	atomic_set(&b->running, nr_cpus);
+	init_completion(&b->started);
+	init_completion(&b->done);
+
+	cpu = first_cpu(cpu_online_map);
+	for (i = 0; i < nr_cpus; i++) {
+		struct bench_thread *t = &threads[i];
+
+		t->bench = b;
+		t->cpu = cpu;
+		t->task = kthread_create(bench_thread, t, "%s/%d", b->name, cpu);
+		if (IS_ERR(t->task)) {
+			err = PTR_ERR(t->task);
+			goto stop;
+		}
+		kthread_bind(t->task, cpu);
+		cpu = next_cpu(cpu, cpu_online_map);
+	}
+
+	for (i = 0; i < nr_cpus; i++)
+		wake_up_process(threads[i].task);
+	wait_for_completion(&b->started);
+
+	b->end = jiffies + sec * HZ;
+	smp_wmb();
+	b->go = 1;
+	wake_up(&b->wait);
+	wait_for_completion(&b->done);
+
+	*ops = 0;
+	for (i = 0; i < nr_cpus; i++) {
+		*ops += threads[i].ops;
+		if (threads[i].err && !err)
+			err = threads[i].err;
+	}
+	i = nr_cpus;
+stop:
+	while (i--)
+		kthread_stop(threads[i].task);
+	kfree(threads);
+	return err;
+}
+EXPORT_SYMBOL_GPL(bench_run);
+
+/**
+ * bench_run_all - run a benchmark on 1, 2, 4, ... and all online cpus
+ * @b: the benchmark
+ * @sec: how long each run lasts
+ *
+ * Prints the total and per-cpu rate of every run.
+ */
+int bench_run_all(struct bench *b, unsigned int sec)
+{
+	int max = num_online_cpus();
+	unsigned long ops;
+	int nr, err;
+
+	if (!sec)
+		sec = 1;
+	for (nr = 1; ; nr = min(2 * nr, max)) {
+		err = bench_run(b, nr, sec, &ops);
+		if (err) {
+			printk(KERN_ERR "%s: %d cpus: failed with %d\n",
+			       b->name, nr, err);
+			return err;
+		}
+		printk(KERN_INFO "%s: %d cpus: %lu %s/sec, %lu per cpu\n",
+		       b->name, nr, ops / sec, b->unit, ops / sec / nr);
+		if (nr == max)
+			break;
+	}
+	return 0;
+}
+EXPORT_SYMBOL_GPL(bench_run_all);
+
+MODULE_LICENSE("GPL");
@@ -0,0 +1,52 @@
+/*
+ * Helpers shared by the lib/bench_*.c benchmark modules.
+ */
+#ifndef _LIB_BENCH_H
+#define _LIB_BENCH_H
+
+#include <linux/wait.h>
+#include <linux/completion.h>
+#include <asm/atomic.h>
+
+struct task_struct;
+struct bench;
+
+struct bench_thread {
+	struct bench *bench;
+	struct task_struct *task;
+	int cpu;
+	unsigned long ops;	/* ->op() calls completed */
+	int err;
+	void *priv;		/* for the benchmark's own use */
+};
+
+struct bench {
+	const char *name;
+	const char *unit;	/* what one ->op() call counts as */
+
+	/*
+	 * ->setup() and ->teardown() are optional and run on the thread's
+	 * own cpu, outside the timed loop.  ->op() does one unit of work.
+	 * A non-zero return from ->setup() or ->op() ends that thread's run
+	 * and is passed back by bench_run().  ->teardown() is called only
+	 * if ->setup() succeeded.
+	 */
+	int (*setup)(struct bench_thread *);
+	void (*teardown)(struct bench_thread *);
+	int (*op)(struct bench_thread *);
+
+	/* private to bench_run() */
+	unsigned long end;
+	int go;
+	wait_queue_head_t wait;
+	atomic_t ready;
+	atomic_t running;
+	struct completion started;
+	struct completion done;
+};
+
+extern int bench_run(struct bench *b, int nr_cpus, unsigned int sec,
+		     unsigned long *ops);
+extern int bench_run_all(struct bench *b, unsigned int sec);
+
+#endif /* _LIB_BENCH_H */
@@ -0,0 +1,159 @@
+/*
+ * Compaction stress test.
+ *
+ * Fills a scratch file with clean page cache and then drops every other
+ * page of it, which leaves free memory scattered in single pages between
+ * movable ones.  It then counts how many of a number of higher order
+ * allocations succeed, once before fragmenting memory and once after.
+ * The allocator has to compact the fragmented zones for the second pass.
+ * The page cache of the file that is still there afterwards tells how
+ * much of the result came from reclaim instead.  /proc/vmstat has the
+ * compact_* and pgmigrate_* counters for the run.
+ *
+ * The scratch file must be on a disk based filesystem, since its pages
+ * are written back so that they can be dropped.  It is left behind.
+ *
+ *	modprobe bench_compaction file=/var/tmp/compact mb=512 order=3
+ */
+
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/mm.h>
+#include <linux/swap.h>
+#include <linux/fs.h>
+#include <linux/file.h>
+#include <linux/pagemap.h>
+#include <linux/vmalloc.h>
+#include <linux/err.h>
+#include <asm/uaccess.h>
+
+static char *file = "/var/tmp/bench_compaction";
+static unsigned int mb;
+static unsigned int order = 3;
+static unsigned int count = 256;
+
+static int fill_file(struct file *filp, unsigned long nr_pages)
+{
+	mm_segment_t old_fs;
+	loff_t pos = 0;
+	unsigned long i;
+	ssize_t ret = PAGE_SIZE;
+	char *buf;
+
+	buf = (char *)__get_free_page(GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
+	memset(buf, 0x5a, PAGE_SIZE);
+
+	old_fs = get_fs();
+	set_fs(KERNEL_DS);
+	for (i = 0; i < nr_pages; i++) {
+		ret = vfs_write(filp, buf, PAGE_SIZE, &pos);
+		if (ret != PAGE_SIZE)
+			break;
+		cond_resched();
+	}
+	set_fs(old_fs);
+	free_page((unsigned long)buf);
+
+	if (ret < 0)
+		return ret;
+	if (ret != PAGE_SIZE)
+		return -ENOSPC;
+	ret = filemap_fdatawrite(filp->f_mapping);
+	if (!ret)
+		ret = filemap_fdatawait(filp->f_mapping);
+	return ret;
+}
+
+/* Drop the odd pages of the file, keep the even ones */
+static void punch_file(struct file *filp, unsigned long nr_pages)
+{
+	unsigned long i;
+
+	for (i = 1; i < nr_pages; i += 2) {
+		invalidate_inode_pages2_range(filp->f_mapping, i, i);
+		cond_resched();
+	}
+}
+
+static int try_allocations(const char *when)
+{
+	unsigned long start = jiffies;
+	unsigned int i, nr = 0;
+	struct page **pages;
+
+	pages = vmalloc(count * sizeof(*pages));
+	if (!pages)
+		return -ENOMEM;
+	for (i = 0; i < count; i++) {
+		pages[nr] = alloc_pages(GFP_KERNEL | __GFP_NORETRY |
+					__GFP_NOWARN, order);
+		if (pages[nr])
+			nr++;
+	}
+	printk(KERN_INFO "compaction: %s: %u of %u order-%u allocations "
+	       "succeeded (%u%%) in %u ms\n", when, nr, count, order,
+	       nr * 100 / count, jiffies_to_msecs(jiffies - start));
+	while (nr--)
+		__free_pages(pages[nr], order);
+	vfree(pages);
+	return 0;
+}
+
+static int __init compaction_bench_init(void)
+{
+	unsigned long nr_pages, cached;
+	struct file *filp;
+	int err;
+
+	if (!count || order >= MAX_ORDER)
+		return -EINVAL;
+	if (mb)
+		nr_pages = (unsigned long)mb << (20 - PAGE_SHIFT);
+	else
+		nr_pages = nr_free_pages() / 2;
+
+	err = try_allocations("unfragmented");
+	if (err)
+		return err;
+
+	filp = filp_open(file, O_RDWR | O_CREAT | O_TRUNC | O_LARGEFILE, 0600);
+	if (IS_ERR(filp))
+		return PTR_ERR(filp);
+
+	err = fill_file(filp, nr_pages);
+	if (err)
+		goto out;
+	punch_file(filp, nr_pages);
+	cached = filp->f_mapping->nrpages;
+
+	err = try_allocations("fragmented");
+	printk(KERN_INFO "compaction: %lu of %lu cached pages of %s "
+	       "were not reclaimed\n", filp->f_mapping->nrpages, cached,
+	       file);
+out:
+	invalidate_inode_pages2(filp->f_mapping);
+	filp_close(filp, NULL);
+	return err;
+}
+
+static void __exit compaction_bench_exit(void) { }
+
+module_init(compaction_bench_init);
+module_exit(compaction_bench_exit);
+
+module_param(file, charp, 0);
+MODULE_PARM_DESC(file, "Scratch file (default /var/tmp/bench_compaction)");
+module_param(mb, uint, 0);
+MODULE_PARM_DESC(mb, "Megabytes of page cache to fragment memory with "
+		 "(default half of free memory)");
+module_param(order, uint, 0);
+MODULE_PARM_DESC(order, "Order of the allocations (default 3)");
+module_param(count, uint, 0);
+MODULE_PARM_DESC(count, "Allocations per pass (default 256)");
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("Compaction stress test");
@@ -0,0 +1,102 @@
+/*
+ * kmalloc/kfree benchmark.
+ *
+ * Each thread allocates a batch of objects with kmalloc() and frees them
+ * again, in a loop, on 1, 2, 4, ... cpus at a time.  Build the kernel
+ * once with CONFIG_SLAB and once with CONFIG_SLUB to compare the two
+ * allocators.  Without a size all of 32, 256 and 2048 bytes are run.
+ *
+ *	modprobe bench_kmalloc size=128 batch=64 sec=5
+ */
+
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/slab.h>
+#include "bench.h"
+
+static unsigned int size;
+static unsigned int batch = 16;
+static unsigned int sec = 5;
+
+static unsigned int sizes[] = { 32, 256, 2048 };
+
+static int kmalloc_setup(struct bench_thread *t)
+{
+	t->priv = kmalloc(batch * sizeof(void *), GFP_KERNEL);
+	return t->priv ? 0 : -ENOMEM;
+}
+
+static void kmalloc_teardown(struct bench_thread *t)
+{
+	kfree(t->priv);
+}
+
+static int kmalloc_op(struct bench_thread *t)
+{
+	void **objs = t->priv;
+	unsigned int i;
+	int err = 0;
+
+	for (i = 0; i < batch; i++) {
+		objs[i] = kmalloc(size, GFP_KERNEL);
+		if (!objs[i]) {
+			err = -ENOMEM;
+			break;
+		}
+	}
+	while (i--)
+		kfree(objs[i]);
+	return err;
+}
+
+static char kmalloc_name[16];
+
+static struct bench kmalloc_bench = {
+	.name		= kmalloc_name,
+	.unit		= "batches",
+	.setup		= kmalloc_setup,
+	.teardown	= kmalloc_teardown,
+	.op		= kmalloc_op,
+};
+
+static int __init kmalloc_bench_init(void)
+{
+	int i, err;
+
+	if (!batch)
+		batch = 1;
+#ifdef CONFIG_SLUB
+	printk(KERN_INFO "kmalloc: SLUB, %u objects per batch\n", batch);
+#else
+	printk(KERN_INFO "kmalloc: SLAB, %u objects per batch\n", batch);
+#endif
+	if (size) {
+		sprintf(kmalloc_name, "kmalloc-%u", size);
+		return bench_run_all(&kmalloc_bench, sec);
+	}
+	for (i = 0; i < ARRAY_SIZE(sizes); i++) {
+		size = sizes[i];
+		sprintf(kmalloc_name, "kmalloc-%u", size);
+		err = bench_run_all(&kmalloc_bench, sec);
+		if (err)
+			return err;
+	}
+	return 0;
+}
+
+static void __exit kmalloc_bench_exit(void) { }
+
+module_init(kmalloc_bench_init);
+module_exit(kmalloc_bench_exit);
+
+module_param(size, uint, 0);
+MODULE_PARM_DESC(size, "Object size in bytes (default 32, 256 and 2048)");
+module_param(batch, uint, 0);
+MODULE_PARM_DESC(batch, "Objects allocated before they are freed (default 16)");
+module_param(sec, uint, 0);
+MODULE_PARM_DESC(sec, "Seconds per cpu count (default 5)");
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("kmalloc/kfree benchmark");
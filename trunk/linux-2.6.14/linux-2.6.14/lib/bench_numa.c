@@ -0,0 +1,193 @@
+/*
+ * NUMA balancing memory walk benchmark.
+ *
+ * Starts one walker for each node with cpus.  A walker faults in its
+ * own anonymous buffer while bound to its node, then moves to the next
+ * node and keeps reading the buffer for a number of seconds.  With
+ * automatic NUMA balancing the buffer should follow it there: the read
+ * rate of the last second should beat that of the first, and the pages
+ * migrated should approach the size of the buffer.
+ *
+ * The walkers are kernel threads sharing the mm of the process loading
+ * the module, so that knumad scans their buffers like any other process
+ * memory and they take NUMA hinting faults on them.
+ *
+ *	modprobe bench_numa mb=256 sec=20
+ */
+
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/sched.h>
+#include <linux/mm.h>
+#include <linux/mman.h>
+#include <linux/slab.h>
+#include <linux/nodemask.h>
+#include <linux/topology.h>
+#include <linux/completion.h>
+#include <linux/jiffies.h>
+#include <linux/err.h>
+#include <asm/uaccess.h>
+
+static unsigned int mb = 256;
+static unsigned int sec = 20;
+
+struct numa_walker {
+	int from_nid, to_nid;
+	unsigned long addr;		/* of the buffer in the shared mm */
+	unsigned long len;
+	unsigned long first_rate;	/* MB/s in the first second */
+	unsigned long last_rate;	/* MB/s in the last second */
+	unsigned long faults_local, faults_remote, migrated;
+	int err;
+	struct completion done;
+};
+
+static int numa_walker(void *data)
+{
+	struct numa_walker *w = data;
+	unsigned long end, window, bytes = 0;
+	unsigned long addr;
+	char *buf;
+
+	buf = kmalloc(PAGE_SIZE, GFP_KERNEL);
+	if (!buf) {
+		w->err = -ENOMEM;
+		goto out;
+	}
+
+	set_cpus_allowed(current, node_to_cpumask(w->from_nid));
+	if (clear_user((void __user *)w->addr, w->len)) {
+		w->err = -EFAULT;
+		goto out_free;
+	}
+	set_cpus_allowed(current, node_to_cpumask(w->to_nid));
+
+	end = jiffies + sec * HZ;
+	window = jiffies;
+	addr = w->addr;
+	while (time_before(jiffies, end)) {
+		if (copy_from_user(buf, (void __user *)addr, PAGE_SIZE)) {
+			w->err = -EFAULT;
+			break;
+		}
+		bytes += PAGE_SIZE;
+		addr += PAGE_SIZE;
+		if (addr == w->addr + w->len) {
+			addr = w->addr;
+			cond_resched();
+		}
+		if (time_after_eq(jiffies, window + HZ)) {
+			w->last_rate = (bytes >> 20) * HZ / (jiffies - window);
+			if (!w->first_rate)
+				w->first_rate = w->last_rate;
+			window = jiffies;
+			bytes = 0;
+		}
+	}
+	w->faults_local = current->numa_faults_local;
+	w->faults_remote = current->numa_faults_remote;
+	w->migrated = current->numa_pages_migrated;
+out_free:
+	kfree(buf);
+out:
+	complete_and_exit(&w->done, 0);
+}
+
+/* The next node after @nid which has cpus, wrapping around */
+static int next_cpu_node(int nid)
+{
+	do {
+		nid = next_node(nid, node_online_map);
+		if (nid == MAX_NUMNODES)
+			nid = first_node(node_online_map);
+	} while (cpus_empty(node_to_cpumask(nid)));
+	return nid;
+}
+
+static int __init numa_bench_init(void)
+{
+	struct mm_struct *mm = current->mm;
+	struct numa_walker *walkers;
+	unsigned long len = (unsigned long)mb << 20;
+	unsigned long addr;
+	int nr = 0, started = 0, nid, i, err = 0;
+
+	if (!mm || !mb)
+		return -EINVAL;
+	for_each_online_node(nid)
+		if (!cpus_empty(node_to_cpumask(nid)))
+			nr++;
+	if (nr < 2) {
+		printk(KERN_ERR "numa: needs at least two nodes with cpus\n");
+		return -ENODEV;
+	}
+
+	walkers = kmalloc(nr * sizeof(*walkers), GFP_KERNEL);
+	if (!walkers)
+		return -ENOMEM;
+	memset(walkers, 0, nr * sizeof(*walkers));
+
+	down_write(&mm->mmap_sem);
+	addr = do_mmap(NULL, 0, nr * len, PROT_READ | PROT_WRITE,
+		       MAP_PRIVATE | MAP_ANONYMOUS, 0);
+	up_write(&mm->mmap_sem);
+	if (IS_ERR_VALUE(addr)) {
+		kfree(walkers);
+		return (int)addr;
+	}
+
+	nid = next_cpu_node(MAX_NUMNODES - 1);
+	for (i = 0; i < nr; i++) {
+		struct numa_walker *w = &walkers[i];
+
+		w->from_nid = nid;
+		w->to_nid = nid = next_cpu_node(nid);
+		w->addr = addr + i * len;
+		w->len = len;
+		init_completion(&w->done);
+		err = kernel_thread(numa_walker, w,
+				    CLONE_FS | CLONE_FILES | SIGCHLD);
+		if (err < 0)
+			break;
+		started++;
+		err = 0;
+	}
+
+	for (i = 0; i < started; i++) {
+		struct numa_walker *w = &walkers[i];
+
+		wait_for_completion(&w->done);
+		if (w->err) {
+			if (!err)
+				err = w->err;
+			continue;
+		}
+		printk(KERN_INFO "numa: node %d -> %d: %lu MB/s first second, "
+		       "%lu MB/s last second, %lu local and %lu remote hinting "
+		       "faults, %lu of %lu pages migrated\n",
+		       w->from_nid, w->to_nid, w->first_rate, w->last_rate,
+		       w->faults_local, w->faults_remote, w->migrated,
+		       len >> PAGE_SHIFT);
+	}
+
+	down_write(&mm->mmap_sem);
+	do_munmap(mm, addr, nr * len);
+	up_write(&mm->mmap_sem);
+	kfree(walkers);
+	return err;
+}
+
+static void __exit numa_bench_exit(void) { }
+
+module_init(numa_bench_init);
+module_exit(numa_bench_exit);
+
+module_param(mb, uint, 0);
+MODULE_PARM_DESC(mb, "Megabytes each walker reads (default 256)");
+module_param(sec, uint, 0);
+MODULE_PARM_DESC(sec, "Seconds each walker reads for (default 20)");
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("NUMA balancing memory walk benchmark");
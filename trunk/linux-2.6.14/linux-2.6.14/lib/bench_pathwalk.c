@@ -0,0 +1,56 @@
+/*
+ * Path walk benchmark.
+ *
+ * Resolves one path with path_lookup() over and over on 1, 2, 4, ... cpus
+ * at a time and prints the lookups per second for each cpu count.  A path
+ * of plain directories measures the RCU walk; symlinks, ".." or
+ * mountpoints on the way send each lookup down the locked walk instead.
+ *
+ *	modprobe bench_pathwalk path=/usr/share/doc sec=5
+ */
+
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/init.h>
+#include <linux/fs.h>
+#include <linux/namei.h>
+#include "bench.h"
+
+static char *path = "/usr/lib";
+static unsigned int sec = 5;
+
+static int pathwalk_op(struct bench_thread *t)
+{
+	struct nameidata nd;
+	int err;
+
+	err = path_lookup(path, LOOKUP_FOLLOW, &nd);
+	if (err)
+		return err;
+	path_release(&nd);
+	return 0;
+}
+
+static struct bench pathwalk_bench = {
+	.name	= "pathwalk",
+	.unit	= "lookups",
+	.op	= pathwalk_op,
+};
+
+static int __init pathwalk_bench_init(void)
+{
+	return bench_run_all(&pathwalk_bench, sec);
+}
+
+static void __exit pathwalk_bench_exit(void) { }
+
+module_init(pathwalk_bench_init);
+module_exit(pathwalk_bench_exit);
+
+module_param(path, charp, 0);
+MODULE_PARM_DESC(path, "Path to look up (default /usr/lib)");
+module_param(sec, uint, 0);
+MODULE_PARM_DESC(sec, "Seconds per cpu count (default 5)");
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("Path walk benchmark");
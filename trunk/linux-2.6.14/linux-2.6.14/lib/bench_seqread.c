@@ -0,0 +1,109 @@
+/*
+ * Sequential read benchmark.
+ *
+ * Drops the page cache of a file and reads it from start to end, a
+ * number of times, and prints the throughput and the system time the
+ * reads cost per GB read.  Every page comes in through readahead, so
+ * the CPU cost is mostly that of setting up the page cache and the I/O.
+ * System time is sampled by the timer tick: use files of some hundreds
+ * of MB at least.
+ *
+ *	modprobe bench_seqread file=/data/big bufsize=1048576 loops=3
+ */
+
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/sched.h>
+#include <linux/fs.h>
+#include <linux/file.h>
+#include <linux/pagemap.h>
+#include <linux/vmalloc.h>
+#include <linux/jiffies.h>
+#include <linux/err.h>
+#include <asm/uaccess.h>
+
+static char *file;
+static unsigned int bufsize = 128 << 10;
+static unsigned int loops = 3;
+
+static int seqread_once(struct file *filp, char *buf)
+{
+	unsigned long start = jiffies;
+	cputime_t stime = current->stime;
+	unsigned long long bytes = 0;
+	unsigned long ms, cpu_ms, mb;
+	mm_segment_t old_fs;
+	loff_t pos = 0;
+	ssize_t ret;
+
+	/* Anything still cached would not go through readahead */
+	ret = invalidate_inode_pages2(filp->f_mapping);
+	if (ret)
+		return ret;
+
+	old_fs = get_fs();
+	set_fs(KERNEL_DS);
+	do {
+		ret = vfs_read(filp, buf, bufsize, &pos);
+		if (ret > 0)
+			bytes += ret;
+		cond_resched();
+	} while (ret > 0);
+	set_fs(old_fs);
+	if (ret < 0)
+		return ret;
+
+	ms = jiffies_to_msecs(jiffies - start);
+	cpu_ms = cputime_to_msecs(cputime_sub(current->stime, stime));
+	mb = bytes >> 20;
+	if (!mb)
+		return -EINVAL;
+	printk(KERN_INFO "seqread: %lu MB in %lu ms, %lu MB/s, "
+	       "%lu ms system time per GB\n", mb, ms,
+	       ms ? mb * 1000 / ms : 0, cpu_ms * 1024 / mb);
+	return 0;
+}
+
+static int __init seqread_bench_init(void)
+{
+	struct file *filp;
+	unsigned int i;
+	char *buf;
+	int err = 0;
+
+	if (!file || !bufsize)
+		return -EINVAL;
+
+	buf = vmalloc(bufsize);
+	if (!buf)
+		return -ENOMEM;
+	filp = filp_open(file, O_RDONLY | O_LARGEFILE, 0);
+	if (IS_ERR(filp)) {
+		vfree(buf);
+		return PTR_ERR(filp);
+	}
+
+	for (i = 0; i < loops && !err; i++)
+		err = seqread_once(filp, buf);
+
+	filp_close(filp, NULL);
+	vfree(buf);
+	return err;
+}
+
+static void __exit seqread_bench_exit(void) { }
+
+module_init(seqread_bench_init);
+module_exit(seqread_bench_exit);
+
+module_param(file, charp, 0);
+MODULE_PARM_DESC(file, "File to read");
+module_param(bufsize, uint, 0);
+MODULE_PARM_DESC(bufsize, "Bytes per read() (default 128k)");
+module_param(loops, uint, 0);
+MODULE_PARM_DESC(loops, "Times to read the file (default 3)");
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("Sequential read benchmark");
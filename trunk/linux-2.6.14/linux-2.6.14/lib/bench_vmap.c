@@ -0,0 +1,125 @@
+/*
+ * vmap/vunmap benchmark.
+ *
+ * Each thread maps a few pages of its own with vmap(), writes to the
+ * mapping and vunmap()s it again, in a loop, on 1, 2, 4, ... cpus at a
+ * time.  The same is then run with vm_map_ram()/vm_unmap_ram(), which
+ * takes small mappings from the per-cpu vmap blocks.  Both leave the TLB
+ * flush to the lazy purge, so the rates show how well that batches.
+ *
+ *	modprobe bench_vmap pages=4 sec=5
+ */
+
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/mm.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include "bench.h"
+
+static unsigned int pages = 4;
+static unsigned int sec = 5;
+
+static int vmap_setup(struct bench_thread *t)
+{
+	struct page **p;
+	unsigned int i;
+
+	p = kmalloc(pages * sizeof(*p), GFP_KERNEL);
+	if (!p)
+		return -ENOMEM;
+	for (i = 0; i < pages; i++) {
+		p[i] = alloc_page(GFP_KERNEL);
+		if (!p[i]) {
+			while (i--)
+				__free_page(p[i]);
+			kfree(p);
+			return -ENOMEM;
+		}
+	}
+	t->priv = p;
+	return 0;
+}
+
+static void vmap_teardown(struct bench_thread *t)
+{
+	struct page **p = t->priv;
+	unsigned int i;
+
+	for (i = 0; i < pages; i++)
+		__free_page(p[i]);
+	kfree(p);
+}
+
+static int vmap_op(struct bench_thread *t)
+{
+	void *addr;
+
+	addr = vmap(t->priv, pages, VM_MAP, PAGE_KERNEL);
+	if (!addr)
+		return -ENOMEM;
+	*(unsigned long *)addr = t->ops;
+	vunmap(addr);
+	return 0;
+}
+
+static int vm_map_ram_op(struct bench_thread *t)
+{
+	void *addr;
+
+	addr = vm_map_ram(t->priv, pages, PAGE_KERNEL);
+	if (!addr)
+		return -ENOMEM;
+	*(unsigned long *)addr = t->ops;
+	vm_unmap_ram(addr, pages);
+	return 0;
+}
+
+static char vmap_name[24];
+static char vm_map_ram_name[24];
+
+static struct bench vmap_bench = {
+	.name		= vmap_name,
+	.unit		= "maps",
+	.setup		= vmap_setup,
+	.teardown	= vmap_teardown,
+	.op		= vmap_op,
+};
+
+static struct bench vm_map_ram_bench = {
+	.name		= vm_map_ram_name,
+	.unit		= "maps",
+	.setup		= vmap_setup,
+	.teardown	= vmap_teardown,
+	.op		= vm_map_ram_op,
+};
+
+static int __init vmap_bench_init(void)
+{
+	int err;
+
+	if (!pages)
+		return -EINVAL;
+	sprintf(vmap_name, "vmap-%u", pages);
+	sprintf(vm_map_ram_name, "vm_map_ram-%u", pages);
+
+	err = bench_run_all(&vmap_bench, sec);
+	if (!err)
+		err = bench_run_all(&vm_map_ram_bench, sec);
+	return err;
+}
+
+static void __exit vmap_bench_exit(void) { }
+
+module_init(vmap_bench_init);
+module_exit(vmap_bench_exit);
+
+module_param(pages, uint, 0);
+MODULE_PARM_DESC(pages, "Pages per mapping (default 4)");
+module_param(sec, uint, 0);
+MODULE_PARM_DESC(sec, "Seconds per cpu count (default 5)");
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("vmap/vunmap benchmark");
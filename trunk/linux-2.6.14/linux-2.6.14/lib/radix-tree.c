@@ -30,6 +30,7 @@
 #include <linux/gfp.h>
 #include <linux/string.h>
 #include <linux/bitops.h>
+#include <linux/rcupdate.h>
 
 
 #ifdef __KERNEL__
@@ -45,8 +46,14 @@
 #define RADIX_TREE_TAG_LONGS	\
 	((RADIX_TREE_MAP_SIZE + BITS_PER_LONG - 1) / BITS_PER_LONG)
 
+/*
+ * Lockless lookups start from the node root->rnode points to, and take
+ * the height of the tree from it: root->height may not match it yet.
+ */
 struct radix_tree_node {
+	unsigned int	height;		/* levels down to the items */
 	unsigned int	count;
+	struct rcu_head	rcu_head;
 	void		*slots[RADIX_TREE_MAP_SIZE];
 	unsigned long	tags[RADIX_TREE_TAGS][RADIX_TREE_TAG_LONGS];
 };
@@ -98,10 +105,22 @@ radix_tree_node_alloc(struct radix_tree_root *root)
 	return ret;
 }
 
+static void radix_tree_node_rcu_free(struct rcu_head *head)
+{
+	struct radix_tree_node *node =
+			container_of(head, struct radix_tree_node, rcu_head);
+
+	kmem_cache_free(radix_tree_node_cachep, node);
+}
+
+/*
+ * A node is only freed once it is empty, but lockless lookups may still
+ * be walking through it: keep it until they are done.
+ */
 static inline void
 radix_tree_node_free(struct radix_tree_node *node)
 {
-	kmem_cache_free(radix_tree_node_cachep, node);
+	call_rcu(&node->rcu_head, radix_tree_node_rcu_free);
 }
 
 /*
@@ -210,7 +229,8 @@ static int radix_tree_extend(struct radix_tree_root *root, unsigned long index)
 		}
 
 		node->count = 1;
-		root->rnode = node;
+		node->height = root->height + 1;
+		rcu_assign_pointer(root->rnode, node);
 		root->height++;
 	} while (height > root->height);
 out:
@@ -251,11 +271,12 @@ int radix_tree_insert(struct radix_tree_root *root,
 			/* Have to add a child node.  */
 			if (!(slot = radix_tree_node_alloc(root)))
 				return -ENOMEM;
+			slot->height = height;
 			if (node) {
-				node->slots[offset] = slot;
+				rcu_assign_pointer(node->slots[offset], slot);
 				node->count++;
 			} else
-				root->rnode = slot;
+				rcu_assign_pointer(root->rnode, slot);
 		}
 
 		/* Go a level down */
@@ -271,45 +292,69 @@ int radix_tree_insert(struct radix_tree_root *root,
 
 	if (node) {
 		node->count++;
-		node->slots[offset] = item;
+		rcu_assign_pointer(node->slots[offset], item);
 		BUG_ON(tag_get(node, 0, offset));
 		BUG_ON(tag_get(node, 1, offset));
 	} else
-		root->rnode = item;
+		rcu_assign_pointer(root->rnode, item);
 
 	return 0;
 }
 EXPORT_SYMBOL(radix_tree_insert);
 
 /**
- *	radix_tree_lookup    -    perform lookup operation on a radix tree
+ *	radix_tree_lookup_slot    -    lookup a slot in a radix tree
  *	@root:		radix tree root
  *	@index:		index key
  *
- *	Lookup the item at the position @index in the radix tree @root.
+ *	Lookup the slot corresponding to the position @index in the radix tree
+ *	@root, or NULL if there is no item at @index. This is useful for
+ *	update-if-exists operations, with the lock protecting the tree held
+ *	for writing.  Under rcu_read_lock() the item must be read from the
+ *	slot with radix_tree_deref_slot(), and may be gone by then.
  */
-void *radix_tree_lookup(struct radix_tree_root *root, unsigned long index)
+void **radix_tree_lookup_slot(struct radix_tree_root *root, unsigned long index)
 {
 	unsigned int height, shift;
-	struct radix_tree_node *slot;
+	struct radix_tree_node *node, **slot;
 
-	height = root->height;
+	node = rcu_dereference(root->rnode);
+	if (node == NULL)
+		return NULL;
+
+	height = node->height;
 	if (index > radix_tree_maxindex(height))
 		return NULL;
 
 	shift = (height-1) * RADIX_TREE_MAP_SHIFT;
-	slot = root->rnode;
 
-	while (height > 0) {
-		if (slot == NULL)
+	do {
+		slot = (struct radix_tree_node **)
+			(node->slots + ((index >> shift) & RADIX_TREE_MAP_MASK));
+		node = rcu_dereference(*slot);
+		if (node == NULL)
 			return NULL;
-
-		slot = slot->slots[(index >> shift) & RADIX_TREE_MAP_MASK];
 		shift -= RADIX_TREE_MAP_SHIFT;
 		height--;
-	}
+	} while (height > 0);
 
-	return slot;
+	return (void **)slot;
+}
+EXPORT_SYMBOL(radix_tree_lookup_slot);
+
+/**
+ *	radix_tree_lookup    -    perform lookup operation on a radix tree
+ *	@root:		radix tree root
+ *	@index:		index key
+ *
+ *	Lookup the item at the position @index in the radix tree @root.
+ */
+void *radix_tree_lookup(struct radix_tree_root *root, unsigned long index)
+{
+	void **slot;
+
+	slot = radix_tree_lookup_slot(root, index);
+	return slot != NULL ? radix_tree_deref_slot(slot) : NULL;
 }
 EXPORT_SYMBOL(radix_tree_lookup);
 
@@ -471,27 +516,31 @@ int radix_tree_tag_get(struct radix_tree_root *root,
 EXPORT_SYMBOL(radix_tree_tag_get);
 #endif
 
+/*
+ * Gather up to @max_items items below @slot, exceptional ones if
+ * @exceptional is set and ordinary ones otherwise: the items at
+ * *@results, or their slots at *@slots, and their indices if @indices
+ * is set.
+ */
 static unsigned int
-__lookup(struct radix_tree_root *root, void **results, unsigned long index,
-	unsigned int max_items, unsigned long *next_index)
+__lookup(struct radix_tree_node *slot, void **results, void ***slots,
+	unsigned long *indices, unsigned long index, unsigned int max_items,
+	unsigned long *next_index, int exceptional)
 {
 	unsigned int nr_found = 0;
 	unsigned int shift, height;
-	struct radix_tree_node *slot;
 	unsigned long i;
 
-	height = root->height;
-	if (height == 0)
-		goto out;
-
+	height = slot->height;
 	shift = (height-1) * RADIX_TREE_MAP_SHIFT;
-	slot = root->rnode;
 
 	for ( ; height > 1; height--) {
+		struct radix_tree_node *child = NULL;
 
 		for (i = (index >> shift) & RADIX_TREE_MAP_MASK ;
 				i < RADIX_TREE_MAP_SIZE; i++) {
-			if (slot->slots[i] != NULL)
+			child = rcu_dereference(slot->slots[i]);
+			if (child != NULL)
 				break;
 			index &= ~((1UL << shift) - 1);
 			index += 1UL << shift;
@@ -502,15 +551,23 @@ __lookup(struct radix_tree_root *root, void **results, unsigned long index,
 			goto out;
 
 		shift -= RADIX_TREE_MAP_SHIFT;
-		slot = slot->slots[i];
+		slot = child;
 	}
 
 	/* Bottom level: grab some items */
 	for (i = index & RADIX_TREE_MAP_MASK; i < RADIX_TREE_MAP_SIZE; i++) {
+		void *item = rcu_dereference(slot->slots[i]);
+
 		index++;
-		if (slot->slots[i]) {
-			results[nr_found++] = slot->slots[i];
-			if (nr_found == max_items)
+		if (item &&
+		    radix_tree_exceptional_entry(item) == exceptional) {
+			if (indices)
+				indices[nr_found] = index - 1;
+			if (slots)
+				slots[nr_found] = &slot->slots[i];
+			else
+				results[nr_found] = item;
+			if (++nr_found == max_items)
 				goto out;
 		}
 	}
@@ -519,6 +576,40 @@ out:
 	return nr_found;
 }
 
+static unsigned int
+__gang_lookup(struct radix_tree_root *root, void **results, void ***slots,
+	unsigned long *indices, unsigned long first_index,
+	unsigned int max_items, int exceptional)
+{
+	struct radix_tree_node *node;
+	unsigned long max_index;
+	unsigned long cur_index = first_index;
+	unsigned int ret = 0;
+
+	node = rcu_dereference(root->rnode);
+	if (node == NULL)
+		return 0;
+	max_index = radix_tree_maxindex(node->height);
+
+	while (ret < max_items) {
+		unsigned int nr_found;
+		unsigned long next_index;	/* Index of next search */
+
+		if (cur_index > max_index)
+			break;
+		nr_found = __lookup(node, results ? results + ret : NULL,
+					slots ? slots + ret : NULL,
+					indices ? indices + ret : NULL,
+					cur_index, max_items - ret,
+					&next_index, exceptional);
+		ret += nr_found;
+		if (next_index == 0)
+			break;
+		cur_index = next_index;
+	}
+	return ret;
+}
+
 /**
  *	radix_tree_gang_lookup - perform multiple lookup on a radix tree
  *	@root:		radix tree root
@@ -528,7 +619,7 @@ out:
  *
  *	Performs an index-ascending scan of the tree for present items.  Places
  *	them at *@results and returns the number of items which were placed at
- *	*@results.
+ *	*@results.  Exceptional entries are not returned.
  *
  *	The implementation is naive.
  */
@@ -536,26 +627,119 @@ unsigned int
 radix_tree_gang_lookup(struct radix_tree_root *root, void **results,
 			unsigned long first_index, unsigned int max_items)
 {
-	const unsigned long max_index = radix_tree_maxindex(root->height);
-	unsigned long cur_index = first_index;
-	unsigned int ret = 0;
+	return __gang_lookup(root, results, NULL, NULL, first_index,
+			     max_items, 0);
+}
+EXPORT_SYMBOL(radix_tree_gang_lookup);
 
-	while (ret < max_items) {
-		unsigned int nr_found;
-		unsigned long next_index;	/* Index of next search */
+/**
+ *	radix_tree_next_hole - find the next hole (not-present entry)
+ *	@root:		tree root
+ *	@index:		index key
+ *	@max_scan:	maximum range to search
+ *
+ *	Search the set [index, min(index+max_scan-1, MAX_INDEX)] for the
+ *	lowest indexed hole: an index with no item, or an exceptional one.
+ *
+ *	Returns the index of the hole if found, otherwise returns an index
+ *	outside of the set specified (in which case 'return - index >=
+ *	max_scan' will be true).  In rare cases of index wrap-around, 0
+ *	will be returned.
+ *
+ *	May be called under rcu_read_lock(), when the answer is only a hint:
+ *	the tree may change meanwhile.
+ */
+unsigned long radix_tree_next_hole(struct radix_tree_root *root,
+				unsigned long index, unsigned long max_scan)
+{
+	unsigned long i;
 
-		if (cur_index > max_index)
+	for (i = 0; i < max_scan; i++) {
+		void *item = radix_tree_lookup(root, index);
+
+		if (!item || radix_tree_exceptional_entry(item))
 			break;
-		nr_found = __lookup(root, results + ret, cur_index,
-					max_items - ret, &next_index);
-		ret += nr_found;
-		if (next_index == 0)
+		index++;
+		if (index == 0)
 			break;
-		cur_index = next_index;
 	}
-	return ret;
+	return index;
 }
-EXPORT_SYMBOL(radix_tree_gang_lookup);
+EXPORT_SYMBOL(radix_tree_next_hole);
+
+/**
+ *	radix_tree_prev_hole - find the prev hole (not-present entry)
+ *	@root:		tree root
+ *	@index:		index key
+ *	@max_scan:	maximum range to search
+ *
+ *	Search backwards in the range [max(index-max_scan+1, 0), index]
+ *	for the first hole, as radix_tree_next_hole() does forwards.
+ *
+ *	Returns the index of the hole if found, otherwise returns an index
+ *	outside of the set specified (in which case 'index - return >=
+ *	max_scan' will be true).  In rare cases of wrap-around, ULONG_MAX
+ *	will be returned.
+ */
+unsigned long radix_tree_prev_hole(struct radix_tree_root *root,
+				unsigned long index, unsigned long max_scan)
+{
+	unsigned long i;
+
+	for (i = 0; i < max_scan; i++) {
+		void *item = radix_tree_lookup(root, index);
+
+		if (!item || radix_tree_exceptional_entry(item))
+			break;
+		index--;
+		if (index == ULONG_MAX)
+			break;
+	}
+	return index;
+}
+EXPORT_SYMBOL(radix_tree_prev_hole);
+
+/**
+ *	radix_tree_gang_lookup_slot - perform multiple slot lookup on a
+ *	                              radix tree
+ *	@root:		radix tree root
+ *	@results:	where the slots of the items are placed
+ *	@first_index:	start the lookup from this key
+ *	@max_items:	place up to this many slots at *results
+ *
+ *	Like radix_tree_gang_lookup(), but returns the slots of the items,
+ *	so that lockless callers can check that an item they took a
+ *	reference on is still there: see radix_tree_deref_slot().
+ */
+unsigned int
+radix_tree_gang_lookup_slot(struct radix_tree_root *root, void ***results,
+			unsigned long first_index, unsigned int max_items)
+{
+	return __gang_lookup(root, NULL, results, NULL, first_index,
+			     max_items, 0);
+}
+EXPORT_SYMBOL(radix_tree_gang_lookup_slot);
+
+/**
+ *	radix_tree_gang_lookup_exceptional - find exceptional entries
+ *	@root:		radix tree root
+ *	@results:	where the entries are placed
+ *	@indices:	where their indices are placed
+ *	@first_index:	start the lookup from this key
+ *	@max_items:	place up to this many entries at *results
+ *
+ *	Like radix_tree_gang_lookup(), but returns only the exceptional
+ *	entries, and their indices at *@indices.
+ */
+unsigned int
+radix_tree_gang_lookup_exceptional(struct radix_tree_root *root,
+			void **results, unsigned long *indices,
+			unsigned long first_index, unsigned int max_items)
+{
+	return __gang_lookup(root, results, NULL, indices, first_index,
+			     max_items, 1);
+}
+EXPORT_SYMBOL(radix_tree_gang_lookup_exceptional);
 
 /*
  * FIXME: the two tag_get()s here should use find_next_bit() instead of
@@ -745,12 +929,14 @@ EXPORT_SYMBOL(radix_tree_delete);
  */
 int radix_tree_tagged(struct radix_tree_root *root, int tag)
 {
+	struct radix_tree_node *rnode;
 	int idx;
 
-	if (!root->rnode)
+	rnode = rcu_dereference(root->rnode);
+	if (!rnode)
 		return 0;
 	for (idx = 0; idx < RADIX_TREE_TAG_LONGS; idx++) {
-		if (root->rnode->tags[tag][idx])
+		if (rnode->tags[tag][idx])
 			return 1;
 	}
 	return 0;
@@ -0,0 +1,372 @@
+/*
+ * mm/backing-dev.c - per-device flusher threads
+ *
+ * Each backing device which has dirty inodes gets a thread of its own to
+ * write them back: periodic writeback of old data and background writeout
+ * are done by the device's flusher, for that device only.  So writeback to
+ * many disks goes on in parallel, and a slow or congested device cannot
+ * hold up the others, the way it would a shared pdflush thread walking all
+ * superblocks.
+ *
+ * Flushers are started on demand, when an inode backed by the device is
+ * dirtied or writeback is asked of it.  Thread creation can sleep, and the
+ * dirtying paths cannot, so it is left to the "bdi-default" thread.  A
+ * flusher exits again when it has been idle for a while and no inode of its
+ * device is dirty.
+ */
+
+#include <linux/sched.h>
+#include <linux/list.h>
+#include <linux/spinlock.h>
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/fs.h>
+#include <linux/writeback.h>
+#include <linux/backing-dev.h>
+#include <linux/kthread.h>
+#include <linux/delay.h>
+#include <linux/err.h>
+
+/*
+ * A flusher with nothing to do for this long goes away, if its device has
+ * no dirty inodes left.
+ */
+#define FLUSHER_IDLE_TIME	(300 * HZ)
+
+/*
+ * backing_dev_info.flusher_state
+ */
+enum {
+	FLUSHER_NONE,		/* No thread */
+	FLUSHER_PENDING,	/* On bdi_pending_list, waiting for a thread */
+	FLUSHER_FORKING,	/* ... which bdi-default is creating */
+	FLUSHER_RUNNING,	/* On bdi_flusher_list, with a thread */
+	FLUSHER_STOPPING,	/* ... which bdi_stop_flusher is stopping */
+};
+
+/*
+ * Devices waiting for a flusher, and devices with one.  Both, and the
+ * flusher fields of every backing_dev_info, are protected by bdi_lock.
+ * bdi_lock nests inside inode_lock.
+ */
+static LIST_HEAD(bdi_pending_list);
+static LIST_HEAD(bdi_flusher_list);
+static DEFINE_SPINLOCK(bdi_lock);
+
+static struct task_struct *bdi_forker;
+static int nr_flushers_started;
+
+static unsigned long writeback_interval(void)
+{
+	return (dirty_writeback_centisecs * HZ) / 100;
+}
+
+/*
+ * How long to sleep until `last' + `interval', or for good if periodic
+ * writeback is switched off.
+ */
+static long sleep_until(unsigned long last, unsigned long interval)
+{
+	long timeout;
+
+	if (!interval)
+		return MAX_SCHEDULE_TIMEOUT;
+	timeout = last + interval - jiffies;
+	if (timeout < 1)
+		timeout = 1;
+	return timeout;
+}
+
+/*
+ * Put @bdi in line for a flusher thread.  Called under bdi_lock.
+ */
+static void __bdi_start_flusher(struct backing_dev_info *bdi)
+{
+	if (bdi->flusher_state != FLUSHER_NONE)
+		return;
+	bdi->flusher_state = FLUSHER_PENDING;
+	list_add_tail(&bdi->flusher_list, &bdi_pending_list);
+	if (bdi_forker)
+		wake_up_process(bdi_forker);
+}
+
+/**
+ * bdi_start_flusher - make sure a device has a flusher thread
+ * @bdi: the device, which has just got a dirty inode
+ *
+ * Does not sleep: called from __mark_inode_dirty, under inode_lock.
+ */
+void bdi_start_flusher(struct backing_dev_info *bdi)
+{
+	if (!bdi_cap_writeback_dirty(bdi))
+		return;
+	if (bdi->flusher_state != FLUSHER_NONE)	/* unlocked test is OK */
+		return;
+
+	spin_lock(&bdi_lock);
+	__bdi_start_flusher(bdi);
+	spin_unlock(&bdi_lock);
+}
+
+/*
+ * Ask the flusher of @bdi for background writeout of at least `nr_pages'.
+ * Called under bdi_lock.
+ */
+static void __bdi_start_writeback(struct backing_dev_info *bdi, long nr_pages)
+{
+	bdi->flusher_pages += nr_pages;
+	set_bit(BDI_work, &bdi->state);
+	if (bdi->flusher_state == FLUSHER_RUNNING)
+		wake_up_process(bdi->flusher);
+	else
+		__bdi_start_flusher(bdi);
+}
+
+/**
+ * bdi_start_writeback - start background writeout against a device
+ * @bdi: the device
+ * @nr_pages: write back at least this many pages
+ *
+ * The device's flusher writes back `nr_pages' of its pages, and then goes on
+ * while the machine is over the background writeout threshold or the device
+ * is over its dirty limit.  Does not wait for any of it.
+ */
+void bdi_start_writeback(struct backing_dev_info *bdi, long nr_pages)
+{
+	if (!bdi_cap_writeback_dirty(bdi))
+		return;
+
+	spin_lock(&bdi_lock);
+	__bdi_start_writeback(bdi, nr_pages);
+	spin_unlock(&bdi_lock);
+}
+EXPORT_SYMBOL(bdi_start_writeback);
+
+/**
+ * bdi_writeback_all - start background writeout against all devices
+ * @nr_pages: ask each device to write back at least this many pages
+ *
+ * Wakes the flushers of all devices which have dirty inodes.
+ */
+void bdi_writeback_all(long nr_pages)
+{
+	struct backing_dev_info *bdi;
+
+	spin_lock(&bdi_lock);
+	list_for_each_entry(bdi, &bdi_flusher_list, flusher_list)
+		__bdi_start_writeback(bdi, nr_pages);
+	list_for_each_entry(bdi, &bdi_pending_list, flusher_list)
+		__bdi_start_writeback(bdi, nr_pages);
+	spin_unlock(&bdi_lock);
+}
+
+/*
+ * Have all the flushers look at the writeback interval again, after it
+ * was changed.
+ */
+void bdi_wakeup_flushers(void)
+{
+	struct backing_dev_info *bdi;
+
+	spin_lock(&bdi_lock);
+	list_for_each_entry(bdi, &bdi_flusher_list, flusher_list) {
+		if (bdi->flusher_state == FLUSHER_RUNNING)
+			wake_up_process(bdi->flusher);
+	}
+	if (bdi_forker)
+		wake_up_process(bdi_forker);
+	spin_unlock(&bdi_lock);
+}
+
+/**
+ * bdi_stop_flusher - stop the flusher thread of a device
+ * @bdi: the device, which is about to go away
+ *
+ * To be called before a backing_dev_info which is not static is freed, once
+ * all the inodes it backs are gone.  Waits for the flusher to exit.
+ */
+void bdi_stop_flusher(struct backing_dev_info *bdi)
+{
+	struct task_struct *task = NULL;
+
+	spin_lock(&bdi_lock);
+	while (bdi->flusher_state == FLUSHER_FORKING) {
+		spin_unlock(&bdi_lock);
+		msleep(1);
+		spin_lock(&bdi_lock);
+	}
+	if (bdi->flusher_state == FLUSHER_PENDING) {
+		list_del(&bdi->flusher_list);
+		bdi->flusher_state = FLUSHER_NONE;
+	} else if (bdi->flusher_state == FLUSHER_RUNNING) {
+		bdi->flusher_state = FLUSHER_STOPPING;
+		task = bdi->flusher;
+	}
+	spin_unlock(&bdi_lock);
+
+	if (task) {
+		kthread_stop(task);
+		spin_lock(&bdi_lock);
+		list_del(&bdi->flusher_list);
+		bdi->flusher = NULL;
+		bdi->flusher_state = FLUSHER_NONE;
+		spin_unlock(&bdi_lock);
+	}
+	clear_bit(BDI_work, &bdi->state);
+	bdi->flusher_pages = 0;
+}
+EXPORT_SYMBOL(bdi_stop_flusher);
+
+/*
+ * An idle flusher may go if no inode of its device is dirty.  Dirtying an
+ * inode puts it on a dirty list and starts a flusher under inode_lock, so
+ * holding that while we look means no dirty inode can be left without one.
+ * Returns true if the flusher is to exit: it no longer owns @bdi then.
+ */
+static int bdi_flusher_may_exit(struct backing_dev_info *bdi)
+{
+	int ret = 0;
+
+	spin_lock(&sb_lock);
+	spin_lock(&inode_lock);
+	if (!bdi_has_dirty_inodes(bdi)) {
+		spin_lock(&bdi_lock);
+		if (bdi->flusher_state == FLUSHER_RUNNING &&
+				!test_bit(BDI_work, &bdi->state)) {
+			list_del(&bdi->flusher_list);
+			bdi->flusher = NULL;
+			bdi->flusher_state = FLUSHER_NONE;
+			ret = 1;
+		}
+		spin_unlock(&bdi_lock);
+	}
+	spin_unlock(&inode_lock);
+	spin_unlock(&sb_lock);
+	return ret;
+}
+
+/*
+ * The flusher thread of a device.  It does the background writeout asked
+ * of it through BDI_work, and every dirty_writeback_centisecs the periodic
+ * writeback of old data.
+ */
+static int bdi_flusher_thread(void *data)
+{
+	struct backing_dev_info *bdi = data;
+	unsigned long last_active = jiffies;
+	unsigned long last_old_flush = jiffies;
+
+	current->flags |= PF_FLUSHER;
+	/*
+	 * Like pdflush, flushers can spend a lot of time doing encryption
+	 * via dm-crypt: not at keventd's priority.
+	 */
+	set_user_nice(current, 0);
+
+	while (!kthread_should_stop()) {
+		unsigned long interval = writeback_interval();
+		long written = 0;
+
+		if (test_and_clear_bit(BDI_work, &bdi->state)) {
+			long min_pages;
+
+			spin_lock(&bdi_lock);
+			min_pages = bdi->flusher_pages;
+			bdi->flusher_pages = 0;
+			spin_unlock(&bdi_lock);
+			written += bdi_background_writeout(bdi, min_pages);
+		}
+
+		if (interval && time_after_eq(jiffies,
+					last_old_flush + interval)) {
+			last_old_flush = jiffies;
+			written += bdi_kupdate(bdi);
+		}
+
+		if (written)
+			last_active = jiffies;
+		else if (time_after(jiffies, last_active + FLUSHER_IDLE_TIME) &&
+				bdi_flusher_may_exit(bdi))
+			break;
+
+		set_current_state(TASK_INTERRUPTIBLE);
+		if (!test_bit(BDI_work, &bdi->state) && !kthread_should_stop())
+			schedule_timeout(sleep_until(last_old_flush, interval));
+		__set_current_state(TASK_RUNNING);
+		try_to_freeze();
+	}
+	return 0;
+}
+
+/*
+ * The bdi-default thread starts the flushers of devices in need of one.
+ * It also writes back dirty superblocks every dirty_writeback_centisecs,
+ * which the periodic writeback used to do before it went per-device.
+ */
+static int bdi_forker_thread(void *unused)
+{
+	unsigned long last_sync = jiffies;
+
+	current->flags |= PF_FLUSHER;
+	set_user_nice(current, 0);
+
+	for ( ; ; ) {
+		unsigned long interval = writeback_interval();
+		struct backing_dev_info *bdi;
+		struct task_struct *task;
+
+		if (interval && time_after_eq(jiffies, last_sync + interval)) {
+			last_sync = jiffies;
+			sync_supers();
+		}
+
+		set_current_state(TASK_INTERRUPTIBLE);
+		spin_lock(&bdi_lock);
+		if (list_empty(&bdi_pending_list)) {
+			spin_unlock(&bdi_lock);
+			schedule_timeout(sleep_until(last_sync, interval));
+			try_to_freeze();
+			continue;
+		}
+		__set_current_state(TASK_RUNNING);
+		bdi = list_entry(bdi_pending_list.next,
+				struct backing_dev_info, flusher_list);
+		bdi->flusher_state = FLUSHER_FORKING;
+		spin_unlock(&bdi_lock);
+
+		task = kthread_create(bdi_flusher_thread, bdi, "flush-%d",
+					nr_flushers_started++);
+
+		spin_lock(&bdi_lock);
+		if (IS_ERR(task)) {
+			/* Out of memory, probably: try again in a while */
+			bdi->flusher_state = FLUSHER_PENDING;
+			spin_unlock(&bdi_lock);
+			set_current_state(TASK_INTERRUPTIBLE);
+			schedule_timeout(HZ);
+			continue;
+		}
+		list_move_tail(&bdi->flusher_list, &bdi_flusher_list);
+		bdi->flusher = task;
+		bdi->flusher_state = FLUSHER_RUNNING;
+		spin_unlock(&bdi_lock);
+		wake_up_process(task);
+	}
+	return 0;
+}
+
+static int __init bdi_flusher_init(void)
+{
+	struct task_struct *task;
+
+	task = kthread_run(bdi_forker_thread, NULL, "bdi-default");
+	if (IS_ERR(task))
+		return PTR_ERR(task);
+
+	spin_lock(&bdi_lock);
+	bdi_forker = task;
+	spin_unlock(&bdi_lock);
+	return 0;
+}
+
+module_init(bdi_flusher_init);
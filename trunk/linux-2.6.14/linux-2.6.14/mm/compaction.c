@@ -0,0 +1,354 @@
+/*
+ * mm/compaction.c - memory compaction
+ *
+ * Defragments a zone by moving movable pages from its start to free pages
+ * near its end.  Two scanners walk the zone a pageblock at a time: the
+ * migrate scanner goes up from the start isolating pages on the LRU, the
+ * free scanner goes down from the end isolating free pages of MOVABLE
+ * pageblocks, and page migration moves the former into the latter.  The
+ * scanners meeting ends the pass; the free memory is then gathered in
+ * large blocks at the start of the zone.
+ *
+ * Compaction runs from the page allocator before direct reclaim when a
+ * higher order allocation fails, and for all zones when anything is
+ * written to /proc/sys/vm/compact_memory.
+ */
+
+#include <linux/mm.h>
+#include <linux/swap.h>
+#include <linux/migrate.h>
+#include <linux/compaction.h>
+#include <linux/sysctl.h>
+#include <linux/sched.h>
+#include <linux/cpuset.h>
+#include "internal.h"
+
+/* Pages isolated for migration at a time */
+#define COMPACT_CLUSTER_MAX	32
+
+struct compact_control {
+	struct list_head freepages;	/* List of free pages to migrate to */
+	struct list_head migratepages;	/* List of pages being migrated */
+	unsigned long nr_freepages;	/* Number of isolated free pages */
+	unsigned long nr_migratepages;	/* Number of pages to migrate */
+	unsigned long free_pfn;		/* isolate_freepages search base */
+	unsigned long migrate_pfn;	/* isolate_migratepages search base */
+	unsigned long nr_moved;		/* Number of pages migrated */
+
+	int order;			/* order a direct compactor needs,
+					   -1 to compact the whole zone */
+	struct zone *zone;
+};
+
+static void release_freepages(struct list_head *freelist)
+{
+	struct page *page, *next;
+
+	list_for_each_entry_safe(page, next, freelist, lru) {
+		list_del(&page->lru);
+		__free_page(page);
+	}
+}
+
+/* Free pages are only taken from pageblocks which hold movable pages */
+static int suitable_migration_target(struct page *page)
+{
+	return get_pageblock_migratetype(page) == MIGRATE_MOVABLE;
+}
+
+/*
+ * Isolate the free pages of the pageblock starting at @block_pfn.
+ * Call with zone->lock held.
+ */
+static unsigned long isolate_freepages_block(struct zone *zone,
+				unsigned long block_pfn,
+				struct list_head *freelist)
+{
+	unsigned long pfn, end_pfn;
+	unsigned long total_isolated = 0;
+
+	end_pfn = min(block_pfn + pageblock_nr_pages,
+		      zone->zone_start_pfn + zone->spanned_pages);
+
+	for (pfn = block_pfn; pfn < end_pfn; pfn++) {
+		int isolated;
+
+		if (!pfn_valid(pfn))
+			continue;
+
+		isolated = isolate_free_block(zone, pfn_to_page(pfn),
+					      freelist);
+		if (isolated) {
+			total_isolated += isolated;
+			pfn += isolated - 1;
+		}
+	}
+	return total_isolated;
+}
+
+/*
+ * Based on information in the current compact_control, find blocks
+ * suitable for isolating free pages from and then isolate them.
+ */
+static void isolate_freepages(struct zone *zone, struct compact_control *cc)
+{
+	unsigned long pfn, low_pfn, high_pfn;
+	unsigned long flags;
+
+	/*
+	 * Scan down from the pageblock the free scanner stopped at, but
+	 * not into the pageblock the migrate scanner is working on.
+	 */
+	pfn = cc->free_pfn;
+	low_pfn = cc->migrate_pfn + pageblock_nr_pages;
+	high_pfn = min(low_pfn, pfn);
+
+	for (; pfn > low_pfn && cc->nr_migratepages > cc->nr_freepages;
+	     pfn -= pageblock_nr_pages) {
+		unsigned long isolated;
+
+		if (!pfn_valid(pfn) ||
+		    !suitable_migration_target(pfn_to_page(pfn)))
+			continue;
+
+		/*
+		 * Keep the zone above the low watermark: compaction must
+		 * not eat into the reserves it is meant to free up.
+		 */
+		if (zone->free_pages < zone->pages_low + pageblock_nr_pages)
+			break;
+
+		spin_lock_irqsave(&zone->lock, flags);
+		isolated = isolate_freepages_block(zone, pfn, &cc->freepages);
+		spin_unlock_irqrestore(&zone->lock, flags);
+
+		cc->nr_freepages += isolated;
+
+		/* Resume here next time, the block may have more pages */
+		if (isolated)
+			high_pfn = max(high_pfn, pfn);
+	}
+
+	cc->free_pfn = high_pfn;
+}
+
+/*
+ * Isolate the pages on the LRU of the next pageblocks which have not
+ * been scanned yet, up to COMPACT_CLUSTER_MAX of them.
+ */
+static unsigned long isolate_migratepages(struct zone *zone,
+					  struct compact_control *cc)
+{
+	unsigned long low_pfn, end_pfn;
+	struct page *page;
+
+	low_pfn = cc->migrate_pfn;
+	end_pfn = low_pfn + pageblock_nr_pages;
+
+	/* Do not scan into the pageblocks the free scanner has taken */
+	if (end_pfn > cc->free_pfn) {
+		cc->migrate_pfn = cc->free_pfn;
+		return 0;
+	}
+
+	/* Get the pages from the pcp lists onto the LRU */
+	lru_add_drain();
+
+	spin_lock_irq(&zone->lru_lock);
+	for (; low_pfn < end_pfn; low_pfn++) {
+		if (!pfn_valid(low_pfn))
+			continue;
+
+		page = pfn_to_page(low_pfn);
+
+		/* Skip free blocks, their order is racy but bounded */
+		if (PagePrivate(page) && !page_count(page) &&
+		    page->private < MAX_ORDER) {
+			low_pfn += (1UL << page->private) - 1;
+			continue;
+		}
+
+		if (!PageLRU(page) || PageReserved(page))
+			continue;
+
+		if (isolate_lru_page(page, &cc->migratepages))
+			continue;
+
+		if (++cc->nr_migratepages == COMPACT_CLUSTER_MAX) {
+			low_pfn++;
+			break;
+		}
+	}
+	spin_unlock_irq(&zone->lru_lock);
+
+	cc->migrate_pfn = low_pfn;
+	return cc->nr_migratepages;
+}
+
+/*
+ * This is a migrate-callback that "allocates" freepages by taking pages
+ * from the isolated freelists in the block we are migrating to.
+ */
+static struct page *compaction_alloc(struct page *migratepage,
+				     unsigned long data)
+{
+	struct compact_control *cc = (struct compact_control *)data;
+	struct page *freepage;
+
+	/* Isolate free pages if necessary */
+	if (list_empty(&cc->freepages)) {
+		isolate_freepages(cc->zone, cc);
+
+		if (list_empty(&cc->freepages))
+			return NULL;
+	}
+
+	freepage = list_entry(cc->freepages.next, struct page, lru);
+	list_del(&freepage->lru);
+	cc->nr_freepages--;
+
+	return freepage;
+}
+
+static int compact_finished(struct zone *zone, struct compact_control *cc)
+{
+	if (signal_pending(current))
+		return COMPACT_PARTIAL;
+
+	/* Compaction run completes if the migrate and free scanner meet */
+	if (cc->free_pfn <= cc->migrate_pfn)
+		return COMPACT_COMPLETE;
+
+	/* Compacting everything for /proc, or the allocation would fail */
+	if (cc->order < 0 ||
+	    !zone_watermark_ok(zone, cc->order, zone->pages_low, 0, 0, 0))
+		return COMPACT_CONTINUE;
+
+	return COMPACT_PARTIAL;
+}
+
+static int compact_zone(struct zone *zone, struct compact_control *cc)
+{
+	int ret;
+
+	INIT_LIST_HEAD(&cc->freepages);
+	INIT_LIST_HEAD(&cc->migratepages);
+	cc->nr_freepages = 0;
+	cc->nr_migratepages = 0;
+	cc->nr_moved = 0;
+	cc->zone = zone;
+
+	/* Setup to move all movable pages to the end of the zone */
+	cc->migrate_pfn = zone->zone_start_pfn;
+	cc->free_pfn = cc->migrate_pfn + zone->spanned_pages;
+	cc->free_pfn &= ~(pageblock_nr_pages - 1);
+
+	while ((ret = compact_finished(zone, cc)) == COMPACT_CONTINUE) {
+		unsigned long nr_migrate;
+		int nr_remaining;
+
+		if (!isolate_migratepages(zone, cc))
+			continue;
+
+		nr_migrate = cc->nr_migratepages;
+		nr_remaining = migrate_pages(&cc->migratepages,
+					     compaction_alloc,
+					     (unsigned long)cc);
+		if (nr_remaining > 0)
+			cc->nr_moved += nr_migrate - nr_remaining;
+		else if (!nr_remaining)
+			cc->nr_moved += nr_migrate;
+		cc->nr_migratepages = 0;
+
+		cond_resched();
+	}
+
+	/* Give back the free pages which were not used */
+	release_freepages(&cc->freepages);
+
+	return ret;
+}
+
+/**
+ * try_to_compact_pages - direct compact to satisfy a high-order allocation
+ * @zones: the zonelist of the allocation
+ * @order: the order of the allocation
+ * @gfp_mask: the gfp mask of the allocation
+ *
+ * Returns nonzero if pages were moved in any of the zones.
+ */
+int try_to_compact_pages(struct zone **zones, int order, gfp_t gfp_mask)
+{
+	struct task_struct *p = current;
+	struct compact_control cc;
+	struct zone *zone;
+	int i, moved = 0;
+
+	/*
+	 * Dropping buffers and locking pages may enter the filesystem,
+	 * so only callers which could do reclaim get to compact.
+	 */
+	if (!(gfp_mask & __GFP_FS) || !(gfp_mask & __GFP_IO))
+		return 0;
+
+	inc_page_state(compact_stall);
+	p->flags |= PF_MEMALLOC;
+
+	for (i = 0; (zone = zones[i]) != NULL; i++) {
+		if (!cpuset_zone_allowed(zone, __GFP_HARDWALL))
+			continue;
+
+		/*
+		 * Compaction needs free pages to migrate into: leave zones
+		 * which are simply short of memory to reclaim.
+		 */
+		if (zone->free_pages < zone->pages_low + (2UL << order))
+			continue;
+
+		cc.order = order;
+		if (compact_zone(zone, &cc) == COMPACT_PARTIAL ||
+		    cc.nr_moved)
+			moved = 1;
+
+		if (zone_watermark_ok(zone, order, zone->pages_low, 0, 0, 0))
+			break;
+	}
+
+	p->flags &= ~PF_MEMALLOC;
+	return moved;
+}
+
+/* Compact all zones within a node */
+static void compact_node(pg_data_t *pgdat)
+{
+	struct compact_control cc;
+	int i;
+
+	for (i = 0; i < MAX_NR_ZONES; i++) {
+		struct zone *zone = pgdat->node_zones + i;
+
+		if (!zone->present_pages)
+			continue;
+
+		cc.order = -1;
+		compact_zone(zone, &cc);
+	}
+}
+
+/* The written value is actually unused, all memory is compacted */
+int sysctl_compact_memory;
+
+/* This is the entry point for compacting all nodes via /proc/sys/vm */
+int sysctl_compaction_handler(struct ctl_table *table, int write,
+			struct file *file, void __user *buffer,
+			size_t *length, loff_t *ppos)
+{
+	pg_data_t *pgdat;
+
+	proc_dointvec(table, write, file, buffer, length, ppos);
+	if (write) {
+		for_each_pgdat(pgdat)
+			compact_node(pgdat);
+	}
+	return 0;
+}
@@ -28,6 +28,7 @@
 #include <linux/blkdev.h>
 #include <linux/security.h>
 #include <linux/syscalls.h>
+#include <linux/rmap.h>
 #include "filemap.h"
 /*
  * FIXME: remove all knowledge of the buffer layer from the core VM
@@ -106,13 +107,23 @@ generic_file_direct_IO(int rw, struct kiocb *iocb, const struct iovec *iov,
 /*
  * Remove a page from the page cache and free it. Caller has to make
  * sure the page is locked and that nobody else uses it - or that usage
- * is safe.  The caller must hold a write_lock on the mapping's tree_lock.
+ * is safe.  The caller must hold the mapping's tree_lock.
+ *
+ * Reclaim passes the @shadow entry from workingset_eviction(), which is
+ * left in the page's slot; everybody else passes NULL.
  */
-void __remove_from_page_cache(struct page *page)
+void __remove_from_page_cache(struct page *page, void *shadow)
 {
 	struct address_space *mapping = page->mapping;
 
-	radix_tree_delete(&mapping->page_tree, page->index);
+	if (shadow) {
+		void **slot;
+
+		slot = radix_tree_lookup_slot(&mapping->page_tree, page->index);
+		radix_tree_replace_slot(slot, shadow);
+		mapping->nrshadows++;
+	} else
+		radix_tree_delete(&mapping->page_tree, page->index);
 	page->mapping = NULL;
 	mapping->nrpages--;
 	pagecache_acct(-1);
@@ -124,9 +135,9 @@ void remove_from_page_cache(struct page *page)
 
 	BUG_ON(!PageLocked(page));
 
-	write_lock_irq(&mapping->tree_lock);
-	__remove_from_page_cache(page);
-	write_unlock_irq(&mapping->tree_lock);
+	spin_lock_irq(&mapping->tree_lock);
+	__remove_from_page_cache(page, NULL);
+	spin_unlock_irq(&mapping->tree_lock);
 }
 
 static int sync_page(void *word)
@@ -369,6 +380,72 @@ int filemap_write_and_wait_range(struct address_space *mapping,
 	return retval;
 }
 
+/*
+ * Put the page in the tree at page->index, in place of the shadow entry
+ * of an evicted page if there is one.  The shadow is returned at
+ * *@shadowp.  The caller holds the tree_lock, with nodes preloaded.
+ */
+static int page_cache_tree_insert(struct address_space *mapping,
+		struct page *page, void **shadowp)
+{
+	void **slot = NULL;
+	int error = 0;
+
+	if (mapping->nrshadows)
+		slot = radix_tree_lookup_slot(&mapping->page_tree,
+					      page->index);
+	if (slot && radix_tree_exceptional_entry(*slot)) {
+		if (shadowp)
+			*shadowp = *slot;
+		radix_tree_replace_slot(slot, page);
+		mapping->nrshadows--;
+	} else
+		error = radix_tree_insert(&mapping->page_tree,
+					  page->index, page);
+	if (!error) {
+		mapping->nrpages++;
+		pagecache_acct(1);
+	}
+	return error;
+}
+
+/*
+ * Insert the page at @offset, in place of the shadow entry of an evicted
+ * page if there is one.  The shadow is returned at *@shadowp.
+ */
+static int __add_to_page_cache(struct page *page,
+		struct address_space *mapping, pgoff_t offset, int gfp_mask,
+		void **shadowp)
+{
+	int error = radix_tree_preload(gfp_mask & ~__GFP_HIGHMEM);
+
+	if (error == 0) {
+		int locked;
+
+		/*
+		 * Lockless lookups may find the page as soon as it is in
+		 * the tree: it must be ready for them, locked, before that.
+		 */
+		page_cache_get(page);
+		locked = TestSetPageLocked(page);
+		page->mapping = mapping;
+		page->index = offset;
+
+		spin_lock_irq(&mapping->tree_lock);
+		error = page_cache_tree_insert(mapping, page, shadowp);
+		spin_unlock_irq(&mapping->tree_lock);
+		radix_tree_preload_end();
+
+		if (unlikely(error)) {
+			page->mapping = NULL;
+			if (!locked)
+				ClearPageLocked(page);
+			page_cache_release(page);
+		}
+	}
+	return error;
+}
+
 /*
  * This function is used to add newly allocated pagecache pages:
  * the page is new, so we can just run SetPageLocked() against it.
@@ -379,36 +456,118 @@ int filemap_write_and_wait_range(struct address_space *mapping,
 int add_to_page_cache(struct page *page, struct address_space *mapping,
 		pgoff_t offset, int gfp_mask)
 {
-	int error = radix_tree_preload(gfp_mask & ~__GFP_HIGHMEM);
-
-	if (error == 0) {
-		write_lock_irq(&mapping->tree_lock);
-		error = radix_tree_insert(&mapping->page_tree, offset, page);
-		if (!error) {
-			page_cache_get(page);
-			SetPageLocked(page);
-			page->mapping = mapping;
-			page->index = offset;
-			mapping->nrpages++;
-			pagecache_acct(1);
-		}
-		write_unlock_irq(&mapping->tree_lock);
-		radix_tree_preload_end();
-	}
-	return error;
+	return __add_to_page_cache(page, mapping, offset, gfp_mask, NULL);
 }
 
 EXPORT_SYMBOL(add_to_page_cache);
 
+/*
+ * Like add_to_page_cache(), and puts the page on the LRU: on the active
+ * list straight away if it was evicted recently enough to be part of
+ * the working set, see mm/workingset.c.
+ */
 int add_to_page_cache_lru(struct page *page, struct address_space *mapping,
 				pgoff_t offset, int gfp_mask)
 {
-	int ret = add_to_page_cache(page, mapping, offset, gfp_mask);
-	if (ret == 0)
-		lru_cache_add(page);
+	void *shadow = NULL;
+	int ret;
+
+	ret = __add_to_page_cache(page, mapping, offset, gfp_mask, &shadow);
+	if (ret == 0) {
+		if (shadow && workingset_refault(shadow)) {
+			lru_cache_add_active(page);
+			workingset_activation(page);
+		} else
+			lru_cache_add(page);
+	}
 	return ret;
 }
 
+/**
+ * add_to_page_cache_lru_vec - add a batch of new pages to the page cache
+ *
+ * @mapping: the address_space to add the pages to
+ * @pages: list of new pages with their ->index set, taken from the tail
+ * @nr_pages: the number of pages on @pages
+ * @pvec: empty pagevec where the pages added are returned
+ * @gfp_mask: allocation mode for the radix tree nodes
+ *
+ * Does add_to_page_cache_lru() on up to PAGEVEC_SIZE pages of @pages,
+ * under one hold of the tree_lock and with one pass over the LRU lock,
+ * which is what readahead wants for its large batches of pages.  The
+ * pages added are returned locked in @pvec, with the caller's reference
+ * still held; the others (already cached, or out of memory) are freed.
+ *
+ * Returns the number of pages taken off @pages.
+ */
+unsigned add_to_page_cache_lru_vec(struct address_space *mapping,
+		struct list_head *pages, unsigned nr_pages,
+		struct pagevec *pvec, int gfp_mask)
+{
+	struct page *batch[PAGEVEC_SIZE];
+	void *shadows[PAGEVEC_SIZE];
+	int errors[PAGEVEC_SIZE];
+	struct pagevec lru_pvec;
+	unsigned i, nr;
+
+	nr = min_t(unsigned, nr_pages, PAGEVEC_SIZE);
+	for (i = 0; i < nr; i++) {
+		struct page *page = list_entry(pages->prev, struct page, lru);
+
+		list_del(&page->lru);
+		/* Ready for lockless lookups, see __add_to_page_cache */
+		page_cache_get(page);
+		SetPageLocked(page);
+		page->mapping = mapping;
+		batch[i] = page;
+		shadows[i] = NULL;
+	}
+
+	i = 0;
+	while (i < nr) {
+		if (radix_tree_preload(gfp_mask & ~__GFP_HIGHMEM)) {
+			while (i < nr)
+				errors[i++] = -ENOMEM;
+			break;
+		}
+		spin_lock_irq(&mapping->tree_lock);
+		for (; i < nr; i++) {
+			errors[i] = page_cache_tree_insert(mapping, batch[i],
+							   &shadows[i]);
+			/* Out of preloaded nodes: refill, without the lock */
+			if (errors[i] == -ENOMEM)
+				break;
+		}
+		spin_unlock_irq(&mapping->tree_lock);
+		radix_tree_preload_end();
+	}
+
+	pagevec_init(&lru_pvec, 0);
+	for (i = 0; i < nr; i++) {
+		struct page *page = batch[i];
+
+		if (errors[i]) {
+			page->mapping = NULL;
+			ClearPageLocked(page);
+			__put_page(page);		/* the pagecache ref */
+			page_cache_release(page);	/* and the caller's */
+			continue;
+		}
+		if (shadows[i] && workingset_refault(shadows[i])) {
+			lru_cache_add_active(page);
+			workingset_activation(page);
+		} else {
+			page_cache_get(page);
+			if (!pagevec_add(&lru_pvec, page))
+				__pagevec_lru_add(&lru_pvec);
+		}
+		pagevec_add(pvec, page);
+	}
+	pagevec_lru_add(&lru_pvec);
+	return nr;
+}
+EXPORT_SYMBOL(add_to_page_cache_lru_vec);
+
 /*
  * In order to wait for pages to become available there must be
  * waitqueues associated with pages. By using a hash table of
@@ -500,16 +659,37 @@ EXPORT_SYMBOL(__lock_page);
 /*
  * a rather lightweight function, finding and getting a reference to a
  * hashed page atomically.
+ *
+ * It does not take the tree_lock: the page is looked up under
+ * rcu_read_lock(), and only kept if it is still in its slot once the
+ * reference is taken.
  */
 struct page * find_get_page(struct address_space *mapping, unsigned long offset)
 {
+	void **pagep;
 	struct page *page;
 
-	read_lock_irq(&mapping->tree_lock);
-	page = radix_tree_lookup(&mapping->page_tree, offset);
-	if (page)
-		page_cache_get(page);
-	read_unlock_irq(&mapping->tree_lock);
+	rcu_read_lock();
+repeat:
+	page = NULL;
+	pagep = radix_tree_lookup_slot(&mapping->page_tree, offset);
+	if (pagep) {
+		page = radix_tree_deref_slot(pagep);
+		if (unlikely(!page || radix_tree_exceptional_entry(page))) {
+			page = NULL;
+			goto out;
+		}
+		if (!page_cache_get_speculative(page))
+			goto repeat;
+
+		/* Has the page moved, or been freed and reused? */
+		if (unlikely(page != *pagep)) {
+			page_cache_release(page);
+			goto repeat;
+		}
+	}
+out:
+	rcu_read_unlock();
 	return page;
 }
 
@@ -522,11 +702,13 @@ struct page *find_trylock_page(struct address_space *mapping, unsigned long offs
 {
 	struct page *page;
 
-	read_lock_irq(&mapping->tree_lock);
+	spin_lock_irq(&mapping->tree_lock);
 	page = radix_tree_lookup(&mapping->page_tree, offset);
+	if (page && radix_tree_exceptional_entry(page))
+		page = NULL;
 	if (page && TestSetPageLocked(page))
 		page = NULL;
-	read_unlock_irq(&mapping->tree_lock);
+	spin_unlock_irq(&mapping->tree_lock);
 	return page;
 }
 
@@ -548,25 +730,18 @@ struct page *find_lock_page(struct address_space *mapping,
 {
 	struct page *page;
 
-	read_lock_irq(&mapping->tree_lock);
 repeat:
-	page = radix_tree_lookup(&mapping->page_tree, offset);
+	page = find_get_page(mapping, offset);
 	if (page) {
-		page_cache_get(page);
-		if (TestSetPageLocked(page)) {
-			read_unlock_irq(&mapping->tree_lock);
-			lock_page(page);
-			read_lock_irq(&mapping->tree_lock);
-
-			/* Has the page been truncated while we slept? */
-			if (page->mapping != mapping || page->index != offset) {
-				unlock_page(page);
-				page_cache_release(page);
-				goto repeat;
-			}
+		lock_page(page);
+		/* Has the page been truncated? */
+		if (unlikely(page->mapping != mapping ||
+			     page->index != offset)) {
+			unlock_page(page);
+			page_cache_release(page);
+			goto repeat;
 		}
 	}
-	read_unlock_irq(&mapping->tree_lock);
 	return page;
 }
 
@@ -633,19 +808,52 @@ EXPORT_SYMBOL(find_or_create_page);
  * indexes.  There may be holes in the indices due to not-present pages.
  *
  * find_get_pages() returns the number of pages which were found.
+ *
+ * Like find_get_page(), it runs under rcu_read_lock() alone: a page
+ * which goes away meanwhile is just left out.
  */
 unsigned find_get_pages(struct address_space *mapping, pgoff_t start,
 			    unsigned int nr_pages, struct page **pages)
 {
 	unsigned int i;
 	unsigned int ret;
+	unsigned int nr_found;
+
+	rcu_read_lock();
+restart:
+	nr_found = radix_tree_gang_lookup_slot(&mapping->page_tree,
+				(void ***)pages, start, nr_pages);
+	ret = 0;
+	for (i = 0; i < nr_found; i++) {
+		void **slot = (void **)pages[i];
+		struct page *page;
+repeat:
+		page = radix_tree_deref_slot(slot);
+		if (unlikely(!page))
+			continue;
+		/* Replaced by a shadow entry since the lookup */
+		if (unlikely(radix_tree_exceptional_entry(page)))
+			continue;
+		if (!page_cache_get_speculative(page))
+			goto repeat;
 
-	read_lock_irq(&mapping->tree_lock);
-	ret = radix_tree_gang_lookup(&mapping->page_tree,
-				(void **)pages, start, nr_pages);
-	for (i = 0; i < ret; i++)
-		page_cache_get(pages[i]);
-	read_unlock_irq(&mapping->tree_lock);
+		/* Has the page moved? */
+		if (unlikely(page != *slot)) {
+			page_cache_release(page);
+			goto repeat;
+		}
+
+		pages[ret] = page;
+		ret++;
+	}
+
+	/*
+	 * Every page found went away: there may be more further on, look
+	 * again rather than return nothing, which callers take for the end.
+	 */
+	if (unlikely(!ret && nr_found))
+		goto restart;
+	rcu_read_unlock();
 	return ret;
 }
 
@@ -659,14 +867,14 @@ unsigned find_get_pages_tag(struct address_space *mapping, pgoff_t *index,
 	unsigned int i;
 	unsigned int ret;
 
-	read_lock_irq(&mapping->tree_lock);
+	spin_lock_irq(&mapping->tree_lock);
 	ret = radix_tree_gang_lookup_tag(&mapping->page_tree,
 				(void **)pages, *index, nr_pages, tag);
 	for (i = 0; i < ret; i++)
 		page_cache_get(pages[i]);
 	if (ret)
 		*index = pages[ret - 1]->index + 1;
-	read_unlock_irq(&mapping->tree_lock);
+	spin_unlock_irq(&mapping->tree_lock);
 	return ret;
 }
 
@@ -725,7 +933,6 @@ void do_generic_mapping_read(struct address_space *mapping,
 	unsigned long end_index;
 	unsigned long offset;
 	unsigned long last_index;
-	unsigned long next_index;
 	unsigned long prev_index;
 	loff_t isize;
 	struct page *cached_page;
@@ -734,7 +941,6 @@ void do_generic_mapping_read(struct address_space *mapping,
 
 	cached_page = NULL;
 	index = *ppos >> PAGE_CACHE_SHIFT;
-	next_index = index;
 	prev_index = ra.prev_page;
 	last_index = (*ppos + desc->count + PAGE_CACHE_SIZE-1) >> PAGE_CACHE_SHIFT;
 	offset = *ppos & ~PAGE_CACHE_MASK;
@@ -761,16 +967,19 @@ void do_generic_mapping_read(struct address_space *mapping,
 		nr = nr - offset;
 
 		cond_resched();
-		if (index == next_index)
-			next_index = page_cache_readahead(mapping, &ra, filp,
-					index, last_index - index);
-
 find_page:
 		page = find_get_page(mapping, index);
-		if (unlikely(page == NULL)) {
-			handle_ra_miss(mapping, &ra, index);
-			goto no_cached_page;
-		}
+		if (!page) {
+			page_cache_sync_readahead(mapping, &ra, filp,
+					index, last_index - index);
+			page = find_get_page(mapping, index);
+			if (unlikely(page == NULL))
+				goto no_cached_page;
+		} else
+			inc_page_state(file_ra_hit);
+		if (PageReadahead(page))
+			page_cache_async_readahead(mapping, &ra, filp, page,
+					index, last_index - index);
 		if (!PageUptodate(page))
 			goto page_not_up_to_date;
 page_ok:
@@ -911,6 +1120,7 @@ no_cached_page:
 	}
 
 out:
+	ra.prev_page = prev_index;
 	*_ra = ra;
 
 	*ppos = ((loff_t) index << PAGE_CACHE_SHIFT) + offset;
@@ -1207,27 +1417,32 @@ retry_all:
 	if (VM_RandomReadHint(area))
 		goto no_cached_page;
 
-	/*
-	 * The readahead code wants to be told about each and every page
-	 * so it can build and shrink its windows appropriately
-	 *
-	 * For sequential accesses, we use the generic readahead logic.
-	 */
-	if (VM_SequentialReadHint(area))
-		page_cache_readahead(mapping, ra, file, pgoff, 1);
-
 	/*
 	 * Do we have something in the page cache already?
 	 */
 retry_find:
 	page = find_get_page(mapping, pgoff);
+	if (page)
+		inc_page_state(file_ra_hit);
+
+	/*
+	 * For sequential accesses, we use the generic readahead logic.
+	 */
+	if (VM_SequentialReadHint(area)) {
+		if (!page) {
+			page_cache_sync_readahead(mapping, ra, file, pgoff, 1);
+			page = find_get_page(mapping, pgoff);
+			if (!page)
+				goto no_cached_page;
+		}
+		if (PageReadahead(page))
+			page_cache_async_readahead(mapping, ra, file, page,
+						   pgoff, 1);
+	}
+
 	if (!page) {
 		unsigned long ra_pages;
 
-		if (VM_SequentialReadHint(area)) {
-			handle_ra_miss(mapping, ra, pgoff);
-			goto no_cached_page;
-		}
 		ra->mmap_miss++;
 
 		/*
@@ -1374,6 +1589,86 @@ page_not_uptodate:
 
 EXPORT_SYMBOL(filemap_nopage);
 
+/**
+ * filemap_map_pages - map the cached pages around a read fault
+ * @vma: the vma of the fault
+ * @start: the first address of the window around it
+ * @end: the end of the window
+ * @pte: the pte of @start
+ *
+ * Maps the pages of the window which are uptodate in the page cache
+ * and not locked, where the pte is still none; the rest is left to
+ * ->nopage.  Called with the page_table_lock held, and @pte mapped:
+ * truncation cannot unmap the window before we are done with it.
+ */
+void filemap_map_pages(struct vm_area_struct *vma, unsigned long start,
+		       unsigned long end, pte_t *pte)
+{
+	struct address_space *mapping = vma->vm_file->f_mapping;
+	struct mm_struct *mm = vma->vm_mm;
+	struct page *pages[PAGEVEC_SIZE];
+	pgoff_t first, pgoff, last, size;
+	unsigned int i, nr;
+
+	first = ((start - vma->vm_start) >> PAGE_SHIFT) + vma->vm_pgoff;
+	last = first + ((end - start) >> PAGE_SHIFT);
+	size = (i_size_read(mapping->host) + PAGE_CACHE_SIZE - 1) >>
+			PAGE_CACHE_SHIFT;
+	if (last > size)
+		last = size;
+
+	for (pgoff = first; pgoff < last; ) {
+		nr = find_get_pages(mapping, pgoff,
+				    min_t(pgoff_t, PAGEVEC_SIZE, last - pgoff),
+				    pages);
+		if (!nr)
+			break;
+		for (i = 0; i < nr; i++) {
+			struct page *page = pages[i];
+			unsigned long addr;
+			pte_t *ptep, entry;
+
+			/* The page may be gone by the end of this iteration */
+			pgoff = page->index + 1;
+			if (page->index >= last)
+				goto skip;
+			addr = start + ((page->index - first) << PAGE_SHIFT);
+			ptep = pte + (page->index - first);
+			/* Marked pages are left to the fault, for readahead */
+			if (!pte_none(*ptep) || !PageUptodate(page) ||
+			    PageReadahead(page))
+				goto skip;
+			if (TestSetPageLocked(page))
+				goto skip;
+			/*
+			 * Truncated or invalidated under us?  i_size is
+			 * lowered before truncate takes the page lock, so
+			 * check it again now that we hold that.
+			 */
+			size = (i_size_read(mapping->host) + PAGE_CACHE_SIZE - 1)
+					>> PAGE_CACHE_SHIFT;
+			if (page->mapping != mapping || !PageUptodate(page) ||
+			    page->index >= size) {
+				unlock_page(page);
+				goto skip;
+			}
+
+			inc_mm_counter(mm, rss);
+			flush_icache_page(vma, page);
+			/* Not accessed yet: let reclaim tell if it is */
+			entry = pte_mkold(mk_pte(page, vma->vm_page_prot));
+			set_pte_at(mm, addr, ptep, entry);
+			page_add_file_rmap(page);
+			update_mmu_cache(vma, addr, entry);
+			lazy_mmu_prot_update(entry);
+			unlock_page(page);
+			continue;
+skip:
+			page_cache_release(page);
+		}
+	}
+}
+
 static struct page * filemap_getpage(struct file *file, unsigned long pgoff,
 					int nonblock)
 {
@@ -1541,6 +1836,7 @@ repeat:
 struct vm_operations_struct generic_file_vm_ops = {
 	.nopage		= filemap_nopage,
 	.populate	= filemap_populate,
+	.map_pages	= filemap_map_pages,
 };
 
 /* This is used for a general mmap of a disk file */
@@ -0,0 +1,958 @@
+/*
+ * mm/huge_memory.c - transparent huge pages for anonymous memory
+ *
+ * An aligned, large enough private anonymous range is mapped with a
+ * single huge pmd at fault time.  The pmd maps HPAGE_PMD_NR ordinary
+ * small pages which come from one HPAGE_PMD_ORDER allocation split into
+ * independent pages: each keeps its own count, mapcount and anon rmap
+ * and sits on the LRU by itself, so that only the page tables know
+ * about the huge mapping.
+ *
+ * Anything which wants to deal with the single pages of a huge pmd
+ * (mprotect, a partial munmap or mremap, breaking COW, and reclaim or
+ * migration unmapping one of the pages) splits the pmd into a page
+ * table of small ptes first.  The page table for that is allocated when
+ * the huge pmd is set up and kept on mm->pmd_huge_pte until then, so a
+ * split never has to allocate memory.
+ *
+ * khugepaged scans the mms which had eligible vmas and collapses page
+ * tables, mapped with small pages because no huge page was free at
+ * fault time or because of a split, back into huge pmds.
+ *
+ * The policy is set in /sys/kernel/mm/transparent_hugepage.
+ */
+
+#include <linux/mm.h>
+#include <linux/huge_mm.h>
+#include <linux/ksm.h>
+#include <linux/highmem.h>
+#include <linux/mman.h>
+#include <linux/rmap.h>
+#include <linux/swap.h>
+#include <linux/sched.h>
+#include <linux/module.h>
+#include <linux/kobject.h>
+#include <linux/sysfs.h>
+#include <linux/init.h>
+
+#include <asm/pgalloc.h>
+#include <asm/tlb.h>
+#include <asm/tlbflush.h>
+#include "internal.h"
+
+enum transparent_hugepage_flag {
+	TRANSPARENT_HUGEPAGE_ALWAYS,
+	TRANSPARENT_HUGEPAGE_MADVISE,
+	TRANSPARENT_HUGEPAGE_NEVER,
+};
+
+static int transparent_hugepage_enabled = TRANSPARENT_HUGEPAGE_ALWAYS;
+
+/* khugepaged tunables and statistics */
+static unsigned int khugepaged_pages_to_scan = HPAGE_PMD_NR * 8;
+static unsigned int khugepaged_scan_sleep_millisecs = 10000;
+static unsigned int khugepaged_max_ptes_none = HPAGE_PMD_NR - 1;
+static unsigned int khugepaged_pages_collapsed;
+static unsigned int khugepaged_full_scans;
+
+/*
+ * The mms khugepaged scans, each holding a reference on mm_count.  The
+ * scan cursor is the mm and address khugepaged will continue at.
+ */
+static DEFINE_SPINLOCK(khugepaged_mm_lock);
+static LIST_HEAD(khugepaged_mm_head);
+static struct mm_struct *khugepaged_scan_mm;
+static unsigned long khugepaged_scan_address;
+
+/* A huge pmd needs a page table to be split into: keep it with the mm */
+static void pgtable_deposit(struct mm_struct *mm, struct page *pgtable)
+{
+	list_add(&pgtable->lru, &mm->pmd_huge_pte);
+}
+
+static struct page *pgtable_withdraw(struct mm_struct *mm)
+{
+	struct page *pgtable;
+
+	BUG_ON(list_empty(&mm->pmd_huge_pte));
+	pgtable = list_entry(mm->pmd_huge_pte.next, struct page, lru);
+	list_del(&pgtable->lru);
+	return pgtable;
+}
+
+static inline struct page *huge_pmd_page(pmd_t pmd)
+{
+	return pfn_to_page(pmd_pfn(pmd));
+}
+
+static inline pmd_t maybe_pmd_mkwrite(pmd_t pmd, struct vm_area_struct *vma)
+{
+	if (likely(vma->vm_flags & VM_WRITE))
+		pmd = pmd_mkwrite(pmd);
+	return pmd;
+}
+
+static struct page *alloc_hugepage(gfp_t gfp_mask)
+{
+	struct page *page;
+
+	page = alloc_pages(gfp_mask | __GFP_NOWARN, HPAGE_PMD_ORDER);
+	if (page)
+		split_page(page, HPAGE_PMD_ORDER);
+	return page;
+}
+
+static void free_hugepage(struct page *page)
+{
+	int i;
+
+	for (i = 0; i < HPAGE_PMD_NR; i++)
+		__free_page(page + i);
+}
+
+static int hugepage_vma_check(struct vm_area_struct *vma)
+{
+	if (vma->vm_flags & VM_NOHUGEPAGE)
+		return 0;
+	if (transparent_hugepage_enabled == TRANSPARENT_HUGEPAGE_NEVER)
+		return 0;
+	if (transparent_hugepage_enabled == TRANSPARENT_HUGEPAGE_MADVISE &&
+	    !(vma->vm_flags & VM_HUGEPAGE))
+		return 0;
+
+	/* Private anonymous memory only */
+	if (vma->vm_file || vma->vm_ops)
+		return 0;
+	if (vma->vm_flags & (VM_SHARED | VM_MAYSHARE | VM_HUGETLB |
+			     VM_IO | VM_RESERVED | VM_NONLINEAR))
+		return 0;
+	return 1;
+}
+
+/**
+ * transparent_hugepage_vma - may a huge pmd map @address in @vma?
+ * @vma: the vma faulted on
+ * @address: the faulting address
+ *
+ * The whole aligned huge page range around @address has to be inside
+ * the vma, and the vma has to be one the policy allows huge pages in.
+ */
+int transparent_hugepage_vma(struct vm_area_struct *vma,
+			     unsigned long address)
+{
+	unsigned long haddr = address & HPAGE_PMD_MASK;
+
+	if (haddr < vma->vm_start || haddr + HPAGE_PMD_SIZE > vma->vm_end)
+		return 0;
+	return hugepage_vma_check(vma);
+}
+
+/*
+ * Map a fresh huge page at the none pmd @pmd.  Called with the
+ * page_table_lock held, which is dropped unless VM_FAULT_FALLBACK is
+ * returned.
+ */
+int do_huge_pmd_anonymous_page(struct mm_struct *mm, struct vm_area_struct *vma,
+			       unsigned long address, pmd_t *pmd,
+			       int write_access)
+{
+	unsigned long haddr = address & HPAGE_PMD_MASK;
+	struct page *page, *pgtable;
+	pmd_t entry;
+	int i;
+
+	spin_unlock(&mm->page_table_lock);
+
+	if (unlikely(anon_vma_prepare(vma)))
+		return VM_FAULT_OOM;
+
+	/* Whatever happens now, khugepaged may find work in this mm */
+	khugepaged_enter(mm);
+
+	page = alloc_hugepage(GFP_HIGHUSER_MOVABLE | __GFP_NORETRY);
+	if (!page) {
+		inc_page_state(thp_fault_fallback);
+		spin_lock(&mm->page_table_lock);
+		return VM_FAULT_FALLBACK;
+	}
+	pgtable = pte_alloc_one(mm, haddr);
+	if (!pgtable) {
+		free_hugepage(page);
+		return VM_FAULT_OOM;
+	}
+	for (i = 0; i < HPAGE_PMD_NR; i++)
+		clear_user_highpage(page + i, haddr + i * PAGE_SIZE);
+
+	spin_lock(&mm->page_table_lock);
+	if (unlikely(!pmd_none(*pmd))) {
+		/* A sibling thread was faster, let the access retry */
+		spin_unlock(&mm->page_table_lock);
+		pte_free(pgtable);
+		free_hugepage(page);
+		return VM_FAULT_MINOR;
+	}
+
+	entry = mk_huge_pmd(page, vma->vm_page_prot);
+	if (write_access)
+		entry = maybe_pmd_mkwrite(pmd_mkdirty(entry), vma);
+	for (i = 0; i < HPAGE_PMD_NR; i++) {
+		SetPageSwapBacked(page + i);
+		lru_cache_add_active(page + i);
+		page_add_anon_rmap(page + i, vma, haddr + i * PAGE_SIZE);
+	}
+	add_mm_counter(mm, rss, HPAGE_PMD_NR);
+	set_pmd(pmd, entry);
+	pgtable_deposit(mm, pgtable);
+	inc_page_state(nr_page_table_pages);
+	spin_unlock(&mm->page_table_lock);
+
+	inc_page_state(thp_fault_alloc);
+	return VM_FAULT_MINOR;
+}
+
+/* Does nobody but this huge pmd map its pages? */
+static int huge_pmd_exclusive(pmd_t pmd)
+{
+	struct page *page = huge_pmd_page(pmd);
+	int i;
+
+	for (i = 0; i < HPAGE_PMD_NR; i++) {
+		if (PageSwapCache(page + i) || page_mapcount(page + i) != 1)
+			return 0;
+	}
+	return 1;
+}
+
+/*
+ * Fault on the huge pmd @pmd.  Called with the page_table_lock held,
+ * which is dropped unless VM_FAULT_FALLBACK is returned.
+ */
+int do_huge_pmd_fault(struct mm_struct *mm, struct vm_area_struct *vma,
+		      unsigned long address, pmd_t *pmd, int write_access)
+{
+	pmd_t entry = *pmd;
+
+	if (write_access) {
+		if (!pmd_write(entry)) {
+			/*
+			 * Write to a huge pmd shared since fork: it can be
+			 * made writable once the other side has gone away,
+			 * otherwise copy on write page by page.
+			 */
+			if (!(vma->vm_flags & VM_WRITE) ||
+			    !huge_pmd_exclusive(entry)) {
+				__split_huge_pmd(mm, pmd, address);
+				return VM_FAULT_FALLBACK;
+			}
+			entry = pmd_mkwrite(entry);
+		}
+		entry = pmd_mkyoung(pmd_mkdirty(entry));
+		set_pmd(pmd, entry);
+		flush_tlb_page(vma, address);
+	}
+	spin_unlock(&mm->page_table_lock);
+	return VM_FAULT_MINOR;
+}
+
+/*
+ * Copy the huge pmd at @src_pmd for fork: called with the child's
+ * page_table_lock held.  Returns -EAGAIN if @src_pmd is, or has been,
+ * split and is to be copied as a page table.
+ */
+int copy_huge_pmd(struct mm_struct *dst_mm, struct mm_struct *src_mm,
+		  pmd_t *dst_pmd, pmd_t *src_pmd, unsigned long addr,
+		  unsigned long end)
+{
+	struct page *page, *pgtable = NULL;
+	pmd_t pmd;
+	int i, ret = -EAGAIN;
+
+	/* Only part of the huge pmd is inside the vma: copy small ptes */
+	if (end - addr == HPAGE_PMD_SIZE) {
+		spin_unlock(&dst_mm->page_table_lock);
+		pgtable = pte_alloc_one(dst_mm, addr);
+		spin_lock(&dst_mm->page_table_lock);
+		if (!pgtable)
+			return -ENOMEM;
+	}
+
+	spin_lock(&src_mm->page_table_lock);
+	pmd = *src_pmd;
+	if (unlikely(!pmd_trans_huge(pmd)))
+		goto out_unlock;
+	if (!pgtable) {
+		__split_huge_pmd(src_mm, src_pmd, addr);
+		goto out_unlock;
+	}
+
+	/* Both sides share the pages until a write breaks COW */
+	pmdp_set_wrprotect(src_mm, addr, src_pmd);
+	pmd = pmd_mkold(pmd_wrprotect(pmd));
+	page = huge_pmd_page(pmd);
+	for (i = 0; i < HPAGE_PMD_NR; i++) {
+		get_page(page + i);
+		page_dup_rmap(page + i);
+	}
+	add_mm_counter(dst_mm, rss, HPAGE_PMD_NR);
+	add_mm_counter(dst_mm, anon_rss, HPAGE_PMD_NR);
+	set_pmd(dst_pmd, pmd);
+	pgtable_deposit(dst_mm, pgtable);
+	inc_page_state(nr_page_table_pages);
+	pgtable = NULL;
+	ret = 0;
+
+	khugepaged_enter(dst_mm);
+out_unlock:
+	spin_unlock(&src_mm->page_table_lock);
+	if (pgtable)
+		pte_free(pgtable);
+	return ret;
+}
+
+/*
+ * Unmap the whole of the huge pmd @pmd: called with the page_table_lock
+ * held, the pages are freed after the tlb flush like small ones.
+ */
+void zap_huge_pmd(struct mmu_gather *tlb, pmd_t *pmd)
+{
+	struct mm_struct *mm = tlb->mm;
+	struct page *page = huge_pmd_page(*pmd);
+	int i;
+
+	pmd_clear(pmd);
+	for (i = 0; i < HPAGE_PMD_NR; i++) {
+		page_remove_rmap(page + i);
+		tlb->freed++;
+		tlb_remove_page(tlb, page + i);
+	}
+	add_mm_counter(mm, anon_rss, -HPAGE_PMD_NR);
+	pte_free(pgtable_withdraw(mm));
+	dec_page_state(nr_page_table_pages);
+}
+
+/*
+ * follow_page() for a huge pmd.  This may run without the
+ * page_table_lock, from interrupt context even: look at the pmd once.
+ */
+struct page *follow_trans_huge_pmd(pmd_t *pmd, unsigned long address,
+				   int write, int accessed)
+{
+	pmd_t pmdval = *pmd;
+	struct page *page;
+
+	barrier();
+	if (!pmd_trans_huge(pmdval))
+		return NULL;
+	if (write && !pmd_write(pmdval))
+		return NULL;
+
+	page = huge_pmd_page(pmdval) +
+		((address & ~HPAGE_PMD_MASK) >> PAGE_SHIFT);
+	if (accessed) {
+		if (write && !pmd_dirty(pmdval) && !PageDirty(page))
+			set_page_dirty(page);
+		mark_page_accessed(page);
+	}
+	return page;
+}
+
+/**
+ * __split_huge_pmd - map the pages of a huge pmd with small ptes
+ * @mm: the mm of the huge pmd
+ * @pmd: the huge pmd
+ * @address: any address inside the range @pmd maps
+ *
+ * Called with the page_table_lock held.  The page table deposited when
+ * the huge pmd was set up is filled with ptes of the same protection
+ * and then replaces the huge pmd.
+ */
+void __split_huge_pmd(struct mm_struct *mm, pmd_t *pmd, unsigned long address)
+{
+	unsigned long haddr = address & HPAGE_PMD_MASK;
+	pmd_t entry, _pmd;
+	struct page *page, *pgtable;
+	pgprot_t prot;
+	pte_t *pte;
+	int i;
+
+	BUG_ON(!pmd_trans_huge(*pmd));
+
+	/*
+	 * The tlb must never hold the huge and a small translation at
+	 * once: clear and flush the huge pmd before the ptes go in.
+	 * Faults meanwhile wait for the page_table_lock.
+	 */
+	entry = pmdp_get_and_clear(mm, haddr, pmd);
+	flush_tlb_mm(mm);
+
+	page = huge_pmd_page(entry);
+	prot = pmd_pgprot(entry);
+	pgtable = pgtable_withdraw(mm);
+
+	pmd_populate(mm, &_pmd, pgtable);
+	pte = pte_offset_map(&_pmd, haddr);
+	for (i = 0; i < HPAGE_PMD_NR; i++)
+		set_pte_at(mm, haddr + i * PAGE_SIZE, pte + i,
+			   mk_pte(page + i, prot));
+	pte_unmap(pte);
+	pmd_populate(mm, pmd, pgtable);
+	mm->nr_ptes++;
+
+	inc_page_state(thp_split);
+}
+
+/*
+ * Does the huge pmd @pmd map @page at @address?
+ */
+int huge_pmd_maps_page(pmd_t *pmd, unsigned long address, struct page *page)
+{
+	return huge_pmd_page(*pmd) +
+		((address & ~HPAGE_PMD_MASK) >> PAGE_SHIFT) == page;
+}
+
+/*
+ * Split the huge pmd @pmd if it maps @page at @address: for the rmap
+ * walkers, which are about to deal with @page alone.  Called with the
+ * page_table_lock held.
+ */
+void split_huge_pmd_page(struct mm_struct *mm, pmd_t *pmd,
+			 unsigned long address, struct page *page)
+{
+	if (huge_pmd_maps_page(pmd, address, page))
+		__split_huge_pmd(mm, pmd, address);
+}
+
+/*
+ * Test and clear the young bit of a huge pmd, for page_referenced():
+ * aging leaves the pmd huge.  Called with the page_table_lock held.
+ */
+int pmdp_clear_flush_young(struct vm_area_struct *vma,
+			   unsigned long address, pmd_t *pmd)
+{
+	int young;
+
+	young = pmdp_test_and_clear_young(vma, address, pmd);
+	if (young)
+		flush_tlb_page(vma, address & HPAGE_PMD_MASK);
+	return young;
+}
+
+int hugepage_madvise(struct vm_area_struct *vma, unsigned long *vm_flags,
+		     int advice)
+{
+	switch (advice) {
+	case MADV_HUGEPAGE:
+		/* Only what the fault path could back with huge pages */
+		if (vma->vm_file || vma->vm_ops ||
+		    (*vm_flags & (VM_SHARED | VM_MAYSHARE | VM_HUGETLB |
+				  VM_IO | VM_RESERVED | VM_NONLINEAR)))
+			return -EINVAL;
+		*vm_flags &= ~VM_NOHUGEPAGE;
+		*vm_flags |= VM_HUGEPAGE;
+		khugepaged_enter(vma->vm_mm);
+		break;
+	case MADV_NOHUGEPAGE:
+		*vm_flags &= ~VM_HUGEPAGE;
+		*vm_flags |= VM_NOHUGEPAGE;
+		break;
+	}
+	return 0;
+}
+
+/*
+ * khugepaged
+ */
+
+/* Set once mmput() dropped the last user: exit_mmap() is on its way */
+static inline int khugepaged_test_exit(struct mm_struct *mm)
+{
+	return atomic_read(&mm->mm_users) == 0;
+}
+
+/**
+ * khugepaged_enter - have khugepaged scan @mm
+ * @mm: an mm with vmas which may be backed by huge pages
+ */
+void khugepaged_enter(struct mm_struct *mm)
+{
+	if (!list_empty(&mm->khugepaged_list))
+		return;
+
+	spin_lock(&khugepaged_mm_lock);
+	if (list_empty(&mm->khugepaged_list)) {
+		atomic_inc(&mm->mm_count);
+		list_add_tail(&mm->khugepaged_list, &khugepaged_mm_head);
+	}
+	spin_unlock(&khugepaged_mm_lock);
+}
+
+/**
+ * khugepaged_exit - stop khugepaged scanning @mm
+ * @mm: the mm mmput() dropped the last user of
+ *
+ * If khugepaged is scanning @mm right now, it leaves the mm to the next
+ * scan, but it may still be working under mmap_sem: wait for that, so
+ * that exit_mmap() can tear down the page tables.
+ */
+void khugepaged_exit(struct mm_struct *mm)
+{
+	int free = 0;
+
+	spin_lock(&khugepaged_mm_lock);
+	if (!list_empty(&mm->khugepaged_list) && khugepaged_scan_mm != mm) {
+		list_del_init(&mm->khugepaged_list);
+		free = 1;
+	}
+	spin_unlock(&khugepaged_mm_lock);
+
+	if (free)
+		mmdrop(mm);
+	else if (!list_empty(&mm->khugepaged_list)) {
+		down_write(&mm->mmap_sem);
+		up_write(&mm->mmap_sem);
+	}
+}
+
+/*
+ * Check the page table of @pmd for being worth and able to collapse:
+ * all ptes map exclusive anonymous pages, but up to max_ptes_none which
+ * may be none or the zero page, and some were recently referenced.
+ * Call with the page_table_lock held.
+ */
+static int khugepaged_check_ptes(pte_t *pte, unsigned long haddr,
+				 int referenced_needed)
+{
+	int i, none = 0, referenced = 0;
+
+	for (i = 0; i < HPAGE_PMD_NR; i++) {
+		pte_t pteval = pte[i];
+		struct page *page;
+
+		if (pte_none(pteval) ||
+		    (pte_present(pteval) && pte_pfn(pteval) ==
+		     page_to_pfn(ZERO_PAGE(haddr + i * PAGE_SIZE)))) {
+			if (++none > khugepaged_max_ptes_none)
+				return 0;
+			continue;
+		}
+		if (!pte_present(pteval) || !pfn_valid(pte_pfn(pteval)))
+			return 0;
+		page = pfn_to_page(pte_pfn(pteval));
+		if (!PageAnon(page) || PageKsm(page) || PageSwapCache(page) ||
+		    PageLocked(page) || page_mapcount(page) != 1)
+			return 0;
+		if (pte_young(pteval) || PageReferenced(page))
+			referenced = 1;
+	}
+	return referenced || !referenced_needed;
+}
+
+static pmd_t *khugepaged_find_pmd(struct mm_struct *mm, unsigned long address)
+{
+	pgd_t *pgd;
+	pud_t *pud;
+	pmd_t *pmd;
+
+	pgd = pgd_offset(mm, address);
+	if (!pgd_present(*pgd))
+		return NULL;
+	pud = pud_offset(pgd, address);
+	if (!pud_present(*pud))
+		return NULL;
+	pmd = pmd_offset(pud, address);
+	if (!pmd_present(*pmd) || pmd_trans_huge(*pmd))
+		return NULL;
+	return pmd;
+}
+
+/*
+ * Replace the page table of the huge page range at @haddr by a huge pmd
+ * mapping copies of its pages.  Entered with mmap_sem held for reading
+ * and returns with it released: the collapse takes it for writing,
+ * which keeps out faults and all other page table walkers but rmap.
+ */
+static void collapse_huge_page(struct mm_struct *mm, unsigned long haddr)
+{
+	struct vm_area_struct *vma;
+	struct page *new_page, *pgtable;
+	pmd_t *pmd, _pmd, entry;
+	pte_t *pte;
+	int i, none = 0;
+
+	up_read(&mm->mmap_sem);
+
+	new_page = alloc_hugepage(GFP_HIGHUSER_MOVABLE);
+	if (!new_page)
+		return;
+	inc_page_state(thp_collapse_alloc);
+
+	/* The pages may sit in the pagevecs with an extra count */
+	lru_add_drain();
+
+	down_write(&mm->mmap_sem);
+	if (khugepaged_test_exit(mm))
+		goto out;
+	vma = find_vma(mm, haddr);
+	if (!vma || !transparent_hugepage_vma(vma, haddr))
+		goto out;
+	pmd = khugepaged_find_pmd(mm, haddr);
+	if (!pmd)
+		goto out;
+
+	spin_lock(&mm->page_table_lock);
+	/*
+	 * Detach the page table first: no cpu may write to the pages while
+	 * they are copied, and rmap will not find them meanwhile.
+	 */
+	_pmd = *pmd;
+	pmd_clear(pmd);
+	flush_tlb_mm(mm);
+
+	pte = pte_offset_map(&_pmd, haddr);
+	if (!khugepaged_check_ptes(pte, haddr, 0))
+		goto out_restore;
+	for (i = 0; i < HPAGE_PMD_NR; i++) {
+		pte_t pteval = pte[i];
+		struct page *page;
+
+		if (pte_none(pteval))
+			continue;
+		page = pfn_to_page(pte_pfn(pteval));
+		if (page != ZERO_PAGE(haddr + i * PAGE_SIZE) &&
+		    page_count(page) != 1)
+			goto out_restore;
+	}
+
+	for (i = 0; i < HPAGE_PMD_NR; i++) {
+		unsigned long address = haddr + i * PAGE_SIZE;
+		pte_t pteval = pte[i];
+		struct page *page;
+
+		if (pte_none(pteval) ||
+		    (page = pfn_to_page(pte_pfn(pteval))) == ZERO_PAGE(address)) {
+			clear_user_highpage(new_page + i, address);
+			pte_clear(mm, address, pte + i);
+			none++;
+			continue;
+		}
+		copy_user_highpage(new_page + i, page, address);
+		pte_clear(mm, address, pte + i);
+		page_remove_rmap(page);
+		put_page(page);
+	}
+	pte_unmap(pte);
+
+	/* The emptied page table is kept for splitting the new pmd */
+	pgtable = pmd_page(_pmd);
+	pgtable_deposit(mm, pgtable);
+	mm->nr_ptes--;
+
+	entry = mk_huge_pmd(new_page, vma->vm_page_prot);
+	entry = maybe_pmd_mkwrite(pmd_mkdirty(entry), vma);
+	for (i = 0; i < HPAGE_PMD_NR; i++) {
+		SetPageSwapBacked(new_page + i);
+		lru_cache_add_active(new_page + i);
+		page_add_anon_rmap(new_page + i, vma, haddr + i * PAGE_SIZE);
+	}
+	/* page_add_anon_rmap() counted all the new pages as anon_rss */
+	add_mm_counter(mm, rss, none);
+	add_mm_counter(mm, anon_rss, none - HPAGE_PMD_NR);
+	set_pmd(pmd, entry);
+	spin_unlock(&mm->page_table_lock);
+
+	khugepaged_pages_collapsed++;
+	new_page = NULL;
+	goto out;
+
+out_restore:
+	pte_unmap(pte);
+	set_pmd(pmd, _pmd);
+	spin_unlock(&mm->page_table_lock);
+out:
+	up_write(&mm->mmap_sem);
+	if (new_page)
+		free_hugepage(new_page);
+}
+
+/*
+ * Scan the next part of the mm at the scan cursor, up to @pages pages.
+ * Returns the number of pages scanned.
+ */
+static unsigned int khugepaged_scan_mm_slot(unsigned int pages)
+{
+	struct mm_struct *mm = khugepaged_scan_mm;
+	unsigned long address = khugepaged_scan_address;
+	struct vm_area_struct *vma = NULL;
+	unsigned int progress = 0;
+	int collapse = 0;
+
+	down_read(&mm->mmap_sem);
+	if (!khugepaged_test_exit(mm))
+		vma = find_vma(mm, address);
+
+	for (; vma; vma = vma->vm_next) {
+		unsigned long hstart, hend;
+
+		cond_resched();
+		if (!hugepage_vma_check(vma)) {
+			progress++;
+			continue;
+		}
+		hstart = (vma->vm_start + ~HPAGE_PMD_MASK) & HPAGE_PMD_MASK;
+		hend = vma->vm_end & HPAGE_PMD_MASK;
+		if (address < hstart)
+			address = hstart;
+		for (; address < hend; address += HPAGE_PMD_SIZE) {
+			pmd_t *pmd;
+
+			if (progress >= pages)
+				goto out;
+			progress += HPAGE_PMD_NR;
+
+			pmd = khugepaged_find_pmd(mm, address);
+			if (!pmd)
+				continue;
+			spin_lock(&mm->page_table_lock);
+			if (pmd_present(*pmd) && !pmd_trans_huge(*pmd)) {
+				pte_t *pte = pte_offset_map(pmd, address);
+
+				collapse = khugepaged_check_ptes(pte, address, 1);
+				pte_unmap(pte);
+			}
+			spin_unlock(&mm->page_table_lock);
+			if (collapse) {
+				/* Drops mmap_sem */
+				collapse_huge_page(mm, address);
+				address += HPAGE_PMD_SIZE;
+				goto out_unlocked;
+			}
+		}
+	}
+out:
+	up_read(&mm->mmap_sem);
+out_unlocked:
+	spin_lock(&khugepaged_mm_lock);
+	khugepaged_scan_address = address;
+	if (!vma || khugepaged_test_exit(mm)) {
+		/* Done with this mm: go on with the next one */
+		if (mm->khugepaged_list.next != &khugepaged_mm_head) {
+			khugepaged_scan_mm = list_entry(mm->khugepaged_list.next,
+						struct mm_struct, khugepaged_list);
+		} else {
+			khugepaged_scan_mm = NULL;
+			khugepaged_full_scans++;
+		}
+		khugepaged_scan_address = 0;
+		if (khugepaged_test_exit(mm)) {
+			list_del_init(&mm->khugepaged_list);
+			spin_unlock(&khugepaged_mm_lock);
+			mmdrop(mm);
+			return progress;
+		}
+	}
+	spin_unlock(&khugepaged_mm_lock);
+	return progress;
+}
+
+static void khugepaged_do_scan(void)
+{
+	unsigned int progress = 0;
+
+	while (progress < khugepaged_pages_to_scan) {
+		spin_lock(&khugepaged_mm_lock);
+		if (!khugepaged_scan_mm) {
+			if (list_empty(&khugepaged_mm_head)) {
+				spin_unlock(&khugepaged_mm_lock);
+				break;
+			}
+			khugepaged_scan_mm = list_entry(khugepaged_mm_head.next,
+						struct mm_struct, khugepaged_list);
+			khugepaged_scan_address = 0;
+		}
+		spin_unlock(&khugepaged_mm_lock);
+
+		progress += khugepaged_scan_mm_slot(khugepaged_pages_to_scan -
+						    progress);
+		cond_resched();
+	}
+}
+
+static int khugepaged(void *unused)
+{
+	daemonize("khugepaged");
+	set_user_nice(current, 19);
+
+	for ( ; ; ) {
+		try_to_freeze();
+		if (transparent_hugepage_enabled != TRANSPARENT_HUGEPAGE_NEVER)
+			khugepaged_do_scan();
+		schedule_timeout_interruptible(
+			msecs_to_jiffies(khugepaged_scan_sleep_millisecs));
+	}
+	return 0;
+}
+
+/*
+ * /sys/kernel/mm/transparent_hugepage
+ */
+
+#define HUGEPAGE_ATTR_RO(_name) \
+static struct subsys_attribute _name##_attr = __ATTR_RO(_name)
+
+#define HUGEPAGE_ATTR_RW(_name) \
+static struct subsys_attribute _name##_attr = \
+	__ATTR(_name, 0644, _name##_show, _name##_store)
+
+static const char *enabled_names[] = {
+	[TRANSPARENT_HUGEPAGE_ALWAYS]	= "always",
+	[TRANSPARENT_HUGEPAGE_MADVISE]	= "madvise",
+	[TRANSPARENT_HUGEPAGE_NEVER]	= "never",
+};
+
+static ssize_t enabled_show(struct subsystem *subsys, char *page)
+{
+	char *p = page;
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(enabled_names); i++) {
+		if (i == transparent_hugepage_enabled)
+			p += sprintf(p, "[%s] ", enabled_names[i]);
+		else
+			p += sprintf(p, "%s ", enabled_names[i]);
+	}
+	p[-1] = '\n';
+	return p - page;
+}
+
+static ssize_t enabled_store(struct subsystem *subsys, const char *page,
+			     size_t count)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(enabled_names); i++) {
+		int len = strlen(enabled_names[i]);
+
+		if (!strncmp(page, enabled_names[i], len) &&
+		    (count == len || (count == len + 1 && page[len] == '\n'))) {
+			transparent_hugepage_enabled = i;
+			return count;
+		}
+	}
+	return -EINVAL;
+}
+HUGEPAGE_ATTR_RW(enabled);
+
+static struct attribute *hugepage_attrs[] = {
+	&enabled_attr.attr,
+	NULL
+};
+
+static struct attribute_group hugepage_attr_group = {
+	.attrs = hugepage_attrs,
+};
+
+static ssize_t khugepaged_store_uint(const char *page, size_t count,
+				     unsigned int *value, unsigned int max)
+{
+	char *end;
+	unsigned long val = simple_strtoul(page, &end, 10);
+
+	if (end == page || (*end && *end != '\n') || val > max)
+		return -EINVAL;
+	*value = val;
+	return count;
+}
+
+static ssize_t pages_to_scan_show(struct subsystem *subsys, char *page)
+{
+	return sprintf(page, "%u\n", khugepaged_pages_to_scan);
+}
+
+static ssize_t pages_to_scan_store(struct subsystem *subsys, const char *page,
+				   size_t count)
+{
+	ssize_t ret;
+
+	ret = khugepaged_store_uint(page, count, &khugepaged_pages_to_scan,
+				    UINT_MAX);
+	if (ret > 0 && !khugepaged_pages_to_scan)
+		khugepaged_pages_to_scan = HPAGE_PMD_NR;
+	return ret;
+}
+HUGEPAGE_ATTR_RW(pages_to_scan);
+
+static ssize_t scan_sleep_millisecs_show(struct subsystem *subsys, char *page)
+{
+	return sprintf(page, "%u\n", khugepaged_scan_sleep_millisecs);
+}
+
+static ssize_t scan_sleep_millisecs_store(struct subsystem *subsys,
+					  const char *page, size_t count)
+{
+	return khugepaged_store_uint(page, count,
+				     &khugepaged_scan_sleep_millisecs,
+				     UINT_MAX);
+}
+HUGEPAGE_ATTR_RW(scan_sleep_millisecs);
+
+static ssize_t max_ptes_none_show(struct subsystem *subsys, char *page)
+{
+	return sprintf(page, "%u\n", khugepaged_max_ptes_none);
+}
+
+static ssize_t max_ptes_none_store(struct subsystem *subsys, const char *page,
+				   size_t count)
+{
+	return khugepaged_store_uint(page, count, &khugepaged_max_ptes_none,
+				     HPAGE_PMD_NR - 1);
+}
+HUGEPAGE_ATTR_RW(max_ptes_none);
+
+static ssize_t pages_collapsed_show(struct subsystem *subsys, char *page)
+{
+	return sprintf(page, "%u\n", khugepaged_pages_collapsed);
+}
+HUGEPAGE_ATTR_RO(pages_collapsed);
+
+static ssize_t full_scans_show(struct subsystem *subsys, char *page)
+{
+	return sprintf(page, "%u\n", khugepaged_full_scans);
+}
+HUGEPAGE_ATTR_RO(full_scans);
+
+static struct attribute *khugepaged_attrs[] = {
+	&pages_to_scan_attr.attr,
+	&scan_sleep_millisecs_attr.attr,
+	&max_ptes_none_attr.attr,
+	&pages_collapsed_attr.attr,
+	&full_scans_attr.attr,
+	NULL
+};
+
+static struct attribute_group khugepaged_attr_group = {
+	.name = "khugepaged",
+	.attrs = khugepaged_attrs,
+};
+
+static decl_subsys(transparent_hugepage, NULL, NULL);
+
+static int __init hugepage_init(void)
+{
+	int err;
+
+	transparent_hugepage_subsys.kset.kobj.parent = &mm_subsys.kset.kobj;
+	err = subsystem_register(&transparent_hugepage_subsys);
+	if (!err)
+		err = sysfs_create_group(&transparent_hugepage_subsys.kset.kobj,
+					 &hugepage_attr_group);
+	if (!err)
+		err = sysfs_create_group(&transparent_hugepage_subsys.kset.kobj,
+					 &khugepaged_attr_group);
+	if (err)
+		printk(KERN_ERR "hugepage: cannot register sysfs files\n");
+
+	kernel_thread(khugepaged, NULL, CLONE_KERNEL);
+	return 0;
+}
+
+module_init(hugepage_init)
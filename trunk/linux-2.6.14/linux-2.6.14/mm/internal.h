@@ -11,3 +11,14 @@
 
 /* page_alloc.c */
 extern void set_page_refs(struct page *page, int order);
+extern int get_pageblock_migratetype(struct page *page);
+extern int isolate_free_block(struct zone *zone, struct page *page,
+			      struct list_head *list);
+extern void split_page(struct page *page, unsigned int order);
+
+/* vmscan.c */
+extern void rescue_unevictable_page(struct page *page);
+
+/* mlock.c */
+extern void munlock_vma_pages_range(struct vm_area_struct *vma,
+				    unsigned long start, unsigned long end);
@@ -0,0 +1,1297 @@
+/*
+ * mm/ksm.c - merging of identical anonymous pages
+ *
+ * An application marks anonymous areas which are likely to hold the
+ * same data as in other processes, virtual machine guest memory for
+ * one, with madvise(MADV_MERGEABLE).  The ksmd thread goes through the
+ * pages of those areas, and replaces identical pages by a single write
+ * protected KSM page: a write to it breaks COW in do_wp_page() as after
+ * fork(), and the writer gets a private copy back.
+ *
+ * Pages are compared by content, in two red-black trees.  The stable
+ * tree holds the KSM pages, which cannot change.  The unstable tree
+ * holds the other pages whose checksum stayed the same since the last
+ * scan, and may be inconsistent as their contents change, so it is
+ * thrown away and built again on every full scan.  A page found in the
+ * stable tree is merged into the KSM page there; a page found in the
+ * unstable tree is merged with that page, which becomes a new KSM page
+ * in the stable tree.
+ *
+ * Each page ksmd looks at has an rmap_item, which records where it is
+ * mapped.  The rmap_items of the mappings of a KSM page are listed on
+ * its stable_node, which page->mapping points to instead of an anon_vma:
+ * page_referenced() finds the ptes of a KSM page through them.  KSM pages
+ * are not swapped out or migrated: the stable_node holds a reference on
+ * its page until no process maps it anymore.
+ *
+ * The policy is set in /sys/kernel/mm/ksm.
+ */
+
+#include <linux/mm.h>
+#include <linux/ksm.h>
+#include <linux/mman.h>
+#include <linux/rmap.h>
+#include <linux/highmem.h>
+#include <linux/pagemap.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/rbtree.h>
+#include <linux/jhash.h>
+#include <linux/wait.h>
+#include <linux/kobject.h>
+#include <linux/sysfs.h>
+#include <linux/init.h>
+#include <linux/module.h>
+
+#include <asm/semaphore.h>
+#include <asm/tlbflush.h>
+
+/**
+ * struct rmap_item - a page ksmd looked at
+ * @rmap_list: next rmap_item of the same mm, by address
+ * @mm: the mm the page is mapped into
+ * @address: its user address, with the flags below in the low bits
+ * @oldchecksum: the checksum of the page at the last scan
+ * @node: its node in the unstable tree
+ * @head: the stable_node of the KSM page mapped at @address
+ * @hlist: its entry on the list of @head
+ */
+struct rmap_item {
+	struct rmap_item *rmap_list;
+	struct mm_struct *mm;
+	unsigned long address;
+	unsigned int oldchecksum;
+	union {
+		struct rb_node node;
+		struct {
+			struct stable_node *head;
+			struct hlist_node hlist;
+		};
+	};
+};
+
+#define SEQNR_MASK	0x0ff	/* low bits of the scan an item was added in */
+#define UNSTABLE_FLAG	0x100	/* the item is in the unstable tree */
+#define STABLE_FLAG	0x200	/* the item is on a stable_node's list */
+
+/**
+ * struct stable_node - a KSM page in the stable tree
+ * @node: its node in the stable tree
+ * @hlist: the rmap_items of the ptes which map it
+ * @page: the KSM page, which the stable_node holds a reference on
+ */
+struct stable_node {
+	struct rb_node node;
+	struct hlist_head hlist;
+	struct page *page;
+};
+
+/*
+ * The scan cursor: the mm and address ksmd continues at, where the
+ * rmap_item for that address goes on the mm's list, and the number of
+ * the current full scan.
+ */
+struct ksm_scan {
+	struct mm_struct *mm;
+	unsigned long address;
+	struct rmap_item **rmap_list;
+	unsigned long seqnr;
+};
+
+static struct rb_root root_stable_tree = RB_ROOT;
+static struct rb_root root_unstable_tree = RB_ROOT;
+
+static struct ksm_scan ksm_scan;
+
+static kmem_cache_t *rmap_item_cache;
+static kmem_cache_t *stable_node_cache;
+
+/*
+ * The mms ksmd scans, each holding a reference on mm_count: ksm_exit()
+ * leaves an mm with rmap_items to ksmd, which frees them.
+ */
+static DEFINE_SPINLOCK(ksm_mmlist_lock);
+static LIST_HEAD(ksm_mm_head);
+
+/*
+ * ksm_lock guards the rmap_item lists of the stable nodes and the
+ * page->mapping of KSM pages against page_referenced_ksm().  Only ksmd
+ * changes the trees, so it walks them without a lock.
+ */
+static DEFINE_SPINLOCK(ksm_lock);
+
+/* Statistics */
+static unsigned long ksm_pages_shared;		/* KSM pages in use */
+static unsigned long ksm_pages_sharing;		/* more ptes mapping them */
+static unsigned long ksm_pages_unshared;	/* pages in the unstable tree */
+static unsigned long ksm_rmap_items;		/* pages ksmd looked at */
+static unsigned int ksm_full_scans;
+
+/* Tunables */
+static unsigned int ksm_thread_pages_to_scan = 100;
+static unsigned int ksm_thread_sleep_millisecs = 20;
+
+#define KSM_RUN_STOP	0
+#define KSM_RUN_MERGE	1
+#define KSM_RUN_UNMERGE	2
+static unsigned int ksm_run = KSM_RUN_STOP;
+
+static DECLARE_WAIT_QUEUE_HEAD(ksm_thread_wait);
+static DECLARE_MUTEX(ksm_thread_sem);
+
+/* Set once mmput() dropped the last user: exit_mmap() is on its way */
+static inline int ksm_test_exit(struct mm_struct *mm)
+{
+	return atomic_read(&mm->mm_users) == 0;
+}
+
+static inline struct rmap_item *alloc_rmap_item(void)
+{
+	struct rmap_item *rmap_item;
+
+	rmap_item = kmem_cache_alloc(rmap_item_cache, GFP_KERNEL);
+	if (rmap_item) {
+		memset(rmap_item, 0, sizeof(*rmap_item));
+		ksm_rmap_items++;
+	}
+	return rmap_item;
+}
+
+static inline void free_rmap_item(struct rmap_item *rmap_item)
+{
+	ksm_rmap_items--;
+	kmem_cache_free(rmap_item_cache, rmap_item);
+}
+
+static inline int in_stable_tree(struct rmap_item *rmap_item)
+{
+	return rmap_item->address & STABLE_FLAG;
+}
+
+static unsigned int calc_checksum(struct page *page)
+{
+	void *addr = kmap_atomic(page, KM_USER0);
+	unsigned int checksum;
+
+	checksum = jhash2(addr, PAGE_SIZE / 4, 17);
+	kunmap_atomic(addr, KM_USER0);
+	return checksum;
+}
+
+static int memcmp_pages(struct page *page1, struct page *page2)
+{
+	char *addr1, *addr2;
+	int ret;
+
+	addr1 = kmap_atomic(page1, KM_USER0);
+	addr2 = kmap_atomic(page2, KM_USER1);
+	ret = memcmp(addr1, addr2, PAGE_SIZE);
+	kunmap_atomic(addr2, KM_USER1);
+	kunmap_atomic(addr1, KM_USER0);
+	return ret;
+}
+
+/*
+ * The vma at @addr, if ksmd may merge its pages.  Call with mmap_sem
+ * held, after checking that the mm is not exiting.
+ */
+static struct vm_area_struct *find_mergeable_vma(struct mm_struct *mm,
+						 unsigned long addr)
+{
+	struct vm_area_struct *vma;
+
+	vma = find_vma(mm, addr);
+	if (!vma || vma->vm_start > addr)
+		return NULL;
+	if (!(vma->vm_flags & VM_MERGEABLE) || !vma->anon_vma)
+		return NULL;
+	return vma;
+}
+
+/*
+ * Unshare the KSM page mapped at @addr, if there is one, by faking a
+ * write fault on it.  Call with mmap_sem held.
+ */
+static int break_ksm(struct vm_area_struct *vma, unsigned long addr)
+{
+	struct page *page;
+	int ksm, ret;
+
+	for (;;) {
+		cond_resched();
+		page = follow_page_get(vma->vm_mm, addr);
+		if (!page)
+			return 0;
+		ksm = PageKsm(page);
+		put_page(page);
+		if (!ksm)
+			return 0;
+
+		ret = __handle_mm_fault(vma->vm_mm, vma, addr, 1);
+		if (ret & VM_FAULT_WRITE)
+			return 0;
+		if (ret == VM_FAULT_OOM)
+			return -ENOMEM;
+		if (ret == VM_FAULT_SIGBUS)
+			return 0;
+	}
+}
+
+static void break_cow(struct rmap_item *rmap_item)
+{
+	struct mm_struct *mm = rmap_item->mm;
+	unsigned long addr = rmap_item->address & PAGE_MASK;
+	struct vm_area_struct *vma;
+
+	down_read(&mm->mmap_sem);
+	if (!ksm_test_exit(mm)) {
+		vma = find_mergeable_vma(mm, addr);
+		if (vma)
+			break_ksm(vma, addr);
+	}
+	up_read(&mm->mmap_sem);
+}
+
+/*
+ * The anonymous page the rmap_item of an unstable tree node maps now,
+ * with a reference held, or NULL.
+ */
+static struct page *get_mergeable_page(struct rmap_item *rmap_item)
+{
+	struct mm_struct *mm = rmap_item->mm;
+	unsigned long addr = rmap_item->address & PAGE_MASK;
+	struct page *page = NULL;
+
+	down_read(&mm->mmap_sem);
+	if (!ksm_test_exit(mm) && find_mergeable_vma(mm, addr)) {
+		page = follow_page_get(mm, addr);
+		if (page && !PageAnon(page)) {
+			put_page(page);
+			page = NULL;
+		}
+	}
+	up_read(&mm->mmap_sem);
+	return page;
+}
+
+/*
+ * Take an rmap_item out of the tree it is in, and clear its flags.
+ */
+static void remove_rmap_item_from_tree(struct rmap_item *rmap_item)
+{
+	if (rmap_item->address & STABLE_FLAG) {
+		struct stable_node *stable_node = rmap_item->head;
+
+		spin_lock(&ksm_lock);
+		hlist_del(&rmap_item->hlist);
+		spin_unlock(&ksm_lock);
+
+		if (stable_node->hlist.first)
+			ksm_pages_sharing--;
+		else
+			ksm_pages_shared--;
+	} else if (rmap_item->address & UNSTABLE_FLAG) {
+		unsigned char age;
+
+		/*
+		 * The unstable tree is thrown away at the start of each
+		 * full scan: only erase the items added during this one.
+		 */
+		age = (unsigned char)(ksm_scan.seqnr - rmap_item->address);
+		BUG_ON(age > 1);
+		if (!age)
+			rb_erase(&rmap_item->node, &root_unstable_tree);
+		ksm_pages_unshared--;
+	}
+	rmap_item->address &= PAGE_MASK;
+	cond_resched();
+}
+
+static void remove_trailing_rmap_items(struct rmap_item **rmap_list)
+{
+	while (*rmap_list) {
+		struct rmap_item *rmap_item = *rmap_list;
+
+		*rmap_list = rmap_item->rmap_list;
+		remove_rmap_item_from_tree(rmap_item);
+		free_rmap_item(rmap_item);
+	}
+}
+
+/*
+ * Free a stable node whose page no process maps anymore.  Only ksmd maps
+ * KSM pages again, so the page stays unmapped and is freed when the
+ * reference the node holds goes.
+ */
+static void remove_node_from_stable_tree(struct stable_node *stable_node)
+{
+	struct page *page = stable_node->page;
+	struct rmap_item *rmap_item;
+	struct hlist_node *hlist, *tmp;
+
+	lock_page(page);
+	spin_lock(&ksm_lock);
+	hlist_for_each_entry_safe(rmap_item, hlist, tmp, &stable_node->hlist,
+				  hlist) {
+		if (rmap_item->hlist.next)
+			ksm_pages_sharing--;
+		else
+			ksm_pages_shared--;
+		hlist_del(&rmap_item->hlist);
+		rmap_item->address &= PAGE_MASK;
+	}
+	page->mapping = NULL;
+	spin_unlock(&ksm_lock);
+	unlock_page(page);
+
+	rb_erase(&stable_node->node, &root_stable_tree);
+	put_page(page);
+	kmem_cache_free(stable_node_cache, stable_node);
+}
+
+static void ksm_gc_stable_tree(void)
+{
+	struct rb_node *node = rb_first(&root_stable_tree);
+
+	while (node) {
+		struct stable_node *stable_node;
+
+		stable_node = rb_entry(node, struct stable_node, node);
+		node = rb_next(node);
+		if (!page_mapped(stable_node->page))
+			remove_node_from_stable_tree(stable_node);
+	}
+}
+
+/*
+ * Make the pte mapping @page in @vma read only and clean, and return it
+ * in @orig_pte, for the page to be compared and merged.  Fails if there
+ * are references to the page which do not come from ptes or from the
+ * swap cache: somebody, O_DIRECT for one, may still write to it.
+ */
+static int write_protect_page(struct vm_area_struct *vma, struct page *page,
+			      pte_t *orig_pte)
+{
+	struct mm_struct *mm = vma->vm_mm;
+	unsigned long addr;
+	pte_t *ptep, entry;
+	int err = -EFAULT;
+
+	addr = page_address_in_vma(page, vma);
+	if (addr == -EFAULT)
+		goto out;
+
+	ptep = page_check_address(page, mm, addr);
+	if (IS_ERR(ptep))
+		goto out;
+
+	if (pte_write(*ptep) || pte_dirty(*ptep)) {
+		int swapped = PageSwapCache(page);
+
+		flush_cache_page(vma, addr, page_to_pfn(page));
+		/* Clear the pte first, so no cpu can write through it */
+		entry = ptep_clear_flush(vma, addr, ptep);
+		/* Our reference from scanning is the one extra */
+		if (page_mapcount(page) + 1 + swapped != page_count(page)) {
+			set_pte_at(mm, addr, ptep, entry);
+			goto out_unlock;
+		}
+		if (pte_dirty(entry))
+			set_page_dirty(page);
+		entry = pte_mkclean(pte_wrprotect(entry));
+		set_pte_at(mm, addr, ptep, entry);
+	}
+	*orig_pte = *ptep;
+	err = 0;
+
+out_unlock:
+	pte_unmap(ptep);
+	spin_unlock(&mm->page_table_lock);
+out:
+	return err;
+}
+
+/*
+ * Map @kpage instead of @page in @vma, if the pte is still @orig_pte.
+ */
+static int replace_page(struct vm_area_struct *vma, struct page *page,
+			struct page *kpage, pte_t orig_pte)
+{
+	struct mm_struct *mm = vma->vm_mm;
+	unsigned long addr;
+	pgd_t *pgd;
+	pud_t *pud;
+	pmd_t *pmd;
+	pte_t *ptep, entry;
+	int err = -EFAULT;
+
+	addr = page_address_in_vma(page, vma);
+	if (addr == -EFAULT)
+		goto out;
+
+	spin_lock(&mm->page_table_lock);
+	pgd = pgd_offset(mm, addr);
+	if (!pgd_present(*pgd))
+		goto out_unlock;
+	pud = pud_offset(pgd, addr);
+	if (!pud_present(*pud))
+		goto out_unlock;
+	pmd = pmd_offset(pud, addr);
+	if (!pmd_present(*pmd) || pmd_trans_huge(*pmd))
+		goto out_unlock;
+
+	ptep = pte_offset_map(pmd, addr);
+	if (!pte_same(*ptep, orig_pte)) {
+		pte_unmap(ptep);
+		goto out_unlock;
+	}
+
+	/* The KSM page may have been unmapped everywhere else meanwhile */
+	get_page(kpage);
+	if (atomic_inc_and_test(&kpage->_mapcount))
+		inc_page_state(nr_mapped);
+
+	flush_cache_page(vma, addr, pte_pfn(*ptep));
+	ptep_clear_flush(vma, addr, ptep);
+	entry = pte_wrprotect(mk_pte(kpage, vma->vm_page_prot));
+	set_pte_at(mm, addr, ptep, entry);
+	update_mmu_cache(vma, addr, entry);
+	lazy_mmu_prot_update(entry);
+
+	page_remove_rmap(page);
+	put_page(page);
+
+	pte_unmap(ptep);
+	err = 0;
+out_unlock:
+	spin_unlock(&mm->page_table_lock);
+out:
+	return err;
+}
+
+/*
+ * Merge @page, mapped in @vma, into @kpage; or with a NULL @kpage turn
+ * @page itself into a KSM page, which stable_tree_insert() then gives
+ * its stable_node.  Returns 0 on success.
+ */
+static int try_to_merge_one_page(struct vm_area_struct *vma,
+				 struct page *page, struct page *kpage)
+{
+	pte_t orig_pte = __pte(0);
+	int err = -EFAULT;
+
+	/* A forked mapping of the KSM page itself */
+	if (page == kpage)
+		return 0;
+
+	if (!PageAnon(page) || PageKsm(page))
+		goto out;
+	if (TestSetPageLocked(page))
+		goto out;
+
+	/*
+	 * A new KSM page loses its anon_vma, so its other mappings could
+	 * not be found anymore; and it must not keep a swap slot.
+	 */
+	if (!kpage && (page_mapcount(page) != 1 || PageSwapCache(page)))
+		goto out_unlock;
+
+	if (write_protect_page(vma, page, &orig_pte) == 0) {
+		if (!kpage) {
+			/* Keeps do_wp_page() from reusing the page */
+			spin_lock(&ksm_lock);
+			set_page_stable_node(page, NULL);
+			spin_unlock(&ksm_lock);
+			err = 0;
+		} else if (!memcmp_pages(page, kpage))
+			err = replace_page(vma, page, kpage, orig_pte);
+	}
+
+out_unlock:
+	unlock_page(page);
+out:
+	return err;
+}
+
+static int try_to_merge_with_ksm_page(struct rmap_item *rmap_item,
+				      struct page *page, struct page *kpage)
+{
+	struct mm_struct *mm = rmap_item->mm;
+	struct vm_area_struct *vma;
+	int err = -EFAULT;
+
+	down_read(&mm->mmap_sem);
+	if (!ksm_test_exit(mm)) {
+		vma = find_mergeable_vma(mm, rmap_item->address & PAGE_MASK);
+		if (vma)
+			err = try_to_merge_one_page(vma, page, kpage);
+	}
+	up_read(&mm->mmap_sem);
+	return err;
+}
+
+/*
+ * Make @page a KSM page and merge @tree_page into it.  Returns the new
+ * KSM page, or NULL when the pages could not be merged.
+ */
+static struct page *try_to_merge_two_pages(struct rmap_item *rmap_item,
+					   struct page *page,
+					   struct rmap_item *tree_rmap_item,
+					   struct page *tree_page)
+{
+	int err;
+
+	err = try_to_merge_with_ksm_page(rmap_item, page, NULL);
+	if (!err) {
+		err = try_to_merge_with_ksm_page(tree_rmap_item,
+						 tree_page, page);
+		if (err)
+			break_cow(rmap_item);
+	}
+	return err ? NULL : page;
+}
+
+static struct stable_node *stable_tree_search(struct page *page)
+{
+	struct rb_node *node = root_stable_tree.rb_node;
+
+	while (node) {
+		struct stable_node *stable_node;
+		int ret;
+
+		cond_resched();
+		stable_node = rb_entry(node, struct stable_node, node);
+		ret = memcmp_pages(page, stable_node->page);
+		if (ret < 0)
+			node = node->rb_left;
+		else if (ret > 0)
+			node = node->rb_right;
+		else
+			return stable_node;
+	}
+	return NULL;
+}
+
+/*
+ * Give the new, locked KSM page @kpage its stable_node.  Returns NULL if
+ * an identical KSM page is in the tree already, or on allocation failure.
+ */
+static struct stable_node *stable_tree_insert(struct page *kpage)
+{
+	struct rb_node **new = &root_stable_tree.rb_node;
+	struct rb_node *parent = NULL;
+	struct stable_node *stable_node;
+
+	while (*new) {
+		int ret;
+
+		cond_resched();
+		stable_node = rb_entry(*new, struct stable_node, node);
+		ret = memcmp_pages(kpage, stable_node->page);
+		parent = *new;
+		if (ret < 0)
+			new = &parent->rb_left;
+		else if (ret > 0)
+			new = &parent->rb_right;
+		else
+			return NULL;
+	}
+
+	stable_node = kmem_cache_alloc(stable_node_cache, GFP_KERNEL);
+	if (!stable_node)
+		return NULL;
+
+	rb_link_node(&stable_node->node, parent, new);
+	rb_insert_color(&stable_node->node, &root_stable_tree);
+	INIT_HLIST_HEAD(&stable_node->hlist);
+	get_page(kpage);
+	stable_node->page = kpage;
+
+	spin_lock(&ksm_lock);
+	set_page_stable_node(kpage, stable_node);
+	spin_unlock(&ksm_lock);
+	return stable_node;
+}
+
+static void stable_tree_append(struct rmap_item *rmap_item,
+			       struct stable_node *stable_node)
+{
+	spin_lock(&ksm_lock);
+	rmap_item->head = stable_node;
+	rmap_item->address |= STABLE_FLAG;
+	hlist_add_head(&rmap_item->hlist, &stable_node->hlist);
+	spin_unlock(&ksm_lock);
+
+	if (rmap_item->hlist.next)
+		ksm_pages_sharing++;
+	else
+		ksm_pages_shared++;
+}
+
+/*
+ * Look for a page identical to @page in the unstable tree.  Returns its
+ * rmap_item, with the page referenced in @tree_pagep; otherwise inserts
+ * @rmap_item into the tree and returns NULL.
+ */
+static struct rmap_item *unstable_tree_search_insert(struct rmap_item *rmap_item,
+						     struct page *page,
+						     struct page **tree_pagep)
+{
+	struct rb_node **new = &root_unstable_tree.rb_node;
+	struct rb_node *parent = NULL;
+
+	while (*new) {
+		struct rmap_item *tree_rmap_item;
+		struct page *tree_page;
+		int ret;
+
+		cond_resched();
+		tree_rmap_item = rb_entry(*new, struct rmap_item, node);
+		tree_page = get_mergeable_page(tree_rmap_item);
+		if (!tree_page)
+			return NULL;
+
+		/* The same page mapped twice in the mm: nothing to merge */
+		if (page == tree_page) {
+			put_page(tree_page);
+			return NULL;
+		}
+
+		ret = memcmp_pages(page, tree_page);
+		parent = *new;
+		if (ret < 0) {
+			put_page(tree_page);
+			new = &parent->rb_left;
+		} else if (ret > 0) {
+			put_page(tree_page);
+			new = &parent->rb_right;
+		} else {
+			*tree_pagep = tree_page;
+			return tree_rmap_item;
+		}
+	}
+
+	rmap_item->address |= UNSTABLE_FLAG;
+	rmap_item->address |= (ksm_scan.seqnr & SEQNR_MASK);
+	rb_link_node(&rmap_item->node, parent, new);
+	rb_insert_color(&rmap_item->node, &root_unstable_tree);
+	ksm_pages_unshared++;
+	return NULL;
+}
+
+/*
+ * Merge @page, which @rmap_item maps, into an identical KSM page, or
+ * with an identical page from the unstable tree.
+ */
+static void cmp_and_merge_page(struct page *page, struct rmap_item *rmap_item)
+{
+	struct rmap_item *tree_rmap_item;
+	struct stable_node *stable_node;
+	struct page *tree_page = NULL;
+	struct page *kpage;
+	unsigned int checksum;
+
+	remove_rmap_item_from_tree(rmap_item);
+
+	stable_node = stable_tree_search(page);
+	if (stable_node) {
+		if (!try_to_merge_with_ksm_page(rmap_item, page,
+						stable_node->page))
+			stable_tree_append(rmap_item, stable_node);
+		return;
+	}
+	if (PageKsm(page))
+		return;
+
+	/*
+	 * A page whose contents changed since the last scan is likely to
+	 * change again: it does not go into the unstable tree yet.
+	 */
+	checksum = calc_checksum(page);
+	if (rmap_item->oldchecksum != checksum) {
+		rmap_item->oldchecksum = checksum;
+		return;
+	}
+
+	tree_rmap_item = unstable_tree_search_insert(rmap_item, page,
+						     &tree_page);
+	if (!tree_rmap_item)
+		return;
+
+	kpage = try_to_merge_two_pages(rmap_item, page,
+				       tree_rmap_item, tree_page);
+	put_page(tree_page);
+	if (!kpage)
+		return;
+
+	remove_rmap_item_from_tree(tree_rmap_item);
+	lock_page(kpage);
+	stable_node = stable_tree_insert(kpage);
+	if (stable_node) {
+		stable_tree_append(tree_rmap_item, stable_node);
+		stable_tree_append(rmap_item, stable_node);
+	}
+	unlock_page(kpage);
+
+	/* Undo the merge when the KSM page cannot go into the tree */
+	if (!stable_node) {
+		break_cow(tree_rmap_item);
+		break_cow(rmap_item);
+	}
+}
+
+/*
+ * The rmap_item for @addr on the mm's address ordered list, freeing
+ * the items for addresses passed over: they map no anonymous page now.
+ */
+static struct rmap_item *get_next_rmap_item(struct mm_struct *mm,
+					    struct rmap_item **rmap_list,
+					    unsigned long addr)
+{
+	struct rmap_item *rmap_item;
+
+	while (*rmap_list) {
+		rmap_item = *rmap_list;
+		if ((rmap_item->address & PAGE_MASK) == addr)
+			return rmap_item;
+		if (rmap_item->address > addr)
+			break;
+		*rmap_list = rmap_item->rmap_list;
+		remove_rmap_item_from_tree(rmap_item);
+		free_rmap_item(rmap_item);
+	}
+
+	rmap_item = alloc_rmap_item();
+	if (rmap_item) {
+		rmap_item->mm = mm;
+		rmap_item->address = addr;
+		rmap_item->rmap_list = *rmap_list;
+		*rmap_list = rmap_item;
+	}
+	return rmap_item;
+}
+
+/*
+ * Move the scan cursor on to the next anonymous page in a mergeable
+ * vma.  Returns its rmap_item, with the page referenced in @page, or
+ * NULL at the end of a full scan.
+ */
+static struct rmap_item *scan_get_next_rmap_item(struct page **page)
+{
+	struct mm_struct *mm;
+	struct vm_area_struct *vma;
+	struct rmap_item *rmap_item;
+
+	mm = ksm_scan.mm;
+	if (!mm) {
+		root_unstable_tree = RB_ROOT;
+
+		spin_lock(&ksm_mmlist_lock);
+		if (list_empty(&ksm_mm_head)) {
+			spin_unlock(&ksm_mmlist_lock);
+			return NULL;
+		}
+		mm = list_entry(ksm_mm_head.next, struct mm_struct, ksm_list);
+		ksm_scan.mm = mm;
+		spin_unlock(&ksm_mmlist_lock);
+
+		ksm_scan.address = 0;
+		ksm_scan.rmap_list = &mm->ksm_rmap_list;
+	}
+
+	for (;;) {
+		down_read(&mm->mmap_sem);
+		if (ksm_test_exit(mm))
+			vma = NULL;
+		else
+			vma = find_vma(mm, ksm_scan.address);
+
+		for (; vma; vma = vma->vm_next) {
+			if (!(vma->vm_flags & VM_MERGEABLE))
+				continue;
+			if (ksm_scan.address < vma->vm_start)
+				ksm_scan.address = vma->vm_start;
+			if (!vma->anon_vma)
+				ksm_scan.address = vma->vm_end;
+
+			while (ksm_scan.address < vma->vm_end) {
+				if (ksm_test_exit(mm))
+					break;
+				*page = follow_page_get(mm, ksm_scan.address);
+				if (*page && PageAnon(*page)) {
+					rmap_item = get_next_rmap_item(mm,
+						ksm_scan.rmap_list,
+						ksm_scan.address);
+					if (rmap_item) {
+						ksm_scan.rmap_list =
+							&rmap_item->rmap_list;
+						ksm_scan.address += PAGE_SIZE;
+					} else
+						put_page(*page);
+					up_read(&mm->mmap_sem);
+					return rmap_item;
+				}
+				if (*page)
+					put_page(*page);
+				ksm_scan.address += PAGE_SIZE;
+				cond_resched();
+			}
+		}
+
+		/* An exiting mm loses all its rmap_items */
+		if (ksm_test_exit(mm))
+			ksm_scan.rmap_list = &mm->ksm_rmap_list;
+		remove_trailing_rmap_items(ksm_scan.rmap_list);
+
+		spin_lock(&ksm_mmlist_lock);
+		if (mm->ksm_list.next != &ksm_mm_head)
+			ksm_scan.mm = list_entry(mm->ksm_list.next,
+						 struct mm_struct, ksm_list);
+		else
+			ksm_scan.mm = NULL;
+		if (ksm_test_exit(mm)) {
+			list_del_init(&mm->ksm_list);
+			spin_unlock(&ksm_mmlist_lock);
+			up_read(&mm->mmap_sem);
+			mmdrop(mm);
+		} else {
+			spin_unlock(&ksm_mmlist_lock);
+			up_read(&mm->mmap_sem);
+		}
+
+		mm = ksm_scan.mm;
+		if (!mm)
+			break;
+		ksm_scan.address = 0;
+		ksm_scan.rmap_list = &mm->ksm_rmap_list;
+	}
+
+	/* A full scan is done: free the KSM pages nobody maps anymore */
+	ksm_gc_stable_tree();
+	ksm_scan.seqnr++;
+	ksm_full_scans++;
+	return NULL;
+}
+
+static void ksm_do_scan(unsigned int scan_npages)
+{
+	struct rmap_item *rmap_item;
+	struct page *page;
+
+	while (scan_npages--) {
+		cond_resched();
+		rmap_item = scan_get_next_rmap_item(&page);
+		if (!rmap_item)
+			return;
+		if (!PageKsm(page) || !in_stable_tree(rmap_item))
+			cmp_and_merge_page(page, rmap_item);
+		put_page(page);
+	}
+}
+
+static int ksmd_should_run(void)
+{
+	return (ksm_run & KSM_RUN_MERGE) && !list_empty(&ksm_mm_head);
+}
+
+static int ksm_scan_thread(void *unused)
+{
+	daemonize("ksmd");
+	set_user_nice(current, 5);
+
+	for ( ; ; ) {
+		try_to_freeze();
+
+		down(&ksm_thread_sem);
+		if (ksmd_should_run())
+			ksm_do_scan(ksm_thread_pages_to_scan);
+		up(&ksm_thread_sem);
+
+		if (ksmd_should_run())
+			schedule_timeout_interruptible(
+				msecs_to_jiffies(ksm_thread_sleep_millisecs));
+		else
+			wait_event_interruptible(ksm_thread_wait,
+						 ksmd_should_run());
+	}
+	return 0;
+}
+
+/*
+ * Unmerging
+ */
+
+static int unmerge_ksm_pages(struct vm_area_struct *vma,
+			     unsigned long start, unsigned long end)
+{
+	unsigned long addr;
+	int err = 0;
+
+	for (addr = start; addr < end && !err; addr += PAGE_SIZE) {
+		if (ksm_test_exit(vma->vm_mm))
+			break;
+		if (signal_pending(current))
+			err = -ERESTARTSYS;
+		else
+			err = break_ksm(vma, addr);
+	}
+	return err;
+}
+
+/*
+ * Unshare all KSM pages and forget all rmap_items, for "run" set to 2.
+ * Called with ksm_thread_sem held, so ksmd is not scanning.
+ */
+static int unmerge_and_remove_all_rmap_items(void)
+{
+	struct mm_struct *mm;
+	struct vm_area_struct *vma;
+	int err = 0;
+
+	spin_lock(&ksm_mmlist_lock);
+	if (list_empty(&ksm_mm_head))
+		ksm_scan.mm = NULL;
+	else
+		ksm_scan.mm = list_entry(ksm_mm_head.next,
+					 struct mm_struct, ksm_list);
+	spin_unlock(&ksm_mmlist_lock);
+
+	while ((mm = ksm_scan.mm) != NULL) {
+		down_read(&mm->mmap_sem);
+		for (vma = mm->mmap; vma; vma = vma->vm_next) {
+			if (ksm_test_exit(mm))
+				break;
+			if (!(vma->vm_flags & VM_MERGEABLE) || !vma->anon_vma)
+				continue;
+			err = unmerge_ksm_pages(vma, vma->vm_start,
+						vma->vm_end);
+			if (err) {
+				up_read(&mm->mmap_sem);
+				spin_lock(&ksm_mmlist_lock);
+				ksm_scan.mm = NULL;
+				spin_unlock(&ksm_mmlist_lock);
+				return err;
+			}
+		}
+		remove_trailing_rmap_items(&mm->ksm_rmap_list);
+
+		spin_lock(&ksm_mmlist_lock);
+		if (mm->ksm_list.next != &ksm_mm_head)
+			ksm_scan.mm = list_entry(mm->ksm_list.next,
+						 struct mm_struct, ksm_list);
+		else
+			ksm_scan.mm = NULL;
+		if (ksm_test_exit(mm)) {
+			list_del_init(&mm->ksm_list);
+			spin_unlock(&ksm_mmlist_lock);
+			up_read(&mm->mmap_sem);
+			mmdrop(mm);
+		} else {
+			spin_unlock(&ksm_mmlist_lock);
+			up_read(&mm->mmap_sem);
+		}
+	}
+
+	ksm_gc_stable_tree();
+	ksm_scan.seqnr = 0;
+	return 0;
+}
+
+/*
+ * madvise and mm lifetime
+ */
+
+int ksm_madvise(struct vm_area_struct *vma, unsigned long start,
+		unsigned long end, int advice, unsigned long *vm_flags)
+{
+	int err;
+
+	switch (advice) {
+	case MADV_MERGEABLE:
+		/* Only private anonymous memory ksmd can write protect */
+		if (*vm_flags & (VM_MERGEABLE | VM_SHARED | VM_MAYSHARE |
+				 VM_IO | VM_RESERVED | VM_HUGETLB |
+				 VM_NONLINEAR))
+			return 0;
+		__ksm_enter(vma->vm_mm);
+		*vm_flags |= VM_MERGEABLE;
+		break;
+	case MADV_UNMERGEABLE:
+		if (!(*vm_flags & VM_MERGEABLE))
+			return 0;
+		if (vma->anon_vma) {
+			err = unmerge_ksm_pages(vma, start, end);
+			if (err)
+				return err;
+		}
+		*vm_flags &= ~VM_MERGEABLE;
+		break;
+	}
+	return 0;
+}
+
+/**
+ * __ksm_enter - have ksmd scan @mm
+ * @mm: an mm with mergeable vmas
+ */
+void __ksm_enter(struct mm_struct *mm)
+{
+	int needs_wakeup;
+
+	if (!list_empty(&mm->ksm_list))
+		return;
+
+	spin_lock(&ksm_mmlist_lock);
+	needs_wakeup = list_empty(&ksm_mm_head);
+	if (list_empty(&mm->ksm_list)) {
+		atomic_inc(&mm->mm_count);
+		list_add_tail(&mm->ksm_list, &ksm_mm_head);
+	}
+	spin_unlock(&ksm_mmlist_lock);
+
+	if (needs_wakeup)
+		wake_up_interruptible(&ksm_thread_wait);
+}
+
+/**
+ * ksm_exit - stop ksmd scanning @mm
+ * @mm: the mm mmput() dropped the last user of
+ *
+ * An mm without rmap_items is taken off the list right away.  Otherwise
+ * ksmd frees the rmap_items on its next visit, and the mm after them;
+ * if ksmd is scanning @mm right now, wait until it let go of mmap_sem,
+ * so that exit_mmap() can tear down the vmas.
+ */
+void ksm_exit(struct mm_struct *mm)
+{
+	int free = 0;
+
+	if (list_empty(&mm->ksm_list))
+		return;
+
+	spin_lock(&ksm_mmlist_lock);
+	if (!list_empty(&mm->ksm_list) && !mm->ksm_rmap_list &&
+	    ksm_scan.mm != mm) {
+		list_del_init(&mm->ksm_list);
+		free = 1;
+	}
+	spin_unlock(&ksm_mmlist_lock);
+
+	if (free)
+		mmdrop(mm);
+	else {
+		down_write(&mm->mmap_sem);
+		up_write(&mm->mmap_sem);
+	}
+}
+
+/**
+ * page_referenced_ksm - page_referenced() for a KSM page
+ * @page: the KSM page
+ * @ignore_token: ignore the swap token
+ *
+ * Walks the rmap_items of the page's stable_node.  An mm whose mmap_sem
+ * is contended is skipped, as the vma cannot be looked up without it.
+ */
+int page_referenced_ksm(struct page *page, int ignore_token)
+{
+	struct stable_node *stable_node;
+	struct rmap_item *rmap_item;
+	struct hlist_node *hlist;
+	unsigned int mapcount;
+	int referenced = 0;
+
+	spin_lock(&ksm_lock);
+	if (!PageKsm(page))
+		goto out;
+	stable_node = page_stable_node(page);
+	if (!stable_node)
+		goto out;
+
+	mapcount = page_mapcount(page);
+	hlist_for_each_entry(rmap_item, hlist, &stable_node->hlist, hlist) {
+		struct mm_struct *mm = rmap_item->mm;
+		unsigned long address = rmap_item->address & PAGE_MASK;
+		struct vm_area_struct *vma;
+
+		if (!down_read_trylock(&mm->mmap_sem))
+			continue;
+		if (!ksm_test_exit(mm)) {
+			vma = find_vma(mm, address);
+			if (vma && vma->vm_start <= address)
+				referenced += page_referenced_one(page, vma,
+						address, &mapcount,
+						ignore_token);
+		}
+		up_read(&mm->mmap_sem);
+		if (!mapcount)
+			break;
+	}
+out:
+	spin_unlock(&ksm_lock);
+	return referenced;
+}
+
+/*
+ * /sys/kernel/mm/ksm
+ */
+
+#define KSM_ATTR_RO(_name) \
+static struct subsys_attribute _name##_attr = __ATTR_RO(_name)
+
+#define KSM_ATTR_RW(_name) \
+static struct subsys_attribute _name##_attr = \
+	__ATTR(_name, 0644, _name##_show, _name##_store)
+
+static ssize_t ksm_store_uint(const char *page, size_t count,
+			      unsigned int *value, unsigned int min,
+			      unsigned int max)
+{
+	char *end;
+	unsigned long val = simple_strtoul(page, &end, 10);
+
+	if (end == page || (*end && *end != '\n') || val < min || val > max)
+		return -EINVAL;
+	*value = val;
+	return count;
+}
+
+static ssize_t sleep_millisecs_show(struct subsystem *subsys, char *page)
+{
+	return sprintf(page, "%u\n", ksm_thread_sleep_millisecs);
+}
+
+static ssize_t sleep_millisecs_store(struct subsystem *subsys,
+				     const char *page, size_t count)
+{
+	return ksm_store_uint(page, count, &ksm_thread_sleep_millisecs,
+			      0, UINT_MAX);
+}
+KSM_ATTR_RW(sleep_millisecs);
+
+static ssize_t pages_to_scan_show(struct subsystem *subsys, char *page)
+{
+	return sprintf(page, "%u\n", ksm_thread_pages_to_scan);
+}
+
+static ssize_t pages_to_scan_store(struct subsystem *subsys,
+				   const char *page, size_t count)
+{
+	return ksm_store_uint(page, count, &ksm_thread_pages_to_scan,
+			      1, UINT_MAX);
+}
+KSM_ATTR_RW(pages_to_scan);
+
+static ssize_t run_show(struct subsystem *subsys, char *page)
+{
+	return sprintf(page, "%u\n", ksm_run);
+}
+
+static ssize_t run_store(struct subsystem *subsys, const char *page,
+			 size_t count)
+{
+	unsigned int flags;
+	ssize_t ret;
+	int err;
+
+	ret = ksm_store_uint(page, count, &flags, KSM_RUN_STOP,
+			     KSM_RUN_UNMERGE);
+	if (ret < 0)
+		return ret;
+
+	down(&ksm_thread_sem);
+	if (ksm_run != flags) {
+		ksm_run = flags;
+		if (flags & KSM_RUN_UNMERGE) {
+			err = unmerge_and_remove_all_rmap_items();
+			if (err) {
+				ksm_run = KSM_RUN_STOP;
+				ret = err;
+			}
+		}
+	}
+	up(&ksm_thread_sem);
+
+	if (flags & KSM_RUN_MERGE)
+		wake_up_interruptible(&ksm_thread_wait);
+	return ret;
+}
+KSM_ATTR_RW(run);
+
+static ssize_t pages_shared_show(struct subsystem *subsys, char *page)
+{
+	return sprintf(page, "%lu\n", ksm_pages_shared);
+}
+KSM_ATTR_RO(pages_shared);
+
+static ssize_t pages_sharing_show(struct subsystem *subsys, char *page)
+{
+	return sprintf(page, "%lu\n", ksm_pages_sharing);
+}
+KSM_ATTR_RO(pages_sharing);
+
+static ssize_t pages_unshared_show(struct subsystem *subsys, char *page)
+{
+	return sprintf(page, "%lu\n", ksm_pages_unshared);
+}
+KSM_ATTR_RO(pages_unshared);
+
+static ssize_t pages_volatile_show(struct subsystem *subsys, char *page)
+{
+	long pages_volatile;
+
+	pages_volatile = ksm_rmap_items - ksm_pages_shared -
+			 ksm_pages_sharing - ksm_pages_unshared;
+	/* The counters are not updated atomically with each other */
+	if (pages_volatile < 0)
+		pages_volatile = 0;
+	return sprintf(page, "%ld\n", pages_volatile);
+}
+KSM_ATTR_RO(pages_volatile);
+
+static ssize_t full_scans_show(struct subsystem *subsys, char *page)
+{
+	return sprintf(page, "%u\n", ksm_full_scans);
+}
+KSM_ATTR_RO(full_scans);
+
+static struct attribute *ksm_attrs[] = {
+	&sleep_millisecs_attr.attr,
+	&pages_to_scan_attr.attr,
+	&run_attr.attr,
+	&pages_shared_attr.attr,
+	&pages_sharing_attr.attr,
+	&pages_unshared_attr.attr,
+	&pages_volatile_attr.attr,
+	&full_scans_attr.attr,
+	NULL
+};
+
+static struct attribute_group ksm_attr_group = {
+	.attrs = ksm_attrs,
+};
+
+static decl_subsys(ksm, NULL, NULL);
+
+static int __init ksm_init(void)
+{
+	int err;
+
+	rmap_item_cache = kmem_cache_create("ksm_rmap_item",
+			sizeof(struct rmap_item), 0, SLAB_PANIC, NULL, NULL);
+	stable_node_cache = kmem_cache_create("ksm_stable_node",
+			sizeof(struct stable_node), 0, SLAB_PANIC, NULL, NULL);
+
+	ksm_subsys.kset.kobj.parent = &mm_subsys.kset.kobj;
+	err = subsystem_register(&ksm_subsys);
+	if (!err)
+		err = sysfs_create_group(&ksm_subsys.kset.kobj,
+					 &ksm_attr_group);
+	if (err)
+		printk(KERN_ERR "ksm: cannot register sysfs files\n");
+
+	kernel_thread(ksm_scan_thread, NULL, CLONE_KERNEL);
+	return 0;
+}
+
+module_init(ksm_init)
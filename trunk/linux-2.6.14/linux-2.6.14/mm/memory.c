@@ -41,6 +41,9 @@
 #include <linux/kernel_stat.h>
 #include <linux/mm.h>
 #include <linux/hugetlb.h>
+#include <linux/huge_mm.h>
+#include <linux/numa_balancing.h>
+#include <linux/ksm.h>
 #include <linux/mman.h>
 #include <linux/swap.h>
 #include <linux/highmem.h>
@@ -353,12 +356,29 @@ copy_one_pte(struct mm_struct *dst_mm, struct mm_struct *src_mm,
 	/* pte contains position in swap or file, so copy. */
 	if (unlikely(!pte_present(pte))) {
 		if (!pte_file(pte)) {
-			swap_duplicate(pte_to_swp_entry(pte));
-			/* make sure dst_mm is on swapoff's mmlist. */
-			if (unlikely(list_empty(&dst_mm->mmlist))) {
-				spin_lock(&mmlist_lock);
-				list_add(&dst_mm->mmlist, &src_mm->mmlist);
-				spin_unlock(&mmlist_lock);
+			swp_entry_t entry = pte_to_swp_entry(pte);
+
+			if (is_migration_entry(entry)) {
+				/*
+				 * COW mappings require pages in both parent
+				 * and child to be set to read.
+				 */
+				if (is_write_migration_entry(entry) &&
+				    (vm_flags & (VM_SHARED | VM_MAYWRITE)) ==
+								VM_MAYWRITE) {
+					make_migration_entry_read(&entry);
+					pte = swp_entry_to_pte(entry);
+					set_pte_at(src_mm, addr, src_pte, pte);
+				}
+			} else {
+				swap_duplicate(entry);
+				/* make sure dst_mm is on swapoff's mmlist. */
+				if (unlikely(list_empty(&dst_mm->mmlist))) {
+					spin_lock(&mmlist_lock);
+					list_add(&dst_mm->mmlist,
+						 &src_mm->mmlist);
+					spin_unlock(&mmlist_lock);
+				}
 			}
 		}
 		set_pte_at(dst_mm, addr, dst_pte, pte);
@@ -459,6 +479,14 @@ static inline int copy_pmd_range(struct mm_struct *dst_mm, struct mm_struct *src
 	src_pmd = pmd_offset(src_pud, addr);
 	do {
 		next = pmd_addr_end(addr, end);
+		if (pmd_trans_huge(*src_pmd)) {
+			int err = copy_huge_pmd(dst_mm, src_mm, dst_pmd,
+						src_pmd, addr, next);
+			if (err == -ENOMEM)
+				return -ENOMEM;
+			if (!err)
+				continue;
+		}
 		if (pmd_none_or_clear_bad(src_pmd))
 			continue;
 		if (copy_pte_range(dst_mm, src_mm, dst_pmd, src_pmd,
@@ -606,6 +634,13 @@ static inline void zap_pmd_range(struct mmu_gather *tlb, pud_t *pud,
 	pmd = pmd_offset(pud, addr);
 	do {
 		next = pmd_addr_end(addr, end);
+		if (pmd_trans_huge(*pmd)) {
+			if (next - addr == HPAGE_PMD_SIZE) {
+				zap_huge_pmd(tlb, pmd);
+				continue;
+			}
+			__split_huge_pmd(tlb->mm, pmd, addr);
+		}
 		if (pmd_none_or_clear_bad(pmd))
 			continue;
 		zap_pte_range(tlb, pmd, addr, next, details);
@@ -722,6 +757,11 @@ unsigned long unmap_vmas(struct mmu_gather **tlbp, struct mm_struct *mm,
 				unmap_hugepage_range(vma, start, end);
 			} else {
 				block = min(zap_bytes, end - start);
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+				/* Rather not end a block inside a huge pmd */
+				block = min(ALIGN(start + block, HPAGE_PMD_SIZE),
+					    end) - start;
+#endif
 				unmap_page_range(*tlbp, vma, start,
 						start + block, details);
 			}
@@ -811,6 +851,8 @@ static struct page *__follow_page(struct mm_struct *mm, unsigned long address,
 		goto out;
 	
 	pmd = pmd_offset(pud, address);
+	if (pmd_trans_huge(*pmd))
+		return follow_trans_huge_pmd(pmd, address, write, accessed);
 	if (pmd_none(*pmd) || unlikely(pmd_bad(*pmd)))
 		goto out;
 	if (pmd_huge(*pmd))
@@ -859,6 +901,23 @@ int check_user_page_readable(struct mm_struct *mm, unsigned long address)
 }
 EXPORT_SYMBOL(check_user_page_readable);
 
+/*
+ * Take a reference on the page mapped at address, leaving its accessed
+ * state alone: for scanners like ksmd, which look at pages without
+ * using them.  The caller holds mmap_sem.
+ */
+struct page *follow_page_get(struct mm_struct *mm, unsigned long address)
+{
+	struct page *page;
+
+	spin_lock(&mm->page_table_lock);
+	page = __follow_page(mm, address, 0, 0, 0);
+	if (page)
+		get_page(page);
+	spin_unlock(&mm->page_table_lock);
+	return page;
+}
+
 static inline int
 untouched_anonymous_page(struct mm_struct* mm, struct vm_area_struct *vma,
 			 unsigned long address)
@@ -882,6 +941,8 @@ untouched_anonymous_page(struct mm_struct* mm, struct vm_area_struct *vma,
 
 	/* Check if page middle directory entry exists. */
 	pmd = pmd_offset(pud, address);
+	if (pmd_trans_huge(*pmd))
+		return 0;
 	if (pmd_none(*pmd) || unlikely(pmd_bad(*pmd)))
 		return 1;
 
@@ -1265,7 +1326,9 @@ static int do_wp_page(struct mm_struct *mm, struct vm_area_struct * vma,
 	}
 	old_page = pfn_to_page(pfn);
 
-	if (PageAnon(old_page) && !TestSetPageLocked(old_page)) {
+	/* A KSM page is shared even when mapped once: always copy it */
+	if (PageAnon(old_page) && !PageKsm(old_page) &&
+	    !TestSetPageLocked(old_page)) {
 		int reuse = can_share_swap_page(old_page);
 		unlock_page(old_page);
 		if (reuse) {
@@ -1296,7 +1359,7 @@ static int do_wp_page(struct mm_struct *mm, struct vm_area_struct * vma,
 		if (!new_page)
 			goto no_new_page;
 	} else {
-		new_page = alloc_page_vma(GFP_HIGHUSER, vma, address);
+		new_page = alloc_page_vma(GFP_HIGHUSER_MOVABLE, vma, address);
 		if (!new_page)
 			goto no_new_page;
 		copy_user_highpage(new_page, old_page, address);
@@ -1316,6 +1379,7 @@ static int do_wp_page(struct mm_struct *mm, struct vm_area_struct * vma,
 			page_remove_rmap(old_page);
 		flush_cache_page(vma, address, pfn);
 		break_cow(vma, new_page, address, page_table);
+		SetPageSwapBacked(new_page);
 		lru_cache_add_active(new_page);
 		page_add_anon_rmap(new_page, vma, address);
 
@@ -1606,6 +1670,9 @@ EXPORT_SYMBOL(vmtruncate);
  * This has been extended to use the NUMA policies from the mm triggering
  * the readahead.
  *
+ * Anonymous faults read ahead by virtual address instead, see
+ * swapin_readahead_vma(); this is left to shmem, which has no ptes.
+ *
  * Caller must hold down_read on the vma->vm_mm if vma is not NULL.
  */
 void swapin_readahead(swp_entry_t entry, unsigned long addr,struct vm_area_struct *vma)
@@ -1668,10 +1735,19 @@ static int do_swap_page(struct mm_struct * mm,
 
 	pte_unmap(page_table);
 	spin_unlock(&mm->page_table_lock);
+	if (is_migration_entry(entry)) {
+		migration_entry_wait(mm, pmd, address);
+		goto out;
+	}
 	page = lookup_swap_cache(entry);
+	if (page && TestClearPageReadahead(page)) {
+		/* Readahead got it right: let its window grow */
+		vma->swap_ra_hits++;
+		inc_page_state(swap_ra_hit);
+	}
 	if (!page) {
- 		swapin_readahead(entry, address, vma);
- 		page = read_swap_cache_async(entry, vma, address);
+		swapin_readahead_vma(entry, address, vma, pmd);
+		page = read_swap_cache_async(entry, vma, address);
 		if (!page) {
 			/*
 			 * Back out if somebody else faulted in this pte while
@@ -1794,6 +1870,7 @@ do_anonymous_page(struct mm_struct *mm, struct vm_area_struct *vma,
 		entry = maybe_mkwrite(pte_mkdirty(mk_pte(page,
 							 vma->vm_page_prot)),
 				      vma);
+		SetPageSwapBacked(page);
 		lru_cache_add_active(page);
 		SetPageReferenced(page);
 		page_add_anon_rmap(page, vma, addr);
@@ -1812,6 +1889,36 @@ no_mem:
 	return VM_FAULT_OOM;
 }
 
+/*
+ * Fault-around: a read fault on a file mapping also maps the pages of
+ * the file around it which are uptodate in the page cache, all under
+ * one page_table_lock, so that a process walking through cached file
+ * data does not take a minor fault for every page.  The window is
+ * sysctl_fault_around_bytes, rounded down to a power of two pages and
+ * aligned to its size, so it never crosses a page table.
+ */
+int sysctl_fault_around_bytes = 65536;
+
+static void do_fault_around(struct vm_area_struct *vma,
+		unsigned long address, pte_t *page_table)
+{
+	unsigned long nr_pages, size, start, end;
+
+	nr_pages = sysctl_fault_around_bytes >> PAGE_SHIFT;
+	if (nr_pages <= 1)
+		return;
+	nr_pages = 1UL << (fls(nr_pages) - 1);
+	if (nr_pages > PTRS_PER_PTE)
+		nr_pages = PTRS_PER_PTE;
+	size = nr_pages << PAGE_SHIFT;
+
+	address &= PAGE_MASK;
+	start = max(address & ~(size - 1), vma->vm_start);
+	end = min((address & ~(size - 1)) + size, vma->vm_end);
+	vma->vm_ops->map_pages(vma, start, end,
+			page_table - ((address - start) >> PAGE_SHIFT));
+}
+
 /*
  * do_no_page() tries to create a new page mapping. It aggressively
  * tries to share with existing pages, but makes a separate copy if
@@ -1838,6 +1945,16 @@ do_no_page(struct mm_struct *mm, struct vm_area_struct *vma,
 	if (!vma->vm_ops || !vma->vm_ops->nopage)
 		return do_anonymous_page(mm, vma, page_table,
 					pmd, write_access, address);
+	if (!write_access && vma->vm_ops->map_pages &&
+	    !(vma->vm_flags & VM_NONLINEAR)) {
+		do_fault_around(vma, address, page_table);
+		/* The page was cached: no need to go to ->nopage */
+		if (!pte_none(*page_table)) {
+			pte_unmap(page_table);
+			spin_unlock(&mm->page_table_lock);
+			return VM_FAULT_MINOR;
+		}
+	}
 	pte_unmap(page_table);
 	spin_unlock(&mm->page_table_lock);
 
@@ -1871,7 +1988,7 @@ retry:
 
 		if (unlikely(anon_vma_prepare(vma)))
 			goto oom;
-		page = alloc_page_vma(GFP_HIGHUSER, vma, address);
+		page = alloc_page_vma(GFP_HIGHUSER_MOVABLE, vma, address);
 		if (!page)
 			goto oom;
 		copy_user_highpage(page, new_page, address);
@@ -1915,6 +2032,7 @@ retry:
 			entry = maybe_mkwrite(pte_mkdirty(entry), vma);
 		set_pte_at(mm, address, page_table, entry);
 		if (anon) {
+			SetPageSwapBacked(new_page);
 			lru_cache_add_active(new_page);
 			page_add_anon_rmap(new_page, vma, address);
 		} else
@@ -2016,6 +2134,9 @@ static inline int handle_pte_fault(struct mm_struct *mm,
 		return do_swap_page(mm, vma, address, pte, pmd, entry, write_access);
 	}
 
+	if (pte_numa_hint(vma, entry))
+		return do_numa_page(mm, vma, address, pte, pmd, entry);
+
 	if (write_access) {
 		if (!pte_write(entry))
 			return do_wp_page(mm, vma, address, pte, pmd, entry);
@@ -2048,6 +2169,8 @@ int __handle_mm_fault(struct mm_struct *mm, struct vm_area_struct * vma,
 	if (unlikely(is_vm_hugetlb_page(vma)))
 		return hugetlb_fault(mm, vma, address, write_access);
 
+	numa_balancing_enter(mm);
+
 	/*
 	 * We need the page table lock to synchronize with kswapd
 	 * and the SMP-safe atomic PTE updates.
@@ -2063,6 +2186,18 @@ int __handle_mm_fault(struct mm_struct *mm, struct vm_area_struct * vma,
 	if (!pmd)
 		goto oom;
 
+	if (pmd_none(*pmd) && transparent_hugepage_vma(vma, address)) {
+		int ret = do_huge_pmd_anonymous_page(mm, vma, address, pmd,
+						     write_access);
+		if (!(ret & VM_FAULT_FALLBACK))
+			return ret;
+	} else if (pmd_trans_huge(*pmd)) {
+		int ret = do_huge_pmd_fault(mm, vma, address, pmd,
+					    write_access);
+		if (!(ret & VM_FAULT_FALLBACK))
+			return ret;
+	}
+
 	pte = pte_alloc_map(mm, pmd, address);
 	if (!pte)
 		goto oom;
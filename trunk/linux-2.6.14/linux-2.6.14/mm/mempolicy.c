@@ -63,6 +63,7 @@
 #include <linux/mm.h>
 #include <linux/highmem.h>
 #include <linux/hugetlb.h>
+#include <linux/huge_mm.h>
 #include <linux/kernel.h>
 #include <linux/sched.h>
 #include <linux/mm.h>
@@ -273,7 +274,7 @@ static inline int check_pmd_range(struct mm_struct *mm, pud_t *pud,
 	pmd = pmd_offset(pud, addr);
 	do {
 		next = pmd_addr_end(addr, end);
-		if (pmd_none_or_clear_bad(pmd))
+		if (pmd_none_or_trans_huge_or_clear_bad(pmd))
 			continue;
 		if (check_pte_range(mm, pmd, addr, next, nodes))
 			return -EIO;
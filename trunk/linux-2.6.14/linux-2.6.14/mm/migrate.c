@@ -0,0 +1,507 @@
+/*
+ * mm/migrate.c - page migration
+ *
+ * Moves the contents of a page to another page, while the page may be
+ * mapped and in the page cache or swap cache.  The old page is locked and
+ * its ptes are replaced by migration entries (see <linux/swapops.h>), the
+ * page cache slot is switched over to the new page, the data and page
+ * flags are copied and the migration entries are finally pointed at the
+ * new page.  Faults on a migration entry wait on the old page's lock.
+ *
+ * Anonymous pages need neither swap space nor I/O to be moved.  Pages
+ * with buffers are only moved if the buffers can be dropped, and pages
+ * under writeback are waited on or skipped.
+ */
+
+#include <linux/mm.h>
+#include <linux/migrate.h>
+#include <linux/mm_inline.h>
+#include <linux/pagemap.h>
+#include <linux/buffer_head.h>
+#include <linux/swap.h>
+#include <linux/swapops.h>
+#include <linux/highmem.h>
+#include <linux/rmap.h>
+#include <linux/huge_mm.h>
+#include <linux/ksm.h>
+#include <linux/rcupdate.h>
+#include <linux/sched.h>
+
+#include <asm/tlbflush.h>
+
+/*
+ * Isolate one page from the LRU lists and put it on @pagelist, with an
+ * extra reference held.  Returns -EBUSY if the page is not on the LRU,
+ * or is being freed.
+ *
+ * Must be called with zone->lru_lock held and interrupts disabled.
+ */
+int isolate_lru_page(struct page *page, struct list_head *pagelist)
+{
+	struct zone *zone = page_zone(page);
+
+	if (!TestClearPageLRU(page))
+		return -EBUSY;
+
+	if (get_page_testone(page)) {
+		/*
+		 * It is being freed elsewhere
+		 */
+		__put_page(page);
+		SetPageLRU(page);
+		return -EBUSY;
+	}
+
+	del_page_from_lru_list(zone, page, page_lru(page));
+	/* It goes back to an evictable list, reclaim culls it again */
+	if (PageUnevictable(page))
+		ClearPageUnevictable(page);
+	list_add_tail(&page->lru, pagelist);
+	return 0;
+}
+
+/*
+ * Give an isolated page back to the LRU and drop the isolation reference.
+ */
+static inline void move_to_lru(struct page *page)
+{
+	if (PageActive(page)) {
+		/*
+		 * lru_cache_add_active checks that
+		 * the PG_active bit is off.
+		 */
+		ClearPageActive(page);
+		lru_cache_add_active(page);
+	} else {
+		lru_cache_add(page);
+	}
+	put_page(page);
+}
+
+/**
+ * putback_lru_pages - put isolated pages back onto the LRU lists
+ * @l: list of pages taken off with isolate_lru_page()
+ */
+void putback_lru_pages(struct list_head *l)
+{
+	struct page *page;
+	struct page *page2;
+
+	list_for_each_entry_safe(page, page2, l, lru) {
+		list_del(&page->lru);
+		move_to_lru(page);
+	}
+}
+
+/*
+ * Wait for the page a migration entry points to to be unlocked, after
+ * a fault found the entry at @address.  The fault is retried afterwards.
+ */
+void migration_entry_wait(struct mm_struct *mm, pmd_t *pmd,
+				unsigned long address)
+{
+	pte_t *ptep, pte;
+	swp_entry_t entry;
+	struct page *page;
+
+	spin_lock(&mm->page_table_lock);
+	ptep = pte_offset_map(pmd, address);
+	pte = *ptep;
+	if (!is_swap_pte(pte))
+		goto out;
+
+	entry = pte_to_swp_entry(pte);
+	if (!is_migration_entry(entry))
+		goto out;
+
+	/*
+	 * The migrating page holds a reference until its migration
+	 * entries have been removed, so this one cannot drop the last.
+	 */
+	page = migration_entry_to_page(entry);
+	get_page(page);
+	pte_unmap(ptep);
+	spin_unlock(&mm->page_table_lock);
+	wait_on_page_locked(page);
+	put_page(page);
+	return;
+out:
+	pte_unmap(ptep);
+	spin_unlock(&mm->page_table_lock);
+}
+
+/*
+ * Restore a pte which migration replaced by a migration entry for @old,
+ * pointing it at @new.
+ */
+static void remove_migration_pte(struct vm_area_struct *vma,
+		struct page *old, struct page *new)
+{
+	struct mm_struct *mm = vma->vm_mm;
+	swp_entry_t entry;
+	pgd_t *pgd;
+	pud_t *pud;
+	pmd_t *pmd;
+	pte_t *ptep, pte;
+	unsigned long addr = page_address_in_vma(new, vma);
+
+	if (addr == -EFAULT)
+		return;
+
+	pgd = pgd_offset(mm, addr);
+	if (!pgd_present(*pgd))
+		return;
+
+	pud = pud_offset(pgd, addr);
+	if (!pud_present(*pud))
+		return;
+
+	pmd = pmd_offset(pud, addr);
+	if (!pmd_present(*pmd))
+		return;
+
+	spin_lock(&mm->page_table_lock);
+	if (pmd_trans_huge(*pmd)) {
+		spin_unlock(&mm->page_table_lock);
+		return;
+	}
+	ptep = pte_offset_map(pmd, addr);
+	pte = *ptep;
+	if (!is_swap_pte(pte))
+		goto out;
+
+	entry = pte_to_swp_entry(pte);
+	if (!is_migration_entry(entry) ||
+	    migration_entry_to_page(entry) != old)
+		goto out;
+
+	get_page(new);
+	pte = pte_mkold(mk_pte(new, vma->vm_page_prot));
+	if (is_write_migration_entry(entry))
+		pte = pte_mkwrite(pte);
+	set_pte_at(mm, addr, ptep, pte);
+
+	inc_mm_counter(mm, rss);
+	if (PageAnon(new))
+		page_add_anon_rmap(new, vma, addr);
+	else
+		page_add_file_rmap(new);
+
+	/* No need to invalidate - it was non-present before */
+	update_mmu_cache(vma, addr, pte);
+	lazy_mmu_prot_update(pte);
+out:
+	pte_unmap(ptep);
+	spin_unlock(&mm->page_table_lock);
+}
+
+/*
+ * Get rid of all migration entries for @old and replace them by ptes
+ * for @new, which is @old itself when the migration failed.  Called with
+ * both pages locked, and under rcu_read_lock for anonymous pages, which
+ * keeps the anon_vma from being freed once the page is unmapped.
+ */
+static void remove_migration_ptes(struct page *old, struct page *new)
+{
+	struct address_space *mapping = new->mapping;
+	struct vm_area_struct *vma;
+
+	if (!mapping)
+		return;
+
+	if (PageAnon(new)) {
+		struct anon_vma *anon_vma;
+
+		anon_vma = (struct anon_vma *)
+			((unsigned long)mapping - PAGE_MAPPING_ANON);
+		spin_lock(&anon_vma->lock);
+		list_for_each_entry(vma, &anon_vma->head, anon_vma_node)
+			remove_migration_pte(vma, old, new);
+		spin_unlock(&anon_vma->lock);
+	} else {
+		pgoff_t pgoff = new->index <<
+				(PAGE_CACHE_SHIFT - PAGE_SHIFT);
+		struct prio_tree_iter iter;
+
+		spin_lock(&mapping->i_mmap_lock);
+		vma_prio_tree_foreach(vma, &iter, &mapping->i_mmap,
+				      pgoff, pgoff)
+			remove_migration_pte(vma, old, new);
+		spin_unlock(&mapping->i_mmap_lock);
+	}
+}
+
+/*
+ * Replace @page by @newpage in its page cache or swap cache slot.  The
+ * only references left to @page must be ours, the cache's and that of
+ * its buffers: anybody else could still be looking at the old contents.
+ * Returns -EAGAIN if that is not the case yet.
+ */
+static int migrate_page_move_mapping(struct page *newpage, struct page *page)
+{
+	struct address_space *mapping = page_mapping(page);
+	struct page **radix_pointer;
+	int expected;
+
+	if (!mapping) {
+		/* Anonymous page without swap cache */
+		if (page_count(page) != 1)
+			return -EAGAIN;
+		return 0;
+	}
+
+	spin_lock_irq(&mapping->tree_lock);
+
+	radix_pointer = (struct page **)radix_tree_lookup_slot(
+						&mapping->page_tree,
+						page_index(page));
+
+	/* pagecache + us + buffers */
+	expected = 2 + !!PagePrivate(page);
+	if (!radix_pointer || *radix_pointer != page ||
+	    !page_freeze_refs(page, expected)) {
+		spin_unlock_irq(&mapping->tree_lock);
+		return -EAGAIN;
+	}
+
+	/*
+	 * Now we know that no one else is looking at the page, and with
+	 * its count frozen no lockless lookup can start to.
+	 */
+	get_page(newpage);
+	if (PageSwapCache(page)) {
+		SetPageSwapCache(newpage);
+		newpage->private = page->private;
+	}
+
+	radix_tree_replace_slot((void **)radix_pointer, newpage);
+	page_unfreeze_refs(page, expected - 1);	/* drop the pagecache ref */
+	spin_unlock_irq(&mapping->tree_lock);
+
+	return 0;
+}
+
+/*
+ * Copy the contents and state of @page to @newpage.  Dirty state moves
+ * over as is: the radix tree tag and nr_dirty stay with the slot.
+ */
+static void migrate_page_copy(struct page *newpage, struct page *page)
+{
+	copy_highpage(newpage, page);
+
+	if (PageError(page))
+		SetPageError(newpage);
+	if (PageReferenced(page))
+		SetPageReferenced(newpage);
+	if (PageUptodate(page))
+		SetPageUptodate(newpage);
+	if (PageActive(page))
+		SetPageActive(newpage);
+	if (PageChecked(page))
+		SetPageChecked(newpage);
+	if (PageMappedToDisk(page))
+		SetPageMappedToDisk(newpage);
+	if (PageSwapBacked(page))
+		SetPageSwapBacked(newpage);
+	if (TestClearPageDirty(page))
+		SetPageDirty(newpage);
+
+	ClearPageSwapCache(page);
+	ClearPageActive(page);
+	page->private = 0;
+	page->mapping = NULL;
+}
+
+/*
+ * Move the unmapped, locked @page over to @newpage.  Buffers are dropped
+ * first if they can be, pages whose buffers stay busy are not moved.
+ * Returns 0 on success.
+ */
+static int move_to_new_page(struct page *newpage, struct page *page)
+{
+	int rc;
+
+	if (PagePrivate(page)) {
+		if (PageDirty(page) ||
+		    !try_to_release_page(page, GFP_KERNEL))
+			return -EBUSY;
+	}
+
+	/*
+	 * Block others from accessing the new page until the data has been
+	 * copied: lookups of the cache slot see a locked, not uptodate page.
+	 */
+	if (TestSetPageLocked(newpage))
+		BUG();
+
+	newpage->index = page->index;
+	newpage->mapping = page->mapping;
+
+	rc = migrate_page_move_mapping(newpage, page);
+	if (!rc) {
+		migrate_page_copy(newpage, page);
+		remove_migration_ptes(page, newpage);
+	} else
+		newpage->mapping = NULL;
+
+	unlock_page(newpage);
+	return rc;
+}
+
+/*
+ * Obtain the lock on page, remove all ptes and migrate the page
+ * to the newly allocated page in newpage.
+ */
+static int unmap_and_move(new_page_t get_new_page, unsigned long private,
+			struct page *page, int force)
+{
+	int rc = 0;
+	int moved = 0;
+	int rcu_locked = 0;
+	struct page *newpage = get_new_page(page, private);
+
+	if (!newpage)
+		return -ENOMEM;
+
+	if (page_count(page) == 1) {
+		/* page was freed from under us. So we are done. */
+		goto done;
+	}
+
+	rc = -EAGAIN;
+	if (TestSetPageLocked(page)) {
+		if (!force)
+			goto done;
+		lock_page(page);
+	}
+
+	if (PageWriteback(page)) {
+		if (!force)
+			goto unlock;
+		wait_on_page_writeback(page);
+	}
+
+	/*
+	 * Truncation removed the page from its mapping: the last reference
+	 * going away will free it, unless it still has buffers.
+	 */
+	if (!page->mapping) {
+		if (PagePrivate(page) && !try_to_release_page(page, GFP_KERNEL))
+			rc = -EBUSY;
+		else
+			rc = 0;
+		goto unlock;
+	}
+
+	/* KSM pages have no anon_vma to find their ptes through */
+	if (PageKsm(page)) {
+		rc = -EBUSY;
+		goto unlock;
+	}
+
+	if (PageAnon(page)) {
+		rcu_read_lock();
+		rcu_locked = 1;
+	}
+
+	/* Establish migration ptes or remove ptes */
+	try_to_unmap(page, 1);
+	if (!page_mapped(page)) {
+		rc = move_to_new_page(newpage, page);
+		moved = !rc;
+	}
+
+	if (rc)
+		remove_migration_ptes(page, page);
+
+	if (rcu_locked)
+		rcu_read_unlock();
+unlock:
+	unlock_page(page);
+done:
+	if (rc != -EAGAIN) {
+		/*
+		 * A page that has been migrated has all references
+		 * removed and will be freed. A page that has not been
+		 * migrated will have kept its references and be
+		 * restored.
+		 */
+		list_del(&page->lru);
+		if (rc)
+			move_to_lru(page);
+		else
+			put_page(page);
+	}
+
+	/*
+	 * Move the new page to the LRU. If it did not receive the
+	 * contents of the old page then this will free it.
+	 */
+	if (moved)
+		move_to_lru(newpage);
+	else
+		put_page(newpage);
+	return rc;
+}
+
+/**
+ * migrate_pages - migrate a list of isolated pages
+ * @from: pages taken off the LRU with isolate_lru_page()
+ * @get_new_page: allocates the page to move each page to
+ * @private: passed on to @get_new_page
+ *
+ * Pages which are busy are retried a few times, forcing the page lock
+ * and waiting for writeback on the later passes.  The pages left on
+ * @from are put back onto the LRU.
+ *
+ * Returns the number of pages that were not migrated, or an error code
+ * if @get_new_page failed.
+ */
+int migrate_pages(struct list_head *from, new_page_t get_new_page,
+		  unsigned long private)
+{
+	int retry = 1;
+	int nr_failed = 0;
+	int nr_succeeded = 0;
+	int pass = 0;
+	struct page *page;
+	struct page *page2;
+	int rc;
+
+	for (pass = 0; pass < 10 && retry; pass++) {
+		retry = 0;
+
+		list_for_each_entry_safe(page, page2, from, lru) {
+			cond_resched();
+
+			rc = unmap_and_move(get_new_page, private,
+						page, pass > 2);
+
+			switch(rc) {
+			case -ENOMEM:
+				goto out;
+			case -EAGAIN:
+				retry++;
+				break;
+			case 0:
+				nr_succeeded++;
+				break;
+			default:
+				/* Permanent failure */
+				nr_failed++;
+				break;
+			}
+		}
+	}
+	rc = 0;
+out:
+	if (nr_succeeded)
+		mod_page_state(pgmigrate_success, nr_succeeded);
+	if (nr_failed + retry)
+		mod_page_state(pgmigrate_fail, nr_failed + retry);
+	putback_lru_pages(from);
+
+	if (rc)
+		return rc;
+	return nr_failed + retry;
+}
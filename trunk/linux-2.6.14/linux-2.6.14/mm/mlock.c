@@ -9,7 +9,101 @@
 #include <linux/mm.h>
 #include <linux/mempolicy.h>
 #include <linux/syscalls.h>
+#include <linux/swap.h>
+#include <linux/huge_mm.h>
+#include "internal.h"
 
+/*
+ * Reclaim moves the mlocked pages it comes across to the unevictable
+ * LRU.  Once a range is no longer locked, its pages are put back on the
+ * inactive lists; those still locked through another vma are simply
+ * culled again.
+ */
+static inline void munlock_page(struct page *page)
+{
+	if (!PageReserved(page) && PageUnevictable(page))
+		rescue_unevictable_page(page);
+}
+
+static void munlock_pte_range(pmd_t *pmd, unsigned long addr,
+			      unsigned long end)
+{
+	pte_t *pte;
+
+	pte = pte_offset_map(pmd, addr);
+	do {
+		if (pte_present(*pte) && pfn_valid(pte_pfn(*pte)))
+			munlock_page(pfn_to_page(pte_pfn(*pte)));
+	} while (pte++, addr += PAGE_SIZE, addr != end);
+	pte_unmap(pte - 1);
+}
+
+static inline void munlock_pmd_range(pud_t *pud, unsigned long addr,
+				     unsigned long end)
+{
+	pmd_t *pmd;
+	unsigned long next;
+
+	pmd = pmd_offset(pud, addr);
+	do {
+		next = pmd_addr_end(addr, end);
+		if (pmd_trans_huge(*pmd)) {
+			for (; addr != next; addr += PAGE_SIZE)
+				munlock_page(follow_trans_huge_pmd(pmd, addr,
+								   0, 0));
+			continue;
+		}
+		if (pmd_none_or_clear_bad(pmd))
+			continue;
+		munlock_pte_range(pmd, addr, next);
+	} while (pmd++, addr = next, addr != end);
+}
+
+static inline void munlock_pud_range(pgd_t *pgd, unsigned long addr,
+				     unsigned long end)
+{
+	pud_t *pud;
+	unsigned long next;
+
+	pud = pud_offset(pgd, addr);
+	do {
+		next = pud_addr_end(addr, end);
+		if (pud_none_or_clear_bad(pud))
+			continue;
+		munlock_pmd_range(pud, addr, next);
+	} while (pud++, addr = next, addr != end);
+}
+
+/**
+ * munlock_vma_pages_range - give the pages of a range back to reclaim
+ * @vma: the vma which is being munlocked or unmapped
+ * @start: start of the range
+ * @end: end of the range
+ *
+ * Called with mmap_sem held, before VM_LOCKED is cleared from @vma or
+ * the range is unmapped.
+ */
+void munlock_vma_pages_range(struct vm_area_struct *vma,
+			     unsigned long start, unsigned long end)
+{
+	struct mm_struct *mm = vma->vm_mm;
+	unsigned long addr = start;
+	unsigned long next;
+	pgd_t *pgd;
+
+	if (vma->vm_flags & (VM_IO | VM_RESERVED))
+		return;
+
+	pgd = pgd_offset(mm, addr);
+	spin_lock(&mm->page_table_lock);
+	do {
+		next = pgd_addr_end(addr, end);
+		if (pgd_none_or_clear_bad(pgd))
+			continue;
+		munlock_pud_range(pgd, addr, next);
+	} while (pgd++, addr = next, addr != end);
+	spin_unlock(&mm->page_table_lock);
+}
 
 static int mlock_fixup(struct vm_area_struct *vma, struct vm_area_struct **prev,
 	unsigned long start, unsigned long end, unsigned int newflags)
@@ -62,7 +156,8 @@ success:
 		pages = -pages;
 		if (!(newflags & VM_IO))
 			ret = make_pages_present(start, end);
-	}
+	} else
+		munlock_vma_pages_range(vma, start, end);
 
 	vma->vm_mm->locked_vm -= pages;
 out:
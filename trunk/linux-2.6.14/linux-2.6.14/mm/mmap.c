@@ -29,6 +29,8 @@
 #include <asm/cacheflush.h>
 #include <asm/tlb.h>
 
+#include "internal.h"
+
 static void unmap_region(struct mm_struct *mm,
 		struct vm_area_struct *vma, struct vm_area_struct *prev,
 		unsigned long start, unsigned long end);
@@ -1792,6 +1794,20 @@ int do_munmap(struct mm_struct *mm, unsigned long start, size_t len)
 	}
 	vma = prev? prev->vm_next: mm->mmap;
 
+	/*
+	 * Pages reclaim set aside as mlocked may be evictable again, but
+	 * only those of the range going away: the rest stays locked.
+	 */
+	if (mm->locked_vm) {
+		struct vm_area_struct *tmp;
+
+		for (tmp = vma; tmp && tmp->vm_start < end; tmp = tmp->vm_next)
+			if (tmp->vm_flags & VM_LOCKED)
+				munlock_vma_pages_range(tmp,
+						max(start, tmp->vm_start),
+						min(end, tmp->vm_end));
+	}
+
 	/*
 	 * Remove the vma's, and unmap the actual pages
 	 */
@@ -1932,6 +1948,14 @@ void exit_mmap(struct mm_struct *mm)
 	unsigned long nr_accounted = 0;
 	unsigned long end;
 
+	if (mm->locked_vm) {
+		for (; vma; vma = vma->vm_next)
+			if (vma->vm_flags & VM_LOCKED)
+				munlock_vma_pages_range(vma, vma->vm_start,
+							vma->vm_end);
+		vma = mm->mmap;
+	}
+
 	lru_add_drain();
 
 	spin_lock(&mm->page_table_lock);
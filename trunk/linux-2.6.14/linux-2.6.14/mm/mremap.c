@@ -9,6 +9,7 @@
 
 #include <linux/mm.h>
 #include <linux/hugetlb.h>
+#include <linux/huge_mm.h>
 #include <linux/slab.h>
 #include <linux/shm.h>
 #include <linux/mman.h>
@@ -38,6 +39,8 @@ static pte_t *get_one_pte_map_nested(struct mm_struct *mm, unsigned long addr)
 		goto end;
 
 	pmd = pmd_offset(pud, addr);
+	if (pmd_trans_huge(*pmd))
+		__split_huge_pmd(mm, pmd, addr);
 	if (pmd_none_or_clear_bad(pmd))
 		goto end;
 
@@ -65,6 +68,8 @@ static pte_t *get_one_pte_map(struct mm_struct *mm, unsigned long addr)
 		return NULL;
 
 	pmd = pmd_offset(pud, addr);
+	if (pmd_trans_huge(*pmd))
+		__split_huge_pmd(mm, pmd, addr);
 	if (pmd_none_or_clear_bad(pmd))
 		return NULL;
 
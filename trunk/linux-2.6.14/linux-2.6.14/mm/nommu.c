@@ -232,6 +232,25 @@ void vunmap(void *addr)
 	BUG();
 }
 
+void *vm_map_ram(struct page **pages, unsigned int count, pgprot_t prot)
+{
+	BUG();
+	return NULL;
+}
+
+void vm_unmap_ram(const void *mem, unsigned int count)
+{
+	BUG();
+}
+
+void vm_unmap_aliases(void)
+{
+}
+
+void __init vmalloc_init(void)
+{
+}
+
 /*
  *  sys_brk() for the most part doesn't need the global kernel
  *  lock, except when an application is doing something nasty
@@ -0,0 +1,625 @@
+/*
+ * mm/numa_balancing.c - automatic NUMA balancing
+ *
+ * Moves the memory of a task to the node it runs on.  The knumad thread
+ * goes round the mms of the tasks which ran since it last looked at
+ * them, and turns a part of each into NUMA hinting ptes: ptes which
+ * still map the page, but like PROT_NONE ones fault on the next access.
+ * The fault makes the pte accessible again, and tells on which node the
+ * page is used: a page which is not on the node of the faulting cpu is
+ * migrated there, unless other processes map it too.
+ *
+ * The faults are also counted per task and node.  The node most of a
+ * task's faults came from in the recent scans of its mm is the task's
+ * preferred node: the load balancer pulls the task to that node even if
+ * it is cache hot, and is reluctant to take it away from there, so that
+ * tasks and their memory end up on the same node.
+ *
+ * The policy is set in /sys/kernel/mm/numa_balancing.
+ */
+
+#include <linux/mm.h>
+#include <linux/numa_balancing.h>
+#include <linux/hugetlb.h>
+#include <linux/huge_mm.h>
+#include <linux/migrate.h>
+#include <linux/swap.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/nodemask.h>
+#include <linux/kobject.h>
+#include <linux/sysfs.h>
+#include <linux/init.h>
+#include <linux/module.h>
+
+#include <asm/tlbflush.h>
+
+/* Tunables and statistics */
+static int numa_balancing_enabled = 1;
+static unsigned int numa_balancing_scan_size_mb = 256;
+static unsigned int numa_balancing_scan_sleep_millisecs = 1000;
+static unsigned int numa_balancing_full_scans;
+
+/*
+ * The mms knumad scans, each holding a reference on mm_count.  The scan
+ * cursor is the mm knumad is at; each mm remembers its own address.
+ */
+static DEFINE_SPINLOCK(numa_mm_lock);
+static LIST_HEAD(numa_mm_head);
+static struct mm_struct *knumad_scan_mm;
+
+/*
+ * Migrations into a node are limited to NUMA_MIGRATE_RATELIMIT pages in
+ * each window of NUMA_MIGRATE_WINDOW_MS, so that a burst of misplaced
+ * faults does not saturate the interconnect.
+ */
+#define NUMA_MIGRATE_WINDOW_MS	100
+#define NUMA_MIGRATE_RATELIMIT	(128UL << (20 - PAGE_SHIFT))
+
+static DEFINE_SPINLOCK(numa_migrate_lock);
+static unsigned long numa_migrate_next_window[MAX_NUMNODES];
+static unsigned long numa_migrate_nr_pages[MAX_NUMNODES];
+
+/* Set once mmput() dropped the last user: exit_mmap() is on its way */
+static inline int numa_test_exit(struct mm_struct *mm)
+{
+	return atomic_read(&mm->mm_users) == 0;
+}
+
+void __numa_balancing_enter(struct mm_struct *mm)
+{
+	if (num_online_nodes() == 1)
+		return;
+
+	spin_lock(&numa_mm_lock);
+	if (list_empty(&mm->numa_list)) {
+		atomic_inc(&mm->mm_count);
+		list_add_tail(&mm->numa_list, &numa_mm_head);
+	}
+	spin_unlock(&numa_mm_lock);
+}
+
+/**
+ * numa_balancing_exit - stop knumad scanning @mm
+ * @mm: the mm mmput() dropped the last user of
+ *
+ * If knumad is scanning @mm right now, it leaves the mm to the next
+ * scan, but it may still be working under mmap_sem: wait for that, so
+ * that exit_mmap() can tear down the page tables.
+ */
+void numa_balancing_exit(struct mm_struct *mm)
+{
+	int free = 0;
+
+	spin_lock(&numa_mm_lock);
+	if (!list_empty(&mm->numa_list) && knumad_scan_mm != mm) {
+		list_del_init(&mm->numa_list);
+		free = 1;
+	}
+	spin_unlock(&numa_mm_lock);
+
+	if (free)
+		mmdrop(mm);
+	else if (!list_empty(&mm->numa_list)) {
+		down_write(&mm->mmap_sem);
+		up_write(&mm->mmap_sem);
+	}
+}
+
+/*
+ * Hinting ptes
+ */
+
+static unsigned long change_pte_numa(struct vm_area_struct *vma, pmd_t *pmd,
+				     unsigned long addr, unsigned long end)
+{
+	struct mm_struct *mm = vma->vm_mm;
+	unsigned long pages = 0;
+	pte_t *pte;
+
+	spin_lock(&mm->page_table_lock);
+	/* A fault may have set up a huge pmd since the unlocked check */
+	if (!pmd_present(*pmd) || pmd_trans_huge(*pmd)) {
+		spin_unlock(&mm->page_table_lock);
+		return 0;
+	}
+
+	pte = pte_offset_map(pmd, addr);
+	do {
+		pte_t ptent = *pte;
+		unsigned long pfn;
+
+		if (!pte_present(ptent) || pte_numa(ptent))
+			continue;
+		pfn = pte_pfn(ptent);
+		if (!pfn_valid(pfn) || PageReserved(pfn_to_page(pfn)))
+			continue;
+
+		ptent = pte_mknuma(ptep_get_and_clear(mm, addr, pte));
+		set_pte_at(mm, addr, pte, ptent);
+		lazy_mmu_prot_update(ptent);
+		pages++;
+	} while (pte++, addr += PAGE_SIZE, addr != end);
+	pte_unmap(pte - 1);
+	spin_unlock(&mm->page_table_lock);
+	return pages;
+}
+
+static unsigned long change_pmd_numa(struct vm_area_struct *vma, pud_t *pud,
+				     unsigned long addr, unsigned long end)
+{
+	unsigned long next, pages = 0;
+	pmd_t *pmd;
+
+	pmd = pmd_offset(pud, addr);
+	do {
+		next = pmd_addr_end(addr, end);
+		if (pmd_none_or_trans_huge_or_clear_bad(pmd))
+			continue;
+		pages += change_pte_numa(vma, pmd, addr, next);
+		cond_resched();
+	} while (pmd++, addr = next, addr != end);
+	return pages;
+}
+
+static unsigned long change_pud_numa(struct vm_area_struct *vma, pgd_t *pgd,
+				     unsigned long addr, unsigned long end)
+{
+	unsigned long next, pages = 0;
+	pud_t *pud;
+
+	pud = pud_offset(pgd, addr);
+	do {
+		next = pud_addr_end(addr, end);
+		if (pud_none_or_clear_bad(pud))
+			continue;
+		pages += change_pmd_numa(vma, pud, addr, next);
+	} while (pud++, addr = next, addr != end);
+	return pages;
+}
+
+/*
+ * Turn the ptes of the range into hinting ptes.  Huge pmds are left
+ * alone: splitting them to sample their pages would cost more than the
+ * better placement gains.  Call with mmap_sem held.
+ */
+static void change_prot_numa(struct vm_area_struct *vma,
+			     unsigned long start, unsigned long end)
+{
+	unsigned long addr = start, next, pages = 0;
+	pgd_t *pgd;
+
+	pgd = pgd_offset(vma->vm_mm, addr);
+	do {
+		next = pgd_addr_end(addr, end);
+		if (pgd_none_or_clear_bad(pgd))
+			continue;
+		pages += change_pud_numa(vma, pgd, addr, next);
+	} while (pgd++, addr = next, addr != end);
+
+	if (pages) {
+		flush_tlb_range(vma, start, end);
+		mod_page_state(numa_pte_updates, pages);
+	}
+}
+
+static int numa_vma_migratable(struct vm_area_struct *vma)
+{
+	if (is_vm_hugetlb_page(vma) || (vma->vm_flags & (VM_IO|VM_RESERVED)))
+		return 0;
+	if (!(vma->vm_flags & (VM_READ|VM_WRITE|VM_EXEC)))
+		return 0;
+	/* Read-only file mappings are shared libraries: used from anywhere */
+	if (vma->vm_file && (vma->vm_flags & (VM_READ|VM_WRITE)) == VM_READ)
+		return 0;
+	return 1;
+}
+
+/*
+ * Sample the next @pages pages of @mm, from where the last scan of the
+ * mm stopped.  Going past the last vma starts the next full scan.
+ */
+static void knumad_scan(struct mm_struct *mm, unsigned long pages)
+{
+	struct vm_area_struct *vma = NULL;
+	unsigned long address = mm->numa_scan_offset;
+	unsigned long progress = 0;
+
+	down_read(&mm->mmap_sem);
+	if (!numa_test_exit(mm)) {
+		vma = find_vma(mm, address);
+		if (!vma) {
+			mm->numa_scan_seq++;
+			address = 0;
+			vma = mm->mmap;
+		}
+	}
+
+	for (; vma; vma = vma->vm_next) {
+		unsigned long end;
+
+		if (!numa_vma_migratable(vma))
+			continue;
+		if (address < vma->vm_start)
+			address = vma->vm_start;
+		end = vma->vm_end;
+		if ((end - address) >> PAGE_SHIFT > pages - progress)
+			end = address + ((pages - progress) << PAGE_SHIFT);
+
+		change_prot_numa(vma, address, end);
+		progress += (end - address) >> PAGE_SHIFT;
+		address = end;
+		if (progress >= pages)
+			break;
+	}
+	mm->numa_scan_offset = address;
+	up_read(&mm->mmap_sem);
+}
+
+static void knumad_do_scan(void)
+{
+	unsigned long pages;
+	struct mm_struct *mm;
+
+	pages = (unsigned long)numa_balancing_scan_size_mb <<
+		(20 - PAGE_SHIFT);
+
+	spin_lock(&numa_mm_lock);
+	if (list_empty(&numa_mm_head)) {
+		spin_unlock(&numa_mm_lock);
+		return;
+	}
+	knumad_scan_mm = list_entry(numa_mm_head.next, struct mm_struct,
+				    numa_list);
+	while ((mm = knumad_scan_mm) != NULL) {
+		spin_unlock(&numa_mm_lock);
+
+		/* Only sample the memory of tasks which ran */
+		if (mm->numa_ran) {
+			mm->numa_ran = 0;
+			knumad_scan(mm, pages);
+		}
+		cond_resched();
+
+		spin_lock(&numa_mm_lock);
+		if (mm->numa_list.next != &numa_mm_head)
+			knumad_scan_mm = list_entry(mm->numa_list.next,
+					struct mm_struct, numa_list);
+		else
+			knumad_scan_mm = NULL;
+		if (numa_test_exit(mm)) {
+			list_del_init(&mm->numa_list);
+			spin_unlock(&numa_mm_lock);
+			mmdrop(mm);
+			spin_lock(&numa_mm_lock);
+		}
+	}
+	numa_balancing_full_scans++;
+	spin_unlock(&numa_mm_lock);
+}
+
+static int knumad(void *unused)
+{
+	daemonize("knumad");
+	set_user_nice(current, 19);
+
+	for ( ; ; ) {
+		try_to_freeze();
+		if (numa_balancing_enabled && num_online_nodes() > 1)
+			knumad_do_scan();
+		schedule_timeout_interruptible(
+			msecs_to_jiffies(numa_balancing_scan_sleep_millisecs));
+	}
+	return 0;
+}
+
+/*
+ * Hinting faults
+ */
+
+static int numa_migrate_ratelimited(int nid)
+{
+	int ret = 0;
+
+	spin_lock(&numa_migrate_lock);
+	if (time_after(jiffies, numa_migrate_next_window[nid])) {
+		numa_migrate_nr_pages[nid] = 0;
+		numa_migrate_next_window[nid] = jiffies +
+			msecs_to_jiffies(NUMA_MIGRATE_WINDOW_MS);
+	}
+	if (numa_migrate_nr_pages[nid] >= NUMA_MIGRATE_RATELIMIT)
+		ret = 1;
+	else
+		numa_migrate_nr_pages[nid]++;
+	spin_unlock(&numa_migrate_lock);
+	return ret;
+}
+
+/* Misplaced pages only move into free memory: no reclaim for them */
+static int numa_node_has_room(int nid)
+{
+	pg_data_t *pgdat = NODE_DATA(nid);
+	int i;
+
+	for (i = pgdat->nr_zones - 1; i >= 0; i--) {
+		struct zone *zone = pgdat->node_zones + i;
+
+		if (zone->present_pages && zone->free_pages > zone->pages_high)
+			return 1;
+	}
+	return 0;
+}
+
+static struct page *alloc_misplaced_dst_page(struct page *page,
+					     unsigned long nid)
+{
+	struct page *newpage;
+
+	newpage = alloc_pages_node(nid, (GFP_HIGHUSER_MOVABLE |
+				   __GFP_NOWARN | __GFP_NOMEMALLOC) &
+				   ~__GFP_WAIT, 0);
+	if (newpage && page_to_nid(newpage) != nid) {
+		__free_page(newpage);
+		newpage = NULL;
+	}
+	return newpage;
+}
+
+/*
+ * Move @page, which the caller holds a reference on, to node @nid.
+ * Returns nonzero if it was moved.
+ */
+static int migrate_misplaced_page(struct page *page, int nid)
+{
+	struct zone *zone = page_zone(page);
+	LIST_HEAD(pagelist);
+	int isolated;
+
+	/* Pages mapped by several processes would bounce between them */
+	if (page_mapcount(page) != 1)
+		return 0;
+	if (!numa_node_has_room(nid) || numa_migrate_ratelimited(nid))
+		return 0;
+
+	spin_lock_irq(&zone->lru_lock);
+	isolated = !isolate_lru_page(page, &pagelist);
+	spin_unlock_irq(&zone->lru_lock);
+	if (!isolated)
+		return 0;
+
+	if (migrate_pages(&pagelist, alloc_misplaced_dst_page, nid))
+		return 0;
+	inc_page_state(numa_pages_migrated);
+	return 1;
+}
+
+/*
+ * Fold the faults of the last scan into the decaying per node counts,
+ * and prefer the node with the most.
+ */
+static void task_numa_placement(struct task_struct *p)
+{
+	unsigned long *faults = p->numa_faults;
+	unsigned long *buffer = faults + MAX_NUMNODES;
+	unsigned long max_faults = 0;
+	int nid, max_nid = -1;
+
+	p->numa_scan_seq = p->mm->numa_scan_seq;
+	for_each_online_node(nid) {
+		faults[nid] = faults[nid] / 2 + buffer[nid];
+		buffer[nid] = 0;
+		if (faults[nid] > max_faults) {
+			max_faults = faults[nid];
+			max_nid = nid;
+		}
+	}
+	if (max_nid >= 0)
+		p->numa_preferred_nid = max_nid;
+}
+
+static void task_numa_fault(int nid, int local, int migrated)
+{
+	struct task_struct *p = current;
+
+	if (unlikely(!p->numa_faults)) {
+		p->numa_faults = kzalloc(2 * MAX_NUMNODES *
+					 sizeof(unsigned long), GFP_KERNEL);
+		if (!p->numa_faults)
+			return;
+	}
+	if (p->numa_scan_seq != p->mm->numa_scan_seq)
+		task_numa_placement(p);
+
+	p->numa_faults[MAX_NUMNODES + nid]++;
+	if (local)
+		p->numa_faults_local++;
+	else
+		p->numa_faults_remote++;
+	if (migrated)
+		p->numa_pages_migrated++;
+
+	inc_page_state(numa_hint_faults);
+	if (local)
+		inc_page_state(numa_hint_faults_local);
+}
+
+/**
+ * do_numa_page - handle a fault on a NUMA hinting pte
+ *
+ * Makes the pte accessible again, and migrates the page to the node of
+ * the faulting cpu if it is elsewhere.  Entered with the page_table_lock
+ * held, like the other fault handlers, and returns with it released.
+ */
+int do_numa_page(struct mm_struct *mm, struct vm_area_struct *vma,
+		 unsigned long address, pte_t *pte, pmd_t *pmd, pte_t entry)
+{
+	int this_nid = numa_node_id();
+	struct page *page = NULL;
+	int page_nid, migrated = 0;
+
+	/* Nobody else sees the pte present: no hardware updates to race */
+	entry = pte_mkyoung(pte_mknonnuma(entry));
+	set_pte_at(mm, address, pte, entry);
+	update_mmu_cache(vma, address, entry);
+	lazy_mmu_prot_update(entry);
+
+	if (pfn_valid(pte_pfn(entry)))
+		page = pte_page(entry);
+	if (!page || PageReserved(page)) {
+		pte_unmap(pte);
+		spin_unlock(&mm->page_table_lock);
+		return VM_FAULT_MINOR;
+	}
+	get_page(page);
+	pte_unmap(pte);
+	spin_unlock(&mm->page_table_lock);
+
+	page_nid = page_to_nid(page);
+	if (page_nid != this_nid)
+		migrated = migrate_misplaced_page(page, this_nid);
+	put_page(page);
+
+	task_numa_fault(migrated ? this_nid : page_nid,
+			page_nid == this_nid, migrated);
+	return VM_FAULT_MINOR;
+}
+
+void task_numa_free(struct task_struct *p)
+{
+	kfree(p->numa_faults);
+	p->numa_faults = NULL;
+}
+
+/*
+ * The NUMA lines of /proc/<pid>/status: the preferred node, the decaying
+ * faults of each node, and the totals.
+ */
+char *task_numa_status(struct task_struct *p, char *buffer)
+{
+	unsigned long *faults = p->numa_faults;
+	int nid;
+
+	buffer += sprintf(buffer, "NUMA_preferred_node:\t%d\n",
+			  p->numa_preferred_nid);
+	if (faults) {
+		buffer += sprintf(buffer, "NUMA_faults:\t");
+		for_each_online_node(nid)
+			buffer += sprintf(buffer, "%lu ", faults[nid] +
+					  faults[MAX_NUMNODES + nid]);
+		buffer[-1] = '\n';
+	}
+	buffer += sprintf(buffer, "NUMA_faults_local:\t%lu\n"
+			  "NUMA_faults_remote:\t%lu\n"
+			  "NUMA_pages_migrated:\t%lu\n",
+			  p->numa_faults_local, p->numa_faults_remote,
+			  p->numa_pages_migrated);
+	return buffer;
+}
+
+/*
+ * /sys/kernel/mm/numa_balancing
+ */
+
+#define NUMA_BALANCING_ATTR_RO(_name) \
+static struct subsys_attribute _name##_attr = __ATTR_RO(_name)
+
+#define NUMA_BALANCING_ATTR_RW(_name) \
+static struct subsys_attribute _name##_attr = \
+	__ATTR(_name, 0644, _name##_show, _name##_store)
+
+static ssize_t numa_balancing_store_uint(const char *page, size_t count,
+				unsigned int *value, unsigned int min,
+				unsigned int max)
+{
+	char *end;
+	unsigned long val = simple_strtoul(page, &end, 10);
+
+	if (end == page || (*end && *end != '\n') || val < min || val > max)
+		return -EINVAL;
+	*value = val;
+	return count;
+}
+
+static ssize_t enabled_show(struct subsystem *subsys, char *page)
+{
+	return sprintf(page, "%d\n", numa_balancing_enabled);
+}
+
+static ssize_t enabled_store(struct subsystem *subsys, const char *page,
+			     size_t count)
+{
+	unsigned int val;
+	ssize_t ret;
+
+	ret = numa_balancing_store_uint(page, count, &val, 0, 1);
+	if (ret > 0)
+		numa_balancing_enabled = val;
+	return ret;
+}
+NUMA_BALANCING_ATTR_RW(enabled);
+
+static ssize_t scan_size_mb_show(struct subsystem *subsys, char *page)
+{
+	return sprintf(page, "%u\n", numa_balancing_scan_size_mb);
+}
+
+static ssize_t scan_size_mb_store(struct subsystem *subsys, const char *page,
+				  size_t count)
+{
+	return numa_balancing_store_uint(page, count,
+					 &numa_balancing_scan_size_mb,
+					 1, UINT_MAX >> 20);
+}
+NUMA_BALANCING_ATTR_RW(scan_size_mb);
+
+static ssize_t scan_sleep_millisecs_show(struct subsystem *subsys, char *page)
+{
+	return sprintf(page, "%u\n", numa_balancing_scan_sleep_millisecs);
+}
+
+static ssize_t scan_sleep_millisecs_store(struct subsystem *subsys,
+					  const char *page, size_t count)
+{
+	return numa_balancing_store_uint(page, count,
+					 &numa_balancing_scan_sleep_millisecs,
+					 0, UINT_MAX);
+}
+NUMA_BALANCING_ATTR_RW(scan_sleep_millisecs);
+
+static ssize_t full_scans_show(struct subsystem *subsys, char *page)
+{
+	return sprintf(page, "%u\n", numa_balancing_full_scans);
+}
+NUMA_BALANCING_ATTR_RO(full_scans);
+
+static struct attribute *numa_balancing_attrs[] = {
+	&enabled_attr.attr,
+	&scan_size_mb_attr.attr,
+	&scan_sleep_millisecs_attr.attr,
+	&full_scans_attr.attr,
+	NULL
+};
+
+static struct attribute_group numa_balancing_attr_group = {
+	.attrs = numa_balancing_attrs,
+};
+
+static decl_subsys(numa_balancing, NULL, NULL);
+
+static int __init numa_balancing_init(void)
+{
+	int err;
+
+	numa_balancing_subsys.kset.kobj.parent = &mm_subsys.kset.kobj;
+	err = subsystem_register(&numa_balancing_subsys);
+	if (!err)
+		err = sysfs_create_group(&numa_balancing_subsys.kset.kobj,
+					 &numa_balancing_attr_group);
+	if (err)
+		printk(KERN_ERR "numa_balancing: cannot register sysfs files\n");
+
+	kernel_thread(knumad, NULL, CLONE_KERNEL);
+	return 0;
+}
+
+module_init(numa_balancing_init)
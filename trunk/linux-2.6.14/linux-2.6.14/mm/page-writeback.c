@@ -29,6 +29,7 @@
 #include <linux/sysctl.h>
 #include <linux/cpu.h>
 #include <linux/syscalls.h>
+#include <asm/div64.h>
 
 /*
  * The maximum number of pages to writeout in a single bdflush/kupdate
@@ -49,20 +50,15 @@ static long total_pages;	/* The total number of pages in the machine. */
 static int dirty_exceeded;	/* Dirty mem may be over limit */
 
 /*
- * When balance_dirty_pages decides that the caller needs to perform some
- * non-background writeback, this is how many pages it will attempt to write.
- * It should be somewhat larger than RATELIMIT_PAGES to ensure that reasonably
- * large amounts of I/O are submitted.
+ * The longest pause of a task dirtying pages over its device's limit,
+ * before it looks at the limit again.
  */
-static inline long sync_writeback_pages(void)
-{
-	return ratelimit_pages + ratelimit_pages / 2;
-}
+#define MAX_PAUSE	max(HZ/5, 1)
 
 /* The following parameters are exported via /proc/sys/vm */
 
 /*
- * Start background writeback (via pdflush) at this percentage
+ * Start background writeback (via the flusher threads) at this percentage
  */
 int dirty_background_ratio = 10;
 
@@ -97,7 +93,86 @@ EXPORT_SYMBOL(laptop_mode);
 /* End of sysctl-exported parameters */
 
 
-static void background_writeout(unsigned long _min_pages);
+/*
+ * The dirty limit is shared between devices in proportion to how fast
+ * they have been writing back lately.  Each device counts its writeback
+ * completions, and the counts of all devices decay by half every period
+ * of 1 << vm_completions_shift completions in the system: the share of a
+ * device in the recent completions is its share of the dirty limit.
+ *
+ * The halving is done lazily, when a device is looked at next.  Then
+ * all the counts add up to about a period, plus the part of the current
+ * period already gone.
+ */
+static atomic_t vm_completions = ATOMIC_INIT(0);
+static int vm_completions_shift;
+static DEFINE_SPINLOCK(completions_lock);
+
+static inline unsigned int completions_period(void)
+{
+	return (unsigned int)atomic_read(&vm_completions) >>
+					vm_completions_shift;
+}
+
+/*
+ * Halve the completions of @bdi once for each period gone since it was
+ * last looked at.
+ */
+static void bdi_completions_decay(struct backing_dev_info *bdi)
+{
+	unsigned int period = completions_period();
+	unsigned int missed;
+	unsigned long flags;
+	int val;
+
+	if (bdi->completions_period == period)
+		return;
+
+	spin_lock_irqsave(&completions_lock, flags);
+	if (bdi->completions_period != period) {
+		missed = (period - bdi->completions_period) &
+					(~0U >> vm_completions_shift);
+		val = atomic_read(&bdi->completions);
+		if (missed < 8 * sizeof(int))
+			val -= val >> missed;
+		atomic_sub(val, &bdi->completions);
+		bdi->completions_period = period;
+	}
+	spin_unlock_irqrestore(&completions_lock, flags);
+}
+
+/*
+ * Count a writeback completion against @bdi: called as pages come out of
+ * writeback, maybe from interrupts.
+ */
+void bdi_writeout_inc(struct backing_dev_info *bdi)
+{
+	bdi_completions_decay(bdi);
+	atomic_inc(&bdi->completions);
+	atomic_inc(&vm_completions);
+}
+EXPORT_SYMBOL(bdi_writeout_inc);
+
+/*
+ * The share of @bdi in the global dirty limit @dirty, in pages.
+ */
+static long bdi_dirty_share(struct backing_dev_info *bdi, long dirty)
+{
+	unsigned long period_size = 1UL << vm_completions_shift;
+	unsigned long numerator, denominator;
+	u64 share;
+
+	bdi_completions_decay(bdi);
+	numerator = max(atomic_read(&bdi->completions), 0);
+	denominator = period_size + ((unsigned int)atomic_read(&vm_completions)
+						& (period_size - 1));
+	if (numerator > denominator)
+		numerator = denominator;
+
+	share = (u64)dirty * numerator;
+	do_div(share, denominator);
+	return share;
+}
 
 struct writeback_state
 {
@@ -131,10 +206,13 @@ static void get_writeback_state(struct writeback_state *wbs)
  *
  * We make sure that the background writeout level is below the adjusted
  * clamping level.
+ *
+ * If @pbdi_dirty is given, it gets the share of the clamping level which
+ * belongs to the device behind @mapping.
  */
 static void
 get_dirty_limits(struct writeback_state *wbs, long *pbackground, long *pdirty,
-		struct address_space *mapping)
+		long *pbdi_dirty, struct address_space *mapping)
 {
 	int background_ratio;		/* Percentages */
 	int dirty_ratio;
@@ -178,41 +256,56 @@ get_dirty_limits(struct writeback_state *wbs, long *pbackground, long *pdirty,
 	}
 	*pbackground = background;
 	*pdirty = dirty;
+	if (pbdi_dirty)
+		*pbdi_dirty = bdi_dirty_share(mapping->backing_dev_info, dirty);
 }
 
+/*
+ * The dirty limit of @bdi as it stands, in pages: for the sysfs counters.
+ */
+unsigned long bdi_dirty_limit(struct backing_dev_info *bdi)
+{
+	struct writeback_state wbs;
+	long background_thresh;
+	long dirty_thresh;
+
+	get_dirty_limits(&wbs, &background_thresh, &dirty_thresh, NULL, NULL);
+	return bdi_dirty_share(bdi, dirty_thresh);
+}
+EXPORT_SYMBOL(bdi_dirty_limit);
+
 /*
  * balance_dirty_pages() must be called by processes which are generating dirty
- * data.  It looks at the number of dirty pages in the machine and will force
- * the caller to perform writeback if the system is over `vm_dirty_ratio'.
- * If we're over `background_thresh' then pdflush is woken to perform some
- * writeout.
+ * data.  It looks at the number of dirty pages in the machine and on the
+ * device being written to, and pauses the caller while the device is over
+ * its share of `vm_dirty_ratio'.  The caller does no writeout itself: the
+ * device's flusher thread is woken to do it, and the pause is longer the
+ * further the device is over its limit, so that dirtiers are slowed down to
+ * the pace of the writeback.  If we're over `background_thresh' then the
+ * flusher is woken to perform some writeout.
+ *
+ * While the machine is well below the dirty limit (halfway between the
+ * background and dirty thresholds) nobody is held up, however much a single
+ * device has dirtied.
  */
 static void balance_dirty_pages(struct address_space *mapping)
 {
 	struct writeback_state wbs;
 	long nr_reclaimable;
+	long bdi_nr_reclaimable;
+	long bdi_nr_writeback;
 	long background_thresh;
 	long dirty_thresh;
-	unsigned long pages_written = 0;
-	unsigned long write_chunk = sync_writeback_pages();
+	long bdi_thresh;
+	long over;
+	long pause;
+	int throttled = 0;
 
 	struct backing_dev_info *bdi = mapping->backing_dev_info;
 
 	for (;;) {
-		struct writeback_control wbc = {
-			.bdi		= bdi,
-			.sync_mode	= WB_SYNC_NONE,
-			.older_than_this = NULL,
-			.nr_to_write	= write_chunk,
-		};
-
 		get_dirty_limits(&wbs, &background_thresh,
-					&dirty_thresh, mapping);
-		nr_reclaimable = wbs.nr_dirty + wbs.nr_unstable;
-		if (nr_reclaimable + wbs.nr_writeback <= dirty_thresh)
-			break;
-
-		dirty_exceeded = 1;
+					&dirty_thresh, &bdi_thresh, mapping);
 
 		/* Note: nr_reclaimable denotes nr_dirty + nr_unstable.
 		 * Unstable writes are a feature of certain networked
@@ -220,25 +313,38 @@ static void balance_dirty_pages(struct address_space *mapping)
 		 * written to the server's write cache, but has not yet
 		 * been flushed to permanent storage.
 		 */
-		if (nr_reclaimable) {
-			writeback_inodes(&wbc);
-			get_dirty_limits(&wbs, &background_thresh,
-					&dirty_thresh, mapping);
-			nr_reclaimable = wbs.nr_dirty + wbs.nr_unstable;
-			if (nr_reclaimable + wbs.nr_writeback <= dirty_thresh)
-				break;
-			pages_written += write_chunk - wbc.nr_to_write;
-			if (pages_written >= write_chunk)
-				break;		/* We've done our duty */
+		nr_reclaimable = wbs.nr_dirty + wbs.nr_unstable;
+		if (nr_reclaimable + wbs.nr_writeback <=
+				(background_thresh + dirty_thresh) / 2)
+			break;
+
+		bdi_nr_reclaimable = bdi_stat(bdi, BDI_RECLAIMABLE);
+		bdi_nr_writeback = bdi_stat(bdi, BDI_WRITEBACK);
+		over = bdi_nr_reclaimable + bdi_nr_writeback - bdi_thresh;
+		if (over <= 0)
+			break;
+
+		if (!throttled) {
+			throttled = 1;
+			dirty_exceeded = 1;
 		}
-		blk_congestion_wait(WRITE, HZ/10);
+		if (!writeback_in_progress(bdi))
+			bdi_start_writeback(bdi, 0);
+
+		pause = over * MAX_PAUSE / (bdi_thresh / 8 + 1);
+		if (pause < 1)
+			pause = 1;
+		if (pause > MAX_PAUSE)
+			pause = MAX_PAUSE;
+		set_current_state(TASK_UNINTERRUPTIBLE);
+		io_schedule_timeout(pause);
 	}
 
 	if (nr_reclaimable + wbs.nr_writeback <= dirty_thresh)
 		dirty_exceeded = 0;
 
 	if (writeback_in_progress(bdi))
-		return;		/* pdflush is already working this queue */
+		return;		/* the flusher is already working this queue */
 
 	/*
 	 * In laptop mode, we wait until hitting the higher threshold before
@@ -248,9 +354,9 @@ static void balance_dirty_pages(struct address_space *mapping)
 	 * In normal mode, we start background writeout at the lower
 	 * background_thresh, to keep the amount of dirty memory low.
 	 */
-	if ((laptop_mode && pages_written) ||
+	if ((laptop_mode && throttled) ||
 	     (!laptop_mode && (nr_reclaimable > background_thresh)))
-		pdflush_operation(background_writeout, 0);
+		bdi_start_writeback(bdi, 0);
 }
 
 /**
@@ -296,7 +402,8 @@ void throttle_vm_writeout(void)
 	long dirty_thresh;
 
         for ( ; ; ) {
-		get_dirty_limits(&wbs, &background_thresh, &dirty_thresh, NULL);
+		get_dirty_limits(&wbs, &background_thresh, &dirty_thresh,
+					NULL, NULL);
 
                 /*
                  * Boost the allowable dirty threshold a bit for page
@@ -312,47 +419,54 @@ void throttle_vm_writeout(void)
 
 
 /*
- * writeback at least _min_pages, and keep writing until the amount of dirty
- * memory is less than the background threshold, or until we're all clean.
+ * Background writeout, done by the flusher thread of `bdi': write back at
+ * least min_pages of its pages, and keep writing while the amount of dirty
+ * memory is over the background threshold or the device is over its dirty
+ * limit, or until it is all clean.  Dirtiers paused in balance_dirty_pages
+ * rely on the latter to bring their device back under its limit.
+ *
+ * The flusher has the device to itself, so it waits on a congested queue
+ * rather than skipping it.  Returns the number of pages written.
  */
-static void background_writeout(unsigned long _min_pages)
+long bdi_background_writeout(struct backing_dev_info *bdi, long min_pages)
 {
-	long min_pages = _min_pages;
+	long written = 0;
 	struct writeback_control wbc = {
-		.bdi		= NULL,
+		.bdi		= bdi,
 		.sync_mode	= WB_SYNC_NONE,
 		.older_than_this = NULL,
 		.nr_to_write	= 0,
-		.nonblocking	= 1,
 	};
 
 	for ( ; ; ) {
 		struct writeback_state wbs;
 		long background_thresh;
 		long dirty_thresh;
-
-		get_dirty_limits(&wbs, &background_thresh, &dirty_thresh, NULL);
-		if (wbs.nr_dirty + wbs.nr_unstable < background_thresh
-				&& min_pages <= 0)
+		long bdi_thresh;
+
+		get_dirty_limits(&wbs, &background_thresh, &dirty_thresh,
+					NULL, NULL);
+		bdi_thresh = bdi_dirty_share(bdi, dirty_thresh);
+		if (wbs.nr_dirty + wbs.nr_unstable < background_thresh &&
+		    bdi_stat(bdi, BDI_RECLAIMABLE) +
+				bdi_stat(bdi, BDI_WRITEBACK) <= bdi_thresh &&
+		    min_pages <= 0)
 			break;
-		wbc.encountered_congestion = 0;
 		wbc.nr_to_write = MAX_WRITEBACK_PAGES;
 		wbc.pages_skipped = 0;
 		writeback_inodes(&wbc);
 		min_pages -= MAX_WRITEBACK_PAGES - wbc.nr_to_write;
-		if (wbc.nr_to_write > 0 || wbc.pages_skipped > 0) {
-			/* Wrote less than expected */
-			blk_congestion_wait(WRITE, HZ/10);
-			if (!wbc.encountered_congestion)
-				break;
-		}
+		written += MAX_WRITEBACK_PAGES - wbc.nr_to_write;
+		if (wbc.nr_to_write > 0 || wbc.pages_skipped > 0)
+			break;		/* Wrote less than expected */
 	}
+	return written;
 }
 
 /*
- * Start writeback of `nr_pages' pages.  If `nr_pages' is zero, write back
- * the whole world.  Returns 0 if a pdflush thread was dispatched.  Returns
- * -1 if all pdflush threads were busy.
+ * Start writeback of `nr_pages' pages on each device.  If `nr_pages' is zero,
+ * write back the whole world.  The flusher threads of the devices do the
+ * work; returns 0.
  */
 int wakeup_pdflush(long nr_pages)
 {
@@ -362,70 +476,55 @@ int wakeup_pdflush(long nr_pages)
 		get_writeback_state(&wbs);
 		nr_pages = wbs.nr_dirty + wbs.nr_unstable;
 	}
-	return pdflush_operation(background_writeout, nr_pages);
+	bdi_writeback_all(nr_pages);
+	return 0;
 }
 
-static void wb_timer_fn(unsigned long unused);
 static void laptop_timer_fn(unsigned long unused);
 
-static DEFINE_TIMER(wb_timer, wb_timer_fn, 0, 0);
 static DEFINE_TIMER(laptop_mode_wb_timer, laptop_timer_fn, 0, 0);
 
 /*
- * Periodic writeback of "old" data.
+ * Periodic writeback of "old" data, done by the flusher thread of `bdi' once
+ * per dirty_writeback_centisecs.
  *
  * Define "old": the first time one of an inode's pages is dirtied, we mark the
  * dirtying-time in the inode's address_space.  So this periodic writeback code
  * just walks the superblock inode list, writing back any inodes which are
  * older than a specific point in time.
  *
- * Try to run once per dirty_writeback_centisecs.  But if a writeback event
- * takes longer than a dirty_writeback_centisecs interval, then leave a
- * one-second gap.
- *
  * older_than_this takes precedence over nr_to_write.  So we'll only write back
  * all dirty pages if they are all attached to "old" mappings.
+ *
+ * Returns the number of pages written.
  */
-static void wb_kupdate(unsigned long arg)
+long bdi_kupdate(struct backing_dev_info *bdi)
 {
 	unsigned long oldest_jif;
-	unsigned long start_jif;
-	unsigned long next_jif;
 	long nr_to_write;
+	long written = 0;
 	struct writeback_state wbs;
 	struct writeback_control wbc = {
-		.bdi		= NULL,
+		.bdi		= bdi,
 		.sync_mode	= WB_SYNC_NONE,
 		.older_than_this = &oldest_jif,
 		.nr_to_write	= 0,
-		.nonblocking	= 1,
 		.for_kupdate	= 1,
 	};
 
-	sync_supers();
-
 	get_writeback_state(&wbs);
 	oldest_jif = jiffies - (dirty_expire_centisecs * HZ) / 100;
-	start_jif = jiffies;
-	next_jif = start_jif + (dirty_writeback_centisecs * HZ) / 100;
 	nr_to_write = wbs.nr_dirty + wbs.nr_unstable +
-			(inodes_stat.nr_inodes - inodes_stat.nr_unused);
+			(inodes_stat.nr_inodes - get_nr_inodes_unused());
 	while (nr_to_write > 0) {
-		wbc.encountered_congestion = 0;
 		wbc.nr_to_write = MAX_WRITEBACK_PAGES;
 		writeback_inodes(&wbc);
-		if (wbc.nr_to_write > 0) {
-			if (wbc.encountered_congestion)
-				blk_congestion_wait(WRITE, HZ/10);
-			else
-				break;	/* All the old data is written */
-		}
-		nr_to_write -= MAX_WRITEBACK_PAGES - wbc.nr_to_write;
+		written += MAX_WRITEBACK_PAGES - wbc.nr_to_write;
+		if (wbc.nr_to_write > 0)
+			break;	/* All the old data is written */
+		nr_to_write -= MAX_WRITEBACK_PAGES;
 	}
-	if (time_before(next_jif, jiffies + HZ))
-		next_jif = jiffies + HZ;
-	if (dirty_writeback_centisecs)
-		mod_timer(&wb_timer, next_jif);
+	return written;
 }
 
 /*
@@ -435,21 +534,11 @@ int dirty_writeback_centisecs_handler(ctl_table *table, int write,
 		struct file *file, void __user *buffer, size_t *length, loff_t *ppos)
 {
 	proc_dointvec(table, write, file, buffer, length, ppos);
-	if (dirty_writeback_centisecs) {
-		mod_timer(&wb_timer,
-			jiffies + (dirty_writeback_centisecs * HZ) / 100);
-	} else {
-		del_timer(&wb_timer);
-	}
+	if (write)
+		bdi_wakeup_flushers();
 	return 0;
 }
 
-static void wb_timer_fn(unsigned long unused)
-{
-	if (pdflush_operation(wb_kupdate, 0) < 0)
-		mod_timer(&wb_timer, jiffies + HZ); /* delay 1 second */
-}
-
 static void laptop_flush(unsigned long unused)
 {
 	sys_sync();
@@ -543,7 +632,12 @@ void __init page_writeback_init(void)
 		if (vm_dirty_ratio <= 0)
 			vm_dirty_ratio = 1;
 	}
-	mod_timer(&wb_timer, jiffies + (dirty_writeback_centisecs * HZ) / 100);
+
+	/*
+	 * Let the device shares of the dirty limit follow the writeback
+	 * completions over about twice the limit's worth of pages.
+	 */
+	vm_completions_shift = fls(total_pages * vm_dirty_ratio / 100) + 1;
 	set_ratelimit();
 	register_cpu_notifier(&ratelimit_nb);
 }
@@ -621,16 +715,19 @@ int __set_page_dirty_nobuffers(struct page *page)
 		struct address_space *mapping2;
 
 		if (mapping) {
-			write_lock_irq(&mapping->tree_lock);
+			spin_lock_irq(&mapping->tree_lock);
 			mapping2 = page_mapping(page);
 			if (mapping2) { /* Race with truncate? */
 				BUG_ON(mapping2 != mapping);
-				if (mapping_cap_account_dirty(mapping))
+				if (mapping_cap_account_dirty(mapping)) {
 					inc_page_state(nr_dirty);
+					bdi_stat_inc(mapping->backing_dev_info,
+							BDI_RECLAIMABLE);
+				}
 				radix_tree_tag_set(&mapping->page_tree,
 					page_index(page), PAGECACHE_TAG_DIRTY);
 			}
-			write_unlock_irq(&mapping->tree_lock);
+			spin_unlock_irq(&mapping->tree_lock);
 			if (mapping->host) {
 				/* !PageAnon && !swapper_space */
 				__mark_inode_dirty(mapping->host,
@@ -705,17 +802,20 @@ int test_clear_page_dirty(struct page *page)
 	unsigned long flags;
 
 	if (mapping) {
-		write_lock_irqsave(&mapping->tree_lock, flags);
+		spin_lock_irqsave(&mapping->tree_lock, flags);
 		if (TestClearPageDirty(page)) {
 			radix_tree_tag_clear(&mapping->page_tree,
 						page_index(page),
 						PAGECACHE_TAG_DIRTY);
-			write_unlock_irqrestore(&mapping->tree_lock, flags);
-			if (mapping_cap_account_dirty(mapping))
+			spin_unlock_irqrestore(&mapping->tree_lock, flags);
+			if (mapping_cap_account_dirty(mapping)) {
 				dec_page_state(nr_dirty);
+				bdi_stat_dec(mapping->backing_dev_info,
+						BDI_RECLAIMABLE);
+			}
 			return 1;
 		}
-		write_unlock_irqrestore(&mapping->tree_lock, flags);
+		spin_unlock_irqrestore(&mapping->tree_lock, flags);
 		return 0;
 	}
 	return TestClearPageDirty(page);
@@ -742,8 +842,11 @@ int clear_page_dirty_for_io(struct page *page)
 
 	if (mapping) {
 		if (TestClearPageDirty(page)) {
-			if (mapping_cap_account_dirty(mapping))
+			if (mapping_cap_account_dirty(mapping)) {
 				dec_page_state(nr_dirty);
+				bdi_stat_dec(mapping->backing_dev_info,
+						BDI_RECLAIMABLE);
+			}
 			return 1;
 		}
 		return 0;
@@ -760,13 +863,19 @@ int test_clear_page_writeback(struct page *page)
 	if (mapping) {
 		unsigned long flags;
 
-		write_lock_irqsave(&mapping->tree_lock, flags);
+		spin_lock_irqsave(&mapping->tree_lock, flags);
 		ret = TestClearPageWriteback(page);
 		if (ret)
 			radix_tree_tag_clear(&mapping->page_tree,
 						page_index(page),
 						PAGECACHE_TAG_WRITEBACK);
-		write_unlock_irqrestore(&mapping->tree_lock, flags);
+		spin_unlock_irqrestore(&mapping->tree_lock, flags);
+		if (ret && mapping_cap_account_dirty(mapping)) {
+			struct backing_dev_info *bdi = mapping->backing_dev_info;
+
+			bdi_stat_dec(bdi, BDI_WRITEBACK);
+			bdi_writeout_inc(bdi);
+		}
 	} else {
 		ret = TestClearPageWriteback(page);
 	}
@@ -781,7 +890,7 @@ int test_set_page_writeback(struct page *page)
 	if (mapping) {
 		unsigned long flags;
 
-		write_lock_irqsave(&mapping->tree_lock, flags);
+		spin_lock_irqsave(&mapping->tree_lock, flags);
 		ret = TestSetPageWriteback(page);
 		if (!ret)
 			radix_tree_tag_set(&mapping->page_tree,
@@ -791,7 +900,9 @@ int test_set_page_writeback(struct page *page)
 			radix_tree_tag_clear(&mapping->page_tree,
 						page_index(page),
 						PAGECACHE_TAG_DIRTY);
-		write_unlock_irqrestore(&mapping->tree_lock, flags);
+		spin_unlock_irqrestore(&mapping->tree_lock, flags);
+		if (!ret && mapping_cap_account_dirty(mapping))
+			bdi_stat_inc(mapping->backing_dev_info, BDI_WRITEBACK);
 	} else {
 		ret = TestSetPageWriteback(page);
 	}
@@ -806,12 +917,11 @@ EXPORT_SYMBOL(test_set_page_writeback);
  */
 int mapping_tagged(struct address_space *mapping, int tag)
 {
-	unsigned long flags;
 	int ret;
 
-	read_lock_irqsave(&mapping->tree_lock, flags);
+	rcu_read_lock();
 	ret = radix_tree_tagged(&mapping->page_tree, tag);
-	read_unlock_irqrestore(&mapping->tree_lock, flags);
+	rcu_read_unlock();
 	return ret;
 }
 EXPORT_SYMBOL(mapping_tagged);
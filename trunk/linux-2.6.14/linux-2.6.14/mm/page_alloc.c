@@ -35,8 +35,10 @@
 #include <linux/cpuset.h>
 #include <linux/nodemask.h>
 #include <linux/vmalloc.h>
+#include <linux/compaction.h>
 
 #include <asm/tlbflush.h>
+#include <asm/div64.h>
 #include "internal.h"
 
 /*
@@ -114,7 +116,8 @@ static void bad_page(const char *function, struct page *page)
 			1 << PG_reclaim |
 			1 << PG_slab    |
 			1 << PG_swapcache |
-			1 << PG_writeback);
+			1 << PG_writeback |
+			1 << PG_unevictable);
 	set_page_count(page, 0);
 	reset_page_mapcount(page);
 	page->mapping = NULL;
@@ -200,6 +203,48 @@ static inline void rmv_page_order(struct page *page)
 	page->private = 0;
 }
 
+/*
+ * The migrate type of the pageblock @page is in.  It is set under
+ * zone->lock, but may be read without it: a stale type only puts a
+ * page on a less suitable free list.
+ */
+static inline unsigned long pageblock_bitidx(struct zone *zone,
+					     unsigned long pfn)
+{
+	return ((pfn >> pageblock_order) -
+		(zone->zone_start_pfn >> pageblock_order)) * NR_PAGEBLOCK_BITS;
+}
+
+static void __set_pageblock_migratetype(struct zone *zone, unsigned long pfn,
+					int migratetype)
+{
+	unsigned long bitidx = pageblock_bitidx(zone, pfn);
+
+	if (migratetype & 1)
+		__set_bit(bitidx, zone->pageblock_flags);
+	else
+		__clear_bit(bitidx, zone->pageblock_flags);
+	if (migratetype & 2)
+		__set_bit(bitidx + 1, zone->pageblock_flags);
+	else
+		__clear_bit(bitidx + 1, zone->pageblock_flags);
+}
+
+int get_pageblock_migratetype(struct page *page)
+{
+	struct zone *zone = page_zone(page);
+	unsigned long bitidx = pageblock_bitidx(zone, page_to_pfn(page));
+
+	return test_bit(bitidx, zone->pageblock_flags) |
+		test_bit(bitidx + 1, zone->pageblock_flags) << 1;
+}
+
+static void set_pageblock_migratetype(struct page *page, int migratetype)
+{
+	__set_pageblock_migratetype(page_zone(page), page_to_pfn(page),
+				    migratetype);
+}
+
 /*
  * Locate the struct page for both the matching buddy in our
  * pair (buddy1) and the combined O(n+1) page they form (page).
@@ -279,6 +324,7 @@ static inline void __free_pages_bulk (struct page *page,
 {
 	unsigned long page_idx;
 	int order_size = 1 << order;
+	int migratetype = get_pageblock_migratetype(page);
 
 	if (unlikely(order))
 		destroy_compound_page(page, order);
@@ -310,7 +356,7 @@ static inline void __free_pages_bulk (struct page *page,
 		order++;
 	}
 	set_page_order(page, order);
-	list_add(&page->lru, &zone->free_area[order].free_list);
+	list_add(&page->lru, &zone->free_area[order].free_list[migratetype]);
 	zone->free_area[order].nr_free++;
 }
 
@@ -327,10 +373,14 @@ static inline void free_pages_check(const char *function, struct page *page)
 			1 << PG_reclaim	|
 			1 << PG_slab	|
 			1 << PG_swapcache |
-			1 << PG_writeback )))
+			1 << PG_writeback |
+			1 << PG_unevictable )))
 		bad_page(function, page);
 	if (PageDirty(page))
 		__ClearPageDirty(page);
+	/* Whether a page is swap backed is decided anew for each user */
+	if (PageSwapBacked(page))
+		__ClearPageSwapBacked(page);
 }
 
 /*
@@ -405,7 +455,7 @@ void __free_pages_ok(struct page *page, unsigned int order)
  */
 static inline struct page *
 expand(struct zone *zone, struct page *page,
- 	int low, int high, struct free_area *area)
+ 	int low, int high, struct free_area *area, int migratetype)
 {
 	unsigned long size = 1 << high;
 
@@ -414,7 +464,7 @@ expand(struct zone *zone, struct page *page,
 		high--;
 		size >>= 1;
 		BUG_ON(bad_range(zone, &page[size]));
-		list_add(&page[size].lru, &area->free_list);
+		list_add(&page[size].lru, &area->free_list[migratetype]);
 		area->nr_free++;
 		set_page_order(&page[size], high);
 	}
@@ -455,22 +505,25 @@ static void prep_new_page(struct page *page, int order)
 			1 << PG_reclaim	|
 			1 << PG_slab    |
 			1 << PG_swapcache |
-			1 << PG_writeback )))
+			1 << PG_writeback |
+			1 << PG_unevictable )))
 		bad_page(__FUNCTION__, page);
 
 	page->flags &= ~(1 << PG_uptodate | 1 << PG_error |
 			1 << PG_referenced | 1 << PG_arch_1 |
-			1 << PG_checked | 1 << PG_mappedtodisk);
+			1 << PG_checked | 1 << PG_mappedtodisk |
+			1 << PG_readahead);
 	page->private = 0;
 	set_page_refs(page, order);
 	kernel_map_pages(page, 1 << order, 1);
 }
 
-/* 
- * Do the hard work of removing an element from the buddy allocator.
- * Call me with the zone->lock already held.
+/*
+ * Take the smallest block of at least @order off the free lists of
+ * @migratetype.
  */
-static struct page *__rmqueue(struct zone *zone, unsigned int order)
+static struct page *__rmqueue_smallest(struct zone *zone, unsigned int order,
+				       int migratetype)
 {
 	struct free_area * area;
 	unsigned int current_order;
@@ -478,27 +531,193 @@ static struct page *__rmqueue(struct zone *zone, unsigned int order)
 
 	for (current_order = order; current_order < MAX_ORDER; ++current_order) {
 		area = zone->free_area + current_order;
-		if (list_empty(&area->free_list))
+		if (list_empty(&area->free_list[migratetype]))
 			continue;
 
-		page = list_entry(area->free_list.next, struct page, lru);
+		page = list_entry(area->free_list[migratetype].next,
+				  struct page, lru);
 		list_del(&page->lru);
 		rmv_page_order(page);
 		area->nr_free--;
 		zone->free_pages -= 1UL << order;
-		return expand(zone, page, order, current_order, area);
+		return expand(zone, page, order, current_order, area,
+			      migratetype);
+	}
+
+	return NULL;
+}
+
+/*
+ * The free lists to take pages from, in order, when the lists of a
+ * migrate type are empty.
+ */
+static const int fallbacks[MIGRATE_TYPES][MIGRATE_TYPES - 1] = {
+	[MIGRATE_UNMOVABLE]   = { MIGRATE_RECLAIMABLE, MIGRATE_MOVABLE },
+	[MIGRATE_RECLAIMABLE] = { MIGRATE_UNMOVABLE,   MIGRATE_MOVABLE },
+	[MIGRATE_MOVABLE]     = { MIGRATE_RECLAIMABLE, MIGRATE_UNMOVABLE },
+};
+
+/*
+ * Move the free blocks of the pageblock @page is in onto the free lists
+ * of @migratetype.  Returns the number of pages moved.
+ */
+static int move_freepages_block(struct zone *zone, struct page *page,
+				int migratetype)
+{
+	unsigned long start_pfn, end_pfn, pfn;
+	int order, pages_moved = 0;
+
+	start_pfn = page_to_pfn(page) & ~(pageblock_nr_pages - 1);
+	end_pfn = start_pfn + pageblock_nr_pages;
+
+	/* Do not cross zone boundaries */
+	if (start_pfn < zone->zone_start_pfn)
+		start_pfn = page_to_pfn(page);
+	if (end_pfn > zone->zone_start_pfn + zone->spanned_pages)
+		return 0;
+
+	for (pfn = start_pfn; pfn < end_pfn; pfn++) {
+		if (!pfn_valid(pfn))
+			continue;
+		page = pfn_to_page(pfn);
+		if (!PagePrivate(page) || page_count(page) ||
+		    PageReserved(page))
+			continue;
+
+		/* The head of a free block, see page_is_buddy() */
+		order = page_order(page);
+		list_del(&page->lru);
+		list_add(&page->lru,
+			 &zone->free_area[order].free_list[migratetype]);
+		pfn += (1 << order) - 1;
+		pages_moved += 1 << order;
+	}
+	return pages_moved;
+}
+
+/*
+ * Take a block off the free lists of another migrate type.  The largest
+ * block is taken, so that the fewest pageblocks end up with mixed
+ * types.  If that is a large part of a pageblock, or the allocation is
+ * a reclaimable one which would otherwise spread over many blocks, the
+ * free pages of the whole pageblock move to @start_migratetype, and the
+ * pageblock changes type if more than half of it was free.
+ */
+static struct page *__rmqueue_fallback(struct zone *zone, int order,
+				       int start_migratetype)
+{
+	struct free_area * area;
+	int current_order;
+	struct page *page;
+	int migratetype, i;
+
+	for (current_order = MAX_ORDER - 1; current_order >= order;
+	     --current_order) {
+		for (i = 0; i < MIGRATE_TYPES - 1; i++) {
+			migratetype = fallbacks[start_migratetype][i];
+			area = zone->free_area + current_order;
+			if (list_empty(&area->free_list[migratetype]))
+				continue;
+
+			page = list_entry(area->free_list[migratetype].next,
+					  struct page, lru);
+			area->nr_free--;
+
+			if (unlikely(current_order >= (pageblock_order >> 1)) ||
+			    start_migratetype == MIGRATE_RECLAIMABLE) {
+				int pages;
+
+				pages = move_freepages_block(zone, page,
+							     start_migratetype);
+				if (pages >= (1 << (pageblock_order - 1)))
+					set_pageblock_migratetype(page,
+							start_migratetype);
+				migratetype = start_migratetype;
+			}
+
+			list_del(&page->lru);
+			rmv_page_order(page);
+			zone->free_pages -= 1UL << order;
+
+			if (current_order == pageblock_order)
+				set_pageblock_migratetype(page,
+							  start_migratetype);
+
+			return expand(zone, page, order, current_order, area,
+				      migratetype);
+		}
 	}
 
 	return NULL;
 }
 
+/* 
+ * Do the hard work of removing an element from the buddy allocator.
+ * Call me with the zone->lock already held.
+ */
+static struct page *__rmqueue(struct zone *zone, unsigned int order,
+			      int migratetype)
+{
+	struct page *page;
+
+	page = __rmqueue_smallest(zone, order, migratetype);
+	if (unlikely(!page))
+		page = __rmqueue_fallback(zone, order, migratetype);
+	return page;
+}
+
+#ifdef CONFIG_COMPACTION
+/*
+ * Take the free block headed by @page off the buddy lists and put its
+ * pages on @list as separate order-0 pages, prepared as if they had been
+ * allocated, for compaction to migrate into.  Returns the number of pages
+ * taken, 0 if @page is not the head of a free block.
+ * Call me with the zone->lock already held.
+ */
+int isolate_free_block(struct zone *zone, struct page *page,
+		       struct list_head *list)
+{
+	int order, i;
+
+	if (!PagePrivate(page) || page_count(page) || PageReserved(page))
+		return 0;
+
+	order = page_order(page);
+	list_del(&page->lru);
+	rmv_page_order(page);
+	zone->free_area[order].nr_free--;
+	zone->free_pages -= 1UL << order;
+
+	for (i = 0; i < (1 << order); i++) {
+		prep_new_page(page + i, 0);
+		list_add_tail(&page[i].lru, list);
+	}
+	return 1 << order;
+}
+#endif
+
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+/*
+ * Turn a freshly allocated higher order page into 1 << @order
+ * independent order-0 pages, each holding one reference.
+ */
+void split_page(struct page *page, unsigned int order)
+{
+	int i;
+
+	for (i = 1; i < (1 << order); i++)
+		set_page_count(page + i, 1);
+}
+#endif
+
 /* 
  * Obtain a specified number of elements from the buddy allocator, all under
  * a single hold of the lock, for efficiency.  Add them to the supplied list.
  * Returns the number of new pages which were placed at *list.
  */
 static int rmqueue_bulk(struct zone *zone, unsigned int order, 
-			unsigned long count, struct list_head *list)
+			unsigned long count, struct list_head *list,
+			int migratetype)
 {
 	unsigned long flags;
 	int i;
@@ -507,16 +726,65 @@ static int rmqueue_bulk(struct zone *zone, unsigned int order,
 	
 	spin_lock_irqsave(&zone->lock, flags);
 	for (i = 0; i < count; ++i) {
-		page = __rmqueue(zone, order);
+		page = __rmqueue(zone, order, migratetype);
 		if (page == NULL)
 			break;
 		allocated++;
+		/* The per cpu lists keep the type the page was taken for */
+		page->private = migratetype;
 		list_add_tail(&page->lru, list);
 	}
 	spin_unlock_irqrestore(&zone->lock, flags);
 	return allocated;
 }
 
+/*
+ * The per cpu lists start out with a batch size derived from the zone
+ * size.  A cpu which has to go to the buddy lists again within the same
+ * tick doubles its batch, up to PCP_BATCH_SCALE times the base size, so
+ * that busy cpus take zone->lock less often.  Once a cpu has not needed
+ * the buddy lists for a second, the batch is halved again.
+ *
+ * The batch stays at a 2^n - 1 value, see zone_batchsize().
+ */
+#define PCP_BATCH_SCALE	4
+
+static void pcp_set_batch(struct per_cpu_pages *pcp, int batch, int cold)
+{
+	pcp->batch = max(1, batch);
+	if (cold) {
+		pcp->low = 0;
+		pcp->high = 2 * batch;
+	} else {
+		pcp->low = 2 * batch;
+		pcp->high = 6 * batch;
+	}
+}
+
+/*
+ * Called with interrupts disabled before each refill or drain of @pcp.
+ */
+static void pcp_adapt_batch(struct per_cpu_pages *pcp, int cold)
+{
+	unsigned long now = jiffies;
+	int batch = pcp->batch;
+
+	/* The boot pagesets must keep handing pages straight through */
+	if (!pcp->base_batch)
+		return;
+
+	if (now == pcp->stamp) {
+		if (batch < pcp->base_batch * PCP_BATCH_SCALE)
+			batch = 2 * batch + 1;
+	} else if (time_after(now, pcp->stamp + HZ)) {
+		if (batch > pcp->base_batch)
+			batch = (batch - 1) / 2;
+	}
+	pcp->stamp = now;
+	if (batch != pcp->batch)
+		pcp_set_batch(pcp, batch, cold);
+}
+
 #ifdef CONFIG_NUMA
 /* Called from the slab reaper to drain remote pagesets */
 void drain_remote_pages(void)
@@ -573,7 +841,7 @@ static void __drain_pages(unsigned int cpu)
 void mark_free_pages(struct zone *zone)
 {
 	unsigned long zone_pfn, flags;
-	int order;
+	int order, t;
 	struct list_head *curr;
 
 	if (!zone->spanned_pages)
@@ -583,8 +851,8 @@ void mark_free_pages(struct zone *zone)
 	for (zone_pfn = 0; zone_pfn < zone->spanned_pages; ++zone_pfn)
 		ClearPageNosaveFree(pfn_to_page(zone_pfn + zone->zone_start_pfn));
 
-	for (order = MAX_ORDER - 1; order >= 0; --order)
-		list_for_each(curr, &zone->free_area[order].free_list) {
+	for_each_migratetype_order(order, t)
+		list_for_each(curr, &zone->free_area[order].free_list[t]) {
 			unsigned long start_pfn, i;
 
 			start_pfn = page_to_pfn(list_entry(curr, struct page, lru));
@@ -635,30 +903,53 @@ static void zone_statistics(struct zonelist *zonelist, struct zone *z)
 }
 
 /*
- * Free a 0-order page
+ * The part of freeing a 0-order page which does not need interrupts
+ * disabled.
  */
-static void FASTCALL(free_hot_cold_page(struct page *page, int cold));
-static void fastcall free_hot_cold_page(struct page *page, int cold)
+static inline void prep_free_page(struct page *page)
 {
-	struct zone *zone = page_zone(page);
-	struct per_cpu_pages *pcp;
-	unsigned long flags;
-
 	arch_free_page(page, 0);
 
 	kernel_map_pages(page, 1, 0);
-	inc_page_state(pgfree);
 	if (PageAnon(page))
 		page->mapping = NULL;
 	free_pages_check(__FUNCTION__, page);
-	pcp = &zone_pcp(zone, get_cpu())->pcp[cold];
-	local_irq_save(flags);
+	page->private = get_pageblock_migratetype(page);
+}
+
+/*
+ * Put a 0-order page on the per cpu list of @cpu, and give a batch
+ * back to the buddy lists if the list got too long.
+ *
+ * Must be called with interrupts disabled.
+ */
+static inline void __free_hot_cold_page(struct page *page, int cold, int cpu)
+{
+	struct zone *zone = page_zone(page);
+	struct per_cpu_pages *pcp = &zone_pcp(zone, cpu)->pcp[cold];
+
 	list_add(&page->lru, &pcp->list);
 	pcp->count++;
-	if (pcp->count >= pcp->high)
+	if (pcp->count >= pcp->high) {
+		pcp_adapt_batch(pcp, cold);
 		pcp->count -= free_pages_bulk(zone, pcp->batch, &pcp->list, 0);
+		pcp->drains++;
+	}
+}
+
+/*
+ * Free a 0-order page
+ */
+static void FASTCALL(free_hot_cold_page(struct page *page, int cold));
+static void fastcall free_hot_cold_page(struct page *page, int cold)
+{
+	unsigned long flags;
+
+	prep_free_page(page);
+	inc_page_state(pgfree);
+	local_irq_save(flags);
+	__free_hot_cold_page(page, cold, smp_processor_id());
 	local_irq_restore(flags);
-	put_cpu();
 }
 
 void fastcall free_hot_page(struct page *page)
@@ -680,6 +971,20 @@ static inline void prep_zero_page(struct page *page, int order, gfp_t gfp_flags)
 		clear_highpage(page + i);
 }
 
+/*
+ * The first page on the per cpu list which was taken for @migratetype.
+ */
+static inline struct page *pcp_find_page(struct per_cpu_pages *pcp,
+					 int migratetype)
+{
+	struct page *page;
+
+	list_for_each_entry(page, &pcp->list, lru)
+		if (page->private == migratetype)
+			return page;
+	return NULL;
+}
+
 /*
  * Really, prep_compound_page() should be called from __rmqueue_bulk().  But
  * we cheat by calling it from here, in the order > 0 path.  Saves a branch
@@ -691,17 +996,28 @@ buffered_rmqueue(struct zone *zone, int order, gfp_t gfp_flags)
 	unsigned long flags;
 	struct page *page = NULL;
 	int cold = !!(gfp_flags & __GFP_COLD);
+	int migratetype = allocflags_to_migratetype(gfp_flags);
 
 	if (order == 0) {
 		struct per_cpu_pages *pcp;
 
 		pcp = &zone_pcp(zone, get_cpu())->pcp[cold];
 		local_irq_save(flags);
-		if (pcp->count <= pcp->low)
+		if (pcp->count <= pcp->low) {
+			pcp_adapt_batch(pcp, cold);
+			pcp->count += rmqueue_bulk(zone, 0,
+					pcp->batch, &pcp->list, migratetype);
+			pcp->refills++;
+		}
+		page = pcp_find_page(pcp, migratetype);
+		if (!page) {
+			/* Only pages for other migrate types are left */
 			pcp->count += rmqueue_bulk(zone, 0,
-						pcp->batch, &pcp->list);
-		if (pcp->count) {
-			page = list_entry(pcp->list.next, struct page, lru);
+					pcp->batch, &pcp->list, migratetype);
+			pcp->refills++;
+			page = pcp_find_page(pcp, migratetype);
+		}
+		if (page) {
 			list_del(&page->lru);
 			pcp->count--;
 		}
@@ -711,7 +1027,7 @@ buffered_rmqueue(struct zone *zone, int order, gfp_t gfp_flags)
 
 	if (page == NULL) {
 		spin_lock_irqsave(&zone->lock, flags);
-		page = __rmqueue(zone, order);
+		page = __rmqueue(zone, order, migratetype);
 		spin_unlock_irqrestore(&zone->lock, flags);
 	}
 
@@ -886,6 +1202,29 @@ zone_reclaim_retry:
 	if (!wait)
 		goto nopage;
 
+	/*
+	 * A higher order allocation may only be failing because the free
+	 * memory is fragmented: try to compact the zones before reclaim.
+	 */
+	if (order && try_to_compact_pages(zones, order, gfp_mask)) {
+		for (i = 0; (z = zones[i]) != NULL; i++) {
+			if (!zone_watermark_ok(z, order, z->pages_min,
+					       classzone_idx, can_try_harder,
+					       gfp_mask & __GFP_HIGH))
+				continue;
+
+			if (!cpuset_zone_allowed(z, gfp_mask))
+				continue;
+
+			page = buffered_rmqueue(z, order, gfp_mask);
+			if (page) {
+				inc_page_state(compact_success);
+				goto got_pg;
+			}
+		}
+		inc_page_state(compact_fail);
+	}
+
 rebalance:
 	cond_resched();
 
@@ -1006,12 +1345,27 @@ fastcall unsigned long get_zeroed_page(gfp_t gfp_mask)
 
 EXPORT_SYMBOL(get_zeroed_page);
 
+/*
+ * Free the 0-order pages of @pvec with a single interrupt disabled
+ * section; the per cpu lists drain to the buddy lists in batches
+ * as usual.
+ */
 void __pagevec_free(struct pagevec *pvec)
 {
+	unsigned long flags;
 	int i = pagevec_count(pvec);
+	int cpu;
 
 	while (--i >= 0)
-		free_hot_cold_page(pvec->pages[i], pvec->cold);
+		prep_free_page(pvec->pages[i]);
+	mod_page_state(pgfree, pagevec_count(pvec));
+
+	local_irq_save(flags);
+	cpu = smp_processor_id();
+	i = pagevec_count(pvec);
+	while (--i >= 0)
+		__free_hot_cold_page(pvec->pages[i], pvec->cold, cpu);
+	local_irq_restore(flags);
 }
 
 fastcall void __free_pages(struct page *page, unsigned int order)
@@ -1188,6 +1542,13 @@ void get_full_page_state(struct page_state *ret)
 	__get_page_state(ret, sizeof(*ret) / sizeof(unsigned long), &mask);
 }
 
+void get_full_page_state_node(struct page_state *ret, int node)
+{
+	cpumask_t mask = node_to_cpumask(node);
+
+	__get_page_state(ret, sizeof(*ret) / sizeof(unsigned long), &mask);
+}
+
 unsigned long __read_page_state(unsigned long offset)
 {
 	unsigned long ret = 0;
@@ -1225,12 +1586,30 @@ void __get_zone_counts(unsigned long *active, unsigned long *inactive,
 	*inactive = 0;
 	*free = 0;
 	for (i = 0; i < MAX_NR_ZONES; i++) {
-		*active += zones[i].nr_active;
-		*inactive += zones[i].nr_inactive;
+		*active += zones[i].lru[LRU_ACTIVE_ANON].nr_pages +
+			   zones[i].lru[LRU_ACTIVE_FILE].nr_pages;
+		*inactive += zones[i].lru[LRU_INACTIVE_ANON].nr_pages +
+			     zones[i].lru[LRU_INACTIVE_FILE].nr_pages;
 		*free += zones[i].free_pages;
 	}
 }
 
+/*
+ * Number of pages on each LRU list, in enum lru_list order, summed over
+ * all zones.
+ */
+void get_lru_counts(unsigned long *nr)
+{
+	struct zone *zone;
+	enum lru_list l;
+
+	for_each_lru(l)
+		nr[l] = 0;
+	for_each_zone(zone)
+		for_each_lru(l)
+			nr[l] += zone->lru[l].nr_pages;
+}
+
 void get_zone_counts(unsigned long *active,
 		unsigned long *inactive, unsigned long *free)
 {
@@ -1352,8 +1731,11 @@ void show_free_areas(void)
 			" min:%lukB"
 			" low:%lukB"
 			" high:%lukB"
-			" active:%lukB"
-			" inactive:%lukB"
+			" active_anon:%lukB"
+			" inactive_anon:%lukB"
+			" active_file:%lukB"
+			" inactive_file:%lukB"
+			" unevictable:%lukB"
 			" present:%lukB"
 			" pages_scanned:%lu"
 			" all_unreclaimable? %s"
@@ -1363,8 +1745,11 @@ void show_free_areas(void)
 			K(zone->pages_min),
 			K(zone->pages_low),
 			K(zone->pages_high),
-			K(zone->nr_active),
-			K(zone->nr_inactive),
+			K(zone->lru[LRU_ACTIVE_ANON].nr_pages),
+			K(zone->lru[LRU_INACTIVE_ANON].nr_pages),
+			K(zone->lru[LRU_ACTIVE_FILE].nr_pages),
+			K(zone->lru[LRU_INACTIVE_FILE].nr_pages),
+			K(zone->lru[LRU_UNEVICTABLE].nr_pages),
 			K(zone->present_pages),
 			zone->pages_scanned,
 			(zone->all_unreclaimable ? "yes" : "no")
@@ -1689,12 +2074,35 @@ void zone_init_free_lists(struct pglist_data *pgdat, struct zone *zone,
 				unsigned long size)
 {
 	int order;
-	for (order = 0; order < MAX_ORDER ; order++) {
-		INIT_LIST_HEAD(&zone->free_area[order].free_list);
+	int t;
+	for_each_migratetype_order(order, t) {
+		INIT_LIST_HEAD(&zone->free_area[order].free_list[t]);
 		zone->free_area[order].nr_free = 0;
 	}
 }
 
+/*
+ * All pageblocks start out movable, the first kernel allocations take
+ * blocks over from there as they need them.
+ */
+static void __init setup_pageblock_flags(struct pglist_data *pgdat,
+					 struct zone *zone)
+{
+	unsigned long start_pfn = zone->zone_start_pfn;
+	unsigned long end_pfn = start_pfn + zone->spanned_pages;
+	unsigned long nr_blocks, pfn;
+
+	nr_blocks = ((end_pfn - 1) >> pageblock_order) -
+		(start_pfn >> pageblock_order) + 1;
+	zone->pageblock_flags = alloc_bootmem_node(pgdat,
+		BITS_TO_LONGS(nr_blocks * NR_PAGEBLOCK_BITS) *
+		sizeof(unsigned long));
+
+	for (pfn = start_pfn & ~(pageblock_nr_pages - 1); pfn < end_pfn;
+	     pfn += pageblock_nr_pages)
+		__set_pageblock_migratetype(zone, pfn, MIGRATE_MOVABLE);
+}
+
 #define ZONETABLE_INDEX(x, zone_nr)	((x << ZONES_SHIFT) | zone_nr)
 void zonetable_add(struct zone *zone, int nid, int zid, unsigned long pfn,
 		unsigned long size)
@@ -1754,16 +2162,14 @@ inline void setup_pageset(struct per_cpu_pageset *p, unsigned long batch)
 
 	pcp = &p->pcp[0];		/* hot */
 	pcp->count = 0;
-	pcp->low = 2 * batch;
-	pcp->high = 6 * batch;
-	pcp->batch = max(1UL, 1 * batch);
+	pcp->base_batch = batch;
+	pcp_set_batch(pcp, batch, 0);
 	INIT_LIST_HEAD(&pcp->list);
 
 	pcp = &p->pcp[1];		/* cold*/
 	pcp->count = 0;
-	pcp->low = 0;
-	pcp->high = 2 * batch;
-	pcp->batch = max(1UL, 1 * batch);
+	pcp->base_batch = batch;
+	pcp_set_batch(pcp, batch, 1);
 	INIT_LIST_HEAD(&pcp->list);
 }
 
@@ -1893,6 +2299,7 @@ static void __init free_area_init_core(struct pglist_data *pgdat,
 		struct zone *zone = pgdat->node_zones + j;
 		unsigned long size, realsize;
 		unsigned long batch;
+		enum lru_list l;
 
 		realsize = size = zones_size[j];
 		if (zholes_size)
@@ -1925,12 +2332,14 @@ static void __init free_area_init_core(struct pglist_data *pgdat,
 		}
 		printk(KERN_DEBUG "  %s zone: %lu pages, LIFO batch:%lu\n",
 				zone_names[j], realsize, batch);
-		INIT_LIST_HEAD(&zone->active_list);
-		INIT_LIST_HEAD(&zone->inactive_list);
-		zone->nr_scan_active = 0;
-		zone->nr_scan_inactive = 0;
-		zone->nr_active = 0;
-		zone->nr_inactive = 0;
+		for_each_lru(l) {
+			INIT_LIST_HEAD(&zone->lru[l].list);
+			zone->lru[l].nr_pages = 0;
+			zone->lru[l].nr_scan = 0;
+		}
+		zone->recent_rotated[0] = zone->recent_rotated[1] = 0;
+		zone->recent_scanned[0] = zone->recent_scanned[1] = 0;
+		atomic_set(&zone->inactive_age, 0);
 		atomic_set(&zone->reclaim_in_progress, 0);
 		if (!size)
 			continue;
@@ -1958,6 +2367,8 @@ static void __init free_area_init_core(struct pglist_data *pgdat,
 
 		zonetable_add(zone, nid, j, zone_start_pfn, size);
 
+		setup_pageblock_flags(pgdat, zone);
+
 		zone_start_pfn += size;
 
 		zone_init_free_lists(pgdat, zone, zone->spanned_pages);
@@ -2077,6 +2488,151 @@ struct seq_operations fragmentation_op = {
 	.show	= frag_show,
 };
 
+static char * const migratetype_names[MIGRATE_TYPES] = {
+	"Unmovable",
+	"Reclaimable",
+	"Movable",
+};
+
+/*
+ * The fragmentation index of an allocation of @order, in thousandths:
+ * -1 if there is a free block large enough.  Otherwise it tends to 0
+ * when the allocation fails for lack of free memory, and to 1 when it
+ * fails because the free memory is split into blocks too small.
+ *
+ * Call with zone->lock held.
+ */
+static int fragmentation_index(struct zone *zone, unsigned int order)
+{
+	unsigned long blocks = 0, suitable = 0;
+	unsigned long long tmp;
+	int o;
+
+	for (o = 0; o < MAX_ORDER; o++) {
+		blocks += zone->free_area[o].nr_free;
+		if (o >= order)
+			suitable += zone->free_area[o].nr_free;
+	}
+	if (!blocks)
+		return 0;
+	if (suitable)
+		return -1000;
+
+	/* 1 - (1 + free_pages / requested) / blocks */
+	tmp = 1000 + (((unsigned long long)zone->free_pages * 1000) >> order);
+	do_div(tmp, blocks);
+	return 1000 - (int)tmp;
+}
+
+/*
+ * Free blocks by migrate type and order, pageblocks by migrate type,
+ * and the fragmentation index of each order, for the zones of @pgdat.
+ */
+static int pagetypeinfo_show(struct seq_file *m, void *arg)
+{
+	pg_data_t *pgdat = (pg_data_t *)arg;
+	struct zone *zone;
+	struct zone *node_zones = pgdat->node_zones;
+	unsigned long flags;
+	int order, mtype;
+
+	if (pgdat == pgdat_list) {
+		seq_printf(m, "Page block order: %d\n", pageblock_order);
+		seq_printf(m, "Pages per block:  %lu\n", pageblock_nr_pages);
+	}
+
+	seq_printf(m, "\n%-43s ", "Free pages count per migrate type at order");
+	for (order = 0; order < MAX_ORDER; ++order)
+		seq_printf(m, "%6d ", order);
+	seq_putc(m, '\n');
+
+	for (zone = node_zones; zone - node_zones < MAX_NR_ZONES; ++zone) {
+		if (!zone->present_pages)
+			continue;
+
+		spin_lock_irqsave(&zone->lock, flags);
+		for (mtype = 0; mtype < MIGRATE_TYPES; mtype++) {
+			seq_printf(m, "Node %4d, zone %8s, type %12s ",
+				   pgdat->node_id, zone->name,
+				   migratetype_names[mtype]);
+			for (order = 0; order < MAX_ORDER; ++order) {
+				unsigned long freecount = 0;
+				struct list_head *curr;
+
+				list_for_each(curr,
+				    &zone->free_area[order].free_list[mtype])
+					freecount++;
+				seq_printf(m, "%6lu ", freecount);
+			}
+			seq_putc(m, '\n');
+		}
+		spin_unlock_irqrestore(&zone->lock, flags);
+	}
+
+	seq_printf(m, "\n%-23s", "Number of blocks type ");
+	for (mtype = 0; mtype < MIGRATE_TYPES; mtype++)
+		seq_printf(m, "%12s ", migratetype_names[mtype]);
+	seq_putc(m, '\n');
+
+	for (zone = node_zones; zone - node_zones < MAX_NR_ZONES; ++zone) {
+		unsigned long count[MIGRATE_TYPES] = { 0, };
+		unsigned long start_pfn = zone->zone_start_pfn;
+		unsigned long end_pfn = start_pfn + zone->spanned_pages;
+		unsigned long pfn;
+
+		if (!zone->present_pages)
+			continue;
+
+		/* The first block may start before the zone */
+		for (pfn = start_pfn; pfn < end_pfn;
+		     pfn = (pfn | (pageblock_nr_pages - 1)) + 1) {
+			struct page *page;
+
+			if (!pfn_valid(pfn))
+				continue;
+			page = pfn_to_page(pfn);
+			if (page_zone(page) != zone)
+				continue;
+			count[get_pageblock_migratetype(page)]++;
+		}
+
+		seq_printf(m, "Node %d, zone %8s ", pgdat->node_id, zone->name);
+		for (mtype = 0; mtype < MIGRATE_TYPES; mtype++)
+			seq_printf(m, "%12lu ", count[mtype]);
+		seq_putc(m, '\n');
+	}
+
+	seq_printf(m, "\n%-28s", "Fragmentation index at order");
+	for (order = 0; order < MAX_ORDER; ++order)
+		seq_printf(m, "%6d ", order);
+	seq_putc(m, '\n');
+
+	for (zone = node_zones; zone - node_zones < MAX_NR_ZONES; ++zone) {
+		if (!zone->present_pages)
+			continue;
+
+		spin_lock_irqsave(&zone->lock, flags);
+		seq_printf(m, "Node %d, zone %8s      ", pgdat->node_id,
+			   zone->name);
+		for (order = 0; order < MAX_ORDER; ++order) {
+			int index = fragmentation_index(zone, order);
+
+			seq_printf(m, "%2d.%03d ", index / 1000,
+				   abs(index % 1000));
+		}
+		spin_unlock_irqrestore(&zone->lock, flags);
+		seq_putc(m, '\n');
+	}
+	return 0;
+}
+
+struct seq_operations pagetypeinfo_op = {
+	.start	= frag_start,
+	.next	= frag_next,
+	.stop	= frag_stop,
+	.show	= pagetypeinfo_show,
+};
+
 /*
  * Output information about zones in @pgdat.
  */
@@ -2100,19 +2656,32 @@ static int zoneinfo_show(struct seq_file *m, void *arg)
 			   "\n        min      %lu"
 			   "\n        low      %lu"
 			   "\n        high     %lu"
-			   "\n        active   %lu"
-			   "\n        inactive %lu"
-			   "\n        scanned  %lu (a: %lu i: %lu)"
+			   "\n        active_anon   %lu"
+			   "\n        inactive_anon %lu"
+			   "\n        active_file   %lu"
+			   "\n        inactive_file %lu"
+			   "\n        unevictable   %lu"
+			   "\n        scanned  %lu (aa: %lu ia: %lu af: %lu if: %lu)"
+			   "\n        recent_rotated %lu %lu"
+			   "\n        recent_scanned %lu %lu"
 			   "\n        spanned  %lu"
 			   "\n        present  %lu",
 			   zone->free_pages,
 			   zone->pages_min,
 			   zone->pages_low,
 			   zone->pages_high,
-			   zone->nr_active,
-			   zone->nr_inactive,
+			   zone->lru[LRU_ACTIVE_ANON].nr_pages,
+			   zone->lru[LRU_INACTIVE_ANON].nr_pages,
+			   zone->lru[LRU_ACTIVE_FILE].nr_pages,
+			   zone->lru[LRU_INACTIVE_FILE].nr_pages,
+			   zone->lru[LRU_UNEVICTABLE].nr_pages,
 			   zone->pages_scanned,
-			   zone->nr_scan_active, zone->nr_scan_inactive,
+			   zone->lru[LRU_ACTIVE_ANON].nr_scan,
+			   zone->lru[LRU_INACTIVE_ANON].nr_scan,
+			   zone->lru[LRU_ACTIVE_FILE].nr_scan,
+			   zone->lru[LRU_INACTIVE_FILE].nr_scan,
+			   zone->recent_rotated[0], zone->recent_rotated[1],
+			   zone->recent_scanned[0], zone->recent_scanned[1],
 			   zone->spanned_pages,
 			   zone->present_pages);
 		seq_printf(m,
@@ -2140,12 +2709,16 @@ static int zoneinfo_show(struct seq_file *m, void *arg)
 					   "\n              count: %i"
 					   "\n              low:   %i"
 					   "\n              high:  %i"
-					   "\n              batch: %i",
+					   "\n              batch: %i"
+					   "\n              refills: %lu"
+					   "\n              drains: %lu",
 					   i, j,
 					   pageset->pcp[j].count,
 					   pageset->pcp[j].low,
 					   pageset->pcp[j].high,
-					   pageset->pcp[j].batch);
+					   pageset->pcp[j].batch,
+					   pageset->pcp[j].refills,
+					   pageset->pcp[j].drains);
 			}
 #ifdef CONFIG_NUMA
 			seq_printf(m,
@@ -2231,7 +2804,41 @@ static char *vmstat_text[] = {
 	"allocstall",
 
 	"pgrotated",
+	"pgscan_inactive_anon",
+	"pgscan_active_anon",
+	"pgscan_inactive_file",
+	"pgscan_active_file",
+	"pgrotated_anon",
+	"pgrotated_file",
+	"unevictable_culled",
+	"unevictable_rescued",
+	"workingset_refault",
+	"workingset_activate",
+	"swap_ra",
+	"swap_ra_hit",
+	"swap_ra_miss",
+	"file_ra_sync",
+	"file_ra_async",
+	"file_ra_context",
+	"file_ra_pages",
+	"file_ra_hit",
 	"nr_bounce",
+
+	"pgmigrate_success",
+	"pgmigrate_fail",
+	"compact_stall",
+	"compact_fail",
+	"compact_success",
+
+	"thp_fault_alloc",
+	"thp_fault_fallback",
+	"thp_collapse_alloc",
+	"thp_split",
+
+	"numa_pte_updates",
+	"numa_hint_faults",
+	"numa_hint_faults_local",
+	"numa_pages_migrated",
 };
 
 static void *vmstat_start(struct seq_file *m, loff_t *pos)
@@ -39,29 +39,6 @@ file_ra_state_init(struct file_ra_state *ra, struct address_space *mapping)
 	ra->prev_page = -1;
 }
 
-/*
- * Return max readahead size for this inode in number-of-pages.
- */
-static inline unsigned long get_max_readahead(struct file_ra_state *ra)
-{
-	return ra->ra_pages;
-}
-
-static inline unsigned long get_min_readahead(struct file_ra_state *ra)
-{
-	return (VM_MIN_READAHEAD * 1024) / PAGE_CACHE_SIZE;
-}
-
-static inline void ra_off(struct file_ra_state *ra)
-{
-	ra->start = 0;
-	ra->flags = 0;
-	ra->size = 0;
-	ra->ahead_start = 0;
-	ra->ahead_size = 0;
-	return;
-}
-
 /*
  * Set the initial window size, round to next power of 2 and square
  * for small size, x 4 for medium, and x 2 for large
@@ -82,25 +59,19 @@ static unsigned long get_init_ra_size(unsigned long size, unsigned long max)
 }
 
 /*
- * Set the new window size, this is called only when I/O is to be submitted,
- * not for each call to readahead.  If a cache miss occured, reduce next I/O
- * size, else increase depending on how close to max we are.
+ * Get the previous window size, ramp it up, and return it as the new
+ * window size: fast while it is small, then slower up to the maximum.
  */
-static inline unsigned long get_next_ra_size(struct file_ra_state *ra)
+static unsigned long get_next_ra_size(struct file_ra_state *ra,
+				      unsigned long max)
 {
-	unsigned long max = get_max_readahead(ra);
-	unsigned long min = get_min_readahead(ra);
 	unsigned long cur = ra->size;
 	unsigned long newsize;
 
-	if (ra->flags & RA_FLAG_MISS) {
-		ra->flags &= ~RA_FLAG_MISS;
-		newsize = max((cur - 2), min);
-	} else if (cur < max / 16) {
+	if (cur < max / 16)
 		newsize = 4 * cur;
-	} else {
+	else
 		newsize = 2 * cur;
-	}
 	return min(newsize, max);
 }
 
@@ -121,21 +92,18 @@ int read_cache_pages(struct address_space *mapping, struct list_head *pages,
 			int (*filler)(void *, struct page *), void *data)
 {
 	struct page *page;
-	struct pagevec lru_pvec;
 	int ret = 0;
 
-	pagevec_init(&lru_pvec, 0);
-
 	while (!list_empty(pages)) {
 		page = list_to_page(pages);
 		list_del(&page->lru);
-		if (add_to_page_cache(page, mapping, page->index, GFP_KERNEL)) {
+		if (add_to_page_cache_lru(page, mapping,
+					page->index, GFP_KERNEL)) {
 			page_cache_release(page);
 			continue;
 		}
 		ret = filler(data, page);
-		if (!pagevec_add(&lru_pvec, page))
-			__pagevec_lru_add(&lru_pvec);
+		page_cache_release(page);
 		if (ret) {
 			while (!list_empty(pages)) {
 				struct page *victim;
@@ -147,7 +115,6 @@ int read_cache_pages(struct address_space *mapping, struct list_head *pages,
 			break;
 		}
 	}
-	pagevec_lru_add(&lru_pvec);
 	return ret;
 }
 
@@ -156,8 +123,8 @@ EXPORT_SYMBOL(read_cache_pages);
 static int read_pages(struct address_space *mapping, struct file *filp,
 		struct list_head *pages, unsigned nr_pages)
 {
-	unsigned page_idx;
-	struct pagevec lru_pvec;
+	struct pagevec pvec;
+	unsigned page_idx, i;
 	int ret = 0;
 
 	if (mapping->a_ops->readpages) {
@@ -165,20 +132,15 @@ static int read_pages(struct address_space *mapping, struct file *filp,
 		goto out;
 	}
 
-	pagevec_init(&lru_pvec, 0);
-	for (page_idx = 0; page_idx < nr_pages; page_idx++) {
-		struct page *page = list_to_page(pages);
-		list_del(&page->lru);
-		if (!add_to_page_cache(page, mapping,
-					page->index, GFP_KERNEL)) {
-			mapping->a_ops->readpage(filp, page);
-			if (!pagevec_add(&lru_pvec, page))
-				__pagevec_lru_add(&lru_pvec);
-		} else {
-			page_cache_release(page);
+	for (page_idx = 0; page_idx < nr_pages; ) {
+		pagevec_init(&pvec, 0);
+		page_idx += add_to_page_cache_lru_vec(mapping, pages,
+					nr_pages - page_idx, &pvec, GFP_KERNEL);
+		for (i = 0; i < pagevec_count(&pvec); i++) {
+			mapping->a_ops->readpage(filp, pvec.pages[i]);
+			page_cache_release(pvec.pages[i]);
 		}
 	}
-	pagevec_lru_add(&lru_pvec);
 out:
 	return ret;
 }
@@ -186,59 +148,34 @@ out:
 /*
  * Readahead design.
  *
+ * Readahead is done on demand: it is started when a read misses the
+ * page cache (synchronous readahead), or when it reaches a page with
+ * the PG_readahead mark (asynchronous readahead).  Each batch of
+ * readahead marks the page which is async_size pages before its end, so
+ * that the next batch is submitted while the application is still
+ * walking through the pages already read.
+ *
  * The fields in struct file_ra_state represent the most-recently-executed
  * readahead attempt:
  *
  * start:	Page index at which we started the readahead
  * size:	Number of pages in that read
- *              Together, these form the "current window".
- *              Together, start and size represent the `readahead window'.
- * prev_page:   The page which the readahead algorithm most-recently inspected.
- *              It is mainly used to detect sequential file reading.
- *              If page_cache_readahead sees that it is again being called for
- *              a page which it just looked at, it can return immediately without
- *              making any state changes.
- * ahead_start,
- * ahead_size:  Together, these form the "ahead window".
+ * async_size:	Number of pages at the end of the read which were left
+ *		to be read while the next batch is submitted: the mark is
+ *		on page start + size - async_size.
+ * prev_page:	The page which the application most recently read.  It
+ *		is used to tell a sequential cache miss from a random one.
  * ra_pages:	The externally controlled max readahead for this fd.
  *
- * When readahead is in the off state (size == 0), readahead is disabled.
- * In this state, prev_page is used to detect the resumption of sequential I/O.
- *
- * The readahead code manages two windows - the "current" and the "ahead"
- * windows.  The intent is that while the application is walking the pages
- * in the current window, I/O is underway on the ahead window.  When the
- * current window is fully traversed, it is replaced by the ahead window
- * and the ahead window is invalidated.  When this copying happens, the
- * new current window's pages are probably still locked.  So
- * we submit a new batch of I/O immediately, creating a new ahead window.
- *
- * So:
- *
- *   ----|----------------|----------------|-----
- *       ^start           ^start+size
- *                        ^ahead_start     ^ahead_start+ahead_size
- *
- *         ^ When this page is read, we submit I/O for the
- *           ahead window.
- *
- * A `readahead hit' occurs when a read request is made against a page which is
- * the next sequential page. Ahead window calculations are done only when it
- * is time to submit a new IO.  The code ramps up the size agressively at first,
- * but slow down as it approaches max_readhead.
- *
- * Any seek/ramdom IO will result in readahead being turned off.  It will resume
- * at the first sequential access.
- *
- * There is a special-case: if the first page which the application tries to
- * read happens to be the first page of the file, it is assumed that a linear
- * read is about to happen and the window is immediately set to the initial size
- * based on I/O request size and the max_readahead.
- *
- * This function is to be called for every read request, rather than when
- * it is time to perform readahead.  It is called only once for the entire I/O
- * regardless of size unless readahead is unable to start enough I/O to satisfy
- * the request (I/O request > max_readahead).
+ * The state only describes the last stream which was read ahead on this
+ * file.  When several streams interleave on one struct file, a marked
+ * page which does not match the state is taken for another stream: how
+ * far the page cache goes ahead of it tells the size of its last
+ * window.  And a cache miss which does not follow the last read looks
+ * at the pages cached before it: if there are enough of them, it is
+ * the continuation of a stream which was read from the page cache, or
+ * was left behind by another reader, and readahead resumes at once.
+ * So no state is needed for each stream: the page cache keeps it.
  */
 
 /*
@@ -247,6 +184,9 @@ out:
  * behaviour which would occur if page allocations are causing VM writeback.
  * We really don't want to intermingle reads and writes like that.
  *
+ * The page @lookahead_size pages before the end of the chunk gets the
+ * PG_readahead mark, if it is read here.
+ *
  * Returns the number of pages requested, or the maximum amount of I/O allowed.
  *
  * do_page_cache_readahead() returns -1 if it encountered request queue
@@ -254,7 +194,8 @@ out:
  */
 static int
 __do_page_cache_readahead(struct address_space *mapping, struct file *filp,
-			unsigned long offset, unsigned long nr_to_read)
+			unsigned long offset, unsigned long nr_to_read,
+			unsigned long lookahead_size)
 {
 	struct inode *inode = mapping->host;
 	struct page *page;
@@ -272,7 +213,7 @@ __do_page_cache_readahead(struct address_space *mapping, struct file *filp,
 	/*
 	 * Preallocate as many pages as we will need.
 	 */
-	read_lock_irq(&mapping->tree_lock);
+	rcu_read_lock();
 	for (page_idx = 0; page_idx < nr_to_read; page_idx++) {
 		unsigned long page_offset = offset + page_idx;
 		
@@ -280,19 +221,21 @@ __do_page_cache_readahead(struct address_space *mapping, struct file *filp,
 			break;
 
 		page = radix_tree_lookup(&mapping->page_tree, page_offset);
-		if (page)
+		if (page && !radix_tree_exceptional_entry(page))
 			continue;
 
-		read_unlock_irq(&mapping->tree_lock);
+		rcu_read_unlock();
 		page = page_cache_alloc_cold(mapping);
-		read_lock_irq(&mapping->tree_lock);
+		rcu_read_lock();
 		if (!page)
 			break;
 		page->index = page_offset;
 		list_add(&page->lru, &page_pool);
+		if (page_idx == nr_to_read - lookahead_size)
+			SetPageReadahead(page);
 		ret++;
 	}
-	read_unlock_irq(&mapping->tree_lock);
+	rcu_read_unlock();
 
 	/*
 	 * Now start the IO.  We ignore I/O errors - if the page is not
@@ -326,7 +269,7 @@ int force_page_cache_readahead(struct address_space *mapping, struct file *filp,
 		if (this_chunk > nr_to_read)
 			this_chunk = nr_to_read;
 		err = __do_page_cache_readahead(mapping, filp,
-						offset, this_chunk);
+						offset, this_chunk, 0);
 		if (err < 0) {
 			ret = err;
 			break;
@@ -338,28 +281,6 @@ int force_page_cache_readahead(struct address_space *mapping, struct file *filp,
 	return ret;
 }
 
-/*
- * Check how effective readahead is being.  If the amount of started IO is
- * less than expected then the file is partly or fully in pagecache and
- * readahead isn't helping.
- *
- */
-static inline int check_ra_success(struct file_ra_state *ra,
-			unsigned long nr_to_read, unsigned long actual)
-{
-	if (actual == 0) {
-		ra->cache_hit += nr_to_read;
-		if (ra->cache_hit >= VM_MAX_CACHE_HIT) {
-			ra_off(ra);
-			ra->flags |= RA_FLAG_INCACHE;
-			return 0;
-		}
-	} else {
-		ra->cache_hit=0;
-	}
-	return 1;
-}
-
 /*
  * This version skips the IO if the queue is read-congested, and will tell the
  * block layer to abandon the readahead if request allocation would block.
@@ -373,186 +294,230 @@ int do_page_cache_readahead(struct address_space *mapping, struct file *filp,
 	if (bdi_read_congested(mapping->backing_dev_info))
 		return -1;
 
-	return __do_page_cache_readahead(mapping, filp, offset, nr_to_read);
+	return __do_page_cache_readahead(mapping, filp, offset, nr_to_read, 0);
 }
 
 /*
- * Read 'nr_to_read' pages starting at page 'offset'. If the flag 'block'
- * is set wait till the read completes.  Otherwise attempt to read without
- * blocking.
- * Returns 1 meaning 'success' if read is succesfull without switching off
- * readhaead mode. Otherwise return failure.
+ * Given a desired number of PAGE_CACHE_SIZE readahead pages, return a
+ * sensible upper limit.
  */
-static int
-blockable_page_cache_readahead(struct address_space *mapping, struct file *filp,
-			unsigned long offset, unsigned long nr_to_read,
-			struct file_ra_state *ra, int block)
+unsigned long max_sane_readahead(unsigned long nr)
 {
-	int actual;
+	unsigned long active;
+	unsigned long inactive;
+	unsigned long free;
 
-	if (!block && bdi_read_congested(mapping->backing_dev_info))
-		return 0;
+	__get_zone_counts(&active, &inactive, &free, NODE_DATA(numa_node_id()));
+	return min(nr, (inactive + free) / 2);
+}
 
-	actual = __do_page_cache_readahead(mapping, filp, offset, nr_to_read);
+/*
+ * Submit IO for the read-ahead request in file_ra_state.
+ */
+static unsigned long ra_submit(struct file_ra_state *ra,
+		struct address_space *mapping, struct file *filp)
+{
+	int actual;
 
-	return check_ra_success(ra, nr_to_read, actual);
+	actual = __do_page_cache_readahead(mapping, filp,
+					ra->start, ra->size, ra->async_size);
+	if (actual > 0)
+		mod_page_state(file_ra_pages, actual);
+	return actual;
 }
 
-static int make_ahead_window(struct address_space *mapping, struct file *filp,
-				struct file_ra_state *ra, int force)
+/*
+ * Count the pages cached contiguously before @offset, up to @max: how
+ * long the stream which @offset continues has been running, or, under
+ * memory pressure, about how much readahead the page cache can hold.
+ */
+static unsigned long count_history_pages(struct address_space *mapping,
+			pgoff_t offset, unsigned long max)
 {
-	int block, ret;
-
-	ra->ahead_size = get_next_ra_size(ra);
-	ra->ahead_start = ra->start + ra->size;
-
-	block = force || (ra->prev_page >= ra->ahead_start);
-	ret = blockable_page_cache_readahead(mapping, filp,
-			ra->ahead_start, ra->ahead_size, ra, block);
-
-	if (!ret && !force) {
-		/* A read failure in blocking mode, implies pages are
-		 * all cached. So we can safely assume we have taken
-		 * care of all the pages requested in this call.
-		 * A read failure in non-blocking mode, implies we are
-		 * reading more pages than requested in this call.  So
-		 * we safely assume we have taken care of all the pages
-		 * requested in this call.
-		 *
-		 * Just reset the ahead window in case we failed due to
-		 * congestion.  The ahead window will any way be closed
-		 * in case we failed due to excessive page cache hits.
-		 */
-		ra->ahead_start = 0;
-		ra->ahead_size = 0;
-	}
+	pgoff_t head;
 
-	return ret;
+	rcu_read_lock();
+	head = radix_tree_prev_hole(&mapping->page_tree, offset - 1, max);
+	rcu_read_unlock();
+
+	return offset - 1 - head;
 }
 
 /*
- * page_cache_readahead is the main function.  If performs the adaptive
- * readahead window size management and submits the readahead I/O.
+ * A cache miss which does not follow the last read of this struct file
+ * may still continue a stream: see if the page cache remembers one.
  */
-unsigned long
-page_cache_readahead(struct address_space *mapping, struct file_ra_state *ra,
-		     struct file *filp, unsigned long offset,
-		     unsigned long req_size)
+static int try_context_readahead(struct address_space *mapping,
+				 struct file_ra_state *ra, pgoff_t offset,
+				 unsigned long req_size, unsigned long max)
 {
-	unsigned long max, newsize;
-	int sequential;
+	unsigned long size;
 
-	/*
-	 * We avoid doing extra work and bogusly perturbing the readahead
-	 * window expansion logic.
-	 */
-	if (offset == ra->prev_page && --req_size)
-		++offset;
+	size = count_history_pages(mapping, offset, max);
 
-	/* Note that prev_page == -1 if it is a first read */
-	sequential = (offset == ra->prev_page + 1);
-	ra->prev_page = offset;
+	/* No history pages: it could be a random read */
+	if (!size)
+		return 0;
 
-	max = get_max_readahead(ra);
-	newsize = min(req_size, max);
+	/* Cached from the start of the file: a long stream, or whole file read */
+	if (size >= offset)
+		size *= 2;
 
-	/* No readahead or sub-page sized read or file already in cache */
-	if (newsize == 0 || (ra->flags & RA_FLAG_INCACHE))
-		goto out;
+	ra->start = offset;
+	ra->size = get_init_ra_size(size + req_size, max);
+	ra->async_size = ra->size;
+	inc_page_state(file_ra_context);
+	return 1;
+}
 
-	ra->prev_page += newsize - 1;
+/*
+ * The readahead state machine, for a read of @req_size pages at @offset
+ * which missed the page cache, or reached a PG_readahead mark.
+ */
+static unsigned long
+ondemand_readahead(struct address_space *mapping,
+		   struct file_ra_state *ra, struct file *filp,
+		   int hit_readahead_marker, pgoff_t offset,
+		   unsigned long req_size)
+{
+	unsigned long max = max_sane_readahead(ra->ra_pages);
+
+	/* Start of file */
+	if (!offset)
+		goto initial_readahead;
 
 	/*
-	 * Special case - first read at start of file. We'll assume it's
-	 * a whole-file read and grow the window fast.  Or detect first
-	 * sequential access
+	 * The expected offset, at the mark or the end of the last window:
+	 * the stream goes on.  Push the window forward and ramp it up.
 	 */
-	if (sequential && ra->size == 0) {
-		ra->size = get_init_ra_size(newsize, max);
-		ra->start = offset;
-		if (!blockable_page_cache_readahead(mapping, filp, offset,
-							 ra->size, ra, 1))
-			goto out;
-
-		/*
-		 * If the request size is larger than our max readahead, we
-		 * at least want to be sure that we get 2 IOs in flight and
-		 * we know that we will definitly need the new I/O.
-		 * once we do this, subsequent calls should be able to overlap
-		 * IOs,* thus preventing stalls. so issue the ahead window
-		 * immediately.
-		 */
-		if (req_size >= max)
-			make_ahead_window(mapping, filp, ra, 1);
-
-		goto out;
+	if (offset == ra->start + ra->size - ra->async_size ||
+	    offset == ra->start + ra->size) {
+		ra->start += ra->size;
+		ra->size = get_next_ra_size(ra, max);
+		ra->async_size = ra->size;
+		goto readit;
 	}
 
 	/*
-	 * Now handle the random case:
-	 * partial page reads and first access were handled above,
-	 * so this must be the next page otherwise it is random
+	 * A mark of another stream, interleaved with the one the state
+	 * is for.  How far the page cache goes past it is about the
+	 * async_size it was read with: ramp that up for the new window.
 	 */
-	if (!sequential) {
-		ra_off(ra);
-		blockable_page_cache_readahead(mapping, filp, offset,
-				 newsize, ra, 1);
-		goto out;
+	if (hit_readahead_marker) {
+		pgoff_t start;
+
+		rcu_read_lock();
+		start = radix_tree_next_hole(&mapping->page_tree,
+					     offset + 1, max);
+		rcu_read_unlock();
+
+		if (!start || start - offset > max)
+			return 0;
+
+		ra->start = start;
+		ra->size = start - offset;	/* old async_size */
+		ra->size += req_size;
+		ra->size = get_next_ra_size(ra, max);
+		ra->async_size = ra->size;
+		goto readit;
 	}
 
+	/* Oversize read */
+	if (req_size > max)
+		goto initial_readahead;
+
+	/* Sequential cache miss */
+	if (offset - ra->prev_page <= 1UL)
+		goto initial_readahead;
+
+	/* A stream the page cache remembers, though this file does not */
+	if (try_context_readahead(mapping, ra, offset, req_size, max))
+		goto readit;
+
 	/*
-	 * If we get here we are doing sequential IO and this was not the first
-	 * occurence (ie we have an existing window)
+	 * Standalone, small random read: read it as it is, and leave the
+	 * readahead state of the file alone.
 	 */
+	return __do_page_cache_readahead(mapping, filp, offset, req_size, 0);
 
-	if (ra->ahead_start == 0) {	 /* no ahead window yet */
-		if (!make_ahead_window(mapping, filp, ra, 0))
-			goto out;
-	}
+initial_readahead:
+	ra->start = offset;
+	ra->size = get_init_ra_size(req_size, max);
+	ra->async_size = ra->size > req_size ? ra->size - req_size : ra->size;
+
+readit:
 	/*
-	 * Already have an ahead window, check if we crossed into it.
-	 * If so, shift windows and issue a new ahead window.
-	 * Only return the #pages that are in the current window, so that
-	 * we get called back on the first page of the ahead window which
-	 * will allow us to submit more IO.
+	 * Will this read reach the mark it is about to set?  Then do the
+	 * readahead that mark would trigger now, as part of this window.
 	 */
-	if (ra->prev_page >= ra->ahead_start) {
-		ra->start = ra->ahead_start;
-		ra->size = ra->ahead_size;
-		make_ahead_window(mapping, filp, ra, 0);
+	if (offset == ra->start && ra->size == ra->async_size) {
+		ra->async_size = get_next_ra_size(ra, max);
+		ra->size += ra->async_size;
 	}
 
-out:
-	return ra->prev_page + 1;
+	return ra_submit(ra, mapping, filp);
 }
 
-/*
- * handle_ra_miss() is called when it is known that a page which should have
- * been present in the pagecache (we just did some readahead there) was in fact
- * not found.  This will happen if it was evicted by the VM (readahead
- * thrashing)
+/**
+ * page_cache_sync_readahead - generic file readahead
+ * @mapping: address_space which holds the pagecache and I/O vectors
+ * @ra: file_ra_state which holds the readahead state
+ * @filp: passed on to ->readpage() and ->readpages()
+ * @offset: start offset into @mapping, in PAGE_CACHE_SIZE units
+ * @req_size: hint: total size of the read which the caller is performing in
+ *            PAGE_CACHE_SIZE units
  *
- * Turn on the cache miss flag in the RA struct, this will cause the RA code
- * to reduce the RA size on the next read.
+ * page_cache_sync_readahead() should be called when a cache miss happened:
+ * it will submit the read.  The readahead logic may decide to piggyback more
+ * pages onto the read request if access patterns suggest it will improve
+ * performance.
  */
-void handle_ra_miss(struct address_space *mapping,
-		struct file_ra_state *ra, pgoff_t offset)
+void page_cache_sync_readahead(struct address_space *mapping,
+			       struct file_ra_state *ra, struct file *filp,
+			       pgoff_t offset, unsigned long req_size)
 {
-	ra->flags |= RA_FLAG_MISS;
-	ra->flags &= ~RA_FLAG_INCACHE;
-	ra->cache_hit = 0;
+	/* No readahead */
+	if (!ra->ra_pages)
+		return;
+
+	inc_page_state(file_ra_sync);
+	ondemand_readahead(mapping, ra, filp, 0, offset, req_size);
 }
+EXPORT_SYMBOL_GPL(page_cache_sync_readahead);
 
-/*
- * Given a desired number of PAGE_CACHE_SIZE readahead pages, return a
- * sensible upper limit.
+/**
+ * page_cache_async_readahead - file readahead for marked pages
+ * @mapping: address_space which holds the pagecache and I/O vectors
+ * @ra: file_ra_state which holds the readahead state
+ * @filp: passed on to ->readpage() and ->readpages()
+ * @page: the page at @offset which has the PG_readahead flag set
+ * @offset: start offset into @mapping, in PAGE_CACHE_SIZE units
+ * @req_size: hint: total size of the read which the caller is performing in
+ *            PAGE_CACHE_SIZE units
+ *
+ * page_cache_async_readahead() should be called when a page is used which
+ * has the PG_readahead flag set: this is a marker to suggest that the
+ * application has used up enough of the readahead window that we should
+ * start pulling in more pages.
  */
-unsigned long max_sane_readahead(unsigned long nr)
+void page_cache_async_readahead(struct address_space *mapping,
+				struct file_ra_state *ra, struct file *filp,
+				struct page *page, pgoff_t offset,
+				unsigned long req_size)
 {
-	unsigned long active;
-	unsigned long inactive;
-	unsigned long free;
+	/* No readahead */
+	if (!ra->ra_pages)
+		return;
 
-	__get_zone_counts(&active, &inactive, &free, NODE_DATA(numa_node_id()));
-	return min(nr, (inactive + free) / 2);
+	/* The mark is for the first reader to get there */
+	if (!TestClearPageReadahead(page))
+		return;
+
+	/* Defer asynchronous readahead on IO congestion */
+	if (bdi_read_congested(mapping->backing_dev_info))
+		return;
+
+	inc_page_state(file_ra_async);
+	ondemand_readahead(mapping, ra, filp, 1, offset, req_size);
 }
+EXPORT_SYMBOL_GPL(page_cache_async_readahead);
@@ -51,6 +51,8 @@
 #include <linux/slab.h>
 #include <linux/init.h>
 #include <linux/rmap.h>
+#include <linux/huge_mm.h>
+#include <linux/ksm.h>
 #include <linux/rcupdate.h>
 
 #include <asm/tlbflush.h>
@@ -193,7 +195,8 @@ static struct anon_vma *page_lock_anon_vma(struct page *page)
 
 	rcu_read_lock();
 	anon_mapping = (unsigned long) page->mapping;
-	if (!(anon_mapping & PAGE_MAPPING_ANON))
+	/* ksmd may have just made it a KSM page, without an anon_vma */
+	if ((anon_mapping & PAGE_MAPPING_FLAGS) != PAGE_MAPPING_ANON)
 		goto out;
 	if (!page_mapped(page))
 		goto out;
@@ -225,7 +228,8 @@ vma_address(struct page *page, struct vm_area_struct *vma)
 
 /*
  * At what user virtual address is page expected in vma? checking that the
- * page matches the vma: currently only used by unuse_process, on anon pages.
+ * page matches the vma: used by unuse_process on anon pages, and by page
+ * migration to restore the ptes of the page.
  */
 unsigned long page_address_in_vma(struct page *page, struct vm_area_struct *vma)
 {
@@ -245,9 +249,12 @@ unsigned long page_address_in_vma(struct page *page, struct vm_area_struct *vma)
  * Check that @page is mapped at @address into @mm.
  *
  * On success returns with mapped pte and locked mm->page_table_lock.
+ * A huge pmd which maps @page is split, unless @hpmd is given: then
+ * the pmd is left as it is and returned in *@hpmd, and the return value
+ * is NULL, with the page_table_lock held all the same.
  */
-pte_t *page_check_address(struct page *page, struct mm_struct *mm,
-			  unsigned long address)
+static pte_t *__page_check_address(struct page *page, struct mm_struct *mm,
+				   unsigned long address, pmd_t **hpmd)
 {
 	pgd_t *pgd;
 	pud_t *pud;
@@ -264,7 +271,15 @@ pte_t *page_check_address(struct page *page, struct mm_struct *mm,
 		pud = pud_offset(pgd, address);
 		if (likely(pud_present(*pud))) {
 			pmd = pmd_offset(pud, address);
-			if (likely(pmd_present(*pmd))) {
+			if (pmd_trans_huge(*pmd) && hpmd &&
+			    huge_pmd_maps_page(pmd, address, page)) {
+				*hpmd = pmd;
+				return NULL;
+			}
+			/* The caller is about to deal with the page alone */
+			if (pmd_trans_huge(*pmd))
+				split_huge_pmd_page(mm, pmd, address, page);
+			if (likely(pmd_present(*pmd) && !pmd_trans_huge(*pmd))) {
 				pte = pte_offset_map(pmd, address);
 				if (likely(pte_present(*pte) &&
 					   page_to_pfn(page) == pte_pfn(*pte)))
@@ -277,35 +292,55 @@ pte_t *page_check_address(struct page *page, struct mm_struct *mm,
 	return ERR_PTR(-ENOENT);
 }
 
+pte_t *page_check_address(struct page *page, struct mm_struct *mm,
+			  unsigned long address)
+{
+	return __page_check_address(page, mm, address, NULL);
+}
+
 /*
  * Subfunctions of page_referenced: page_referenced_one called
- * repeatedly from either page_referenced_anon or page_referenced_file.
+ * repeatedly from either page_referenced_anon, page_referenced_file
+ * or page_referenced_ksm, with the address of the page in vma.
  */
-static int page_referenced_one(struct page *page,
-	struct vm_area_struct *vma, unsigned int *mapcount, int ignore_token)
+int page_referenced_one(struct page *page, struct vm_area_struct *vma,
+	unsigned long address, unsigned int *mapcount, int ignore_token)
 {
 	struct mm_struct *mm = vma->vm_mm;
-	unsigned long address;
+	pmd_t *pmd = NULL;
 	pte_t *pte;
 	int referenced = 0;
 
-	address = vma_address(page, vma);
-	if (address == -EFAULT)
-		goto out;
-
-	pte = page_check_address(page, mm, address);
+	/*
+	 * A huge pmd is aged as it is: splitting it here would cost a TLB
+	 * flush of the mm, and khugepaged would only collapse it again.
+	 */
+	pte = __page_check_address(page, mm, address, &pmd);
 	if (!IS_ERR(pte)) {
-		if (ptep_clear_flush_young(vma, address, pte))
-			referenced++;
-
-		if (mm != current->mm && !ignore_token && has_swap_token(mm))
-			referenced++;
+		if (vma->vm_flags & VM_LOCKED) {
+			/*
+			 * Leave an mlocked page unreferenced and end the
+			 * walk: try_to_unmap() will find the VM_LOCKED vma
+			 * and reclaim moves the page to the unevictable LRU.
+			 */
+			*mapcount = 1;
+		} else {
+			if (pmd) {
+				if (pmdp_clear_flush_young(vma, address, pmd))
+					referenced++;
+			} else if (ptep_clear_flush_young(vma, address, pte))
+				referenced++;
+
+			if (mm != current->mm && !ignore_token &&
+			    has_swap_token(mm))
+				referenced++;
+		}
 
 		(*mapcount)--;
-		pte_unmap(pte);
+		if (pte)
+			pte_unmap(pte);
 		spin_unlock(&mm->page_table_lock);
 	}
-out:
 	return referenced;
 }
 
@@ -322,8 +357,12 @@ static int page_referenced_anon(struct page *page, int ignore_token)
 
 	mapcount = page_mapcount(page);
 	list_for_each_entry(vma, &anon_vma->head, anon_vma_node) {
-		referenced += page_referenced_one(page, vma, &mapcount,
-							ignore_token);
+		unsigned long address = vma_address(page, vma);
+
+		if (address == -EFAULT)
+			continue;
+		referenced += page_referenced_one(page, vma, address,
+						  &mapcount, ignore_token);
 		if (!mapcount)
 			break;
 	}
@@ -375,13 +414,12 @@ static int page_referenced_file(struct page *page, int ignore_token)
 	mapcount = page_mapcount(page);
 
 	vma_prio_tree_foreach(vma, &iter, &mapping->i_mmap, pgoff, pgoff) {
-		if ((vma->vm_flags & (VM_LOCKED|VM_MAYSHARE))
-				  == (VM_LOCKED|VM_MAYSHARE)) {
-			referenced++;
-			break;
-		}
-		referenced += page_referenced_one(page, vma, &mapcount,
-							ignore_token);
+		unsigned long address = vma_address(page, vma);
+
+		if (address == -EFAULT)
+			continue;
+		referenced += page_referenced_one(page, vma, address,
+						  &mapcount, ignore_token);
 		if (!mapcount)
 			break;
 	}
@@ -412,7 +450,9 @@ int page_referenced(struct page *page, int is_locked, int ignore_token)
 		referenced++;
 
 	if (page_mapped(page) && page->mapping) {
-		if (PageAnon(page))
+		if (PageKsm(page))
+			referenced += page_referenced_ksm(page, ignore_token);
+		else if (PageAnon(page))
 			referenced += page_referenced_anon(page, ignore_token);
 		else if (is_locked)
 			referenced += page_referenced_file(page, ignore_token);
@@ -504,7 +544,8 @@ void page_remove_rmap(struct page *page)
  * Subfunctions of try_to_unmap: try_to_unmap_one called
  * repeatedly from either try_to_unmap_anon or try_to_unmap_file.
  */
-static int try_to_unmap_one(struct page *page, struct vm_area_struct *vma)
+static int try_to_unmap_one(struct page *page, struct vm_area_struct *vma,
+				int migration)
 {
 	struct mm_struct *mm = vma->vm_mm;
 	unsigned long address;
@@ -521,14 +562,20 @@ static int try_to_unmap_one(struct page *page, struct vm_area_struct *vma)
 		goto out;
 
 	/*
-	 * If the page is mlock()d, we cannot swap it out.
+	 * If the page is mlock()d, we cannot swap it out: reclaim moves
+	 * it to the unevictable LRU instead.
 	 * If it's recently referenced (perhaps page_referenced
 	 * skipped over this mm) then we should reactivate it.
+	 * Neither matters to migration, which puts the page right back.
 	 *
 	 * Pages belonging to VM_RESERVED regions should not happen here.
 	 */
-	if ((vma->vm_flags & (VM_LOCKED|VM_RESERVED)) ||
-			ptep_clear_flush_young(vma, address, pte)) {
+	if (!migration && (vma->vm_flags & VM_LOCKED)) {
+		ret = SWAP_MLOCK;
+		goto out_unmap;
+	}
+	if ((vma->vm_flags & VM_RESERVED) ||
+	    (!migration && ptep_clear_flush_young(vma, address, pte))) {
 		ret = SWAP_FAIL;
 		goto out_unmap;
 	}
@@ -541,7 +588,18 @@ static int try_to_unmap_one(struct page *page, struct vm_area_struct *vma)
 	if (pte_dirty(pteval))
 		set_page_dirty(page);
 
-	if (PageAnon(page)) {
+	if (migration) {
+		/*
+		 * Store the pfn of the page in a migration entry, see
+		 * do_swap_page() and remove_migration_ptes().
+		 */
+		swp_entry_t entry;
+
+		entry = make_migration_entry(page, pte_write(pteval));
+		set_pte_at(mm, address, pte, swp_entry_to_pte(entry));
+		if (PageAnon(page))
+			dec_mm_counter(mm, anon_rss);
+	} else if (PageAnon(page)) {
 		swp_entry_t entry = { .val = page->private };
 		/*
 		 * Store the swap location in the pte.
@@ -672,7 +730,7 @@ out_unlock:
 	spin_unlock(&mm->page_table_lock);
 }
 
-static int try_to_unmap_anon(struct page *page)
+static int try_to_unmap_anon(struct page *page, int migration)
 {
 	struct anon_vma *anon_vma;
 	struct vm_area_struct *vma;
@@ -683,8 +741,9 @@ static int try_to_unmap_anon(struct page *page)
 		return ret;
 
 	list_for_each_entry(vma, &anon_vma->head, anon_vma_node) {
-		ret = try_to_unmap_one(page, vma);
-		if (ret == SWAP_FAIL || !page_mapped(page))
+		ret = try_to_unmap_one(page, vma, migration);
+		if (ret == SWAP_FAIL || ret == SWAP_MLOCK ||
+		    !page_mapped(page))
 			break;
 	}
 	spin_unlock(&anon_vma->lock);
@@ -694,13 +753,14 @@ static int try_to_unmap_anon(struct page *page)
 /**
  * try_to_unmap_file - unmap file page using the object-based rmap method
  * @page: the page to unmap
+ * @migration: replace the ptes by migration entries
  *
  * Find all the mappings of a page using the mapping pointer and the vma chains
  * contained in the address_space struct it points to.
  *
  * This function is only called from try_to_unmap for object-based pages.
  */
-static int try_to_unmap_file(struct page *page)
+static int try_to_unmap_file(struct page *page, int migration)
 {
 	struct address_space *mapping = page->mapping;
 	pgoff_t pgoff = page->index << (PAGE_CACHE_SHIFT - PAGE_SHIFT);
@@ -714,14 +774,24 @@ static int try_to_unmap_file(struct page *page)
 
 	spin_lock(&mapping->i_mmap_lock);
 	vma_prio_tree_foreach(vma, &iter, &mapping->i_mmap, pgoff, pgoff) {
-		ret = try_to_unmap_one(page, vma);
-		if (ret == SWAP_FAIL || !page_mapped(page))
+		ret = try_to_unmap_one(page, vma, migration);
+		if (ret == SWAP_FAIL || ret == SWAP_MLOCK ||
+		    !page_mapped(page))
 			goto out;
 	}
 
 	if (list_empty(&mapping->i_mmap_nonlinear))
 		goto out;
 
+	/*
+	 * Nonlinear ptes cannot be found from the page, so they cannot
+	 * be turned into migration entries either.
+	 */
+	if (migration) {
+		ret = SWAP_FAIL;
+		goto out;
+	}
+
 	list_for_each_entry(vma, &mapping->i_mmap_nonlinear,
 						shared.vm_set.list) {
 		if (vma->vm_flags & (VM_LOCKED|VM_RESERVED))
@@ -793,26 +863,32 @@ out:
 /**
  * try_to_unmap - try to remove all page table mappings to a page
  * @page: the page to get unmapped
+ * @migration: replace the ptes by migration entries instead of swap entries
  *
  * Tries to remove all the page table entries which are mapping this
- * page, used in the pageout path.  Caller must hold the page lock.
+ * page, used in the pageout path and by page migration.  Caller must
+ * hold the page lock.
  * Return values are:
  *
  * SWAP_SUCCESS	- we succeeded in removing all mappings
  * SWAP_AGAIN	- we missed a mapping, try again later
  * SWAP_FAIL	- the page is unswappable
+ * SWAP_MLOCK	- the page is mlocked
  */
-int try_to_unmap(struct page *page)
+int try_to_unmap(struct page *page, int migration)
 {
 	int ret;
 
 	BUG_ON(PageReserved(page));
 	BUG_ON(!PageLocked(page));
 
-	if (PageAnon(page))
-		ret = try_to_unmap_anon(page);
+	/* KSM pages stay in place until ksmd lets go of them */
+	if (PageKsm(page))
+		ret = SWAP_FAIL;
+	else if (PageAnon(page))
+		ret = try_to_unmap_anon(page, migration);
 	else
-		ret = try_to_unmap_file(page);
+		ret = try_to_unmap_file(page, migration);
 
 	if (!page_mapped(page))
 		ret = SWAP_SUCCESS;
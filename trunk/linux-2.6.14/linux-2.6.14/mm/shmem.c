@@ -367,7 +367,8 @@ static swp_entry_t *shmem_swp_alloc(struct shmem_inode_info *info, unsigned long
 		}
 
 		spin_unlock(&info->lock);
-		page = shmem_dir_alloc(mapping_gfp_mask(inode->i_mapping) | __GFP_ZERO);
+		page = shmem_dir_alloc((mapping_gfp_mask(inode->i_mapping) &
+					~__GFP_MOVABLE) | __GFP_ZERO);
 		if (page) {
 			page->nr_swapped = 0;
 		}
@@ -1107,6 +1108,7 @@ repeat:
 				error = -ENOMEM;
 				goto failed;
 			}
+			SetPageSwapBacked(filepage);
 
 			spin_lock(&info->lock);
 			entry = shmem_swp_alloc(info, idx, sgp);
@@ -1241,19 +1243,26 @@ int shmem_lock(struct file *file, int lock, struct user_struct *user)
 	struct shmem_inode_info *info = SHMEM_I(inode);
 	int retval = -ENOMEM;
 
+	int rescue = 0;
+
 	spin_lock(&info->lock);
 	if (lock && !(info->flags & VM_LOCKED)) {
 		if (!user_shm_lock(inode->i_size, user))
 			goto out_nomem;
 		info->flags |= VM_LOCKED;
+		mapping_set_unevictable(file->f_mapping);
 	}
 	if (!lock && (info->flags & VM_LOCKED) && user) {
 		user_shm_unlock(inode->i_size, user);
 		info->flags &= ~VM_LOCKED;
+		mapping_clear_unevictable(file->f_mapping);
+		rescue = 1;
 	}
 	retval = 0;
 out_nomem:
 	spin_unlock(&info->lock);
+	if (rescue)
+		scan_mapping_unevictable_pages(file->f_mapping);
 	return retval;
 }
 
@@ -0,0 +1,2491 @@
+/*
+ * linux/mm/slub.c
+ *
+ * SLUB: A slab allocator without object queues.
+ *
+ * An alternative to mm/slab.c with the same kmem_cache_* interface,
+ * selected at build time with CONFIG_SLUB.
+ *
+ * There are no per cpu arrays, no shared or alien caches and no
+ * per node lists of free objects. A slab is a group of contiguous pages
+ * and keeps its free objects on a list threaded through the objects
+ * themselves, anchored in the struct page of the first page:
+ *
+ *   page->slab		the cache the slab belongs to
+ *   page->freelist	first free object
+ *   page->inuse	number of objects handed out
+ *   page->lru		link in the node's partial list
+ *
+ * Each cpu allocates from one slab of its own (the cpu slab). Taking a
+ * slab as cpu slab "freezes" it: its freelist moves over to the cpu and
+ * the slab is no longer on any list. Allocations and frees of objects
+ * in the cpu slab only need interrupts disabled. Frees to other slabs
+ * take the slab lock (PG_locked of the first page), and the node's
+ * list_lock when the slab has to go onto or off the partial list.
+ *
+ * Full slabs are on no list at all, they are found again through the
+ * page of any of their objects when one is freed. Empty slabs are
+ * given back to the page allocator right away, apart from a few kept
+ * on the partial lists, so there is no need for a cache reaper.
+ *
+ * Caches with compatible size, alignment and flags and without
+ * constructor are merged into one, which makes most of the small
+ * caches go away. Every cache shows up under /sys/slab, merged ones
+ * as symlinks to the cache they were merged into.
+ *
+ * Lock order:
+ *   1. slub_lock (Global Semaphore)
+ *   2. node->list_lock
+ *   3. slab_lock(page)
+ *
+ * The slab lock is taken with a trylock under the list_lock, so the
+ * inverse order in the free path cannot deadlock.
+ */
+
+#include <linux/config.h>
+#include <linux/mm.h>
+#include <linux/module.h>
+#include <linux/bit_spinlock.h>
+#include <linux/interrupt.h>
+#include <linux/bitops.h>
+#include <linux/slab.h>
+#include <linux/swap.h>
+#include <linux/seq_file.h>
+#include <linux/cpu.h>
+#include <linux/cpuset.h>
+#include <linux/kobject.h>
+#include <linux/rcupdate.h>
+#include <linux/rwsem.h>
+#include <linux/string.h>
+#include <linux/nodemask.h>
+
+#include <asm/uaccess.h>
+
+/*
+ * Flags which prevent merging of caches: debugging requests the caller
+ * made for the cache in particular, and RCU freeing of the slabs.
+ */
+#define SLUB_NEVER_MERGE (SLAB_DEBUG_FREE | SLAB_DEBUG_INITIAL | \
+		SLAB_RED_ZONE | SLAB_POISON | SLAB_STORE_USER | \
+		SLAB_DESTROY_BY_RCU)
+
+/* Flags which have to be the same for caches to be merged */
+#define SLUB_MERGE_SAME (SLAB_RECLAIM_ACCOUNT | SLAB_CACHE_DMA)
+
+/*
+ * Mininum number of partial slabs kept around per node, so that a
+ * cache which allocates and frees about the same number of objects
+ * does not keep going to the page allocator.
+ */
+#define MIN_PARTIAL 2
+
+#ifndef ARCH_KMALLOC_MINALIGN
+#define ARCH_KMALLOC_MINALIGN __alignof__(unsigned long long)
+#endif
+
+#ifndef ARCH_SLAB_MINALIGN
+#define ARCH_SLAB_MINALIGN __alignof__(unsigned long long)
+#endif
+
+/* Objects can be up to the largest block of the page allocator */
+#define MAX_OBJ_ORDER	(MAX_ORDER - 1)
+
+/* Per cpu structures taken from a static pool before kmalloc_node() */
+#define NR_KMEM_CACHE_CPU 100
+
+enum stat_item {
+	ALLOC_FASTPATH,		/* Allocation from cpu slab */
+	ALLOC_SLOWPATH,		/* Allocation by getting a new cpu slab */
+	FREE_FASTPATH,		/* Free to cpu slab */
+	FREE_SLOWPATH,		/* Freeing not to cpu slab */
+	FREE_FROZEN,		/* Freeing to frozen slab */
+	FREE_ADD_PARTIAL,	/* Freeing moves slab to partial list */
+	FREE_REMOVE_PARTIAL,	/* Freeing removes last object */
+	ALLOC_FROM_PARTIAL,	/* Cpu slab acquired from partial list */
+	ALLOC_SLAB,		/* Cpu slab acquired from page allocator */
+	ALLOC_REFILL,		/* Refill cpu slab from slab freelist */
+	FREE_SLAB,		/* Slab freed to the page allocator */
+	CPUSLAB_FLUSH,		/* Abandoning of the cpu slab */
+	DEACTIVATE_FULL,	/* Cpu slab was full when deactivated */
+	DEACTIVATE_EMPTY,	/* Cpu slab was empty when deactivated */
+	DEACTIVATE_TO_HEAD,	/* Cpu slab was moved to the head of partials */
+	DEACTIVATE_TO_TAIL,	/* Cpu slab was moved to the tail of partials */
+	NR_SLUB_STAT_ITEMS
+};
+
+struct kmem_cache_cpu {
+	void **freelist;	/* Free objects of the cpu slab */
+	struct page *page;	/* The slab from which we are allocating */
+	int node;		/* The node of the page (or -1 for debug) */
+	unsigned int offset;	/* Freepointer offset (in word units) */
+	unsigned int objsize;	/* Size of an object (from kmem_cache) */
+#ifdef CONFIG_SLUB_STATS
+	unsigned stat[NR_SLUB_STAT_ITEMS];
+#endif
+};
+
+struct kmem_cache_node {
+	spinlock_t list_lock;	/* Protect partial list and nr_partial */
+	unsigned long nr_partial;
+	atomic_t nr_slabs;
+	struct list_head partial;
+};
+
+/*
+ * Slab cache management.
+ */
+struct kmem_cache_s {
+	/* Used for retriving partial slabs etc */
+	unsigned long flags;
+	int size;		/* The size of an object including meta data */
+	int objsize;		/* The size of an object without meta data */
+	int offset;		/* Free pointer offset. */
+	int order;
+	int objects;		/* Number of objects in slab */
+	int refcount;		/* Refcount for slab cache destroy */
+	void (*ctor)(void *, kmem_cache_t *, unsigned long);
+	void (*dtor)(void *, kmem_cache_t *, unsigned long);
+	int inuse;		/* Offset to metadata */
+	int align;		/* Alignment */
+	const char *name;	/* Name (only for display!) */
+	struct list_head list;	/* List of slab caches */
+#ifdef CONFIG_SYSFS
+	struct kobject kobj;	/* For sysfs */
+#endif
+#ifdef CONFIG_NUMA
+	struct kmem_cache_node *node[MAX_NUMNODES];
+#else
+	struct kmem_cache_node local_node;
+#endif
+	struct kmem_cache_cpu *cpu_slab[NR_CPUS];
+};
+
+/*
+ * Tracking of the state of the allocator during bootstrap.
+ */
+static enum {
+	DOWN,		/* No slab functionality available */
+	PARTIAL,	/* kmem_cache_node cache for NUMA is available */
+	UP,		/* Everything works but does not show up in sysfs */
+	SYSFS		/* Sysfs up */
+} slab_state = DOWN;
+
+/* A list of all slab caches on the system */
+static DECLARE_RWSEM(slub_lock);
+static LIST_HEAD(slab_caches);
+
+atomic_t slab_reclaim_pages;
+EXPORT_SYMBOL(slab_reclaim_pages);
+
+#ifdef CONFIG_SYSFS
+static int sysfs_slab_add(kmem_cache_t *);
+static int sysfs_slab_alias(kmem_cache_t *, const char *);
+static void sysfs_slab_remove(kmem_cache_t *);
+#else
+static inline int sysfs_slab_add(kmem_cache_t *s) { return 0; }
+static inline int sysfs_slab_alias(kmem_cache_t *s, const char *p)
+							{ return 0; }
+static inline void sysfs_slab_remove(kmem_cache_t *s)
+{
+	kfree(s);
+}
+#endif
+
+static inline void stat(struct kmem_cache_cpu *c, enum stat_item si)
+{
+#ifdef CONFIG_SLUB_STATS
+	c->stat[si]++;
+#endif
+}
+
+/********************************************************************
+ * 			Core slab cache functions
+ *******************************************************************/
+
+static inline struct kmem_cache_node *get_node(kmem_cache_t *s, int node)
+{
+#ifdef CONFIG_NUMA
+	return s->node[node];
+#else
+	return &s->local_node;
+#endif
+}
+
+static inline struct kmem_cache_cpu *get_cpu_slab(kmem_cache_t *s, int cpu)
+{
+	return s->cpu_slab[cpu];
+}
+
+/*
+ * The pages of a slab are not a compound page: every page of the slab
+ * has PG_slab set and its ->private pointing to the first one.
+ */
+static inline struct page *virt_to_slab_page(const void *x)
+{
+	return (struct page *)virt_to_page(x)->private;
+}
+
+static inline void *get_freepointer(kmem_cache_t *s, void *object)
+{
+	return *(void **)(object + s->offset);
+}
+
+static inline void set_freepointer(kmem_cache_t *s, void *object, void *fp)
+{
+	*(void **)(object + s->offset) = fp;
+}
+
+/* Loop over all objects in a slab */
+#define for_each_object(__p, __s, __addr) \
+	for (__p = (__addr); __p < (__addr) + (__s)->objects * (__s)->size;\
+			__p += (__s)->size)
+
+/*
+ * Slabs which are the cpu slab of some cpu are "frozen": they are on no
+ * list, and frees to them do not move them around.
+ */
+static inline int SlabFrozen(struct page *page)
+{
+	return PageActive(page);
+}
+
+static inline void SetSlabFrozen(struct page *page)
+{
+	SetPageActive(page);
+}
+
+static inline void ClearSlabFrozen(struct page *page)
+{
+	ClearPageActive(page);
+}
+
+/*
+ * Per slab locking using the pagelock
+ */
+static __always_inline void slab_lock(struct page *page)
+{
+	bit_spin_lock(PG_locked, &page->flags);
+}
+
+static __always_inline void slab_unlock(struct page *page)
+{
+	bit_spin_unlock(PG_locked, &page->flags);
+}
+
+static __always_inline int slab_trylock(struct page *page)
+{
+	return bit_spin_trylock(PG_locked, &page->flags);
+}
+
+/*
+ * Tunables, settable on the kernel command line.
+ */
+static int slub_min_order;
+static int slub_max_order = 1;
+static int slub_min_objects = 8;
+static int slub_nomerge;
+
+static int __init setup_slub_min_order(char *str)
+{
+	get_option(&str, &slub_min_order);
+	return 1;
+}
+
+__setup("slub_min_order=", setup_slub_min_order);
+
+static int __init setup_slub_max_order(char *str)
+{
+	get_option(&str, &slub_max_order);
+	return 1;
+}
+
+__setup("slub_max_order=", setup_slub_max_order);
+
+static int __init setup_slub_min_objects(char *str)
+{
+	get_option(&str, &slub_min_objects);
+	return 1;
+}
+
+__setup("slub_min_objects=", setup_slub_min_objects);
+
+static int __init setup_slub_nomerge(char *str)
+{
+	slub_nomerge = 1;
+	return 1;
+}
+
+__setup("slub_nomerge", setup_slub_nomerge);
+
+/********************************************************************
+ *			Slab allocation and freeing
+ *******************************************************************/
+
+static struct page *allocate_slab(kmem_cache_t *s, gfp_t flags, int node)
+{
+	struct page *page;
+	int i, pages = 1 << s->order;
+
+	/* Slab pages are grouped by the cache, not by the caller */
+	flags &= ~GFP_MOVABLE_MASK;
+	if (s->flags & SLAB_CACHE_DMA)
+		flags |= GFP_DMA;
+	if (s->flags & SLAB_RECLAIM_ACCOUNT)
+		flags |= __GFP_RECLAIMABLE;
+
+	if (node == -1)
+		page = alloc_pages(flags, s->order);
+	else
+		page = alloc_pages_node(node, flags, s->order);
+
+	if (!page)
+		return NULL;
+
+	if (s->flags & SLAB_RECLAIM_ACCOUNT)
+		atomic_add(pages, &slab_reclaim_pages);
+	add_page_state(nr_slab, pages);
+
+	for (i = 0; i < pages; i++) {
+		SetPageSlab(page + i);
+		page[i].private = (unsigned long)page;
+	}
+	return page;
+}
+
+static void setup_object(kmem_cache_t *s, struct page *page, void *object,
+			 gfp_t flags)
+{
+	if (unlikely(s->ctor)) {
+		unsigned long ctor_flags = SLAB_CTOR_CONSTRUCTOR;
+
+		if (!(flags & __GFP_WAIT))
+			ctor_flags |= SLAB_CTOR_ATOMIC;
+		s->ctor(object, s, ctor_flags);
+	}
+}
+
+static struct page *new_slab(kmem_cache_t *s, gfp_t flags, int node)
+{
+	struct page *page;
+	struct kmem_cache_node *n;
+	void *start;
+	void *last;
+	void *p;
+
+	page = allocate_slab(s, flags & GFP_LEVEL_MASK, node);
+	if (!page)
+		return NULL;
+
+	n = get_node(s, page_to_nid(page));
+	if (n)
+		atomic_inc(&n->nr_slabs);
+	page->slab = s;
+
+	start = page_address(page);
+	last = start;
+	for_each_object(p, s, start) {
+		setup_object(s, page, last, flags);
+		set_freepointer(s, last, p);
+		last = p;
+	}
+	setup_object(s, page, last, flags);
+	set_freepointer(s, last, NULL);
+
+	page->freelist = start;
+	page->inuse = 0;
+	return page;
+}
+
+static void __free_slab(kmem_cache_t *s, struct page *page)
+{
+	int i, pages = 1 << s->order;
+
+	if (unlikely(s->dtor)) {
+		void *p;
+
+		for_each_object(p, s, page_address(page))
+			s->dtor(p, s, 0);
+	}
+
+	for (i = 0; i < pages; i++) {
+		BUG_ON(!TestClearPageSlab(page + i));
+		page[i].private = 0;
+	}
+	page->mapping = NULL;
+	reset_page_mapcount(page);
+
+	sub_page_state(nr_slab, pages);
+	if (current->reclaim_state)
+		current->reclaim_state->reclaimed_slab += pages;
+	__free_pages(page, s->order);
+	if (s->flags & SLAB_RECLAIM_ACCOUNT)
+		atomic_sub(pages, &slab_reclaim_pages);
+}
+
+static void rcu_free_slab(struct rcu_head *h)
+{
+	struct page *page;
+
+	page = container_of((struct list_head *)h, struct page, lru);
+	__free_slab(page->slab, page);
+}
+
+static void free_slab(kmem_cache_t *s, struct page *page)
+{
+	if (unlikely(s->flags & SLAB_DESTROY_BY_RCU)) {
+		/*
+		 * RCU free overloads the RCU head over the LRU
+		 */
+		struct rcu_head *head = (void *)&page->lru;
+
+		call_rcu(head, rcu_free_slab);
+	} else
+		__free_slab(s, page);
+}
+
+static void discard_slab(kmem_cache_t *s, struct page *page)
+{
+	struct kmem_cache_node *n = get_node(s, page_to_nid(page));
+
+	atomic_dec(&n->nr_slabs);
+	free_slab(s, page);
+}
+
+/********************************************************************
+ *			Partial slab lists
+ *******************************************************************/
+
+static void add_partial(struct kmem_cache_node *n, struct page *page,
+			int tail)
+{
+	spin_lock(&n->list_lock);
+	n->nr_partial++;
+	if (tail)
+		list_add_tail(&page->lru, &n->partial);
+	else
+		list_add(&page->lru, &n->partial);
+	spin_unlock(&n->list_lock);
+}
+
+static void remove_partial(kmem_cache_t *s, struct page *page)
+{
+	struct kmem_cache_node *n = get_node(s, page_to_nid(page));
+
+	spin_lock(&n->list_lock);
+	list_del(&page->lru);
+	n->nr_partial--;
+	spin_unlock(&n->list_lock);
+}
+
+/*
+ * Lock slab and remove from the partial list.
+ *
+ * Must hold list_lock.
+ */
+static inline int lock_and_freeze_slab(struct kmem_cache_node *n,
+				       struct page *page)
+{
+	if (slab_trylock(page)) {
+		list_del(&page->lru);
+		n->nr_partial--;
+		SetSlabFrozen(page);
+		return 1;
+	}
+	return 0;
+}
+
+/*
+ * Try to allocate a partial slab from a specific node.
+ */
+static struct page *get_partial_node(struct kmem_cache_node *n)
+{
+	struct page *page;
+
+	/*
+	 * Racy check. If we mistakenly see no partial slabs then we
+	 * just allocate an empty slab. If we mistakenly try to get a
+	 * partial slab and there is none available then get_partials()
+	 * will return NULL.
+	 */
+	if (!n || !n->nr_partial)
+		return NULL;
+
+	spin_lock(&n->list_lock);
+	list_for_each_entry(page, &n->partial, lru)
+		if (lock_and_freeze_slab(n, page))
+			goto out;
+	page = NULL;
+out:
+	spin_unlock(&n->list_lock);
+	return page;
+}
+
+/*
+ * Get a page from somewhere. Search in increasing NUMA distances.
+ */
+static struct page *get_any_partial(kmem_cache_t *s, gfp_t flags)
+{
+#ifdef CONFIG_NUMA
+	struct zonelist *zonelist;
+	struct zone **z;
+	struct page *page;
+
+	/*
+	 * Only raid other nodes' partial lists if they have more than
+	 * the minimum: the local node is better off allocating a fresh
+	 * slab of its own than taking the last partial slabs of another
+	 * node, which would then have to allocate one itself.
+	 */
+	zonelist = &NODE_DATA(numa_node_id())->node_zonelists[flags &
+							       GFP_ZONEMASK];
+	for (z = zonelist->zones; *z; z++) {
+		struct kmem_cache_node *n;
+
+		n = get_node(s, (*z)->zone_pgdat->node_id);
+
+		if (n && cpuset_zone_allowed(*z, flags) &&
+				n->nr_partial > MIN_PARTIAL) {
+			page = get_partial_node(n);
+			if (page)
+				return page;
+		}
+	}
+#endif
+	return NULL;
+}
+
+/*
+ * Get a partial page, lock it and return it.
+ */
+static struct page *get_partial(kmem_cache_t *s, gfp_t flags, int node)
+{
+	struct page *page;
+	int searchnode = (node == -1) ? numa_node_id() : node;
+
+	page = get_partial_node(get_node(s, searchnode));
+	if (page || node != -1)
+		return page;
+
+	return get_any_partial(s, flags);
+}
+
+/*
+ * Move a page back to the lists.
+ *
+ * Must be called with the slab lock held.
+ *
+ * On exit the slab lock will have been dropped.
+ */
+static void unfreeze_slab(kmem_cache_t *s, struct page *page, int tail)
+{
+	struct kmem_cache_node *n = get_node(s, page_to_nid(page));
+	struct kmem_cache_cpu *c = get_cpu_slab(s, smp_processor_id());
+
+	ClearSlabFrozen(page);
+	if (page->inuse) {
+
+		if (page->freelist) {
+			add_partial(n, page, tail);
+			stat(c, tail ? DEACTIVATE_TO_TAIL : DEACTIVATE_TO_HEAD);
+		} else
+			stat(c, DEACTIVATE_FULL);
+		slab_unlock(page);
+	} else {
+		stat(c, DEACTIVATE_EMPTY);
+		if (n->nr_partial < MIN_PARTIAL) {
+			/*
+			 * Adding an empty slab to the partial slabs in order
+			 * to avoid page allocator overhead. This slab needs
+			 * to come after the other slabs with objects in
+			 * so that the others get filled first. That way the
+			 * size of the partial list stays small.
+			 */
+			add_partial(n, page, 1);
+			slab_unlock(page);
+		} else {
+			slab_unlock(page);
+			stat(c, FREE_SLAB);
+			discard_slab(s, page);
+		}
+	}
+}
+
+/*
+ * Remove the cpu slab
+ */
+static void deactivate_slab(kmem_cache_t *s, struct kmem_cache_cpu *c)
+{
+	struct page *page = c->page;
+	int tail = 1;
+
+	/*
+	 * Merge cpu freelist into slab freelist. Typically we get here
+	 * because both freelists are empty. So this is unlikely
+	 * to occur.
+	 */
+	while (unlikely(c->freelist)) {
+		void **object;
+
+		tail = 0;	/* Hot objects. Put the slab first */
+
+		/* Retrieve object from cpu_freelist */
+		object = c->freelist;
+		c->freelist = c->freelist[c->offset];
+
+		/* And put onto the regular freelist */
+		object[c->offset] = page->freelist;
+		page->freelist = object;
+		page->inuse--;
+	}
+	c->page = NULL;
+	unfreeze_slab(s, page, tail);
+}
+
+static inline void flush_slab(kmem_cache_t *s, struct kmem_cache_cpu *c)
+{
+	stat(c, CPUSLAB_FLUSH);
+	slab_lock(c->page);
+	deactivate_slab(s, c);
+}
+
+/*
+ * Flush cpu slab.
+ * Called from IPI handler with interrupts disabled.
+ */
+static inline void __flush_cpu_slab(kmem_cache_t *s, int cpu)
+{
+	struct kmem_cache_cpu *c = get_cpu_slab(s, cpu);
+
+	if (likely(c && c->page))
+		flush_slab(s, c);
+}
+
+static void flush_cpu_slab(void *d)
+{
+	kmem_cache_t *s = d;
+
+	__flush_cpu_slab(s, smp_processor_id());
+}
+
+static void flush_all(kmem_cache_t *s)
+{
+	on_each_cpu(flush_cpu_slab, s, 1, 1);
+}
+
+/*
+ * Check if the objects in a per cpu structure fit numa
+ * locality expectations.
+ */
+static inline int node_match(struct kmem_cache_cpu *c, int node)
+{
+#ifdef CONFIG_NUMA
+	if (node != -1 && c->node != node)
+		return 0;
+#endif
+	return 1;
+}
+
+/*
+ * Slow path. The lockless freelist is empty or we need to perform
+ * debugging duties.
+ *
+ * Interrupts are disabled.
+ *
+ * Processing is still very fast if new objects have been freed to the
+ * regular freelist. In that case we simply take over the regular freelist
+ * as the lockless freelist and zap the regular freelist.
+ *
+ * If that is not working then we fall back to the partial lists. We take the
+ * first element of the freelist as the object to allocate now and move the
+ * rest of the freelist to the lockless freelist.
+ *
+ * And if we were unable to get a new slab from the partial slab lists then
+ * we need to allocate a new slab. This is slowest path since we may sleep.
+ */
+static void *__slab_alloc(kmem_cache_t *s, gfp_t gfpflags, int node,
+			  struct kmem_cache_cpu *c)
+{
+	void **object;
+	struct page *new;
+
+	if (!c->page)
+		goto new_slab;
+
+	slab_lock(c->page);
+	if (unlikely(!node_match(c, node)))
+		goto another_slab;
+
+	stat(c, ALLOC_REFILL);
+
+load_freelist:
+	object = c->page->freelist;
+	if (unlikely(!object))
+		goto another_slab;
+
+	c->freelist = object[c->offset];
+	c->page->inuse = s->objects;
+	c->page->freelist = NULL;
+	c->node = page_to_nid(c->page);
+	slab_unlock(c->page);
+	stat(c, ALLOC_SLOWPATH);
+	return object;
+
+another_slab:
+	deactivate_slab(s, c);
+
+new_slab:
+	new = get_partial(s, gfpflags, node);
+	if (new) {
+		c->page = new;
+		stat(c, ALLOC_FROM_PARTIAL);
+		goto load_freelist;
+	}
+
+	if (unlikely(gfpflags & SLAB_NO_GROW))
+		return NULL;
+
+	if (gfpflags & __GFP_WAIT)
+		local_irq_enable();
+
+	new = new_slab(s, gfpflags, node);
+
+	if (gfpflags & __GFP_WAIT)
+		local_irq_disable();
+
+	if (new) {
+		/* We may have been rescheduled to another cpu */
+		c = get_cpu_slab(s, smp_processor_id());
+		stat(c, ALLOC_SLAB);
+		if (c->page)
+			flush_slab(s, c);
+		slab_lock(new);
+		SetSlabFrozen(new);
+		c->page = new;
+		goto load_freelist;
+	}
+	return NULL;
+}
+
+/*
+ * Inlined fastpath so that allocation functions (kmalloc, kmem_cache_alloc)
+ * have the fastpath folded into their functions. So no function call
+ * overhead for requests that can be satisfied on the fastpath.
+ *
+ * The fastpath works by first checking if the lockless freelist can be used.
+ * If not then __slab_alloc is called for slow processing.
+ *
+ * Otherwise we can simply pick the next object from the lockless free list.
+ */
+static __always_inline void *slab_alloc(kmem_cache_t *s, gfp_t gfpflags,
+					int node)
+{
+	void **object;
+	unsigned long flags;
+	struct kmem_cache_cpu *c;
+
+	local_irq_save(flags);
+	c = get_cpu_slab(s, smp_processor_id());
+	if (unlikely(!c->freelist || !node_match(c, node)))
+
+		object = __slab_alloc(s, gfpflags, node, c);
+
+	else {
+		object = c->freelist;
+		c->freelist = object[c->offset];
+		stat(c, ALLOC_FASTPATH);
+	}
+	local_irq_restore(flags);
+
+	return object;
+}
+
+/**
+ * kmem_cache_alloc - Allocate an object
+ * @cachep: The cache to allocate from.
+ * @flags: See kmalloc().
+ *
+ * Allocate an object from this cache.  The flags are only relevant
+ * if the cache has no available objects.
+ */
+void *kmem_cache_alloc(kmem_cache_t *cachep, gfp_t flags)
+{
+	return slab_alloc(cachep, flags, -1);
+}
+EXPORT_SYMBOL(kmem_cache_alloc);
+
+#ifdef CONFIG_NUMA
+/**
+ * kmem_cache_alloc_node - Allocate an object on the specified node
+ * @cachep: The cache to allocate from.
+ * @flags: See kmalloc().
+ * @nodeid: node number of the target node.
+ *
+ * Identical to kmem_cache_alloc, except that this function is slow
+ * and can sleep. And it will allocate memory on the given node, which
+ * can improve the performance for cpu bound structures.
+ */
+void *kmem_cache_alloc_node(kmem_cache_t *cachep, gfp_t flags, int nodeid)
+{
+	return slab_alloc(cachep, flags, nodeid);
+}
+EXPORT_SYMBOL(kmem_cache_alloc_node);
+#endif
+
+/*
+ * Slow patch handling. This may still be called frequently since objects
+ * have a longer lifetime than the cpu slabs in most processing loads.
+ *
+ * So we still attempt to reduce cache line usage. Just take the slab
+ * lock and free the item. If there is no additional partial page
+ * handling required then we can return immediately.
+ */
+static void __slab_free(kmem_cache_t *s, struct page *page, void *x,
+			unsigned int offset)
+{
+	void *prior;
+	void **object = (void *)x;
+	struct kmem_cache_cpu *c;
+
+	c = get_cpu_slab(s, raw_smp_processor_id());
+	stat(c, FREE_SLOWPATH);
+	slab_lock(page);
+
+	prior = object[offset] = page->freelist;
+	page->freelist = object;
+	page->inuse--;
+
+	if (unlikely(SlabFrozen(page))) {
+		stat(c, FREE_FROZEN);
+		goto out_unlock;
+	}
+
+	if (unlikely(!page->inuse))
+		goto slab_empty;
+
+	/*
+	 * Objects left in the slab. If it was not on the partial list
+	 * before then add it.
+	 */
+	if (unlikely(!prior)) {
+		add_partial(get_node(s, page_to_nid(page)), page, 1);
+		stat(c, FREE_ADD_PARTIAL);
+	}
+
+out_unlock:
+	slab_unlock(page);
+	return;
+
+slab_empty:
+	if (prior) {
+		/*
+		 * Slab still on the partial list.
+		 */
+		remove_partial(s, page);
+		stat(c, FREE_REMOVE_PARTIAL);
+	}
+	slab_unlock(page);
+	stat(c, FREE_SLAB);
+	discard_slab(s, page);
+}
+
+/*
+ * Fastpath with forced inlining to produce a kfree and kmem_cache_free that
+ * can perform fastpath freeing without additional function calls.
+ *
+ * The fastpath is only possible if we are freeing to the current cpu slab
+ * of this processor. This typically the case if we have just allocated
+ * the item before.
+ *
+ * If fastpath is not possible then fall back to __slab_free where we deal
+ * with all sorts of special processing.
+ */
+static __always_inline void slab_free(kmem_cache_t *s, struct page *page,
+				      void *x)
+{
+	void **object = (void *)x;
+	unsigned long flags;
+	struct kmem_cache_cpu *c;
+
+	local_irq_save(flags);
+	c = get_cpu_slab(s, smp_processor_id());
+	if (likely(page == c->page)) {
+		object[c->offset] = c->freelist;
+		c->freelist = object;
+		stat(c, FREE_FASTPATH);
+	} else
+		__slab_free(s, page, x, c->offset);
+
+	local_irq_restore(flags);
+}
+
+/**
+ * kmem_cache_free - Deallocate an object
+ * @cachep: The cache the allocation was from.
+ * @objp: The previously allocated object.
+ *
+ * Free an object which was previously allocated from this
+ * cache.
+ */
+void kmem_cache_free(kmem_cache_t *cachep, void *objp)
+{
+	struct page *page = virt_to_slab_page(objp);
+
+	slab_free(cachep, page, objp);
+}
+EXPORT_SYMBOL(kmem_cache_free);
+
+/********************************************************************
+ *			Slab size calculation
+ *******************************************************************/
+
+/*
+ * Calculate the order of allocation given an slab object size.
+ *
+ * The order of allocation has significant impact on performance and other
+ * system components. Generally order 0 allocations should be preferred since
+ * order 0 does not cause fragmentation in the page allocator. Larger objects
+ * be problematic to put into order 0 slabs because there may be too much
+ * unused space left. We go to a higher order if more than 1/8th of the slab
+ * would be wasted.
+ *
+ * In order to reach satisfactory performance we must ensure that a minimum
+ * number of objects is in one slab. Otherwise we may generate too much
+ * activity on the partial lists which requires taking the list_lock. This is
+ * less a concern for large slabs though which are rarely used.
+ *
+ * slub_max_order specifies the order where we begin to stop considering the
+ * number of objects in a slab as critical. If we reach slub_max_order then
+ * we try to keep the page order as low as possible. So we accept more waste
+ * of space in favor of a small page order.
+ *
+ * Higher order allocations also allow the placement of more objects in a
+ * slab and thereby reduce object handling overhead. If the user has
+ * requested a higher mininum order then we start with that one instead of
+ * the smallest order which will fit the object.
+ */
+static inline int slab_order(int size, int min_objects,
+			     int max_order, int fract_leftover)
+{
+	int order;
+	int rem;
+	int min_order = slub_min_order;
+
+	for (order = max(min_order,
+				fls(min_objects * size - 1) - PAGE_SHIFT);
+			order <= max_order; order++) {
+
+		unsigned long slab_size = PAGE_SIZE << order;
+
+		if (slab_size < min_objects * size)
+			continue;
+
+		rem = slab_size % size;
+
+		if (rem <= slab_size / fract_leftover)
+			break;
+
+	}
+
+	return order;
+}
+
+static inline int calculate_order(int size)
+{
+	int order;
+	int min_objects;
+	int fraction;
+
+	/*
+	 * Attempt to find best configuration for a slab. This
+	 * works by first attempting to generate a layout with
+	 * the best configuration and backing off gradually.
+	 *
+	 * First we reduce the acceptable waste in a slab. Then
+	 * we reduce the minimum objects required in a slab.
+	 */
+	min_objects = slub_min_objects;
+	while (min_objects > 1) {
+		fraction = 8;
+		while (fraction >= 4) {
+			order = slab_order(size, min_objects,
+						slub_max_order, fraction);
+			if (order <= slub_max_order)
+				return order;
+			fraction /= 2;
+		}
+		min_objects /= 2;
+	}
+
+	/*
+	 * We were unable to place multiple objects in a slab. Now
+	 * lets see if we can place a single object there.
+	 */
+	order = slab_order(size, 1, slub_max_order, 1);
+	if (order <= slub_max_order)
+		return order;
+
+	/*
+	 * Doh this slab cannot be placed using slub_max_order.
+	 */
+	order = slab_order(size, 1, MAX_ORDER - 1, 1);
+	if (order <= MAX_ORDER - 1)
+		return order;
+	return -ENOSYS;
+}
+
+/*
+ * Figure out what the alignment of the objects will be.
+ */
+static unsigned long calculate_alignment(unsigned long flags,
+		unsigned long align, unsigned long size)
+{
+	/*
+	 * If the user wants hardware cache aligned objects then
+	 * follow that suggestion if the object is sufficiently
+	 * large.
+	 *
+	 * The hardware cache alignment cannot override the
+	 * specified alignment though. If that is greater
+	 * then use it.
+	 */
+	if ((flags & SLAB_MUST_HWCACHE_ALIGN) ||
+	    ((flags & SLAB_HWCACHE_ALIGN) && size > cache_line_size() / 2))
+		return max_t(unsigned long, align, cache_line_size());
+
+	if (align < ARCH_SLAB_MINALIGN)
+		return ARCH_SLAB_MINALIGN;
+
+	return ALIGN(align, sizeof(void *));
+}
+
+/*
+ * calculate_sizes() determines the order and the distribution of data within
+ * a slab object.
+ */
+static int calculate_sizes(kmem_cache_t *s)
+{
+	unsigned long flags = s->flags;
+	unsigned long size = s->objsize;
+	unsigned long align = s->align;
+
+	/*
+	 * Round up object size to the next word boundary. We can only
+	 * place the free pointer at word boundaries and this determines
+	 * the possible location of the free pointer.
+	 */
+	size = ALIGN(size, sizeof(void *));
+
+	/*
+	 * With that we have determined the number of bytes in actual use
+	 * by the object. This is the potential offset to the free pointer.
+	 */
+	s->inuse = size;
+
+	if ((flags & SLAB_DESTROY_BY_RCU) || s->ctor || s->dtor) {
+		/*
+		 * Relocate free pointer after the object if it is not
+		 * permitted to overwrite the first word of the object on
+		 * kmem_cache_free.
+		 *
+		 * This is the case if we do RCU, have a constructor or
+		 * destructor.
+		 */
+		s->offset = size;
+		size += sizeof(void *);
+	}
+
+	/*
+	 * Determine the alignment based on various parameters that the
+	 * user specified and the dynamic determination of cache line size
+	 * on bootup.
+	 */
+	align = calculate_alignment(flags, align, s->objsize);
+
+	/*
+	 * Round up object size to the next boundary to make sure that
+	 * the next object starts at an aligned boundary.
+	 */
+	size = ALIGN(size, align);
+	s->size = size;
+
+	s->order = calculate_order(size);
+	if (s->order < 0)
+		return 0;
+
+	/*
+	 * Determine the number of objects per slab
+	 */
+	s->objects = (PAGE_SIZE << s->order) / size;
+
+	return !!s->objects;
+}
+
+/********************************************************************
+ *			Per cpu and per node structures
+ *******************************************************************/
+
+static void init_kmem_cache_cpu(kmem_cache_t *s, struct kmem_cache_cpu *c)
+{
+	memset(c, 0, sizeof(*c));
+	c->node = 0;
+	c->offset = s->offset / sizeof(void *);
+	c->objsize = s->objsize;
+}
+
+static void init_kmem_cache_node(struct kmem_cache_node *n)
+{
+	n->nr_partial = 0;
+	atomic_set(&n->nr_slabs, 0);
+	spin_lock_init(&n->list_lock);
+	INIT_LIST_HEAD(&n->partial);
+}
+
+/*
+ * Per cpu array for per cpu structures.
+ *
+ * The per cpu array places all kmem_cache_cpu structures from one processor
+ * close together meaning that it becomes possible that multiple per cpu
+ * structures are contained in one cacheline. This may be particularly
+ * beneficial for the kmalloc caches.
+ *
+ * A desktop system typically has around 60-80 slabs. With 100 here we are
+ * likely able to get per cpu structures for all caches from the array defined
+ * here. We must be able to cover all kmalloc caches during bootstrap.
+ *
+ * If the per cpu array is exhausted then fall back to kmalloc
+ * of individual cachelines. No sharing is possible then.
+ *
+ * The pool is manipulated under slub_lock only.
+ */
+static DEFINE_PER_CPU(struct kmem_cache_cpu,
+				kmem_cache_cpu)[NR_KMEM_CACHE_CPU];
+
+static DEFINE_PER_CPU(struct kmem_cache_cpu *, kmem_cache_cpu_free);
+
+static struct kmem_cache_cpu *alloc_kmem_cache_cpu(kmem_cache_t *s,
+						   int cpu, gfp_t flags)
+{
+	struct kmem_cache_cpu *c = per_cpu(kmem_cache_cpu_free, cpu);
+
+	if (c)
+		per_cpu(kmem_cache_cpu_free, cpu) =
+				(void *)c->freelist;
+	else {
+		/* Table overflow: So allocate ourselves */
+		c = kmalloc_node(
+			ALIGN(sizeof(struct kmem_cache_cpu), cache_line_size()),
+			flags, cpu_to_node(cpu));
+		if (!c)
+			return NULL;
+	}
+
+	init_kmem_cache_cpu(s, c);
+	return c;
+}
+
+static void free_kmem_cache_cpu(struct kmem_cache_cpu *c, int cpu)
+{
+	if (c < per_cpu(kmem_cache_cpu, cpu) ||
+			c >= per_cpu(kmem_cache_cpu, cpu) + NR_KMEM_CACHE_CPU) {
+		kfree(c);
+		return;
+	}
+	c->freelist = (void *)per_cpu(kmem_cache_cpu_free, cpu);
+	per_cpu(kmem_cache_cpu_free, cpu) = c;
+}
+
+static void free_kmem_cache_cpus(kmem_cache_t *s)
+{
+	int cpu;
+
+	for_each_cpu(cpu) {
+		struct kmem_cache_cpu *c = get_cpu_slab(s, cpu);
+
+		if (c) {
+			s->cpu_slab[cpu] = NULL;
+			free_kmem_cache_cpu(c, cpu);
+		}
+	}
+}
+
+/*
+ * Per cpu structures are set up for all possible cpus, so nothing has
+ * to be done when a cpu comes up.
+ */
+static int alloc_kmem_cache_cpus(kmem_cache_t *s, gfp_t flags)
+{
+	int cpu;
+
+	for_each_cpu(cpu) {
+		struct kmem_cache_cpu *c = get_cpu_slab(s, cpu);
+
+		if (c)
+			continue;
+
+		c = alloc_kmem_cache_cpu(s, cpu, flags);
+		if (!c) {
+			free_kmem_cache_cpus(s);
+			return 0;
+		}
+		s->cpu_slab[cpu] = c;
+	}
+	return 1;
+}
+
+static void __init init_alloc_cpu(void)
+{
+	int cpu;
+	int i;
+
+	for_each_cpu(cpu)
+		for (i = NR_KMEM_CACHE_CPU - 1; i >= 0; i--)
+			free_kmem_cache_cpu(&per_cpu(kmem_cache_cpu, cpu)[i],
+					    cpu);
+}
+
+#ifdef CONFIG_NUMA
+/*
+ * The kmalloc cache the kmem_cache_node structures come from cannot
+ * allocate its own: it uses these instead.
+ */
+static struct kmem_cache_node boot_kmem_cache_node[MAX_NUMNODES];
+
+static void free_kmem_cache_nodes(kmem_cache_t *s)
+{
+	int node;
+
+	for_each_online_node(node) {
+		struct kmem_cache_node *n = s->node[node];
+
+		if (n && (n < boot_kmem_cache_node ||
+			  n >= boot_kmem_cache_node + MAX_NUMNODES))
+			kfree(n);
+		s->node[node] = NULL;
+	}
+}
+
+static int init_kmem_cache_nodes(kmem_cache_t *s, gfp_t gfpflags)
+{
+	int node;
+
+	for_each_online_node(node) {
+		struct kmem_cache_node *n;
+
+		if (slab_state == DOWN)
+			n = &boot_kmem_cache_node[node];
+		else {
+			n = kmalloc_node(sizeof(struct kmem_cache_node),
+					 gfpflags, node);
+			if (!n) {
+				free_kmem_cache_nodes(s);
+				return 0;
+			}
+		}
+		s->node[node] = n;
+		init_kmem_cache_node(n);
+	}
+	return 1;
+}
+#else
+static void free_kmem_cache_nodes(kmem_cache_t *s)
+{
+}
+
+static int init_kmem_cache_nodes(kmem_cache_t *s, gfp_t gfpflags)
+{
+	init_kmem_cache_node(&s->local_node);
+	return 1;
+}
+#endif
+
+static int kmem_cache_open(kmem_cache_t *s, gfp_t gfpflags,
+		const char *name, size_t size,
+		size_t align, unsigned long flags,
+		void (*ctor)(void *, kmem_cache_t *, unsigned long),
+		void (*dtor)(void *, kmem_cache_t *, unsigned long))
+{
+	memset(s, 0, sizeof(*s));
+	s->name = name;
+	s->ctor = ctor;
+	s->dtor = dtor;
+	s->objsize = size;
+	s->flags = flags;
+	s->align = align;
+
+	if (!calculate_sizes(s))
+		goto error;
+
+	s->refcount = 1;
+
+	if (!init_kmem_cache_nodes(s, gfpflags & ~GFP_DMA))
+		goto error;
+
+	if (alloc_kmem_cache_cpus(s, gfpflags & ~GFP_DMA))
+		return 1;
+	free_kmem_cache_nodes(s);
+error:
+	if (flags & SLAB_PANIC)
+		panic("Cannot create slab %s size=%lu realsize=%u "
+			"order=%u offset=%u flags=%lx\n",
+			s->name, (unsigned long)size, s->size, s->order,
+			s->offset, flags);
+	return 0;
+}
+
+/*
+ * Attempt to free all slabs on a node. Return the number of slabs we
+ * were unable to free.
+ */
+static int free_list(kmem_cache_t *s, struct kmem_cache_node *n,
+		     struct list_head *list)
+{
+	int slabs_inuse = 0;
+	unsigned long flags;
+	struct page *page, *h;
+
+	spin_lock_irqsave(&n->list_lock, flags);
+	list_for_each_entry_safe(page, h, list, lru)
+		if (!page->inuse) {
+			list_del(&page->lru);
+			discard_slab(s, page);
+		} else
+			slabs_inuse++;
+	spin_unlock_irqrestore(&n->list_lock, flags);
+	return slabs_inuse;
+}
+
+/*
+ * Release all resources used by a slab cache.
+ */
+static int kmem_cache_close(kmem_cache_t *s)
+{
+	int node;
+
+	flush_all(s);
+
+	/* Attempt to free all objects */
+	free_kmem_cache_cpus(s);
+	for_each_online_node(node) {
+		struct kmem_cache_node *n = get_node(s, node);
+
+		n->nr_partial -= free_list(s, n, &n->partial);
+		if (atomic_read(&n->nr_slabs))
+			return 1;
+	}
+	free_kmem_cache_nodes(s);
+	return 0;
+}
+
+/********************************************************************
+ *		Cache creation and destruction
+ *******************************************************************/
+
+static int slab_unmergeable(kmem_cache_t *s)
+{
+	if (slub_nomerge || (s->flags & SLUB_NEVER_MERGE))
+		return 1;
+
+	if (s->ctor || s->dtor)
+		return 1;
+
+	/*
+	 * We may have set a slab to be unmergeable during bootstrap.
+	 */
+	if (s->refcount < 0)
+		return 1;
+
+	return 0;
+}
+
+static kmem_cache_t *find_mergeable(size_t size,
+		size_t align, unsigned long flags,
+		void (*ctor)(void *, kmem_cache_t *, unsigned long),
+		void (*dtor)(void *, kmem_cache_t *, unsigned long))
+{
+	kmem_cache_t *s;
+
+	if (slub_nomerge || (flags & SLUB_NEVER_MERGE))
+		return NULL;
+
+	if (ctor || dtor)
+		return NULL;
+
+	size = ALIGN(size, sizeof(void *));
+	align = calculate_alignment(flags, align, size);
+	size = ALIGN(size, align);
+
+	list_for_each_entry(s, &slab_caches, list) {
+		if (slab_unmergeable(s))
+			continue;
+
+		if (size > s->size)
+			continue;
+
+		if ((flags & SLUB_MERGE_SAME) != (s->flags & SLUB_MERGE_SAME))
+			continue;
+		/*
+		 * Check if alignment is compatible.
+		 * Courtesy of Adrian Drzewiecki
+		 */
+		if ((s->size & ~(align - 1)) != s->size)
+			continue;
+
+		if (s->size - size >= sizeof(void *))
+			continue;
+
+		return s;
+	}
+	return NULL;
+}
+
+/**
+ * kmem_cache_create - Create a cache.
+ * @name: A string which is used in /proc/slabinfo to identify this cache.
+ * @size: The size of objects to be created in this cache.
+ * @align: The required alignment for the objects.
+ * @flags: SLAB flags
+ * @ctor: A constructor for the objects.
+ * @dtor: A destructor for the objects.
+ *
+ * Returns a ptr to the cache on success, NULL on failure.
+ * Cannot be called within a int, but can be interrupted.
+ * The @ctor is run when new pages are allocated by the cache
+ * and the @dtor is run before the pages are handed back.
+ *
+ * A cache without @ctor and @dtor may be merged with an existing cache
+ * of compatible size and flags, in which case that cache is returned.
+ *
+ * The flags are
+ *
+ * %SLAB_HWCACHE_ALIGN - Align the objects in this cache to a hardware
+ * cacheline.  This can be beneficial if you're counting cycles as closely
+ * as davem.
+ *
+ * %SLAB_CACHE_DMA - Use GFP_DMA memory
+ *
+ * %SLAB_DESTROY_BY_RCU - Free the pages of the cache only after a RCU
+ * grace period.
+ *
+ * %SLAB_POISON, %SLAB_RED_ZONE and %SLAB_STORE_USER are accepted but only
+ * keep the cache from being merged: this allocator has no debug support.
+ */
+kmem_cache_t *kmem_cache_create(const char *name, size_t size, size_t align,
+		unsigned long flags,
+		void (*ctor)(void *, kmem_cache_t *, unsigned long),
+		void (*dtor)(void *, kmem_cache_t *, unsigned long))
+{
+	kmem_cache_t *s;
+
+	if (!name || in_interrupt() || (size < sizeof(void *)) ||
+		(size > (1 << MAX_OBJ_ORDER) * PAGE_SIZE) || (dtor && !ctor)) {
+		printk(KERN_ERR "%s: Early error in slab %s\n",
+				__FUNCTION__, name);
+		BUG();
+	}
+
+	down_write(&slub_lock);
+	s = find_mergeable(size, align, flags, ctor, dtor);
+	if (s) {
+		s->refcount++;
+		/*
+		 * Adjust the object sizes so that we clear
+		 * the complete object on kzalloc.
+		 */
+		s->objsize = max(s->objsize, (int)size);
+		s->inuse = max_t(int, s->inuse, ALIGN(size, sizeof(void *)));
+		up_write(&slub_lock);
+		if (sysfs_slab_alias(s, name))
+			goto err;
+		return s;
+	}
+
+	s = kmalloc(sizeof(*s), GFP_KERNEL);
+	if (s) {
+		if (kmem_cache_open(s, GFP_KERNEL, name,
+				size, align, flags, ctor, dtor)) {
+			list_add(&s->list, &slab_caches);
+			up_write(&slub_lock);
+			if (sysfs_slab_add(s))
+				goto err;
+			return s;
+		}
+		kfree(s);
+	}
+	up_write(&slub_lock);
+
+err:
+	if (flags & SLAB_PANIC)
+		panic("Cannot create slabcache %s\n", name);
+	else
+		s = NULL;
+	return s;
+}
+EXPORT_SYMBOL(kmem_cache_create);
+
+/**
+ * kmem_cache_destroy - delete a cache
+ * @s: the cache to destroy
+ *
+ * Remove a kmem_cache_t object from the slab cache.
+ * Returns 0 on success.
+ *
+ * It is expected this function will be called by a module when it is
+ * unloaded.  This will remove the cache completely, and avoid a duplicate
+ * cache being allocated each time a module is loaded and unloaded, if the
+ * module doesn't have persistent in-kernel storage across loads and unloads.
+ *
+ * The cache must be empty before calling this function.
+ *
+ * The caller must guarantee that noone will allocate memory from the cache
+ * during the kmem_cache_destroy(). A merged cache goes away with its
+ * last user.
+ */
+int kmem_cache_destroy(kmem_cache_t *s)
+{
+	if (!s || in_interrupt())
+		BUG();
+
+	down_write(&slub_lock);
+	s->refcount--;
+	if (!s->refcount) {
+		list_del(&s->list);
+		if (kmem_cache_close(s)) {
+			printk(KERN_ERR "slab %s: Can't free all objects\n",
+			       s->name);
+			dump_stack();
+			alloc_kmem_cache_cpus(s, GFP_KERNEL);
+			s->refcount++;
+			list_add(&s->list, &slab_caches);
+			up_write(&slub_lock);
+			return 1;
+		}
+		up_write(&slub_lock);
+		if (unlikely(s->flags & SLAB_DESTROY_BY_RCU))
+			synchronize_rcu();
+		sysfs_slab_remove(s);
+	} else
+		up_write(&slub_lock);
+	return 0;
+}
+EXPORT_SYMBOL(kmem_cache_destroy);
+
+/**
+ * kmem_cache_shrink - Shrink a cache.
+ * @s: The cache to shrink.
+ *
+ * Releases as many slabs as possible for a cache. The cpu slabs are
+ * given back first, then the empty slabs on the partial lists are
+ * freed. Returns 0 if the cache has no slabs left.
+ */
+int kmem_cache_shrink(kmem_cache_t *s)
+{
+	int node;
+	int ret = 0;
+	struct kmem_cache_node *n;
+	struct page *page, *t;
+	unsigned long flags;
+
+	flush_all(s);
+	for_each_online_node(node) {
+		n = get_node(s, node);
+
+		if (!n)
+			continue;
+
+		spin_lock_irqsave(&n->list_lock, flags);
+		list_for_each_entry_safe(page, t, &n->partial, lru) {
+			if (page->inuse || !slab_trylock(page))
+				continue;
+			/*
+			 * Must hold slab lock here because slab_free
+			 * may have freed the last object and be
+			 * waiting to release the slab.
+			 */
+			list_del(&page->lru);
+			n->nr_partial--;
+			slab_unlock(page);
+			discard_slab(s, page);
+		}
+		spin_unlock_irqrestore(&n->list_lock, flags);
+
+		if (atomic_read(&n->nr_slabs))
+			ret = 1;
+	}
+	return ret;
+}
+EXPORT_SYMBOL(kmem_cache_shrink);
+
+/********************************************************************
+ *		Kmalloc subsystem
+ *******************************************************************/
+
+/* These are the default caches for kmalloc. Custom caches can have other sizes. */
+struct cache_sizes malloc_sizes[] = {
+#define CACHE(x) { .cs_size = (x) },
+#include <linux/kmalloc_sizes.h>
+	CACHE(ULONG_MAX)
+#undef CACHE
+};
+EXPORT_SYMBOL(malloc_sizes);
+
+/* Must match cache_sizes above. Out of line to keep cache footprint low. */
+struct cache_names {
+	char *name;
+	char *name_dma;
+};
+
+static struct cache_names __initdata cache_names[] = {
+#define CACHE(x) { .name = "size-" #x, .name_dma = "size-" #x "(DMA)" },
+#include <linux/kmalloc_sizes.h>
+	{ NULL, }
+#undef CACHE
+};
+
+enum {
+#define CACHE(x) + 1
+	NR_KMALLOC_CACHES = 0
+#include <linux/kmalloc_sizes.h>
+#undef CACHE
+};
+
+static kmem_cache_t kmalloc_caches[NR_KMALLOC_CACHES];
+static kmem_cache_t kmalloc_dma_caches[NR_KMALLOC_CACHES];
+
+static void __init create_kmalloc_cache(kmem_cache_t *s,
+		const char *name, int size, unsigned long flags)
+{
+	if (!kmem_cache_open(s, GFP_KERNEL, name, size, ARCH_KMALLOC_MINALIGN,
+			flags | SLAB_PANIC, NULL, NULL))
+		BUG();
+
+	list_add(&s->list, &slab_caches);
+}
+
+static inline kmem_cache_t *__find_general_cachep(size_t size, gfp_t gfpflags)
+{
+	struct cache_sizes *csizep = malloc_sizes;
+
+	while (size > csizep->cs_size)
+		csizep++;
+
+	/*
+	 * Really subtle: The last entry with cs->cs_size==ULONG_MAX
+	 * has cs_{dma,}cachep==NULL. Thus no special case
+	 * for large kmalloc calls required.
+	 */
+	if (unlikely(gfpflags & GFP_DMA))
+		return csizep->cs_dmacachep;
+	return csizep->cs_cachep;
+}
+
+kmem_cache_t *kmem_find_general_cachep(size_t size, gfp_t gfpflags)
+{
+	return __find_general_cachep(size, gfpflags);
+}
+EXPORT_SYMBOL(kmem_find_general_cachep);
+
+/**
+ * __kmalloc - allocate memory
+ * @size: how many bytes of memory are required.
+ * @flags: the type of memory to allocate.
+ *
+ * kmalloc is the normal method of allocating memory
+ * in the kernel.
+ */
+void *__kmalloc(size_t size, gfp_t flags)
+{
+	kmem_cache_t *s = __find_general_cachep(size, flags);
+
+	if (unlikely(!s))
+		return NULL;
+	return slab_alloc(s, flags, -1);
+}
+EXPORT_SYMBOL(__kmalloc);
+
+#ifdef CONFIG_NUMA
+void *kmalloc_node(size_t size, gfp_t flags, int node)
+{
+	kmem_cache_t *s = __find_general_cachep(size, flags);
+
+	if (unlikely(!s))
+		return NULL;
+	return slab_alloc(s, flags, node);
+}
+EXPORT_SYMBOL(kmalloc_node);
+#endif
+
+/**
+ * kfree - free previously allocated memory
+ * @objp: pointer returned by kmalloc.
+ *
+ * If @objp is NULL, no operation is performed.
+ *
+ * Don't free memory not originally allocated by kmalloc()
+ * or you will run into trouble.
+ */
+void kfree(const void *objp)
+{
+	struct page *page;
+
+	if (unlikely(!objp))
+		return;
+
+	page = virt_to_slab_page(objp);
+	slab_free(page->slab, page, (void *)objp);
+}
+EXPORT_SYMBOL(kfree);
+
+/**
+ * ksize - get the actual amount of memory allocated for a given object
+ * @objp: Pointer to the object
+ *
+ * kmalloc may internally round up allocations and return more memory
+ * than requested. ksize() can be used to determine the actual amount of
+ * memory allocated. The caller may use this additional memory, even though
+ * a smaller amount of memory was initially specified with the kmalloc call.
+ * The caller must guarantee that objp points to a valid object previously
+ * allocated with either kmalloc() or kmem_cache_alloc(). The object
+ * must not be freed during the duration of the call.
+ */
+unsigned int ksize(const void *objp)
+{
+	kmem_cache_t *s;
+
+	if (unlikely(objp == NULL))
+		return 0;
+
+	s = virt_to_slab_page(objp)->slab;
+
+	/*
+	 * The objects of caches without free pointer after them can be
+	 * used up to the start of the next object.
+	 */
+	if (!(s->flags & SLAB_DESTROY_BY_RCU) && !s->ctor && !s->dtor)
+		return s->size;
+	return s->objsize;
+}
+
+/**
+ * kmem_ptr_validate - check if an untrusted pointer might
+ *	be a slab entry.
+ * @cachep: the cache we're checking against
+ * @ptr: pointer to validate
+ *
+ * This verifies that the untrusted pointer looks sane:
+ * it is _not_ a guarantee that the pointer is actually
+ * part of the slab cache in question, but it at least
+ * validates that the pointer can be dereferenced and
+ * looks half-way sane.
+ *
+ * Currently only used for dentry validation.
+ */
+int fastcall kmem_ptr_validate(kmem_cache_t *cachep, void *ptr)
+{
+	unsigned long addr = (unsigned long) ptr;
+	unsigned long min_addr = PAGE_OFFSET;
+	unsigned long align_mask = sizeof(void *) - 1;
+	unsigned long size = cachep->size;
+	struct page *page;
+
+	if (unlikely(addr < min_addr))
+		goto out;
+	if (unlikely(addr > (unsigned long)high_memory - size))
+		goto out;
+	if (unlikely(addr & align_mask))
+		goto out;
+	if (unlikely(!kern_addr_valid(addr)))
+		goto out;
+	if (unlikely(!kern_addr_valid(addr + size - 1)))
+		goto out;
+	page = virt_to_page(ptr);
+	if (unlikely(!PageSlab(page)))
+		goto out;
+	page = (struct page *)page->private;
+	if (unlikely(page->slab != cachep))
+		goto out;
+	if (unlikely((addr - (unsigned long)page_address(page)) %
+		     cachep->size))
+		goto out;
+	return 1;
+out:
+	return 0;
+}
+
+unsigned int kmem_cache_size(kmem_cache_t *s)
+{
+	return s->objsize;
+}
+EXPORT_SYMBOL(kmem_cache_size);
+
+const char *kmem_cache_name(kmem_cache_t *s)
+{
+	return s->name;
+}
+EXPORT_SYMBOL_GPL(kmem_cache_name);
+
+/********************************************************************
+ *			Basic setup of slabs
+ *******************************************************************/
+
+#ifdef CONFIG_HOTPLUG_CPU
+/*
+ * Use the cpu notifier to give back the cpu slabs of a cpu going down.
+ * Its per cpu structures stay allocated for when it comes back.
+ */
+static int __devinit slab_cpuup_callback(struct notifier_block *nfb,
+		unsigned long action, void *hcpu)
+{
+	long cpu = (long)hcpu;
+	kmem_cache_t *s;
+	unsigned long flags;
+
+	switch (action) {
+	case CPU_UP_CANCELED:
+	case CPU_DEAD:
+		down_read(&slub_lock);
+		list_for_each_entry(s, &slab_caches, list) {
+			local_irq_save(flags);
+			__flush_cpu_slab(s, cpu);
+			local_irq_restore(flags);
+		}
+		up_read(&slub_lock);
+		break;
+	default:
+		break;
+	}
+	return NOTIFY_OK;
+}
+
+static struct notifier_block __devinitdata slab_notifier =
+	{ &slab_cpuup_callback, NULL, 0 };
+#endif
+
+void __init kmem_cache_init(void)
+{
+	struct cache_sizes *sizes = malloc_sizes;
+	struct cache_names *names = cache_names;
+	int i;
+
+	init_alloc_cpu();
+
+#ifdef CONFIG_NUMA
+	/*
+	 * Must first have the slab cache available for the allocations of
+	 * the struct kmem_cache_node's. There is special bootstrap code in
+	 * init_kmem_cache_nodes() for this one.
+	 */
+	while (sizes->cs_size < sizeof(struct kmem_cache_node)) {
+		sizes++;
+		names++;
+	}
+	i = sizes - malloc_sizes;
+	create_kmalloc_cache(&kmalloc_caches[i], names->name,
+			     sizes->cs_size, 0);
+	sizes->cs_cachep = &kmalloc_caches[i];
+	slab_state = PARTIAL;
+
+	sizes = malloc_sizes;
+	names = cache_names;
+#endif
+
+	for (i = 0; sizes->cs_size != ULONG_MAX; i++, sizes++, names++) {
+		if (!sizes->cs_cachep) {
+			create_kmalloc_cache(&kmalloc_caches[i], names->name,
+					     sizes->cs_size, 0);
+			sizes->cs_cachep = &kmalloc_caches[i];
+		}
+		create_kmalloc_cache(&kmalloc_dma_caches[i], names->name_dma,
+				     sizes->cs_size, SLAB_CACHE_DMA);
+		sizes->cs_dmacachep = &kmalloc_dma_caches[i];
+	}
+
+	slab_state = UP;
+
+#ifdef CONFIG_HOTPLUG_CPU
+	register_cpu_notifier(&slab_notifier);
+#endif
+
+	printk(KERN_INFO "SLUB: Genslabs=%d, HWalign=%d, Order=%d-%d, "
+		"MinObjects=%d, CPUs=%d, Nodes=%d\n",
+		2 * NR_KMALLOC_CACHES, cache_line_size(),
+		slub_min_order, slub_max_order, slub_min_objects,
+		num_online_cpus(), num_online_nodes());
+}
+
+/********************************************************************
+ *			/proc/slabinfo
+ *******************************************************************/
+
+#ifdef CONFIG_PROC_FS
+
+static unsigned long count_partial(struct kmem_cache_node *n,
+				   unsigned long *free)
+{
+	unsigned long flags;
+	unsigned long x = 0;
+	struct page *page;
+
+	*free = 0;
+	spin_lock_irqsave(&n->list_lock, flags);
+	list_for_each_entry(page, &n->partial, lru) {
+		x += page->inuse;
+		*free += page->slab->objects - page->inuse;
+	}
+	spin_unlock_irqrestore(&n->list_lock, flags);
+	return x;
+}
+
+static void print_slabinfo_header(struct seq_file *m)
+{
+	seq_puts(m, "slabinfo - version: 2.1\n");
+	seq_puts(m, "# name            <active_objs> <num_objs> <objsize> "
+		 "<objperslab> <pagesperslab>");
+	seq_puts(m, " : tunables <limit> <batchcount> <sharedfactor>");
+	seq_puts(m, " : slabdata <active_slabs> <num_slabs> <sharedavail>");
+	seq_putc(m, '\n');
+}
+
+static void *s_start(struct seq_file *m, loff_t *pos)
+{
+	loff_t n = *pos;
+	struct list_head *p;
+
+	down_read(&slub_lock);
+	if (!n)
+		print_slabinfo_header(m);
+
+	p = slab_caches.next;
+	while (n--) {
+		p = p->next;
+		if (p == &slab_caches)
+			return NULL;
+	}
+	return list_entry(p, kmem_cache_t, list);
+}
+
+static void *s_next(struct seq_file *m, void *p, loff_t *pos)
+{
+	kmem_cache_t *s = p;
+
+	++*pos;
+	return s->list.next == &slab_caches ?
+		NULL : list_entry(s->list.next, kmem_cache_t, list);
+}
+
+static void s_stop(struct seq_file *m, void *p)
+{
+	up_read(&slub_lock);
+}
+
+/*
+ * Objects in the cpu slabs are shown as active, all objects of a full
+ * slab are. There are no tunables, hence the zeroes.
+ */
+static int s_show(struct seq_file *m, void *p)
+{
+	unsigned long nr_partials = 0;
+	unsigned long nr_slabs = 0;
+	unsigned long nr_inuse = 0;
+	unsigned long nr_objs;
+	unsigned long nr_free = 0;
+	kmem_cache_t *s;
+	int node;
+
+	s = p;
+
+	for_each_online_node(node) {
+		struct kmem_cache_node *n = get_node(s, node);
+		unsigned long free;
+
+		if (!n)
+			continue;
+
+		nr_partials += n->nr_partial;
+		nr_slabs += atomic_read(&n->nr_slabs);
+		count_partial(n, &free);
+		nr_free += free;
+	}
+
+	nr_objs = nr_slabs * s->objects;
+	nr_inuse = nr_objs - nr_free;
+
+	seq_printf(m, "%-17s %6lu %6lu %6u %4u %4d", s->name, nr_inuse,
+		   nr_objs, s->size, s->objects, (1 << s->order));
+	seq_printf(m, " : tunables %4u %4u %4u", 0, 0, 0);
+	seq_printf(m, " : slabdata %6lu %6lu %6lu", nr_slabs, nr_slabs,
+		   0UL);
+	seq_putc(m, '\n');
+	return 0;
+}
+
+struct seq_operations slabinfo_op = {
+	.start = s_start,
+	.next = s_next,
+	.stop = s_stop,
+	.show = s_show,
+};
+
+/**
+ * slabinfo_write - Tuning for the slab allocator
+ *
+ * There is nothing to tune: the per cache settings are in /sys/slab.
+ */
+ssize_t slabinfo_write(struct file *file, const char __user *buffer,
+		       size_t count, loff_t *ppos)
+{
+	return -EIO;
+}
+#endif /* CONFIG_PROC_FS */
+
+#ifdef CONFIG_SYSFS
+/********************************************************************
+ *			/sys/slab
+ *******************************************************************/
+
+static unsigned long slab_objects(kmem_cache_t *s, unsigned long *slabs,
+				  unsigned long *partial)
+{
+	unsigned long nr_slabs = 0, nr_partial = 0, nr_free = 0;
+	int node;
+
+	for_each_online_node(node) {
+		struct kmem_cache_node *n = get_node(s, node);
+		unsigned long free;
+
+		if (!n)
+			continue;
+		nr_slabs += atomic_read(&n->nr_slabs);
+		nr_partial += n->nr_partial;
+		count_partial(n, &free);
+		nr_free += free;
+	}
+	if (slabs)
+		*slabs = nr_slabs;
+	if (partial)
+		*partial = nr_partial;
+	return nr_slabs * s->objects - nr_free;
+}
+
+#define to_slab_attr(n) container_of(n, struct slab_attribute, attr)
+#define to_slab(n) container_of(n, kmem_cache_t, kobj);
+
+struct slab_attribute {
+	struct attribute attr;
+	ssize_t (*show)(kmem_cache_t *s, char *buf);
+	ssize_t (*store)(kmem_cache_t *s, const char *x, size_t count);
+};
+
+#define SLAB_ATTR_RO(_name) \
+	static struct slab_attribute _name##_attr = __ATTR_RO(_name)
+
+#define SLAB_ATTR(_name) \
+	static struct slab_attribute _name##_attr =  \
+	__ATTR(_name, 0644, _name##_show, _name##_store)
+
+static ssize_t slab_size_show(kmem_cache_t *s, char *buf)
+{
+	return sprintf(buf, "%d\n", s->size);
+}
+SLAB_ATTR_RO(slab_size);
+
+static ssize_t align_show(kmem_cache_t *s, char *buf)
+{
+	return sprintf(buf, "%d\n", s->align);
+}
+SLAB_ATTR_RO(align);
+
+static ssize_t object_size_show(kmem_cache_t *s, char *buf)
+{
+	return sprintf(buf, "%d\n", s->objsize);
+}
+SLAB_ATTR_RO(object_size);
+
+static ssize_t objs_per_slab_show(kmem_cache_t *s, char *buf)
+{
+	return sprintf(buf, "%d\n", s->objects);
+}
+SLAB_ATTR_RO(objs_per_slab);
+
+static ssize_t order_show(kmem_cache_t *s, char *buf)
+{
+	return sprintf(buf, "%d\n", s->order);
+}
+SLAB_ATTR_RO(order);
+
+static ssize_t aliases_show(kmem_cache_t *s, char *buf)
+{
+	return sprintf(buf, "%d\n", s->refcount - 1);
+}
+SLAB_ATTR_RO(aliases);
+
+static ssize_t objects_show(kmem_cache_t *s, char *buf)
+{
+	return sprintf(buf, "%lu\n", slab_objects(s, NULL, NULL));
+}
+SLAB_ATTR_RO(objects);
+
+static ssize_t slabs_show(kmem_cache_t *s, char *buf)
+{
+	unsigned long slabs;
+
+	slab_objects(s, &slabs, NULL);
+	return sprintf(buf, "%lu\n", slabs);
+}
+SLAB_ATTR_RO(slabs);
+
+static ssize_t partial_show(kmem_cache_t *s, char *buf)
+{
+	unsigned long partial;
+
+	slab_objects(s, NULL, &partial);
+	return sprintf(buf, "%lu\n", partial);
+}
+SLAB_ATTR_RO(partial);
+
+static ssize_t cpu_slabs_show(kmem_cache_t *s, char *buf)
+{
+	int cpu, x = 0;
+
+	for_each_online_cpu(cpu)
+		if (get_cpu_slab(s, cpu)->page)
+			x++;
+	return sprintf(buf, "%d\n", x);
+}
+SLAB_ATTR_RO(cpu_slabs);
+
+static ssize_t hwcache_align_show(kmem_cache_t *s, char *buf)
+{
+	return sprintf(buf, "%d\n", !!(s->flags & SLAB_HWCACHE_ALIGN));
+}
+SLAB_ATTR_RO(hwcache_align);
+
+static ssize_t reclaim_account_show(kmem_cache_t *s, char *buf)
+{
+	return sprintf(buf, "%d\n", !!(s->flags & SLAB_RECLAIM_ACCOUNT));
+}
+SLAB_ATTR_RO(reclaim_account);
+
+static ssize_t cache_dma_show(kmem_cache_t *s, char *buf)
+{
+	return sprintf(buf, "%d\n", !!(s->flags & SLAB_CACHE_DMA));
+}
+SLAB_ATTR_RO(cache_dma);
+
+static ssize_t destroy_by_rcu_show(kmem_cache_t *s, char *buf)
+{
+	return sprintf(buf, "%d\n", !!(s->flags & SLAB_DESTROY_BY_RCU));
+}
+SLAB_ATTR_RO(destroy_by_rcu);
+
+static ssize_t shrink_show(kmem_cache_t *s, char *buf)
+{
+	return 0;
+}
+
+static ssize_t shrink_store(kmem_cache_t *s, const char *buf, size_t length)
+{
+	if (buf[0] == '1') {
+		int rc = kmem_cache_shrink(s);
+
+		if (rc)
+			return rc;
+	} else
+		return -EINVAL;
+	return length;
+}
+SLAB_ATTR(shrink);
+
+#ifdef CONFIG_SLUB_STATS
+static int show_stat(kmem_cache_t *s, char *buf, enum stat_item si)
+{
+	unsigned long sum  = 0;
+	int cpu;
+	int len;
+	int *data = kmalloc(NR_CPUS * sizeof(int), GFP_KERNEL);
+
+	if (!data)
+		return -ENOMEM;
+
+	for_each_online_cpu(cpu) {
+		unsigned x = get_cpu_slab(s, cpu)->stat[si];
+
+		data[cpu] = x;
+		sum += x;
+	}
+
+	len = sprintf(buf, "%lu", sum);
+
+	for_each_online_cpu(cpu) {
+		if (data[cpu] && len < PAGE_SIZE - 20)
+			len += sprintf(buf + len, " C%d=%u", cpu, data[cpu]);
+	}
+	kfree(data);
+	return len + sprintf(buf + len, "\n");
+}
+
+#define STAT_ATTR(si, text) 					\
+static ssize_t text##_show(kmem_cache_t *s, char *buf)		\
+{								\
+	return show_stat(s, buf, si);				\
+}								\
+SLAB_ATTR_RO(text);						\
+
+STAT_ATTR(ALLOC_FASTPATH, alloc_fastpath);
+STAT_ATTR(ALLOC_SLOWPATH, alloc_slowpath);
+STAT_ATTR(FREE_FASTPATH, free_fastpath);
+STAT_ATTR(FREE_SLOWPATH, free_slowpath);
+STAT_ATTR(FREE_FROZEN, free_frozen);
+STAT_ATTR(FREE_ADD_PARTIAL, free_add_partial);
+STAT_ATTR(FREE_REMOVE_PARTIAL, free_remove_partial);
+STAT_ATTR(ALLOC_FROM_PARTIAL, alloc_from_partial);
+STAT_ATTR(ALLOC_SLAB, alloc_slab);
+STAT_ATTR(ALLOC_REFILL, alloc_refill);
+STAT_ATTR(FREE_SLAB, free_slab);
+STAT_ATTR(CPUSLAB_FLUSH, cpuslab_flush);
+STAT_ATTR(DEACTIVATE_FULL, deactivate_full);
+STAT_ATTR(DEACTIVATE_EMPTY, deactivate_empty);
+STAT_ATTR(DEACTIVATE_TO_HEAD, deactivate_to_head);
+STAT_ATTR(DEACTIVATE_TO_TAIL, deactivate_to_tail);
+#endif
+
+static struct attribute *slab_attrs[] = {
+	&slab_size_attr.attr,
+	&object_size_attr.attr,
+	&objs_per_slab_attr.attr,
+	&order_attr.attr,
+	&objects_attr.attr,
+	&slabs_attr.attr,
+	&partial_attr.attr,
+	&cpu_slabs_attr.attr,
+	&aliases_attr.attr,
+	&align_attr.attr,
+	&hwcache_align_attr.attr,
+	&reclaim_account_attr.attr,
+	&cache_dma_attr.attr,
+	&destroy_by_rcu_attr.attr,
+	&shrink_attr.attr,
+#ifdef CONFIG_SLUB_STATS
+	&alloc_fastpath_attr.attr,
+	&alloc_slowpath_attr.attr,
+	&free_fastpath_attr.attr,
+	&free_slowpath_attr.attr,
+	&free_frozen_attr.attr,
+	&free_add_partial_attr.attr,
+	&free_remove_partial_attr.attr,
+	&alloc_from_partial_attr.attr,
+	&alloc_slab_attr.attr,
+	&alloc_refill_attr.attr,
+	&free_slab_attr.attr,
+	&cpuslab_flush_attr.attr,
+	&deactivate_full_attr.attr,
+	&deactivate_empty_attr.attr,
+	&deactivate_to_head_attr.attr,
+	&deactivate_to_tail_attr.attr,
+#endif
+	NULL
+};
+
+static ssize_t slab_attr_show(struct kobject *kobj,
+			      struct attribute *attr,
+			      char *buf)
+{
+	struct slab_attribute *attribute;
+	kmem_cache_t *s;
+
+	attribute = to_slab_attr(attr);
+	s = to_slab(kobj);
+
+	if (!attribute->show)
+		return -EIO;
+
+	return attribute->show(s, buf);
+}
+
+static ssize_t slab_attr_store(struct kobject *kobj,
+			       struct attribute *attr,
+			       const char *buf, size_t len)
+{
+	struct slab_attribute *attribute;
+	kmem_cache_t *s;
+
+	attribute = to_slab_attr(attr);
+	s = to_slab(kobj);
+
+	if (!attribute->store)
+		return -EIO;
+
+	return attribute->store(s, buf, len);
+}
+
+static void kmem_cache_release(struct kobject *kobj)
+{
+	kmem_cache_t *s = to_slab(kobj);
+
+	kfree(s);
+}
+
+static struct sysfs_ops slab_sysfs_ops = {
+	.show = slab_attr_show,
+	.store = slab_attr_store,
+};
+
+static struct kobj_type slab_ktype = {
+	.sysfs_ops = &slab_sysfs_ops,
+	.release = kmem_cache_release,
+	.default_attrs = slab_attrs,
+};
+
+static decl_subsys(slab, &slab_ktype, NULL);
+
+#define ID_STR_LENGTH 64
+
+/*
+ * Create a unique string id for a slab cache:
+ * format
+ * :[flags-]size
+ */
+static char *create_unique_id(kmem_cache_t *s)
+{
+	char *name = kmalloc(ID_STR_LENGTH, GFP_KERNEL);
+	char *p = name;
+
+	BUG_ON(!name);
+
+	*p++ = ':';
+	/*
+	 * First flags affecting slabcache operations. We will only
+	 * get here for aliasable slabs so we do not need to support
+	 * too many flags. The flags here must cover all flags that
+	 * are matched during merging to guarantee that the id is
+	 * unique.
+	 */
+	if (s->flags & SLAB_CACHE_DMA)
+		*p++ = 'd';
+	if (s->flags & SLAB_RECLAIM_ACCOUNT)
+		*p++ = 'a';
+	if (p != name + 1)
+		*p++ = '-';
+	p += sprintf(p, "%07d", s->size);
+	BUG_ON(p > name + ID_STR_LENGTH - 1);
+	return name;
+}
+
+static int sysfs_slab_add(kmem_cache_t *s)
+{
+	int err;
+	const char *name;
+	int unmergeable;
+
+	if (slab_state < SYSFS)
+		/* Defer until later */
+		return 0;
+
+	unmergeable = slab_unmergeable(s);
+	if (unmergeable) {
+		/*
+		 * Slabcache can never be merged so we can use the name proper.
+		 * This is typically the case for debug situations. In that
+		 * case we can catch duplicate names easily.
+		 */
+		sysfs_remove_link(&slab_subsys.kset.kobj, s->name);
+		name = s->name;
+	} else {
+		/*
+		 * Create a unique name for the slab as a target
+		 * for the symlinks.
+		 */
+		name = create_unique_id(s);
+	}
+
+	kobj_set_kset_s(s, slab_subsys);
+	kobject_set_name(&s->kobj, "%s", name);
+	err = kobject_register(&s->kobj);
+	if (!unmergeable) {
+		/* Setup first alias */
+		if (!err)
+			sysfs_slab_alias(s, s->name);
+		kfree(name);
+	}
+	return err;
+}
+
+static void sysfs_slab_remove(kmem_cache_t *s)
+{
+	if (slab_state < SYSFS) {
+		kfree(s);
+		return;
+	}
+	kobject_unregister(&s->kobj);
+}
+
+/*
+ * Need to buffer aliases during bootup until sysfs becomes
+ * available lest we loose that information.
+ */
+struct saved_alias {
+	kmem_cache_t *s;
+	const char *name;
+	struct saved_alias *next;
+};
+
+static struct saved_alias *alias_list;
+
+static int sysfs_slab_alias(kmem_cache_t *s, const char *name)
+{
+	struct saved_alias *al;
+
+	if (slab_state == SYSFS) {
+		/*
+		 * If we have a leftover link then remove it.
+		 */
+		sysfs_remove_link(&slab_subsys.kset.kobj, name);
+		return sysfs_create_link(&slab_subsys.kset.kobj,
+						&s->kobj, name);
+	}
+
+	al = kmalloc(sizeof(struct saved_alias), GFP_KERNEL);
+	if (!al)
+		return -ENOMEM;
+
+	al->s = s;
+	al->name = name;
+	al->next = alias_list;
+	alias_list = al;
+	return 0;
+}
+
+static int __init slab_sysfs_init(void)
+{
+	kmem_cache_t *s;
+	int err;
+
+	err = subsystem_register(&slab_subsys);
+	if (err) {
+		printk(KERN_ERR "Cannot register slab subsystem.\n");
+		return -ENOSYS;
+	}
+
+	slab_state = SYSFS;
+
+	list_for_each_entry(s, &slab_caches, list) {
+		err = sysfs_slab_add(s);
+		if (err)
+			printk(KERN_ERR "SLUB: Unable to add boot slab %s"
+						" to sysfs\n", s->name);
+	}
+
+	while (alias_list) {
+		struct saved_alias *al = alias_list;
+
+		alias_list = alias_list->next;
+		err = sysfs_slab_alias(al->s, al->name);
+		if (err)
+			printk(KERN_ERR "SLUB: Unable to add boot slab alias"
+					" %s to sysfs\n", s->name);
+		kfree(al);
+	}
+	return 0;
+}
+
+__initcall(slab_sysfs_init);
+#endif /* CONFIG_SYSFS */
@@ -14,6 +14,7 @@
 #include <linux/pagemap.h>
 #include <linux/buffer_head.h>
 #include <linux/backing-dev.h>
+#include <linux/swapops.h>
 
 #include <asm/pgtable.h>
 
@@ -35,7 +36,7 @@ static struct backing_dev_info swap_backing_dev_info = {
 
 struct address_space swapper_space = {
 	.page_tree	= RADIX_TREE_INIT(GFP_ATOMIC|__GFP_NOWARN),
-	.tree_lock	= RW_LOCK_UNLOCKED,
+	.tree_lock	= SPIN_LOCK_UNLOCKED,
 	.a_ops		= &swap_aops,
 	.i_mmap_nonlinear = LIST_HEAD_INIT(swapper_space.i_mmap_nonlinear),
 	.backing_dev_info = &swap_backing_dev_info,
@@ -70,25 +71,35 @@ void show_swap_cache_info(void)
 static int __add_to_swap_cache(struct page *page, swp_entry_t entry,
 			       gfp_t gfp_mask)
 {
-	int error;
+	int error, locked;
 
 	BUG_ON(PageSwapCache(page));
 	BUG_ON(PagePrivate(page));
 	error = radix_tree_preload(gfp_mask);
 	if (!error) {
-		write_lock_irq(&swapper_space.tree_lock);
+		/* Ready for lockless lookups before it is in the tree */
+		page_cache_get(page);
+		locked = TestSetPageLocked(page);
+		SetPageSwapCache(page);
+		page->private = entry.val;
+
+		spin_lock_irq(&swapper_space.tree_lock);
 		error = radix_tree_insert(&swapper_space.page_tree,
 						entry.val, page);
 		if (!error) {
-			page_cache_get(page);
-			SetPageLocked(page);
-			SetPageSwapCache(page);
-			page->private = entry.val;
 			total_swapcache_pages++;
 			pagecache_acct(1);
 		}
-		write_unlock_irq(&swapper_space.tree_lock);
+		spin_unlock_irq(&swapper_space.tree_lock);
 		radix_tree_preload_end();
+
+		if (unlikely(error)) {
+			page->private = 0UL;
+			ClearPageSwapCache(page);
+			if (!locked)
+				ClearPageLocked(page);
+			page_cache_release(page);
+		}
 	}
 	return error;
 }
@@ -132,6 +143,8 @@ void __delete_from_swap_cache(struct page *page)
 	total_swapcache_pages--;
 	pagecache_acct(-1);
 	INC_CACHE_INFO(del_total);
+	if (TestClearPageReadahead(page))
+		inc_page_state(swap_ra_miss);
 }
 
 /**
@@ -199,11 +212,11 @@ void delete_from_swap_cache(struct page *page)
 
 	entry.val = page->private;
 
-	write_lock_irq(&swapper_space.tree_lock);
+	spin_lock_irq(&swapper_space.tree_lock);
 	__delete_from_swap_cache(page);
-	write_unlock_irq(&swapper_space.tree_lock);
+	spin_unlock_irq(&swapper_space.tree_lock);
 
-	swap_free(entry);
+	swapcache_free(entry);
 	page_cache_release(page);
 }
 
@@ -335,7 +348,7 @@ struct page *read_swap_cache_async(swp_entry_t entry,
 		 * Get a new page to read into from swap.
 		 */
 		if (!new_page) {
-			new_page = alloc_page_vma(GFP_HIGHUSER, vma, addr);
+			new_page = alloc_page_vma(GFP_HIGHUSER_MOVABLE, vma, addr);
 			if (!new_page)
 				break;		/* Out of memory */
 		}
@@ -350,6 +363,7 @@ struct page *read_swap_cache_async(swp_entry_t entry,
 		 * the just freed swap entry for an existing page.
 		 * May fail (-ENOMEM) if radix-tree node allocation failed.
 		 */
+		SetPageSwapBacked(new_page);
 		err = add_to_swap_cache(new_page, entry);
 		if (!err) {
 			/*
@@ -365,3 +379,119 @@ struct page *read_swap_cache_async(swp_entry_t entry,
 		page_cache_release(new_page);
 	return found_page;
 }
+
+/*
+ * Swap readahead by virtual address.  Once a swap device is fragmented,
+ * the pages next to each other on it were seldom swapped out together,
+ * and reading ahead by swap offset mostly reads pages nobody waits for.
+ * Instead we read the pages which the ptes around the fault point to,
+ * wherever they are in swap.  The window follows the direction of the
+ * faults when they are sequential, and is centered on the fault when
+ * they are not.  Its size depends on how many of the pages last read
+ * ahead in the vma were faulted on since: it grows while they are used,
+ * and shrinks by half at most each time while they are not.
+ */
+#define SWAP_RA_MAX_PAGES	32
+
+static unsigned int swap_ra_window(struct vm_area_struct *vma,
+				   unsigned long addr)
+{
+	unsigned int hits = vma->swap_ra_hits;
+	unsigned int pages, roundup, max_pages;
+
+	max_pages = SWAP_RA_MAX_PAGES;
+	if (page_cluster < 5)
+		max_pages = 1 << page_cluster;
+
+	pages = hits + 2;
+	if (!hits) {
+		/* No hits to judge by: only read ahead of sequential faults */
+		if (addr != vma->swap_ra_addr + PAGE_SIZE &&
+		    addr != vma->swap_ra_addr - PAGE_SIZE)
+			pages = 1;
+	} else {
+		for (roundup = 4; roundup < pages; roundup <<= 1)
+			;
+		pages = roundup;
+	}
+	if (pages < vma->swap_ra_win / 2)
+		pages = vma->swap_ra_win / 2;
+	if (pages > max_pages)
+		pages = max_pages;
+	return pages;
+}
+
+/**
+ * swapin_readahead_vma - read ahead the swap pages around a fault
+ * @entry: the swap entry faulted on
+ * @addr: the faulting address
+ * @vma: the vma of @addr
+ * @pmd: the page table of @addr
+ *
+ * Caller must hold down_read on vma->vm_mm, but not its page_table_lock.
+ */
+void swapin_readahead_vma(swp_entry_t entry, unsigned long addr,
+			  struct vm_area_struct *vma, pmd_t *pmd)
+{
+	struct mm_struct *mm = vma->vm_mm;
+	pte_t ptes[SWAP_RA_MAX_PAGES], *pte;
+	unsigned long start, end, before;
+	unsigned int win, i, nr;
+
+	addr &= PAGE_MASK;
+	win = swap_ra_window(vma, addr);
+	if (addr == vma->swap_ra_addr + PAGE_SIZE)
+		before = 0;
+	else if (addr == vma->swap_ra_addr - PAGE_SIZE)
+		before = win - 1;
+	else
+		before = (win - 1) / 2;
+	vma->swap_ra_addr = addr;
+	vma->swap_ra_win = win;
+	vma->swap_ra_hits = 0;
+	if (win <= 1)
+		return;
+
+	/* Stay in the vma, and in the page table of the fault */
+	start = max(vma->vm_start, addr & PMD_MASK);
+	before = min(before, (addr - start) >> PAGE_SHIFT);
+	start = addr - (before << PAGE_SHIFT);
+	end = min(vma->vm_end, (addr & PMD_MASK) + PMD_SIZE);
+	end = min(end, start + ((unsigned long)win << PAGE_SHIFT));
+	nr = (end - start) >> PAGE_SHIFT;
+
+	spin_lock(&mm->page_table_lock);
+	pte = pte_offset_map(pmd, start);
+	for (i = 0; i < nr; i++)
+		ptes[i] = pte[i];
+	pte_unmap(pte);
+	spin_unlock(&mm->page_table_lock);
+
+	for (i = 0; i < nr; i++) {
+		unsigned long ra_addr = start + ((unsigned long)i << PAGE_SHIFT);
+		swp_entry_t ra_entry;
+		struct page *page;
+
+		if (ra_addr == addr)
+			continue;
+		if (pte_none(ptes[i]) || pte_present(ptes[i]) ||
+		    pte_file(ptes[i]))
+			continue;
+		ra_entry = pte_to_swp_entry(ptes[i]);
+		if (is_migration_entry(ra_entry))
+			continue;
+
+		page = find_get_page(&swapper_space, ra_entry.val);
+		if (page) {
+			page_cache_release(page);
+			continue;
+		}
+		page = read_swap_cache_async(ra_entry, vma, ra_addr);
+		if (!page)
+			break;
+		SetPageReadahead(page);
+		inc_page_state(swap_ra);
+		page_cache_release(page);
+	}
+	lru_add_drain();	/* Push any new pages onto the LRU now */
+}
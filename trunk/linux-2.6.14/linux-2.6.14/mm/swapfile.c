@@ -8,6 +8,7 @@
 #include <linux/config.h>
 #include <linux/mm.h>
 #include <linux/hugetlb.h>
+#include <linux/huge_mm.h>
 #include <linux/mman.h>
 #include <linux/slab.h>
 #include <linux/kernel_stat.h>
@@ -26,6 +27,8 @@
 #include <linux/security.h>
 #include <linux/backing-dev.h>
 #include <linux/syscalls.h>
+#include <linux/percpu.h>
+#include <linux/zswap.h>
 
 #include <asm/pgtable.h>
 #include <asm/tlbflush.h>
@@ -85,51 +88,135 @@ void swap_unplug_io_fn(struct backing_dev_info *unused_bdi, struct page *page)
 #define SWAPFILE_CLUSTER	256
 #define LATENCY_LIMIT		256
 
-static inline unsigned long scan_swap_map(struct swap_info_struct *si)
+/*
+ * Swap space is handed out in clusters of SWAPFILE_CLUSTER slots.  We
+ * count the slots in use in each cluster, and keep the clusters with
+ * none in use on a list, in the order they became free.  Each cpu takes
+ * a free cluster of its own and allocates from it sequentially: the
+ * pages a cpu swaps out are written together, cpus do not interleave
+ * their writes, and a cluster is only reused as a whole, which is what
+ * flash devices handle best.  All of this is under swap_lock.
+ */
+struct swap_cluster_info {
+	unsigned int count;		/* slots in use */
+	unsigned int next;		/* next on the free cluster list */
+	unsigned int flags;
+};
+
+#define CLUSTER_FLAG_FREE	1	/* on the free cluster list */
+#define CLUSTER_FLAG_CPU	2	/* a cpu allocates from it */
+
+/* Cluster 0 holds the swap header, so it is never free */
+#define CLUSTER_NULL		0
+
+struct percpu_cluster {
+	unsigned int cluster;		/* cluster allocated from */
+	unsigned int next;		/* next slot in it to try */
+};
+
+static void free_cluster_add(struct swap_info_struct *si, unsigned int idx)
 {
-	unsigned long offset, last_in_cluster;
-	int latency_ration = LATENCY_LIMIT;
+	struct swap_cluster_info *ci = &si->cluster_info[idx];
+
+	ci->flags |= CLUSTER_FLAG_FREE;
+	ci->next = CLUSTER_NULL;
+	if (si->free_cluster_head == CLUSTER_NULL)
+		si->free_cluster_head = idx;
+	else
+		si->cluster_info[si->free_cluster_tail].next = idx;
+	si->free_cluster_tail = idx;
+}
 
-	/* 
-	 * We try to cluster swap pages by allocating them sequentially
-	 * in swap.  Once we've allocated SWAPFILE_CLUSTER pages this
-	 * way, however, we resort to first-free allocation, starting
-	 * a new cluster.  This prevents us from scattering swap pages
-	 * all over the entire swap partition, so that we reduce
-	 * overall disk seek times between swap pages.  -- sct
-	 * But we do now try to find an empty cluster.  -Andrea
-	 */
+/*
+ * Take the oldest free cluster off the list.  Clusters which first-free
+ * allocation put pages in meanwhile are dropped on the way: they go
+ * back on the list when they are empty again.
+ */
+static unsigned int free_cluster_take(struct swap_info_struct *si)
+{
+	unsigned int idx;
 
-	si->flags += SWP_SCANNING;
-	if (unlikely(!si->cluster_nr)) {
-		si->cluster_nr = SWAPFILE_CLUSTER - 1;
-		if (si->pages - si->inuse_pages < SWAPFILE_CLUSTER)
-			goto lowest;
-		spin_unlock(&swap_lock);
+	while ((idx = si->free_cluster_head) != CLUSTER_NULL) {
+		struct swap_cluster_info *ci = &si->cluster_info[idx];
 
-		offset = si->lowest_bit;
-		last_in_cluster = offset + SWAPFILE_CLUSTER - 1;
-
-		/* Locate the first empty (unaligned) cluster */
-		for (; last_in_cluster <= si->highest_bit; offset++) {
-			if (si->swap_map[offset])
-				last_in_cluster = offset + SWAPFILE_CLUSTER;
-			else if (offset == last_in_cluster) {
-				spin_lock(&swap_lock);
-				si->cluster_next = offset-SWAPFILE_CLUSTER-1;
-				goto cluster;
-			}
-			if (unlikely(--latency_ration < 0)) {
-				cond_resched();
-				latency_ration = LATENCY_LIMIT;
+		si->free_cluster_head = ci->next;
+		ci->flags &= ~CLUSTER_FLAG_FREE;
+		if (!ci->count)
+			return idx;
+	}
+	return CLUSTER_NULL;
+}
+
+static inline void inc_cluster_count(struct swap_info_struct *si,
+				     unsigned long offset)
+{
+	si->cluster_info[offset / SWAPFILE_CLUSTER].count++;
+}
+
+static void dec_cluster_count(struct swap_info_struct *si,
+			      unsigned long offset)
+{
+	unsigned int idx = offset / SWAPFILE_CLUSTER;
+	struct swap_cluster_info *ci = &si->cluster_info[idx];
+
+	if (!--ci->count &&
+	    !(ci->flags & (CLUSTER_FLAG_FREE | CLUSTER_FLAG_CPU)))
+		free_cluster_add(si, idx);
+}
+
+/*
+ * Find a free slot in the cluster of this cpu, moving on to the oldest
+ * free cluster when it is used up.  Returns 0 if no cluster is free.
+ */
+static unsigned long scan_swap_map_cluster(struct swap_info_struct *si)
+{
+	struct percpu_cluster *pc;
+	struct swap_cluster_info *ci;
+	unsigned long offset, end;
+
+	pc = per_cpu_ptr(si->percpu_cluster, smp_processor_id());
+	for (;;) {
+		if (pc->cluster == CLUSTER_NULL) {
+			pc->cluster = free_cluster_take(si);
+			if (pc->cluster == CLUSTER_NULL)
+				return 0;
+			si->cluster_info[pc->cluster].flags |= CLUSTER_FLAG_CPU;
+			pc->next = pc->cluster * SWAPFILE_CLUSTER;
+		}
+
+		end = min_t(unsigned long, si->max,
+			    (pc->cluster + 1) * SWAPFILE_CLUSTER);
+		for (offset = pc->next; offset < end; offset++) {
+			if (!si->swap_map[offset]) {
+				pc->next = offset + 1;
+				return offset;
 			}
 		}
-		spin_lock(&swap_lock);
-		goto lowest;
+
+		ci = &si->cluster_info[pc->cluster];
+		ci->flags &= ~CLUSTER_FLAG_CPU;
+		if (!ci->count)
+			free_cluster_add(si, pc->cluster);
+		pc->cluster = CLUSTER_NULL;
 	}
+}
+
+static inline unsigned long scan_swap_map(struct swap_info_struct *si)
+{
+	unsigned long offset;
+	int latency_ration = LATENCY_LIMIT;
 
-	si->cluster_nr--;
-cluster:
+	/*
+	 * We try to cluster swap pages by allocating them sequentially
+	 * in swap, each cpu in a free cluster of its own.  Once no free
+	 * cluster is left, however, we resort to first-free allocation,
+	 * from where it left off last time.
+	 */
+
+	si->flags += SWP_SCANNING;
+	offset = scan_swap_map_cluster(si);
+	if (offset)
+		goto checks;
 	offset = si->cluster_next;
 	if (offset > si->highest_bit)
 lowest:		offset = si->lowest_bit;
@@ -148,6 +235,7 @@ checks:	if (!(si->flags & SWP_WRITEOK))
 			si->highest_bit = 0;
 		}
 		si->swap_map[offset] = 1;
+		inc_cluster_count(si, offset);
 		si->cluster_next = offset + 1;
 		si->flags -= SWP_SCANNING;
 		return offset;
@@ -172,17 +260,23 @@ no_page:
 	return 0;
 }
 
-swp_entry_t get_swap_page(void)
+/*
+ * Allocate up to @n swap slots into @slots, all from the same swap
+ * device, taking swap_lock only once.  Returns how many were allocated.
+ */
+static int get_swap_pages(int n, swp_entry_t *slots)
 {
 	struct swap_info_struct *si;
 	pgoff_t offset;
 	int type, next;
 	int wrapped = 0;
+	int nr = 0;
 
 	spin_lock(&swap_lock);
 	if (nr_swap_pages <= 0)
 		goto noswap;
-	nr_swap_pages--;
+	if (n > nr_swap_pages)
+		n = nr_swap_pages;
 
 	for (type = swap_list.next; type >= 0 && wrapped < 2; type = next) {
 		si = swap_info + type;
@@ -199,18 +293,67 @@ swp_entry_t get_swap_page(void)
 			continue;
 
 		swap_list.next = next;
-		offset = scan_swap_map(si);
-		if (offset) {
-			spin_unlock(&swap_lock);
-			return swp_entry(type, offset);
-		}
+		while (nr < n && (offset = scan_swap_map(si)))
+			slots[nr++] = swp_entry(type, offset);
+		if (nr)
+			break;
 		next = swap_list.next;
 	}
-
-	nr_swap_pages++;
+	nr_swap_pages -= nr;
 noswap:
 	spin_unlock(&swap_lock);
-	return (swp_entry_t) {0};
+	return nr;
+}
+
+/*
+ * Each cpu keeps a few swap slots allocated ahead, and the slots freed
+ * from the swap cache are collected before they are given back, so that
+ * swapping cpus do not take swap_lock for every page.  The slots held
+ * here count as used.  swapoff drains the caches after it stopped
+ * allocations from the device, and from then on its slots are freed
+ * straight away.
+ */
+#define SWAP_SLOTS_CACHE_SIZE	64
+
+struct swap_slots_cache {
+	spinlock_t lock;
+	int nr;				/* slots left to hand out, */
+	int cur;			/* from slots[cur] on */
+	swp_entry_t slots[SWAP_SLOTS_CACHE_SIZE];
+	int nr_free;			/* freed slots in free[] */
+	swp_entry_t free[SWAP_SLOTS_CACHE_SIZE];
+};
+
+static DEFINE_PER_CPU(struct swap_slots_cache, swap_slots_cache);
+
+/* Keep no slots on the side once swap is almost full */
+static inline int swap_slots_cache_active(void)
+{
+	return nr_swap_pages >
+		2 * SWAP_SLOTS_CACHE_SIZE * (long)num_online_cpus();
+}
+
+swp_entry_t get_swap_page(void)
+{
+	struct swap_slots_cache *cache;
+	swp_entry_t entry = { 0 };
+
+	cache = &get_cpu_var(swap_slots_cache);
+	spin_lock(&cache->lock);
+	if (!cache->nr && swap_slots_cache_active()) {
+		cache->nr = get_swap_pages(SWAP_SLOTS_CACHE_SIZE, cache->slots);
+		cache->cur = 0;
+	}
+	if (cache->nr) {
+		entry = cache->slots[cache->cur++];
+		cache->nr--;
+	}
+	spin_unlock(&cache->lock);
+	put_cpu_var(swap_slots_cache);
+
+	if (!entry.val)
+		get_swap_pages(1, &entry);
+	return entry;
 }
 
 static struct swap_info_struct * swap_info_get(swp_entry_t entry)
@@ -265,11 +408,41 @@ static int swap_entry_free(struct swap_info_struct *p, unsigned long offset)
 				swap_list.next = p - swap_info;
 			nr_swap_pages++;
 			p->inuse_pages--;
+			dec_cluster_count(p, offset);
+			zswap_invalidate(p - swap_info, offset);
 		}
 	}
 	return count;
 }
 
+static void swap_free_entries(swp_entry_t *entries, int nr)
+{
+	int i;
+
+	spin_lock(&swap_lock);
+	for (i = 0; i < nr; i++)
+		swap_entry_free(swap_info + swp_type(entries[i]),
+				swp_offset(entries[i]));
+	spin_unlock(&swap_lock);
+}
+
+/* Give back the slots held in the caches of all cpus, for swapoff */
+static void drain_swap_slots_caches(void)
+{
+	int cpu;
+
+	for_each_cpu(cpu) {
+		struct swap_slots_cache *cache = &per_cpu(swap_slots_cache, cpu);
+
+		spin_lock(&cache->lock);
+		swap_free_entries(cache->slots + cache->cur, cache->nr);
+		cache->nr = 0;
+		swap_free_entries(cache->free, cache->nr_free);
+		cache->nr_free = 0;
+		spin_unlock(&cache->lock);
+	}
+}
+
 /*
  * Caller has made sure that the swapdevice corresponding to entry
  * is still around or has not been recycled.
@@ -285,6 +458,40 @@ void swap_free(swp_entry_t entry)
 	}
 }
 
+/*
+ * Free the swap slot of a page just deleted from the swap cache.  If
+ * the swap cache held the last reference, the slot is collected on
+ * this cpu and freed later in a batch.
+ */
+void swapcache_free(swp_entry_t entry)
+{
+	struct swap_info_struct *p = swap_info + swp_type(entry);
+	unsigned long offset = swp_offset(entry);
+	struct swap_slots_cache *cache;
+	int collected = 0;
+
+	cache = &get_cpu_var(swap_slots_cache);
+	spin_lock(&cache->lock);
+	/*
+	 * The count is read without swap_lock: at worst a slot which is
+	 * still in use stays counted until the batch is freed.
+	 */
+	if (swp_type(entry) < nr_swapfiles && (p->flags & SWP_WRITEOK) &&
+	    offset < p->max && p->swap_map[offset] == 1) {
+		if (cache->nr_free == SWAP_SLOTS_CACHE_SIZE) {
+			swap_free_entries(cache->free, cache->nr_free);
+			cache->nr_free = 0;
+		}
+		cache->free[cache->nr_free++] = entry;
+		collected = 1;
+	}
+	spin_unlock(&cache->lock);
+	put_cpu_var(swap_slots_cache);
+
+	if (!collected)
+		swap_free(entry);
+}
+
 /*
  * How many references to page are currently swapped out?
  */
@@ -347,14 +554,20 @@ int remove_exclusive_swap_page(struct page *page)
 	/* Is the only swap cache user the cache itself? */
 	retval = 0;
 	if (p->swap_map[swp_offset(entry)] == 1) {
-		/* Recheck the page count with the swapcache lock held.. */
-		write_lock_irq(&swapper_space.tree_lock);
-		if ((page_count(page) == 2) && !PageWriteback(page)) {
-			__delete_from_swap_cache(page);
-			SetPageDirty(page);
-			retval = 1;
+		/*
+		 * Recheck the page count with the swapcache lock held,
+		 * freezing it against lockless lookups meanwhile..
+		 */
+		spin_lock_irq(&swapper_space.tree_lock);
+		if (page_freeze_refs(page, 2)) {
+			if (!PageWriteback(page)) {
+				__delete_from_swap_cache(page);
+				SetPageDirty(page);
+				retval = 1;
+			}
+			page_unfreeze_refs(page, 2);
 		}
-		write_unlock_irq(&swapper_space.tree_lock);
+		spin_unlock_irq(&swapper_space.tree_lock);
 	}
 	spin_unlock(&swap_lock);
 
@@ -375,6 +588,9 @@ void free_swap_and_cache(swp_entry_t entry)
 	struct swap_info_struct * p;
 	struct page *page = NULL;
 
+	if (is_migration_entry(entry))
+		return;
+
 	p = swap_info_get(entry);
 	if (p) {
 		if (swap_entry_free(p, swp_offset(entry)) == 1)
@@ -454,7 +670,8 @@ static inline int unuse_pmd_range(struct vm_area_struct *vma, pud_t *pud,
 	pmd = pmd_offset(pud, addr);
 	do {
 		next = pmd_addr_end(addr, end);
-		if (pmd_none_or_clear_bad(pmd))
+		/* Huge pmds never map swapped out pages */
+		if (pmd_none_or_trans_huge_or_clear_bad(pmd))
 			continue;
 		if (unuse_pte_range(vma, pmd, addr, next, entry, page))
 			return 1;
@@ -1056,6 +1273,44 @@ int page_queue_congested(struct page *page)
 }
 #endif
 
+/*
+ * The header, the bad pages and the slots past the end of the device
+ * count as used, so the clusters holding them are never free.  The
+ * other clusters go on the free list in disk order.
+ */
+static int setup_swap_clusters(struct swap_info_struct *p)
+{
+	unsigned long nr_clusters, offset, idx;
+
+	nr_clusters = (p->max + SWAPFILE_CLUSTER - 1) / SWAPFILE_CLUSTER;
+	p->cluster_info = vmalloc(nr_clusters *
+				  sizeof(struct swap_cluster_info));
+	p->percpu_cluster = alloc_percpu(struct percpu_cluster);
+	if (!p->cluster_info || !p->percpu_cluster)
+		return -ENOMEM;
+
+	memset(p->cluster_info, 0,
+	       nr_clusters * sizeof(struct swap_cluster_info));
+	for (offset = 0; offset < nr_clusters * SWAPFILE_CLUSTER; offset++)
+		if (offset >= p->max || p->swap_map[offset])
+			inc_cluster_count(p, offset);
+	p->free_cluster_head = p->free_cluster_tail = CLUSTER_NULL;
+	for (idx = 0; idx < nr_clusters; idx++)
+		if (!p->cluster_info[idx].count)
+			free_cluster_add(p, idx);
+	return 0;
+}
+
+static void free_swap_clusters(struct swap_info_struct *p)
+{
+	vfree(p->cluster_info);
+	p->cluster_info = NULL;
+	if (p->percpu_cluster) {
+		free_percpu(p->percpu_cluster);
+		p->percpu_cluster = NULL;
+	}
+}
+
 asmlinkage long sys_swapoff(const char __user * specialfile)
 {
 	struct swap_info_struct * p = NULL;
@@ -1118,6 +1373,9 @@ asmlinkage long sys_swapoff(const char __user * specialfile)
 	p->flags &= ~SWP_WRITEOK;
 	spin_unlock(&swap_lock);
 
+	/* No slot of the device gets into the caches from now on */
+	drain_swap_slots_caches();
+
 	current->flags |= PF_SWAPOFF;
 	err = try_to_unuse(type);
 	current->flags &= ~PF_SWAPOFF;
@@ -1166,6 +1424,8 @@ asmlinkage long sys_swapoff(const char __user * specialfile)
 	spin_unlock(&swap_lock);
 	up(&swapon_sem);
 	vfree(swap_map);
+	free_swap_clusters(p);
+	zswap_invalidate_area(p - swap_info);
 	inode = mapping->host;
 	if (S_ISBLK(inode->i_mode)) {
 		struct block_device *bdev = I_BDEV(inode);
@@ -1277,6 +1537,16 @@ static int __init procswaps_init(void)
 __initcall(procswaps_init);
 #endif /* CONFIG_PROC_FS */
 
+static int __init swap_slots_cache_init(void)
+{
+	int cpu;
+
+	for_each_cpu(cpu)
+		spin_lock_init(&per_cpu(swap_slots_cache, cpu).lock);
+	return 0;
+}
+__initcall(swap_slots_cache_init);
+
 /*
  * Written 01/25/92 by Simmule Turner, heavily changed by Linus.
  *
@@ -1338,7 +1608,6 @@ asmlinkage long sys_swapon(const char __user * specialfile, int swap_flags)
 	p->swap_map = NULL;
 	p->lowest_bit = 0;
 	p->highest_bit = 0;
-	p->cluster_nr = 0;
 	p->inuse_pages = 0;
 	p->next = -1;
 	if (swap_flags & SWAP_FLAG_PREFER) {
@@ -1517,6 +1786,9 @@ asmlinkage long sys_swapon(const char __user * specialfile, int swap_flags)
 			goto bad_swap;
 		}
 		nr_good_pages = p->pages;
+		error = setup_swap_clusters(p);
+		if (error)
+			goto bad_swap;
 	}
 	if (!nr_good_pages) {
 		printk(KERN_WARNING "Empty swap-file\n");
@@ -1569,6 +1841,7 @@ bad_swap_2:
 		++least_priority;
 	spin_unlock(&swap_lock);
 	vfree(swap_map);
+	free_swap_clusters(p);
 	if (swap_file)
 		filp_close(swap_file, NULL);
 out:
@@ -1615,6 +1888,9 @@ int swap_duplicate(swp_entry_t entry)
 	unsigned long offset, type;
 	int result = 0;
 
+	if (is_migration_entry(entry))
+		return 1;
+
 	type = swp_type(entry);
 	if (type >= nr_swapfiles)
 		goto bad_file;
@@ -76,20 +76,51 @@ invalidate_complete_page(struct address_space *mapping, struct page *page)
 	if (PagePrivate(page) && !try_to_release_page(page, 0))
 		return 0;
 
-	write_lock_irq(&mapping->tree_lock);
+	spin_lock_irq(&mapping->tree_lock);
 	if (PageDirty(page)) {
-		write_unlock_irq(&mapping->tree_lock);
+		spin_unlock_irq(&mapping->tree_lock);
 		return 0;
 	}
 
 	BUG_ON(PagePrivate(page));
-	__remove_from_page_cache(page);
-	write_unlock_irq(&mapping->tree_lock);
+	__remove_from_page_cache(page, NULL);
+	spin_unlock_irq(&mapping->tree_lock);
 	ClearPageUptodate(page);
 	page_cache_release(page);	/* pagecache ref */
 	return 1;
 }
 
+/*
+ * Drop the shadow entries of evicted pages from @start on, see
+ * mm/workingset.c.
+ */
+static void clear_shadow_entries(struct address_space *mapping, pgoff_t start)
+{
+	void *shadows[PAGEVEC_SIZE];
+	unsigned long indices[PAGEVEC_SIZE];
+	unsigned int i, nr;
+	pgoff_t next = start;
+
+	spin_lock_irq(&mapping->tree_lock);
+	while (mapping->nrshadows) {
+		nr = radix_tree_gang_lookup_exceptional(&mapping->page_tree,
+				shadows, indices, next, PAGEVEC_SIZE);
+		if (!nr)
+			break;
+		for (i = 0; i < nr; i++)
+			radix_tree_delete(&mapping->page_tree, indices[i]);
+		mapping->nrshadows -= nr;
+		next = indices[nr - 1] + 1;
+		if (!next)
+			break;
+
+		spin_unlock_irq(&mapping->tree_lock);
+		cond_resched();
+		spin_lock_irq(&mapping->tree_lock);
+	}
+	spin_unlock_irq(&mapping->tree_lock);
+}
+
 /**
  * truncate_inode_pages - truncate *all* the pages from an offset
  * @mapping: mapping to truncate
@@ -121,7 +152,7 @@ void truncate_inode_pages(struct address_space *mapping, loff_t lstart)
 	pgoff_t next;
 	int i;
 
-	if (mapping->nrpages == 0)
+	if (mapping->nrpages == 0 && mapping->nrshadows == 0)
 		return;
 
 	pagevec_init(&pvec, 0);
@@ -179,6 +210,9 @@ void truncate_inode_pages(struct address_space *mapping, loff_t lstart)
 		}
 		pagevec_release(&pvec);
 	}
+
+	if (mapping->nrshadows)
+		clear_shadow_entries(mapping, start);
 }
 
 EXPORT_SYMBOL(truncate_inode_pages);
@@ -9,10 +9,14 @@
 
 #include <linux/mm.h>
 #include <linux/module.h>
+#include <linux/init.h>
 #include <linux/highmem.h>
 #include <linux/slab.h>
 #include <linux/spinlock.h>
 #include <linux/interrupt.h>
+#include <linux/rbtree.h>
+#include <linux/radix-tree.h>
+#include <linux/percpu.h>
 
 #include <linux/vmalloc.h>
 
@@ -64,12 +68,14 @@ static inline void vunmap_pud_range(pgd_t *pgd, unsigned long addr,
 	} while (pud++, addr = next, addr != end);
 }
 
-void unmap_vm_area(struct vm_struct *area)
+/*
+ * Clear the kernel page tables over [addr, end).  The TLBs are left to the
+ * caller.
+ */
+static void vunmap_page_range(unsigned long addr, unsigned long end)
 {
 	pgd_t *pgd;
 	unsigned long next;
-	unsigned long addr = (unsigned long) area->addr;
-	unsigned long end = addr + area->size;
 
 	BUG_ON(addr >= end);
 	pgd = pgd_offset_k(addr);
@@ -80,7 +86,15 @@ void unmap_vm_area(struct vm_struct *area)
 			continue;
 		vunmap_pud_range(pgd, addr, next);
 	} while (pgd++, addr = next, addr != end);
-	flush_tlb_kernel_range((unsigned long) area->addr, end);
+}
+
+void unmap_vm_area(struct vm_struct *area)
+{
+	unsigned long addr = (unsigned long) area->addr;
+	unsigned long end = addr + area->size;
+
+	vunmap_page_range(addr, end);
+	flush_tlb_kernel_range(addr, end);
 }
 
 static int vmap_pte_range(pmd_t *pmd, unsigned long addr,
@@ -136,12 +150,11 @@ static inline int vmap_pud_range(pgd_t *pgd, unsigned long addr,
 	return 0;
 }
 
-int map_vm_area(struct vm_struct *area, pgprot_t prot, struct page ***pages)
+static int vmap_page_range_noflush(unsigned long addr, unsigned long end,
+			pgprot_t prot, struct page ***pages)
 {
 	pgd_t *pgd;
 	unsigned long next;
-	unsigned long addr = (unsigned long) area->addr;
-	unsigned long end = addr + area->size - PAGE_SIZE;
 	int err;
 
 	BUG_ON(addr >= end);
@@ -154,16 +167,417 @@ int map_vm_area(struct vm_struct *area, pgprot_t prot, struct page ***pages)
 			break;
 	} while (pgd++, addr = next, addr != end);
 	spin_unlock(&init_mm.page_table_lock);
-	flush_cache_vmap((unsigned long) area->addr, end);
 	return err;
 }
 
+static int vmap_page_range(unsigned long start, unsigned long end,
+			pgprot_t prot, struct page ***pages)
+{
+	int err;
+
+	err = vmap_page_range_noflush(start, end, prot, pages);
+	flush_cache_vmap(start, end);
+	return err;
+}
+
+int map_vm_area(struct vm_struct *area, pgprot_t prot, struct page ***pages)
+{
+	unsigned long addr = (unsigned long) area->addr;
+	unsigned long end = addr + area->size - PAGE_SIZE;
+
+	return vmap_page_range(addr, end, prot, pages);
+}
+
+/*
+ * Kernel virtual address space is handed out in vmap areas.  They are kept
+ * in an rbtree by address, for lookup, and on a list in address order, for
+ * the search of a free range.  Every vm_struct (vmalloc, vmap, ioremap) has
+ * one, and so has every vmap block of vm_map_ram below.
+ *
+ * Freeing an area clears its page tables but leaves the TLBs alone.  The
+ * area stays reserved, on vmap_purge_list, until enough of them have piled
+ * up to make one global TLB flush worth it: then they are all flushed at
+ * once and their address space can be reused.  Until then, stale TLB
+ * entries may point at the old pages, but nothing can get mapped there.
+ */
+#define VM_LAZY_FREE	0x01	/* Unmapped, waiting for the TLB flush */
+#define VM_VM_AREA	0x02	/* ->private is a vm_struct on vmlist */
+
+struct vmap_area {
+	unsigned long va_start;
+	unsigned long va_end;		/* exclusive */
+	unsigned long flags;
+	struct rb_node rb_node;		/* address sorted rbtree */
+	struct list_head list;		/* address sorted list */
+	struct list_head purge_list;	/* on vmap_purge_list, once lazy */
+	void *private;
+};
+
+static DEFINE_SPINLOCK(vmap_area_lock);
+static struct rb_root vmap_area_root = RB_ROOT;
+static LIST_HEAD(vmap_area_list);
+static LIST_HEAD(vmap_purge_list);
+
+/*
+ * The free area cache: the area the last search ended at, and the largest
+ * hole it skipped on the way.  A search with the same or stricter bounds
+ * for something which would not fit in that hole can start from there.
+ */
+static struct rb_node *free_vmap_cache;
+static unsigned long cached_hole_size;
+static unsigned long cached_vstart;
+static unsigned long cached_align;
+
+/* Pages in lazily freed areas and dirty pages of vmap blocks */
+static atomic_t vmap_lazy_nr = ATOMIC_INIT(0);
+
+static struct vmap_area *__find_vmap_area(unsigned long addr)
+{
+	struct rb_node *n = vmap_area_root.rb_node;
+
+	while (n) {
+		struct vmap_area *va;
+
+		va = rb_entry(n, struct vmap_area, rb_node);
+		if (addr < va->va_start)
+			n = n->rb_left;
+		else if (addr >= va->va_end)
+			n = n->rb_right;
+		else
+			return va;
+	}
+	return NULL;
+}
+
+static void __insert_vmap_area(struct vmap_area *va)
+{
+	struct rb_node **p = &vmap_area_root.rb_node;
+	struct rb_node *parent = NULL;
+	struct rb_node *prev;
+
+	while (*p) {
+		struct vmap_area *tmp;
+
+		parent = *p;
+		tmp = rb_entry(parent, struct vmap_area, rb_node);
+		if (va->va_end <= tmp->va_start)
+			p = &(*p)->rb_left;
+		else if (va->va_start >= tmp->va_end)
+			p = &(*p)->rb_right;
+		else
+			BUG();
+	}
+	rb_link_node(&va->rb_node, parent, p);
+	rb_insert_color(&va->rb_node, &vmap_area_root);
+
+	prev = rb_prev(&va->rb_node);
+	if (prev)
+		list_add(&va->list,
+			&rb_entry(prev, struct vmap_area, rb_node)->list);
+	else
+		list_add(&va->list, &vmap_area_list);
+}
+
+static void purge_vmap_area_lazy(void);
+
+/*
+ * Allocate a region of kernel virtual address space of @size bytes,
+ * aligned to @align, within [vstart, vend).
+ */
+static struct vmap_area *alloc_vmap_area(unsigned long size,
+				unsigned long align,
+				unsigned long vstart, unsigned long vend,
+				gfp_t gfp_mask)
+{
+	struct vmap_area *va;
+	struct rb_node *n;
+	unsigned long addr;
+	int purged = 0;
+	struct vmap_area *first;
+
+	BUG_ON(!size);
+	BUG_ON(size & ~PAGE_MASK);
+
+	va = kmalloc(sizeof(struct vmap_area), gfp_mask & GFP_LEVEL_MASK);
+	if (unlikely(!va))
+		return NULL;
+
+retry:
+	spin_lock(&vmap_area_lock);
+	/*
+	 * Invalidate the cache if the constraints are looser than those it
+	 * was built for, or if the request would fit in a hole it skipped.
+	 */
+	if (!free_vmap_cache || size <= cached_hole_size ||
+			vstart < cached_vstart || align < cached_align) {
+		cached_hole_size = 0;
+		free_vmap_cache = NULL;
+	}
+	cached_vstart = vstart;
+	cached_align = align;
+
+	if (free_vmap_cache) {
+		first = rb_entry(free_vmap_cache, struct vmap_area, rb_node);
+		addr = ALIGN(first->va_end, align);
+		if (addr < vstart)
+			goto nocache;
+		if (addr + size - 1 < addr)
+			goto overflow;
+	} else {
+nocache:
+		addr = ALIGN(vstart, align);
+		if (addr + size - 1 < addr)
+			goto overflow;
+
+		/* Find the lowest area which ends above addr */
+		n = vmap_area_root.rb_node;
+		first = NULL;
+		while (n) {
+			struct vmap_area *tmp;
+
+			tmp = rb_entry(n, struct vmap_area, rb_node);
+			if (tmp->va_end > addr) {
+				first = tmp;
+				if (tmp->va_start <= addr)
+					break;
+				n = n->rb_left;
+			} else
+				n = n->rb_right;
+		}
+		if (!first)
+			goto found;
+	}
+
+	/* From there, walk the areas in address order to the first hole */
+	while (addr + size > first->va_start && addr + size <= vend) {
+		if (addr + cached_hole_size < first->va_start)
+			cached_hole_size = first->va_start - addr;
+		addr = ALIGN(first->va_end, align);
+		if (addr + size - 1 < addr)
+			goto overflow;
+		if (first->list.next == &vmap_area_list)
+			goto found;
+		first = list_entry(first->list.next, struct vmap_area, list);
+	}
+
+found:
+	if (addr + size > vend)
+		goto overflow;
+
+	va->va_start = addr;
+	va->va_end = addr + size;
+	va->flags = 0;
+	va->private = NULL;
+	__insert_vmap_area(va);
+	free_vmap_cache = &va->rb_node;
+	spin_unlock(&vmap_area_lock);
+	return va;
+
+overflow:
+	spin_unlock(&vmap_area_lock);
+	if (!purged) {
+		/* Lazily freed areas may be in the way: get rid of them */
+		purge_vmap_area_lazy();
+		purged = 1;
+		goto retry;
+	}
+	if (printk_ratelimit())
+		printk(KERN_WARNING "allocation failed: out of vmalloc space - use vmalloc=<size> to increase size.\n");
+	kfree(va);
+	return NULL;
+}
+
+static void __free_vmap_area(struct vmap_area *va)
+{
+	if (free_vmap_cache) {
+		if (va->va_end < cached_vstart) {
+			free_vmap_cache = NULL;
+		} else {
+			struct vmap_area *cache;
+
+			cache = rb_entry(free_vmap_cache, struct vmap_area,
+						rb_node);
+			if (va->va_start <= cache->va_start) {
+				free_vmap_cache = rb_prev(&va->rb_node);
+				/*
+				 * We don't try to update cached_hole_size,
+				 * but it won't go very wrong.
+				 */
+			}
+		}
+	}
+	rb_erase(&va->rb_node, &vmap_area_root);
+	list_del(&va->list);
+	kfree(va);
+}
+
+/*
+ * Free an area which was never mapped: no TLB flush is needed.
+ */
+static void free_vmap_area(struct vmap_area *va)
+{
+	spin_lock(&vmap_area_lock);
+	__free_vmap_area(va);
+	spin_unlock(&vmap_area_lock);
+}
+
+/*
+ * How many pages may be lazily freed before we flush.  A global TLB flush
+ * costs more the more CPUs there are, so batch more on bigger machines.
+ */
+static unsigned long lazy_max_pages(void)
+{
+	unsigned int log;
+
+	log = fls(num_online_cpus());
+	return log * (32UL * 1024 * 1024 / PAGE_SIZE);
+}
+
+static DEFINE_SPINLOCK(purge_lock);
+
+static unsigned long purge_vmap_blocks_begin(struct list_head *blocks,
+				unsigned long *start, unsigned long *end);
+static void purge_vmap_blocks_end(struct list_head *blocks);
+
+/*
+ * Flush the TLBs over all lazily freed areas and the dirty pages of the
+ * vmap blocks, in one go, and release them.  If `sync' is clear, give up when someone else is at it already.  If
+ * `force_flush' is set, [*start, *end) gets flushed even when there is
+ * nothing lazy.
+ */
+static void __purge_vmap_area_lazy(unsigned long *start, unsigned long *end,
+					int sync, int force_flush)
+{
+	LIST_HEAD(valist);
+	LIST_HEAD(vblist);
+	struct vmap_area *va, *n;
+	unsigned long nr = 0;
+	unsigned long nr_vb;
+
+	if (!sync && !force_flush) {
+		if (!spin_trylock(&purge_lock))
+			return;
+	} else
+		spin_lock(&purge_lock);
+
+	nr_vb = purge_vmap_blocks_begin(&vblist, start, end);
+
+	spin_lock(&vmap_area_lock);
+	list_splice_init(&vmap_purge_list, &valist);
+	spin_unlock(&vmap_area_lock);
+
+	list_for_each_entry(va, &valist, purge_list) {
+		if (va->va_start < *start)
+			*start = va->va_start;
+		if (va->va_end > *end)
+			*end = va->va_end;
+		nr += (va->va_end - va->va_start) >> PAGE_SHIFT;
+	}
+
+	if (nr + nr_vb)
+		atomic_sub(nr + nr_vb, &vmap_lazy_nr);
+	if (nr || nr_vb || force_flush)
+		flush_tlb_kernel_range(*start, *end);
+
+	purge_vmap_blocks_end(&vblist);
+
+	if (nr) {
+		spin_lock(&vmap_area_lock);
+		list_for_each_entry_safe(va, n, &valist, purge_list)
+			__free_vmap_area(va);
+		spin_unlock(&vmap_area_lock);
+	}
+	spin_unlock(&purge_lock);
+}
+
+static void try_purge_vmap_area_lazy(void)
+{
+	unsigned long start = ULONG_MAX, end = 0;
+
+	__purge_vmap_area_lazy(&start, &end, 0, 0);
+}
+
+static void purge_vmap_area_lazy(void)
+{
+	unsigned long start = ULONG_MAX, end = 0;
+
+	__purge_vmap_area_lazy(&start, &end, 1, 0);
+}
+
+/*
+ * Free an area whose page tables have been cleared, leaving the TLB flush
+ * for later.
+ */
+static void free_vmap_area_noflush(struct vmap_area *va)
+{
+	spin_lock(&vmap_area_lock);
+	va->flags |= VM_LAZY_FREE;
+	list_add_tail(&va->purge_list, &vmap_purge_list);
+	spin_unlock(&vmap_area_lock);
+
+	atomic_add((va->va_end - va->va_start) >> PAGE_SHIFT, &vmap_lazy_nr);
+	if (unlikely(atomic_read(&vmap_lazy_nr) > lazy_max_pages()))
+		try_purge_vmap_area_lazy();
+}
+
+static void free_unmap_vmap_area(struct vmap_area *va)
+{
+	vunmap_page_range(va->va_start, va->va_end);
+	free_vmap_area_noflush(va);
+}
+
+/**
+ *	vm_unmap_aliases  -  unmap outstanding lazy aliases in the vmap layer
+ *
+ *	vunmap, vfree and vm_unmap_ram leave stale TLB entries behind until
+ *	the next purge, which still alias pages that may already be back in
+ *	other use.  This purges right away, dirty pages of vmap blocks
+ *	included.  Code which changes the way a page is mapped (its caching
+ *	attributes, say) must call this first.
+ */
+void vm_unmap_aliases(void)
+{
+	unsigned long start = VMALLOC_START, end = VMALLOC_END;
+
+	__purge_vmap_area_lazy(&start, &end, 1, 1);
+}
+
+EXPORT_SYMBOL_GPL(vm_unmap_aliases);
+
+/*
+ * vmlist is kept in address order: find the link to the vm_struct of @va,
+ * which follows that of the nearest vm_struct area below.  Caller holds
+ * vmlist_lock for writing and vmap_area_lock.
+ */
+static struct vm_struct **vmlist_link(struct vmap_area *va)
+{
+	struct rb_node *n = &va->rb_node;
+
+	while ((n = rb_prev(n)) != NULL) {
+		struct vmap_area *prev = rb_entry(n, struct vmap_area, rb_node);
+
+		if (prev->flags & VM_VM_AREA)
+			return &((struct vm_struct *)prev->private)->next;
+	}
+	return &vmlist;
+}
+
+static void insert_vmalloc_vm(struct vm_struct *vm, struct vmap_area *va)
+{
+	struct vm_struct **p = vmlist_link(va);
+
+	va->flags |= VM_VM_AREA;
+	va->private = vm;
+	vm->next = *p;
+	*p = vm;
+}
+
 struct vm_struct *__get_vm_area(unsigned long size, unsigned long flags,
 				unsigned long start, unsigned long end)
 {
-	struct vm_struct **p, *tmp, *area;
+	struct vm_struct *area;
+	struct vmap_area *va;
 	unsigned long align = 1;
-	unsigned long addr;
 
 	if (flags & VM_IOREMAP) {
 		int bit = fls(size);
@@ -175,60 +589,39 @@ struct vm_struct *__get_vm_area(unsigned long size, unsigned long flags,
 
 		align = 1ul << bit;
 	}
-	addr = ALIGN(start, align);
 	size = PAGE_ALIGN(size);
+	if (unlikely(!size))
+		return NULL;
 
 	area = kmalloc(sizeof(*area), GFP_KERNEL);
 	if (unlikely(!area))
 		return NULL;
 
-	if (unlikely(!size)) {
-		kfree (area);
-		return NULL;
-	}
-
 	/*
 	 * We always allocate a guard page.
 	 */
 	size += PAGE_SIZE;
 
-	write_lock(&vmlist_lock);
-	for (p = &vmlist; (tmp = *p) != NULL ;p = &tmp->next) {
-		if ((unsigned long)tmp->addr < addr) {
-			if((unsigned long)tmp->addr + tmp->size >= addr)
-				addr = ALIGN(tmp->size + 
-					     (unsigned long)tmp->addr, align);
-			continue;
-		}
-		if ((size + addr) < addr)
-			goto out;
-		if (size + addr <= (unsigned long)tmp->addr)
-			goto found;
-		addr = ALIGN(tmp->size + (unsigned long)tmp->addr, align);
-		if (addr > end - size)
-			goto out;
+	va = alloc_vmap_area(size, align, start, end, GFP_KERNEL);
+	if (!va) {
+		kfree(area);
+		return NULL;
 	}
 
-found:
-	area->next = *p;
-	*p = area;
-
 	area->flags = flags;
-	area->addr = (void *)addr;
+	area->addr = (void *)va->va_start;
 	area->size = size;
 	area->pages = NULL;
 	area->nr_pages = 0;
 	area->phys_addr = 0;
+
+	write_lock(&vmlist_lock);
+	spin_lock(&vmap_area_lock);
+	insert_vmalloc_vm(area, va);
+	spin_unlock(&vmap_area_lock);
 	write_unlock(&vmlist_lock);
 
 	return area;
-
-out:
-	write_unlock(&vmlist_lock);
-	kfree(area);
-	if (printk_ratelimit())
-		printk(KERN_WARNING "allocation failed: out of vmalloc space - use vmalloc=<size> to increase size.\n");
-	return NULL;
 }
 
 /**
@@ -249,17 +642,25 @@ struct vm_struct *get_vm_area(unsigned long size, unsigned long flags)
 /* Caller must hold vmlist_lock */
 struct vm_struct *__remove_vm_area(void *addr)
 {
-	struct vm_struct **p, *tmp;
-
-	for (p = &vmlist ; (tmp = *p) != NULL ;p = &tmp->next) {
-		 if (tmp->addr == addr)
-			 goto found;
+	struct vmap_area *va;
+	struct vm_struct *tmp, **p;
+
+	spin_lock(&vmap_area_lock);
+	va = __find_vmap_area((unsigned long)addr);
+	if (!va || va->va_start != (unsigned long)addr ||
+			!(va->flags & VM_VM_AREA)) {
+		spin_unlock(&vmap_area_lock);
+		return NULL;
 	}
-	return NULL;
-
-found:
-	unmap_vm_area(tmp);
+	tmp = va->private;
+	p = vmlist_link(va);
+	BUG_ON(*p != tmp);
 	*p = tmp->next;
+	va->flags &= ~VM_VM_AREA;
+	va->private = NULL;
+	spin_unlock(&vmap_area_lock);
+
+	free_unmap_vmap_area(va);
 
 	/*
 	 * Remove the guard page.
@@ -592,3 +993,408 @@ finished:
 	read_unlock(&vmlist_lock);
 	return buf - buf_start;
 }
+
+/*
+ * vm_map_ram hands out small mappings from per-cpu vmap blocks: chunks of
+ * VMAP_BLOCK_PAGES pages of address space, a vmap area each.  Mapping then
+ * needs neither vmap_area_lock nor a search of the rbtree.  Unmapped pages
+ * of a block stay dirty until a purge has flushed the TLBs over them; the
+ * purge then hands them out again, or releases the block if nothing in it
+ * is mapped any more.
+ */
+#define VMAP_MAX_ALLOC		BITS_PER_LONG	/* pages */
+#define VMAP_BLOCK_PAGES	(4 * VMAP_MAX_ALLOC)
+#define VMAP_BLOCK_SIZE		(VMAP_BLOCK_PAGES * PAGE_SIZE)
+
+struct vmap_block_queue {
+	spinlock_t lock;
+	struct list_head free;		/* blocks with space left */
+};
+
+struct vmap_block {
+	spinlock_t lock;
+	struct vmap_area *va;
+	struct vmap_block_queue *vbq;	/* of the cpu it was set up on */
+	unsigned long free;		/* pages not handed out */
+	unsigned long dirty;		/* pages unmapped since the last purge */
+	unsigned long flushing;		/* pages the running purge flushes */
+	unsigned long dirty_min;	/* dirty pages are in [min, max) */
+	unsigned long dirty_max;
+	DECLARE_BITMAP(alloc_map, VMAP_BLOCK_PAGES);
+	DECLARE_BITMAP(dirty_map, VMAP_BLOCK_PAGES);
+	DECLARE_BITMAP(flush_map, VMAP_BLOCK_PAGES);
+	struct list_head free_list;	/* on vmap_block_queue.free */
+	struct list_head purge_list;	/* on the list of the running purge */
+};
+
+static DEFINE_PER_CPU(struct vmap_block_queue, vmap_block_queue);
+
+/*
+ * All vmap blocks, by address, for vm_unmap_ram and the purge to find
+ * them.  Blocks are aligned to VMAP_BLOCK_SIZE, so each has an index of
+ * its own.
+ */
+static DEFINE_SPINLOCK(vmap_block_tree_lock);
+static RADIX_TREE(vmap_block_tree, GFP_ATOMIC);
+
+static unsigned long addr_to_vb_idx(unsigned long addr)
+{
+	return addr / VMAP_BLOCK_SIZE;
+}
+
+static inline unsigned long vb_mapped(struct vmap_block *vb)
+{
+	return VMAP_BLOCK_PAGES - vb->free - vb->dirty - vb->flushing;
+}
+
+static struct vmap_block *new_vmap_block(gfp_t gfp_mask)
+{
+	struct vmap_block_queue *vbq;
+	struct vmap_block *vb;
+	struct vmap_area *va;
+	int err;
+
+	vb = kmalloc(sizeof(struct vmap_block), gfp_mask & GFP_LEVEL_MASK);
+	if (unlikely(!vb))
+		return NULL;
+
+	va = alloc_vmap_area(VMAP_BLOCK_SIZE, VMAP_BLOCK_SIZE,
+					VMALLOC_START, VMALLOC_END, gfp_mask);
+	if (unlikely(!va)) {
+		kfree(vb);
+		return NULL;
+	}
+
+	err = radix_tree_preload(gfp_mask);
+	if (unlikely(err)) {
+		free_vmap_area(va);
+		kfree(vb);
+		return NULL;
+	}
+
+	spin_lock_init(&vb->lock);
+	vb->va = va;
+	vb->free = VMAP_BLOCK_PAGES;
+	vb->dirty = 0;
+	vb->flushing = 0;
+	vb->dirty_min = VMAP_BLOCK_PAGES;
+	vb->dirty_max = 0;
+	bitmap_zero(vb->alloc_map, VMAP_BLOCK_PAGES);
+	bitmap_zero(vb->dirty_map, VMAP_BLOCK_PAGES);
+	bitmap_zero(vb->flush_map, VMAP_BLOCK_PAGES);
+	INIT_LIST_HEAD(&vb->purge_list);
+
+	spin_lock(&vmap_block_tree_lock);
+	err = radix_tree_insert(&vmap_block_tree,
+				addr_to_vb_idx(va->va_start), vb);
+	spin_unlock(&vmap_block_tree_lock);
+	BUG_ON(err);
+	radix_tree_preload_end();
+
+	vbq = &get_cpu_var(vmap_block_queue);
+	vb->vbq = vbq;
+	spin_lock(&vbq->lock);
+	list_add(&vb->free_list, &vbq->free);
+	spin_unlock(&vbq->lock);
+	put_cpu_var(vmap_block_queue);
+
+	return vb;
+}
+
+/*
+ * Release a block with nothing mapped in it, which has been taken off its
+ * queue.  Its address space goes the lazy way, dirty pages and all, with
+ * everything else waiting for a TLB flush.
+ */
+static void free_vmap_block(struct vmap_block *vb)
+{
+	struct vmap_block *tmp;
+
+	spin_lock(&vmap_block_tree_lock);
+	tmp = radix_tree_delete(&vmap_block_tree,
+				addr_to_vb_idx(vb->va->va_start));
+	spin_unlock(&vmap_block_tree_lock);
+	BUG_ON(tmp != vb);
+
+	/* Counted again with the whole area */
+	atomic_sub(vb->dirty, &vmap_lazy_nr);
+	free_vmap_area_noflush(vb->va);
+	kfree(vb);
+}
+
+/* First page of a run of @nr free ones in @vb, or -1 */
+static long vb_find_free(struct vmap_block *vb, unsigned long nr)
+{
+	unsigned long start = 0, next;
+
+	for (;;) {
+		start = find_next_zero_bit(vb->alloc_map, VMAP_BLOCK_PAGES,
+					   start);
+		if (start + nr > VMAP_BLOCK_PAGES)
+			return -1;
+		next = find_next_bit(vb->alloc_map, start + nr, start);
+		if (next >= start + nr)
+			return start;
+		start = next + 1;
+	}
+}
+
+static void *vb_alloc(unsigned long size, gfp_t gfp_mask)
+{
+	struct vmap_block_queue *vbq;
+	struct vmap_block *vb;
+	unsigned long addr;
+	unsigned long nr = size >> PAGE_SHIFT;
+	unsigned long i;
+	long first;
+
+again:
+	addr = 0;
+	vbq = &get_cpu_var(vmap_block_queue);
+	spin_lock(&vbq->lock);
+	list_for_each_entry(vb, &vbq->free, free_list) {
+		spin_lock(&vb->lock);
+		first = vb->free >= nr ? vb_find_free(vb, nr) : -1;
+		if (first >= 0) {
+			for (i = first; i < first + nr; i++)
+				__set_bit(i, vb->alloc_map);
+			vb->free -= nr;
+			if (!vb->free)
+				list_del_init(&vb->free_list);
+			addr = vb->va->va_start + (first << PAGE_SHIFT);
+			spin_unlock(&vb->lock);
+			break;
+		}
+		spin_unlock(&vb->lock);
+	}
+	spin_unlock(&vbq->lock);
+	put_cpu_var(vmap_block_queue);
+
+	if (!addr) {
+		if (!new_vmap_block(gfp_mask))
+			return NULL;
+		goto again;
+	}
+	return (void *)addr;
+}
+
+static void vb_free(const void *addr, unsigned long size)
+{
+	struct vmap_block_queue *vbq;
+	struct vmap_block *vb;
+	unsigned long nr = size >> PAGE_SHIFT;
+	unsigned long offset, i;
+	int empty = 0;
+
+	spin_lock(&vmap_block_tree_lock);
+	vb = radix_tree_lookup(&vmap_block_tree,
+				addr_to_vb_idx((unsigned long)addr));
+	spin_unlock(&vmap_block_tree_lock);
+	BUG_ON(!vb);
+
+	vunmap_page_range((unsigned long)addr, (unsigned long)addr + size);
+	offset = ((unsigned long)addr - vb->va->va_start) >> PAGE_SHIFT;
+
+	/* Before the pages show up in vb->dirty, where a purge takes them */
+	atomic_add(nr, &vmap_lazy_nr);
+
+	vbq = vb->vbq;
+	spin_lock(&vbq->lock);
+	spin_lock(&vb->lock);
+	for (i = offset; i < offset + nr; i++)
+		__set_bit(i, vb->dirty_map);
+	vb->dirty += nr;
+	vb->dirty_min = min(vb->dirty_min, offset);
+	vb->dirty_max = max(vb->dirty_max, offset + nr);
+	BUG_ON(vb->free + vb->dirty + vb->flushing > VMAP_BLOCK_PAGES);
+	/* A block the running purge holds is left to it */
+	if (!vb_mapped(vb) && list_empty(&vb->purge_list)) {
+		list_del_init(&vb->free_list);
+		empty = 1;
+	}
+	spin_unlock(&vb->lock);
+	spin_unlock(&vbq->lock);
+
+	if (empty)
+		free_vmap_block(vb);
+	else if (unlikely(atomic_read(&vmap_lazy_nr) > lazy_max_pages()))
+		try_purge_vmap_area_lazy();
+}
+
+/*
+ * First half of a purge, before the TLB flush: move the dirty pages of
+ * every block over to its flush_map and widen [*start, *end) to cover
+ * them.  The blocks go on @blocks, where vb_free leaves them alone.
+ * Returns the number of pages.  Caller holds purge_lock.
+ */
+static unsigned long purge_vmap_blocks_begin(struct list_head *blocks,
+				unsigned long *start, unsigned long *end)
+{
+	struct vmap_block *batch[16];
+	unsigned long index = 0, nr = 0;
+	unsigned int n, i;
+
+	spin_lock(&vmap_block_tree_lock);
+	while ((n = radix_tree_gang_lookup(&vmap_block_tree, (void **)batch,
+					   index, ARRAY_SIZE(batch)))) {
+		for (i = 0; i < n; i++) {
+			struct vmap_block *vb = batch[i];
+			unsigned long va_start = vb->va->va_start;
+
+			spin_lock(&vb->lock);
+			if (vb->dirty) {
+				*start = min(*start, va_start +
+					     (vb->dirty_min << PAGE_SHIFT));
+				*end = max(*end, va_start +
+					   (vb->dirty_max << PAGE_SHIFT));
+				bitmap_copy(vb->flush_map, vb->dirty_map,
+					    VMAP_BLOCK_PAGES);
+				bitmap_zero(vb->dirty_map, VMAP_BLOCK_PAGES);
+				vb->flushing = vb->dirty;
+				nr += vb->dirty;
+				vb->dirty = 0;
+				vb->dirty_min = VMAP_BLOCK_PAGES;
+				vb->dirty_max = 0;
+				list_add_tail(&vb->purge_list, blocks);
+			}
+			spin_unlock(&vb->lock);
+		}
+		index = addr_to_vb_idx(batch[n - 1]->va->va_start) + 1;
+	}
+	spin_unlock(&vmap_block_tree_lock);
+	return nr;
+}
+
+/*
+ * Second half, after the flush: the flushed pages can be handed out
+ * again.  A block with nothing mapped left in it is released instead.
+ */
+static void purge_vmap_blocks_end(struct list_head *blocks)
+{
+	struct vmap_block *vb, *n;
+
+	list_for_each_entry_safe(vb, n, blocks, purge_list) {
+		struct vmap_block_queue *vbq = vb->vbq;
+		int empty = 0;
+
+		spin_lock(&vbq->lock);
+		spin_lock(&vb->lock);
+		list_del_init(&vb->purge_list);
+		bitmap_andnot(vb->alloc_map, vb->alloc_map, vb->flush_map,
+			      VMAP_BLOCK_PAGES);
+		vb->free += vb->flushing;
+		vb->flushing = 0;
+		if (!vb_mapped(vb)) {
+			list_del_init(&vb->free_list);
+			empty = 1;
+		} else if (list_empty(&vb->free_list))
+			list_add_tail(&vb->free_list, &vbq->free);
+		spin_unlock(&vb->lock);
+		spin_unlock(&vbq->lock);
+
+		if (empty)
+			free_vmap_block(vb);
+	}
+}
+
+/**
+ *	vm_map_ram  -  map pages linearly into kernel virtual address space
+ *
+ *	@pages:		array of page pointers
+ *	@count:		number of pages to map
+ *	@prot:		page protection for the mapping
+ *
+ *	A faster vmap() for short-lived mappings: no vm_struct is set up,
+ *	and small mappings come out of per-cpu blocks.  The mapping must be
+ *	released with vm_unmap_ram(), with the same @count.  Returns the
+ *	address of the mapping, or %NULL on failure.
+ */
+void *vm_map_ram(struct page **pages, unsigned int count, pgprot_t prot)
+{
+	unsigned long size = (unsigned long)count << PAGE_SHIFT;
+	unsigned long addr;
+	void *mem;
+
+	if (likely(count <= VMAP_MAX_ALLOC)) {
+		mem = vb_alloc(size, GFP_KERNEL);
+		if (!mem)
+			return NULL;
+		addr = (unsigned long)mem;
+	} else {
+		struct vmap_area *va;
+
+		va = alloc_vmap_area(size, PAGE_SIZE,
+				VMALLOC_START, VMALLOC_END, GFP_KERNEL);
+		if (!va)
+			return NULL;
+		addr = va->va_start;
+		mem = (void *)addr;
+	}
+	if (vmap_page_range(addr, addr + size, prot, &pages)) {
+		vm_unmap_ram(mem, count);
+		return NULL;
+	}
+	return mem;
+}
+
+EXPORT_SYMBOL(vm_map_ram);
+
+/**
+ *	vm_unmap_ram  -  unmap linear kernel address space set up by vm_map_ram
+ *
+ *	@mem:		the address vm_map_ram() returned
+ *	@count:		the count passed to vm_map_ram()
+ *
+ *	The TLB flush is deferred: see vm_unmap_aliases().
+ */
+void vm_unmap_ram(const void *mem, unsigned int count)
+{
+	unsigned long size = (unsigned long)count << PAGE_SHIFT;
+	unsigned long addr = (unsigned long)mem;
+	struct vmap_area *va;
+
+	BUG_ON(!addr);
+	BUG_ON(addr < VMALLOC_START);
+	BUG_ON(addr > VMALLOC_END);
+	BUG_ON(addr & (PAGE_SIZE-1));
+
+	if (likely(count <= VMAP_MAX_ALLOC)) {
+		vb_free(mem, size);
+		return;
+	}
+
+	spin_lock(&vmap_area_lock);
+	va = __find_vmap_area(addr);
+	spin_unlock(&vmap_area_lock);
+	BUG_ON(!va || va->va_start != addr || (va->flags & VM_VM_AREA));
+	free_unmap_vmap_area(va);
+}
+
+EXPORT_SYMBOL(vm_unmap_ram);
+
+void __init vmalloc_init(void)
+{
+	struct vm_struct *tmp;
+	int i;
+
+	for_each_cpu(i) {
+		struct vmap_block_queue *vbq = &per_cpu(vmap_block_queue, i);
+
+		spin_lock_init(&vbq->lock);
+		INIT_LIST_HEAD(&vbq->free);
+	}
+
+	/* Areas the architecture set up early, before the rbtree */
+	for (tmp = vmlist; tmp; tmp = tmp->next) {
+		struct vmap_area *va;
+
+		va = kmalloc(sizeof(struct vmap_area), GFP_KERNEL);
+		if (!va)
+			panic("vmalloc_init: out of memory\n");
+		va->va_start = (unsigned long)tmp->addr;
+		va->va_end = va->va_start + tmp->size;
+		va->flags = VM_VM_AREA;
+		va->private = tmp;
+		__insert_vmap_area(va);
+	}
+}
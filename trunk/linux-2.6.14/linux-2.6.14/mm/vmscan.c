@@ -28,6 +28,7 @@
 #include <linux/pagevec.h>
 #include <linux/backing-dev.h>
 #include <linux/rmap.h>
+#include <linux/ksm.h>
 #include <linux/topology.h>
 #include <linux/cpu.h>
 #include <linux/cpuset.h>
@@ -61,8 +62,6 @@ struct scan_control {
 	/* Incremented by the number of pages reclaimed */
 	unsigned long nr_reclaimed;
 
-	unsigned long nr_mapped;	/* From page_state */
-
 	/* How many pages shrink_cache() should reclaim */
 	int nr_to_reclaim;
 
@@ -97,6 +96,11 @@ struct shrinker {
 
 #define lru_to_page(_head) (list_entry((_head)->prev, struct page, lru))
 
+/* The pgscan_* counters in struct page_state are in enum lru_list order */
+#define count_lru_scan(l, nr)						\
+	__mod_page_state(offsetof(struct page_state, pgscan_inactive_anon) + \
+			 (l) * sizeof(unsigned long), (nr))
+
 #ifdef ARCH_HAS_PREFETCH
 #define prefetch_prev_lru_page(_page, _base, _field)			\
 	do {								\
@@ -129,7 +133,6 @@ struct shrinker {
  * From 0 .. 100.  Higher means more swappy.
  */
 int vm_swappiness = 60;
-static long total_memory;
 
 static LIST_HEAD(shrinker_list);
 static DECLARE_RWSEM(shrinker_rwsem);
@@ -378,6 +381,7 @@ static int shrink_list(struct list_head *page_list, struct scan_control *sc)
 	LIST_HEAD(ret_pages);
 	struct pagevec freed_pvec;
 	int pgactivate = 0;
+	int culled = 0;
 	int reclaimed = 0;
 
 	cond_resched();
@@ -407,6 +411,14 @@ static int shrink_list(struct list_head *page_list, struct scan_control *sc)
 		if (PageWriteback(page))
 			goto keep_locked;
 
+		/* ramfs and SHM_LOCKed shmem: no point looking again */
+		if (mapping_unevictable(page_mapping(page)))
+			goto cull_mlocked;
+
+		/* KSM pages are not swapped: ksmd holds on to them */
+		if (PageKsm(page))
+			goto cull_mlocked;
+
 		referenced = page_referenced(page, 1, sc->priority <= 0);
 		/* In active use or really unfreeable?  Activate it. */
 		if (referenced && page_mapping_inuse(page))
@@ -432,9 +444,11 @@ static int shrink_list(struct list_head *page_list, struct scan_control *sc)
 		 * processes. Try to unmap it here.
 		 */
 		if (page_mapped(page) && mapping) {
-			switch (try_to_unmap(page)) {
+			switch (try_to_unmap(page, 0)) {
 			case SWAP_FAIL:
 				goto activate_locked;
+			case SWAP_MLOCK:
+				goto cull_mlocked;
 			case SWAP_AGAIN:
 				goto keep_locked;
 			case SWAP_SUCCESS:
@@ -504,33 +518,39 @@ static int shrink_list(struct list_head *page_list, struct scan_control *sc)
 		if (!mapping)
 			goto keep_locked;	/* truncate got there first */
 
-		write_lock_irq(&mapping->tree_lock);
+		spin_lock_irq(&mapping->tree_lock);
 
 		/*
 		 * The non-racy check for busy page.  It is critical to check
 		 * PageDirty _after_ making sure that the page is freeable and
 		 * not in use by anybody. 	(pagecache + us == 2)
+		 *
+		 * Lockless lookups do not take the tree_lock, so the count
+		 * is frozen at zero while the page goes: they cannot take a
+		 * reference meanwhile.  The cmpxchg is a full barrier.
 		 */
-		if (unlikely(page_count(page) != 2))
+		if (!page_freeze_refs(page, 2))
 			goto cannot_free;
-		smp_rmb();
-		if (unlikely(PageDirty(page)))
+		if (unlikely(PageDirty(page))) {
+			page_unfreeze_refs(page, 2);
 			goto cannot_free;
+		}
 
 #ifdef CONFIG_SWAP
 		if (PageSwapCache(page)) {
 			swp_entry_t swap = { .val = page->private };
 			__delete_from_swap_cache(page);
-			write_unlock_irq(&mapping->tree_lock);
-			swap_free(swap);
-			__put_page(page);	/* The pagecache ref */
+			spin_unlock_irq(&mapping->tree_lock);
+			swapcache_free(swap);
+			page_unfreeze_refs(page, 1);	/* drop the pagecache ref */
 			goto free_it;
 		}
 #endif /* CONFIG_SWAP */
 
-		__remove_from_page_cache(page);
-		write_unlock_irq(&mapping->tree_lock);
-		__put_page(page);
+		__remove_from_page_cache(page,
+					 workingset_eviction(mapping, page));
+		spin_unlock_irq(&mapping->tree_lock);
+		page_unfreeze_refs(page, 1);	/* drop the pagecache ref */
 
 free_it:
 		unlock_page(page);
@@ -540,7 +560,13 @@ free_it:
 		continue;
 
 cannot_free:
-		write_unlock_irq(&mapping->tree_lock);
+		spin_unlock_irq(&mapping->tree_lock);
+		goto keep_locked;
+
+cull_mlocked:
+		/* The caller puts it on the unevictable list */
+		SetPageUnevictable(page);
+		culled++;
 		goto keep_locked;
 
 activate_locked:
@@ -556,6 +582,7 @@ keep:
 	if (pagevec_count(&freed_pvec))
 		__pagevec_release_nonlru(&freed_pvec);
 	mod_page_state(pgactivate, pgactivate);
+	mod_page_state(unevictable_culled, culled);
 	sc->nr_reclaimed += reclaimed;
 	return reclaimed;
 }
@@ -612,11 +639,14 @@ static int isolate_lru_pages(int nr_to_scan, struct list_head *src,
 /*
  * shrink_cache() adds the number of pages reclaimed to sc->nr_reclaimed
  */
-static void shrink_cache(struct zone *zone, struct scan_control *sc)
+static void shrink_cache(struct zone *zone, struct scan_control *sc,
+			 enum lru_list l)
 {
 	LIST_HEAD(page_list);
 	struct pagevec pvec;
 	int max_scan = sc->nr_to_scan;
+	int file = is_file_lru(l);
+	int nr_rotated = 0;
 
 	pagevec_init(&pvec, 1);
 
@@ -629,9 +659,10 @@ static void shrink_cache(struct zone *zone, struct scan_control *sc)
 		int nr_freed;
 
 		nr_taken = isolate_lru_pages(sc->swap_cluster_max,
-					     &zone->inactive_list,
+					     &zone->lru[l].list,
 					     &page_list, &nr_scan);
-		zone->nr_inactive -= nr_taken;
+		zone->lru[l].nr_pages -= nr_taken;
+		zone->recent_scanned[file] += nr_taken;
 		zone->pages_scanned += nr_scan;
 		spin_unlock_irq(&zone->lru_lock);
 
@@ -639,6 +670,7 @@ static void shrink_cache(struct zone *zone, struct scan_control *sc)
 			goto done;
 
 		max_scan -= nr_scan;
+		count_lru_scan(l, nr_scan);
 		if (current_is_kswapd())
 			mod_page_state_zone(zone, pgscan_kswapd, nr_scan);
 		else
@@ -651,17 +683,20 @@ static void shrink_cache(struct zone *zone, struct scan_control *sc)
 
 		spin_lock_irq(&zone->lru_lock);
 		/*
-		 * Put back any unfreeable pages.
+		 * Put back any unfreeable pages.  Those which turned out
+		 * to be in use go to the active list: count them, they
+		 * are what get_scan_ratio() balances the lists by.
 		 */
 		while (!list_empty(&page_list)) {
 			page = lru_to_page(&page_list);
 			if (TestSetPageLRU(page))
 				BUG();
 			list_del(&page->lru);
-			if (PageActive(page))
-				add_page_to_active_list(zone, page);
-			else
-				add_page_to_inactive_list(zone, page);
+			if (PageActive(page)) {
+				zone->recent_rotated[file]++;
+				nr_rotated++;
+			}
+			add_page_to_lru_list(zone, page, page_lru(page));
 			if (!pagevec_add(&pvec, page)) {
 				spin_unlock_irq(&zone->lru_lock);
 				__pagevec_release(&pvec);
@@ -672,13 +707,18 @@ static void shrink_cache(struct zone *zone, struct scan_control *sc)
 	spin_unlock_irq(&zone->lru_lock);
 done:
 	pagevec_release(&pvec);
+	if (file)
+		mod_page_state(pgrotated_file, nr_rotated);
+	else
+		mod_page_state(pgrotated_anon, nr_rotated);
 }
 
 /*
- * This moves pages from the active list to the inactive list.
+ * This moves pages from the active list @l to the inactive list of the
+ * same type.
  *
- * We move them the other way if the page is referenced by one or more
- * processes, from rmap.
+ * We move them the other way if the page is mapped and referenced by one
+ * or more processes, from rmap.
  *
  * If the pages are mostly unmapped, the processing is fast and it is
  * appropriate to hold zone->lru_lock across the whole operation.  But if
@@ -692,72 +732,44 @@ done:
  * But we had to alter page->flags anyway.
  */
 static void
-refill_inactive_zone(struct zone *zone, struct scan_control *sc)
+refill_inactive_zone(struct zone *zone, struct scan_control *sc,
+		     enum lru_list l)
 {
 	int pgmoved;
 	int pgdeactivate = 0;
 	int pgscanned;
+	int pgrotated = 0;
 	int nr_pages = sc->nr_to_scan;
+	int file = is_file_lru(l);
 	LIST_HEAD(l_hold);	/* The pages which were snipped off */
 	LIST_HEAD(l_inactive);	/* Pages to go onto the inactive_list */
 	LIST_HEAD(l_active);	/* Pages to go onto the active_list */
 	struct page *page;
 	struct pagevec pvec;
-	int reclaim_mapped = 0;
-	long mapped_ratio;
-	long distress;
-	long swap_tendency;
 
 	lru_add_drain();
 	spin_lock_irq(&zone->lru_lock);
-	pgmoved = isolate_lru_pages(nr_pages, &zone->active_list,
+	pgmoved = isolate_lru_pages(nr_pages, &zone->lru[l].list,
 				    &l_hold, &pgscanned);
 	zone->pages_scanned += pgscanned;
-	zone->nr_active -= pgmoved;
+	zone->lru[l].nr_pages -= pgmoved;
+	zone->recent_scanned[file] += pgmoved;
 	spin_unlock_irq(&zone->lru_lock);
 
 	/*
-	 * `distress' is a measure of how much trouble we're having reclaiming
-	 * pages.  0 -> no problems.  100 -> great trouble.
+	 * How much of anon and of file memory to deactivate is decided by
+	 * the scan ratio in shrink_zone(): here only pages mapped and in
+	 * use by a process stay active.
 	 */
-	distress = 100 >> zone->prev_priority;
-
-	/*
-	 * The point of this algorithm is to decide when to start reclaiming
-	 * mapped memory instead of just pagecache.  Work out how much memory
-	 * is mapped.
-	 */
-	mapped_ratio = (sc->nr_mapped * 100) / total_memory;
-
-	/*
-	 * Now decide how much we really want to unmap some pages.  The mapped
-	 * ratio is downgraded - just because there's a lot of mapped memory
-	 * doesn't necessarily mean that page reclaim isn't succeeding.
-	 *
-	 * The distress ratio is important - we don't want to start going oom.
-	 *
-	 * A 100% value of vm_swappiness overrides this algorithm altogether.
-	 */
-	swap_tendency = mapped_ratio / 2 + distress + vm_swappiness;
-
-	/*
-	 * Now use this metric to decide whether to start moving mapped memory
-	 * onto the inactive list.
-	 */
-	if (swap_tendency >= 100)
-		reclaim_mapped = 1;
-
 	while (!list_empty(&l_hold)) {
 		cond_resched();
 		page = lru_to_page(&l_hold);
 		list_del(&page->lru);
-		if (page_mapped(page)) {
-			if (!reclaim_mapped ||
-			    (total_swap_pages == 0 && PageAnon(page)) ||
-			    page_referenced(page, 0, sc->priority <= 0)) {
-				list_add(&page->lru, &l_active);
-				continue;
-			}
+		if (page_mapped(page) &&
+		    page_referenced(page, 0, sc->priority <= 0)) {
+			list_add(&page->lru, &l_active);
+			pgrotated++;
+			continue;
 		}
 		list_add(&page->lru, &l_inactive);
 	}
@@ -772,10 +784,10 @@ refill_inactive_zone(struct zone *zone, struct scan_control *sc)
 			BUG();
 		if (!TestClearPageActive(page))
 			BUG();
-		list_move(&page->lru, &zone->inactive_list);
+		list_move(&page->lru, &zone->lru[l - LRU_ACTIVE].list);
 		pgmoved++;
 		if (!pagevec_add(&pvec, page)) {
-			zone->nr_inactive += pgmoved;
+			zone->lru[l - LRU_ACTIVE].nr_pages += pgmoved;
 			spin_unlock_irq(&zone->lru_lock);
 			pgdeactivate += pgmoved;
 			pgmoved = 0;
@@ -785,7 +797,7 @@ refill_inactive_zone(struct zone *zone, struct scan_control *sc)
 			spin_lock_irq(&zone->lru_lock);
 		}
 	}
-	zone->nr_inactive += pgmoved;
+	zone->lru[l - LRU_ACTIVE].nr_pages += pgmoved;
 	pgdeactivate += pgmoved;
 	if (buffer_heads_over_limit) {
 		spin_unlock_irq(&zone->lru_lock);
@@ -793,6 +805,7 @@ refill_inactive_zone(struct zone *zone, struct scan_control *sc)
 		spin_lock_irq(&zone->lru_lock);
 	}
 
+	zone->recent_rotated[file] += pgrotated;
 	pgmoved = 0;
 	while (!list_empty(&l_active)) {
 		page = lru_to_page(&l_active);
@@ -800,22 +813,101 @@ refill_inactive_zone(struct zone *zone, struct scan_control *sc)
 		if (TestSetPageLRU(page))
 			BUG();
 		BUG_ON(!PageActive(page));
-		list_move(&page->lru, &zone->active_list);
+		list_move(&page->lru, &zone->lru[l].list);
 		pgmoved++;
 		if (!pagevec_add(&pvec, page)) {
-			zone->nr_active += pgmoved;
+			zone->lru[l].nr_pages += pgmoved;
 			pgmoved = 0;
 			spin_unlock_irq(&zone->lru_lock);
 			__pagevec_release(&pvec);
 			spin_lock_irq(&zone->lru_lock);
 		}
 	}
-	zone->nr_active += pgmoved;
+	zone->lru[l].nr_pages += pgmoved;
 	spin_unlock_irq(&zone->lru_lock);
 	pagevec_release(&pvec);
 
+	count_lru_scan(l, pgscanned);
 	mod_page_state_zone(zone, pgrefill, pgscanned);
 	mod_page_state(pgdeactivate, pgdeactivate);
+	if (file)
+		mod_page_state(pgrotated_file, pgrotated);
+	else
+		mod_page_state(pgrotated_anon, pgrotated);
+}
+
+static inline unsigned long zone_lru_pages(struct zone *zone)
+{
+	return zone->lru[LRU_INACTIVE_ANON].nr_pages +
+		zone->lru[LRU_ACTIVE_ANON].nr_pages +
+		zone->lru[LRU_INACTIVE_FILE].nr_pages +
+		zone->lru[LRU_ACTIVE_FILE].nr_pages;
+}
+
+/*
+ * How hard to scan the anon and the file lists of @zone, in percent:
+ * percent[0] for anon, percent[1] for file.
+ *
+ * Each type is worth keeping in proportion to the fraction of its
+ * recently scanned pages which were found in use and rotated back to
+ * the active list, and its priority: vm_swappiness for anon and
+ * 200 - vm_swappiness for file, so that at 100 both weigh the same.
+ */
+static void get_scan_ratio(struct zone *zone, struct scan_control *sc,
+			   unsigned long *percent)
+{
+	unsigned long anon, file;
+	unsigned long anon_prio, file_prio;
+	unsigned long ap, fp;
+
+	/* Anon pages cannot go anywhere without swap */
+	if (!sc->may_swap || nr_swap_pages <= 0) {
+		percent[0] = 0;
+		percent[1] = 100;
+		return;
+	}
+
+	anon = zone->lru[LRU_ACTIVE_ANON].nr_pages +
+		zone->lru[LRU_INACTIVE_ANON].nr_pages;
+	file = zone->lru[LRU_ACTIVE_FILE].nr_pages +
+		zone->lru[LRU_INACTIVE_FILE].nr_pages;
+
+	/* Too little page cache left to make a difference */
+	if (file + zone->free_pages <= zone->pages_high) {
+		percent[0] = 100;
+		percent[1] = 0;
+		return;
+	}
+
+	/*
+	 * Halve the statistics once a quarter of the list has been
+	 * scanned, so that they follow what the workload does now.
+	 */
+	if (unlikely(zone->recent_scanned[0] > anon / 4 ||
+		     zone->recent_scanned[1] > file / 4)) {
+		spin_lock_irq(&zone->lru_lock);
+		if (zone->recent_scanned[0] > anon / 4) {
+			zone->recent_scanned[0] /= 2;
+			zone->recent_rotated[0] /= 2;
+		}
+		if (zone->recent_scanned[1] > file / 4) {
+			zone->recent_scanned[1] /= 2;
+			zone->recent_rotated[1] /= 2;
+		}
+		spin_unlock_irq(&zone->lru_lock);
+	}
+
+	anon_prio = vm_swappiness;
+	file_prio = 200 - vm_swappiness;
+
+	ap = (anon_prio + 1) * (zone->recent_scanned[0] + 1);
+	ap /= zone->recent_rotated[0] + 1;
+
+	fp = (file_prio + 1) * (zone->recent_scanned[1] + 1);
+	fp /= zone->recent_rotated[1] + 1;
+
+	percent[0] = 100 * ap / (ap + fp + 1);
+	percent[1] = 100 - percent[0];
 }
 
 /*
@@ -824,47 +916,51 @@ refill_inactive_zone(struct zone *zone, struct scan_control *sc)
 static void
 shrink_zone(struct zone *zone, struct scan_control *sc)
 {
-	unsigned long nr_active;
-	unsigned long nr_inactive;
+	unsigned long nr[NR_LRU_LISTS];
+	unsigned long percent[2];
+	enum lru_list l;
 
 	atomic_inc(&zone->reclaim_in_progress);
 
-	/*
-	 * Add one to `nr_to_scan' just to make sure that the kernel will
-	 * slowly sift through the active list.
-	 */
-	zone->nr_scan_active += (zone->nr_active >> sc->priority) + 1;
-	nr_active = zone->nr_scan_active;
-	if (nr_active >= sc->swap_cluster_max)
-		zone->nr_scan_active = 0;
-	else
-		nr_active = 0;
+	get_scan_ratio(zone, sc, percent);
 
-	zone->nr_scan_inactive += (zone->nr_inactive >> sc->priority) + 1;
-	nr_inactive = zone->nr_scan_inactive;
-	if (nr_inactive >= sc->swap_cluster_max)
-		zone->nr_scan_inactive = 0;
-	else
-		nr_inactive = 0;
-
-	sc->nr_to_reclaim = sc->swap_cluster_max;
+	for_each_evictable_lru(l) {
+		int file = is_file_lru(l);
 
-	while (nr_active || nr_inactive) {
-		if (nr_active) {
-			sc->nr_to_scan = min(nr_active,
-					(unsigned long)sc->swap_cluster_max);
-			nr_active -= sc->nr_to_scan;
-			refill_inactive_zone(zone, sc);
+		if (!percent[file]) {
+			nr[l] = 0;
+			continue;
 		}
+		/*
+		 * Add one to `nr_to_scan' just to make sure that the kernel
+		 * will slowly sift through each list.
+		 */
+		zone->lru[l].nr_scan += (zone->lru[l].nr_pages >>
+				sc->priority) * percent[file] / 100 + 1;
+		nr[l] = zone->lru[l].nr_scan;
+		if (nr[l] >= sc->swap_cluster_max)
+			zone->lru[l].nr_scan = 0;
+		else
+			nr[l] = 0;
+	}
+
+	sc->nr_to_reclaim = sc->swap_cluster_max;
 
-		if (nr_inactive) {
-			sc->nr_to_scan = min(nr_inactive,
+	while (nr[LRU_INACTIVE_ANON] || nr[LRU_ACTIVE_ANON] ||
+	       nr[LRU_INACTIVE_FILE] || nr[LRU_ACTIVE_FILE]) {
+		for_each_evictable_lru(l) {
+			if (!nr[l])
+				continue;
+			sc->nr_to_scan = min(nr[l],
 					(unsigned long)sc->swap_cluster_max);
-			nr_inactive -= sc->nr_to_scan;
-			shrink_cache(zone, sc);
-			if (sc->nr_to_reclaim <= 0)
-				break;
+			nr[l] -= sc->nr_to_scan;
+			if (is_active_lru(l))
+				refill_inactive_zone(zone, sc, l);
+			else
+				shrink_cache(zone, sc, l);
 		}
+		if (sc->nr_to_reclaim <= 0)
+			break;
 	}
 
 	throttle_vm_writeout();
@@ -872,6 +968,53 @@ shrink_zone(struct zone *zone, struct scan_control *sc)
 	atomic_dec(&zone->reclaim_in_progress);
 }
 
+/*
+ * Move @page back from the unevictable list to the inactive list of its
+ * type, after the mlock or the mapping flag which got it there went away.
+ * If it is still locked through another vma, reclaim culls it again.
+ */
+void rescue_unevictable_page(struct page *page)
+{
+	struct zone *zone = page_zone(page);
+	unsigned long flags;
+
+	spin_lock_irqsave(&zone->lru_lock, flags);
+	if (PageLRU(page) && PageUnevictable(page)) {
+		del_page_from_lru_list(zone, page, LRU_UNEVICTABLE);
+		ClearPageUnevictable(page);
+		add_page_to_inactive_list(zone, page);
+		inc_page_state(unevictable_rescued);
+	}
+	spin_unlock_irqrestore(&zone->lru_lock, flags);
+}
+
+/**
+ * scan_mapping_unevictable_pages - make a mapping's pages evictable again
+ * @mapping: the mapping which is no longer unevictable
+ *
+ * Puts the pages of @mapping which reclaim moved to the unevictable list
+ * back on the inactive lists.
+ */
+void scan_mapping_unevictable_pages(struct address_space *mapping)
+{
+	struct pagevec pvec;
+	pgoff_t next = 0;
+	int i;
+
+	pagevec_init(&pvec, 0);
+	while (pagevec_lookup(&pvec, mapping, next, PAGEVEC_SIZE)) {
+		for (i = 0; i < pagevec_count(&pvec); i++) {
+			struct page *page = pvec.pages[i];
+
+			next = page->index + 1;
+			if (PageUnevictable(page))
+				rescue_unevictable_page(page);
+		}
+		pagevec_release(&pvec);
+		cond_resched();
+	}
+}
+
 /*
  * This is the direct reclaim path, for page-allocating processes.  We only
  * try to reclaim pages from zones which will satisfy the caller's allocation
@@ -949,11 +1092,10 @@ int try_to_free_pages(struct zone **zones, unsigned int gfp_mask)
 			continue;
 
 		zone->temp_priority = DEF_PRIORITY;
-		lru_pages += zone->nr_active + zone->nr_inactive;
+		lru_pages += zone_lru_pages(zone);
 	}
 
 	for (priority = DEF_PRIORITY; priority >= 0; priority--) {
-		sc.nr_mapped = read_page_state(nr_mapped);
 		sc.nr_scanned = 0;
 		sc.nr_reclaimed = 0;
 		sc.priority = priority;
@@ -1040,7 +1182,6 @@ loop_again:
 	sc.gfp_mask = GFP_KERNEL;
 	sc.may_writepage = 0;
 	sc.may_swap = 1;
-	sc.nr_mapped = read_page_state(nr_mapped);
 
 	inc_page_state(pageoutrun);
 
@@ -1085,7 +1226,7 @@ scan:
 		for (i = 0; i <= end_zone; i++) {
 			struct zone *zone = pgdat->node_zones + i;
 
-			lru_pages += zone->nr_active + zone->nr_inactive;
+			lru_pages += zone_lru_pages(zone);
 		}
 
 		/*
@@ -1131,7 +1272,7 @@ scan:
 			if (zone->all_unreclaimable)
 				continue;
 			if (nr_slab == 0 && zone->pages_scanned >=
-				    (zone->nr_active + zone->nr_inactive) * 4)
+				    zone_lru_pages(zone) * 4)
 				zone->all_unreclaimable = 1;
 			/*
 			 * If we've done a decent amount of scanning and
@@ -1327,7 +1468,6 @@ static int __init kswapd_init(void)
 	for_each_pgdat(pgdat)
 		pgdat->kswapd
 		= find_task_by_pid(kernel_thread(kswapd, pgdat, CLONE_KERNEL));
-	total_memory = nr_free_pagecache_pages();
 	hotcpu_notifier(cpu_callback, 0);
 	return 0;
 }
@@ -1353,7 +1493,6 @@ int zone_reclaim(struct zone *zone, unsigned int gfp_mask, unsigned int order)
 	sc.gfp_mask = gfp_mask;
 	sc.may_writepage = 0;
 	sc.may_swap = 0;
-	sc.nr_mapped = read_page_state(nr_mapped);
 	sc.nr_scanned = 0;
 	sc.nr_reclaimed = 0;
 	/* scan at the highest priority */
@@ -0,0 +1,122 @@
+/*
+ * mm/workingset.c - working set detection for the page cache
+ *
+ * A file page which is read once goes on the inactive list and, unless
+ * it is used again, is reclaimed from there; only pages accessed twice
+ * while on the inactive list make it to the active list.  That protects
+ * the active list from streaming I/O, but a working set which is bigger
+ * than the inactive list is not recognised at all: its pages are evicted
+ * before their second access and keep being read back in from disk.
+ *
+ * So reclaim leaves a shadow entry in the page cache in place of each
+ * file page it evicts, which records when, in terms of the zone's
+ * inactive_age, the page was evicted.  inactive_age ticks on every
+ * eviction and on every activation, the two events which move pages
+ * out of the inactive list.  When the page is faulted back in, the
+ * difference between inactive_age then and now, the refault distance,
+ * is how many pages the inactive list would have needed to hold on top
+ * of what it did for the page to still be cached.
+ *
+ * The active list is the only memory the inactive list could grow into.
+ * A page whose refault distance is no larger than the active list would
+ * have stayed cached with the lists balanced differently: it is part of
+ * the working set, and goes straight to the active list.  It then has
+ * to compete with the pages already there, and the working set which
+ * deserves the memory wins.
+ *
+ * Shadow entries are radix tree exceptional entries, which lookups of
+ * pages ignore; they go when the page is read back in, and when the
+ * file is truncated or its inode freed.
+ */
+
+#include <linux/mm.h>
+#include <linux/swap.h>
+#include <linux/pagemap.h>
+#include <linux/radix-tree.h>
+
+/*
+ * A shadow entry holds the eviction age, node and zone of the page.
+ * The eviction age is taken from an atomic_t, so it is only ever
+ * compared modulo 2^32, or what of it fits into the entry.
+ */
+#define EVICTION_SHIFT	(RADIX_TREE_EXCEPTIONAL_SHIFT + \
+			 NODES_SHIFT + ZONES_SHIFT)
+#define EVICTION_MASK	((unsigned int)(~0UL >> EVICTION_SHIFT))
+
+static void *pack_shadow(unsigned long eviction, struct zone *zone)
+{
+	eviction = (eviction << NODES_SHIFT) | zone->zone_pgdat->node_id;
+	eviction = (eviction << ZONES_SHIFT) | zone_idx(zone);
+	eviction = (eviction << RADIX_TREE_EXCEPTIONAL_SHIFT);
+
+	return (void *)(eviction | RADIX_TREE_EXCEPTIONAL_ENTRY);
+}
+
+static void unpack_shadow(void *shadow, struct zone **zone,
+			  unsigned long *eviction)
+{
+	unsigned long entry = (unsigned long)shadow;
+	int zid, nid;
+
+	entry >>= RADIX_TREE_EXCEPTIONAL_SHIFT;
+	zid = entry & ((1UL << ZONES_SHIFT) - 1);
+	entry >>= ZONES_SHIFT;
+	nid = entry & ((1UL << NODES_SHIFT) - 1);
+	entry >>= NODES_SHIFT;
+
+	*zone = NODE_DATA(nid)->node_zones + zid;
+	*eviction = entry;
+}
+
+/**
+ * workingset_eviction - note the eviction of a page from the page cache
+ * @mapping: the address_space the page is evicted from
+ * @page: the page being evicted
+ *
+ * Returns the shadow entry to leave in the page's slot.  Called by
+ * reclaim with the page locked and the mapping's tree_lock held.
+ */
+void *workingset_eviction(struct address_space *mapping, struct page *page)
+{
+	struct zone *zone = page_zone(page);
+	unsigned int eviction;
+
+	eviction = atomic_inc_return(&zone->inactive_age);
+	return pack_shadow(eviction & EVICTION_MASK, zone);
+}
+
+/**
+ * workingset_refault - evaluate the refault of a previously evicted page
+ * @shadow: the shadow entry the page left behind
+ *
+ * Returns nonzero if the page belongs to the working set and should go
+ * straight to the active list.
+ */
+int workingset_refault(void *shadow)
+{
+	unsigned long eviction;
+	unsigned long refault_distance;
+	struct zone *zone;
+
+	unpack_shadow(shadow, &zone, &eviction);
+	refault_distance = ((unsigned int)atomic_read(&zone->inactive_age) -
+			    eviction) & EVICTION_MASK;
+
+	inc_page_state(workingset_refault);
+	if (refault_distance <= zone->lru[LRU_ACTIVE_FILE].nr_pages) {
+		inc_page_state(workingset_activate);
+		return 1;
+	}
+	return 0;
+}
+
+/**
+ * workingset_activation - note a page activation
+ * @page: the page being activated
+ *
+ * The page leaves the inactive list, like an evicted one does.
+ */
+void workingset_activation(struct page *page)
+{
+	atomic_inc(&page_zone(page)->inactive_age);
+}
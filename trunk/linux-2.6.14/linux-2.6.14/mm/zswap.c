@@ -0,0 +1,523 @@
+/*
+ * mm/zswap.c - compressed cache for swap pages
+ *
+ * Pages which reclaim writes to swap are compressed with zlib first and
+ * kept in memory, so that swapping them back in costs a decompression
+ * instead of a disk read.  Only pages which do not compress well, and
+ * pages for which the pool has no room, still go to the swap device.
+ *
+ * The compressed pages live in a pool of slab caches, one for each
+ * multiple of ZSWAP_CLASS_SIZE bytes, up to a size beyond which a page
+ * is not worth keeping compressed.  Each swap device has a radix tree
+ * mapping swap offsets to entries in the pool.  An entry stays as long
+ * as its swap slot is in use: the page may be read back several times
+ * while it sits clean in the swap cache.  It goes when the swap slot is
+ * freed, or when the page is written out to the slot again.
+ *
+ * swap_writepage() and swap_readpage() are called with the page locked
+ * in the swap cache, which holds a reference on the swap slot, so the
+ * entry for a slot never changes under them.
+ *
+ * The settings and statistics are in /sys/kernel/mm/zswap.
+ */
+
+#include <linux/mm.h>
+#include <linux/zswap.h>
+#include <linux/swap.h>
+#include <linux/swapops.h>
+#include <linux/highmem.h>
+#include <linux/radix-tree.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/percpu.h>
+#include <linux/zlib.h>
+#include <linux/kobject.h>
+#include <linux/sysfs.h>
+#include <linux/init.h>
+#include <linux/module.h>
+
+/*
+ * Compressed pages are stored in ZSWAP_NR_CLASSES size classes; a page
+ * which does not compress to ZSWAP_MAX_COMPRESSED bytes goes to disk.
+ */
+#define ZSWAP_CLASS_SIZE	(PAGE_SIZE / 16)
+#define ZSWAP_NR_CLASSES	12
+#define ZSWAP_MAX_COMPRESSED	(ZSWAP_NR_CLASSES * ZSWAP_CLASS_SIZE)
+
+/* Allocations come from reclaim: no recursion, no reserves */
+#define ZSWAP_GFP	(__GFP_NOWARN | __GFP_NORETRY | __GFP_NOMEMALLOC)
+
+struct zswap_entry {
+	void *data;
+	unsigned int length;		/* compressed size */
+	unsigned long offset;		/* swap slot, index in the tree */
+};
+
+struct zswap_tree {
+	struct radix_tree_root root;	/* swap offset -> zswap_entry */
+	spinlock_t lock;
+};
+
+/* The zlib streams and workspaces of a cpu */
+struct zswap_stream {
+	z_stream deflate;
+	z_stream inflate;
+};
+
+static struct zswap_tree zswap_trees[MAX_SWAPFILES];
+static kmem_cache_t *zswap_entry_cache;
+static kmem_cache_t *zswap_class_cache[ZSWAP_NR_CLASSES];
+static DEFINE_PER_CPU(struct zswap_stream, zswap_streams);
+
+/* Tunables */
+static int zswap_enabled = 1;
+static unsigned int zswap_max_pool_percent = 20;
+
+/* Statistics */
+static atomic_t zswap_stored_pages = ATOMIC_INIT(0);
+static atomic_t zswap_pool_classes = ATOMIC_INIT(0);	/* class units */
+static atomic_t zswap_hits = ATOMIC_INIT(0);
+static atomic_t zswap_misses = ATOMIC_INIT(0);
+static atomic_t zswap_reject_compress_poor = ATOMIC_INIT(0);
+static atomic_t zswap_reject_pool_limit = ATOMIC_INIT(0);
+static atomic_t zswap_reject_alloc_fail = ATOMIC_INIT(0);
+
+static inline unsigned long zswap_pool_bytes(void)
+{
+	return (unsigned long)atomic_read(&zswap_pool_classes) *
+		ZSWAP_CLASS_SIZE;
+}
+
+static int zswap_pool_full(void)
+{
+	unsigned long max_pages;
+
+	max_pages = totalram_pages * zswap_max_pool_percent / 100;
+	return zswap_pool_bytes() >> PAGE_SHIFT >= max_pages;
+}
+
+static inline int zswap_class(unsigned int length)
+{
+	return (length - 1) / ZSWAP_CLASS_SIZE;
+}
+
+static void zswap_free_entry(struct zswap_entry *entry)
+{
+	int class = zswap_class(entry->length);
+
+	kmem_cache_free(zswap_class_cache[class], entry->data);
+	kmem_cache_free(zswap_entry_cache, entry);
+	atomic_sub(class + 1, &zswap_pool_classes);
+	atomic_dec(&zswap_stored_pages);
+}
+
+/*
+ * Compress @page into a new entry.  Returns NULL if the page does not
+ * compress well enough, or if no memory was to be had for it.
+ */
+static struct zswap_entry *zswap_compress(struct page *page)
+{
+	struct zswap_stream *stream;
+	struct zswap_entry *entry = NULL;
+	unsigned char *dst;
+	void *src;
+	int class, ret;
+
+	/* The compressed data only fits in the class buffer in the end */
+	dst = (unsigned char *)__get_free_page(ZSWAP_GFP);
+	if (!dst) {
+		atomic_inc(&zswap_reject_alloc_fail);
+		return NULL;
+	}
+
+	stream = &get_cpu_var(zswap_streams);
+	src = kmap_atomic(page, KM_USER0);
+	zlib_deflateReset(&stream->deflate);
+	stream->deflate.next_in = src;
+	stream->deflate.avail_in = PAGE_SIZE;
+	stream->deflate.next_out = dst;
+	stream->deflate.avail_out = ZSWAP_MAX_COMPRESSED;
+	ret = zlib_deflate(&stream->deflate, Z_FINISH);
+	kunmap_atomic(src, KM_USER0);
+
+	/* Output space ran out before the end of the stream */
+	if (ret != Z_STREAM_END) {
+		put_cpu_var(zswap_streams);
+		atomic_inc(&zswap_reject_compress_poor);
+		goto out;
+	}
+
+	entry = kmem_cache_alloc(zswap_entry_cache, ZSWAP_GFP);
+	if (entry) {
+		entry->length = stream->deflate.total_out;
+		class = zswap_class(entry->length);
+		entry->data = kmem_cache_alloc(zswap_class_cache[class],
+					       ZSWAP_GFP);
+		if (entry->data) {
+			memcpy(entry->data, dst, entry->length);
+			atomic_add(class + 1, &zswap_pool_classes);
+			atomic_inc(&zswap_stored_pages);
+		} else {
+			kmem_cache_free(zswap_entry_cache, entry);
+			entry = NULL;
+		}
+	}
+	put_cpu_var(zswap_streams);
+	if (!entry)
+		atomic_inc(&zswap_reject_alloc_fail);
+out:
+	free_page((unsigned long)dst);
+	return entry;
+}
+
+/* Forget the entry of @offset, if it has one */
+static void zswap_erase(struct zswap_tree *tree, unsigned long offset)
+{
+	struct zswap_entry *entry;
+
+	spin_lock(&tree->lock);
+	entry = radix_tree_delete(&tree->root, offset);
+	spin_unlock(&tree->lock);
+	if (entry)
+		zswap_free_entry(entry);
+}
+
+/**
+ * zswap_store - keep a page on its way to swap compressed in memory
+ * @page: the locked swap cache page swap_writepage() writes out
+ *
+ * Returns 0 when the page is stored, and need not be written to disk.
+ */
+int zswap_store(struct page *page)
+{
+	swp_entry_t swp = { .val = page->private };
+	struct zswap_tree *tree = &zswap_trees[swp_type(swp)];
+	unsigned long offset = swp_offset(swp);
+	struct zswap_entry *entry;
+	int err;
+
+	/* The page was written before: its old contents are stale now */
+	zswap_erase(tree, offset);
+
+	if (!zswap_enabled)
+		return -ENOSPC;
+	if (zswap_pool_full()) {
+		atomic_inc(&zswap_reject_pool_limit);
+		return -ENOSPC;
+	}
+
+	entry = zswap_compress(page);
+	if (!entry)
+		return -ENOSPC;
+	entry->offset = offset;
+
+	spin_lock(&tree->lock);
+	err = radix_tree_insert(&tree->root, offset, entry);
+	spin_unlock(&tree->lock);
+	if (err) {
+		zswap_free_entry(entry);
+		atomic_inc(&zswap_reject_alloc_fail);
+		return err;
+	}
+	return 0;
+}
+
+/**
+ * zswap_load - read a swap page from the compressed cache
+ * @page: the locked swap cache page swap_readpage() reads in
+ *
+ * Returns 0 when the page was found and decompressed into @page,
+ * -ENOENT when it is not in zswap and must be read from the swap device,
+ * and -EIO when it is but could not be decompressed.
+ */
+int zswap_load(struct page *page)
+{
+	swp_entry_t swp = { .val = page->private };
+	struct zswap_tree *tree = &zswap_trees[swp_type(swp)];
+	struct zswap_stream *stream;
+	struct zswap_entry *entry;
+	void *dst;
+	int ret;
+
+	spin_lock(&tree->lock);
+	entry = radix_tree_lookup(&tree->root, swp_offset(swp));
+	spin_unlock(&tree->lock);
+	if (!entry) {
+		atomic_inc(&zswap_misses);
+		return -ENOENT;
+	}
+
+	stream = &get_cpu_var(zswap_streams);
+	dst = kmap_atomic(page, KM_USER0);
+	zlib_inflateReset(&stream->inflate);
+	stream->inflate.next_in = entry->data;
+	stream->inflate.avail_in = entry->length;
+	stream->inflate.next_out = dst;
+	stream->inflate.avail_out = PAGE_SIZE;
+	ret = zlib_inflate(&stream->inflate, Z_FINISH);
+	kunmap_atomic(dst, KM_USER0);
+	put_cpu_var(zswap_streams);
+
+	if (ret != Z_STREAM_END || stream->inflate.total_out != PAGE_SIZE) {
+		printk(KERN_ERR "zswap: cannot decompress swap page %lx\n",
+		       swp.val);
+		return -EIO;
+	}
+	atomic_inc(&zswap_hits);
+	return 0;
+}
+
+/**
+ * zswap_invalidate - drop the compressed copy of a freed swap slot
+ * @type: the swap device
+ * @offset: the slot
+ *
+ * Called with swap_lock held, when the count of the slot drops to zero.
+ */
+void zswap_invalidate(unsigned type, unsigned long offset)
+{
+	zswap_erase(&zswap_trees[type], offset);
+}
+
+/**
+ * zswap_invalidate_area - drop all compressed pages of a swap device
+ * @type: the swap device swapoff is done with
+ */
+void zswap_invalidate_area(unsigned type)
+{
+	struct zswap_tree *tree = &zswap_trees[type];
+	struct zswap_entry *entries[16];
+	unsigned long index = 0;
+	unsigned int i, nr;
+
+	do {
+		spin_lock(&tree->lock);
+		nr = radix_tree_gang_lookup(&tree->root, (void **)entries,
+					    index, ARRAY_SIZE(entries));
+		for (i = 0; i < nr; i++)
+			radix_tree_delete(&tree->root, entries[i]->offset);
+		if (nr)
+			index = entries[nr - 1]->offset + 1;
+		spin_unlock(&tree->lock);
+
+		for (i = 0; i < nr; i++)
+			zswap_free_entry(entries[i]);
+		cond_resched();
+	} while (nr);
+}
+
+/*
+ * /sys/kernel/mm/zswap
+ */
+
+#define ZSWAP_ATTR_RO(_name) \
+static struct subsys_attribute _name##_attr = __ATTR_RO(_name)
+
+#define ZSWAP_ATTR_RW(_name) \
+static struct subsys_attribute _name##_attr = \
+	__ATTR(_name, 0644, _name##_show, _name##_store)
+
+static ssize_t zswap_store_uint(const char *page, size_t count,
+				unsigned int *value, unsigned int min,
+				unsigned int max)
+{
+	char *end;
+	unsigned long val = simple_strtoul(page, &end, 10);
+
+	if (end == page || (*end && *end != '\n') || val < min || val > max)
+		return -EINVAL;
+	*value = val;
+	return count;
+}
+
+static ssize_t enabled_show(struct subsystem *subsys, char *page)
+{
+	return sprintf(page, "%d\n", zswap_enabled);
+}
+
+static ssize_t enabled_store(struct subsystem *subsys, const char *page,
+			     size_t count)
+{
+	unsigned int val;
+	ssize_t ret;
+
+	ret = zswap_store_uint(page, count, &val, 0, 1);
+	if (ret > 0)
+		zswap_enabled = val;
+	return ret;
+}
+ZSWAP_ATTR_RW(enabled);
+
+static ssize_t max_pool_percent_show(struct subsystem *subsys, char *page)
+{
+	return sprintf(page, "%u\n", zswap_max_pool_percent);
+}
+
+static ssize_t max_pool_percent_store(struct subsystem *subsys,
+				      const char *page, size_t count)
+{
+	return zswap_store_uint(page, count, &zswap_max_pool_percent,
+				0, 100);
+}
+ZSWAP_ATTR_RW(max_pool_percent);
+
+static ssize_t stored_pages_show(struct subsystem *subsys, char *page)
+{
+	return sprintf(page, "%d\n", atomic_read(&zswap_stored_pages));
+}
+ZSWAP_ATTR_RO(stored_pages);
+
+static ssize_t pool_size_show(struct subsystem *subsys, char *page)
+{
+	return sprintf(page, "%lu\n", zswap_pool_bytes());
+}
+ZSWAP_ATTR_RO(pool_size);
+
+/* Uncompressed to compressed size of the stored pages, two decimals */
+static ssize_t compression_ratio_show(struct subsystem *subsys, char *page)
+{
+	unsigned long stored, pool, ratio = 0;
+
+	stored = (unsigned long)atomic_read(&zswap_stored_pages) *
+		 (PAGE_SIZE / ZSWAP_CLASS_SIZE);
+	pool = atomic_read(&zswap_pool_classes);
+	if (pool)
+		ratio = stored * 100 / pool;
+	return sprintf(page, "%lu.%02lu\n", ratio / 100, ratio % 100);
+}
+ZSWAP_ATTR_RO(compression_ratio);
+
+static ssize_t hits_show(struct subsystem *subsys, char *page)
+{
+	return sprintf(page, "%d\n", atomic_read(&zswap_hits));
+}
+ZSWAP_ATTR_RO(hits);
+
+static ssize_t misses_show(struct subsystem *subsys, char *page)
+{
+	return sprintf(page, "%d\n", atomic_read(&zswap_misses));
+}
+ZSWAP_ATTR_RO(misses);
+
+static ssize_t reject_compress_poor_show(struct subsystem *subsys,
+					 char *page)
+{
+	return sprintf(page, "%d\n", atomic_read(&zswap_reject_compress_poor));
+}
+ZSWAP_ATTR_RO(reject_compress_poor);
+
+static ssize_t reject_pool_limit_show(struct subsystem *subsys, char *page)
+{
+	return sprintf(page, "%d\n", atomic_read(&zswap_reject_pool_limit));
+}
+ZSWAP_ATTR_RO(reject_pool_limit);
+
+static ssize_t reject_alloc_fail_show(struct subsystem *subsys, char *page)
+{
+	return sprintf(page, "%d\n", atomic_read(&zswap_reject_alloc_fail));
+}
+ZSWAP_ATTR_RO(reject_alloc_fail);
+
+static struct attribute *zswap_attrs[] = {
+	&enabled_attr.attr,
+	&max_pool_percent_attr.attr,
+	&stored_pages_attr.attr,
+	&pool_size_attr.attr,
+	&compression_ratio_attr.attr,
+	&hits_attr.attr,
+	&misses_attr.attr,
+	&reject_compress_poor_attr.attr,
+	&reject_pool_limit_attr.attr,
+	&reject_alloc_fail_attr.attr,
+	NULL
+};
+
+static struct attribute_group zswap_attr_group = {
+	.attrs = zswap_attrs,
+};
+
+static decl_subsys(zswap, NULL, NULL);
+
+static void __init zswap_free_streams(void)
+{
+	int cpu;
+
+	for_each_cpu(cpu) {
+		struct zswap_stream *stream = &per_cpu(zswap_streams, cpu);
+
+		vfree(stream->deflate.workspace);
+		vfree(stream->inflate.workspace);
+		stream->deflate.workspace = NULL;
+		stream->inflate.workspace = NULL;
+	}
+}
+
+static int __init zswap_init_streams(void)
+{
+	int cpu, err;
+
+	for_each_cpu(cpu) {
+		struct zswap_stream *stream = &per_cpu(zswap_streams, cpu);
+
+		stream->deflate.workspace =
+			vmalloc(zlib_deflate_workspacesize());
+		stream->inflate.workspace =
+			vmalloc(zlib_inflate_workspacesize());
+		if (!stream->deflate.workspace || !stream->inflate.workspace) {
+			err = -ENOMEM;
+			goto fail;
+		}
+		/* Raw deflate streams: no header or checksum to spend on */
+		if (zlib_deflateInit2(&stream->deflate, Z_BEST_SPEED,
+				      Z_DEFLATED, -MAX_WBITS, MAX_MEM_LEVEL,
+				      Z_DEFAULT_STRATEGY) != Z_OK ||
+		    zlib_inflateInit2(&stream->inflate, -MAX_WBITS) != Z_OK) {
+			err = -EINVAL;
+			goto fail;
+		}
+	}
+	return 0;
+
+fail:
+	/* The zlib streams keep all their state in the workspaces */
+	zswap_free_streams();
+	return err;
+}
+
+static int __init zswap_init(void)
+{
+	static char names[ZSWAP_NR_CLASSES][16];
+	int i, err;
+
+	for (i = 0; i < MAX_SWAPFILES; i++) {
+		INIT_RADIX_TREE(&zswap_trees[i].root, ZSWAP_GFP);
+		spin_lock_init(&zswap_trees[i].lock);
+	}
+
+	zswap_entry_cache = kmem_cache_create("zswap_entry",
+			sizeof(struct zswap_entry), 0, SLAB_PANIC, NULL, NULL);
+	for (i = 0; i < ZSWAP_NR_CLASSES; i++) {
+		sprintf(names[i], "zswap-%lu", (i + 1) * ZSWAP_CLASS_SIZE);
+		zswap_class_cache[i] = kmem_cache_create(names[i],
+				(i + 1) * ZSWAP_CLASS_SIZE, 0, SLAB_PANIC,
+				NULL, NULL);
+	}
+
+	if (zswap_init_streams()) {
+		printk(KERN_ERR "zswap: cannot set up compression, "
+		       "disabled\n");
+		zswap_enabled = 0;
+		return 0;
+	}
+
+	zswap_subsys.kset.kobj.parent = &mm_subsys.kset.kobj;
+	err = subsystem_register(&zswap_subsys);
+	if (!err)
+		err = sysfs_create_group(&zswap_subsys.kset.kobj,
+					 &zswap_attr_group);
+	if (err)
+		printk(KERN_ERR "zswap: cannot register sysfs files\n");
+	return 0;
+}
+
+module_init(zswap_init)